@@ -0,0 +1,73 @@
+#!/bin/bash
+
+# Runs the same log through Sagan with "rule-evaluation: event" and
+# "rule-evaluation: batch" and checks that both give the same alerts.  The
+# rules include an "event_id" that is only set by a "normalize" rule
+# earlier in the rule set.
+#
+# Usage: batch-test.sh [path to sagan binary] [path to sagan-rules]
+#
+# Sagan must be built with liblognorm support.  The classification,
+# reference,  gen-msg and protocol map files come from the sagan-rules
+# directory.
+
+SAGAN=${1:-../../src/sagan}
+RULES=${2:-/usr/local/etc/sagan-rules}
+
+HERE=$(cd $(dirname $0) && pwd)
+WORK=$(mktemp -d /tmp/sagan-batch-test.XXXXXX)
+
+# Expected alerts (sid,  sorted) for batch-test.log
+
+EXPECTED="5900001 5900001 5900001 5900002 5900002 5900003"
+
+run_sagan()
+{
+
+MODE=$1
+
+mkdir -p $WORK/$MODE/ipc $WORK/$MODE/log
+
+# Start from the stock configuration,  point it at the test rules and cut
+# the rule list down to them.
+
+sed -e "s|^\(    RULE_PATH:\).*|\1 \"$RULES\"|" \
+    -e "s|^\(    LOG_PATH:\).*|\1 \"$WORK/$MODE/log\"|" \
+    -e "s|^\(    LOCKFILE:\).*|\1 \"$WORK/$MODE/sagan.pid\"|" \
+    -e "s|^\(    FIFO:\).*|\1 \"$WORK/$MODE/sagan.fifo\"|" \
+    -e "s|^\(    ipc-directory:\).*|\1 $WORK/$MODE/ipc|" \
+    -e "s|^\(    normalize_rulebase:\).*|\1 \"$HERE/batch-test.rulebase\"|" \
+    -e "s|^\(    rule-evaluation:\).*|\1 $MODE|" \
+    -e "s|^\(    batch-size:\).*|\1 100|" \
+    -e '/^rules-files:/,$d' \
+    $HERE/../../etc/sagan.yaml > $WORK/$MODE/sagan.yaml
+
+echo "rules-files:" >> $WORK/$MODE/sagan.yaml
+echo "  - $HERE/batch-test.rules" >> $WORK/$MODE/sagan.yaml
+
+$SAGAN -Q -u $(id -un) -f $WORK/$MODE/sagan.yaml -l $WORK/$MODE/sagan.log -F $HERE/batch-test.log > $WORK/$MODE/stdout.log 2>&1
+
+if [ "$?" != "0" ]
+        then
+        echo "Sagan failed with rule-evaluation: $MODE.  See $WORK/$MODE"
+        exit 1
+        fi
+
+grep -o "\[1:[0-9]*:" $WORK/$MODE/log/alert.log | cut -d: -f2 | sort -n | tr '\n' ' ' | sed 's/ $//'
+
+}
+
+EVENT=$(run_sagan event) || { echo "$EVENT"; exit 1; }
+BATCH=$(run_sagan batch) || { echo "$BATCH"; exit 1; }
+
+echo "event: $EVENT"
+echo "batch: $BATCH"
+
+if [ "$EVENT" != "$EXPECTED" ] || [ "$BATCH" != "$EXPECTED" ]
+	then
+	echo "FAIL - expected: $EXPECTED (see $WORK)"
+	exit 1
+	fi
+
+echo "PASS"
+rm -rf $WORK
@@ -42,106 +42,93 @@
 #include "sagan.h"
 #include "aetas.h"
 #include "rules.h"
+#include "rule-generation.h"
+#include "util-time.h"
+#include "rule-arena.h"
 
-struct _Rule_Struct *rulestruct;
 
-int Check_Time(int rule_number)
-{
-
-    char ct[64] = { 0 };
-    char buf[80] = { 0 };
-
-    int day_current;
-
-    time_t     now;
-    struct     tm  ts;
-
-    /* For current utime */
-
-    time_t t;
-    struct tm *now_utime;
-
-
-    bool   next_day = 0;
-    bool   off_day = 0;
-
-    char current_time_tmp[5];
-    char hour_tmp[3];
-    char minute_tmp[3];
+/****************************************************************************
+ * Aetas_Compile - Called once when a rule with "alert_time" is loaded.
+ * The days and hours are turned into a bitmap with one bit for every
+ * minute of the week.  A window that crosses midnight (start > end) also
+ * covers the early hours of the following day,  including Saturday into
+ * Sunday.
+ ****************************************************************************/
 
-    int	 current_time;
-
-    /* Get current utime / and day of the week */
-
-    t = time(NULL);
-    now_utime=localtime(&t);
-    strftime(ct, sizeof(ct), "%s",  now_utime);
-    day_current = localtime(&t)->tm_wday;
+void Aetas_Compile(int rule_number)
+{
 
-    time(&now);
-    ts = *localtime(&now);
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
 
-    strftime(hour_tmp, sizeof(buf), "%H", &ts);
-    strftime(minute_tmp, sizeof(buf), "%M", &ts);
+    unsigned char *week = Rule_Arena_Alloc( AETAS_MINUTES / 8 );
 
-    snprintf(current_time_tmp, sizeof(current_time_tmp), "%s%s",  hour_tmp, minute_tmp);
-    current_time = atoi(current_time_tmp);
+    int start = gen->rulestruct[rule_number].aetas_start;
+    int end = gen->rulestruct[rule_number].aetas_end;
+    unsigned char days = gen->rulestruct[rule_number].alert_days;
 
-    strftime(buf, sizeof(buf), "%d", &ts);
+    bool next_day = ( start > end );
+    bool in_window;
 
-    /* We check if rule extends to a new day */
+    int day;
+    int minute;
+    int hhmm;
+    int bit;
 
-    if ( rulestruct[rule_number].aetas_start > rulestruct[rule_number].aetas_end )
+    for ( day = 0; day < 7; day++ )
         {
-            next_day = 1;
-        }
 
-    /* We check if current day is not one of our days */
+            for ( minute = 0; minute < 1440; minute++ )
+                {
 
-    if ( ! Check_Day(rulestruct[rule_number].alert_days, day_current ) )
-        {
-            off_day = 1;
-        }
+                    hhmm = ( ( minute / 60 ) * 100 ) + ( minute % 60 );
+                    in_window = false;
 
-    /* We check that we are in the current day || that the previous day is
-       one of our days and the rule goes over to a new day */
+                    if ( Check_Day(days, day) )
+                        {
 
-    if ( Check_Day(rulestruct[rule_number].alert_days, day_current ) || ( Check_Day(rulestruct[rule_number].alert_days, day_current - 1) && next_day == 1) )
-        {
+                            if ( next_day == false )
+                                {
+                                    in_window = ( hhmm >= start && hhmm <= end );
+                                }
+                            else
+                                {
+                                    in_window = ( hhmm >= start || hhmm <= end );
+                                }
+                        }
 
-            /* We check if rule is in current day and does not extend to a new day */
+                    /* Off day,  but the previous day's window rolled into it */
 
-            if ( next_day == 0 && off_day == 0)
-                {
-                    if ( current_time >= rulestruct[rule_number].aetas_start && current_time <= rulestruct[rule_number].aetas_end )
+                    else if ( next_day == true && Check_Day(days, ( day + 6 ) % 7) )
                         {
-                            return(true);
+                            in_window = ( hhmm <= end );
                         }
-                }
 
-            /* We check if rule extends to a new day and that we are in a current day */
-
-            if ( next_day == 1 && off_day == 0 )
-                {
-                    if ( current_time >= rulestruct[rule_number].aetas_start || current_time <= rulestruct[rule_number].aetas_end )
+                    if ( in_window == true )
                         {
-                            return(true);
+                            bit = ( day * 1440 ) + minute;
+                            week[bit / 8] |= ( 1 << ( bit % 8 ) );
                         }
                 }
+        }
 
-            /* We check if rule is on an off day but the rule rolled into the day */
+    gen->rulestruct[rule_number].aetas_week = week;
 
-            if ( next_day == 1 && off_day == 1 )
-                {
-                    if ( current_time <= rulestruct[rule_number].aetas_end )
-                        {
-                            return(true);
-                        }
-                }
+}
 
-        }
+/****************************************************************************
+ * Check_Time - Is the current local minute of the week one that the rule
+ * is allowed to alert in?
+ ****************************************************************************/
+
+int Check_Time(int rule_number)
+{
+
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
+
+    uint32_t minute = Clock_Minute_Of_Week();
+
+    return( ( gen->rulestruct[rule_number].aetas_week[minute / 8] >> ( minute % 8 ) ) & 1 );
 
-    return(false);
 }
 
 /****************************************************************************/
@@ -23,5 +23,6 @@
 #endif
 
 int Check_Time(int);
+void Aetas_Compile(int);
 int Check_Day(unsigned char, int);
 
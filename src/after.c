@@ -34,197 +34,210 @@
 #include "sagan-defs.h"
 #include "sagan-config.h"
 #include "rules.h"
+#include "rule-generation.h"
+#include "util-time.h"
 #include "after.h"
 #include "ipc.h"
-
-pthread_mutex_t After2_Mutex=PTHREAD_MUTEX_INITIALIZER;
+#include "ipc-hash.h"
 
 struct _After2_IPC *After2_IPC;
+struct _IPC_Hash *After2_Index;
 
 struct _SaganCounters *counters;
-struct _Rule_Struct *rulestruct;
 struct _SaganDebug *debug;
 struct _SaganConfig *config;
 
 struct _Sagan_IPC_Counters *counters_ipc;
 
-bool After2 ( int rule_position, char *ip_src, uint32_t src_port, char *ip_dst,  uint32_t dst_port, char *username, char *syslog_message )
+/****************************************************************************
+ * After2_Match - Confirm an index hit is for the same rule and revision
+ ****************************************************************************/
+
+static bool After2_Match( uint32_t entry, void *arg )
+{
+
+    struct _Rule_Struct *Rule = arg;
+
+    return( After2_IPC[entry].sid == Rule->s_sid && After2_IPC[entry].rev == Rule->s_rev );
+}
+
+/****************************************************************************
+ * After2_Expired - Can an entry be reused?  "arg" is the current time.
+ ****************************************************************************/
+
+static bool After2_Expired( uint32_t entry, void *arg )
+{
+    return( ( *(uint64_t *)arg - After2_IPC[entry].utime ) >= (uint64_t)After2_IPC[entry].expire );
+}
+
+bool After2 ( int rule_position, struct _Sagan_IP *ip_src, uint32_t src_port, struct _Sagan_IP *ip_dst,  uint32_t dst_port, char *username, char *syslog_message )
 {
 
-    time_t t;
-    struct tm *now;
-    char  timet[20];
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
 
-    int i;
+    int32_t i;
+    uint32_t stripe;
 
     uint64_t after_oldtime;
     uint64_t current_time;
 
-    t = time(NULL);
-    now=localtime(&t);
-    strftime(timet, sizeof(timet), "%s",  now);
-
-    char src_tmp[MAXIP] = { 0 };
-    char dst_tmp[MAXIP] = { 0 };
+    char *src_tmp = "";
+    char *dst_tmp = "";
     char username_tmp[MAX_USERNAME_SIZE] = { 0 };
     uint32_t dst_port_tmp = 0;
     uint32_t src_port_tmp = 0;
 
-    char hash_string[128] = { 0 };
     char debug_string[64] = { 0 };
 
-    uint32_t hash;
+    uint64_t hash;
+    uint64_t sid = gen->rulestruct[rule_position].s_sid;
 
     bool after_log_flag = true;
 
-    current_time = atol(timet);
+    current_time = Return_Epoch();
     username_tmp[0] = '\0';
 
-    if ( rulestruct[rule_position].after2_method_src == true )
+    hash = Fnv1a_Hash64( &sid, sizeof(sid), IP_HASH64_SEED );
+    hash = Fnv1a_Hash64( &gen->rulestruct[rule_position].s_rev, sizeof(gen->rulestruct[rule_position].s_rev), hash );
+
+    if ( gen->rulestruct[rule_position].after2_method_src == true )
         {
-            strlcpy(src_tmp, ip_src, sizeof(src_tmp));
+            hash = IP_Hash64( ip_src, hash );
+            src_tmp = IP_Text( ip_src );
         }
 
-    if ( rulestruct[rule_position].after2_method_dst == true )
+    if ( gen->rulestruct[rule_position].after2_method_dst == true )
         {
-            strlcpy(dst_tmp, ip_dst, sizeof(dst_tmp));
+            hash = IP_Hash64( ip_dst, hash );
+            dst_tmp = IP_Text( ip_dst );
         }
 
-    if ( rulestruct[rule_position].after2_method_username == true && username != NULL )
+    if ( gen->rulestruct[rule_position].after2_method_username == true && username != NULL )
         {
             strlcpy(username_tmp, username, sizeof(username_tmp));
         }
 
-    if ( rulestruct[rule_position].after2_method_srcport == true )
+    if ( gen->rulestruct[rule_position].after2_method_srcport == true )
         {
             src_port_tmp = src_port;
         }
 
-    if ( rulestruct[rule_position].after2_method_dstport == true )
+    if ( gen->rulestruct[rule_position].after2_method_dstport == true )
         {
             dst_port_tmp = dst_port;
         }
 
-    snprintf(hash_string, sizeof(hash_string), "%s|%d|%s|%d|%s", src_tmp, src_port_tmp, dst_tmp, dst_port_tmp, username_tmp);
-
-    hash = Djb2_Hash( hash_string );
-
-    for (i = 0; i < counters_ipc->after2_count; i++ )
-        {
+    /* Ports and username are folded into the same hash as the sid,  rev
+       and addresses */
 
-            if ( hash == After2_IPC[i].hash && After2_IPC[i].sid == rulestruct[rule_position].s_sid &&
-                    After2_IPC[i].rev == rulestruct[rule_position].s_rev )
-                {
+    hash = Fnv1a_Hash64( &src_port_tmp, sizeof(src_port_tmp), hash );
+    hash = Fnv1a_Hash64( &dst_port_tmp, sizeof(dst_port_tmp), hash );
+    hash = Fnv1a_Hash64( username_tmp, strlen(username_tmp), hash );
 
+    stripe = IPC_Hash_Lock( After2_Index, hash );
 
-                    File_Lock(config->shm_after2);
-                    pthread_mutex_lock(&After2_Mutex);
+    if ( ( i = IPC_Hash_Lookup( After2_Index, hash, After2_Match, &gen->rulestruct[rule_position] ) ) != -1 )
+        {
 
-                    After2_IPC[i].count++;
+            After2_IPC[i].count++;
 
-                    after_oldtime = current_time - After2_IPC[i].utime;
+            after_oldtime = current_time - After2_IPC[i].utime;
 
-                    strlcpy(After2_IPC[i].syslog_message, syslog_message, sizeof(After2_IPC[i].syslog_message));
-                    strlcpy(After2_IPC[i].signature_msg, rulestruct[rule_position].s_msg, sizeof(After2_IPC[i].signature_msg));
+            strlcpy(After2_IPC[i].syslog_message, syslog_message, sizeof(After2_IPC[i].syslog_message));
+            strlcpy(After2_IPC[i].signature_msg, gen->rulestruct[rule_position].s_msg, sizeof(After2_IPC[i].signature_msg));
 
-                    /* Reset counter if it's expired */
+            /* Reset counter if it's expired */
 
-                    if ( after_oldtime > rulestruct[rule_position].after2_seconds || After2_IPC[i].count == 0 )
-                        {
-                            After2_IPC[i].count=1;
-                            After2_IPC[i].utime = current_time;
-                            after_log_flag = true;
-                        }
+            if ( after_oldtime > gen->rulestruct[rule_position].after2_seconds || After2_IPC[i].count == 0 )
+                {
+                    After2_IPC[i].count=1;
+                    After2_IPC[i].utime = current_time;
+                    after_log_flag = true;
+                }
 
+            if ( gen->rulestruct[rule_position].after2_count < After2_IPC[i].count )
+                {
+                    After2_IPC[i].utime = current_time;
+                    after_log_flag = false;
 
-                    if ( rulestruct[rule_position].after2_count < After2_IPC[i].count )
+                    if ( debug->debuglimits )
                         {
 
-                            After2_IPC[i].utime = current_time;
-                            after_log_flag = false;
-
-                            if ( debug->debuglimits )
+                            if ( After2_IPC[i].after2_method_src == true )
                                 {
+                                    strlcat(debug_string, "by_src ", sizeof(debug_string));
+                                }
 
-                                    if ( After2_IPC[i].after2_method_src == true )
-                                        {
-                                            strlcat(debug_string, "by_src ", sizeof(debug_string));
-                                        }
-
-                                    if ( After2_IPC[i].after2_method_dst == true )
-                                        {
-                                            strlcat(debug_string, "by_dst ", sizeof(debug_string));
-                                        }
-
-                                    if ( After2_IPC[i].after2_method_username == true )
-                                        {
-                                            strlcat(debug_string, "by_username ", sizeof(debug_string));
-                                        }
-
-                                    if ( After2_IPC[i].after2_method_srcport == true )
-                                        {
-                                            strlcat(debug_string, "by_srcport ", sizeof(debug_string));
-                                        }
+                            if ( After2_IPC[i].after2_method_dst == true )
+                                {
+                                    strlcat(debug_string, "by_dst ", sizeof(debug_string));
+                                }
 
-                                    if ( After2_IPC[i].after2_method_dstport == true )
-                                        {
-                                            strlcat(debug_string, "by_dstport ", sizeof(debug_string));
-                                        }
+                            if ( After2_IPC[i].after2_method_username == true )
+                                {
+                                    strlcat(debug_string, "by_username ", sizeof(debug_string));
+                                }
 
-                                    Sagan_Log(NORMAL, "After SID %" PRIu64 ". Tracking by %s[%d: Hash: %lu]", After2_IPC[i].sid, debug_string, i, hash);
+                            if ( After2_IPC[i].after2_method_srcport == true )
+                                {
+                                    strlcat(debug_string, "by_srcport ", sizeof(debug_string));
+                                }
 
+                            if ( After2_IPC[i].after2_method_dstport == true )
+                                {
+                                    strlcat(debug_string, "by_dstport ", sizeof(debug_string));
                                 }
 
-                            counters->after_total++;
-                        }
+                            Sagan_Log(NORMAL, "After SID %" PRIu64 ". Tracking by %s[%d: Hash: %" PRIu64 "]", After2_IPC[i].sid, debug_string, i, hash);
 
-                    pthread_mutex_unlock(&After2_Mutex);
-                    File_Unlock(config->shm_after2);
+                        }
 
-                    return(after_log_flag);
+                    __atomic_add_fetch(&counters->after_total, 1, __ATOMIC_SEQ_CST);
                 }
 
-        }
-
-
-    /* If not found add it to the array */
+            IPC_Hash_Unlock( After2_Index, stripe );
 
-    if ( Clean_IPC_Object(AFTER2) == 0 )
-        {
+            return(after_log_flag);
 
-            File_Lock(config->shm_after2);
-            pthread_mutex_lock(&After2_Mutex);
+        }
 
-            After2_IPC[counters_ipc->after2_count].hash = hash;
+    /* If not found,  add it.  This reuses an expired entry on the way if
+       there is one. */
 
-            After2_IPC[counters_ipc->after2_count].count = 1;
-            After2_IPC[counters_ipc->after2_count].utime = current_time;
-            After2_IPC[counters_ipc->after2_count].expire = rulestruct[rule_position].after2_seconds;
-            After2_IPC[counters_ipc->after2_count].sid = rulestruct[rule_position].s_sid;
-            After2_IPC[counters_ipc->after2_count].rev = rulestruct[rule_position].s_rev;
-            After2_IPC[counters_ipc->after2_count].target_count =rulestruct[rule_position].after2_count;
+    if ( ( i = IPC_Hash_Insert( After2_Index, hash, After2_Expired, &current_time ) ) == -1 )
+        {
+            IPC_Hash_Unlock( After2_Index, stripe );
+            Sagan_Log(WARN, "[%s, line %d] After2_IPC is full,  cannot track SID %" PRIu64 ".", __FILE__, __LINE__, sid);
+            return(true);
+        }
 
-            After2_IPC[counters_ipc->after2_count].after2_method_src = rulestruct[rule_position].after2_method_src;
-            After2_IPC[counters_ipc->after2_count].after2_method_dst = rulestruct[rule_position].after2_method_dst;
-            After2_IPC[counters_ipc->after2_count].after2_method_username = rulestruct[rule_position].after2_method_username;
+    After2_IPC[i].hash = hash;
+    After2_IPC[i].count = 1;
+    After2_IPC[i].utime = current_time;
+    After2_IPC[i].expire = gen->rulestruct[rule_position].after2_seconds;
+    After2_IPC[i].sid = sid;
+    After2_IPC[i].rev = gen->rulestruct[rule_position].s_rev;
+    After2_IPC[i].target_count =gen->rulestruct[rule_position].after2_count;
+    After2_IPC[i].after2_method_src = gen->rulestruct[rule_position].after2_method_src;
+    After2_IPC[i].after2_method_dst = gen->rulestruct[rule_position].after2_method_dst;
+    After2_IPC[i].after2_method_username = gen->rulestruct[rule_position].after2_method_username;
+    After2_IPC[i].after2_method_srcport = gen->rulestruct[rule_position].after2_method_srcport;
+    After2_IPC[i].after2_method_dstport = gen->rulestruct[rule_position].after2_method_dstport;
 
-            strlcpy(After2_IPC[counters_ipc->after2_count].ip_src, src_tmp, sizeof(After2_IPC[counters_ipc->after2_count].ip_src));
-            After2_IPC[counters_ipc->after2_count].src_port = src_port_tmp;
+    strlcpy(After2_IPC[i].ip_src, src_tmp, sizeof(After2_IPC[i].ip_src));
+    After2_IPC[i].src_port = src_port_tmp;
 
-            strlcpy(After2_IPC[counters_ipc->after2_count].ip_dst, dst_tmp, sizeof(After2_IPC[counters_ipc->after2_count].ip_dst));
-            After2_IPC[counters_ipc->after2_count].dst_port = dst_port_tmp;
+    strlcpy(After2_IPC[i].ip_dst, dst_tmp, sizeof(After2_IPC[i].ip_dst));
+    After2_IPC[i].dst_port = dst_port_tmp;
 
-            strlcpy(After2_IPC[counters_ipc->after2_count].username, username_tmp, sizeof(After2_IPC[counters_ipc->after2_count].username));
+    strlcpy(After2_IPC[i].username, username_tmp, sizeof(After2_IPC[i].username));
 
-            strlcpy(After2_IPC[counters_ipc->after2_count].syslog_message, syslog_message, sizeof(After2_IPC[counters_ipc->after2_count].syslog_message));
-            strlcpy(After2_IPC[counters_ipc->after2_count].signature_msg, rulestruct[rule_position].s_msg, sizeof(After2_IPC[counters_ipc->after2_count].signature_msg));
+    strlcpy(After2_IPC[i].syslog_message, syslog_message, sizeof(After2_IPC[i].syslog_message));
+    strlcpy(After2_IPC[i].signature_msg, gen->rulestruct[rule_position].s_msg, sizeof(After2_IPC[i].signature_msg));
 
-            counters_ipc->after2_count++;
+    IPC_Hash_Unlock( After2_Index, stripe );
 
-            pthread_mutex_unlock(&After2_Mutex);
-            File_Unlock(config->shm_after2);
-        }
+    __atomic_store_n(&counters_ipc->after2_count, After2_Index->entry_count, __ATOMIC_SEQ_CST);
 
     return(true);
 }
-
@@ -41,6 +41,9 @@
 #include "sagan-defs.h"
 #include "config-yaml.h"
 #include "rules.h"
+#include "rule-generation.h"
+#include "rule-image.h"
+#include "rule-load.h"
 #include "sagan-config.h"
 #include "classifications.h"
 #include "input-json-map.h"
@@ -92,7 +95,8 @@ struct _SaganDebug *debug;
 struct _SaganVar *var;
 struct _SaganCounters *counters;
 struct _Rules_Loaded *rules_loaded;
-struct _Rule_Struct *rulestruct;
+
+pthread_mutex_t SaganRulesLoadedMutex;
 
 #ifndef HAVE_LIBYAML
 ** You must of LIBYAML installed! **
@@ -112,8 +116,6 @@ void Load_YAML_Config( char *yaml_file )
 
     bool done = 0;
 
-    int check = 0;
-
     unsigned char type = 0;
     int sub_type = 0;
     unsigned char toggle = 0;
@@ -240,6 +242,18 @@ void Load_YAML_Config( char *yaml_file )
 
             config->max_batch = DEFAULT_SYSLOG_BATCH;
 
+            config->rule_order_adaptive = false;
+
+            config->rule_eval_batch = false;
+
+            config->rule_profile_flag = false;
+            config->rule_profile_top = RULE_PROFILE_DEFAULT_TOP;
+
+            config->template_cache_flag = false;
+            config->template_cache_size = TEMPLATE_CACHE_DEFAULT_SIZE;
+
+            config->rule_image[0] = '\0';
+
             config->pp_sagan_track_clients = TRACK_TIME;
 
             config->sagan_proto = 17;           /* Default to UDP */
@@ -929,6 +943,100 @@ void Load_YAML_Config( char *yaml_file )
 
                                         }
 
+                                    else if (!strcmp(last_pass, "rule-ordering"))
+                                        {
+
+                                            Var_To_Value(value, tmp, sizeof(tmp));
+
+                                            if (strcmp(tmp, "static") && strcmp(tmp, "adaptive"))
+                                                {
+
+                                                    Sagan_Log(ERROR, "[%s, line %d] sagan-core|rule-ordering is set to an invalid type '%s'. It must be 'static' or 'adaptive'. Abort!", __FILE__, __LINE__, tmp);
+
+                                                }
+
+                                            if (!strcmp(tmp, "adaptive"))
+                                                {
+                                                    config->rule_order_adaptive = true;
+                                                }
+                                            else
+                                                {
+                                                    config->rule_order_adaptive = false;
+                                                }
+                                        }
+
+                                    else if (!strcmp(last_pass, "rule-evaluation"))
+                                        {
+
+                                            Var_To_Value(value, tmp, sizeof(tmp));
+
+                                            if (strcmp(tmp, "event") && strcmp(tmp, "batch"))
+                                                {
+
+                                                    Sagan_Log(ERROR, "[%s, line %d] sagan-core|rule-evaluation is set to an invalid type '%s'. It must be 'event' or 'batch'. Abort!", __FILE__, __LINE__, tmp);
+
+                                                }
+
+                                            if (!strcmp(tmp, "batch"))
+                                                {
+                                                    config->rule_eval_batch = true;
+                                                }
+                                            else
+                                                {
+                                                    config->rule_eval_batch = false;
+                                                }
+                                        }
+
+                                    else if (!strcmp(last_pass, "rule-profiling"))
+                                        {
+
+                                            if (!strcasecmp(value, "enabled") || !strcasecmp(value, "true" ) || !strcasecmp(value, "yes") )
+                                                {
+                                                    config->rule_profile_flag = true;
+                                                }
+                                        }
+
+                                    else if (!strcmp(last_pass, "rule-profiling-top"))
+                                        {
+
+                                            Var_To_Value(value, tmp, sizeof(tmp));
+
+                                            config->rule_profile_top = atoi(tmp);
+
+                                            if ( config->rule_profile_top <= 0 )
+                                                {
+                                                    Sagan_Log(ERROR, "[%s, line %d] sagan-core|rule-profiling-top is zero/invalid. Abort!", __FILE__, __LINE__);
+                                                }
+                                        }
+
+                                    else if (!strcmp(last_pass, "template-cache"))
+                                        {
+
+                                            if (!strcasecmp(value, "enabled") || !strcasecmp(value, "true" ) || !strcasecmp(value, "yes") )
+                                                {
+                                                    config->template_cache_flag = true;
+                                                }
+                                        }
+
+                                    else if (!strcmp(last_pass, "template-cache-size"))
+                                        {
+
+                                            Var_To_Value(value, tmp, sizeof(tmp));
+
+                                            config->template_cache_size = strtoull(tmp, NULL, 10);
+
+                                            if ( config->template_cache_size == 0 )
+                                                {
+                                                    Sagan_Log(ERROR, "[%s, line %d] sagan-core|template-cache-size is zero/invalid. Abort!", __FILE__, __LINE__);
+                                                }
+                                        }
+
+                                    else if (!strcmp(last_pass, "rule-image"))
+                                        {
+                                            Var_To_Value(value, tmp, sizeof(tmp));
+                                            strlcpy(config->rule_image, tmp, sizeof(config->rule_image));
+                                        }
+
                                     else if (!strcmp(last_pass, "xbit-storage"))
                                         {
 
@@ -2585,8 +2693,7 @@ void Load_YAML_Config( char *yaml_file )
 
 #endif
 
-                            Var_To_Value(value, tmp, sizeof(tmp));
-                            (void)Load_Rules( (char*)tmp );
+                            /* Rule files are parsed later by Load_YAML_Rules() */
 
                             rules_loaded = (_Rules_Loaded *) realloc(rules_loaded, (counters->rules_loaded_count+1) * sizeof(_Rules_Loaded));
 
@@ -2768,22 +2875,6 @@ void Load_YAML_Config( char *yaml_file )
     /* Sanity checks here */
     /**********************/
 
-    /* Check rules for duplicate sid.  We can't have that! */
-
-    for (a = 0; a < counters->rulecount; a++)
-        {
-
-            for ( check = a+1; check < counters->rulecount; check++)
-                {
-
-                    if ( rulestruct[check].s_sid == rulestruct[a].s_sid )
-                        {
-                            Sagan_Log(ERROR, "[%s, line %d] Detected duplicate signature id number %" PRIu64 ".", __FILE__, __LINE__, rulestruct[check].s_sid, rulestruct[a].s_sid);
-                        }
-                }
-        }
-
-
     if ( config->sagan_is_file == false && config->sagan_fifo[0] == '\0' )
         {
             Sagan_Log(ERROR, "[%s, line %d] No FIFO option found which is required! Aborting!", __FILE__, __LINE__);
@@ -2893,4 +2984,105 @@ void Load_YAML_Config( char *yaml_file )
 
 }
 
+/****************************************************************************
+ * Load_YAML_Sid_Compare - qsort() signature ids
+ ****************************************************************************/
+
+static int Load_YAML_Sid_Compare( const void *a, const void *b )
+{
+
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return( x < y ? -1 : x > y );
+
+}
+
+/****************************************************************************
+ * Load_YAML_Rules - Parse the rule files collected by Load_YAML_Config(),
+ * or load them from the "rule-image".  This is kept apart from the
+ * configuration so that a SIGHUP can build the new rules without holding
+ * up the processor threads.  See rule-generation.c
+ ****************************************************************************/
+
+void Load_YAML_Rules( void )
+{
+
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
+
+    struct _Rules_Loaded *rulesets = NULL;
+    uint64_t *sids = NULL;
+    int count = 0;
+    int a = 0;
+
+    /* A precompiled rule image (see rule-image.c) skips the parsing.  It was
+       checked for duplicate sids when it was written. */
+
+    if ( config->rule_image[0] != '\0' && config->rule_image_compile[0] == '\0' &&
+            Rule_Image_Load( config->rule_image ) == true )
+        {
+            return;
+        }
+
+    pthread_mutex_lock(&SaganRulesLoadedMutex);
+
+    count = counters->rules_loaded_count;
+
+    if ( count > 0 )
+        {
+
+            rulesets = malloc(count * sizeof(_Rules_Loaded));
+
+            if ( rulesets == NULL )
+                {
+                    Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for rulesets. Abort!", __FILE__, __LINE__);
+                }
+
+            memcpy(rulesets, rules_loaded, count * sizeof(_Rules_Loaded));
+
+        }
+
+    pthread_mutex_unlock(&SaganRulesLoadedMutex);
+
+    /* Rule files are parsed in parallel.  See rule-load.c */
+
+    Rule_Load_Files( rulesets, count );
+
+    free(rulesets);
+
+    /* Check rules for duplicate sid.  We can't have that!  Sorted,  rather
+       than comparing every rule with every other rule */
+
+    if ( gen->rulecount > 1 )
+        {
+
+            sids = malloc(gen->rulecount * sizeof(uint64_t));
+
+            if ( sids == NULL )
+                {
+                    Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for sids. Abort!", __FILE__, __LINE__);
+                }
+
+            for (a = 0; a < gen->rulecount; a++)
+                {
+                    sids[a] = gen->rulestruct[a].s_sid;
+                }
+
+            qsort(sids, gen->rulecount, sizeof(uint64_t), Load_YAML_Sid_Compare);
+
+            for (a = 1; a < gen->rulecount; a++)
+                {
+
+                    if ( sids[a] == sids[a-1] )
+                        {
+                            Sagan_Log(ERROR, "[%s, line %d] Detected duplicate signature id number %" PRIu64 ".", __FILE__, __LINE__, sids[a]);
+                        }
+                }
+
+            free(sids);
+
+        }
+
+}
+
 #endif
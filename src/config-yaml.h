@@ -82,5 +82,6 @@
 #define		YAML_OUTPUT_EVE			307
 
 void Load_YAML_Config( char * );
+void Load_YAML_Rules( void );
 
 #endif
@@ -31,16 +31,18 @@
 #include "sagan.h"
 #include "sagan-defs.h"
 #include "rules.h"
+#include "rule-generation.h"
 #include "content.h"
 
 #include "parsers/parsers.h"
 
-struct _Rule_Struct *rulestruct;
 
 
 bool Content ( int rule_position, const char *syslog_message )
 {
 
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
+
     int z = 0;
     int alter_num = 0;
     char alter_content[MAX_SYSLOGMSG] = { 0 };
@@ -49,17 +51,17 @@ bool Content ( int rule_position, const char *syslog_message )
 
     alter_num = 0;
 
-    for(z=0; z<rulestruct[rule_position].content_count; z++)
+    for(z=0; z<gen->rulestruct[rule_position].content_count; z++)
         {
 
 
-            if ( rulestruct[rule_position].s_offset[z] != 0 )
+            if ( gen->rulestruct[rule_position].s_offset[z] != 0 )
                 {
 
-                    if ( strlen(syslog_message) > rulestruct[rule_position].s_offset[z] )
+                    if ( strlen(syslog_message) > gen->rulestruct[rule_position].s_offset[z] )
                         {
 
-                            alter_num = strlen(syslog_message) - rulestruct[rule_position].s_offset[z];
+                            alter_num = strlen(syslog_message) - gen->rulestruct[rule_position].s_offset[z];
                             strlcpy(alter_content, syslog_message + (strlen(syslog_message) - alter_num), alter_num + 1);
 
                         }
@@ -80,28 +82,28 @@ bool Content ( int rule_position, const char *syslog_message )
 
             /* Content: DEPTH */
 
-            if ( rulestruct[rule_position].s_depth[z] != 0 )
+            if ( gen->rulestruct[rule_position].s_depth[z] != 0 )
                 {
 
                     /* We do +2 to account for alter_count[0] and whitespace at the begin of syslog message */
 
-                    strlcpy(alter_content, alter_content, rulestruct[rule_position].s_depth[z] + 2);
+                    strlcpy(alter_content, alter_content, gen->rulestruct[rule_position].s_depth[z] + 2);
 
                 }
 
             /* Content: DISTANCE */
 
-            if ( rulestruct[rule_position].s_distance[z] != 0 )
+            if ( gen->rulestruct[rule_position].s_distance[z] != 0 )
                 {
 
-                    alter_num = strlen(syslog_message) - ( rulestruct[rule_position].s_depth[z-1] + rulestruct[rule_position].s_distance[z] + 1);
+                    alter_num = strlen(syslog_message) - ( gen->rulestruct[rule_position].s_depth[z-1] + gen->rulestruct[rule_position].s_distance[z] + 1);
                     strlcpy(alter_content, syslog_message + (strlen(syslog_message) - alter_num), alter_num + 1);
 
                     /* Content: WITHIN */
 
-                    if ( rulestruct[rule_position].s_within[z] != 0 )
+                    if ( gen->rulestruct[rule_position].s_within[z] != 0 )
                         {
-                            strlcpy(alter_content, alter_content, rulestruct[rule_position].s_within[z] + 1);
+                            strlcpy(alter_content, alter_content, gen->rulestruct[rule_position].s_within[z] + 1);
 
                         }
 
@@ -109,14 +111,14 @@ bool Content ( int rule_position, const char *syslog_message )
 
             /* If case insensitive - nocase */
 
-            if ( rulestruct[rule_position].content_case[z] == true )
+            if ( gen->rulestruct[rule_position].content_case[z] == true )
                 {
 
-                    if ( rulestruct[rule_position].content_not[z] == false )
+                    if ( gen->rulestruct[rule_position].content_not[z] == false )
                         {
 
 
-                            if ( !Sagan_stristr(alter_content, rulestruct[rule_position].content[z], true))
+                            if ( !Sagan_stristr(alter_content, gen->rulestruct[rule_position].content[z], true))
                                 {
                                     return(false);
                                 }
@@ -127,7 +129,7 @@ bool Content ( int rule_position, const char *syslog_message )
 
                             /* content not */
 
-                            if ( Sagan_stristr(alter_content, rulestruct[rule_position].content[z], true))
+                            if ( Sagan_stristr(alter_content, gen->rulestruct[rule_position].content[z], true))
                                 {
                                     return(false);
                                 }
@@ -138,10 +140,10 @@ bool Content ( int rule_position, const char *syslog_message )
             else
                 {
 
-                    if ( rulestruct[rule_position].content_not[z] == false )
+                    if ( gen->rulestruct[rule_position].content_not[z] == false )
                         {
 
-                            if ( !Sagan_strstr(alter_content, rulestruct[rule_position].content[z]))
+                            if ( !Sagan_strstr(alter_content, gen->rulestruct[rule_position].content[z]))
                                 {
                                     return(false);
                                 }
@@ -152,7 +154,7 @@ bool Content ( int rule_position, const char *syslog_message )
 
                             /* content not */
 
-                            if ( Sagan_strstr(alter_content, rulestruct[rule_position].content[z]))
+                            if ( Sagan_strstr(alter_content, gen->rulestruct[rule_position].content[z]))
                                 {
                                     return(false);
                                 }
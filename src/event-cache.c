@@ -0,0 +1,208 @@
+/*
+** Copyright (C) 2009-2020 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2020 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* event-cache.c
+ *
+ * Values that Sagan_Engine() derives from a log line (Parse_IP() results,
+ * hashes, protocol,  binary IP addresses,  etc) used to be recomputed for
+ * every rule that requested them.  This caches them for the life of a
+ * single event.  Nothing is computed until a rule actually asks for it.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "sagan.h"
+#include "sagan-defs.h"
+#include "event-cache.h"
+
+#include "parsers/parsers.h"
+
+/****************************************************************************
+ * Event_Cache_Init - Invalidate everything from the previous event.  Only
+ * flags are reset here,  the buffers are filled on demand.
+ ****************************************************************************/
+
+void Event_Cache_Init( struct _Sagan_Event_Cache *EventCache, struct _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL )
+{
+
+    EventCache->SaganProcSyslog = SaganProcSyslog_LOCAL;
+
+    EventCache->parse_ip_done = false;
+    EventCache->lookup_cache_size = 0;
+
+    EventCache->hash_done = false;
+
+    EventCache->proto_program_done = false;
+    EventCache->proto_program = 0;
+
+    memset(EventCache->ip_done, 0, sizeof(EventCache->ip_done));
+
+    EventCache->append_program_done = false;
+    EventCache->http_uri_done = false;
+
+}
+
+/****************************************************************************
+ * Event_Cache_Parse_IP - Run Parse_IP() over the syslog message once and
+ * return the number of entries in the lookup cache.
+ ****************************************************************************/
+
+int Event_Cache_Parse_IP( struct _Sagan_Event_Cache *EventCache )
+{
+
+    if ( EventCache->parse_ip_done == false )
+        {
+
+            memset(EventCache->lookup_cache, 0, sizeof(EventCache->lookup_cache));
+
+            EventCache->lookup_cache_size = Parse_IP(EventCache->SaganProcSyslog->syslog_message, EventCache->lookup_cache );
+            EventCache->parse_ip_done = true;
+        }
+
+    return(EventCache->lookup_cache_size);
+}
+
+/****************************************************************************
+ * Event_Cache_Hash - Returns the first MD5, SHA1 or SHA256 found in the
+ * syslog message.  Returns an empty string if none was found.  All three
+ * are found by the same Parse_Hash() pass.
+ ****************************************************************************/
+
+char *Event_Cache_Hash( struct _Sagan_Event_Cache *EventCache, int type )
+{
+
+    if ( EventCache->hash_done == false )
+        {
+            Parse_Hash(EventCache->SaganProcSyslog->syslog_message,
+                       EventCache->md5, sizeof(EventCache->md5),
+                       EventCache->sha1, sizeof(EventCache->sha1),
+                       EventCache->sha256, sizeof(EventCache->sha256));
+
+            EventCache->hash_done = true;
+        }
+
+    if ( type == PARSE_HASH_MD5 )
+        {
+            return(EventCache->md5);
+        }
+
+    else if ( type == PARSE_HASH_SHA1 )
+        {
+            return(EventCache->sha1);
+        }
+
+    return(EventCache->sha256);
+}
+
+/****************************************************************************
+ * Event_Cache_Proto_Program - Protocol based off the syslog "program"
+ ****************************************************************************/
+
+int Event_Cache_Proto_Program( struct _Sagan_Event_Cache *EventCache )
+{
+
+    if ( EventCache->proto_program_done == false )
+        {
+            EventCache->proto_program = Parse_Proto_Program(EventCache->SaganProcSyslog->syslog_program);
+            EventCache->proto_program_done = true;
+        }
+
+    return(EventCache->proto_program);
+}
+
+/****************************************************************************
+ * Event_Cache_IP - IP_Set() for one of the per-event IP "slots".  The
+ * string for a slot does not change during an event,  so it is only
+ * parsed once.
+ ****************************************************************************/
+
+void Event_Cache_IP( struct _Sagan_Event_Cache *EventCache, int slot, char *ip, struct _Sagan_IP *addr )
+{
+
+    if ( EventCache->ip_done[slot] == false )
+        {
+            IP_Set( &EventCache->ip[slot], ip );
+            EventCache->ip_done[slot] = true;
+        }
+
+    memcpy(addr, &EventCache->ip[slot], sizeof(struct _Sagan_IP));
+}
+
+/****************************************************************************
+ * Event_Cache_Append_Program - "append_program" rule option.  The program
+ * is appended to the syslog message only once per event.  Anything that
+ * was parsed out of the old message is invalidated.
+ ****************************************************************************/
+
+void Event_Cache_Append_Program( struct _Sagan_Event_Cache *EventCache )
+{
+
+    char *syslog_message = EventCache->SaganProcSyslog->syslog_message;
+    size_t room = 0;
+
+    if ( EventCache->append_program_done == true )
+        {
+            return;
+        }
+
+    /* The program always fits (MAX_SYSLOG_PROGRAM is far smaller than
+       MAX_SYSLOGMSG),  so if the result is too long it is the message
+       that is cut short,  never the " | program" rules look for. */
+
+    room = sizeof(EventCache->SaganProcSyslog->syslog_message) - 1 - strlen(" | ") - strlen(EventCache->SaganProcSyslog->syslog_program);
+
+    if ( strlen(syslog_message) > room )
+        {
+            syslog_message[room] = '\0';
+        }
+
+    strlcat(syslog_message, " | ", sizeof(EventCache->SaganProcSyslog->syslog_message));
+    strlcat(syslog_message, EventCache->SaganProcSyslog->syslog_program, sizeof(EventCache->SaganProcSyslog->syslog_message));
+
+    EventCache->parse_ip_done = false;
+    EventCache->hash_done = false;
+    EventCache->SaganProcSyslog->event_id_done = false;
+
+    EventCache->append_program_done = true;
+
+}
+
+/****************************************************************************
+ * Event_Cache_HTTP_URI - hostname+url as decoded from JSON
+ ****************************************************************************/
+
+char *Event_Cache_HTTP_URI( struct _Sagan_Event_Cache *EventCache )
+{
+
+    if ( EventCache->http_uri_done == false )
+        {
+            snprintf(EventCache->http_uri, sizeof(EventCache->http_uri), "%s%s", EventCache->SaganProcSyslog->hostname, EventCache->SaganProcSyslog->url);
+            EventCache->http_uri_done = true;
+        }
+
+    return(EventCache->http_uri);
+}
+
@@ -0,0 +1,83 @@
+/*
+** Copyright (C) 2009-2020 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2020 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* Binary IP "slots" that are cached per event */
+
+#define EVENT_CACHE_IP_JSON_SRC		0	/* src_ip decoded from JSON */
+#define EVENT_CACHE_IP_JSON_DST		1	/* dst_ip decoded from JSON */
+#define EVENT_CACHE_IP_NORMALIZE_SRC	2	/* src-ip from liblognorm */
+#define EVENT_CACHE_IP_NORMALIZE_DST	3	/* dst-ip from liblognorm */
+#define EVENT_CACHE_IP_HOST		4	/* syslog host (or sagan_host) */
+
+#define EVENT_CACHE_IP_MAX		5
+
+/* Per-event cache of values derived from the log line.  Each field is
+   computed the first time a rule asks for it and reused by every other rule
+   for the remainder of the rule scan. */
+
+typedef struct _Sagan_Event_Cache _Sagan_Event_Cache;
+struct _Sagan_Event_Cache
+{
+
+    struct _Sagan_Proc_Syslog *SaganProcSyslog;
+
+    /* Parse_IP() results (parse_src_ip, parse_dst_ip, blacklist, etc) */
+
+    bool parse_ip_done;
+    int  lookup_cache_size;
+    struct _Sagan_Lookup_Cache_Entry lookup_cache[MAX_PARSE_IP];
+
+    /* Parse_Hash() results */
+
+    bool hash_done;
+
+    char md5[MD5_HASH_SIZE+1];
+    char sha1[SHA1_HASH_SIZE+1];
+    char sha256[SHA256_HASH_SIZE+1];
+
+    /* Parse_Proto_Program() results */
+
+    bool proto_program_done;
+    int  proto_program;
+
+    /* IP_Set() results */
+
+    bool ip_done[EVENT_CACHE_IP_MAX];
+    struct _Sagan_IP ip[EVENT_CACHE_IP_MAX];
+
+    /* "append_program" has been applied to the syslog message */
+
+    bool append_program_done;
+
+    /* hostname+url from JSON,  used by bluedot */
+
+    bool http_uri_done;
+    char http_uri[MAX_HOSTNAME_SIZE + MAX_URL_SIZE + 1];
+
+};
+
+void  Event_Cache_Init( struct _Sagan_Event_Cache *EventCache, struct _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL );
+int   Event_Cache_Parse_IP( struct _Sagan_Event_Cache *EventCache );
+char *Event_Cache_Hash( struct _Sagan_Event_Cache *EventCache, int type );
+int   Event_Cache_Proto_Program( struct _Sagan_Event_Cache *EventCache );
+void  Event_Cache_IP( struct _Sagan_Event_Cache *EventCache, int slot, char *ip, struct _Sagan_IP *addr );
+void  Event_Cache_Append_Program( struct _Sagan_Event_Cache *EventCache );
+char *Event_Cache_HTTP_URI( struct _Sagan_Event_Cache *EventCache );
+
@@ -38,90 +38,182 @@
  * Event ID's are stored as "strings".  This allows for greater flexibility with
  * event IDs.  For example,  0001234 doesn't get translated to 1234.
  *
+ * The event's ID is found once per event (Event_ID_Key()) and hashed.  Each
+ * rule keeps its IDs as a sorted array of hashes (Event_ID_Compile()),  so a
+ * rule with many IDs costs a binary search and usually one strcmp().
+ *
  */
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
 
 #include "sagan.h"
 #include "sagan-defs.h"
 #include "rules.h"
+#include "rule-generation.h"
+#include "rule-arena.h"
 #include "event-id.h"
 
 #include "parsers/parsers.h"
 
-
-#ifdef HAVE_CONFIG_H
-#include "config.h"             /* From autoconf */
-#endif
-
 struct _SaganCounters *counters;
-struct _Rule_Struct *rulestruct;
 
-bool Event_ID ( int position, _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL )
-{
+/****************************************************************************
+ * Event_ID_Compile - Called once a rule's "event_id" list has been parsed.
+ * Builds the sorted hash array.  event_id_index[i] is the position in
+ * event_id[] of the ID with the i'th smallest hash.
+ ****************************************************************************/
 
-    char alter_message[MAX_SYSLOGMSG] = { 0 };
-    char tmp_content[9] = { 0 };
+void Event_ID_Compile( int rule_number )
+{
 
-    int i = 0;
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
 
+    int count = gen->rulestruct[rule_number].event_id_count;
 
-    /* If we do _not_ have a decoded JSON event_id,  we attempt to find it via a traditional
-       way.  This is the equivalent of:
+    uint32_t *hash = Rule_Arena_Alloc( count * sizeof(uint32_t) );
+    unsigned char *index = Rule_Arena_Alloc( count );
 
-       content: " 1234|3a| "; depth: 8;
+    uint32_t h = 0;
+    unsigned char x = 0;
 
-       1234 == the event ID.  This is how most logging programs (NXlog, Evtsys, etc) record the
-       event ID. */
+    int i = 0;
+    int j = 0;
 
+    /* Insertion sort,  there are at most MAX_EVENT_ID */
 
-    if ( SaganProcSyslog_LOCAL->event_id[0] == '\0' )
+    for ( i = 0; i < count; i++ )
         {
 
-            for (i = 0; i < rulestruct[position].event_id_count; i++ )
+            h = Fnv1a_Hash( gen->rulestruct[rule_number].event_id[i], strlen(gen->rulestruct[rule_number].event_id[i]), IP_HASH_SEED );
+            x = i;
+
+            for ( j = i; j > 0 && hash[j-1] > h; j-- )
                 {
+                    hash[j] = hash[j-1];
+                    index[j] = index[j-1];
+                }
 
-                    /* Basically - depth: 8; offset: 0; */
+            hash[j] = h;
+            index[j] = x;
+        }
 
-                    strlcpy(alter_message, SaganProcSyslog_LOCAL->syslog_message, 8);
-                    tmp_content[0] = '\0';
+    gen->rulestruct[rule_number].event_id_hash = hash;
+    gen->rulestruct[rule_number].event_id_index = index;
 
-                    /* New equivalent to a "content" */
+}
 
-                    snprintf(tmp_content, sizeof(tmp_content), " %s: ", rulestruct[position].event_id[i]);
+/****************************************************************************
+ * Event_ID_Key - Find the event's ID.  A decoded (JSON/liblognorm) event_id
+ * is used as is.  Otherwise we look for " 1234: " within the first 8 bytes
+ * of the message.  Done once per event.  Anything that changes the
+ * event_id or message clears event_id_done.
+ ****************************************************************************/
 
-                    /* Search.  If we find it,  return true! */
+static void Event_ID_Key( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL )
+{
 
-                    if ( Sagan_stristr(alter_message, tmp_content, 0 ))
-                        {
-                            return(true);
-                        }
-                }
+    const char *msg = SaganProcSyslog_LOCAL->syslog_message;
 
-            return(false);
+    int p = 0;
+    int q = 0;
 
+    SaganProcSyslog_LOCAL->event_id_done = true;
+    SaganProcSyslog_LOCAL->event_id_key[0] = '\0';
+    SaganProcSyslog_LOCAL->event_id_hash = 0;
+
+    if ( SaganProcSyslog_LOCAL->event_id[0] != '\0' )
+        {
+            strlcpy(SaganProcSyslog_LOCAL->event_id_key, SaganProcSyslog_LOCAL->event_id, sizeof(SaganProcSyslog_LOCAL->event_id_key));
         }
     else
         {
 
-            /* If we have a decoded "event id" via JSON/liblognorm,  we can use that
-               value instead */
+            /* Basically - depth: 8; offset: 0; */
 
-
-            for (i = 0; i < rulestruct[position].event_id_count; i++ )
+            for ( p = 0; p < 8 && msg[p] != '\0'; p++ )
                 {
 
-                    if ( !strcmp(rulestruct[position].event_id[i], SaganProcSyslog_LOCAL->event_id ) )
+                    if ( msg[p] != ' ' )
                         {
-                            return(true);
+                            continue;
                         }
 
+                    for ( q = p + 1; q < 8 && msg[q] != '\0' && msg[q] != ' ' && msg[q] != ':'; q++ );
+
+                    if ( q > p + 1 && q + 1 < 8 && msg[q] == ':' && msg[q+1] == ' ' )
+                        {
+                            memcpy(SaganProcSyslog_LOCAL->event_id_key, msg + p + 1, q - p - 1);
+                            SaganProcSyslog_LOCAL->event_id_key[q - p - 1] = '\0';
+                            break;
+                        }
                 }
+        }
+
+    if ( SaganProcSyslog_LOCAL->event_id_key[0] != '\0' )
+        {
+            SaganProcSyslog_LOCAL->event_id_hash = Fnv1a_Hash( SaganProcSyslog_LOCAL->event_id_key, strlen(SaganProcSyslog_LOCAL->event_id_key), IP_HASH_SEED );
+        }
+
+}
+
+bool Event_ID ( int position, _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL )
+{
+
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
 
+    uint32_t *hash = gen->rulestruct[position].event_id_hash;
+    uint32_t h = 0;
+
+    int low = 0;
+    int high = gen->rulestruct[position].event_id_count;
+    int mid = 0;
+
+    if ( SaganProcSyslog_LOCAL->event_id_done == false )
+        {
+            Event_ID_Key( SaganProcSyslog_LOCAL );
+        }
+
+    if ( SaganProcSyslog_LOCAL->event_id_key[0] == '\0' )
+        {
             return(false);
         }
 
+    h = SaganProcSyslog_LOCAL->event_id_hash;
+
+    /* First hash >= h */
+
+    while ( low < high )
+        {
+
+            mid = ( low + high ) / 2;
+
+            if ( hash[mid] < h )
+                {
+                    low = mid + 1;
+                }
+            else
+                {
+                    high = mid;
+                }
+        }
+
+    for ( ; low < gen->rulestruct[position].event_id_count && hash[low] == h; low++ )
+        {
+
+            if ( !strcmp(gen->rulestruct[position].event_id[ gen->rulestruct[position].event_id_index[low] ], SaganProcSyslog_LOCAL->event_id_key ) )
+                {
+                    return(true);
+                }
+        }
+
+    return(false);
 
 }
+
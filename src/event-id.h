@@ -21,3 +21,4 @@
 /* event-id.h */
 
 bool Event_ID ( int position, _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL );
+void Event_ID_Compile( int rule_number );
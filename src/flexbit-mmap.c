@@ -22,6 +22,18 @@
  * flexbit-mmap.c - Functions used for tracking events over multiple log
  * lines.
  *
+ * Flexbits are indexed by their name,  addresses and ports (see
+ * ipc-hash.c).  Each set flexbit is also linked into a "group" for every
+ * partial key a direction can ask about (name,  name + src,  name + dst
+ * and so on,  FLEXBIT_KEY_*).  Groups keep a count of the set flexbits in
+ * them,  so "isset",  "isnotset" and "count" are a single lookup instead of
+ * a walk over every flexbit.
+ *
+ * Both indexes are guarded by the group index's stripe locks.  Flexbit
+ * lookups take the stripe of the key they want.  "set" takes the stripes of
+ * every key the flexbit is in,  while "unset" and the once a second expire
+ * sweep take all of them.
+ *
  */
 
 #ifdef HAVE_CONFIG_H
@@ -38,290 +50,347 @@
 #include "sagan.h"
 #include "sagan-defs.h"
 #include "ipc.h"
+#include "ipc-hash.h"
 #include "flexbit-mmap.h"
 #include "rules.h"
+#include "rule-generation.h"
+#include "util-time.h"
 #include "sagan-config.h"
 #include "parsers/parsers.h"
 
 struct _SaganCounters *counters;
-struct _Rule_Struct *rulestruct;
 struct _SaganDebug *debug;
 struct _SaganConfig *config;
 
-pthread_mutex_t Flexbit_Mutex=PTHREAD_MUTEX_INITIALIZER;
-
 struct _Sagan_IPC_Counters *counters_ipc;
 struct _Sagan_IPC_Flexbit *flexbit_ipc;
+struct _Sagan_IPC_Flexbit_Group *Flexbit_Group_IPC;
+struct _IPC_Hash *Flexbit_Index;
+struct _IPC_Hash *Flexbit_Group_Index;
+
+static const char *Flexbit_Direction[] = { "none", "both", "by_src", "by_dst", "reverse", "src_xbitdst", "dst_xbitsrc", "both_p", "by_src_p", "by_dst_p", "reverse_p", "src_xbitdst_p", "dst_xbitsrc_p" };
 
 /*****************************************************************************
- * Flexbit_Condition - Used for testing "isset" & "isnotset".  Full
- * rule condition is tested here and returned.
+ * Flexbit_Key_Make - Build a "type" key,  keeping only the fields that
+ * kind of key uses.
  *****************************************************************************/
 
-bool Flexbit_Condition_MMAP(int rule_position, char *ip_src, char *ip_dst, int src_port, int dst_port )
+static void Flexbit_Key_Make( struct _Flexbit_Key *Key, uint32_t type, const char *name, const unsigned char *ip_src, const unsigned char *ip_dst, int src_port, int dst_port )
 {
 
-    time_t t;
-    struct tm *now;
-    char  timet[20];
+    memset(Key, 0, sizeof(struct _Flexbit_Key));
 
-    int i;
-    int a;
+    Key->type = type;
+    strlcpy(Key->flexbit_name, name, sizeof(Key->flexbit_name));
 
-    int flexbit_total_match = 0;
-    bool flexbit_match = 0;
-
-    t = time(NULL);
-    now=localtime(&t);
-    strftime(timet, sizeof(timet), "%s",  now);
-
-    Flexbit_Cleanup_MMAP();
-
-    for (i = 0; i < rulestruct[rule_position].flexbit_count; i++)
+    if ( type == FLEXBIT_KEY_SRC || type == FLEXBIT_KEY_PAIR || type == FLEXBIT_KEY_SRCP || type == FLEXBIT_KEY_FULL )
         {
+            memcpy(Key->ip_src, ip_src, sizeof(Key->ip_src));
+        }
 
-            /*******************
-             *      ISSET      *
-             *******************/
-
-            if ( rulestruct[rule_position].flexbit_type[i] == 3 )
-                {
-
-
-                    if ( debug->debugflexbit )
-                        {
-                            Sagan_Log(DEBUG, "[%s, line %d] Condition \"isset\" found in rule.", __FILE__, __LINE__);
-                        }
-
-
-                    for (a = 0; a < counters_ipc->flexbit_count; a++)
-                        {
-
-                            if ( !memcmp(rulestruct[rule_position].flexbit_name[i], flexbit_ipc[a].flexbit_name, sizeof(rulestruct[rule_position].flexbit_name[i])) &&
-                                    flexbit_ipc[a].flexbit_state == true )
-                                {
-
-                                    /* direction: by_src - most common check */
+    if ( type == FLEXBIT_KEY_DST || type == FLEXBIT_KEY_PAIR || type == FLEXBIT_KEY_DSTP || type == FLEXBIT_KEY_FULL )
+        {
+            memcpy(Key->ip_dst, ip_dst, sizeof(Key->ip_dst));
+        }
 
-                                    if ( rulestruct[rule_position].flexbit_direction[i] == 2 &&
-                                            !memcmp(flexbit_ipc[a].ip_src, ip_src, sizeof(flexbit_ipc[a].ip_src)) )
+    if ( type == FLEXBIT_KEY_SRCP || type == FLEXBIT_KEY_FULL )
+        {
+            Key->src_port = src_port;
+        }
 
-                                        {
+    if ( type == FLEXBIT_KEY_DSTP || type == FLEXBIT_KEY_FULL )
+        {
+            Key->dst_port = dst_port;
+        }
+}
 
-                                            if ( debug->debugflexbit )
-                                                {
-                                                    Sagan_Log(DEBUG, "[%s, line %d] \"isset\" flexbit \"%s\" (direction: \"by_src\"). (%s -> any)", __FILE__, __LINE__, flexbit_ipc[a].flexbit_name, flexbit_ipc[a].ip_src);
-                                                }
+/*****************************************************************************
+ * Flexbit_Key_Hash - Index hash of a key
+ *****************************************************************************/
 
-                                            flexbit_total_match++;
+static uint64_t Flexbit_Key_Hash( struct _Flexbit_Key *Key )
+{
+    return( Fnv1a_Hash64( Key, sizeof(struct _Flexbit_Key), IP_HASH64_SEED ) );
+}
 
-                                        }
+/*****************************************************************************
+ * Flexbit_Query - The key a rule's direction looks a flexbit up by.  The
+ * "reverse" and "xbit" directions swap which of the event's addresses and
+ * ports are compared to the flexbit's source and destination.
+ *****************************************************************************/
 
-                                    /* direction: none */
+static void Flexbit_Query( int direction, const char *name, struct _Sagan_IP *ip_src, struct _Sagan_IP *ip_dst, int src_port, int dst_port, struct _Flexbit_Key *Key )
+{
 
-                                    else if ( rulestruct[rule_position].flexbit_direction[i] == 0 )
+    switch ( direction )
+        {
 
-                                        {
+        case 1:		/* both */
+            Flexbit_Key_Make( Key, FLEXBIT_KEY_PAIR, name, ip_src->bits, ip_dst->bits, 0, 0 );
+            break;
 
-                                            if ( debug->debugflexbit )
-                                                {
-                                                    Sagan_Log(DEBUG, "[%s, line %d] \"isset\" flexbit \"%s\" (direction: \"none\"). (any -> any)", __FILE__, __LINE__, flexbit_ipc[a].flexbit_name);
-                                                }
+        case 2:		/* by_src */
+            Flexbit_Key_Make( Key, FLEXBIT_KEY_SRC, name, ip_src->bits, NULL, 0, 0 );
+            break;
 
-                                            flexbit_total_match++;
+        case 3:		/* by_dst */
+            Flexbit_Key_Make( Key, FLEXBIT_KEY_DST, name, NULL, ip_dst->bits, 0, 0 );
+            break;
 
-                                        }
+        case 4:		/* reverse */
+            Flexbit_Key_Make( Key, FLEXBIT_KEY_PAIR, name, ip_dst->bits, ip_src->bits, 0, 0 );
+            break;
 
-                                    /* direction: both */
+        case 5:		/* src_xbitdst */
+            Flexbit_Key_Make( Key, FLEXBIT_KEY_DST, name, NULL, ip_src->bits, 0, 0 );
+            break;
 
-                                    else if ( rulestruct[rule_position].flexbit_direction[i] == 1 &&
-                                              !memcmp(flexbit_ipc[a].ip_src, ip_src, sizeof(flexbit_ipc[a].ip_src)) &&
-                                              !memcmp(flexbit_ipc[a].ip_dst, ip_dst, sizeof(flexbit_ipc[a].ip_dst)) )
+        case 6:		/* dst_xbitsrc */
+            Flexbit_Key_Make( Key, FLEXBIT_KEY_SRC, name, ip_dst->bits, NULL, 0, 0 );
+            break;
 
-                                        {
+        case 7:		/* both_p */
+            Flexbit_Key_Make( Key, FLEXBIT_KEY_FULL, name, ip_src->bits, ip_dst->bits, src_port, dst_port );
+            break;
 
-                                            if ( debug->debugflexbit )
-                                                {
-                                                    Sagan_Log(DEBUG, "[%s, line %d] \"isset\" flexbit \"%s\" (direction: \"both\"). (%s -> %s)", __FILE__, __LINE__, flexbit_ipc[a].flexbit_name, ip_src, ip_dst);
-                                                }
+        case 8:		/* by_src_p */
+            Flexbit_Key_Make( Key, FLEXBIT_KEY_SRCP, name, ip_src->bits, NULL, src_port, 0 );
+            break;
 
-                                            flexbit_total_match++;
+        case 9:		/* by_dst_p */
+            Flexbit_Key_Make( Key, FLEXBIT_KEY_DSTP, name, NULL, ip_dst->bits, 0, dst_port );
+            break;
 
-                                        }
+        case 10:	/* reverse_p */
+            Flexbit_Key_Make( Key, FLEXBIT_KEY_FULL, name, ip_dst->bits, ip_src->bits, dst_port, src_port );
+            break;
 
-                                    /* direction: by_dst */
+        case 11:	/* src_xbitdst_p */
+            Flexbit_Key_Make( Key, FLEXBIT_KEY_DSTP, name, NULL, ip_src->bits, 0, src_port );
+            break;
 
-                                    else if ( rulestruct[rule_position].flexbit_direction[i] == 3 &&
-                                              !memcmp(flexbit_ipc[a].ip_dst, ip_dst, sizeof(flexbit_ipc[a].ip_dst)) )
+        case 12:	/* dst_xbitsrc_p */
+            Flexbit_Key_Make( Key, FLEXBIT_KEY_SRCP, name, ip_dst->bits, NULL, dst_port, 0 );
+            break;
 
-                                        {
+        default:	/* none */
+            Flexbit_Key_Make( Key, FLEXBIT_KEY_NAME, name, NULL, NULL, 0, 0 );
+            break;
 
-                                            if ( debug->debugflexbit)
-                                                {
-                                                    Sagan_Log(DEBUG, "[%s, line %d] \"isset\" flexbit \"%s\" (direction: \"by_dst\"). (any -> %s)", __FILE__, __LINE__, flexbit_ipc[a].flexbit_name, ip_dst);
-                                                }
+        }
+}
 
-                                            flexbit_total_match++;
+/*****************************************************************************
+ * Flexbit_Entry_Key - A "type" key for a stored flexbit
+ *****************************************************************************/
 
-                                        }
+static void Flexbit_Entry_Key( uint32_t x, uint32_t type, struct _Flexbit_Key *Key )
+{
+    Flexbit_Key_Make( Key, type, flexbit_ipc[x].flexbit_name, flexbit_ipc[x].ip_src, flexbit_ipc[x].ip_dst, flexbit_ipc[x].src_port, flexbit_ipc[x].dst_port );
+}
 
-                                    /* direction: reverse */
+/*****************************************************************************
+ * Index callbacks,  see ipc-hash.c
+ *****************************************************************************/
 
-                                    else if ( rulestruct[rule_position].flexbit_direction[i] == 4 &&
-                                              !memcmp(flexbit_ipc[a].ip_src, ip_dst, sizeof(flexbit_ipc[a].ip_src)) &&
-                                              !memcmp(flexbit_ipc[a].ip_dst, ip_src, sizeof(flexbit_ipc[a].ip_dst)) )
+static bool Flexbit_Match( uint32_t entry, void *arg )
+{
 
-                                        {
-                                            if ( debug->debugflexbit)
-                                                {
-                                                    Sagan_Log(DEBUG, "[%s, line %d] \"isset\" flexbit \"%s\" (direction: \"reverse\"). (%s -> %s)", __FILE__, __LINE__, flexbit_ipc[a].flexbit_name, ip_dst, ip_src);
-                                                }
+    struct _Flexbit_Key *Key = arg;
 
-                                            flexbit_total_match++;
+    return( !strcmp(flexbit_ipc[entry].flexbit_name, Key->flexbit_name) &&
+            !memcmp(flexbit_ipc[entry].ip_src, Key->ip_src, sizeof(Key->ip_src)) &&
+            !memcmp(flexbit_ipc[entry].ip_dst, Key->ip_dst, sizeof(Key->ip_dst)) &&
+            flexbit_ipc[entry].src_port == Key->src_port &&
+            flexbit_ipc[entry].dst_port == Key->dst_port );
+}
 
-                                        }
+static bool Flexbit_Expired( uint32_t entry, void *arg )
+{
+    return( flexbit_ipc[entry].flexbit_state == false );
+}
 
-                                    /* direction: src_xbitdst */
+static bool Flexbit_Group_Match( uint32_t entry, void *arg )
+{
+    return( !memcmp(&Flexbit_Group_IPC[entry].key, arg, sizeof(struct _Flexbit_Key)) );
+}
 
-                                    else if ( rulestruct[rule_position].flexbit_direction[i] == 5 &&
-                                              !memcmp(flexbit_ipc[a].ip_dst, ip_src, sizeof(flexbit_ipc[a].ip_dst)) )
+static bool Flexbit_Group_Expired( uint32_t entry, void *arg )
+{
+    return( Flexbit_Group_IPC[entry].live == 0 );
+}
 
-                                        {
+/*****************************************************************************
+ * Flexbit_Link - Count a flexbit that has just been set in each of its
+ * groups.  The stripes for all its keys must be locked.
+ *****************************************************************************/
 
-                                            if ( debug->debugflexbit)
-                                                {
-                                                    Sagan_Log(DEBUG, "[%s, line %d] \"isset\" flexbit \"%s\" (direction: \"src_xbitdst\"). (%s -> any)", __FILE__, __LINE__, flexbit_ipc[a].flexbit_name, ip_src);
-                                                }
+static void Flexbit_Link( uint32_t x )
+{
 
-                                            flexbit_total_match++;
+    struct _Flexbit_Key Key;
+    struct _Sagan_IPC_Flexbit_Group *Group = NULL;
 
-                                        }
+    uint64_t hash = 0;
+    uint32_t type = 0;
+    int32_t g = 0;
 
-                                    /* direction: dst_xbitsrc */
+    for ( type = 0; type < FLEXBIT_KEYS; type++ )
+        {
 
-                                    else if ( rulestruct[rule_position].flexbit_direction[i] == 6 &&
-                                              !memcmp(flexbit_ipc[a].ip_src, ip_dst, sizeof(flexbit_ipc[a].ip_src)) )
+            Flexbit_Entry_Key( x, type, &Key );
+            hash = Flexbit_Key_Hash( &Key );
 
-                                        {
+            if ( ( g = IPC_Hash_Lookup( Flexbit_Group_Index, hash, Flexbit_Group_Match, &Key ) ) == -1 )
+                {
 
-                                            if ( debug->debugflexbit)
-                                                {
-                                                    Sagan_Log(DEBUG, "[%s, line %d] \"isset\" flexbit \"%s\" (direction: \"dst_xbitsrc\"). (any -> %s)", __FILE__, __LINE__, flexbit_ipc[a].flexbit_name, ip_dst);
-                                                }
+                    if ( ( g = IPC_Hash_Insert( Flexbit_Group_Index, hash, Flexbit_Group_Expired, NULL ) ) == -1 )
+                        {
+                            Sagan_Log(WARN, "[%s, line %d] Flexbit group object is full,  flexbit \"%s\" can't be found by every direction.", __FILE__, __LINE__, flexbit_ipc[x].flexbit_name);
+                            flexbit_ipc[x].group[type] = 0;
+                            continue;
+                        }
 
-                                            flexbit_total_match++;
+                    memcpy(&Flexbit_Group_IPC[g].key, &Key, sizeof(struct _Flexbit_Key));
+                    Flexbit_Group_IPC[g].live = 0;
+                    Flexbit_Group_IPC[g].head = 0;
+                }
 
-                                        }
+            Group = &Flexbit_Group_IPC[g];
 
-                                    /* direction: both_p */
+            flexbit_ipc[x].group[type] = g + 1;
+            flexbit_ipc[x].prev[type] = 0;
+            flexbit_ipc[x].next[type] = Group->head;
 
-                                    else if ( rulestruct[rule_position].flexbit_direction[i] == 7 &&
-                                              !memcmp(flexbit_ipc[a].ip_src, ip_src, sizeof(flexbit_ipc[a].ip_src)) &&
-                                              !memcmp(flexbit_ipc[a].ip_dst, ip_dst, sizeof(flexbit_ipc[a].ip_dst)) &&
-                                              flexbit_ipc[a].src_port == src_port &&
-                                              flexbit_ipc[a].dst_port == dst_port )
+            if ( Group->head != 0 )
+                {
+                    flexbit_ipc[Group->head - 1].prev[type] = x + 1;
+                }
 
-                                        {
+            Group->head = x + 1;
+            Group->live++;
+        }
+}
 
-                                            if ( debug->debugflexbit)
-                                                {
-                                                    Sagan_Log(DEBUG, "[%s, line %d] \"isset\" flexbit \"%s\" (direction: \"both_p\"). (%s -> %s)", __FILE__, __LINE__, flexbit_ipc[a].flexbit_name, ip_src, ip_dst);
-                                                }
+/*****************************************************************************
+ * Flexbit_Unlink - Take a flexbit that is being unset or has expired out
+ * of its groups.  The stripes for all its keys must be locked.
+ *****************************************************************************/
 
-                                            flexbit_total_match++;
+static void Flexbit_Unlink( uint32_t x )
+{
 
-                                        }
+    struct _Sagan_IPC_Flexbit_Group *Group = NULL;
+    uint32_t type = 0;
 
-                                    /* direction: by_src_p */
+    for ( type = 0; type < FLEXBIT_KEYS; type++ )
+        {
 
-                                    else if ( rulestruct[rule_position].flexbit_direction[i] == 8 &&
-                                              !memcmp(flexbit_ipc[a].ip_src, ip_src, sizeof(flexbit_ipc[a].ip_src)) &&
-                                              flexbit_ipc[a].src_port == src_port )
+            if ( flexbit_ipc[x].group[type] == 0 )
+                {
+                    continue;
+                }
 
-                                        {
+            Group = &Flexbit_Group_IPC[flexbit_ipc[x].group[type] - 1];
 
-                                            if ( debug->debugflexbit)
-                                                {
-                                                    Sagan_Log(DEBUG, "[%s, line %d] \"isset\" flexbit \"%s\" (direction: \"by_src_p\"). (%s -> any)", __FILE__, __LINE__, flexbit_ipc[a].flexbit_name, ip_src);
-                                                }
+            if ( flexbit_ipc[x].prev[type] != 0 )
+                {
+                    flexbit_ipc[flexbit_ipc[x].prev[type] - 1].next[type] = flexbit_ipc[x].next[type];
+                }
+            else
+                {
+                    Group->head = flexbit_ipc[x].next[type];
+                }
 
-                                            flexbit_total_match++;
+            if ( flexbit_ipc[x].next[type] != 0 )
+                {
+                    flexbit_ipc[flexbit_ipc[x].next[type] - 1].prev[type] = flexbit_ipc[x].prev[type];
+                }
 
-                                        }
+            Group->live--;
 
-                                    /* direction: by_dst_p */
+            flexbit_ipc[x].group[type] = 0;
+            flexbit_ipc[x].next[type] = 0;
+            flexbit_ipc[x].prev[type] = 0;
+        }
+}
 
-                                    else if ( rulestruct[rule_position].flexbit_direction[i] == 9 &&
-                                              !memcmp(flexbit_ipc[a].ip_dst, ip_dst, sizeof(flexbit_ipc[a].ip_dst))  &&
-                                              flexbit_ipc[a].dst_port == dst_port )
+/*****************************************************************************
+ * Flexbit_Live - How many set flexbits match "Key"
+ *****************************************************************************/
 
-                                        {
+static uint32_t Flexbit_Live( struct _Flexbit_Key *Key )
+{
 
-                                            if ( debug->debugflexbit)
-                                                {
-                                                    Sagan_Log(DEBUG, "[%s, line %d] \"isset\" flexbit \"%s\" (direction: \"by_dst_p\"). (any -> %s)", __FILE__, __LINE__, flexbit_ipc[a].flexbit_name, ip_dst);
-                                                }
+    uint64_t hash = Flexbit_Key_Hash( Key );
+    uint32_t stripe = 0;
+    uint32_t live = 0;
+    int32_t x = 0;
 
-                                            flexbit_total_match++;
+    stripe = IPC_Hash_Lock( Flexbit_Group_Index, hash );
 
-                                        }
+    if ( Key->type == FLEXBIT_KEY_FULL )
+        {
 
-                                    /* direction: reverse_p */
+            if ( ( x = IPC_Hash_Lookup( Flexbit_Index, hash, Flexbit_Match, Key ) ) != -1 &&
+                    flexbit_ipc[x].flexbit_state == true )
+                {
+                    live = 1;
+                }
 
-                                    else if ( rulestruct[rule_position].flexbit_direction[i] == 10 &&
-                                              !memcmp(flexbit_ipc[a].ip_src, ip_dst, sizeof(flexbit_ipc[a].ip_src)) &&
-                                              !memcmp(flexbit_ipc[a].ip_dst, ip_src, sizeof(flexbit_ipc[a].ip_dst)) &&
-                                              flexbit_ipc[a].src_port == dst_port &&
-                                              flexbit_ipc[a].dst_port == src_port )
+        }
 
+    else if ( ( x = IPC_Hash_Lookup( Flexbit_Group_Index, hash, Flexbit_Group_Match, Key ) ) != -1 )
+        {
+            live = Flexbit_Group_IPC[x].live;
+        }
 
-                                        {
-                                            if ( debug->debugflexbit)
-                                                {
-                                                    Sagan_Log(DEBUG, "[%s, line %d] \"isset\" flexbit \"%s\" (direction: \"reverse_p\"). (%s -> %s)", __FILE__, __LINE__, flexbit_ipc[a].flexbit_name, ip_dst, ip_src);
-                                                }
+    IPC_Hash_Unlock( Flexbit_Group_Index, stripe );
 
-                                            flexbit_total_match++;
+    return(live);
+}
 
-                                        }
+/*****************************************************************************
+ * Flexbit_Condition - Used for testing "isset" & "isnotset".  Full
+ * rule condition is tested here and returned.
+ *****************************************************************************/
 
-                                    /* direction: src_xbitdst_p */
+bool Flexbit_Condition_MMAP(int rule_position, struct _Sagan_IP *ip_src, struct _Sagan_IP *ip_dst, int src_port, int dst_port )
+{
 
-                                    else if ( rulestruct[rule_position].flexbit_direction[i] == 11 &&
-                                              !memcmp(flexbit_ipc[a].ip_dst, ip_src, sizeof(flexbit_ipc[a].ip_dst)) &&
-                                              flexbit_ipc[a].dst_port == src_port )
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
 
-                                        {
+    int i;
 
-                                            if ( debug->debugflexbit)
-                                                {
-                                                    Sagan_Log(DEBUG, "[%s, line %d] \"isset\" flexbit \"%s\" (direction: \"src_xbitdst_p\"). (%s -> any)", __FILE__, __LINE__, flexbit_ipc[a].flexbit_name, ip_src);
-                                                }
+    int flexbit_total_match = 0;
 
-                                            flexbit_total_match++;
+    struct _Flexbit_Key Key;
+    uint32_t live = 0;
 
-                                        }
+    Flexbit_Cleanup_MMAP();
 
-                                    /* direction: dst_xbitsrc_p */
+    for (i = 0; i < gen->rulestruct[rule_position].flexbit_count; i++)
+        {
 
-                                    else if ( rulestruct[rule_position].flexbit_direction[i] == 12 &&
-                                              !memcmp(flexbit_ipc[a].ip_src, ip_dst, sizeof(flexbit_ipc[a].ip_src)) &&
-                                              flexbit_ipc[a].src_port == dst_port )
+            /*******************
+             *      ISSET      *
+             *******************/
 
-                                        {
+            if ( gen->rulestruct[rule_position].flexbit_type[i] == 3 )
+                {
 
-                                            if ( debug->debugflexbit)
-                                                {
-                                                    Sagan_Log(DEBUG, "[%s, line %d] \"isset\" flexbit \"%s\" (direction: \"dst_xbitsrc_p\"). (any -> %s)", __FILE__, __LINE__, flexbit_ipc[a].flexbit_name, ip_dst);
-                                                }
+                    Flexbit_Query( gen->rulestruct[rule_position].flexbit_direction[i], gen->rulestruct[rule_position].flexbit_name[i], ip_src, ip_dst, src_port, dst_port, &Key );
 
-                                            flexbit_total_match++;
+                    live = Flexbit_Live( &Key );
 
-                                        }
+                    if ( debug->debugflexbit )
+                        {
+                            Sagan_Log(DEBUG, "[%s, line %d] \"isset\" flexbit \"%s\" (direction: \"%s\") is set %u times. (%s:%d -> %s:%d)", __FILE__, __LINE__, gen->rulestruct[rule_position].flexbit_name[i], Flexbit_Direction[gen->rulestruct[rule_position].flexbit_direction[i]], live, IP_Text(ip_src), src_port, IP_Text(ip_dst), dst_port);
+                        }
 
-                                } /* End of strcmp flexbit_name & flexbit_state = 1 */
+                    /* Every matching flexbit counts towards the condition */
 
-                        } /* End of "for a" */
+                    flexbit_total_match += live;
 
                 } /* End "if" flexbit_type == 3 (ISSET) */
 
@@ -329,337 +398,50 @@ bool Flexbit_Condition_MMAP(int rule_position, char *ip_src, char *ip_dst, int s
             *    ISNOTSET     *
             *******************/
 
-            if ( rulestruct[rule_position].flexbit_type[i] == 4 )
+            if ( gen->rulestruct[rule_position].flexbit_type[i] == 4 )
                 {
 
+                    Flexbit_Query( gen->rulestruct[rule_position].flexbit_direction[i], gen->rulestruct[rule_position].flexbit_name[i], ip_src, ip_dst, src_port, dst_port, &Key );
+
+                    live = Flexbit_Live( &Key );
 
                     if ( debug->debugflexbit )
                         {
-                            Sagan_Log(DEBUG, "[%s, line %d] Condition \"isnotset\" found in rule.", __FILE__, __LINE__);
+                            Sagan_Log(DEBUG, "[%s, line %d] \"isnotset\" flexbit \"%s\" (direction: \"%s\") is set %u times. (%s:%d -> %s:%d)", __FILE__, __LINE__, gen->rulestruct[rule_position].flexbit_name[i], Flexbit_Direction[gen->rulestruct[rule_position].flexbit_direction[i]], live, IP_Text(ip_src), src_port, IP_Text(ip_dst), dst_port);
                         }
 
-                    flexbit_match = false;
-
-                    for (a = 0; a < counters_ipc->flexbit_count; a++)
-                        {
-                            if ( !memcmp(rulestruct[rule_position].flexbit_name[i], flexbit_ipc[a].flexbit_name, sizeof(rulestruct[rule_position].flexbit_name[i])) )
-                                {
-
-                                    /* direction: none */
-
-                                    if ( rulestruct[rule_position].flexbit_direction[i] == 0 )
-                                        {
-
-                                            if ( flexbit_ipc[a].flexbit_state == true )
-                                                {
-                                                    if ( debug->debugflexbit )
-                                                        {
-                                                            Sagan_Log(DEBUG, "[%s, line %d] \"isnotset\" flexbit \"%s\" true (direction: \"none\"). (any -> any)", __FILE__, __LINE__, flexbit_ipc[a].flexbit_name);
-
-                                                        }
-
-                                                    flexbit_match = true;
-                                                }
-                                        }
-
-                                    /* direction: both */
-
-                                    if ( rulestruct[rule_position].flexbit_direction[i] == 1 )
-                                        {
-
-                                            if ( !memcmp(flexbit_ipc[a].ip_src, ip_src, sizeof(flexbit_ipc[a].ip_src)) &&
-                                                    !memcmp(flexbit_ipc[a].ip_dst, ip_dst, sizeof(flexbit_ipc[a].ip_dst)) )
-                                                {
-                                                    if ( flexbit_ipc[a].flexbit_state == true )
-                                                        {
-                                                            if ( debug->debugflexbit )
-                                                                {
-                                                                    Sagan_Log(DEBUG, "[%s, line %d] \"isnotset\" flexbit \"%s\" true (direction: \"by_src\"). (%s -> %s)", __FILE__, __LINE__, flexbit_ipc[a].flexbit_name, ip_src, ip_dst);
-
-                                                                }
-
-                                                            flexbit_match = true;
-                                                        }
-                                                }
-                                        }
-
-                                    /* direction: by_src */
-
-                                    if ( rulestruct[rule_position].flexbit_direction[i] == 2 )
-                                        {
-
-                                            if ( !memcmp(flexbit_ipc[a].ip_src, ip_src, sizeof(flexbit_ipc[a].ip_src)) )
-                                                {
-                                                    if ( flexbit_ipc[a].flexbit_state == true )
-                                                        {
-                                                            if ( debug->debugflexbit )
-                                                                {
-                                                                    Sagan_Log(DEBUG, "[%s, line %d] \"isnotset\" flexbit \"%s\" true (direction: \"by_src\"). (%s -> any)", __FILE__, __LINE__, flexbit_ipc[a].flexbit_name, ip_src);
-
-                                                                }
-
-                                                            flexbit_match = true;
-                                                        }
-                                                }
-                                        }
-
-                                    /* direction: by_dst */
-
-                                    else if ( rulestruct[rule_position].flexbit_direction[i] == 3 )
-                                        {
-
-                                            if ( !memcmp(flexbit_ipc[a].ip_dst, ip_dst, sizeof(flexbit_ipc[a].ip_dst)) )
-                                                {
-                                                    if ( flexbit_ipc[a].flexbit_state == true )
-                                                        {
-                                                            if ( debug->debugflexbit )
-                                                                {
-                                                                    Sagan_Log(DEBUG, "[%s, line %d] \"isnotset\" flexbit \"%s\" true (direction: \"by_dst\"). (any -> %s)", __FILE__, __LINE__, flexbit_ipc[a].flexbit_name, ip_dst);
-
-                                                                }
-
-                                                            flexbit_match = true;
-                                                        }
-                                                }
-                                        }
-
-                                    /* direction: reverse */
-
-                                    else if ( rulestruct[rule_position].flexbit_direction[i] == 4 )
-                                        {
-
-                                            if ( !memcmp(flexbit_ipc[a].ip_src, ip_dst, sizeof(flexbit_ipc[a].ip_src)) &&
-                                                    !memcmp(flexbit_ipc[a].ip_dst, ip_src, sizeof(flexbit_ipc[a].ip_dst)) )
-                                                {
-                                                    if ( flexbit_ipc[a].flexbit_state == true )
-                                                        {
-                                                            if ( debug->debugflexbit )
-                                                                {
-                                                                    Sagan_Log(DEBUG, "[%s, line %d] \"isnotset\" flexbit \"%s\" true (direction: \"reverse\"). (%s -> %s)", __FILE__, __LINE__, flexbit_ipc[a].flexbit_name, ip_dst, ip_src);
-
-                                                                }
-
-                                                            flexbit_match = true;
-                                                        }
-                                                }
-                                        }
-
-                                    /* direciton: src_xbitdst */
-
-                                    else if ( rulestruct[rule_position].flexbit_direction[i] == 5 )
-                                        {
-
-                                            if ( !memcmp(flexbit_ipc[a].ip_dst, ip_src, sizeof(flexbit_ipc[a].ip_dst)) )
-                                                {
-                                                    if ( flexbit_ipc[a].flexbit_state == true )
-                                                        {
-                                                            if ( debug->debugflexbit )
-                                                                {
-                                                                    Sagan_Log(DEBUG, "[%s, line %d] \"isnotset\" flexbit \"%s\" true (direction: \"src_xbitdst\"). (any -> %s)", __FILE__, __LINE__, flexbit_ipc[a].flexbit_name, ip_dst);
-
-                                                                }
-
-                                                            flexbit_match = true;
-                                                        }
-                                                }
-                                        }
-
-                                    /* direction: dst_xbitsrc */
-
-                                    else if ( rulestruct[rule_position].flexbit_direction[i] == 6 )
-                                        {
-
-                                            if ( !memcmp(flexbit_ipc[a].ip_src, ip_dst, sizeof(flexbit_ipc[a].ip_src)) )
-                                                {
-                                                    if ( flexbit_ipc[a].flexbit_state == true )
-                                                        {
-                                                            if ( debug->debugflexbit )
-                                                                {
-                                                                    Sagan_Log(DEBUG, "[%s, line %d] \"isnotset\" flexbit \"%s\" true (direction: \"src_xbitdst\"). (%s -> any)", __FILE__, __LINE__, flexbit_ipc[a].flexbit_name, ip_dst);
-
-                                                                }
-
-                                                            flexbit_match = true;
-                                                        }
-                                                }
-                                        }
-
-                                    /* direction: both_p */
-
-                                    else if ( rulestruct[rule_position].flexbit_direction[i] == 7 )
-                                        {
-
-                                            if ( !memcmp(flexbit_ipc[a].ip_src, ip_src, sizeof(flexbit_ipc[a].ip_src)) &&
-                                                    !memcmp(flexbit_ipc[a].ip_dst, ip_dst, sizeof(flexbit_ipc[a].ip_dst)) &&
-                                                    flexbit_ipc[a].src_port == src_port &&
-                                                    flexbit_ipc[a].dst_port == dst_port )
-
-                                                {
-                                                    if ( flexbit_ipc[a].flexbit_state == true )
-                                                        {
-                                                            if ( debug->debugflexbit )
-                                                                {
-                                                                    Sagan_Log(DEBUG, "[%s, line %d] \"isnotset\" flexbit \"%s\" true (direction: \"src_xbitdst\"). (%s -> any)", __FILE__, __LINE__, flexbit_ipc[a].flexbit_name, ip_dst);
-
-                                                                }
-
-                                                            flexbit_match = true;
-                                                        }
-                                                }
-                                        }
-
-                                    /* direction: by_src_p */
-
-                                    else if ( rulestruct[rule_position].flexbit_direction[i] == 8 )
-                                        {
-
-                                            if ( !memcmp(flexbit_ipc[a].ip_src, ip_src, sizeof(flexbit_ipc[a].ip_src)) &&
-                                                    flexbit_ipc[a].src_port == src_port )
-
-                                                {
-                                                    if ( flexbit_ipc[a].flexbit_state == true )
-                                                        {
-                                                            if ( debug->debugflexbit )
-                                                                {
-                                                                    Sagan_Log(DEBUG, "[%s, line %d] \"isnotset\" flexbit \"%s\" true (direction: \"by_src_p\"). (%s:%d -> any)", __FILE__, __LINE__, flexbit_ipc[a].flexbit_name, ip_src, src_port);
-
-                                                                }
-
-                                                            flexbit_match = true;
-                                                        }
-                                                }
-                                        }
-
-                                    /* direction: by_dst_p */
-
-                                    else if ( rulestruct[rule_position].flexbit_direction[i] == 9 )
-                                        {
-
-                                            if ( !memcmp(flexbit_ipc[a].ip_dst, ip_dst, sizeof(flexbit_ipc[a].ip_dst)) &&
-                                                    flexbit_ipc[a].dst_port == dst_port )
-
-                                                {
-                                                    if ( flexbit_ipc[a].flexbit_state == true )
-                                                        {
-                                                            if ( debug->debugflexbit )
-                                                                {
-                                                                    Sagan_Log(DEBUG, "[%s, line %d] \"isnotset\" flexbit \"%s\" true (direction: \"by_dst_p\"). (any -> %s:%d)", __FILE__, __LINE__, flexbit_ipc[a].flexbit_name, ip_dst, dst_port);
-
-                                                                }
-
-                                                            flexbit_match = true;
-                                                        }
-                                                }
-                                        }
-
-                                    /* direction: reverse_p */
-
-                                    else if ( rulestruct[rule_position].flexbit_direction[i] == 10 )
-                                        {
-
-                                            if ( !memcmp(flexbit_ipc[a].ip_src, ip_dst, sizeof(flexbit_ipc[a].ip_src)) &&
-                                                    !memcmp(flexbit_ipc[a].ip_dst, ip_src, sizeof(flexbit_ipc[a].ip_dst)) &&
-                                                    flexbit_ipc[a].src_port == dst_port &&
-                                                    flexbit_ipc[a].dst_port == src_port)
-                                                {
-                                                    if ( flexbit_ipc[a].flexbit_state == true )
-                                                        {
-                                                            if ( debug->debugflexbit )
-                                                                {
-                                                                    Sagan_Log(DEBUG, "[%s, line %d] \"isnotset\" flexbit \"%s\" true (direction: \"reverse_p\"). (%s:%d -> %s:%d)", __FILE__, __LINE__, flexbit_ipc[a].flexbit_name, ip_src, dst_port, ip_dst, src_port);
-
-                                                                }
-
-                                                            flexbit_match = true;
-                                                        }
-                                                }
-                                        }
-
-                                    /* direction: src_xbitdst_p */
-
-                                    else if ( rulestruct[rule_position].flexbit_direction[i] == 11 )
-                                        {
-
-                                            if ( !memcmp(flexbit_ipc[a].ip_dst, ip_src, sizeof(flexbit_ipc[a].ip_dst)) &&
-                                                    flexbit_ipc[a].dst_port == src_port )
-
-                                                {
-                                                    if ( flexbit_ipc[a].flexbit_state == true )
-                                                        {
-                                                            if ( debug->debugflexbit )
-                                                                {
-                                                                    Sagan_Log(DEBUG, "[%s, line %d] \"isnotset\" flexbit \"%s\" true (direction: \"src_xbitdst_p\"). (any -> %s:%d)", __FILE__, __LINE__, flexbit_ipc[a].flexbit_name, ip_src, src_port);
-
-                                                                }
-
-                                                            flexbit_match = true;
-                                                        }
-                                                }
-                                        }
-
-                                    /* direction: dst_xbitsrc_p */
-
-                                    else if ( rulestruct[rule_position].flexbit_direction[i] == 12 )
-                                        {
-
-
-                                            if ( !memcmp(flexbit_ipc[a].ip_src, ip_dst, sizeof(flexbit_ipc[a].ip_src)) &&
-                                                    flexbit_ipc[a].src_port == dst_port )
-                                                {
-                                                    if ( flexbit_ipc[a].flexbit_state == true )
-                                                        {
-                                                            if ( debug->debugflexbit )
-                                                                {
-                                                                    Sagan_Log(DEBUG, "[%s, line %d] \"isnotset\" flexbit \"%s\" true (direction: \"dst_xbitsrc_p\"). (%s:%d-> any)", __FILE__, __LINE__, flexbit_ipc[a].flexbit_name, ip_dst, dst_port);
-
-                                                                }
-
-                                                            flexbit_match = true;
-                                                        }
-                                                }
-                                        }
-
-                                } /* if memcmp(rulestruct[rule_position].xbit_name[i] */
-                        } /* for a = 0 */
-
                     /* flexbit wasn't found for isnotset */
 
-                    if ( flexbit_match == false )
+                    if ( live == 0 )
                         {
                             flexbit_total_match++;
                         }
 
                 } /* rulestruct[rule_position].flexbit_type[i] == 4 */
 
-        } /* for (i = 0; i < rulestruct[rule_position].xbit_count; i++) */
+        } /* for (i = 0; i < rulestruct[rule_position].flexbit_count; i++) */
 
 
-    if ( flexbit_total_match == rulestruct[rule_position].flexbit_condition_count )
+    if ( flexbit_total_match == gen->rulestruct[rule_position].flexbit_condition_count )
         {
 
             if ( debug->debugflexbit )
                 {
-                    Sagan_Log(DEBUG, "[%s, line %d] Got %d flexbits & needed %d. Got corrent number of flexbits, return true!", __FILE__, __LINE__, flexbit_total_match, rulestruct[rule_position].flexbit_condition_count );
+                    Sagan_Log(DEBUG, "[%s, line %d] Got %d flexbits & needed %d. Got corrent number of flexbits, return true!", __FILE__, __LINE__, flexbit_total_match, gen->rulestruct[rule_position].flexbit_condition_count );
                 }
 
             return(true);
 
         }
-    else
-        {
-
-            if ( debug->debugflexbit )
-                {
-                    Sagan_Log(DEBUG, "[%s, line %d] Got %d flexbits, needed %d", __FILE__, __LINE__, flexbit_total_match, rulestruct[rule_position].flexbit_condition_count );
-                }
-
-            return(false);
 
+    if ( debug->debugflexbit )
+        {
+            Sagan_Log(DEBUG, "[%s, line %d] Got %d flexbits, needed %d", __FILE__, __LINE__, flexbit_total_match, gen->rulestruct[rule_position].flexbit_condition_count );
         }
 
-    Sagan_Log(WARN, "Shouldn't make it this far in Xbit_Condition()!\n");
+    return(false);
 
-}  /* End of Xbit_Condition(); */
+}  /* End of Flexbit_Condition(); */
 
 
 /*****************************************************************************
@@ -668,69 +450,63 @@ bool Flexbit_Condition_MMAP(int rule_position, char *ip_src, char *ip_dst, int s
  * distributed attacks.
  *****************************************************************************/
 
-bool Flexbit_Count_MMAP( int rule_position, char *ip_src, char *ip_dst )
+bool Flexbit_Count_MMAP( int rule_position, struct _Sagan_IP *ip_src, struct _Sagan_IP *ip_dst )
 {
 
-    uint32_t a = 0;
-    uint32_t i = 0;
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
+
+    int i = 0;
+    uint32_t live = 0;
     uint32_t counter = 0;
+    bool reached = false;
 
-    for (i = 0; i < rulestruct[rule_position].flexbit_count_count; i++)
+    struct _Flexbit_Key Key;
+
+    Flexbit_Cleanup_MMAP();
+
+    for (i = 0; i < gen->rulestruct[rule_position].flexbit_count; i++)
         {
 
-            for (a = 0; a < counters_ipc->flexbit_count; a++)
+            if ( gen->rulestruct[rule_position].flexbit_type[i] != 8 )
                 {
+                    continue;
+                }
 
-                    if ( rulestruct[rule_position].flexbit_direction[i] == 2 &&
-                            !memcmp(flexbit_ipc[a].ip_src, ip_src, sizeof(flexbit_ipc[a].ip_src)) )
-                        {
-
-                            counter++;
+            Flexbit_Query( gen->rulestruct[rule_position].flexbit_direction[i], gen->rulestruct[rule_position].flexbit_name[i], ip_src, ip_dst, 0, 0, &Key );
 
-                            if ( rulestruct[rule_position].flexbit_count_gt_lt[i] == 0 )
-                                {
+            live = Flexbit_Live( &Key );
+            counter = gen->rulestruct[rule_position].flexbit_count_counter[i];
 
-                                    if ( counter > rulestruct[rule_position].flexbit_count_counter[i] )
-                                        {
+            if ( gen->rulestruct[rule_position].flexbit_count_gt_lt[i] == 0 )
+                {
+                    reached = live > counter;
+                }
 
-                                            if ( debug->debugflexbit)
-                                                {
-                                                    Sagan_Log(DEBUG, "[%s, line %d] Xbit count 'by_src' threshold reached for flexbit '%s'.", __FILE__, __LINE__, flexbit_ipc[a].flexbit_name);
-                                                }
+            else if ( gen->rulestruct[rule_position].flexbit_count_gt_lt[i] == 1 )
+                {
+                    reached = live < counter;
+                }
 
+            else
+                {
+                    reached = live == counter;
+                }
 
-                                            return(true);
-                                        }
-                                }
-                        }
+            if ( reached == true )
+                {
 
-                    else if ( rulestruct[rule_position].flexbit_direction[i] == 3 &&
-                              !memcmp(flexbit_ipc[a].ip_dst, ip_dst, sizeof(flexbit_ipc[a].ip_dst)) )
+                    if ( debug->debugflexbit)
                         {
-
-                            counter++;
-
-                            if ( rulestruct[rule_position].flexbit_count_gt_lt[i] == 0 )
-                                {
-
-                                    if ( counter > rulestruct[rule_position].flexbit_count_counter[i] )
-                                        {
-
-                                            if ( debug->debugflexbit)
-                                                {
-                                                    Sagan_Log(DEBUG, "[%s, line %d] Xbit count 'by_dst' threshold reached for flexbit '%s'.", __FILE__, __LINE__, flexbit_ipc[a].flexbit_name);
-                                                }
-
-                                            return(true);
-                                        }
-                                }
+                            Sagan_Log(DEBUG, "[%s, line %d] Flexbit count '%s' threshold reached for flexbit '%s' (%u set).", __FILE__, __LINE__, Flexbit_Direction[gen->rulestruct[rule_position].flexbit_direction[i]], gen->rulestruct[rule_position].flexbit_name[i], live);
                         }
+
+                    return(true);
                 }
         }
 
     if ( debug->debugflexbit)
         {
-            Sagan_Log(DEBUG, "[%s, line %d] Xbit count threshold NOT reached for flexbit.", __FILE__, __LINE__);
+            Sagan_Log(DEBUG, "[%s, line %d] Flexbit count threshold NOT reached for flexbit.", __FILE__, __LINE__);
         }
 
     return(false);
@@ -742,753 +518,221 @@ bool Flexbit_Count_MMAP( int rule_position, char *ip_src, char *ip_dst )
  * "unset" happen here.
  *****************************************************************************/
 
-void Flexbit_Set_MMAP(int rule_position, char *ip_src, char *ip_dst, int src_port, int dst_port, char *syslog_message )
+void Flexbit_Set_MMAP(int rule_position, struct _Sagan_IP *ip_src, struct _Sagan_IP *ip_dst, int src_port, int dst_port, char *syslog_message )
 {
 
-    int i = 0;
-    int a = 0;
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
 
-    time_t t;
-    struct tm *now;
-    char  timet[20];
-
-    bool flexbit_match = false;
-    bool flexbit_unset_match = 0;
-
-    t = time(NULL);
-    now=localtime(&t);
-    strftime(timet, sizeof(timet), "%s",  now);
+    int i = 0;
 
-    struct _Sagan_Flexbit_Track *flexbit_track;
+    uint64_t current_time = Return_Epoch();
 
-    flexbit_track = malloc(sizeof(_Sagan_Flexbit_Track));
+    struct _Flexbit_Key Key;
+    struct _Flexbit_Key Part;
 
-    if ( flexbit_track  == NULL )
-        {
-            Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for flexbit_track. Abort!", __FILE__, __LINE__);
-        }
+    uint64_t hash = 0;
+    uint64_t mask = 0;
+    uint32_t type = 0;
+    uint32_t m = 0;
+    int32_t x = 0;
 
-    memset(flexbit_track, 0, sizeof(_Sagan_Flexbit_Track));
+    int set_src_port = 0;
+    int set_dst_port = 0;
 
-    int flexbit_track_count = 0;
+    bool flexbit_unset_match = false;
 
     Flexbit_Cleanup_MMAP();
 
-    for (i = 0; i < rulestruct[rule_position].flexbit_count; i++)
+    for (i = 0; i < gen->rulestruct[rule_position].flexbit_count; i++)
         {
 
             /*******************
              *      UNSET      *
              *******************/
 
-            if ( rulestruct[rule_position].flexbit_type[i] == 2 )
+            if ( gen->rulestruct[rule_position].flexbit_type[i] == 2 )
                 {
 
-                    for (a = 0; a < counters_ipc->flexbit_count; a++)
-                        {
-
-                            if ( !strcmp(flexbit_ipc[a].flexbit_name, rulestruct[rule_position].flexbit_name[i] ))
-                                {
-
-                                    /* direction: none */
-
-                                    if ( rulestruct[rule_position].flexbit_direction[i] == 0 )
-                                        {
+                    flexbit_unset_match = false;
 
-                                            if ( debug->debugflexbit)
-                                                {
-                                                    Sagan_Log(DEBUG, "[%s, line %d] \"unset\" flexbit \"%s\" (direction: \"none\"). (any -> any)", __FILE__, __LINE__, flexbit_ipc[a].flexbit_name);
-                                                }
+                    Flexbit_Query( gen->rulestruct[rule_position].flexbit_direction[i], gen->rulestruct[rule_position].flexbit_name[i], ip_src, ip_dst, src_port, dst_port, &Key );
 
+                    hash = Flexbit_Key_Hash( &Key );
 
-                                            File_Lock(config->shm_flexbit);
-                                            pthread_mutex_lock(&Flexbit_Mutex);
+                    /* Every flexbit unset leaves several groups,  which
+                       could be in any stripe */
 
-                                            flexbit_ipc[a].flexbit_state = false;
+                    IPC_Hash_Lock_Mask( Flexbit_Group_Index, IPC_HASH_ALL_STRIPES );
 
-                                            pthread_mutex_unlock(&Flexbit_Mutex);
-                                            File_Unlock(config->shm_flexbit);
-
-                                            flexbit_unset_match = 1;
-
-                                        }
-
-
-                                    /* direction: both */
-
-                                    else if ( rulestruct[rule_position].flexbit_direction[i] == 1 &&
-                                              !memcmp(flexbit_ipc[a].ip_src, ip_src, sizeof(flexbit_ipc[a].ip_src)) &&
-                                              !memcmp(flexbit_ipc[a].ip_dst, ip_dst, sizeof(flexbit_ipc[a].ip_dst)) )
-                                        {
-
-                                            if ( debug->debugflexbit)
-                                                {
-                                                    Sagan_Log(DEBUG, "[%s, line %d] \"unset\" flexbit \"%s\" (direction: \"both\"). (%s -> %s)", __FILE__, __LINE__, flexbit_ipc[a].flexbit_name, ip_src, ip_dst);
-                                                }
-
-                                            File_Lock(config->shm_flexbit);
-                                            pthread_mutex_lock(&Flexbit_Mutex);
-
-                                            flexbit_ipc[a].flexbit_state = false;
-
-                                            pthread_mutex_unlock(&Flexbit_Mutex);
-                                            File_Unlock(config->shm_flexbit);
-
-                                            flexbit_unset_match = 1;
-
-                                        }
-
-                                    /* direction: by_src */
-
-                                    else if ( rulestruct[rule_position].flexbit_direction[i] == 2 &&
-                                              !memcmp(flexbit_ipc[a].ip_src, ip_src, sizeof(flexbit_ipc[a].ip_src)) )
-
-                                        {
-
-                                            if ( debug->debugflexbit)
-                                                {
-                                                    Sagan_Log(DEBUG, "[%s, line %d] \"unset\" flexbit \"%s\" (direction: \"by_src\"). (%s -> any)", __FILE__, __LINE__, flexbit_ipc[a].flexbit_name, ip_src);
-                                                }
-
-                                            File_Lock(config->shm_flexbit);
-                                            pthread_mutex_lock(&Flexbit_Mutex);
-
-                                            flexbit_ipc[a].flexbit_state = false;
-
-                                            pthread_mutex_unlock(&Flexbit_Mutex);
-                                            File_Unlock(config->shm_flexbit);
-
-                                            flexbit_unset_match = 1;
-
-                                        }
-
-
-                                    /* direction: by_dst */
-
-                                    else if ( rulestruct[rule_position].flexbit_direction[i] == 3 &&
-                                              !memcmp(flexbit_ipc[a].ip_dst, ip_dst, sizeof(flexbit_ipc[a].ip_dst)) )
-                                        {
-
-                                            if ( debug->debugflexbit)
-                                                {
-                                                    Sagan_Log(DEBUG, "[%s, line %d] \"unset\" flexbit \"%s\" (direction: \"by_dst\"). (any -> %s)", __FILE__, __LINE__, flexbit_ipc[a].flexbit_name, ip_dst);
-                                                }
-
-                                            File_Lock(config->shm_flexbit);
-                                            pthread_mutex_lock(&Flexbit_Mutex);
-
-                                            flexbit_ipc[a].flexbit_state = false;
-
-                                            pthread_mutex_unlock(&Flexbit_Mutex);
-                                            File_Unlock(config->shm_flexbit);
-
-                                            flexbit_unset_match = 1;
-
-                                        }
-
-                                    /* direction: reverse */
-
-                                    else if ( rulestruct[rule_position].flexbit_direction[i] == 4 &&
-                                              !memcmp(flexbit_ipc[a].ip_dst, ip_src, sizeof(flexbit_ipc[a].ip_dst)) &&
-                                              !memcmp(flexbit_ipc[a].ip_src, ip_dst, sizeof(flexbit_ipc[a].ip_src)) )
-
-                                        {
-
-                                            if ( debug->debugflexbit)
-                                                {
-                                                    Sagan_Log(DEBUG, "[%s, line %d] \"unset\" flexbit \"%s\" (direction: \"reverse\"). (%s -> %s)", __FILE__, __LINE__, flexbit_ipc[a].flexbit_name, ip_dst, ip_src);
-                                                }
-
-                                            File_Lock(config->shm_flexbit);
-                                            pthread_mutex_lock(&Flexbit_Mutex);
-
-                                            flexbit_ipc[a].flexbit_state = false;
-
-                                            pthread_mutex_unlock(&Flexbit_Mutex);
-                                            File_Unlock(config->shm_flexbit);
-
-                                            flexbit_unset_match = 1;
-
-                                        }
-
-                                    /* direction: src_xbitdst */
-
-                                    else if ( rulestruct[rule_position].flexbit_direction[i] == 5 &&
-                                              !memcmp(flexbit_ipc[a].ip_dst, ip_src, sizeof(flexbit_ipc[a].ip_dst)) )
-                                        {
-
-                                            if ( debug->debugflexbit)
-                                                {
-                                                    Sagan_Log(DEBUG, "[%s, line %d] \"unset\" flexbit \"%s\" (direction: \"src_xbitdst\"). (any -> %s)", __FILE__, __LINE__, flexbit_ipc[a].flexbit_name, ip_src);
-                                                }
-
-                                            File_Lock(config->shm_flexbit);
-                                            pthread_mutex_lock(&Flexbit_Mutex);
-
-                                            flexbit_ipc[a].flexbit_state = 0;
-
-                                            pthread_mutex_unlock(&Flexbit_Mutex);
-                                            File_Unlock(config->shm_flexbit);
-
-                                            flexbit_unset_match = 1;
-
-                                        }
-
-                                    /* direction: dst_xbitsrc */
-
-                                    else if ( rulestruct[rule_position].flexbit_direction[i] == 6 &&
-                                              !memcmp(flexbit_ipc[a].ip_src, ip_dst, sizeof(flexbit_ipc[a].ip_src)) )
-                                        {
-
-                                            if ( debug->debugflexbit)
-                                                {
-                                                    Sagan_Log(DEBUG, "[%s, line %d] \"unset\" flexbit \"%s\" (direction: \"dst_xbitsrc\"). (any -> %s)", __FILE__, __LINE__, flexbit_ipc[a].flexbit_name, ip_dst);
-                                                }
-
-                                            File_Lock(config->shm_flexbit);
-                                            pthread_mutex_lock(&Flexbit_Mutex);
-
-                                            flexbit_ipc[a].flexbit_state = 0;
-
-                                            pthread_mutex_unlock(&Flexbit_Mutex);
-                                            File_Unlock(config->shm_flexbit);
-
-                                            flexbit_unset_match = 1;
-
-                                        }
-
-                                    /* direction: both_p */
-
-                                    else if ( rulestruct[rule_position].flexbit_direction[i] == 7 &&
-                                              !memcmp(flexbit_ipc[a].ip_src, ip_src, sizeof(flexbit_ipc[a].ip_src)) &&
-                                              !memcmp(flexbit_ipc[a].ip_dst, ip_dst, sizeof(flexbit_ipc[a].ip_dst)) &&
-                                              flexbit_ipc[a].src_port == src_port &&
-                                              flexbit_ipc[a].dst_port == dst_port )
-                                        {
-
-                                            if ( debug->debugflexbit)
-                                                {
-                                                    Sagan_Log(DEBUG, "[%s, line %d] \"unset\" flexbit \"%s\" (direction: \"both_p\"). (%s -> %s)", __FILE__, __LINE__, flexbit_ipc[a].flexbit_name, ip_src, ip_dst);
-                                                }
-
-                                            File_Lock(config->shm_flexbit);
-                                            pthread_mutex_lock(&Flexbit_Mutex);
-
-                                            flexbit_ipc[a].flexbit_state = 0;
-
-                                            pthread_mutex_unlock(&Flexbit_Mutex);
-                                            File_Unlock(config->shm_flexbit);
-
-                                            flexbit_unset_match = 1;
-
-                                        }
-
-                                    /* direction: by_src_p */
-
-                                    else if ( rulestruct[rule_position].flexbit_direction[i] == 8 &&
-                                              !memcmp(flexbit_ipc[a].ip_src, ip_src, sizeof(flexbit_ipc[a].ip_src)) &&
-                                              flexbit_ipc[a].src_port == src_port )
-
-                                        {
-
-                                            if ( debug->debugflexbit)
-                                                {
-                                                    Sagan_Log(DEBUG, "[%s, line %d] \"unset\" flexbit \"%s\" (direction: \"by_src_p\"). (%s -> any)", __FILE__, __LINE__, flexbit_ipc[a].flexbit_name, ip_src);
-                                                }
-
-                                            File_Lock(config->shm_flexbit);
-                                            pthread_mutex_lock(&Flexbit_Mutex);
-
-                                            flexbit_ipc[a].flexbit_state = 0;
-
-                                            pthread_mutex_unlock(&Flexbit_Mutex);
-                                            File_Unlock(config->shm_flexbit);
-
-                                            flexbit_unset_match = 1;
-
-                                        }
-
-
-                                    /* direction: by_dst_p */
-
-                                    else if ( rulestruct[rule_position].flexbit_direction[i] == 9 &&
-                                              !memcmp(flexbit_ipc[a].ip_dst, ip_dst, sizeof(flexbit_ipc[a].ip_dst)) &&
-                                              flexbit_ipc[a].dst_port == dst_port )
-                                        {
-
-                                            if ( debug->debugflexbit)
-                                                {
-                                                    Sagan_Log(DEBUG, "[%s, line %d] \"unset\" flexbit \"%s\" (direction: \"by_dst\"). (any -> %s)", __FILE__, __LINE__, flexbit_ipc[a].flexbit_name, ip_dst);
-                                                }
-
-                                            File_Lock(config->shm_flexbit);
-                                            pthread_mutex_lock(&Flexbit_Mutex);
-
-                                            flexbit_ipc[a].flexbit_state = 0;
-
-                                            pthread_mutex_unlock(&Flexbit_Mutex);
-                                            File_Unlock(config->shm_flexbit);
-
-                                            flexbit_unset_match = 1;
-
-                                        }
-
-                                    /* direction: reverse_p */
-
-                                    else if ( rulestruct[rule_position].flexbit_direction[i] == 10 &&
-                                              !memcmp(flexbit_ipc[a].ip_dst, ip_src, sizeof(flexbit_ipc[a].ip_dst)) &&
-                                              !memcmp(flexbit_ipc[a].ip_src, ip_dst, sizeof(flexbit_ipc[a].ip_src)) &&
-                                              flexbit_ipc[a].src_port == dst_port &&
-                                              flexbit_ipc[a].dst_port == src_port )
-
-                                        {
-
-                                            if ( debug->debugflexbit)
-                                                {
-                                                    Sagan_Log(DEBUG, "[%s, line %d] \"unset\" flexbit \"%s\" (direction: \"reverse_p\"). (%s -> %s)", __FILE__, __LINE__, flexbit_ipc[a].flexbit_name, ip_dst, ip_src);
-                                                }
-
-                                            File_Lock(config->shm_flexbit);
-                                            pthread_mutex_lock(&Flexbit_Mutex);
-
-                                            flexbit_ipc[a].flexbit_state = 0;
-
-                                            pthread_mutex_unlock(&Flexbit_Mutex);
-                                            File_Unlock(config->shm_flexbit);
-
-                                            flexbit_unset_match = 1;
-
-                                        }
-
-                                    /* direction: src_xbitdst_p */
-
-                                    else if ( rulestruct[rule_position].flexbit_direction[i] == 11 &&
-                                              !memcmp(flexbit_ipc[a].ip_dst, ip_src, sizeof(flexbit_ipc[a].ip_dst)) &&
-                                              flexbit_ipc[a].dst_port == src_port )
-                                        {
-
-                                            if ( debug->debugflexbit)
-                                                {
-                                                    Sagan_Log(DEBUG, "[%s, line %d] \"unset\" flexbit \"%s\" (direction: \"src_xbitdst_p\"). (any -> %s)", __FILE__, __LINE__, flexbit_ipc[a].flexbit_name, ip_src);
-                                                }
-
-                                            File_Lock(config->shm_flexbit);
-                                            pthread_mutex_lock(&Flexbit_Mutex);
-
-                                            flexbit_ipc[a].flexbit_state = 0;
-
-                                            pthread_mutex_unlock(&Flexbit_Mutex);
-                                            File_Unlock(config->shm_flexbit);
-
-                                            flexbit_unset_match = 1;
-
-                                        }
-
-                                    /* direction: dst_xbitsrc_p */
-
-                                    else if ( rulestruct[rule_position].flexbit_direction[i] == 12 &&
-                                              !memcmp(flexbit_ipc[a].ip_src, ip_dst, sizeof(flexbit_ipc[a].ip_src)) &&
-                                              flexbit_ipc[a].src_port == dst_port )
-                                        {
-
-                                            if ( debug->debugflexbit)
-                                                {
-                                                    Sagan_Log(DEBUG, "[%s, line %d] \"unset\" flexbit \"%s\" (direction: \"dst_xbitsrc_p\"). (any -> %s)", __FILE__, __LINE__, flexbit_ipc[a].flexbit_name, ip_dst);
-                                                }
-
-                                            File_Lock(config->shm_flexbit);
-                                            pthread_mutex_lock(&Flexbit_Mutex);
-
-                                            flexbit_ipc[a].flexbit_state = 0;
-
-                                            pthread_mutex_unlock(&Flexbit_Mutex);
-                                            File_Unlock(config->shm_flexbit);
-
-                                            flexbit_unset_match = 1;
-
-                                        }
-
-                                }
-                        }
-
-                    if ( debug->debugflexbit && flexbit_unset_match == 0 )
+                    if ( Key.type == FLEXBIT_KEY_FULL )
                         {
-                            Sagan_Log(DEBUG, "[%s, line %d] No flexbit found to \"unset\" for %s.", __FILE__, __LINE__, rulestruct[rule_position].flexbit_name[i]);
+                            x = IPC_Hash_Lookup( Flexbit_Index, hash, Flexbit_Match, &Key );
+                            m = ( x != -1 && flexbit_ipc[x].flexbit_state == true ) ? x + 1 : 0;
                         }
 
-                } /* if ( rulestruct[rule_position].flexbit_type[i] == 2 ) */
-
-            /*******************
-             *      SET        *
-            *******************/
-
-            else if ( rulestruct[rule_position].flexbit_type[i] == 1 )
-                {
-
-                    for (a = 0; a < counters_ipc->flexbit_count; a++)
+                    else
                         {
-
-                            /* Do we have the flexbit already in memory?  If so,  update the information */
-
-                            if (!strcmp(flexbit_ipc[a].flexbit_name, rulestruct[rule_position].flexbit_name[i]) &&
-                                    !memcmp(flexbit_ipc[a].ip_src, ip_src, sizeof(flexbit_ipc[a].ip_src)) &&
-                                    !memcmp(flexbit_ipc[a].ip_dst, ip_dst, sizeof(flexbit_ipc[a].ip_dst)) &&
-                                    flexbit_ipc[a].src_port == config->sagan_port &&
-                                    flexbit_ipc[a].dst_port == config->sagan_port )
-                                {
-
-
-                                    File_Lock(config->shm_flexbit);
-                                    pthread_mutex_lock(&Flexbit_Mutex);
-
-                                    flexbit_ipc[a].flexbit_date = atol(timet);
-                                    flexbit_ipc[a].flexbit_expire = atol(timet) + rulestruct[rule_position].flexbit_timeout[i];
-                                    flexbit_ipc[a].flexbit_state = true;
-                                    strlcpy(flexbit_ipc[a].syslog_message, syslog_message, sizeof(flexbit_ipc[a].syslog_message));
-                                    strlcpy(flexbit_ipc[a].signature_msg, rulestruct[rule_position].s_msg, sizeof(flexbit_ipc[a].signature_msg));
-                                    flexbit_ipc[a].sid = rulestruct[rule_position].s_sid;
-
-
-                                    if ( debug->debugflexbit)
-                                        {
-
-                                            Sagan_Log(DEBUG,"[%s, line %d] [%d] Updated via \"set\" for flexbit \"%s\". Nex expire time is %d (%d) [ %s:%d -> %s:%d ]", __FILE__, __LINE__, a, rulestruct[rule_position].flexbit_name[i], flexbit_ipc[i].flexbit_expire, rulestruct[rule_position].flexbit_timeout[i], flexbit_ipc[a].ip_src, flexbit_ipc[a].src_port, flexbit_ipc[a].ip_dst, flexbit_ipc[a].dst_port);
-
-                                        }
-
-                                    pthread_mutex_unlock(&Flexbit_Mutex);
-                                    File_Unlock(config->shm_flexbit);
-
-                                    flexbit_match = true;
-                                }
-
+                            x = IPC_Hash_Lookup( Flexbit_Group_Index, hash, Flexbit_Group_Match, &Key );
+                            m = ( x != -1 ) ? Flexbit_Group_IPC[x].head : 0;
                         }
 
-
-                    /* If the flexbit isn't in memory,  store it to be created later */
-
-                    if ( flexbit_match == false )
+                    while ( m != 0 )
                         {
 
-                            flexbit_track = ( _Sagan_Flexbit_Track * ) realloc(flexbit_track, (flexbit_track_count+1) * sizeof(_Sagan_Flexbit_Track));
+                            x = m - 1;
+                            m = ( Key.type == FLEXBIT_KEY_FULL ) ? 0 : flexbit_ipc[x].next[Key.type];
 
-                            if ( flexbit_track == NULL )
+                            if ( debug->debugflexbit)
                                 {
-                                    Sagan_Log(ERROR, "[%s, line %d] Failed to reallocate memory for flexbit_track. Abort!", __FILE__, __LINE__);
+                                    Sagan_Log(DEBUG, "[%s, line %d] \"unset\" flexbit \"%s\" (direction: \"%s\"). (%s -> %s)", __FILE__, __LINE__, flexbit_ipc[x].flexbit_name, Flexbit_Direction[gen->rulestruct[rule_position].flexbit_direction[i]], IP_Text(ip_src), IP_Text(ip_dst));
                                 }
 
-                            memset(&flexbit_track[flexbit_track_count], 0, sizeof(_Sagan_Flexbit_Track));
-
-                            strlcpy(flexbit_track[flexbit_track_count].flexbit_name, rulestruct[rule_position].flexbit_name[i], sizeof(flexbit_track[flexbit_track_count].flexbit_name));
-                            strlcpy(flexbit_ipc[flexbit_track_count].syslog_message, syslog_message, sizeof(flexbit_ipc[flexbit_track_count].syslog_message));
-                            strlcpy(flexbit_ipc[flexbit_track_count].signature_msg, rulestruct[rule_position].s_msg, sizeof(flexbit_ipc[flexbit_track_count].signature_msg));
-                            flexbit_ipc[flexbit_track_count].sid = rulestruct[rule_position].s_sid;
-
-                            flexbit_track[flexbit_track_count].flexbit_timeout = rulestruct[rule_position].flexbit_timeout[i];
-                            flexbit_track[flexbit_track_count].flexbit_srcport = config->sagan_port;
-                            flexbit_track[flexbit_track_count].flexbit_dstport = config->sagan_port;
-                            flexbit_track_count++;
+                            Flexbit_Unlink( x );
+                            flexbit_ipc[x].flexbit_state = false;
 
+                            flexbit_unset_match = true;
                         }
 
-                } /* if flexbit_type == 1 */
-
-            /***************************
-             *      SET_SRCPORT        *
-            ****************************/
-
-            else if ( rulestruct[rule_position].flexbit_type[i] == 5 )
-                {
-
-                    flexbit_match = false;
+                    IPC_Hash_Unlock_Mask( Flexbit_Group_Index, IPC_HASH_ALL_STRIPES );
 
-                    for (a = 0; a < counters_ipc->flexbit_count; a++)
+                    if ( debug->debugflexbit && flexbit_unset_match == false )
                         {
+                            Sagan_Log(DEBUG, "[%s, line %d] No flexbit found to \"unset\" for %s.", __FILE__, __LINE__, gen->rulestruct[rule_position].flexbit_name[i]);
+                        }
 
-                            /* Do we have the flexbit already in memory?  If so,  update the information */
-
-                            if (!strcmp(flexbit_ipc[a].flexbit_name, rulestruct[rule_position].flexbit_name[i]) &&
-                                    !memcmp(flexbit_ipc[a].ip_src, ip_src, sizeof(flexbit_ipc[a].ip_src)) &&
-                                    !memcmp(flexbit_ipc[a].ip_dst, ip_dst, sizeof(flexbit_ipc[a].ip_dst)) &&
-                                    flexbit_ipc[a].src_port == src_port &&
-                                    flexbit_ipc[a].dst_port == config->sagan_port )
-                                {
-
-                                    File_Lock(config->shm_flexbit);
-                                    pthread_mutex_lock(&Flexbit_Mutex);
+                } /* if ( rulestruct[rule_position].flexbit_type[i] == 2 ) */
 
-                                    flexbit_ipc[a].flexbit_date = atol(timet);
-                                    flexbit_ipc[a].flexbit_expire = atol(timet) + rulestruct[rule_position].flexbit_timeout[i];
-                                    flexbit_ipc[a].flexbit_state = true;
-                                    strlcpy(flexbit_ipc[a].syslog_message, syslog_message, sizeof(flexbit_ipc[a].syslog_message));
+            /*************************************************
+             *  SET,  SET_SRCPORT,  SET_DSTPORT,  SET_PORTS  *
+             *************************************************/
 
-                                    if ( debug->debugflexbit)
-                                        {
+            else if ( gen->rulestruct[rule_position].flexbit_type[i] == 1 || gen->rulestruct[rule_position].flexbit_type[i] == 5 ||
+                      gen->rulestruct[rule_position].flexbit_type[i] == 6 || gen->rulestruct[rule_position].flexbit_type[i] == 7 )
+                {
 
-                                            Sagan_Log(DEBUG,"[%s, line %d] [%d] Updated via \"set_srcport\" for flexbit \"%s\". Nex expire time is %d (%d) [ %s:%d -> %s:%d ]", __FILE__, __LINE__, a, rulestruct[rule_position].flexbit_name[i], flexbit_ipc[i].flexbit_expire, rulestruct[rule_position].flexbit_timeout[i], flexbit_ipc[a].ip_src, flexbit_ipc[a].src_port, flexbit_ipc[a].ip_dst, flexbit_ipc[a].dst_port);
+                    /* Ports that aren't tracked are stored as the Sagan port */
 
-                                        }
+                    set_src_port = ( gen->rulestruct[rule_position].flexbit_type[i] == 5 || gen->rulestruct[rule_position].flexbit_type[i] == 7 ) ? src_port : config->sagan_port;
+                    set_dst_port = ( gen->rulestruct[rule_position].flexbit_type[i] == 6 || gen->rulestruct[rule_position].flexbit_type[i] == 7 ) ? dst_port : config->sagan_port;
 
-                                    pthread_mutex_unlock(&Flexbit_Mutex);
-                                    File_Unlock(config->shm_flexbit);
+                    Flexbit_Key_Make( &Key, FLEXBIT_KEY_FULL, gen->rulestruct[rule_position].flexbit_name[i], ip_src->bits, ip_dst->bits, set_src_port, set_dst_port );
 
-                                    flexbit_match = true;
-                                }
+                    hash = Flexbit_Key_Hash( &Key );
+                    mask = IPC_Hash_Stripe_Bit( hash );
 
+                    for ( type = 0; type < FLEXBIT_KEYS; type++ )
+                        {
+                            Flexbit_Key_Make( &Part, type, Key.flexbit_name, Key.ip_src, Key.ip_dst, Key.src_port, Key.dst_port );
+                            mask |= IPC_Hash_Stripe_Bit( Flexbit_Key_Hash( &Part ) );
                         }
 
+                    IPC_Hash_Lock_Mask( Flexbit_Group_Index, mask );
 
-                    /* If the flexbit isn't in memory,  store it to be created later */
+                    /* Do we have the flexbit already in memory?  If so,  update the information */
 
-                    if ( flexbit_match == false )
+                    if ( ( x = IPC_Hash_Lookup( Flexbit_Index, hash, Flexbit_Match, &Key ) ) != -1 )
                         {
 
-                            flexbit_track = ( _Sagan_Flexbit_Track * ) realloc(flexbit_track, (flexbit_track_count+1) * sizeof(_Sagan_Flexbit_Track));
-
-                            if ( flexbit_track == NULL )
+                            if ( debug->debugflexbit)
                                 {
-                                    Sagan_Log(ERROR, "[%s, line %d] Failed to reallocate memory for flexbit_track. Abort!", __FILE__, __LINE__);
+                                    Sagan_Log(DEBUG,"[%s, line %d] [%d] Updated flexbit \"%s\". Next expire time is %" PRIu64 " (%d) [ %s:%d -> %s:%d ]", __FILE__, __LINE__, x, Key.flexbit_name, current_time + gen->rulestruct[rule_position].flexbit_timeout[i], gen->rulestruct[rule_position].flexbit_timeout[i], IP_Text(ip_src), set_src_port, IP_Text(ip_dst), set_dst_port);
                                 }
 
-                            memset(&flexbit_track[flexbit_track_count], 0, sizeof(_Sagan_Flexbit_Track));
-
-                            strlcpy(flexbit_track[flexbit_track_count].flexbit_name, rulestruct[rule_position].flexbit_name[i], sizeof(flexbit_track[flexbit_track_count].flexbit_name));
-                            strlcpy(flexbit_ipc[flexbit_track_count].syslog_message, syslog_message, sizeof(flexbit_ipc[flexbit_track_count].syslog_message));
-                            flexbit_track[flexbit_track_count].flexbit_timeout = rulestruct[rule_position].flexbit_timeout[i];
-                            flexbit_track[flexbit_track_count].flexbit_srcport = src_port;
-                            flexbit_track[flexbit_track_count].flexbit_dstport = config->sagan_port;
-                            flexbit_track_count++;
-
                         }
 
-                } /* if flexbit_type == 5 */
+                    /* If not,  add it.  This reuses an unset or expired flexbit on the way if there is one. */
 
-            /***************************
-             *      SET_DSTPORT        *
-            ****************************/
-
-            else if ( rulestruct[rule_position].flexbit_type[i] == 6 )
-                {
-
-                    flexbit_match = false;
-
-                    for (a = 0; a < counters_ipc->flexbit_count; a++)
+                    else if ( ( x = IPC_Hash_Insert( Flexbit_Index, hash, Flexbit_Expired, NULL ) ) != -1 )
                         {
 
-                            /* Do we have the flexbit already in memory?  If so,  update the information */
+                            strlcpy(flexbit_ipc[x].flexbit_name, Key.flexbit_name, sizeof(flexbit_ipc[x].flexbit_name));
+                            memcpy(flexbit_ipc[x].ip_src, Key.ip_src, sizeof(flexbit_ipc[x].ip_src));
+                            memcpy(flexbit_ipc[x].ip_dst, Key.ip_dst, sizeof(flexbit_ipc[x].ip_dst));
+                            flexbit_ipc[x].src_port = set_src_port;
+                            flexbit_ipc[x].dst_port = set_dst_port;
+                            flexbit_ipc[x].flexbit_state = false;
 
-                            if (!strcmp(flexbit_ipc[a].flexbit_name, rulestruct[rule_position].flexbit_name[i]) &&
-                                    !memcmp(flexbit_ipc[a].ip_src, ip_src, sizeof(flexbit_ipc[a].ip_src)) &&
-                                    !memcmp(flexbit_ipc[a].ip_dst, ip_dst, sizeof(flexbit_ipc[a].ip_dst)) &&
-                                    flexbit_ipc[a].src_port == config->sagan_port &&
-                                    flexbit_ipc[a].dst_port == dst_port )
+                            if ( debug->debugflexbit)
                                 {
-
-                                    File_Lock(config->shm_flexbit);
-                                    pthread_mutex_lock(&Flexbit_Mutex);
-
-                                    flexbit_ipc[a].flexbit_date = atol(timet);
-                                    flexbit_ipc[a].flexbit_expire = atol(timet) + rulestruct[rule_position].flexbit_timeout[i];
-                                    flexbit_ipc[a].flexbit_state = true;
-                                    strlcpy(flexbit_ipc[a].syslog_message, syslog_message, sizeof(flexbit_ipc[a].syslog_message));
-
-                                    if ( debug->debugflexbit)
-                                        {
-
-                                            Sagan_Log(DEBUG,"[%s, line %d] [%d] Updated via \"set_dstport\" for flexbit \"%s\". Nex expire time is %d (%d) [ %s:%d -> %s:%d ]", __FILE__, __LINE__, a, rulestruct[rule_position].flexbit_name[i], flexbit_ipc[i].flexbit_expire, rulestruct[rule_position].flexbit_timeout[i], flexbit_ipc[a].ip_src, flexbit_ipc[a].src_port, flexbit_ipc[a].ip_dst, flexbit_ipc[a].dst_port);
-
-                                        }
-
-                                    pthread_mutex_unlock(&Flexbit_Mutex);
-                                    File_Unlock(config->shm_flexbit);
-
-                                    flexbit_match = true;
+                                    Sagan_Log(DEBUG, "[%s, line %d] [%d] Created flexbit \"%s\" via \"set, set_srcport, set_dstport, or set_ports\" [%s:%d -> %s:%d]", __FILE__, __LINE__, x, Key.flexbit_name, IP_Text(ip_src), set_src_port, IP_Text(ip_dst), set_dst_port);
                                 }
 
                         }
 
-
-                    /* If the flexbit isn't in memory,  store it to be created later */
-
-                    if ( flexbit_match == false )
+                    else
                         {
-
-                            flexbit_track = ( _Sagan_Flexbit_Track * ) realloc(flexbit_track, (flexbit_track_count+1) * sizeof(_Sagan_Flexbit_Track));
-
-                            if ( flexbit_track == NULL )
-                                {
-                                    Sagan_Log(ERROR, "[%s, line %d] Failed to reallocate memory for flexbit_track. Abort!", __FILE__, __LINE__);
-                                }
-
-                            memset(&flexbit_track[flexbit_track_count], 0, sizeof(_Sagan_Flexbit_Track));
-
-                            strlcpy(flexbit_track[flexbit_track_count].flexbit_name, rulestruct[rule_position].flexbit_name[i], sizeof(flexbit_track[flexbit_track_count].flexbit_name));
-                            strlcpy(flexbit_ipc[flexbit_track_count].syslog_message, syslog_message, sizeof(flexbit_ipc[flexbit_track_count].syslog_message));
-                            flexbit_track[flexbit_track_count].flexbit_timeout = rulestruct[rule_position].flexbit_timeout[i];
-                            flexbit_track[flexbit_track_count].flexbit_srcport = config->sagan_port;
-                            flexbit_track[flexbit_track_count].flexbit_dstport = dst_port;
-                            flexbit_track_count++;
-
+                            IPC_Hash_Unlock_Mask( Flexbit_Group_Index, mask );
+                            Sagan_Log(WARN, "[%s, line %d] Flexbit object is full,  cannot set flexbit \"%s\".", __FILE__, __LINE__, Key.flexbit_name);
+                            continue;
                         }
 
-                } /* if flexbit_type == 6 */
-
-            /*************************
-             *      SET_PORTS        *
-            **************************/
+                    flexbit_ipc[x].flexbit_date = current_time;
+                    flexbit_ipc[x].flexbit_expire = current_time + gen->rulestruct[rule_position].flexbit_timeout[i];
+                    flexbit_ipc[x].expire = gen->rulestruct[rule_position].flexbit_timeout[i];
+                    flexbit_ipc[x].sid = gen->rulestruct[rule_position].s_sid;
 
-            else if ( rulestruct[rule_position].flexbit_type[i] == 7 )
-                {
+                    strlcpy(flexbit_ipc[x].syslog_message, syslog_message, sizeof(flexbit_ipc[x].syslog_message));
+                    strlcpy(flexbit_ipc[x].signature_msg, gen->rulestruct[rule_position].s_msg, sizeof(flexbit_ipc[x].signature_msg));
 
-                    flexbit_match = false;
-
-                    for (a = 0; a < counters_ipc->flexbit_count; a++)
+                    if ( flexbit_ipc[x].flexbit_state == false )
                         {
-
-                            /* Do we have the flexbit already in memory?  If so,  update the information */
-
-                            if (!strcmp(flexbit_ipc[a].flexbit_name, rulestruct[rule_position].flexbit_name[i]) &&
-                                    !memcmp(flexbit_ipc[a].ip_src, ip_src, sizeof(flexbit_ipc[a].ip_src)) &&
-                                    !memcmp(flexbit_ipc[a].ip_dst, ip_dst, sizeof(flexbit_ipc[a].ip_dst)) &&
-                                    flexbit_ipc[a].src_port == src_port &&
-                                    flexbit_ipc[a].dst_port == dst_port )
-                                {
-
-                                    File_Lock(config->shm_flexbit);
-                                    pthread_mutex_lock(&Flexbit_Mutex);
-
-                                    flexbit_ipc[a].flexbit_date = atol(timet);
-                                    flexbit_ipc[a].flexbit_expire = atol(timet) + rulestruct[rule_position].flexbit_timeout[i];
-                                    flexbit_ipc[a].flexbit_state = true;
-                                    strlcpy(flexbit_ipc[a].syslog_message, syslog_message, sizeof(flexbit_ipc[a].syslog_message));
-
-                                    if ( debug->debugflexbit)
-                                        {
-
-                                            Sagan_Log(DEBUG,"[%s, line %d] [%d] Updated via \"set_ports\" for flexbit \"%s\". Nex expire time is %d (%d) [ %s:%d -> %s:%d ]", __FILE__, __LINE__, a, rulestruct[rule_position].flexbit_name[i], flexbit_ipc[i].flexbit_expire, rulestruct[rule_position].flexbit_timeout[i], flexbit_ipc[a].ip_src, flexbit_ipc[a].src_port, flexbit_ipc[a].ip_dst, flexbit_ipc[a].dst_port);
-
-                                        }
-
-                                    pthread_mutex_unlock(&Flexbit_Mutex);
-                                    File_Unlock(config->shm_flexbit);
-
-                                    flexbit_match = true;
-                                }
-
+                            Flexbit_Link( x );
+                            flexbit_ipc[x].flexbit_state = true;
                         }
 
+                    IPC_Hash_Unlock_Mask( Flexbit_Group_Index, mask );
 
-                    /* If the flexbit isn't in memory,  store it to be created later */
-
-                    if ( flexbit_match == false )
-                        {
+                    __atomic_store_n(&counters_ipc->flexbit_count, Flexbit_Index->entry_count, __ATOMIC_SEQ_CST);
 
-                            flexbit_track = ( _Sagan_Flexbit_Track * ) realloc(flexbit_track, (flexbit_track_count+1) * sizeof(_Sagan_Flexbit_Track));
+                } /* if flexbit_type == 1, 5, 6 or 7 */
 
-                            if ( flexbit_track == NULL )
-                                {
-                                    Sagan_Log(ERROR, "[%s, line %d] Failed to reallocate memory for flexbit_track. Abort!", __FILE__, __LINE__);
-                                }
+        } /* Out of for i loop */
 
-                            memset(&flexbit_track[flexbit_track_count], 0, sizeof(_Sagan_Flexbit_Track));
+} /* End of Flexbit_Set */
 
-                            strlcpy(flexbit_track[flexbit_track_count].flexbit_name, rulestruct[rule_position].flexbit_name[i], sizeof(flexbit_track[flexbit_track_count].flexbit_name));
-                            strlcpy(flexbit_ipc[flexbit_track_count].syslog_message, syslog_message, sizeof(flexbit_ipc[flexbit_track_count].syslog_message));
-                            strlcpy(flexbit_ipc[flexbit_track_count].signature_msg, rulestruct[rule_position].s_msg, sizeof(flexbit_ipc[flexbit_track_count].signature_msg));
-                            flexbit_ipc[flexbit_track_count].sid = rulestruct[rule_position].s_sid;
+/*****************************************************************************
+ * Flexbit_Cleanup - Find "expired" flexbits and toggle the "state"
+ * to "off".  Flexbit timeouts are in seconds,  so this only sweeps once a
+ * second.  The first caller in a new second sweeps while the rest wait on
+ * the locks,  so nobody sees a flexbit that should have expired.
+ *****************************************************************************/
 
-                            flexbit_track[flexbit_track_count].flexbit_timeout = rulestruct[rule_position].flexbit_timeout[i];
-                            flexbit_track[flexbit_track_count].flexbit_srcport = src_port;
-                            flexbit_track[flexbit_track_count].flexbit_dstport = dst_port;
-                            flexbit_track_count++;
+void Flexbit_Cleanup_MMAP(void)
+{
 
-                        }
+    uint32_t i = 0;
 
-                } /* if flexbit_type == 7 */
+    uint64_t current_time = Return_Epoch();
 
-        } /* Out of for i loop */
+    if ( __atomic_load_n(&Flexbit_Group_Index->swept, __ATOMIC_ACQUIRE) >= current_time )
+        {
+            return;
+        }
 
-    /* Do we have any flexbits in memory that need to be created?  */
+    IPC_Hash_Lock_Mask( Flexbit_Group_Index, IPC_HASH_ALL_STRIPES );
 
-    if ( flexbit_track_count != 0 )
+    if ( Flexbit_Group_Index->swept < current_time )
         {
 
-            for (i = 0; i < flexbit_track_count; i++)
+            for (i = 0; i < Flexbit_Index->entry_count; i++)
                 {
 
-                    if ( Clean_IPC_Object(FLEXBIT) == 0 )
+                    if ( flexbit_ipc[i].flexbit_state == true && current_time >= flexbit_ipc[i].flexbit_expire )
                         {
 
-                            File_Lock(config->shm_flexbit);
-                            pthread_mutex_lock(&Flexbit_Mutex);
-
-                            memcpy(flexbit_ipc[counters_ipc->flexbit_count].ip_src, ip_src, sizeof(flexbit_ipc[counters_ipc->flexbit_count].ip_src));
-                            memcpy(flexbit_ipc[counters_ipc->flexbit_count].ip_dst, ip_dst, sizeof(flexbit_ipc[counters_ipc->flexbit_count].ip_dst));
-
-                            flexbit_ipc[counters_ipc->flexbit_count].src_port = flexbit_track[i].flexbit_srcport;
-                            flexbit_ipc[counters_ipc->flexbit_count].dst_port = flexbit_track[i].flexbit_dstport;
-                            flexbit_ipc[counters_ipc->flexbit_count].flexbit_date = atol(timet);
-                            flexbit_ipc[counters_ipc->flexbit_count].flexbit_expire = atol(timet) + flexbit_track[i].flexbit_timeout;
-                            flexbit_ipc[counters_ipc->flexbit_count].flexbit_state = true;
-                            flexbit_ipc[counters_ipc->flexbit_count].expire = flexbit_track[i].flexbit_timeout;
-
-                            strlcpy(flexbit_ipc[counters_ipc->flexbit_count].flexbit_name, flexbit_track[i].flexbit_name, sizeof(flexbit_ipc[counters_ipc->flexbit_count].flexbit_name));
-                            strlcpy(flexbit_ipc[counters_ipc->flexbit_count].signature_msg, rulestruct[rule_position].s_msg, sizeof(flexbit_ipc[counters_ipc->flexbit_count].signature_msg));
-                            strlcpy(flexbit_ipc[counters_ipc->flexbit_count].syslog_message, syslog_message, sizeof(flexbit_ipc[counters_ipc->flexbit_count].syslog_message));
-                            flexbit_ipc[counters_ipc->flexbit_count].sid = rulestruct[rule_position].s_sid;
-
-
-                            if ( debug->debugflexbit)
+                            if (debug->debugflexbit)
                                 {
-                                    Sagan_Log(DEBUG, "[%s, line %d] [%d] Created flexbit \"%s\" via \"set, set_srcport, set_dstport, or set_ports\" [%s:%d -> %s:%d]", __FILE__, __LINE__, counters_ipc->flexbit_count, flexbit_ipc[counters_ipc->flexbit_count].flexbit_name, ip_src, flexbit_track[i].flexbit_srcport, ip_dst, flexbit_track[i].flexbit_dstport);
+                                    Sagan_Log(DEBUG, "[%s, line %d] Setting flexbit %s to \"expired\" state.", __FILE__, __LINE__, flexbit_ipc[i].flexbit_name);
                                 }
 
-                            File_Lock(config->shm_counters);
-
-                            counters_ipc->flexbit_count++;
-
-                            File_Unlock(config->shm_counters);
-                            File_Unlock(config->shm_flexbit);
-
-                            pthread_mutex_unlock(&Flexbit_Mutex);
-
+                            Flexbit_Unlink( i );
+                            flexbit_ipc[i].flexbit_state = false;
                         }
                 }
-        }
-
-    free(flexbit_track);
-
-} /* End of Xbit_Set */
-
-/*****************************************************************************
- * Xbit_Cleanup - Find "expired" flexbits and toggle the "state"
- * to "off"
- *****************************************************************************/
 
-void Flexbit_Cleanup_MMAP(void)
-{
-
-    int i = 0;
-
-    time_t t;
-    struct tm *now;
-    char  timet[20];
-
-    t = time(NULL);
-    now=localtime(&t);
-    strftime(timet, sizeof(timet), "%s",  now);
-
-    for (i=0; i<counters_ipc->flexbit_count; i++)
-        {
-
-            if (  flexbit_ipc[i].flexbit_state == true && atol(timet) >= flexbit_ipc[i].flexbit_expire )
-                {
-                    if (debug->debugflexbit)
-                        {
-                            Sagan_Log(DEBUG, "[%s, line %d] Setting flexbit %s to \"expired\" state.", __FILE__, __LINE__, flexbit_ipc[i].flexbit_name);
-                        }
-                    flexbit_ipc[i].flexbit_state = false;
-                }
+            __atomic_store_n(&Flexbit_Group_Index->swept, current_time, __ATOMIC_RELEASE);
         }
 
+    IPC_Hash_Unlock_Mask( Flexbit_Group_Index, IPC_HASH_ALL_STRIPES );
+
 }
@@ -24,19 +24,22 @@
 
 #include "sagan-defs.h"
 
-bool Flexbit_Condition_MMAP ( int, char *, char *, int, int );
-void Flexbit_Cleanup_MMAP( void );
-void Flexbit_Set_MMAP(int rule_position, char *ip_src, char *ip_dst, int src_port, int dst_port, char *syslog_message );
-bool Flexbit_Count_MMAP( int rule_position, char *ip_src, char *ip_dst );
+/* Keys each flexbit is indexed by,  besides all of name,  addresses and
+   ports.  See Flexbit_Query() for which directions use which. */
 
-typedef struct _Sagan_Flexbit_Track _Sagan_Flexbit_Track;
-struct _Sagan_Flexbit_Track
-{
-    char	flexbit_name[64];
-    int		flexbit_timeout;
-    int		flexbit_srcport;
-    int		flexbit_dstport;
-};
+#define FLEXBIT_KEY_NAME	0
+#define FLEXBIT_KEY_SRC		1
+#define FLEXBIT_KEY_DST		2
+#define FLEXBIT_KEY_PAIR	3
+#define FLEXBIT_KEY_SRCP	4
+#define FLEXBIT_KEY_DSTP	5
+#define FLEXBIT_KEYS		6
+#define FLEXBIT_KEY_FULL	6		/* The flexbit itself */
+
+bool Flexbit_Condition_MMAP ( int, struct _Sagan_IP *, struct _Sagan_IP *, int, int );
+void Flexbit_Cleanup_MMAP( void );
+void Flexbit_Set_MMAP(int rule_position, struct _Sagan_IP *ip_src, struct _Sagan_IP *ip_dst, int src_port, int dst_port, char *syslog_message );
+bool Flexbit_Count_MMAP( int rule_position, struct _Sagan_IP *ip_src, struct _Sagan_IP *ip_dst );
 
 typedef struct _Sagan_IPC_Flexbit _Sagan_IPC_Flexbit;
 struct _Sagan_IPC_Flexbit
@@ -55,6 +58,37 @@ struct _Sagan_IPC_Flexbit
     uint64_t sid;
     char signature_msg[MAX_SAGAN_MSG];
 
+    /* Groups this flexbit is counted in while set,  and its neighbours in
+       each group's list.  All are entry + 1,  0 for none. */
+
+    uint32_t group[FLEXBIT_KEYS];
+    uint32_t next[FLEXBIT_KEYS];
+    uint32_t prev[FLEXBIT_KEYS];
+
+};
+
+/* A name plus the addresses/ports one kind of key uses.  Unused fields are
+   zero so keys can be hashed and compared whole. */
+
+typedef struct _Flexbit_Key _Flexbit_Key;
+struct _Flexbit_Key
+{
+    uint32_t type;			/* FLEXBIT_KEY_* */
+    char flexbit_name[64];
+    unsigned char ip_src[MAXIPBIT];
+    unsigned char ip_dst[MAXIPBIT];
+    int src_port;
+    int dst_port;
+};
+
+/* Every set flexbit sharing a key,  stored in FLEXBIT_GROUP_IPC_FILE */
+
+typedef struct _Sagan_IPC_Flexbit_Group _Sagan_IPC_Flexbit_Group;
+struct _Sagan_IPC_Flexbit_Group
+{
+    struct _Flexbit_Key key;
+    uint32_t live;			/* Flexbits set */
+    uint32_t head;			/* First one + 1 */
 };
 
 
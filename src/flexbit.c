@@ -42,20 +42,20 @@
 
 struct _SaganConfig *config;
 
-bool Flexbit_Condition(int rule_position, char *ip_src_char, char *ip_dst_char, int src_port, int dst_port )
+bool Flexbit_Condition(int rule_position, struct _Sagan_IP *ip_src, struct _Sagan_IP *ip_dst, int src_port, int dst_port )
 {
-    return(Flexbit_Condition_MMAP(rule_position, ip_src_char, ip_dst_char, src_port, dst_port));
+    return(Flexbit_Condition_MMAP(rule_position, ip_src, ip_dst, src_port, dst_port));
 }
 
 
-bool Flexbit_Count( int rule_position, char *ip_src_char, char *ip_dst_char )
+bool Flexbit_Count( int rule_position, struct _Sagan_IP *ip_src, struct _Sagan_IP *ip_dst )
 {
-    return(Flexbit_Count_MMAP(rule_position, ip_src_char, ip_dst_char));
+    return(Flexbit_Count_MMAP(rule_position, ip_src, ip_dst));
 }
 
-void Flexbit_Set(int rule_position, char *ip_src_char, char *ip_dst_char, int src_port, int dst_port, _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL )
+void Flexbit_Set(int rule_position, struct _Sagan_IP *ip_src, struct _Sagan_IP *ip_dst, int src_port, int dst_port, _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL )
 {
-    Flexbit_Set_MMAP(rule_position, ip_src_char, ip_dst_char, src_port, dst_port, SaganProcSyslog_LOCAL->syslog_message );
+    Flexbit_Set_MMAP(rule_position, ip_src, ip_dst, src_port, dst_port, SaganProcSyslog_LOCAL->syslog_message );
 
 }
 
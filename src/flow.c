@@ -18,7 +18,16 @@
 ** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 */
 
-/* check-flow.c */
+/* flow.c
+ *
+ * "flow_1",  "port_1",  "flow_2" and "port_2" rule options.  When rules are
+ * loaded,  each address/port list is compiled into a group of sorted,
+ * non-overlapping ranges.  Identical lists (most rules use the same
+ * $HOME_NET and $EXTERNAL_NET) share a group.  A group's result is cached
+ * per thread for the current event,  so a group is only searched once per
+ * event for a given address or port.  Check_Flow() is then a lookup of up
+ * to four cached results.
+ */
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"             /* From autoconf */
@@ -29,13 +38,30 @@
 #include <pthread.h>
 #include <errno.h>
 #include <unistd.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
 
 #include "sagan.h"
 #include "sagan-defs.h"
 #include "rules.h"
+#include "rule-table.h"
+#include "rule-generation.h"
+#include "rule-epoch.h"
 #include "sagan-config.h"
+#include "routing.h"
+#include "event-cache.h"
+
+#ifdef HAVE_LIBFASTJSON
+#include "input-json.h"
+#include "message-json-map.h"
+#endif
+
+#include "thread-context.h"
+#include "flow.h"
+
+struct _SaganCounters *counters;
 
-struct _Rule_Struct *rulestruct;
 
 /********************/ /************************/ /*****************/
 /***** flow_type ****/ /******* flow_var *******/ /*** direction ***/
@@ -45,460 +71,518 @@ struct _Rule_Struct *rulestruct;
 /* 3 = match ip     */ /************************/ /*****************/
 /********************/ /************************/ /*****************/
 
-bool Check_Flow( int b, int ip_proto, unsigned char *ip_src_bits, int normalize_src_port, unsigned char *ip_dst_bits, int normalize_dst_port)
+/****************************************************************************
+ * Flow_Address_Compare/Flow_Port_Compare - qsort() by start of range
+ ****************************************************************************/
+
+static int Flow_Address_Compare( const void *a, const void *b )
+{
+    return( memcmp( ((const struct _Flow_Address_Range *)a)->lo, ((const struct _Flow_Address_Range *)b)->lo, MAXIPBIT ) );
+}
+
+static int Flow_Port_Compare( const void *a, const void *b )
 {
 
-    unsigned char *src;
-    unsigned char *dst;
+    const struct _Flow_Port_Range *x = a;
+    const struct _Flow_Port_Range *y = b;
 
-    int port_src;
-    int port_dst;
+    return( x->lo < y->lo ? -1 : x->lo > y->lo );
+}
 
-    unsigned char *ip_src;
-    unsigned char *ip_dst;
+/****************************************************************************
+ * Flow_Address_Merge/Flow_Port_Merge - Sort ranges and merge the ones that
+ * overlap.  Returns the new number of ranges.
+ ****************************************************************************/
 
-    src = ip_src_bits;
-    dst = ip_dst_bits;
+static uint32_t Flow_Address_Merge( struct _Flow_Address_Range *range, uint32_t count )
+{
 
-    unsigned char ip_convert[MAXIPBIT] = { 0 };
+    uint32_t i = 0;
+    uint32_t n = 0;
 
-    if(rulestruct[b].direction == 0 || rulestruct[b].direction == 1)
+    if ( count == 0 )
         {
-            ip_src = src;
-            ip_dst = dst;
-            port_src = normalize_src_port;
-            port_dst = normalize_dst_port;
+            return(0);
         }
-    else
+
+    qsort(range, count, sizeof(struct _Flow_Address_Range), Flow_Address_Compare);
+
+    for ( i = 1; i < count; i++ )
         {
-            ip_src = dst;
-            ip_dst = src;
-            port_src = normalize_dst_port;
-            port_dst = normalize_src_port;
+
+            if ( memcmp(range[i].lo, range[n].hi, MAXIPBIT) <= 0 )
+                {
+
+                    if ( memcmp(range[i].hi, range[n].hi, MAXIPBIT) > 0 )
+                        {
+                            memcpy(range[n].hi, range[i].hi, MAXIPBIT);
+                        }
+
+                }
+            else
+                {
+                    n++;
+                    range[n] = range[i];
+                }
         }
 
+    return(n + 1);
 
-    /*proto*/
+}
+
+static uint32_t Flow_Port_Merge( struct _Flow_Port_Range *range, uint32_t count )
+{
 
-    int c1=0;
+    uint32_t i = 0;
+    uint32_t n = 0;
+
+    if ( count == 0 )
+        {
+            return(0);
+        }
 
-    /*flow 1*/
+    qsort(range, count, sizeof(struct _Flow_Port_Range), Flow_Port_Compare);
 
-    int w=0;
-    int a1=0;
-    int eq1=0;
-    int ne1=0;
-    int eq1_val=0;
-    int ne1_val=0;
-    int f1;
+    for ( i = 1; i < count; i++ )
+        {
 
-    /*port 1*/
+            if ( range[i].lo <= range[n].hi )
+                {
 
-    int b1=0;
-    int u=0;
-    int eq3=0;
-    int ne3=0;
-    int eq3_val=0;
-    int ne3_val=0;
-    int g1;
+                    if ( range[i].hi > range[n].hi )
+                        {
+                            range[n].hi = range[i].hi;
+                        }
 
+                }
+            else
+                {
+                    n++;
+                    range[n] = range[i];
+                }
+        }
 
-    /*flow 2*/
+    return(n + 1);
 
-    int z=0;
-    int a2=0;
-    int eq2=0;
-    int ne2=0;
-    int eq2_val=0;
-    int ne2_val=0;
-    int f2;
+}
 
-    /*port 2*/
+/****************************************************************************
+ * Flow_Address_Search/Flow_Port_Search - Binary search of sorted ranges
+ ****************************************************************************/
 
-    int b2=0;
-    int v=0;
-    int eq4=0;
-    int ne4=0;
-    int eq4_val=0;
-    int ne4_val=0;
-    int g2;
+static bool Flow_Address_Search( struct _Flow_Address_Range *range, uint32_t count, unsigned char *ip )
+{
 
-    int i;
-    int failed=0;
+    uint32_t lo = 0;
+    uint32_t hi = count;
+    uint32_t mid = 0;
 
-    /*Begin ip_proto*/
+    /* Find the number of ranges that start at or before "ip" */
 
-    if(rulestruct[b].ip_proto != 0)
+    while ( lo < hi )
         {
-            if(ip_proto == rulestruct[b].ip_proto)
+
+            mid = ( lo + hi ) / 2;
+
+            if ( memcmp(range[mid].lo, ip, MAXIPBIT) <= 0 )
                 {
-                    c1=1;
+                    lo = mid + 1;
+                }
+            else
+                {
+                    hi = mid;
                 }
-        }
-    else
-        {
-            c1=1;
         }
 
-    if(c1 != 1)
-        {
-            return 0;
-        }
+    return( lo > 0 && memcmp(ip, range[lo - 1].hi, MAXIPBIT) <= 0 );
 
-    /*Begin flow_1*/
+}
 
-    if(rulestruct[b].flow_1_var != 0)
-        {
-            for(i=0; i < rulestruct[b].flow_1_counter; i++)
-                {
-                    w++;
-                    f1 = rulestruct[b].flow_1_type[w];
+static bool Flow_Port_Search( struct _Flow_Port_Range *range, uint32_t count, int port )
+{
 
-                    if(f1 == 0)
-                        {
-                            ne1++;
+    uint32_t lo = 0;
+    uint32_t hi = count;
+    uint32_t mid = 0;
 
-                            if(is_inrange(ip_src, (unsigned char *)&rulestruct[b].flow_1[i].range, 1))
-                                {
-                                    ne1_val++;
-                                }
-                        }
+    while ( lo < hi )
+        {
 
-                    else if(f1 == 1)
+            mid = ( lo + hi ) / 2;
 
-                        {
-                            eq1++;
-                            if(is_inrange(ip_src, (unsigned char *)&rulestruct[b].flow_1[i].range, 1))
-                                {
-                                    eq1_val++;
-                                }
+            if ( range[mid].lo <= port )
+                {
+                    lo = mid + 1;
+                }
+            else
+                {
+                    hi = mid;
+                }
+        }
 
-                        }
+    return( lo > 0 && port <= range[lo - 1].hi );
 
-                    else if(f1 == 2)
-                        {
+}
 
-                            ne1++;
+/****************************************************************************
+ * Flow_Group_ID - Compile a flow_1/flow_2 (FLOW_GROUP_ADDRESS) or
+ * port_1/port_2 (FLOW_GROUP_PORT) list and return its group ID.  "entries"
+ * is the rule's arr_flow_* or arr_port_* array and "type" the matching
+ * 1 based flow_*_type or port_*_type array.
+ ****************************************************************************/
 
-                            memset(ip_convert, 0, MAXIPBIT);
-                            memcpy(ip_convert, ip_src, MAXIPBIT);
+uint32_t Flow_Group_ID( unsigned char kind, void *entries, int *type, int count )
+{
 
-                            if (!memcmp(ip_convert, rulestruct[b].flow_1[i].range.ipbits, MAXIPBIT) )
-                                {
-                                    ne1_val++;
-                                }
-                        }
+    struct _Rule_Generation *gen = Rule_Generation_Current();
 
-                    else if(f1 == 3)
-                        {
+    struct _Flow_Group group;
+    struct _Flow_Address_Range *address = NULL;
+    struct _Flow_Port_Range *port = NULL;
 
-                            eq1++;
+    unsigned char *range = NULL;
+    struct arr_port_1 *port_entry = NULL;
 
-                            memset(ip_convert, 0, MAXIPBIT);
-                            memcpy(ip_convert, ip_src, MAXIPBIT);
+    uint32_t in_count = 0;
+    uint32_t not_count = 0;
+    uint32_t total = 0;
+    uint32_t id = 0;
 
-                            if (!memcmp(ip_convert, rulestruct[b].flow_1[i].range.ipbits, MAXIPBIT))
-                                {
+    bool is_not = false;
+    bool mask_end = false;
+    unsigned char mask = 0;
 
-                                    eq1_val++;
-                                }
-                        }
-                }
-        }
-    else
+    int i = 0;
+    int j = 0;
+
+    if ( count == 0 )
         {
-            a1=1;
+            return(0);
         }
 
-    /* if ne1, did anything match (meaning failed) */
+    memset(&group, 0, sizeof(struct _Flow_Group));
+    group.kind = kind;
+
+    /* "in" entries are built from the front,  "not" entries from the back */
 
-    if(ne1>0)
+    if ( kind == FLOW_GROUP_ADDRESS )
         {
-            if(ne1_val > 0)
+
+            address = malloc(count * sizeof(struct _Flow_Address_Range));
+
+            if ( address == NULL )
                 {
-                    failed++;
+                    Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for _Flow_Address_Range. Abort!", __FILE__, __LINE__);
                 }
+
         }
+    else
+        {
 
-    /* if eq1, did anything not match meaning failed */
+            port = malloc(count * sizeof(struct _Flow_Port_Range));
 
-    if(eq1>0)
-        {
-            if(eq1_val < 1)
+            if ( port == NULL )
                 {
-                    failed++;
+                    Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for _Flow_Port_Range. Abort!", __FILE__, __LINE__);
                 }
-        }
 
-    /* if either failed, we did not match, no need to check the second flow... we already failed! */
+        }
 
-    if(a1 != 1)
+    for ( i = 0; i < count; i++ )
         {
 
-            if(failed > 0)
+            /* 0 = not in group,  1 = in group,  2 = not match,  3 = match */
+
+            is_not = ( type[i + 1] == 0 || type[i + 1] == 2 );
+
+            if ( is_not == false )
                 {
-                    return 0;
+                    group.has_in = true;
                 }
-        }
 
-    /*Begin port_1*/
-
-    if(rulestruct[b].port_1_var != 0)
-        {
-            for(i=0; i < rulestruct[b].port_1_counter; i++)
+            if ( kind == FLOW_GROUP_ADDRESS )
                 {
-                    u++;
-                    g1 = rulestruct[b].port_1_type[u];
 
-                    if(g1 == 0)
-                        {
-                            ne3++;
-                            if(port_src >= rulestruct[b].port_1[i].lo && port_src <= rulestruct[b].port_1[i].hi)
-                                {
-                                    ne3_val++;
-                                }
-                        }
+                    /* ipbits followed by maskbits.  See arr_flow_1 */
+
+                    range = (unsigned char *)entries + ( i * MAXIPBIT * 2 );
 
-                    if(g1 == 1)
+                    struct _Flow_Address_Range *r = is_not ? &address[ count - 1 - not_count ] : &address[ in_count ];
+
+                    if ( type[i + 1] == 0 || type[i + 1] == 1 )
                         {
-                            eq3++;
-                            if(port_src >= rulestruct[b].port_1[i].lo && port_src <= rulestruct[b].port_1[i].hi)
+
+                            /* Like is_inrange(),  the mask ends at the first 0 byte */
+
+                            mask_end = false;
+
+                            for ( j = 0; j < MAXIPBIT; j++ )
                                 {
-                                    eq3_val++;
+
+                                    if ( range[MAXIPBIT + j] == 0x00 )
+                                        {
+                                            mask_end = true;
+                                        }
+
+                                    mask = mask_end ? 0x00 : range[MAXIPBIT + j];
+
+                                    r->lo[j] = range[j] & mask;
+                                    r->hi[j] = range[j] | (unsigned char)~mask;
                                 }
-                        }
 
-                    if(g1 == 2)
+                        }
+                    else
                         {
-                            ne3++;
-                            if(port_src == rulestruct[b].port_1[i].lo)
-                                {
-                                    ne3_val++;
-                                }
+                            memcpy(r->lo, range, MAXIPBIT);
+                            memcpy(r->hi, range, MAXIPBIT);
                         }
 
-                    if(g1 == 3)
+                }
+            else
+                {
+
+                    port_entry = (struct arr_port_1 *)entries + i;
+
+                    struct _Flow_Port_Range *r = is_not ? &port[ count - 1 - not_count ] : &port[ in_count ];
+
+                    r->lo = port_entry->lo;
+                    r->hi = ( type[i + 1] == 0 || type[i + 1] == 1 ) ? port_entry->hi : port_entry->lo;
+
+                    /* A backwards range never matches */
+
+                    if ( r->lo > r->hi )
                         {
-                            eq3++;
-                            if(port_src == rulestruct[b].port_1[i].lo)
-                                {
-                                    eq3_val++;
-                                }
+                            continue;
                         }
+
+                }
+
+            if ( is_not == true )
+                {
+                    not_count++;
+                }
+            else
+                {
+                    in_count++;
                 }
+
+        }
+
+    /* Move the "not" entries down to follow the "in" entries,  then sort and
+       merge each */
+
+    if ( kind == FLOW_GROUP_ADDRESS )
+        {
+            memmove(&address[in_count], &address[count - not_count], not_count * sizeof(struct _Flow_Address_Range));
+            group.in_count = Flow_Address_Merge( address, in_count );
+            memmove(&address[group.in_count], &address[in_count], not_count * sizeof(struct _Flow_Address_Range));
+            group.not_count = Flow_Address_Merge( &address[group.in_count], not_count );
+            group.address = address;
         }
     else
         {
-            b1=1;
+            memmove(&port[in_count], &port[count - not_count], not_count * sizeof(struct _Flow_Port_Range));
+            group.in_count = Flow_Port_Merge( port, in_count );
+            memmove(&port[group.in_count], &port[in_count], not_count * sizeof(struct _Flow_Port_Range));
+            group.not_count = Flow_Port_Merge( &port[group.in_count], not_count );
+            group.port = port;
         }
 
-    /* if ne3, did anything match (meaning failed) */
+    total = group.in_count + group.not_count;
+
+    group.hash = Fnv1a_Hash( &group.kind, sizeof(group.kind), IP_HASH_SEED );
+    group.hash = Fnv1a_Hash( &group.has_in, sizeof(group.has_in), group.hash );
+    group.hash = Fnv1a_Hash( &group.in_count, sizeof(group.in_count), group.hash );
 
-    if(ne3>0)
+    if ( kind == FLOW_GROUP_ADDRESS )
         {
-            if(ne3_val > 0)
-                {
-                    failed++;
-                }
+            group.hash = Fnv1a_Hash( address, total * sizeof(struct _Flow_Address_Range), group.hash );
+        }
+    else
+        {
+            group.hash = Fnv1a_Hash( port, total * sizeof(struct _Flow_Port_Range), group.hash );
         }
 
-    /* if eq3, did anything not match meaning failed */
+    /* Already have it? */
 
-    if(eq3>0)
+    for ( id = 1; id < gen->flowgroup_count; id++ )
         {
-            if(eq3_val < 1)
+
+            if ( gen->flowgroup[id].hash != group.hash || gen->flowgroup[id].kind != kind ||
+                    gen->flowgroup[id].has_in != group.has_in || gen->flowgroup[id].in_count != group.in_count ||
+                    gen->flowgroup[id].not_count != group.not_count )
                 {
-                    failed++;
+                    continue;
                 }
-        }
 
-    /* if either failed, we did not match, no need to check the second flow... we already failed! */
-
-    if(b1 != 1)
-        {
-            if(failed > 0)
+            if ( ( kind == FLOW_GROUP_ADDRESS && !memcmp(gen->flowgroup[id].address, address, total * sizeof(struct _Flow_Address_Range)) ) ||
+                    ( kind == FLOW_GROUP_PORT && !memcmp(gen->flowgroup[id].port, port, total * sizeof(struct _Flow_Port_Range)) ) )
                 {
-                    return 0;
+                    free(address);
+                    free(port);
+                    return(id);
                 }
         }
 
-
-
-    /* Begin flow_2 */
-
-    if(rulestruct[b].flow_2_var != 0)
+    if ( gen->flowgroup_count >= gen->flowgroup_max )
         {
 
-            for(i=0; i < rulestruct[b].flow_2_counter; i++)
-                {
-                    z++;
-                    f2 = rulestruct[b].flow_2_type[z];
+            /* Copied rather than realloc()'ed,  Check_Flow() may be using it
+               (dynamic rules).  See rule-epoch.c */
 
+            Rule_Epoch_Grow(&gen->flowgroup, gen->flowgroup_max * sizeof(struct _Flow_Group), ( gen->flowgroup_max == 0 ? 64 : gen->flowgroup_max * 2 ) * sizeof(struct _Flow_Group));
 
-                    if(f2 == 0)
-                        {
-                            ne2++;
+            gen->flowgroup_max = gen->flowgroup_max == 0 ? 64 : gen->flowgroup_max * 2;
 
-                            if(is_inrange(ip_dst, (unsigned char *)&rulestruct[b].flow_2[i].range, 1))
-                                {
-                                    ne2_val++;
-                                }
-                        }
+        }
 
-                    else if(f2 == 1)
-                        {
-                            eq2++;
+    gen->flowgroup[gen->flowgroup_count] = group;
+    gen->flowgroup_count++;
 
-                            if(is_inrange(ip_dst, (unsigned char *)&rulestruct[b].flow_2[i].range, 1))
-                                {
-                                    eq2_val++;
-                                }
-                        }
+    return(gen->flowgroup_count - 1);
 
-                    else if(f2 == 2)
-                        {
-                            ne2++;
+}
 
-                            memset(ip_convert, 0, MAXIPBIT);
-                            memcpy(ip_convert, ip_dst, MAXIPBIT);
+/****************************************************************************
+ * Flow_Group_Free - Release a retired generation's groups.  See
+ * rule-generation.c
+ ****************************************************************************/
 
-                            if (!memcmp(ip_convert, rulestruct[b].flow_2[i].range.ipbits, MAXIPBIT ))
-                                {
-                                    ne2_val++;
-                                }
-                        }
-                    else if(f2 == 3)
-                        {
-                            eq2++;
+void Flow_Group_Free( struct _Flow_Group *groups, uint32_t count )
+{
 
-                            memset(ip_convert, 0, MAXIPBIT);
-                            memcpy(ip_convert, ip_dst, MAXIPBIT);
+    uint32_t id = 0;
 
-                            if (!memcmp(ip_convert, rulestruct[b].flow_2[i].range.ipbits, MAXIPBIT ))
-                                {
-                                    eq2_val++;
-                                }
-                        }
-                }
-        }
-    else
+    if ( groups == NULL )
         {
-            a2=1;
+            return;
         }
 
-    /* if ne2, did anything match (meaning failed) */
-
-    if(ne2>0)
+    for ( id = 1; id < count; id++ )
         {
-            if(ne2_val > 0)
-                {
-                    failed++;
-                }
+            free(groups[id].address);
+            free(groups[id].port);
         }
 
-    /* if eq2, did anything not match meaning failed */
+    free(groups);
 
-    if(eq2>0)
+}
+
+/****************************************************************************
+ * Flow_Group_Match - Does an address or port match a group?  "side" is 0
+ * for flow_1/port_1 and 1 for flow_2/port_2.
+ ****************************************************************************/
+
+static bool Flow_Group_Match( struct _Sagan_Thread_Context *ThreadContext, uint32_t id, int side, unsigned char *ip, int port )
+{
+
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
+
+    struct _Flow_Group *group = NULL;
+    struct _Flow_Group_Cache *cache = NULL;
+    struct _Flow_Group_Cache *tmp = NULL;
+
+    bool result = false;
+
+    if ( id == 0 )
         {
-            if(eq2_val < 1)
-                {
-                    failed++;
-                }
+            return(true);
         }
 
-    /* if either failed, we did not match, leave */
-
-    if(a2 != 1)
+    if ( id * 2 + 1 >= ThreadContext->flow_cache_size )
         {
-            if(failed > 0)
+
+            tmp = realloc(ThreadContext->flow_cache, gen->flowgroup_count * 2 * sizeof(struct _Flow_Group_Cache));
+
+            if ( tmp == NULL )
                 {
-                    return 0;
+                    Sagan_Log(ERROR, "[%s, line %d] Failed to reallocate memory for _Flow_Group_Cache. Abort!", __FILE__, __LINE__);
                 }
+
+            memset(&tmp[ThreadContext->flow_cache_size], 0, ( gen->flowgroup_count * 2 - ThreadContext->flow_cache_size ) * sizeof(struct _Flow_Group_Cache));
+
+            ThreadContext->flow_cache = tmp;
+            ThreadContext->flow_cache_size = gen->flowgroup_count * 2;
+
+            __atomic_add_fetch(&counters->hot_path_alloc, 1, __ATOMIC_SEQ_CST);
+
         }
 
-    /*Begin port_2*/
+    group = &gen->flowgroup[id];
+    cache = &ThreadContext->flow_cache[ id * 2 + side ];
 
-    if(rulestruct[b].port_2_var != 0)
+    if ( group->kind == FLOW_GROUP_ADDRESS )
         {
-            for(i=0; i < rulestruct[b].port_2_counter; i++)
-                {
-                    v++;
-                    g2 = rulestruct[b].port_2_type[v];
 
-                    if(g2 == 0)
-                        {
-                            ne4++;
-                            if(port_dst >= rulestruct[b].port_2[i].lo && port_dst <= rulestruct[b].port_2[i].hi)
-                                {
-                                    ne4_val++;
-                                }
-                        }
+            if ( cache->event == ThreadContext->header_event && !memcmp(cache->ip, ip, MAXIPBIT) )
+                {
+                    return(cache->result);
+                }
 
-                    if(g2 == 1)
-                        {
-                            eq4++;
-                            if(port_dst >= rulestruct[b].port_2[i].lo && port_dst <= rulestruct[b].port_2[i].hi)
-                                {
-                                    eq4_val++;
-                                }
-                        }
+            result = Flow_Address_Search( &group->address[group->in_count], group->not_count, ip ) == false &&
+                     ( group->has_in == false || Flow_Address_Search( group->address, group->in_count, ip ) == true );
 
-                    if(g2 == 2)
-                        {
-                            ne4++;
-                            if(port_dst == rulestruct[b].port_2[i].lo)
-                                {
-                                    ne4_val++;
-                                }
-                        }
+            memcpy(cache->ip, ip, MAXIPBIT);
 
-                    if(g2 == 3)
-                        {
-                            eq4++;
-                            if(port_dst == rulestruct[b].port_2[i].lo)
-                                {
-                                    eq4_val++;
-                                }
-                        }
-                }
         }
     else
         {
-            b2=1;
-        }
-
-    /* if ne4, did anything match (meaning failed) */
 
-    if(ne4>0)
-        {
-            if(ne4_val > 0)
+            if ( cache->event == ThreadContext->header_event && cache->port == port )
                 {
-                    failed++;
+                    return(cache->result);
                 }
+
+            result = Flow_Port_Search( &group->port[group->in_count], group->not_count, port ) == false &&
+                     ( group->has_in == false || Flow_Port_Search( group->port, group->in_count, port ) == true );
+
+            cache->port = port;
+
         }
 
-    /* if eq4, did anything not match meaning failed */
+    cache->event = ThreadContext->header_event;
+    cache->result = result;
+
+    return(result);
+
+}
+
+/****************************************************************************
+ * Check_Flow - Does the event match the rule's protocol,  flow and ports?
+ ****************************************************************************/
 
-    if(eq4>0)
+bool Check_Flow( int b, int ip_proto, unsigned char *ip_src_bits, int normalize_src_port, unsigned char *ip_dst_bits, int normalize_dst_port)
+{
+
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
+
+    struct _Sagan_Thread_Context *ThreadContext = Thread_Context();
+
+    unsigned char *ip_src = ip_src_bits;
+    unsigned char *ip_dst = ip_dst_bits;
+
+    int port_src = normalize_src_port;
+    int port_dst = normalize_dst_port;
+
+    if ( gen->ruletable->ip_proto[b] != 0 && ip_proto != gen->ruletable->ip_proto[b] )
         {
-            if(eq4_val < 1)
-                {
-                    failed++;
-                }
+            return(false);
         }
 
-    /* if either failed, we did not match, no need to check the second flow... we already failed! */
+    /* "<-" swaps source and destination */
 
-    if(b2 != 1)
+    if ( gen->ruletable->direction[b] == 2 )
         {
-            if(failed > 0)
-                {
-                    return 0;
-                }
+            ip_src = ip_dst_bits;
+            ip_dst = ip_src_bits;
+            port_src = normalize_dst_port;
+            port_dst = normalize_src_port;
         }
 
-    /* If we made it to this point we have a match */
+    return( Flow_Group_Match( ThreadContext, gen->ruletable->flow_1_group[b], 0, ip_src, 0 ) == true &&
+            Flow_Group_Match( ThreadContext, gen->ruletable->port_1_group[b], 0, NULL, port_src ) == true &&
+            Flow_Group_Match( ThreadContext, gen->ruletable->flow_2_group[b], 1, ip_dst, 0 ) == true &&
+            Flow_Group_Match( ThreadContext, gen->ruletable->port_2_group[b], 1, NULL, port_dst ) == true );
 
-    return 1;
+}
 
-} /*We are done*/
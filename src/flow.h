@@ -22,4 +22,60 @@
 #include "config.h"             /* From autoconf */
 #endif
 
+/* flow_1/flow_2 (addresses) and port_1/port_2 are compiled into shared
+   groups when rules are loaded.  Rules with the same $HOME_NET,  etc share
+   one group.  Group ID 0 means "any". */
+
+#define FLOW_GROUP_ADDRESS		1
+#define FLOW_GROUP_PORT			2
+
+typedef struct _Flow_Address_Range _Flow_Address_Range;
+struct _Flow_Address_Range
+{
+    unsigned char lo[MAXIPBIT];
+    unsigned char hi[MAXIPBIT];
+};
+
+typedef struct _Flow_Port_Range _Flow_Port_Range;
+struct _Flow_Port_Range
+{
+    int lo;
+    int hi;
+};
+
+/* Sorted,  non-overlapping ranges.  An event matches the group if it is in
+   none of the "not" ranges and,  if the group has any "in" entries,  in one
+   of the "in" ranges */
+
+typedef struct _Flow_Group _Flow_Group;
+struct _Flow_Group
+{
+
+    unsigned char kind;				/* FLOW_GROUP_ADDRESS or FLOW_GROUP_PORT */
+    uint32_t hash;
+
+    bool has_in;				/* Group has "in" entries */
+    uint32_t in_count;
+    uint32_t not_count;
+
+    struct _Flow_Address_Range *address;	/* in_count "in" ranges,  then not_count "not" ranges */
+    struct _Flow_Port_Range *port;
+
+};
+
+/* Per thread cache of group results.  Two entries per group,  one for each
+   side of a flow (flow_1/port_1 and flow_2/port_2) */
+
+typedef struct _Flow_Group_Cache _Flow_Group_Cache;
+struct _Flow_Group_Cache
+{
+    uint32_t event;
+    bool result;
+    int port;
+    unsigned char ip[MAXIPBIT];
+};
+
+uint32_t Flow_Group_ID( unsigned char kind, void *entries, int *type, int count );
+void Flow_Group_Free( struct _Flow_Group *groups, uint32_t count );
+
 bool Check_Flow( int b, int ip_porto, unsigned char *ip_src_bits, int normalize_src_port, unsigned char *ip_dst_bits, int normalize_dst_port);
@@ -36,15 +36,17 @@
 #include "sagan.h"
 #include "sagan-defs.h"
 #include "gen-msg.h"
+#include "rule-generation.h"
 
 struct _SaganCounters *counters;
-struct _Sagan_Processor_Generator *generator;
 struct _SaganConfig *config;
 struct _SaganDebug *debug;
 
 void Load_Gen_Map( const char *genmap )
 {
 
+    struct _Rule_Generation *gen = Rule_Generation_Current();
+
     FILE *genmapfile;
     char genbuf[1024];
 
@@ -56,7 +58,7 @@ void Load_Gen_Map( const char *genmap )
 
     Sagan_Log(NORMAL, "Loading gen-msg.map file. [%s]", genmap);
 
-    __atomic_store_n (&counters->genmapcount, 0, __ATOMIC_SEQ_CST);
+    __atomic_store_n (&gen->genmapcount, 0, __ATOMIC_SEQ_CST);
 
     if (( genmapfile = fopen(genmap, "r" )) == NULL )
         {
@@ -75,14 +77,14 @@ void Load_Gen_Map( const char *genmap )
 
             /* Allocate memory for references,  not comments */
 
-            generator = (_Sagan_Processor_Generator *) realloc(generator, (counters->genmapcount+1) * sizeof(_Sagan_Processor_Generator));
+            gen->generator = (_Sagan_Processor_Generator *) realloc(gen->generator, (gen->genmapcount+1) * sizeof(_Sagan_Processor_Generator));
 
-            if ( generator == NULL )
+            if ( gen->generator == NULL )
                 {
                     Sagan_Log(ERROR, "[%s, line %d] Failed to reallocate memory for generator. Abort!", __FILE__, __LINE__);
                 }
 
-            memset(&generator[counters->genmapcount], 0, sizeof(_Sagan_Processor_Generator));
+            memset(&gen->generator[gen->genmapcount], 0, sizeof(_Sagan_Processor_Generator));
 
             gen1 = strtok_r(genbuf, "|", &saveptr);
 
@@ -111,16 +113,16 @@ void Load_Gen_Map( const char *genmap )
 
             Remove_Return(gen3);
 
-            generator[counters->genmapcount].generatorid=atoi(gen1);
-            generator[counters->genmapcount].alertid=atoi(gen2);
-            strlcpy(generator[counters->genmapcount].generator_msg, gen3, sizeof(generator[counters->genmapcount].generator_msg));
+            gen->generator[gen->genmapcount].generatorid=atoi(gen1);
+            gen->generator[gen->genmapcount].alertid=atoi(gen2);
+            strlcpy(gen->generator[gen->genmapcount].generator_msg, gen3, sizeof(gen->generator[gen->genmapcount].generator_msg));
 
-            __atomic_add_fetch(&counters->genmapcount, 1, __ATOMIC_SEQ_CST);
+            __atomic_add_fetch(&gen->genmapcount, 1, __ATOMIC_SEQ_CST);
 
         }
 
     fclose(genmapfile);
-    Sagan_Log(NORMAL, "%d generators loaded.", counters->genmapcount);
+    Sagan_Log(NORMAL, "%d generators loaded.", gen->genmapcount);
 }
 
 
@@ -132,14 +134,16 @@ void Load_Gen_Map( const char *genmap )
 void Generator_Lookup(int processor_id, int alert_id, char *str, size_t size)
 {
 
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
+
     int z=0;
     char *msg=NULL;
 
-    for (z=0; z<counters->genmapcount; z++)
+    for (z=0; z<gen->genmapcount; z++)
         {
-            if ( generator[z].generatorid == processor_id && generator[z].alertid == alert_id)
+            if ( gen->generator[z].generatorid == processor_id && gen->generator[z].alertid == alert_id)
                 {
-                    msg=generator[z].generator_msg;
+                    msg=gen->generator[z].generator_msg;
                     break;
                 }
         }
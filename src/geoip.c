@@ -46,11 +46,11 @@
 #include "sagan.h"
 #include "sagan-defs.h"
 #include "rules.h"
+#include "rule-generation.h"
 #include "geoip.h"
 #include "sagan-config.h"
 
 struct _SaganConfig *config;
-struct _Rule_Struct *rulestruct;
 struct _SaganDebug *debug;
 struct _SaganCounters *counters;
 struct _Sagan_GeoIP_Skip *GeoIP_Skip;
@@ -90,10 +90,11 @@ void Open_GeoIP2_Database( void )
  * it is in/out of HOME_COUNTRY
  ****************************************************************************/
 
-int GeoIP2_Lookup_Country( char *ipaddr, int rule_position )
+int GeoIP2_Lookup_Country( struct _Sagan_IP *ipaddr, int rule_position )
 {
 
-    int gai_error;
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
+
     int mmdb_error;
     int res;
 
@@ -103,17 +104,17 @@ int GeoIP2_Lookup_Country( char *ipaddr, int rule_position )
     char country[2];
     char tmp[1024];
 
-    unsigned char ip_convert[MAXIPBIT] = { 0 };
+    struct sockaddr_storage sa;
+    struct sockaddr_in *sa4 = (struct sockaddr_in *)&sa;
+    struct sockaddr_in6 *sa6 = (struct sockaddr_in6 *)&sa;
 
     int i = 0;
 
-    IP2Bit(ipaddr, ip_convert);
-
-    if ( is_notroutable(ip_convert) )
+    if ( is_notroutable(ipaddr->bits) )
         {
             if (debug->debuggeoip2)
                 {
-                    Sagan_Log(DEBUG, "[%s, line %d] IP address %s is not routable. Skipping GeoIP lookup.", __FILE__, __LINE__, ipaddr);
+                    Sagan_Log(DEBUG, "[%s, line %d] IP address %s is not routable. Skipping GeoIP lookup.", __FILE__, __LINE__, IP_Text(ipaddr));
                 }
 
             return(GEOIP_SKIP);
@@ -122,12 +123,12 @@ int GeoIP2_Lookup_Country( char *ipaddr, int rule_position )
     for ( i = 0; i < counters->geoip_skip_count; i++ )
         {
 
-            if ( is_inrange(ip_convert, (unsigned char *)&GeoIP_Skip[i].range, 1) )
+            if ( is_inrange(ipaddr->bits, (unsigned char *)&GeoIP_Skip[i].range, 1) )
                 {
 
                     if (debug->debuggeoip2)
                         {
-                            Sagan_Log(DEBUG, "[%s, line %d] IP address %s is in GeoIP 'skip_networks'. Skipping lookup.", __FILE__, __LINE__, ipaddr);
+                            Sagan_Log(DEBUG, "[%s, line %d] IP address %s is in GeoIP 'skip_networks'. Skipping lookup.", __FILE__, __LINE__, IP_Text(ipaddr));
                         }
 
                     return(GEOIP_SKIP);
@@ -135,7 +136,23 @@ int GeoIP2_Lookup_Country( char *ipaddr, int rule_position )
 
         }
 
-    MMDB_lookup_result_s result = MMDB_lookup_string(&config->geoip2, ipaddr, &gai_error, &mmdb_error);
+    /* Hand libmaxminddb the binary address.  MMDB_lookup_string() would
+       run it back through getaddrinfo() */
+
+    memset(&sa, 0, sizeof(sa));
+
+    if ( ipaddr->family == IPv6 )
+        {
+            sa6->sin6_family = AF_INET6;
+            memcpy(&sa6->sin6_addr, ipaddr->bits, sizeof(sa6->sin6_addr));
+        }
+    else
+        {
+            sa4->sin_family = AF_INET;
+            memcpy(&sa4->sin_addr, ipaddr->bits, sizeof(sa4->sin_addr));
+        }
+
+    MMDB_lookup_result_s result = MMDB_lookup_sockaddr(&config->geoip2, (struct sockaddr *)&sa, &mmdb_error);
     MMDB_entry_data_s entry_data;
 
     res = MMDB_get_value(&result.entry, &entry_data, "country", "iso_code", NULL);
@@ -145,7 +162,7 @@ int GeoIP2_Lookup_Country( char *ipaddr, int rule_position )
     if (res != MMDB_SUCCESS)
         {
 
-            Sagan_Log(WARN, "Country code MMDB_get_value failure (%s) for %s.", MMDB_strerror(res), ipaddr);
+            Sagan_Log(WARN, "Country code MMDB_get_value failure (%s) for %s.", MMDB_strerror(res), IP_Text(ipaddr));
 
             __atomic_add_fetch(&counters->geoip2_error, 1, __ATOMIC_SEQ_CST);
 
@@ -158,19 +175,19 @@ int GeoIP2_Lookup_Country( char *ipaddr, int rule_position )
 
             if ( debug->debuggeoip2 )
                 {
-                    Sagan_Log(DEBUG, "Country code for %s not found in GeoIP DB", ipaddr);
+                    Sagan_Log(DEBUG, "Country code for %s not found in GeoIP DB", IP_Text(ipaddr));
                 }
 
             return(GEOIP_SKIP);
         }
 
     strlcpy(country, entry_data.utf8_string, 3);
-    strlcpy(tmp, rulestruct[rule_position].geoip2_country_codes, sizeof(tmp));
+    strlcpy(tmp, gen->rulestruct[rule_position].geoip2_country_codes, sizeof(tmp));
 
     if (debug->debuggeoip2)
         {
-            Sagan_Log(DEBUG, "GeoIP Lookup IP  : %s", ipaddr);
-            Sagan_Log(DEBUG, "Country Codes    : |%s|", rulestruct[rule_position].geoip2_country_codes);
+            Sagan_Log(DEBUG, "GeoIP Lookup IP  : %s", IP_Text(ipaddr));
+            Sagan_Log(DEBUG, "Country Codes    : |%s|", gen->rulestruct[rule_position].geoip2_country_codes);
             Sagan_Log(DEBUG, "Found in GeoIP DB: %s", country);
         }
 
@@ -35,6 +35,11 @@
 #include "version.h"
 #include "input-pipe.h"
 #include "debug.h"
+#include "routing.h"
+#include "event-cache.h"
+#include "input-json.h"
+#include "message-json-map.h"
+#include "thread-context.h"
 
 struct _SaganCounters *counters;
 struct _SaganConfig *config;
@@ -42,13 +47,6 @@ struct _SaganDebug *debug;
 
 struct _Syslog_JSON_Map *Syslog_JSON_Map;
 
-typedef struct _JSON_Key_String _JSON_Key_String;
-struct _JSON_Key_String
-{
-    char key[JSON_MAX_KEY_SIZE];
-    char json[JSON_MAX_VALUE_SIZE];
-};
-
 
 void SyslogInput_JSON( char *syslog_string, struct _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL )
 {
@@ -71,21 +69,12 @@ void SyslogInput_JSON( char *syslog_string, struct _Sagan_Proc_Syslog *SaganProc
     const char *val_str = NULL;
     struct json_object *val;
 
-    struct _JSON_Key_String *JSON_Key_String;
-    JSON_Key_String = malloc(sizeof(_JSON_Key_String) * JSON_MAX_NEST );
+    /* Per-thread,  see thread-context.c */
 
-    if ( JSON_Key_String == NULL )
-        {
-            Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for _JSON_Key_String", __FILE__, __LINE__);
-        }
+    struct _Sagan_Thread_Context *ThreadContext = Thread_Context();
 
-    struct _JSON_Key_String *JSON_Key_String_J;
-    JSON_Key_String_J = malloc(sizeof(_JSON_Key_String) * JSON_MAX_NEST );
-
-    if ( JSON_Key_String_J == NULL )
-        {
-            Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for _JSON_Key_String_J", __FILE__, __LINE__);
-        }
+    struct _JSON_Key_String *JSON_Key_String = ThreadContext->JSON_Key_String;
+    struct _JSON_Key_String *JSON_Key_String_J = ThreadContext->JSON_Key_String_J;
 
     memset(SaganProcSyslog_LOCAL, 0, sizeof(_Sagan_Proc_Syslog));
 
@@ -18,6 +18,13 @@
 ** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 */
 
+typedef struct _JSON_Key_String _JSON_Key_String;
+struct _JSON_Key_String
+{
+    char key[JSON_MAX_KEY_SIZE];
+    char json[JSON_MAX_VALUE_SIZE];
+};
+
 void SyslogInput_JSON( char *syslog_string, struct _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL );
 
 
@@ -61,7 +61,7 @@ void SyslogInput_Pipe( char *syslog_string, struct _Sagan_Proc_Syslog *SaganProc
     if ( config->syslog_src_lookup && ptr != NULL )
         {
 
-            if ( !Is_IP(ptr, IPv4) || !Is_IP(ptr, IPv6) )   	/* Is inbound a valid IP? */
+            if ( IP_Parse(ptr, NULL) == 0 )   	/* Is inbound a valid IP? */
                 {
                     dns_flag = false;
 
@@ -122,7 +122,7 @@ void SyslogInput_Pipe( char *syslog_string, struct _Sagan_Proc_Syslog *SaganProc
             /* We check to see if values from our FIFO are valid.  If we aren't doing DNS related
             * stuff (above),  we start basic check with the SaganProcSyslog_LOCAL->syslog_host */
 
-            if ( ptr == NULL || !Is_IP(ptr, IPv4) || !Is_IP(ptr, IPv6) )
+            if ( ptr == NULL || IP_Parse(ptr, NULL) == 0 )
                 {
                     strlcpy(SaganProcSyslog_LOCAL->syslog_host, config->sagan_host, sizeof(SaganProcSyslog_LOCAL->syslog_host));
 
@@ -0,0 +1,365 @@
+/*
+** Copyright (C) 2009-2020 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2020 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* ipc-hash.c
+ *
+ * Open addressing index for the mmap() IPC objects.  The index lives in the
+ * same file as the entries it points to,  so every Sagan process sharing
+ * the file shares the index.  The slots are split into stripes,  each with
+ * its own process shared lock.  A key always probes within the stripe its
+ * hash picks,  so holding that stripe's lock is enough to look up,  add or
+ * update it.  Different rules and sources rarely share a stripe and don't
+ * wait on each other.
+ *
+ * Slots are never emptied.  An entry that has expired is reused in place
+ * by the next key that probes past it,  which keeps every probe chain
+ * intact without tombstones.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "sagan.h"
+#include "sagan-defs.h"
+#include "ipc-hash.h"
+
+/****************************************************************************
+ * IPC_Hash_Align - Round "size" up to IPC_HASH_ALIGN
+ ****************************************************************************/
+
+static size_t IPC_Hash_Align( size_t size )
+{
+    return( ( size + IPC_HASH_ALIGN - 1 ) & ~( (size_t)IPC_HASH_ALIGN - 1 ) );
+}
+
+/****************************************************************************
+ * IPC_Hash_Stripe_Slots - Slots per stripe for "max_entries" entries
+ ****************************************************************************/
+
+static uint32_t IPC_Hash_Stripe_Slots( uint32_t max_entries )
+{
+
+    uint64_t want = ( (uint64_t)max_entries * IPC_HASH_SLOTS + IPC_HASH_STRIPES - 1 ) / IPC_HASH_STRIPES;
+    uint32_t slots = IPC_HASH_MIN_SLOTS;
+
+    while ( slots < want )
+        {
+            slots <<= 1;
+        }
+
+    return(slots);
+}
+
+/****************************************************************************
+ * IPC_Hash_Slot_Bytes - Size of the slot array
+ ****************************************************************************/
+
+static size_t IPC_Hash_Slot_Bytes( uint32_t stripe_slots )
+{
+    return( IPC_Hash_Align( (size_t)IPC_HASH_STRIPES * stripe_slots * sizeof(struct _IPC_Hash_Slot) ) );
+}
+
+/****************************************************************************
+ * IPC_Hash_Stripe - First slot of the stripe "hash" belongs to
+ ****************************************************************************/
+
+static inline struct _IPC_Hash_Slot *IPC_Hash_Stripe( struct _IPC_Hash *Index, uint64_t hash )
+{
+
+    struct _IPC_Hash_Slot *Slot = (struct _IPC_Hash_Slot *)( (char *)Index + IPC_Hash_Align( sizeof(struct _IPC_Hash) ) );
+
+    return( Slot + (size_t)( ( hash >> 32 ) & ( IPC_HASH_STRIPES - 1 ) ) * Index->stripe_slots );
+}
+
+/****************************************************************************
+ * IPC_Hash_Size - Size of the mmap() file holding the index and
+ * "max_entries" entries
+ ****************************************************************************/
+
+size_t IPC_Hash_Size( uint32_t max_entries, size_t entry_size )
+{
+    return( IPC_Hash_Align( sizeof(struct _IPC_Hash) ) +
+            IPC_Hash_Slot_Bytes( IPC_Hash_Stripe_Slots( max_entries ) ) +
+            (size_t)max_entries * entry_size );
+}
+
+/****************************************************************************
+ * IPC_Hash_Map - Size and map an IPC object.  A new object gets its
+ * index and locks set up.  "entries" is pointed at the entry array.
+ ****************************************************************************/
+
+struct _IPC_Hash *IPC_Hash_Map( int fd, const char *name, uint32_t max_entries, size_t entry_size, bool new_object, void **entries )
+{
+
+    struct _IPC_Hash *Index = NULL;
+    pthread_mutexattr_t attr;
+
+    size_t size = IPC_Hash_Size( max_entries, entry_size );
+    uint32_t stripe_slots = IPC_Hash_Stripe_Slots( max_entries );
+    uint32_t i = 0;
+
+    if ( ftruncate(fd, size) != 0 )
+        {
+            Sagan_Log(ERROR, "[%s, line %d] Failed to ftruncate %s. [%s]", __FILE__, __LINE__, name, strerror(errno));
+        }
+
+    if (( Index = mmap(0, size, (PROT_READ | PROT_WRITE), MAP_SHARED, fd, 0)) == MAP_FAILED )
+        {
+            Sagan_Log(ERROR, "[%s, line %d] Error allocating memory for %s object! [%s]", __FILE__, __LINE__, name, strerror(errno));
+        }
+
+    /* A zero header is a file that was created but never set up */
+
+    if ( new_object == true || Index->max_entries == 0 )
+        {
+
+            memset(Index, 0, IPC_Hash_Align( sizeof(struct _IPC_Hash) ) + IPC_Hash_Slot_Bytes( stripe_slots ));
+
+            Index->max_entries = max_entries;
+            Index->entry_size = entry_size;
+            Index->stripe_slots = stripe_slots;
+
+            /* Robust,  so a Sagan process that dies holding a stripe
+               doesn't hang every other process using the object */
+
+            pthread_mutexattr_init(&attr);
+            pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+            pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+
+            for ( i = 0; i < IPC_HASH_STRIPES; i++ )
+                {
+                    if ( pthread_mutex_init(&Index->lock[i], &attr) != 0 )
+                        {
+                            Sagan_Log(ERROR, "[%s, line %d] Cannot create %s lock. [%s]", __FILE__, __LINE__, name, strerror(errno));
+                        }
+                }
+
+            pthread_mutexattr_destroy(&attr);
+
+        }
+
+    else if ( Index->max_entries != max_entries || Index->entry_size != entry_size )
+        {
+            Sagan_Log(ERROR, "[%s, line %d] %s was created for %u entries of %u bytes,  not %u of %zu. Remove your mmap files and restart!", __FILE__, __LINE__, name, Index->max_entries, Index->entry_size, max_entries, entry_size);
+        }
+
+    *entries = (char *)Index + IPC_Hash_Align( sizeof(struct _IPC_Hash) ) + IPC_Hash_Slot_Bytes( stripe_slots );
+
+    return(Index);
+}
+
+/****************************************************************************
+ * IPC_Hash_Lock_Stripe - Lock one stripe
+ ****************************************************************************/
+
+static void IPC_Hash_Lock_Stripe( struct _IPC_Hash *Index, uint32_t stripe )
+{
+
+    /* The last owner died holding the lock.  At worst it left one entry
+       half updated,  which the counts and times can live with */
+
+    if ( pthread_mutex_lock(&Index->lock[stripe]) == EOWNERDEAD )
+        {
+            pthread_mutex_consistent(&Index->lock[stripe]);
+        }
+}
+
+/****************************************************************************
+ * IPC_Hash_Lock - Lock the stripe "hash" belongs to.  Returns the stripe
+ * for IPC_Hash_Unlock().
+ ****************************************************************************/
+
+uint32_t IPC_Hash_Lock( struct _IPC_Hash *Index, uint64_t hash )
+{
+
+    uint32_t stripe = ( hash >> 32 ) & ( IPC_HASH_STRIPES - 1 );
+
+    IPC_Hash_Lock_Stripe( Index, stripe );
+
+    return(stripe);
+}
+
+/****************************************************************************
+ * IPC_Hash_Unlock - Release a stripe from IPC_Hash_Lock()
+ ****************************************************************************/
+
+void IPC_Hash_Unlock( struct _IPC_Hash *Index, uint32_t stripe )
+{
+    pthread_mutex_unlock(&Index->lock[stripe]);
+}
+
+/****************************************************************************
+ * IPC_Hash_Stripe_Bit - The bit for "hash"'s stripe in an
+ * IPC_Hash_Lock_Mask() mask
+ ****************************************************************************/
+
+uint64_t IPC_Hash_Stripe_Bit( uint64_t hash )
+{
+    return( 1ULL << ( ( hash >> 32 ) & ( IPC_HASH_STRIPES - 1 ) ) );
+}
+
+/****************************************************************************
+ * IPC_Hash_Lock_Mask - Lock several stripes at once,  for updates that
+ * touch more than one key.  Stripes are always taken lowest first so two
+ * callers can't deadlock.
+ ****************************************************************************/
+
+void IPC_Hash_Lock_Mask( struct _IPC_Hash *Index, uint64_t mask )
+{
+
+    uint32_t stripe = 0;
+
+    for ( stripe = 0; stripe < IPC_HASH_STRIPES; stripe++ )
+        {
+            if ( mask & ( 1ULL << stripe ) )
+                {
+                    IPC_Hash_Lock_Stripe( Index, stripe );
+                }
+        }
+}
+
+/****************************************************************************
+ * IPC_Hash_Unlock_Mask - Release the stripes from IPC_Hash_Lock_Mask()
+ ****************************************************************************/
+
+void IPC_Hash_Unlock_Mask( struct _IPC_Hash *Index, uint64_t mask )
+{
+
+    uint32_t stripe = 0;
+
+    for ( stripe = 0; stripe < IPC_HASH_STRIPES; stripe++ )
+        {
+            if ( mask & ( 1ULL << stripe ) )
+                {
+                    pthread_mutex_unlock(&Index->lock[stripe]);
+                }
+        }
+}
+
+/****************************************************************************
+ * IPC_Hash_Lookup - Find the entry for "hash".  "match" confirms the
+ * entry really is the caller's key.  Returns -1 if it isn't there.  The
+ * stripe must be locked unless "match" copes with the entry being
+ * rewritten under it (see Xbit_Read() in xbit-mmap.c).
+ ****************************************************************************/
+
+int32_t IPC_Hash_Lookup( struct _IPC_Hash *Index, uint64_t hash, IPC_Hash_Func match, void *arg )
+{
+
+    struct _IPC_Hash_Slot *Slot = IPC_Hash_Stripe( Index, hash );
+    uint32_t mask = Index->stripe_slots - 1;
+    uint32_t i = hash & mask;
+    uint32_t n = 0;
+    uint32_t entry = 0;
+
+    /* A slot's entry is stored last with release,  so a lookup that isn't
+       holding the lock never sees a filled slot without its hash */
+
+    for ( n = 0; n < Index->stripe_slots; n++, i = ( i + 1 ) & mask )
+        {
+
+            if ( ( entry = __atomic_load_n(&Slot[i].entry, __ATOMIC_ACQUIRE) ) == 0 )
+                {
+                    return(-1);
+                }
+
+            if ( __atomic_load_n(&Slot[i].hash, __ATOMIC_RELAXED) == hash && match( entry - 1, arg ) == true )
+                {
+                    return( entry - 1 );
+                }
+        }
+
+    return(-1);
+}
+
+/****************************************************************************
+ * IPC_Hash_Entry_New - Hand out an entry that has never been used
+ ****************************************************************************/
+
+static int32_t IPC_Hash_Entry_New( struct _IPC_Hash *Index )
+{
+
+    uint32_t count = __atomic_load_n(&Index->entry_count, __ATOMIC_SEQ_CST);
+
+    do
+        {
+            if ( count >= Index->max_entries )
+                {
+                    return(-1);
+                }
+        }
+    while ( !__atomic_compare_exchange_n(&Index->entry_count, &count, count + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST) );
+
+    return(count);
+}
+
+/****************************************************************************
+ * IPC_Hash_Insert - Add "hash" to the index.  The first entry on its probe
+ * chain that "expired" says is stale gets reused,  otherwise the chain is
+ * extended with an unused entry.  Returns the entry for the caller to fill
+ * in,  or -1 if the object is full.  The stripe must be locked and the key
+ * must not already be in the index.
+ ****************************************************************************/
+
+int32_t IPC_Hash_Insert( struct _IPC_Hash *Index, uint64_t hash, IPC_Hash_Func expired, void *arg )
+{
+
+    struct _IPC_Hash_Slot *Slot = IPC_Hash_Stripe( Index, hash );
+    uint32_t mask = Index->stripe_slots - 1;
+    uint32_t i = hash & mask;
+    uint32_t n = 0;
+    int32_t entry = 0;
+
+    for ( n = 0; n < Index->stripe_slots; n++, i = ( i + 1 ) & mask )
+        {
+
+            if ( Slot[i].entry == 0 )
+                {
+
+                    if ( ( entry = IPC_Hash_Entry_New( Index ) ) == -1 )
+                        {
+                            return(-1);
+                        }
+
+                    __atomic_store_n(&Slot[i].hash, hash, __ATOMIC_RELAXED);
+                    __atomic_store_n(&Slot[i].entry, entry + 1, __ATOMIC_RELEASE);
+                    return(entry);
+                }
+
+            if ( expired( Slot[i].entry - 1, arg ) == true )
+                {
+                    __atomic_store_n(&Slot[i].hash, hash, __ATOMIC_RELAXED);
+                    return( Slot[i].entry - 1 );
+                }
+        }
+
+    return(-1);
+}
+
@@ -0,0 +1,71 @@
+/*
+** Copyright (C) 2009-2020 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2020 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+/* Requires pthread.h to be included first */
+
+#define IPC_HASH_STRIPES	64		/* Locks per index,  power of two up to 64 */
+#define IPC_HASH_SLOTS		2		/* Index slots per entry */
+#define IPC_HASH_MIN_SLOTS	8		/* Smallest stripe */
+#define IPC_HASH_ALIGN		64
+#define IPC_HASH_ALL_STRIPES	0xffffffffffffffffULL	/* IPC_Hash_Lock_Mask() */
+
+typedef struct _IPC_Hash_Slot _IPC_Hash_Slot;
+struct _IPC_Hash_Slot
+{
+
+    uint64_t hash;
+    uint32_t entry;				/* Entry + 1,  0 is an empty slot */
+    uint32_t pad;
+
+};
+
+/* Laid out at the start of the mmap() file,  followed by the slots and
+   then the entries themselves */
+
+typedef struct _IPC_Hash _IPC_Hash;
+struct _IPC_Hash
+{
+
+    uint32_t max_entries;
+    uint32_t entry_size;
+    uint32_t stripe_slots;			/* Slots per stripe,  power of two */
+    uint32_t entry_count;			/* Entries handed out so far */
+    uint64_t swept;				/* Owner's last expire sweep */
+
+    pthread_mutex_t lock[IPC_HASH_STRIPES];
+
+};
+
+typedef bool (*IPC_Hash_Func)( uint32_t entry, void *arg );
+
+size_t IPC_Hash_Size( uint32_t max_entries, size_t entry_size );
+struct _IPC_Hash *IPC_Hash_Map( int fd, const char *name, uint32_t max_entries, size_t entry_size, bool new_object, void **entries );
+uint32_t IPC_Hash_Lock( struct _IPC_Hash *Index, uint64_t hash );
+void IPC_Hash_Unlock( struct _IPC_Hash *Index, uint32_t stripe );
+uint64_t IPC_Hash_Stripe_Bit( uint64_t hash );
+void IPC_Hash_Lock_Mask( struct _IPC_Hash *Index, uint64_t mask );
+void IPC_Hash_Unlock_Mask( struct _IPC_Hash *Index, uint64_t mask );
+int32_t IPC_Hash_Lookup( struct _IPC_Hash *Index, uint64_t hash, IPC_Hash_Func match, void *arg );
+int32_t IPC_Hash_Insert( struct _IPC_Hash *Index, uint64_t hash, IPC_Hash_Func expired, void *arg );
+
@@ -32,7 +32,6 @@
 #endif
 
 void IPC_Init(void);
-bool Clean_IPC_Object( int );
 void IPC_Check_Object(char *, bool, char *);
 
 
@@ -32,87 +32,86 @@
 #include "sagan.h"
 #include "sagan-defs.h"
 #include "rules.h"
+#include "rule-generation.h"
 #include "json-content.h"
+#include "json-index.h"
 #include "search-type.h"
 
 #include "parsers/parsers.h"
 
-struct _Rule_Struct *rulestruct;
 
 bool JSON_Content(int rule_position, _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL)
 {
 
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
+
     int i=0;
     int a=0;
 
-    for (i=0; i < rulestruct[rule_position].json_content_count; i++)
+    for (i=0; i < gen->rulestruct[rule_position].json_content_count; i++)
         {
 
-            for (a=0; a < SaganProcSyslog_LOCAL->json_count; a++)
+            /* Search for the "key" specified in json_content */
+
+            for (a = JSON_Index_Find( SaganProcSyslog_LOCAL, gen->rulestruct[rule_position].json_content_key[i], gen->rulestruct[rule_position].json_content_key_hash[i] ); a != -1; a = JSON_Index_Next( SaganProcSyslog_LOCAL, a ))
                 {
 
-                    /* Search for the "key" specified in json_content */
+                    /* Key was found,  is this a "nocase" rule or is it case sensitive */
 
-                    if ( !strcmp(SaganProcSyslog_LOCAL->json_key[a], rulestruct[rule_position].json_content_key[i] ) )
+                    if ( gen->rulestruct[rule_position].json_content_case[i] == true )
                         {
 
-                            /* Key was found,  is this a "nocase" rule or is it case sensitive */
+                            /* Is this a json_content or json_content:! */
 
-                            if ( rulestruct[rule_position].json_content_case[i] == true )
+                            if ( gen->rulestruct[rule_position].json_content_not[i] == false )
                                 {
 
-                                    /* Is this a json_content or json_content:! */
-
-                                    if ( rulestruct[rule_position].json_content_not[i] == false )
+                                    if ( Search_Nocase(SaganProcSyslog_LOCAL->json_value[a], gen->rulestruct[rule_position].json_content_content[i], false, gen->rulestruct[rule_position].json_content_strstr[i] ) == false  )
                                         {
 
-                                            if ( Search_Nocase(SaganProcSyslog_LOCAL->json_value[a], rulestruct[rule_position].json_content_content[i], false, rulestruct[rule_position].json_content_strstr[i] ) == false  )
-                                                {
+                                            return(false);
 
-                                                    return(false);
+                                        }
 
-                                                }
 
 
+                                }
+                            else
+                                {
 
-                                        }
-                                    else
+                                    if ( Search_Nocase(SaganProcSyslog_LOCAL->json_value[a], gen->rulestruct[rule_position].json_content_content[i], false, gen->rulestruct[rule_position].json_content_strstr[i] ) == true )
                                         {
-
-                                            if ( Search_Nocase(SaganProcSyslog_LOCAL->json_value[a], rulestruct[rule_position].json_content_content[i], false, rulestruct[rule_position].json_content_strstr[i] ) == true )
-                                                {
-                                                    return(false);
-                                                }
-
-
+                                            return(false);
                                         }
 
+
                                 }
-                            else
-                                {
 
-                                    /* Case sensitive */
+                        }
+                    else
+                        {
 
-                                    if ( rulestruct[rule_position].json_content_not[i] == false )
-                                        {
+                            /* Case sensitive */
 
-                                            if ( Search_Case(SaganProcSyslog_LOCAL->json_value[a], rulestruct[rule_position].json_content_content[i], rulestruct[rule_position].json_content_strstr[i]) ==  false )
-                                                {
-                                                    return(false);
-                                                }
+                            if ( gen->rulestruct[rule_position].json_content_not[i] == false )
+                                {
 
-                                        }
-                                    else
+                                    if ( Search_Case(SaganProcSyslog_LOCAL->json_value[a], gen->rulestruct[rule_position].json_content_content[i], gen->rulestruct[rule_position].json_content_strstr[i]) ==  false )
                                         {
+                                            return(false);
+                                        }
 
-                                            if ( Search_Case(SaganProcSyslog_LOCAL->json_value[a], rulestruct[rule_position].json_content_content[i], rulestruct[rule_position].json_content_strstr[i]) == true )
-                                                {
-                                                    return(false);
-                                                }
+                                }
+                            else
+                                {
 
+                                    if ( Search_Case(SaganProcSyslog_LOCAL->json_value[a], gen->rulestruct[rule_position].json_content_content[i], gen->rulestruct[rule_position].json_content_strstr[i]) == true )
+                                        {
+                                            return(false);
                                         }
 
                                 }
+
                         }
                 }
         }
@@ -39,6 +39,7 @@
 #include "sagan.h"
 #include "references.h"
 #include "rules.h"
+#include "rule-generation.h"
 #include "util-base64.h"
 #include "util-time.h"
 #include "sagan-config.h"
@@ -46,7 +47,6 @@
 
 struct _SaganConfig *config;
 struct _SaganDebug *debug;
-struct _Rule_Struct *rulestruct;
 
 /*****************************************************************************
  * Format_JSON_Alert_EVE - Sends only alerts out to eve file in JSON
@@ -55,6 +55,8 @@ struct _Rule_Struct *rulestruct;
 void Format_JSON_Alert_EVE( _Sagan_Event *Event, char *str, size_t size )
 {
 
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
+
     struct json_object *jobj;
     struct json_object *jobj_alert;
 
@@ -228,11 +230,11 @@ void Format_JSON_Alert_EVE( _Sagan_Event *Event, char *str, size_t size )
 
 #endif
 
-    if ( rulestruct[Event->found].metadata_json[0] != '\0' )
+    if ( gen->rulestruct[Event->found].metadata_json[0] != '\0' )
         {
 
             str[ strlen(str) - 2 ] = '\0';
-            snprintf(tmp_data, sizeof(tmp_data), ", \"metadata\": %s }",  rulestruct[Event->found].metadata_json);
+            snprintf(tmp_data, sizeof(tmp_data), ", \"metadata\": %s }",  gen->rulestruct[Event->found].metadata_json);
             strlcat(str, tmp_data, size);
 
         }
@@ -0,0 +1,169 @@
+/*
+** Copyright (C) 2009-2020 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2020 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* json-index.c
+ *
+ * json_content,  json_pcre and json_meta_content used to strcmp() each of
+ * their keys against every decoded key of the event.  The first time a
+ * rule asks for a key,  the event's keys are put in a small open addressing
+ * hash table (json_index).  Positions that share a key are chained through
+ * json_next.  Rule keys are hashed once at load time by JSON_Index_Compile().
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "sagan.h"
+#include "sagan-defs.h"
+#include "rules.h"
+#include "rule-generation.h"
+#include "rule-arena.h"
+#include "json-index.h"
+
+
+/****************************************************************************
+ * JSON_Index_Hash_Keys - Hash "count" rule keys into the arena
+ ****************************************************************************/
+
+static uint32_t *JSON_Index_Hash_Keys( char (*key)[128], int count )
+{
+
+    uint32_t *hash = NULL;
+    int i = 0;
+
+    if ( count == 0 )
+        {
+            return(NULL);
+        }
+
+    hash = Rule_Arena_Alloc( count * sizeof(uint32_t) );
+
+    for ( i = 0; i < count; i++ )
+        {
+            hash[i] = Fnv1a_Hash( key[i], strlen(key[i]), IP_HASH_SEED );
+        }
+
+    return(hash);
+
+}
+
+/****************************************************************************
+ * JSON_Index_Compile - Hash a rule's json_content,  json_pcre and
+ * json_meta_content keys.  Called once the rule is in the arena.
+ ****************************************************************************/
+
+void JSON_Index_Compile( int rule_number )
+{
+
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
+
+    gen->rulestruct[rule_number].json_content_key_hash = JSON_Index_Hash_Keys( gen->rulestruct[rule_number].json_content_key, gen->rulestruct[rule_number].json_content_count );
+    gen->rulestruct[rule_number].json_pcre_key_hash = JSON_Index_Hash_Keys( gen->rulestruct[rule_number].json_pcre_key, gen->rulestruct[rule_number].json_pcre_count );
+    gen->rulestruct[rule_number].json_meta_content_key_hash = JSON_Index_Hash_Keys( gen->rulestruct[rule_number].json_meta_content_key, gen->rulestruct[rule_number].json_meta_content_count );
+
+}
+
+/****************************************************************************
+ * JSON_Index_Build - Index the event's decoded keys.  Value lengths are
+ * kept as well so they are only strlen()'ed once.
+ ****************************************************************************/
+
+static void JSON_Index_Build( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL )
+{
+
+    uint32_t hash = 0;
+    uint32_t slot = 0;
+    int head = 0;
+    int a = 0;
+
+    memset(SaganProcSyslog_LOCAL->json_index, 0, sizeof(SaganProcSyslog_LOCAL->json_index));
+
+    for ( a = 0; a < SaganProcSyslog_LOCAL->json_count; a++ )
+        {
+
+            hash = Fnv1a_Hash( SaganProcSyslog_LOCAL->json_key[a], strlen(SaganProcSyslog_LOCAL->json_key[a]), IP_HASH_SEED );
+
+            SaganProcSyslog_LOCAL->json_key_hash[a] = hash;
+            SaganProcSyslog_LOCAL->json_value_len[a] = strlen(SaganProcSyslog_LOCAL->json_value[a]);
+            SaganProcSyslog_LOCAL->json_next[a] = 0;
+
+            for ( slot = hash & ( JSON_INDEX_SIZE - 1 ); SaganProcSyslog_LOCAL->json_index[slot] != 0; slot = ( slot + 1 ) & ( JSON_INDEX_SIZE - 1 ) )
+                {
+
+                    head = SaganProcSyslog_LOCAL->json_index[slot] - 1;
+
+                    /* Same key seen before.  Chain it */
+
+                    if ( SaganProcSyslog_LOCAL->json_key_hash[head] == hash &&
+                            !strcmp(SaganProcSyslog_LOCAL->json_key[head], SaganProcSyslog_LOCAL->json_key[a]) )
+                        {
+                            SaganProcSyslog_LOCAL->json_next[a] = head + 1;
+                            break;
+                        }
+                }
+
+            SaganProcSyslog_LOCAL->json_index[slot] = a + 1;
+        }
+
+    SaganProcSyslog_LOCAL->json_index_done = true;
+
+}
+
+/****************************************************************************
+ * JSON_Index_Find - First position in the event with "key" (which hashes
+ * to "hash"),  or -1.  Use JSON_Index_Next() for the rest.
+ ****************************************************************************/
+
+int JSON_Index_Find( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, const char *key, uint32_t hash )
+{
+
+    uint32_t slot = 0;
+    int a = 0;
+
+    if ( SaganProcSyslog_LOCAL->json_count == 0 )
+        {
+            return(-1);
+        }
+
+    if ( SaganProcSyslog_LOCAL->json_index_done == false )
+        {
+            JSON_Index_Build( SaganProcSyslog_LOCAL );
+        }
+
+    for ( slot = hash & ( JSON_INDEX_SIZE - 1 ); SaganProcSyslog_LOCAL->json_index[slot] != 0; slot = ( slot + 1 ) & ( JSON_INDEX_SIZE - 1 ) )
+        {
+
+            a = SaganProcSyslog_LOCAL->json_index[slot] - 1;
+
+            if ( SaganProcSyslog_LOCAL->json_key_hash[a] == hash && !strcmp(SaganProcSyslog_LOCAL->json_key[a], key) )
+                {
+                    return(a);
+                }
+        }
+
+    return(-1);
+
+}
+
@@ -23,51 +23,50 @@
 #include "sagan.h"
 #include "sagan-defs.h"
 #include "rules.h"
+#include "rule-generation.h"
 #include "json-meta-content.h"
+#include "json-index.h"
 #include "search-type.h"
 
 #include "parsers/parsers.h"
 
-struct _Rule_Struct *rulestruct;
 
 bool JSON_Meta_Content(int rule_position, _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL)
 {
 
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
+
     int i=0;
     int a=0;
 
     int rc=0;
     int match = 0;
 
-    for (i=0; i < rulestruct[rule_position].json_meta_content_count; i++)
+    for (i=0; i < gen->rulestruct[rule_position].json_meta_content_count; i++)
         {
 
-            for (a=0; a < SaganProcSyslog_LOCAL->json_count; a++)
-                {
-
-                    /* Locate the key (if it's avaliable */
+            /* Locate the key (if it's avaliable */
 
-                    if ( !strcmp(SaganProcSyslog_LOCAL->json_key[a], rulestruct[rule_position].json_meta_content_key[i] ) )
-                        {
+            for (a = JSON_Index_Find( SaganProcSyslog_LOCAL, gen->rulestruct[rule_position].json_meta_content_key[i], gen->rulestruct[rule_position].json_meta_content_key_hash[i] ); a != -1; a = JSON_Index_Next( SaganProcSyslog_LOCAL, a ))
+                {
 
-                            /* Key found, test for json_meta_content */
+                    /* Key found, test for json_meta_content */
 
-                            rc = JSON_Meta_Content_Search(rule_position, SaganProcSyslog_LOCAL->json_value[a], i );
+                    rc = JSON_Meta_Content_Search(rule_position, SaganProcSyslog_LOCAL->json_value[a], i );
 
 
-                            /* Got hit */
+                    /* Got hit */
 
-                            if ( rc == true )
-                                {
-                                    match++;
-                                }
+                    if ( rc == true )
+                        {
+                            match++;
                         }
                 }
         }
 
     /* Does the number of json_meta_contents match what we expect? */
 
-    if ( match == rulestruct[rule_position].json_meta_content_count )
+    if ( match == gen->rulestruct[rule_position].json_meta_content_count )
         {
             return(true);
         }
@@ -84,20 +83,22 @@ bool JSON_Meta_Content(int rule_position, _Sagan_Proc_Syslog *SaganProcSyslog_LO
 bool JSON_Meta_Content_Search(int rule_position, const char *json_string, int i )
 {
 
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
+
     int z = 0;
 
-    if ( rulestruct[rule_position].json_meta_content_not[i] == false )
+    if ( gen->rulestruct[rule_position].json_meta_content_not[i] == false )
         {
 
             /* Standard "json_meta_content" (without !) */
 
-            for ( z = 0; z < rulestruct[rule_position].json_meta_content_containers[i].json_meta_counter; z++ )
+            for ( z = 0; z < gen->rulestruct[rule_position].json_meta_content_containers[i].json_meta_counter; z++ )
                 {
 
-                    if ( rulestruct[rule_position].json_meta_content_case[i] == true )
+                    if ( gen->rulestruct[rule_position].json_meta_content_case[i] == true )
                         {
 
-                            if ( Search_Nocase(json_string, rulestruct[rule_position].json_meta_content_containers[i].json_meta_content_converted[z], false,  rulestruct[rule_position].json_meta_strstr[i] ) )
+                            if ( Search_Nocase(json_string, gen->rulestruct[rule_position].json_meta_content_containers[i].json_meta_content_converted[z], false,  gen->rulestruct[rule_position].json_meta_strstr[i] ) )
                                 {
                                     return(true);
                                 }
@@ -105,7 +106,7 @@ bool JSON_Meta_Content_Search(int rule_position, const char *json_string, int i
                     else
                         {
 
-                            if ( Search_Case(json_string, rulestruct[rule_position].json_meta_content_containers[i].json_meta_content_converted[z], rulestruct[rule_position].json_meta_strstr[i] ) )
+                            if ( Search_Case(json_string, gen->rulestruct[rule_position].json_meta_content_containers[i].json_meta_content_converted[z], gen->rulestruct[rule_position].json_meta_strstr[i] ) )
                                 {
                                     return(true);
                                 }
@@ -120,15 +121,15 @@ bool JSON_Meta_Content_Search(int rule_position, const char *json_string, int i
 
         {
 
-            for ( z = 0; z < rulestruct[rule_position].json_meta_content_containers[i].json_meta_counter; z++ )
+            for ( z = 0; z < gen->rulestruct[rule_position].json_meta_content_containers[i].json_meta_counter; z++ )
                 {
 
                     /* "json_meta_content:!" */
 
-                    if ( rulestruct[rule_position].json_meta_content_case[i] == true )
+                    if ( gen->rulestruct[rule_position].json_meta_content_case[i] == true )
                         {
 
-                            if ( Search_Nocase(json_string, rulestruct[rule_position].json_meta_content_containers[i].json_meta_content_converted[z], false,  rulestruct[rule_position].json_meta_strstr[i] ) )
+                            if ( Search_Nocase(json_string, gen->rulestruct[rule_position].json_meta_content_containers[i].json_meta_content_converted[z], false,  gen->rulestruct[rule_position].json_meta_strstr[i] ) )
                                 {
                                     return(false);
                                 }
@@ -136,7 +137,7 @@ bool JSON_Meta_Content_Search(int rule_position, const char *json_string, int i
                     else
                         {
 
-                            if ( Search_Case(json_string, rulestruct[rule_position].json_meta_content_containers[i].json_meta_content_converted[z], rulestruct[rule_position].json_meta_strstr[i] ) )
+                            if ( Search_Case(json_string, gen->rulestruct[rule_position].json_meta_content_containers[i].json_meta_content_converted[z], gen->rulestruct[rule_position].json_meta_strstr[i] ) )
                                 {
                                     return(false);
                                 }
@@ -31,38 +31,38 @@
 #include "sagan.h"
 #include "sagan-defs.h"
 #include "rules.h"
+#include "rule-generation.h"
 #include "json-content.h"
 
+#include "json-index.h"
+
 #include "parsers/parsers.h"
 
-struct _Rule_Struct *rulestruct;
 
 bool JSON_Pcre(int rule_position, _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL)
 {
 
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
+
     int i=0;
     int a=0;
     int rc=0;
 
     int ovector[PCRE_OVECCOUNT];
 
-    for (i=0; i < rulestruct[rule_position].json_pcre_count; i++)
+    for (i=0; i < gen->rulestruct[rule_position].json_pcre_count; i++)
         {
 
-            for (a=0; a < SaganProcSyslog_LOCAL->json_count; a++)
+            for (a = JSON_Index_Find( SaganProcSyslog_LOCAL, gen->rulestruct[rule_position].json_pcre_key[i], gen->rulestruct[rule_position].json_pcre_key_hash[i] ); a != -1; a = JSON_Index_Next( SaganProcSyslog_LOCAL, a ))
                 {
 
-                    if ( !strcmp(SaganProcSyslog_LOCAL->json_key[a], rulestruct[rule_position].json_pcre_key[i] ) )
-                        {
+                    rc = pcre_exec( gen->rulestruct[rule_position].json_re_pcre[i], gen->rulestruct[rule_position].json_pcre_extra[i], SaganProcSyslog_LOCAL->json_value[a], (int)SaganProcSyslog_LOCAL->json_value_len[a], 0, 0, ovector, PCRE_OVECCOUNT);
 
-                            rc = pcre_exec( rulestruct[rule_position].json_re_pcre[i], rulestruct[rule_position].json_pcre_extra[i], SaganProcSyslog_LOCAL->json_value[a], (int)strlen(SaganProcSyslog_LOCAL->json_value[a]), 0, 0, ovector, PCRE_OVECCOUNT);
+                    /* If it's _not_ a match, no need to test other conditions */
 
-                            /* If it's _not_ a match, no need to test other conditions */
-
-                            if ( rc < 0 )
-                                {
-                                    return(false);
-                                }
+                    if ( rc < 0 )
+                        {
+                            return(false);
                         }
                 }
         }
@@ -41,6 +41,10 @@ libfastjson is required for Sagan to function!
 #include "version.h"
 #include "debug.h"
 #include "message-json-map.h"
+#include "routing.h"
+#include "event-cache.h"
+#include "input-json.h"
+#include "thread-context.h"
 
 #include "parsers/parsers.h"
 
@@ -369,15 +373,9 @@ void Load_Message_JSON_Map ( const char *json_map )
 void Parse_JSON_Message ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL )
 {
 
-    struct _JSON_Message_Map_Found *JSON_Message_Map_Found = NULL;
-    JSON_Message_Map_Found = malloc(sizeof(struct _JSON_Message_Map_Found) * JSON_MAX_NEST);
+    /* Per-thread,  see thread-context.c */
 
-    if ( JSON_Message_Map_Found == NULL )
-        {
-            Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for JSON_Message_Map_Found. Abort!", __FILE__, __LINE__);
-        }
-
-    memset(JSON_Message_Map_Found, 0, sizeof(_JSON_Message_Map_Found) * JSON_MAX_NEST);
+    struct _JSON_Message_Map_Found *JSON_Message_Map_Found = Thread_Context()->JSON_Message_Map_Found;
 
     uint16_t i=0;
     uint16_t a=0;
@@ -401,6 +399,32 @@ void Parse_JSON_Message ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL )
     char json_str[JSON_MAX_NEST][JSON_MAX_SIZE];  // = { { 0 } };
     char tmp_message[MAX_SYSLOGMSG] = { 0 };
 
+    /* Only the entries a map can write to are reset,  and only the first
+       byte of each string.  This is much cheaper than clearing the whole
+       array for every log line */
+
+    for ( i = 0; i < counters->json_message_map && i < JSON_MAX_NEST; i++ )
+        {
+            JSON_Message_Map_Found[i].program[0] = '\0';
+            JSON_Message_Map_Found[i].message[0] = '\0';
+            JSON_Message_Map_Found[i].src_ip[0] = '\0';
+            JSON_Message_Map_Found[i].dst_ip[0] = '\0';
+            JSON_Message_Map_Found[i].src_port[0] = '\0';
+            JSON_Message_Map_Found[i].dst_port[0] = '\0';
+            JSON_Message_Map_Found[i].proto[0] = '\0';
+            JSON_Message_Map_Found[i].flow_id = 0;
+            JSON_Message_Map_Found[i].event_id[0] = '\0';
+            JSON_Message_Map_Found[i].md5[0] = '\0';
+            JSON_Message_Map_Found[i].sha1[0] = '\0';
+            JSON_Message_Map_Found[i].sha256[0] = '\0';
+            JSON_Message_Map_Found[i].filename[0] = '\0';
+            JSON_Message_Map_Found[i].hostname[0] = '\0';
+            JSON_Message_Map_Found[i].url[0] = '\0';
+            JSON_Message_Map_Found[i].ja3[0] = '\0';
+        }
+
+    i = 0;
+
     strlcpy(json_str[0], SaganProcSyslog_LOCAL->syslog_message, sizeof(json_str[0]));
     json_obj = json_tokener_parse(SaganProcSyslog_LOCAL->syslog_message);
 
@@ -415,7 +439,6 @@ void Parse_JSON_Message ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL )
                 }
 
             json_object_put(json_obj);
-            free(JSON_Message_Map_Found);
             __atomic_add_fetch(&counters->malformed_json_mp_count, 1, __ATOMIC_SEQ_CST);
             return;
         }
@@ -875,8 +898,6 @@ void Parse_JSON_Message ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL )
 
         }
 
-    free(JSON_Message_Map_Found);
-
 }
 
 #endif
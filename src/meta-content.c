@@ -42,13 +42,15 @@
 #include "sagan-defs.h"
 #include "meta-content.h"
 #include "rules.h"
+#include "rule-generation.h"
 #include "parsers/parsers.h"
 
-struct _Rule_Struct *rulestruct;
 
 bool Meta_Content(int rule_position, const char *syslog_message)
 {
 
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
+
     int z=0;
     int meta_alter_num=0;
     int match=0;
@@ -57,20 +59,20 @@ bool Meta_Content(int rule_position, const char *syslog_message)
 
     bool rc = 0;
 
-    for (z=0; z<rulestruct[rule_position].meta_content_count; z++)
+    for (z=0; z<gen->rulestruct[rule_position].meta_content_count; z++)
         {
 
             meta_alter_num = 0;
 
             /* Meta_content: OFFSET */
 
-            if ( rulestruct[rule_position].meta_offset[z] != 0 )
+            if ( gen->rulestruct[rule_position].meta_offset[z] != 0 )
                 {
 
-                    if ( strlen(syslog_message) > rulestruct[rule_position].meta_offset[z] )
+                    if ( strlen(syslog_message) > gen->rulestruct[rule_position].meta_offset[z] )
                         {
 
-                            meta_alter_num = strlen(syslog_message) - rulestruct[rule_position].meta_offset[z];
+                            meta_alter_num = strlen(syslog_message) - gen->rulestruct[rule_position].meta_offset[z];
                             strlcpy(meta_alter_content, syslog_message + (strlen(syslog_message) - meta_alter_num), meta_alter_num + 1);
 
                         }
@@ -92,28 +94,28 @@ bool Meta_Content(int rule_position, const char *syslog_message)
 
             /* Meta_content: DEPTH */
 
-            if ( rulestruct[rule_position].meta_depth[z] != 0 )
+            if ( gen->rulestruct[rule_position].meta_depth[z] != 0 )
                 {
 
                     /* We do +2 to account for alter_count[0] and whitespace at the begin of syslog message */
 
-                    strlcpy(meta_alter_content, meta_alter_content, rulestruct[rule_position].meta_depth[z] + 2);
+                    strlcpy(meta_alter_content, meta_alter_content, gen->rulestruct[rule_position].meta_depth[z] + 2);
 
                 }
 
             /* Meta_content: DISTANCE */
 
-            if ( rulestruct[rule_position].meta_distance[z] != 0 )
+            if ( gen->rulestruct[rule_position].meta_distance[z] != 0 )
                 {
 
-                    meta_alter_num = strlen(syslog_message) - ( rulestruct[rule_position].meta_depth[z-1] + rulestruct[rule_position].meta_distance[z] + 1 );
+                    meta_alter_num = strlen(syslog_message) - ( gen->rulestruct[rule_position].meta_depth[z-1] + gen->rulestruct[rule_position].meta_distance[z] + 1 );
                     strlcpy(meta_alter_content, syslog_message + (strlen(syslog_message) - meta_alter_num), meta_alter_num + 1);
 
                     /* Meta_ontent: WITHIN */
 
-                    if ( rulestruct[rule_position].meta_within[z] != 0 )
+                    if ( gen->rulestruct[rule_position].meta_within[z] != 0 )
                         {
-                            strlcpy(meta_alter_content, meta_alter_content, rulestruct[rule_position].meta_within[z] + 1);
+                            strlcpy(meta_alter_content, meta_alter_content, gen->rulestruct[rule_position].meta_within[z] + 1);
 
                         }
 
@@ -132,7 +134,7 @@ bool Meta_Content(int rule_position, const char *syslog_message)
 
     /* Got positive results, return true */
 
-    if ( match == rulestruct[rule_position].meta_content_count )
+    if ( match == gen->rulestruct[rule_position].meta_content_count )
         {
             return(true);
         }
@@ -148,19 +150,21 @@ bool Meta_Content(int rule_position, const char *syslog_message)
 bool Meta_Content_Search(char *syslog_msg, int rule_position, int meta_content_count)
 {
 
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
+
     int z = meta_content_count;
     int i;
 
     /* Normal "meta_content" search */
 
-    if ( rulestruct[rule_position].meta_content_not[z] == false )
+    if ( gen->rulestruct[rule_position].meta_content_not[z] == false )
         {
-            for ( i=0; i<rulestruct[rule_position].meta_content_containers[z].meta_counter; i++ )
+            for ( i=0; i<gen->rulestruct[rule_position].meta_content_containers[z].meta_counter; i++ )
                 {
-                    if ( rulestruct[rule_position].meta_content_case[z] == true )
+                    if ( gen->rulestruct[rule_position].meta_content_case[z] == true )
                         {
 
-                            if (Sagan_stristr(syslog_msg, rulestruct[rule_position].meta_content_containers[z].meta_content_converted[i], true))
+                            if (Sagan_stristr(syslog_msg, gen->rulestruct[rule_position].meta_content_containers[z].meta_content_converted[i], true))
                                 {
                                     return(true);
                                 }
@@ -168,7 +172,7 @@ bool Meta_Content_Search(char *syslog_msg, int rule_position, int meta_content_c
                     else
                         {
 
-                            if (Sagan_strstr(syslog_msg, rulestruct[rule_position].meta_content_containers[z].meta_content_converted[i]))
+                            if (Sagan_strstr(syslog_msg, gen->rulestruct[rule_position].meta_content_containers[z].meta_content_converted[i]))
                                 {
                                     return(true);
                                 }
@@ -181,13 +185,13 @@ bool Meta_Content_Search(char *syslog_msg, int rule_position, int meta_content_c
     else
         {
 
-            for ( i=0; i<rulestruct[rule_position].meta_content_containers[z].meta_counter; i++ )
+            for ( i=0; i<gen->rulestruct[rule_position].meta_content_containers[z].meta_counter; i++ )
                 {
 
-                    if ( rulestruct[rule_position].meta_content_case[z] == true )
+                    if ( gen->rulestruct[rule_position].meta_content_case[z] == true )
                         {
 
-                            if (Sagan_stristr(syslog_msg, rulestruct[rule_position].meta_content_containers[z].meta_content_converted[i], true))
+                            if (Sagan_stristr(syslog_msg, gen->rulestruct[rule_position].meta_content_containers[z].meta_content_converted[i], true))
                                 {
                                     return(false);
                                 }
@@ -195,7 +199,7 @@ bool Meta_Content_Search(char *syslog_msg, int rule_position, int meta_content_c
                     else
                         {
 
-                            if (Sagan_strstr(syslog_msg, rulestruct[rule_position].meta_content_containers[z].meta_content_converted[i]))
+                            if (Sagan_strstr(syslog_msg, gen->rulestruct[rule_position].meta_content_containers[z].meta_content_converted[i]))
                                 {
                                     return(false);
                                 }
@@ -42,7 +42,6 @@
 #include "references.h"
 #include "sagan-config.h"
 
-struct _Rule_Struct *rulestruct;
 struct _SaganConfig *config;
 struct _SaganCounters *counters;
 
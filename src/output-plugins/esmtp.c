@@ -44,11 +44,11 @@
 #include "sagan-config.h"
 #include "references.h"
 #include "rules.h"
+#include "rule-generation.h"
 #include "esmtp.h"
 #include "util-time.h"
 #include "version.h"
 
-struct _Rule_Struct *rulestruct;
 struct _SaganDebug *debug;
 struct _SaganConfig *config;
 struct _SaganCounters *counters;
@@ -56,6 +56,8 @@ struct _SaganCounters *counters;
 int ESMTP_Thread ( _Sagan_Event *Event )
 {
 
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
+
     char tmpref[256];
     char timebuf[64];
 
@@ -80,7 +82,7 @@ int ESMTP_Thread ( _Sagan_Event *Event )
                       "%s %s %s:%d -> %s:%d %s %s %s\n"
                       "Syslog message: %s\r\n%s\n\r",
                       config->sagan_esmtp_from,
-                      rulestruct[Event->found].email,
+                      gen->rulestruct[Event->found].email,
                       config->sagan_email_subject,
                       Event->f_msg,
                       Event->generatorid,
@@ -157,7 +159,7 @@ int ESMTP_Thread ( _Sagan_Event *Event )
             __atomic_add_fetch(&counters->esmtp_count_failed, 1, __ATOMIC_SEQ_CST);
             goto failure;
         }
-    if((recipient = smtp_add_recipient (message, rulestruct[Event->found].email)) == NULL)
+    if((recipient = smtp_add_recipient (message, gen->rulestruct[Event->found].email)) == NULL)
         {
             Sagan_Log(WARN, "[%s, line %d] Cannot add recipient.",  __FILE__, __LINE__);
             __atomic_add_fetch(&counters->esmtp_count_failed, 1, __ATOMIC_SEQ_CST);
@@ -48,7 +48,6 @@
 #include "util-time.h"
 #include "output-plugins/external.h"
 
-struct _Rule_Struct *rulestruct;
 struct _SaganDebug *debug;
 struct _SaganConfig *config;
 
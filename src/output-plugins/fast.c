@@ -40,7 +40,6 @@
 
 #include "output-plugins/alert.h"
 
-struct _Rule_Struct *rulestruct;
 struct _SaganConfig *config;
 
 void Fast_File( _Sagan_Event *Event )
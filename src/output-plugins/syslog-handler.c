@@ -43,7 +43,6 @@
 
 #include "output-plugins/syslog-handler.h"
 
-struct _Rule_Struct *rulestruct;
 struct _SaganConfig *config;
 
 void Alert_Syslog( _Sagan_Event *Event )
@@ -34,6 +34,7 @@
 #include "sagan.h"
 #include "output.h"
 #include "rules.h"
+#include "rule-generation.h"
 #include "sagan-config.h"
 
 #include "output-plugins/alert.h"
@@ -50,7 +51,6 @@
 #endif
 
 struct _SaganCounters *counters;
-struct _Rule_Struct *rulestruct;
 struct _SaganConfig *config;
 
 bool nonthread_alert_lock = false;
@@ -60,6 +60,8 @@ pthread_mutex_t SaganOutputNonThreadMutex=PTHREAD_MUTEX_INITIALIZER;
 void Output( _Sagan_Event *Event )
 {
 
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
+
     /******************************/
     /* Single threaded operations */
     /******************************/
@@ -69,7 +71,7 @@ void Output( _Sagan_Event *Event )
     pthread_mutex_lock(&SaganOutputNonThreadMutex);
     nonthread_alert_lock = true;
 
-    if ( config->alert_flag && rulestruct[Event->found].xbit_noalert == false )
+    if ( config->alert_flag && gen->rulestruct[Event->found].xbit_noalert == false )
         {
             Alert_File(Event);
         }
@@ -77,7 +79,7 @@ void Output( _Sagan_Event *Event )
     if ( config->eve_flag && config->eve_alerts )
         {
 
-            if ( rulestruct[Event->found].xbit_noeve == false && rulestruct[Event->found].flexbit_noeve == false )
+            if ( gen->rulestruct[Event->found].xbit_noeve == false && gen->rulestruct[Event->found].flexbit_noeve == false )
                 {
                     Alert_JSON(Event);
                 }
@@ -112,7 +114,7 @@ void Output( _Sagan_Event *Event )
 
 #ifdef HAVE_LIBESMTP
 
-    if ( config->sagan_esmtp_flag && rulestruct[Event->found].email_flag )
+    if ( config->sagan_esmtp_flag && gen->rulestruct[Event->found].email_flag )
         {
             ESMTP_Thread( Event );
         }
@@ -123,9 +125,9 @@ void Output( _Sagan_Event *Event )
     /* External program via rule                                                */
     /****************************************************************************/
 
-    if (  rulestruct[Event->found].external_flag )
+    if (  gen->rulestruct[Event->found].external_flag )
         {
-            External_Thread( Event, rulestruct[Event->found].external_program );
+            External_Thread( Event, gen->rulestruct[Event->found].external_program );
         }
 }
 
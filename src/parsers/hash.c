@@ -20,6 +20,10 @@
 
 /*
  * hash.c
+ *
+ * Finds MD5,  SHA1 and SHA256 values in a log line.  The message is walked
+ * once and every run of hex characters is sorted by its length,  so all
+ * three hash types come out of the same pass.
  */
 
 #ifdef HAVE_CONFIG_H
@@ -39,137 +43,137 @@
 
 struct _SaganConfig *config;
 
-void Parse_Hash(char *syslog_message, int type, char *str, size_t size)
-{
-    char mod_string[MAX_SYSLOGMSG];
-
-    char *ptmp=NULL;
-    char *tok=NULL;
-    char tmp[SHA256_HASH_SIZE+1];
-
-    int i;
+/* Character classes.  Anything marked PARSE_HASH_DELIM separates words (the
+   end of the string is a delimiter as well). */
 
-    /* Remove anything we dont want */
+#define PARSE_HASH_OTHER	0
+#define PARSE_HASH_DELIM	1
+#define PARSE_HASH_HEX		2
 
-    for (i=0; i<strlen(syslog_message); i++)
-        {
-
-            /* Remove everything.  Just want any hashes */
-
-            if ( syslog_message[i] != '"' && syslog_message[i] != '(' && syslog_message[i] != ')' &&
-                    syslog_message[i] != '[' && syslog_message[i] != ']' && syslog_message[i] != '<' &&
-                    syslog_message[i] != '>' && syslog_message[i] != '{' && syslog_message[i] != '}' &&
-                    syslog_message[i] != ',' && syslog_message[i] != '/' && syslog_message[i] != '@' &&
-                    syslog_message[i] != '=' && syslog_message[i] != '-' && syslog_message[i] != '!' &&
-                    syslog_message[i] != '|' && syslog_message[i] != '_' && syslog_message[i] != '+' &&
-                    syslog_message[i] != '&' && syslog_message[i] != '%' && syslog_message[i] != '$' &&
-                    syslog_message[i] != '~' && syslog_message[i] != '^' && syslog_message[i] != '\'' &&
-                    syslog_message[i] != '.' )
-                {
-
-                    mod_string[i] = syslog_message[i];
-                    mod_string[i+1] = '\0';
-
-                }
-            else
-                {
+static const unsigned char Parse_Hash_Class[256] =
+{
 
-                    mod_string[i] = ' ';
-                    mod_string[i+1] = '\0';
+    [0] = PARSE_HASH_DELIM,
+    [' '] = PARSE_HASH_DELIM,
+    ['"'] = PARSE_HASH_DELIM,
+    ['\''] = PARSE_HASH_DELIM,
+    ['('] = PARSE_HASH_DELIM,
+    [')'] = PARSE_HASH_DELIM,
+    ['['] = PARSE_HASH_DELIM,
+    [']'] = PARSE_HASH_DELIM,
+    ['<'] = PARSE_HASH_DELIM,
+    ['>'] = PARSE_HASH_DELIM,
+    ['{'] = PARSE_HASH_DELIM,
+    ['}'] = PARSE_HASH_DELIM,
+    [','] = PARSE_HASH_DELIM,
+    ['/'] = PARSE_HASH_DELIM,
+    ['@'] = PARSE_HASH_DELIM,
+    ['='] = PARSE_HASH_DELIM,
+    ['-'] = PARSE_HASH_DELIM,
+    ['!'] = PARSE_HASH_DELIM,
+    ['|'] = PARSE_HASH_DELIM,
+    ['_'] = PARSE_HASH_DELIM,
+    ['+'] = PARSE_HASH_DELIM,
+    ['&'] = PARSE_HASH_DELIM,
+    ['%'] = PARSE_HASH_DELIM,
+    ['$'] = PARSE_HASH_DELIM,
+    ['~'] = PARSE_HASH_DELIM,
+    ['^'] = PARSE_HASH_DELIM,
+    ['.'] = PARSE_HASH_DELIM,
+
+    ['0'] = PARSE_HASH_HEX, ['1'] = PARSE_HASH_HEX, ['2'] = PARSE_HASH_HEX,
+    ['3'] = PARSE_HASH_HEX, ['4'] = PARSE_HASH_HEX, ['5'] = PARSE_HASH_HEX,
+    ['6'] = PARSE_HASH_HEX, ['7'] = PARSE_HASH_HEX, ['8'] = PARSE_HASH_HEX,
+    ['9'] = PARSE_HASH_HEX,
+    ['a'] = PARSE_HASH_HEX, ['b'] = PARSE_HASH_HEX, ['c'] = PARSE_HASH_HEX,
+    ['d'] = PARSE_HASH_HEX, ['e'] = PARSE_HASH_HEX, ['f'] = PARSE_HASH_HEX,
+    ['A'] = PARSE_HASH_HEX, ['B'] = PARSE_HASH_HEX, ['C'] = PARSE_HASH_HEX,
+    ['D'] = PARSE_HASH_HEX, ['E'] = PARSE_HASH_HEX, ['F'] = PARSE_HASH_HEX
+
+};
+
+/****************************************************************************
+ * Parse_Hash - Copies the first MD5,  SHA1 and SHA256 found in the message
+ * into md5,  sha1 and sha256.  Types that are not found are left as an
+ * empty string.  A word may start with a ':' (ie - "md5:HASH").
+ ****************************************************************************/
+
+void Parse_Hash( char *syslog_message, char *md5, size_t md5_size, char *sha1, size_t sha1_size, char *sha256, size_t sha256_size )
+{
 
-                }
+    const char *p = syslog_message;
+    const char *start = NULL;
 
-        }
+    bool all_hex = true;
+    size_t len = 0;
 
-    ptmp = strtok_r(mod_string, " ", &tok);
+    md5[0] = '\0';
+    sha1[0] = '\0';
+    sha256[0] = '\0';
 
-    while (ptmp != NULL )
+    while ( *p != '\0' )
         {
 
-            Parse_Hash_Cleanup(ptmp, tmp, sizeof(tmp));
+            /* Skip to the start of the next word */
 
-            if ( type == PARSE_HASH_MD5 || type == PARSE_HASH_ALL )
+            while ( *p != '\0' && Parse_Hash_Class[(unsigned char)*p] == PARSE_HASH_DELIM )
                 {
-                    if ( strlen(tmp) == MD5_HASH_SIZE )
-                        {
-                            if ( Validate_HEX(tmp) == true )
-                                {
-                                    snprintf(str, size, "%s", tmp);
-                                    return;
-                                }
-                        }
-
+                    p++;
                 }
 
-            else if ( type == PARSE_HASH_SHA1 || type == PARSE_HASH_ALL )
+            if ( *p == '\0' )
                 {
-                    if ( strlen(tmp) == SHA1_HASH_SIZE )
-                        {
-                            if ( Validate_HEX(tmp) == true )
-                                {
-                                    snprintf(str, size, "%s", tmp);
-                                    return;
-                                }
-                        }
+                    break;
                 }
 
-            else if ( type == PARSE_HASH_SHA256 || type == PARSE_HASH_ALL )
+            if ( *p == ':' )
                 {
+                    p++;
+                }
 
+            /* Walk the word,  noting if anything in it isn't hex */
 
-                    if ( strlen(tmp) == SHA256_HASH_SIZE )
+            start = p;
+            all_hex = true;
+
+            for ( ; Parse_Hash_Class[(unsigned char)*p] != PARSE_HASH_DELIM; p++ )
+                {
+                    if ( Parse_Hash_Class[(unsigned char)*p] != PARSE_HASH_HEX )
                         {
-                            if ( Validate_HEX(tmp) == true )
-                                {
-                                    snprintf(str, size, "%s", tmp);
-                                    return;
-                                }
+                            all_hex = false;
                         }
                 }
 
+            if ( all_hex == false )
+                {
+                    continue;
+                }
 
-            ptmp = strtok_r(NULL, " ", &tok);
-
-        }
-
-    tmp[0] = '\0';
-    snprintf(str, size, "%s", tmp);
-}
-
-
-void Parse_Hash_Cleanup(char *string, char *str, size_t size)
-{
-
-    char tmp[512];
-    int i;
-    char in[512] = { 0 };
-    char tmp2[2];
-
-    strlcpy(in, string, sizeof(in));
+            len = p - start;
 
-    int len = strlen(in);
+            if ( len == MD5_HASH_SIZE && md5[0] == '\0' )
+                {
+                    snprintf(md5, md5_size, "%.*s", (int)len, start);
+                }
 
-    if ( ( in[strlen(in) - 1] ) == ',' || ( in[strlen(in) - 1] ) == '\'' )
-        {
-            strlcpy(tmp, in, len-1 );
-            strlcpy(in, tmp, sizeof(in));
-        }
+            else if ( len == SHA1_HASH_SIZE && sha1[0] == '\0' )
+                {
+                    snprintf(sha1, sha1_size, "%.*s", (int)len, start);
+                }
 
-    if ( in[0] == ',' || in[0] == '\'' || in[0] == ':' )
-        {
+            else if ( len == SHA256_HASH_SIZE && sha256[0] == '\0' )
+                {
+                    snprintf(sha256, sha256_size, "%.*s", (int)len, start);
+                }
 
-            tmp[0] = '\0';
+            /* Nothing left to look for */
 
-            for(i=1; i < strlen(in); i++)
+            if ( md5[0] != '\0' && sha1[0] != '\0' && sha256[0] != '\0' )
                 {
-                    snprintf(tmp2, sizeof(tmp2), "%c", in[i]);
-                    strcat(tmp, tmp2);
+                    break;
                 }
 
-            strlcpy(in, tmp, sizeof(in));
         }
 
-    snprintf(str, size, "%s", in);
-
 }
 
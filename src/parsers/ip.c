@@ -59,6 +59,9 @@
  * fe80::b614:89ff:fe11:5e24 Client Port: 1234	# Windows
  * fe80::b614:89ff:fe11:5e24 client port 1234
  *
+ * The message is walked once,  left to right.  Nothing is copied except
+ * the few words that look like they could be an address.
+ *
  */
 
 #ifdef HAVE_CONFIG_H
@@ -68,11 +71,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
-#include <netinet/in.h>
-#include <arpa/inet.h>
-#include <sys/socket.h>
-#include <netdb.h>
 #include <string.h>
+#include <ctype.h>
 #include <pthread.h>
 
 #include "sagan.h"
@@ -85,908 +85,557 @@
 struct _SaganConfig *config;
 struct _SaganDebug *debug;
 
-int Parse_IP( char *syslog_message, struct _Sagan_Lookup_Cache_Entry *lookup_cache )
+/* Character classes for the scanner.  Anything marked PARSE_IP_DELIM
+   separates "words",  so "192.168.1.1",  (192.168.1.1) and
+   src=192.168.1.1 all yield the same word.  The end of the string is a
+   delimiter as well. */
+
+#define PARSE_IP_OTHER		0
+#define PARSE_IP_DELIM		1
+#define PARSE_IP_COLON		2
+#define PARSE_IP_DOT		3
+#define PARSE_IP_HASH		4
+
+static const unsigned char Parse_IP_Class[256] =
 {
 
-    if ( debug->debugparse_ip )
+    [0] = PARSE_IP_DELIM,
+    [' '] = PARSE_IP_DELIM,
+    ['"'] = PARSE_IP_DELIM,
+    ['\''] = PARSE_IP_DELIM,
+    ['('] = PARSE_IP_DELIM,
+    [')'] = PARSE_IP_DELIM,
+    ['['] = PARSE_IP_DELIM,
+    [']'] = PARSE_IP_DELIM,
+    ['<'] = PARSE_IP_DELIM,
+    ['>'] = PARSE_IP_DELIM,
+    ['{'] = PARSE_IP_DELIM,
+    ['}'] = PARSE_IP_DELIM,
+    [','] = PARSE_IP_DELIM,
+    ['/'] = PARSE_IP_DELIM,
+    ['@'] = PARSE_IP_DELIM,
+    ['='] = PARSE_IP_DELIM,
+    ['-'] = PARSE_IP_DELIM,
+    ['!'] = PARSE_IP_DELIM,
+    ['|'] = PARSE_IP_DELIM,
+    ['_'] = PARSE_IP_DELIM,
+    ['+'] = PARSE_IP_DELIM,
+    ['&'] = PARSE_IP_DELIM,
+    ['%'] = PARSE_IP_DELIM,
+    ['$'] = PARSE_IP_DELIM,
+    ['~'] = PARSE_IP_DELIM,
+    ['^'] = PARSE_IP_DELIM,
+
+    [':'] = PARSE_IP_COLON,
+    ['.'] = PARSE_IP_DOT,
+    ['#'] = PARSE_IP_HASH
+
+};
+
+/****************************************************************************
+ * Parse_IP_Word - Returns the next word at or after "s" and its length,  or
+ * NULL at the end of the string.
+ ****************************************************************************/
+
+static const char *Parse_IP_Word( const char *s, size_t *len )
+{
+
+    const char *end = NULL;
+
+    while ( *s != '\0' && Parse_IP_Class[(unsigned char)*s] == PARSE_IP_DELIM )
         {
-            Sagan_Log(DEBUG, "[%s:%lu] Start Function.", __FUNCTION__, pthread_self() );
+            s++;
         }
 
-    struct sockaddr_in sa;
+    if ( *s == '\0' )
+        {
+            return(NULL);
+        }
 
-    int current_position = 0;
+    for ( end = s; Parse_IP_Class[(unsigned char)*end] != PARSE_IP_DELIM; end++ );
 
-    char mod_string[MAX_SYSLOGMSG] = { 0 };
+    *len = end - s;
+    return(s);
+}
 
-    char tmp_token[64] = { 0 };
+/****************************************************************************
+ * Parse_IP_Word_Has - Case insensitive search for "needle" within a word
+ * that isn't NULL terminated.
+ ****************************************************************************/
 
-    char *ptr1 = NULL;
-    char *ptr2 = NULL;
+static bool Parse_IP_Word_Has( const char *word, size_t len, const char *needle )
+{
 
-    char *ptr3 = NULL;
-    char *ptr4 = NULL;
+    size_t needle_len = strlen(needle);
+    size_t i = 0;
+    size_t j = 0;
 
+    for ( i = 0; i + needle_len <= len; i++ )
+        {
 
-    char *ip_1 = NULL;
-    char *ip_2 = NULL;
+            for ( j = 0; j < needle_len && tolower((unsigned char)word[i+j]) == needle[j]; j++ );
 
-    char port_test[6] = { 0 };
-    int  port_test_int = 0;
+            if ( j == needle_len )
+                {
+                    return(true);
+                }
+        }
 
-    bool valid = false ;
+    return(false);
+}
 
-    int i=0;
-    int b=0;
+/****************************************************************************
+ * Parse_IP_Store - Convert "ip" into the lookup cache entry.  Returns true
+ * if it is an address of the requested family.
+ ****************************************************************************/
 
-    int num_colons = 0;
-    int num_dots = 0;
-    int num_hashes = 0;
+static bool Parse_IP_Store( struct _Sagan_Lookup_Cache_Entry *entry, const char *ip, int family )
+{
 
-    int port = config->sagan_port;
+    entry->family = IP_Parse(ip, entry->ip_bits);
 
-    for (i=0; i<strlen(syslog_message); i++)
+    if ( entry->family != family )
         {
+            return(false);
+        }
 
-            /* Remove any ", (, ), etc. In case the IP is enclosed like this:
-               "192.168.1.1" or (192.168.1.1) */
-
-            if ( syslog_message[i] != '"' && syslog_message[i] != '(' && syslog_message[i] != ')' &&
-                    syslog_message[i] != '[' && syslog_message[i] != ']' && syslog_message[i] != '<' &&
-                    syslog_message[i] != '>' && syslog_message[i] != '{' && syslog_message[i] != '}' &&
-                    syslog_message[i] != ',' && syslog_message[i] != '/' && syslog_message[i] != '@' &&
-                    syslog_message[i] != '=' && syslog_message[i] != '-' && syslog_message[i] != '!' &&
-                    syslog_message[i] != '|' && syslog_message[i] != '_' && syslog_message[i] != '+' &&
-                    syslog_message[i] != '&' && syslog_message[i] != '%' && syslog_message[i] != '$' &&
-                    syslog_message[i] != '~' && syslog_message[i] != '^' && syslog_message[i] != '\'' )
-                {
+    strlcpy(entry->ip, ip, sizeof(entry->ip));
+    entry->status = 1;
 
-                    mod_string[i] = syslog_message[i];
-                    mod_string[i+1] = '\0';
+    return(true);
+}
 
-                }
-            else
-                {
+/****************************************************************************
+ * Parse_IP_Set_Port - atoi() the first "len" bytes of the port.  Anything
+ * that isn't a port falls back to the default "sagan_port".
+ ****************************************************************************/
 
-                    mod_string[i] = ' ';
-                    mod_string[i+1] = '\0';
+static void Parse_IP_Set_Port( struct _Sagan_Lookup_Cache_Entry *entry, const char *port_string, size_t len )
+{
 
-                }
+    char tmp[16] = { 0 };
+    int port = 0;
 
+    if ( len > sizeof(tmp) - 1 )
+        {
+            len = sizeof(tmp) - 1;
         }
 
+    memcpy(tmp, port_string, len);
+    port = atoi(tmp);
 
-    if ( debug->debugparse_ip )
+    if ( port == 0 )
         {
-            Sagan_Log(DEBUG, "[%s:%lu] Modified string: %s", __FUNCTION__, pthread_self(), mod_string);
+            entry->port = config->sagan_port;
         }
-
-    ptr1 = strtok_r(mod_string, " ", &ptr2);
-
-    while ( ptr1 != NULL )
+    else
         {
+            entry->port = port;
+        }
+}
 
-            num_colons = 0;
-            num_dots = 0;
-            num_hashes = 0;
-
-            if ( debug->debugparse_ip )
-                {
-                    Sagan_Log(DEBUG, "[%s:%lu] Token: '%s'", __FUNCTION__, pthread_self(), ptr1 );
-                }
-
-            /* Get counts of colons, hashes, dots.  */
+/****************************************************************************
+ * Parse_IP_Unmap - This converts ::ffff:192.168.1.1 to regular IPv4
+ * (192.168.1.1) unless the user wants to keep the mapped address.
+ ****************************************************************************/
 
-            for (i=0; i<strlen(ptr1); i++)
-                {
+static void Parse_IP_Unmap( struct _Sagan_Lookup_Cache_Entry *entry )
+{
 
-                    switch(ptr1[i])
-                        {
+    if ( config->parse_ip_ipv4_mapped_ipv6 == false && !strncasecmp(entry->ip, "::ffff:", 7) )
+        {
+            memmove(entry->ip, entry->ip + 7, strlen(entry->ip + 7) + 1);
+        }
+}
 
-                        case(':'):
-                            num_colons++;
-                            break;
+/****************************************************************************
+ * Parse_IP_Split - Handles ADDRESS:PORT and INTERFACE:ADDRESS (or with a
+ * '#').  "token" is left as it was found.
+ ****************************************************************************/
 
-                        case('#'):
-                            num_hashes++;
-                            break;
+static bool Parse_IP_Split( struct _Sagan_Lookup_Cache_Entry *entry, char *token, char separator, int family )
+{
 
-                        case('.'):
-                            num_dots++;
-                            break;
+    char *split = strchr(token, separator);
+    bool found = false;
 
-                        }
+    if ( split == NULL )
+        {
+            return(false);
+        }
 
-                }
+    *split = '\0';
 
-            valid = false;		/* Reset to not valid */
+    if ( Parse_IP_Store( entry, token, family ) == true )
+        {
 
             if ( debug->debugparse_ip )
                 {
-                    Sagan_Log(DEBUG, "[%s:%lu] Colons: %d, Dots: %d, Hashes: %d", __FUNCTION__, pthread_self(), num_colons, num_dots, num_hashes );
+                    Sagan_Log(DEBUG, "[%s:%lu] ** Identified ADDRESS%cPORT '%s' **", __FUNCTION__, pthread_self(), separator, token );
                 }
 
-            if ( !strcasecmp(ptr1, "tcp" ) )
-                {
-
-                    if ( debug->debugparse_ip )
-                        {
-                            Sagan_Log(DEBUG, "[%s:%lu] Protocal TCP detected.", __FUNCTION__, pthread_self() );
-                        }
+            Parse_IP_Set_Port( entry, split + 1, strlen(split + 1) );
+            found = true;
+        }
 
-                    lookup_cache[0].proto = 6;
-                }
+    else if ( Parse_IP_Store( entry, split + 1, family ) == true )
+        {
 
-            else if ( !strcasecmp(ptr1, "udp" ) )
+            if ( debug->debugparse_ip )
                 {
+                    Sagan_Log(DEBUG, "[%s:%lu] ** Identified INTERFACE%cADDRESS '%s' **", __FUNCTION__, pthread_self(), separator, split + 1 );
+                }
 
-                    if ( debug->debugparse_ip )
-                        {
-                            Sagan_Log(DEBUG, "[%s:%lu] Protocal UDP detected.", __FUNCTION__, pthread_self() );
-                        }
+            entry->port = config->sagan_port;
+            found = true;
+        }
 
-                    lookup_cache[0].proto = 17;
+    *split = separator;
 
-                }
+    return(found);
+}
 
-            else if ( !strcasecmp(ptr1, "icmp" ) )
-                {
+/****************************************************************************
+ * Parse_IP_Port_Words - Look at the words following an address for
+ * "port 1234",  "source port: 1234",  "destination port 1234" or
+ * "client port 1234".  For IPv6,  [fe80::b614:89ff:fe11:5e24]:443 leaves
+ * ":443" as the next word.
+ ****************************************************************************/
 
-                    if ( debug->debugparse_ip )
-                        {
-                            Sagan_Log(DEBUG, "[%s:%lu] Protocal ICMP detected.", __FUNCTION__, pthread_self() );
-                        }
+static void Parse_IP_Port_Words( const char *s, struct _Sagan_Lookup_Cache_Entry *entry, bool ipv6 )
+{
 
-                    lookup_cache[0].proto = 1;
+    const char *word = NULL;
+    size_t len = 0;
 
-                }
+    word = Parse_IP_Word( s, &len );
 
+    if ( word == NULL )
+        {
+            return;
+        }
 
-            /* Needs to have proper IPv6 or IPv4 encoding. num_dots > 4 is for IP with trailing
-            period. */
+    if ( Parse_IP_Word_Has( word, len, "port" ) )
+        {
 
-            if ( ( num_colons < 2 && num_dots < 3 ) || ( num_dots > 4 ) )
+            if ( debug->debugparse_ip )
                 {
-
-                    if ( debug->debugparse_ip )
-                        {
-                            Sagan_Log(DEBUG, "[%s:%lu] '%s' can't be an IPv4 or IPv6.", __FUNCTION__, pthread_self(), ptr1 );
-                        }
-
-                    ptr1 = strtok_r(NULL, " ", &ptr2);		/* move to next token */
-                    continue;
+                    Sagan_Log(DEBUG, "[%s:%lu] Identified the word 'port'", __FUNCTION__, pthread_self() );
                 }
 
+        }
 
-            /* Stand alone IPv4 address */
+    else if ( ipv6 == true && word[0] == ':' )
+        {
 
-            if ( num_dots == 3 && num_colons == 0 )
+            if ( debug->debugparse_ip )
                 {
+                    Sagan_Log(DEBUG, "[%s:%lu] Identified possible [IPv6]:PORT", __FUNCTION__, pthread_self() );
+                }
 
-                    valid = inet_pton(AF_INET, ptr1,  &(sa.sin_addr));
-
-                    if ( valid == 1 )
-                        {
-
-                            if ( debug->debugparse_ip )
-                                {
-                                    Sagan_Log(DEBUG, "[%s:%lu] ** Identified stand alone IPv4 address '%s' position %d **", __FUNCTION__, pthread_self(), ptr1, current_position );
-                                }
-
-                            /* Grab the IP */
-
-                            memcpy(lookup_cache[current_position].ip, ptr1, MAXIP);
-                            memset(lookup_cache[current_position].ip_bits, 0, MAXIPBIT);
-                            IP2Bit(ptr1, lookup_cache[current_position].ip_bits);
-
-                            /* Preserve the array */
-
-                            memcpy(tmp_token, ptr2, sizeof(tmp_token));
-
-                            ptr4 = tmp_token;
-                            ptr3 = strtok_r(NULL, " ", &ptr4);
-
-                            /* Look for "192.168.1.1 port 1234" */
-
-                            if ( ptr3 != NULL && strcasestr(ptr3, "port") )
-                                {
-
-                                    if ( debug->debugparse_ip )
-                                        {
-                                            Sagan_Log(DEBUG, "[%s:%d] Identified the word 'port'", __FUNCTION__, pthread_self() );
-                                        }
-
-                                    ptr3 = strtok_r(NULL, " ", &ptr4);
-
-                                    if ( ptr3 != NULL )
-                                        {
-                                            port = atoi(ptr3);
-
-                                            if ( port == 0 )
-                                                {
-                                                    lookup_cache[current_position].port = config->sagan_port;
-
-                                                }
-                                            else
-                                                {
-
-                                                    lookup_cache[current_position].port = port;
-
-                                                }
-                                        }
-
-                                }
-
-                            /* Look for "192.168.1.1 source port: 1234" or
-                            "192.168.1.1 source port 1234" */
-
-                            else if ( ptr3 != NULL && ( strcasestr(ptr3, "source") ||
-                                                        strcasestr(ptr3, "destination" ) ) )
-
-                                {
-
-                                    if ( debug->debugparse_ip )
-                                        {
-                                            Sagan_Log(DEBUG, "[%s:%lu] Identified 'source' or 'destination'", __FUNCTION__, pthread_self() );
-                                        }
-
-                                    ptr3 = strtok_r(NULL, " ", &ptr4);
-
-                                    if ( ptr3 != NULL && strcasestr(ptr3, "port" ) )
-                                        {
-
-                                            if ( debug->debugparse_ip )
-                                                {
-                                                    Sagan_Log(DEBUG, "[%s:%lu] Identified 'port'.", __FUNCTION__, pthread_self() );
-                                                }
-
-                                            ptr3 = strtok_r(NULL, " ", &ptr4);
-
-                                            if ( ptr3 != NULL )
-                                                {
-
-                                                    port = atoi(ptr3);
-
-                                                    if ( port == 0 )
-                                                        {
+            Parse_IP_Set_Port( entry, word + 1, len - 1 );
+            return;
+        }
 
-                                                            lookup_cache[current_position].port = config->sagan_port;
+    else if ( Parse_IP_Word_Has( word, len, "source" ) || Parse_IP_Word_Has( word, len, "destination" ) ||
+              Parse_IP_Word_Has( word, len, "client" ) )
+        {
 
-                                                        }
-                                                    else
-                                                        {
+            if ( debug->debugparse_ip )
+                {
+                    Sagan_Log(DEBUG, "[%s:%lu] Identified 'source', 'destination' or 'client'", __FUNCTION__, pthread_self() );
+                }
 
-                                                            lookup_cache[current_position].port = port;
-                                                        }
+            word = Parse_IP_Word( word + len, &len );
 
+            if ( word == NULL || !Parse_IP_Word_Has( word, len, "port" ) )
+                {
+                    return;
+                }
 
-                                                }
+        }
 
-                                        }
+    else
+        {
+            return;
+        }
 
-                                }
+    word = Parse_IP_Word( word + len, &len );
 
-                            /* Look's for 192.168.1.1 client port 1234 */
+    if ( word != NULL )
+        {
+            Parse_IP_Set_Port( entry, word, len );
+        }
 
-                            else if ( ptr3 != NULL && strcasestr(ptr3, "client") )
-                                {
+}
 
-                                    if ( debug->debugparse_ip )
-                                        {
-                                            Sagan_Log(DEBUG, "[%s:%lu] Identified 'client'", __FUNCTION__, pthread_self() );
-                                        }
+int Parse_IP( char *syslog_message, struct _Sagan_Lookup_Cache_Entry *lookup_cache )
+{
 
-                                    ptr3 = strtok_r(NULL, " ", &ptr4);
+    if ( debug->debugparse_ip )
+        {
+            Sagan_Log(DEBUG, "[%s:%lu] Start Function.", __FUNCTION__, pthread_self() );
+        }
 
-                                    if ( ptr3 != NULL && strcasestr(ptr3, "port" ) )
-                                        {
+    int current_position = 0;
 
-                                            if ( debug->debugparse_ip )
-                                                {
-                                                    Sagan_Log(DEBUG, "[%s:%lu] Identified 'port'.", __FUNCTION__, pthread_self() );
-                                                }
+    const char *p = syslog_message;
+    const char *start = NULL;
 
-                                            ptr3 = strtok_r(NULL, " ", &ptr4);
+    char token[MAXIP] = { 0 };
+    bool found = false;
 
-                                            if ( ptr3 != NULL )
-                                                {
+    size_t len = 0;
+    int i = 0;
 
-                                                    port = atoi(ptr3);
+    int num_colons = 0;
+    int num_dots = 0;
+    int num_hashes = 0;
 
-                                                    if ( port == 0 )
-                                                        {
+    while ( *p != '\0' && current_position < MAX_PARSE_IP )
+        {
 
-                                                            lookup_cache[current_position].port = config->sagan_port;
+            /* Skip to the start of the next word */
 
-                                                        }
-                                                    else
-                                                        {
+            while ( *p != '\0' && Parse_IP_Class[(unsigned char)*p] == PARSE_IP_DELIM )
+                {
+                    p++;
+                }
 
-                                                            lookup_cache[current_position].port = port;
-                                                        }
+            if ( *p == '\0' )
+                {
+                    break;
+                }
 
+            /* Find the end of the word,  counting colons,  dots and hashes
+               along the way */
 
-                                                }
+            start = p;
 
-                                        }
+            num_colons = 0;
+            num_dots = 0;
+            num_hashes = 0;
 
-                                }
+            for ( ; Parse_IP_Class[(unsigned char)*p] != PARSE_IP_DELIM; p++ )
+                {
 
+                    switch( Parse_IP_Class[(unsigned char)*p] )
+                        {
 
-                            lookup_cache[current_position].status = 1;
-                            current_position++;
+                        case(PARSE_IP_COLON):
+                            num_colons++;
+                            break;
 
-                            /* If we've run to the end, we're done */
+                        case(PARSE_IP_HASH):
+                            num_hashes++;
+                            break;
 
-                            if ( current_position > MAX_PARSE_IP )
-                                {
-                                    break;
-                                }
+                        case(PARSE_IP_DOT):
+                            num_dots++;
+                            break;
 
                         }
-
                 }
 
-            /* Stand alone IPv4 with trailing period */
+            len = p - start;
 
-            if ( num_dots == 4 && ptr1[ strlen(ptr1)-1 ] == '.' )
+            if ( len == 3 && !strncasecmp(start, "tcp", 3) )
                 {
 
-                    /* Erase the period */
-
-                    ptr1[ strlen(ptr1)-1 ] = '\0';
-
-                    valid = inet_pton(AF_INET, ptr1,  &(sa.sin_addr));
-
-                    if ( valid == 1 )
+                    if ( debug->debugparse_ip )
                         {
-
-                            if ( debug->debugparse_ip )
-                                {
-                                    Sagan_Log(DEBUG, "[%s:%lu] ** Identified stand alone IPv4 address '%s' with trailing period. **", __FUNCTION__, pthread_self(), ptr1 );
-                                }
-
-                            memcpy(lookup_cache[current_position].ip, ptr1, MAXIP);
-                            memset(lookup_cache[current_position].ip_bits, 0, MAXIPBIT);
-                            IP2Bit(ptr1, lookup_cache[current_position].ip_bits);
-                            lookup_cache[current_position].port = config->sagan_port;
-                            lookup_cache[current_position].status = 1;
-
-                            current_position++;
-
-                            if ( current_position > MAX_PARSE_IP )
-                                {
-                                    break;
-                                }
-
-
+                            Sagan_Log(DEBUG, "[%s:%lu] Protocal TCP detected.", __FUNCTION__, pthread_self() );
                         }
 
+                    lookup_cache[0].proto = 6;
                 }
 
-            /* IPv4 with 192.168.2.1:12345 or inet:192.168.2.1 */
-
-            if ( num_colons == 1 && num_dots == 3)
+            else if ( len == 3 && !strncasecmp(start, "udp", 3) )
                 {
 
-                    /* test both sides */
-
-                    ip_1 = strtok_r(ptr1, ":", &ip_2);
-
-                    if ( ip_1 != NULL )
+                    if ( debug->debugparse_ip )
                         {
-                            valid = inet_pton(AF_INET, ip_1,  &(sa.sin_addr));
+                            Sagan_Log(DEBUG, "[%s:%lu] Protocal UDP detected.", __FUNCTION__, pthread_self() );
                         }
 
-                    if ( valid == 1 )
-                        {
-
-                            if ( debug->debugparse_ip )
-                                {
-                                    Sagan_Log(DEBUG, "[%s:%lu] ** Identified IPv4:PORT address. **", __FUNCTION__, pthread_self() );
-                                }
+                    lookup_cache[0].proto = 17;
+                }
 
-                            memcpy(lookup_cache[current_position].ip, ip_1, MAXIP);
-                            memset(lookup_cache[current_position].ip_bits, 0, MAXIPBIT);
-                            IP2Bit(ip_1, lookup_cache[current_position].ip_bits);
+            else if ( len == 4 && !strncasecmp(start, "icmp", 4) )
+                {
 
-                            /* In many cases, the port is after the : */
+                    if ( debug->debugparse_ip )
+                        {
+                            Sagan_Log(DEBUG, "[%s:%lu] Protocal ICMP detected.", __FUNCTION__, pthread_self() );
+                        }
 
-                            port = atoi(ip_2);
+                    lookup_cache[0].proto = 1;
+                }
 
-                            if ( port == 0 )
-                                {
-                                    lookup_cache[current_position].port = config->sagan_port;
-                                }
-                            else
-                                {
-                                    lookup_cache[current_position].port = port;
-                                }
+            /* Needs to have proper IPv6 or IPv4 encoding. num_dots > 4 is for IP with trailing
+               period.  Anything longer than MAXIP can't be an address either. */
 
-                            lookup_cache[current_position].status = 1;
-                            current_position++;
+            if ( ( num_colons < 2 && num_dots < 3 ) || ( num_dots > 4 ) || len >= sizeof(token) )
+                {
+                    continue;
+                }
 
-                            if ( current_position > MAX_PARSE_IP )
-                                {
-                                    break;
-                                }
+            memcpy(token, start, len);
+            token[len] = '\0';
 
-                        }
+            if ( debug->debugparse_ip )
+                {
+                    Sagan_Log(DEBUG, "[%s:%lu] Token: '%s' Colons: %d, Dots: %d, Hashes: %d", __FUNCTION__, pthread_self(), token, num_colons, num_dots, num_hashes );
+                }
 
-                    if ( ip_2 != NULL )
-                        {
-                            valid = inet_pton(AF_INET, ip_2,  &(sa.sin_addr));
-                        }
+            /* Stand alone IPv4 address,  possibly followed by "port 1234" */
 
-                    if ( valid == 1 )
+            if ( num_dots == 3 && num_colons == 0 && num_hashes == 0 )
+                {
 
+                    if ( Parse_IP_Store( &lookup_cache[current_position], token, IPv4 ) == true )
                         {
 
                             if ( debug->debugparse_ip )
                                 {
-                                    Sagan_Log(DEBUG, "[%s:%lu] ** Identified INTERFACE:IPv4 **", __FUNCTION__, pthread_self() );
+                                    Sagan_Log(DEBUG, "[%s:%lu] ** Identified stand alone IPv4 address '%s' position %d **", __FUNCTION__, pthread_self(), token, current_position );
                                 }
 
-                            memcpy(lookup_cache[current_position].ip, ip_2, MAXIP);
-                            memset(lookup_cache[current_position].ip_bits, 0, MAXIPBIT);
-                            IP2Bit(ip_2, lookup_cache[current_position].ip_bits);
-                            lookup_cache[current_position].port = config->sagan_port;
-                            lookup_cache[current_position].status = 1;
-
+                            Parse_IP_Port_Words( p, &lookup_cache[current_position], false );
                             current_position++;
-
-                            if ( current_position > MAX_PARSE_IP )
-                                {
-                                    break;
-                                }
-
                         }
 
                 }
 
-            /* Handle 192.168.2.1#12345 or inet#192.168.2.1 */
+            /* Stand alone IPv4 with trailing period.  The period stays
+               erased for the IPv6 tests below (::ffff:192.168.1.1.) */
 
-            if ( num_hashes == 1 && num_dots == 3)
+            else if ( num_dots == 4 && token[len-1] == '.' )
                 {
 
-                    /* test both sides */
+                    token[--len] = '\0';
 
-                    ip_1 = strtok_r(ptr1, "#", &ip_2);
-
-                    if ( ip_1 != NULL )
-                        {
-                            valid = inet_pton(AF_INET, ip_1,  &(sa.sin_addr));
-                        }
-
-                    if ( valid == 1 )
+                    if ( Parse_IP_Store( &lookup_cache[current_position], token, IPv4 ) == true )
                         {
 
                             if ( debug->debugparse_ip )
                                 {
-                                    Sagan_Log(DEBUG, "[%s:%lu] ** Identified IPv4#PORT **", __FUNCTION__, pthread_self() );
+                                    Sagan_Log(DEBUG, "[%s:%lu] ** Identified stand alone IPv4 address '%s' with trailing period. **", __FUNCTION__, pthread_self(), token );
                                 }
 
+                            lookup_cache[current_position].port = config->sagan_port;
+                            current_position++;
+                        }
 
-                            memcpy(lookup_cache[current_position].ip, ip_1, MAXIP);
-                            memset(lookup_cache[current_position].ip_bits, 0, MAXIPBIT);
-                            IP2Bit(ip_1, lookup_cache[current_position].ip_bits);
-
-                            /* In many cases, the port is after the : */
-
-                            port = atoi(ip_2);
-
-                            if ( port == 0 )
-                                {
-                                    lookup_cache[current_position].port = config->sagan_port;
-                                }
-                            else
-                                {
-                                    lookup_cache[current_position].port = port;
-                                }
+                }
 
-                            lookup_cache[current_position].status = 1;
-                            current_position++;
+            /* IPv4 with 192.168.2.1:12345 or inet:192.168.2.1,  192.168.2.1#12345
+               or inet#192.168.2.1.  For inet#192.168.2.1:8080 only what is left
+               of the ':' is tested for a '#' */
 
-                            /* If we've run to the end, we're done */
+            else if ( num_dots == 3 )
+                {
 
-                            if ( current_position > MAX_PARSE_IP )
-                                {
-                                    break;
-                                }
+                    found = false;
 
+                    if ( num_colons == 1 )
+                        {
+                            found = Parse_IP_Split( &lookup_cache[current_position], token, ':', IPv4 );
+                            *strchr(token, ':') = '\0';
                         }
 
-                    if ( ip_2 != NULL )
+                    if ( found == false && num_hashes == 1 )
                         {
-                            valid = inet_pton(AF_INET, ip_2,  &(sa.sin_addr));
+                            found = Parse_IP_Split( &lookup_cache[current_position], token, '#', IPv4 );
                         }
 
-                    if ( valid == 1 )
-
+                    if ( found == true )
                         {
-
-                            if ( debug->debugparse_ip )
-                                {
-                                    Sagan_Log(DEBUG, "[%s:%lu] ** Identified INTERFACE#PORT **", __FUNCTION__, pthread_self() );
-                                }
-
-                            memcpy(lookup_cache[current_position].ip, ip_2, MAXIP);
-                            memset(lookup_cache[current_position].ip_bits, 0, MAXIPBIT);
-                            IP2Bit(ip_2, lookup_cache[current_position].ip_bits);
-                            lookup_cache[current_position].port = config->sagan_port;
-                            lookup_cache[current_position].status = 1;
-
                             current_position++;
-
-                            /* If we've run to the end, we're done */
-
-                            if ( current_position > MAX_PARSE_IP )
-                                {
-                                    break;
-                                }
-
                         }
 
                 }
 
-
             /* Do we even want to part IPv6? */
 
-            if ( config->parse_ip_ipv6 == true )
+            if ( config->parse_ip_ipv6 == false || num_colons <= 2 || current_position >= MAX_PARSE_IP )
                 {
+                    continue;
+                }
 
-                    /* Stand alone IPv6 */
-
-                    if ( num_colons > 2 )
-                        {
-
-                            valid = inet_pton(AF_INET6, ptr1,  &(sa.sin_addr));
-
-                            if ( valid == 1 )
-                                {
-
-                                    if ( debug->debugparse_ip )
-                                        {
-                                            Sagan_Log(DEBUG, "[%s:%lu] ** Identified stand alone IPv6 address '%s' **", __FUNCTION__, pthread_self(), ptr1 );
-                                        }
-
-                                    memcpy(lookup_cache[current_position].ip, ptr1, MAXIP);
-                                    memset(lookup_cache[current_position].ip_bits, 0, MAXIPBIT);
-                                    IP2Bit(ptr1, lookup_cache[current_position].ip_bits);
-
-                                    /* This converts ::ffff:192.168.1.1 to regular IPv4 (192.168.1.1) */
-
-                                    if ( config->parse_ip_ipv4_mapped_ipv6 == false )
-                                        {
-
-                                            if ( ptr1[0] == ':' && ptr1[1] == ':' && ( ptr1[2] == 'f' || ptr1[2] == 'F' ) &&
-                                                    ( ptr1[3] == 'f' || ptr1[3] == 'F' ) && ( ptr1[4] == 'f' || ptr1[4] == 'F' ) &&
-                                                    ( ptr1[5] == 'f' || ptr1[5] == 'F' ) && ptr1[6] == ':' )
-                                                {
-
-                                                    b = strlen(ptr1);
-
-                                                    for (i = 7; b > i; i++)
-                                                        {
-                                                            lookup_cache[current_position].ip[i-7] = ptr1[i];
-                                                            lookup_cache[current_position].ip[i-6] = '\0';
-                                                        }
-
-                                                    memset(lookup_cache[current_position].ip_bits, 0, MAXIPBIT);
-                                                    IP2Bit(ptr1, lookup_cache[current_position].ip_bits);
-
-                                                }
-
-                                        }
-
-                                    /* Look for "fe80::b614:89ff:fe11:5e24 port 1234" */
-
-                                    memcpy(tmp_token, ptr2, sizeof(tmp_token));
-
-                                    ptr4 = tmp_token;
-                                    ptr3 = strtok_r(NULL, " ", &ptr4);
-
-                                    if ( ptr3 != NULL && strcasestr(ptr3, "port") )
-                                        {
-
-                                            if ( debug->debugparse_ip )
-                                                {
-                                                    Sagan_Log(DEBUG, "[%s:%lu] Identified the word 'port'", __FUNCTION__, pthread_self() );
-                                                }
-
-
-                                            ptr3 = strtok_r(NULL, " ", &ptr4);
-
-                                            if ( ptr3 != NULL )
-                                                {
-                                                    port = atoi(ptr3);
-
-                                                    if ( port == 0 )
-                                                        {
-                                                            lookup_cache[current_position].port = port;
-                                                        }
-                                                    else
-                                                        {
-                                                            lookup_cache[current_position].port = config->sagan_port;
-                                                        }
-
-                                                }
-
-                                        }
-
-                                    /* Look for "fe80::b614:89ff:fe11:5e24 source port: 1234" or
-                                    "fe80::b614:89ff:fe11:5e24 source port 1234" */
-
-                                    else if ( ptr3 != NULL && ( strcasestr(ptr3, "source") ||
-                                                                strcasestr(ptr3, "destination" ) ) )
-
-                                        {
-
-                                            if ( debug->debugparse_ip )
-                                                {
-                                                    Sagan_Log(DEBUG, "[%s:%lu] Identified the word 'source' or 'destination'", __FUNCTION__, pthread_self() );
-                                                }
-
-
-                                            ptr3 = strtok_r(NULL, " ", &ptr4);
-
-                                            if ( ptr3 != NULL && strcasestr(ptr3, "port" ) )
-                                                {
-
-                                                    if ( debug->debugparse_ip )
-                                                        {
-                                                            Sagan_Log(DEBUG, "[%s:%lu] Identified the word 'port'", __FUNCTION__, pthread_self() );
-                                                        }
-
-
-                                                    ptr3 = strtok_r(NULL, " ", &ptr4);
-
-                                                    if ( ptr3 != NULL )
-                                                        {
-
-                                                            port = atoi(ptr3);
-
-                                                            if ( port == 0 )
-                                                                {
-                                                                    lookup_cache[current_position].port = config->sagan_port;
-                                                                }
-                                                            else
-                                                                {
-                                                                    lookup_cache[current_position].port = port;
-                                                                }
-
-                                                        }
-
-                                                }
-
-                                        }
-
-                                    /* IPv6 [fe80::b614:89ff:fe11:5e24]:443 */
-
-                                    else if ( ptr3 != NULL && ptr3[0] == ':' )
-                                        {
-
-                                            if ( debug->debugparse_ip )
-                                                {
-                                                    Sagan_Log(DEBUG, "[%s:%lu] Identified possible [IPv6]:PORT", __FUNCTION__, pthread_self() );
-                                                }
-
-                                            for ( i = 1; i < strlen(ptr3); i++ )
-                                                {
-                                                    port_test[i-1] = ptr3[i];
-                                                }
-
-                                            port_test_int = atoi(port_test);
-
-                                            if ( port_test_int == 0 )
-                                                {
-                                                    lookup_cache[current_position].port = config->sagan_port;
-                                                }
-                                            else
-                                                {
-                                                    lookup_cache[current_position].port = port_test_int;
-                                                }
-
-                                        }
-
-                                    lookup_cache[current_position].status = 1;
-
-                                    current_position++;
-
-                                    if ( current_position > MAX_PARSE_IP )
-                                        {
-                                            break;
-                                        }
-
-                                }
-
-                        }
-
+            /* Handle IPv6 fe80::b614:89ff:fe11:5e24#12345 or inet#fe80::b614:89ff:fe11:5e24 */
 
-                    /* Stand alone IPv6 with trailing period */
+            if ( num_hashes == 1 )
+                {
 
-                    if ( num_colons > 2 && ptr1[ strlen(ptr1)-1 ] == '.' )
+                    if ( token[len-1] == '.' )
                         {
-
-                            /* Erase the period */
-
-                            ptr1[ strlen(ptr1)-1 ] = '\0';
-
-                            valid = inet_pton(AF_INET6, ptr1,  &(sa.sin_addr));
-
-                            if ( valid == 1 )
-                                {
-
-                                    if ( debug->debugparse_ip )
-                                        {
-                                            Sagan_Log(DEBUG, "[%s:%lu] ** Identified stand alone IPv6 '%s' with trailing period. **", __FUNCTION__, pthread_self(), ptr1 );
-                                        }
-
-                                    memcpy(lookup_cache[current_position].ip, ptr1, MAXIP);
-                                    memset(lookup_cache[current_position].ip_bits, 0, MAXIPBIT);
-                                    IP2Bit(ptr1, lookup_cache[current_position].ip_bits);
-
-                                    /* This converts ::ffff:192.168.1.1 to regular IPv4 (192.168.1.1) */
-
-                                    if ( config->parse_ip_ipv4_mapped_ipv6 == false )
-                                        {
-
-                                            if ( ptr1[0] == ':' && ptr1[1] == ':' && ( ptr1[2] == 'f' || ptr1[2] == 'F' ) &&
-                                                    ( ptr1[3] == 'f' || ptr1[3] == 'F' ) && ( ptr1[4] == 'f' || ptr1[4] == 'F' ) &&
-                                                    ( ptr1[5] == 'f' || ptr1[5] == 'F' ) && ptr1[6] == ':' )
-                                                {
-
-                                                    b = strlen(ptr1);
-
-                                                    for (i = 7; b > i; i++)
-                                                        {
-                                                            lookup_cache[current_position].ip[i-7] = ptr1[i];
-                                                            lookup_cache[current_position].ip[i-6] = '\0';
-                                                        }
-
-                                                    memset(lookup_cache[current_position].ip_bits, 0, MAXIPBIT);
-                                                    IP2Bit(ptr1, lookup_cache[current_position].ip_bits);
-
-                                                }
-
-                                        }
-
-                                    lookup_cache[current_position].port = config->sagan_port;
-                                    lookup_cache[current_position].status = 1;
-
-                                    current_position++;
-
-                                    if ( current_position > MAX_PARSE_IP )
-                                        {
-                                            break;
-                                        }
-
-                                }
-
+                            token[--len] = '\0';
                         }
 
-                    /* Handle IPv6 fe80::b614:89ff:fe11:5e24#12345 or inet#fe80::b614:89ff:fe11:5e24 */
-
-                    if ( num_hashes == 1 && num_colons > 2 )
+                    if ( Parse_IP_Split( &lookup_cache[current_position], token, '#', IPv6 ) == true )
                         {
+                            current_position++;
+                        }
 
-                            /* test both sides */
-
-                            ip_1 = strtok_r(ptr1, "#", &ip_2);
-
-                            if ( ip_1 != NULL )
-                                {
-                                    valid = inet_pton(AF_INET6, ip_1,  &(sa.sin_addr));
-                                }
-
-                            if ( valid == 1 )
-                                {
-
-                                    if ( debug->debugparse_ip )
-                                        {
-                                            Sagan_Log(DEBUG, "[%s:%lu] ** Identified IPv6#PORT **", __FUNCTION__, pthread_self() );
-                                        }
-
-
-                                    memcpy(lookup_cache[current_position].ip, ip_1, MAXIP);
-                                    memset(lookup_cache[current_position].ip_bits, 0, MAXIPBIT);
-                                    IP2Bit(ip_1, lookup_cache[current_position].ip_bits);
-
-                                    /* In many cases, the port is after the : */
-
-                                    port = atoi(ip_2);
-
-                                    if ( port == 0 )
-                                        {
-                                            lookup_cache[current_position].port = config->sagan_port;
+                }
 
-                                        }
-                                    else
-                                        {
+            /* Stand alone IPv6,  possibly followed by "port 1234" */
 
-                                            lookup_cache[current_position].port = port;
-                                        }
+            else if ( Parse_IP_Store( &lookup_cache[current_position], token, IPv6 ) == true )
+                {
 
-                                    lookup_cache[current_position].status = 1;
-                                    current_position++;
+                    if ( debug->debugparse_ip )
+                        {
+                            Sagan_Log(DEBUG, "[%s:%lu] ** Identified stand alone IPv6 address '%s' **", __FUNCTION__, pthread_self(), token );
+                        }
 
-                                    /* If we've run to the end, we're done */
+                    Parse_IP_Unmap( &lookup_cache[current_position] );
+                    Parse_IP_Port_Words( p, &lookup_cache[current_position], true );
+                    current_position++;
+                }
 
-                                    if ( current_position > MAX_PARSE_IP )
-                                        {
-                                            break;
-                                        }
+            /* Stand alone IPv6 with trailing period */
 
-                                }
+            else if ( token[len-1] == '.' )
+                {
 
-                            if ( ip_2 != NULL )
-                                {
-                                    valid = inet_pton(AF_INET6, ip_2,  &(sa.sin_addr));
-                                }
+                    token[--len] = '\0';
 
-                            if ( valid == 1 )
+                    if ( Parse_IP_Store( &lookup_cache[current_position], token, IPv6 ) == true )
+                        {
 
+                            if ( debug->debugparse_ip )
                                 {
-
-                                    if ( debug->debugparse_ip )
-                                        {
-                                            Sagan_Log(DEBUG, "[%s:%lu] ** Identified INTERFACE#IPv6 **", __FUNCTION__, pthread_self() );
-                                        }
-
-
-                                    memcpy(lookup_cache[current_position].ip, ip_2, MAXIP);
-                                    memset(lookup_cache[current_position].ip_bits, 0, MAXIPBIT);
-                                    IP2Bit(ip_2, lookup_cache[current_position].ip_bits);
-                                    lookup_cache[current_position].port = config->sagan_port;
-                                    lookup_cache[current_position].status = 1;
-
-                                    current_position++;
-
-                                    /* If we've run to the end, we're done */
-
-                                    if ( current_position > MAX_PARSE_IP )
-                                        {
-                                            break;
-                                        }
-
-
+                                    Sagan_Log(DEBUG, "[%s:%lu] ** Identified stand alone IPv6 '%s' with trailing period. **", __FUNCTION__, pthread_self(), token );
                                 }
 
+                            Parse_IP_Unmap( &lookup_cache[current_position] );
+                            lookup_cache[current_position].port = config->sagan_port;
+                            current_position++;
                         }
 
-                } /* If config->parse_ip_ipv6 */
-
-            ptr1 = strtok_r(NULL, " ", &ptr2);
-
-        }
+                }
 
-    for ( i = 0; i < current_position; i++)
-        {
-            lookup_cache[current_position].status = 0;
         }
 
     if ( debug->debugparse_ip )
         {
 
-
             if ( current_position > 0 )
                 {
 
                     Sagan_Log(DEBUG, "[%lld:%d] --[Lookup Cache Array]----", pthread_self(), current_position );
 
-
                     for (i = 0; i < current_position; i++)
                         {
-
                             Sagan_Log(DEBUG, "-- ARRAY: Position: %d, Status: %d, IP: %s, Port: %d", i, lookup_cache[i].status, lookup_cache[i].ip, lookup_cache[i].port);
                         }
 
                 }
 
-
         }
 
-
     return(current_position);
 }
 
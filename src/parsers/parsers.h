@@ -30,8 +30,7 @@ int   Parse_Src_Port( char * );
 int   Parse_Dst_Port( char * );
 int   Parse_Proto( char * );
 int   Parse_Proto_Program( char * );
-void  Parse_Hash( char *, int, char *str, size_t size );
-void  Parse_Hash_Cleanup(char *, char *str, size_t size );
+void  Parse_Hash( char *, char *md5, size_t md5_size, char *sha1, size_t sha1_size, char *sha256, size_t sha256_size );
 
 /* IP Lookup cache */
 
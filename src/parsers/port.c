@@ -66,7 +66,6 @@ int Parse_Src_Port (char *msg)
     char *tmpport=NULL;
 
     int i;
-    struct sockaddr_in sa;
     int result;
 
     port = config->sagan_port;
@@ -200,7 +199,7 @@ int Parse_Src_Port (char *msg)
                     token = strtok_r(NULL, " ", &saveptr2);
                     if ( token == NULL ) break;
 
-                    result = inet_pton(AF_INET, token,  &(sa.sin_addr));
+                    result = Is_IP(token, IPv4);
 
                     /* Found IP,  get the port */
                     if ( result != 0 )
@@ -32,13 +32,15 @@
 #include "sagan.h"
 #include "sagan-defs.h"
 #include "rules.h"
+#include "rule-generation.h"
 
-struct _Rule_Struct *rulestruct;
 
 
 bool PcreS ( int rule_position, const char *syslog_message )
 {
 
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
+
 
     int z = 0;
     int match = 0;
@@ -46,10 +48,10 @@ bool PcreS ( int rule_position, const char *syslog_message )
     int ovector[PCRE_OVECCOUNT];
 
 
-    for(z=0; z<rulestruct[rule_position].pcre_count; z++)
+    for(z=0; z<gen->rulestruct[rule_position].pcre_count; z++)
         {
 
-            rc = pcre_exec( rulestruct[rule_position].re_pcre[z], rulestruct[rule_position].pcre_extra[z], syslog_message, (int)strlen(syslog_message), 0, 0, ovector, PCRE_OVECCOUNT);
+            rc = pcre_exec( gen->rulestruct[rule_position].re_pcre[z], gen->rulestruct[rule_position].pcre_extra[z], syslog_message, (int)strlen(syslog_message), 0, 0, ovector, PCRE_OVECCOUNT);
 
             if ( rc > 0 )
                 {
@@ -58,7 +60,7 @@ bool PcreS ( int rule_position, const char *syslog_message )
 
         }
 
-    if ( match == rulestruct[rule_position].pcre_count )
+    if ( match == gen->rulestruct[rule_position].pcre_count )
         {
             return(true);
         }
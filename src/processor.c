@@ -44,12 +44,17 @@
 #include "sagan-config.h"
 #include "input-pipe.h"
 #include "parsers/parsers.h"
+#include "routing.h"
+#include "event-cache.h"
 
 #ifdef HAVE_LIBFASTJSON
 #include "input-json.h"
 #include "message-json-map.h"
 #endif
 
+#include "thread-context.h"
+#include "rule-epoch.h"
+
 #include "processors/engine.h"
 #include "processors/track-clients.h"
 #include "processors/blacklist.h"
@@ -66,7 +71,6 @@ struct _SaganDebug *debug;
 int proc_msgslot; 		/* Comes from sagan.c */
 int proc_running;   	        /* Comes from sagan.c */
 
-bool dynamic_rule_flag = NORMAL_RULE;
 uint32_t dynamic_line_count = 0;
 
 
@@ -75,11 +79,82 @@ bool death=false;
 pthread_cond_t SaganProcDoWork;
 pthread_mutex_t SaganProcWorkMutex;
 
-pthread_cond_t SaganReloadCond;
-pthread_mutex_t SaganReloadMutex;
-
 pthread_mutex_t SaganDynamicFlag;
 
+/****************************************************************************
+ * Processor_Input - Parse a raw log line
+ ****************************************************************************/
+
+static void Processor_Input( char *syslog, struct _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL )
+{
+
+    if ( config->input_type == INPUT_PIPE )
+        {
+            SyslogInput_Pipe( syslog, SaganProcSyslog_LOCAL );
+        }
+    else
+        {
+            SyslogInput_JSON( syslog, SaganProcSyslog_LOCAL );
+        }
+
+    if (debug->debugsyslog)
+        {
+            Sagan_Log(DEBUG, "[%s, line %d] **[Parsed Syslog]*********************************", __FILE__, __LINE__);
+            Sagan_Log(DEBUG, "[%s, line %d] Host: %s | Program: %s | Facility: %s | Priority: %s | Level: %s | Tag: %s | Date: %s | Time: %s | Event ID: %s", __FILE__, __LINE__, SaganProcSyslog_LOCAL->syslog_host, SaganProcSyslog_LOCAL->syslog_program, SaganProcSyslog_LOCAL->syslog_facility, SaganProcSyslog_LOCAL->syslog_priority, SaganProcSyslog_LOCAL->syslog_level, SaganProcSyslog_LOCAL->syslog_tag, SaganProcSyslog_LOCAL->syslog_date, SaganProcSyslog_LOCAL->syslog_time, SaganProcSyslog_LOCAL->event_id);
+            Sagan_Log(DEBUG, "[%s, line %d] Parsed message: %s", __FILE__, __LINE__,  SaganProcSyslog_LOCAL->syslog_message);
+        }
+
+}
+
+/****************************************************************************
+ * Processor_Dynamic - Is it time for this event to run the dynamic rules?
+ ****************************************************************************/
+
+static bool Processor_Dynamic( void )
+{
+
+    bool flag = NORMAL_RULE;
+
+    if ( config->dynamic_load_flag == true )
+        {
+
+            __atomic_add_fetch(&dynamic_line_count, 1, __ATOMIC_SEQ_CST);
+
+            if ( dynamic_line_count >= config->dynamic_load_sample_rate )
+                {
+                    flag = DYNAMIC_RULE;
+
+                    __atomic_store_n (&dynamic_line_count, 0, __ATOMIC_SEQ_CST);
+
+                }
+        }
+
+    return(flag);
+
+}
+
+/****************************************************************************
+ * Processor_Track - Per event work done after the rules have run
+ ****************************************************************************/
+
+static void Processor_Track( struct _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL )
+{
+
+    if ( config->client_stats_flag )
+        {
+
+            Client_Stats_Add_Update_IP ( SaganProcSyslog_LOCAL->syslog_host, SaganProcSyslog_LOCAL->syslog_program, SaganProcSyslog_LOCAL->syslog_message );
+
+        }
+
+
+    if ( config->sagan_track_clients_flag )
+        {
+            Track_Clients( SaganProcSyslog_LOCAL->syslog_host );
+        }
+
+}
+
 void Processor ( void )
 {
 
@@ -106,7 +181,33 @@ void Processor ( void )
 
     memset(SaganPassSyslog_LOCAL, 0, sizeof(struct _Sagan_Pass_Syslog));
 
+    /* "rule-evaluation: batch" parses several events before running the
+       rules over them.  See Sagan_Engine_Batch() */
+
+    struct _Sagan_Proc_Syslog *SaganProcSyslog_BATCH = NULL;
+    bool dynamic_rule_flags[ENGINE_BATCH_MAX] = { 0 };
+
+    if ( config->rule_eval_batch == true && config->max_batch > 1 )
+        {
+
+            SaganProcSyslog_BATCH = malloc(ENGINE_BATCH_MAX * sizeof(struct _Sagan_Proc_Syslog));
+
+            if ( SaganProcSyslog_BATCH == NULL )
+                {
+                    Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for SaganProcSyslog_BATCH. Abort!", __FILE__, __LINE__);
+                }
+
+            memset(SaganProcSyslog_BATCH, 0, ENGINE_BATCH_MAX * sizeof(struct _Sagan_Proc_Syslog));
+        }
+
+    /* Allocate this threads working memory now,  rather than on the first
+       log line.  See thread-context.c */
+
+    (void)Thread_Context();
+
     int i;
+    int e;
+    int batch_count = 0;
 
     while(death == false)
         {
@@ -115,11 +216,6 @@ void Processor ( void )
 
             while ( proc_msgslot == 0 ) pthread_cond_wait(&SaganProcDoWork, &SaganProcWorkMutex);
 
-            if ( config->sagan_reload )
-                {
-                    pthread_cond_wait(&SaganReloadCond, &SaganReloadMutex);
-                }
-
             proc_msgslot--;     /* This was ++ before coming over, so we now -- it to get to
                                  * original value */
 
@@ -143,70 +239,65 @@ void Processor ( void )
 
             __atomic_add_fetch(&proc_running, 1, __ATOMIC_SEQ_CST);
 
-            /* Process local syslog buffer */
+            /* Rule memory replaced by a dynamic load or a SIGHUP isn't free()'ed
+               until we are done with this buffer,  and a SIGHUP holds us here
+               while it reloads the configuration.  See rule-epoch.c */
 
-            for (i=0; i < config->max_batch; i++)
-                {
+            Rule_Epoch_Enter();
 
-//		    memset(SaganProcSyslog_LOCAL, 0, sizeof(struct _Sagan_Proc_Syslog));
-
-                    if ( config->input_type == INPUT_PIPE )
-                        {
-                            SyslogInput_Pipe( SaganPassSyslog_LOCAL->syslog[i], SaganProcSyslog_LOCAL );
-                        }
-                    else
-                        {
-                            SyslogInput_JSON( SaganPassSyslog_LOCAL->syslog[i], SaganProcSyslog_LOCAL );
-                        }
+            /* Process local syslog buffer */
 
-                    if (debug->debugsyslog)
-                        {
-                            Sagan_Log(DEBUG, "[%s, line %d] **[Parsed Syslog]*********************************", __FILE__, __LINE__);
-                            Sagan_Log(DEBUG, "[%s, line %d] Host: %s | Program: %s | Facility: %s | Priority: %s | Level: %s | Tag: %s | Date: %s | Time: %s | Event ID: %s", __FILE__, __LINE__, SaganProcSyslog_LOCAL->syslog_host, SaganProcSyslog_LOCAL->syslog_program, SaganProcSyslog_LOCAL->syslog_facility, SaganProcSyslog_LOCAL->syslog_priority, SaganProcSyslog_LOCAL->syslog_level, SaganProcSyslog_LOCAL->syslog_tag, SaganProcSyslog_LOCAL->syslog_date, SaganProcSyslog_LOCAL->syslog_time, SaganProcSyslog_LOCAL->event_id);
-                            Sagan_Log(DEBUG, "[%s, line %d] Parsed message: %s", __FILE__, __LINE__,  SaganProcSyslog_LOCAL->syslog_message);
-                        }
+            if ( SaganProcSyslog_BATCH != NULL )
+                {
 
-                    /* Dynamic goes here */
+                    /* "rule-evaluation: batch" - ENGINE_BATCH_MAX events at a time */
 
-                    if ( config->dynamic_load_flag == true )
+                    for (i=0; i < config->max_batch; i = i + batch_count)
                         {
 
-                            __atomic_add_fetch(&dynamic_line_count, 1, __ATOMIC_SEQ_CST);
+                            batch_count = config->max_batch - i;
 
-                            if ( dynamic_line_count >= config->dynamic_load_sample_rate )
+                            if ( batch_count > ENGINE_BATCH_MAX )
                                 {
-                                    dynamic_rule_flag = DYNAMIC_RULE;
-
-                                    __atomic_store_n (&dynamic_line_count, 0, __ATOMIC_SEQ_CST);
+                                    batch_count = ENGINE_BATCH_MAX;
+                                }
 
+                            for (e=0; e < batch_count; e++)
+                                {
+                                    Processor_Input( SaganPassSyslog_LOCAL->syslog[i+e], &SaganProcSyslog_BATCH[e] );
+                                    dynamic_rule_flags[e] = Processor_Dynamic();
                                 }
-                        }
 
-                    (void)Sagan_Engine(SaganProcSyslog_LOCAL, dynamic_rule_flag );
+                            Sagan_Engine_Batch(SaganProcSyslog_BATCH, dynamic_rule_flags, batch_count );
 
-                    /* If this is a dynamic run,  reset back to normal */
+                            for (e=0; e < batch_count; e++)
+                                {
+                                    Processor_Track( &SaganProcSyslog_BATCH[e] );
+                                }
 
-                    if ( dynamic_rule_flag == DYNAMIC_RULE )
-                        {
-                            dynamic_rule_flag = NORMAL_RULE;
                         }
 
+                }
+            else
+                {
 
-                    if ( config->client_stats_flag )
+                    for (i=0; i < config->max_batch; i++)
                         {
 
-                            Client_Stats_Add_Update_IP ( SaganProcSyslog_LOCAL->syslog_host, SaganProcSyslog_LOCAL->syslog_program, SaganProcSyslog_LOCAL->syslog_message );
+//		            memset(SaganProcSyslog_LOCAL, 0, sizeof(struct _Sagan_Proc_Syslog));
 
-                        }
+                            Processor_Input( SaganPassSyslog_LOCAL->syslog[i], SaganProcSyslog_LOCAL );
 
+                            (void)Sagan_Engine(SaganProcSyslog_LOCAL, Processor_Dynamic() );
+
+                            Processor_Track( SaganProcSyslog_LOCAL );
 
-                    if ( config->sagan_track_clients_flag )
-                        {
-                            Track_Clients( SaganProcSyslog_LOCAL->syslog_host );
                         }
 
                 }
 
+            Rule_Epoch_Exit();
+
             __atomic_sub_fetch(&proc_running, 1, __ATOMIC_SEQ_CST);
 
         } /*  for (;;) */
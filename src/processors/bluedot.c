@@ -45,6 +45,8 @@
 #include "sagan-defs.h"
 #include "sagan-config.h"
 #include "rules.h"
+#include "rule-generation.h"
+#include "util-time.h"
 
 #include "processors/bluedot.h"
 
@@ -69,7 +71,6 @@ struct _Sagan_Bluedot_URL_Queue *SaganBluedotURLQueue = NULL;
 struct _Sagan_Bluedot_Filename_Queue *SaganBluedotFilenameQueue = NULL;
 struct _Sagan_Bluedot_JA3_Queue *SaganBluedotJA3Queue = NULL;
 
-struct _Rule_Struct *rulestruct;
 
 pthread_mutex_t SaganProcBluedotWorkMutex=PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t CounterBluedotGenericMutex=PTHREAD_MUTEX_INITIALIZER;
@@ -92,16 +93,7 @@ bool bluedot_dns_global=0;
 void Sagan_Bluedot_Init(void)
 {
 
-    char  timet[20] = { 0 };
-
-    time_t t;
-    struct tm *now = NULL;
-
-    t = time(NULL);
-    now=localtime(&t);
-    strftime(timet, sizeof(timet), "%s",  now);
-
-    config->bluedot_last_time = atol(timet);
+    config->bluedot_last_time = Return_Epoch();
 
     /* Bluedot IP Cache */
 
@@ -265,22 +257,18 @@ void Sagan_Bluedot_Init(void)
  * happens a lot with IP address looks
  ****************************************************************************/
 
-int Sagan_Bluedot_Clean_Queue ( char *data, unsigned char type )
+int Sagan_Bluedot_Clean_Queue ( char *data, unsigned char *ip_bits, unsigned char type )
 {
 
     int i=0;
 
-    unsigned char ip_convert[MAXIPBIT] = { 0 };
-
     if ( type == BLUEDOT_LOOKUP_IP && config->bluedot_ip_max_cache > 0 )
         {
 
-            IP2Bit(data, ip_convert);
-
             for (i=0; i<config->bluedot_ip_queue; i++)
                 {
 
-                    if ( !memcmp(ip_convert, SaganBluedotIPQueue[i].ip, MAXIPBIT) )
+                    if ( !memcmp(ip_bits, SaganBluedotIPQueue[i].ip, MAXIPBIT) )
                         {
 
                             pthread_mutex_lock(&SaganProcBluedotIPWorkMutex);
@@ -464,16 +452,7 @@ void Sagan_Bluedot_Load_Cat(void)
 void Sagan_Bluedot_Check_Cache_Time (void)
 {
 
-    time_t t;
-    struct tm *now = NULL;
-
-    char  timet[20] = { 0 };
-
-    t = time(NULL);
-    now=localtime(&t);
-    strftime(timet, sizeof(timet), "%s",  now);
-
-    if ( bluedot_cache_clean_lock == 0 && atol(timet) > ( config->bluedot_last_time + config->bluedot_timeout ) )
+    if ( bluedot_cache_clean_lock == 0 && Return_Epoch() > ( config->bluedot_last_time + config->bluedot_timeout ) )
         {
 
             pthread_mutex_lock(&SaganProcBluedotWorkMutex);
@@ -533,15 +512,7 @@ void Sagan_Bluedot_Clean_Cache ( void )
     int new_bluedot_filename_max_cache = 0;
     int new_bluedot_ja3_max_cache = 0;
 
-    char  timet[20] = { 0 };
-    time_t t;
-    struct tm *now=NULL;
-    uint64_t timeint;
-
-    t = time(NULL);
-    now=localtime(&t);
-    strftime(timet, sizeof(timet), "%s",  now);
-    timeint = atol(timet);
+    uint64_t timeint = Return_Epoch();
 
     if (debug->debugbluedot)
         {
@@ -760,8 +731,9 @@ void Sagan_Bluedot_Clean_Cache ( void )
 }
 
 /***************************************************************************
- * Sagan_Bluedot_IP_Lookup - This does the actual Bluedot lookup.  It returns
- * the bluedot_alertid value (0 if not found)
+ * Bluedot_Lookup - This does the actual Bluedot lookup.  It returns
+ * the bluedot_alertid value (0 if not found).  "ip_bits" is only used
+ * for BLUEDOT_LOOKUP_IP.
  ***************************************************************************/
 
 /* type
@@ -773,10 +745,10 @@ void Sagan_Bluedot_Clean_Cache ( void )
  * 5 == JA3
  */
 
-unsigned char Sagan_Bluedot_Lookup(char *data,  unsigned char type, int rule_position, char *bluedot_str, size_t bluedot_size )
+static unsigned char Bluedot_Lookup( char *data, unsigned char *ip_bits, unsigned char type, int rule_position, char *bluedot_str, size_t bluedot_size )
 {
 
-    unsigned char ip_convert[MAXIPBIT] = { 0 };
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
 
     char buff[2048] = { 0 };
     char tmpdeviceid[64] = { 0 };
@@ -805,15 +777,7 @@ unsigned char Sagan_Bluedot_Lookup(char *data,  unsigned char type, int rule_pos
 
     char tmp[64] = { 0 };
 
-    char  timet[20] = { 0 };
-    time_t t;
-    struct tm *now=NULL;
-
-    t = time(NULL);
-    now=localtime(&t);
-    strftime(timet, sizeof(timet), "%s",  now);
-
-    uint64_t epoch_time = atol(timet);
+    uint64_t epoch_time = Return_Epoch();
 
     /* Check IP TTL for Bluedot */
 
@@ -863,13 +827,7 @@ unsigned char Sagan_Bluedot_Lookup(char *data,  unsigned char type, int rule_pos
     if ( type == BLUEDOT_LOOKUP_IP )
         {
 
-            /* For some reason, when I try to use the IP2Bit passed from engine.c,  it
-               is sometimes 16 bytes off!  Not idea why and doesn't happen all the time.
-               We call IP2Bit here to prevent it from getting off :(  Champ 2019/05/14 */
-
-            IP2Bit(data, ip_convert);
-
-            if ( is_notroutable(ip_convert) )
+            if ( is_notroutable(ip_bits) )
                 {
 
                     if ( debug->debugbluedot )
@@ -883,7 +841,7 @@ unsigned char Sagan_Bluedot_Lookup(char *data,  unsigned char type, int rule_pos
             for ( i = 0; i < counters->bluedot_skip_count; i++ )
                 {
 
-                    if ( is_inrange(ip_convert, (unsigned char *)&Bluedot_Skip[i].range, 1) )
+                    if ( is_inrange(ip_bits, (unsigned char *)&Bluedot_Skip[i].range, 1) )
                         {
 
                             if ( debug->debugbluedot )
@@ -900,7 +858,7 @@ unsigned char Sagan_Bluedot_Lookup(char *data,  unsigned char type, int rule_pos
             for (i=0; i<config->bluedot_ip_max_cache; i++)
                 {
 
-                    if (!memcmp( ip_convert, SaganBluedotIPCache[i].ip, MAXIPBIT ))
+                    if (!memcmp( ip_bits, SaganBluedotIPCache[i].ip, MAXIPBIT ))
                         {
 
                             if (debug->debugbluedot)
@@ -910,15 +868,15 @@ unsigned char Sagan_Bluedot_Lookup(char *data,  unsigned char type, int rule_pos
 
                             bluedot_alertid = SaganBluedotIPCache[i].alertid;
 
-                            if ( bluedot_alertid != 0 && rulestruct[rule_position].bluedot_mdate_effective_period != 0 )
+                            if ( bluedot_alertid != 0 && gen->rulestruct[rule_position].bluedot_mdate_effective_period != 0 )
                                 {
 
-                                    if ( ( epoch_time - SaganBluedotIPCache[i].mdate_utime ) > rulestruct[rule_position].bluedot_mdate_effective_period )
+                                    if ( ( epoch_time - SaganBluedotIPCache[i].mdate_utime ) > gen->rulestruct[rule_position].bluedot_mdate_effective_period )
                                         {
 
                                             if ( debug->debugbluedot )
                                                 {
-                                                    Sagan_Log(DEBUG, "[%s, line %d] From Bluedot Cache - mdate_epoch for %s is over %d seconds.  Not alerting.", __FILE__, __LINE__, data, rulestruct[rule_position].bluedot_mdate_effective_period);
+                                                    Sagan_Log(DEBUG, "[%s, line %d] From Bluedot Cache - mdate_epoch for %s is over %d seconds.  Not alerting.", __FILE__, __LINE__, data, gen->rulestruct[rule_position].bluedot_mdate_effective_period);
                                                 }
 
                                             __atomic_add_fetch(&counters->bluedot_mdate_cache, 1, __ATOMIC_SEQ_CST);
@@ -927,15 +885,15 @@ unsigned char Sagan_Bluedot_Lookup(char *data,  unsigned char type, int rule_pos
                                         }
                                 }
 
-                            else if ( bluedot_alertid != 0 && rulestruct[rule_position].bluedot_cdate_effective_period != 0 )
+                            else if ( bluedot_alertid != 0 && gen->rulestruct[rule_position].bluedot_cdate_effective_period != 0 )
                                 {
 
-                                    if ( ( epoch_time - SaganBluedotIPCache[i].cdate_utime ) > rulestruct[rule_position].bluedot_cdate_effective_period )
+                                    if ( ( epoch_time - SaganBluedotIPCache[i].cdate_utime ) > gen->rulestruct[rule_position].bluedot_cdate_effective_period )
                                         {
 
                                             if ( debug->debugbluedot )
                                                 {
-                                                    Sagan_Log(DEBUG, "[%s, line %d] ctime_epoch for %s is over %d seconds.  Not alerting.", __FILE__, __LINE__, data, rulestruct[rule_position].bluedot_cdate_effective_period);
+                                                    Sagan_Log(DEBUG, "[%s, line %d] ctime_epoch for %s is over %d seconds.  Not alerting.", __FILE__, __LINE__, data, gen->rulestruct[rule_position].bluedot_cdate_effective_period);
                                                 }
 
                                             __atomic_add_fetch(&counters->bluedot_cdate_cache, 1, __ATOMIC_SEQ_CST);
@@ -957,7 +915,7 @@ unsigned char Sagan_Bluedot_Lookup(char *data,  unsigned char type, int rule_pos
 
             for (i=0; i < config->bluedot_ip_queue; i++)
                 {
-                    if ( !memcmp(ip_convert, SaganBluedotIPQueue[i].ip, MAXIPBIT ))
+                    if ( !memcmp(ip_bits, SaganBluedotIPQueue[i].ip, MAXIPBIT ))
                         {
                             if (debug->debugbluedot)
                                 {
@@ -986,7 +944,7 @@ unsigned char Sagan_Bluedot_Lookup(char *data,  unsigned char type, int rule_pos
                         {
                             pthread_mutex_lock(&SaganProcBluedotIPWorkMutex);
 
-                            memcpy(SaganBluedotIPQueue[i].ip, ip_convert, MAXIPBIT);
+                            memcpy(SaganBluedotIPQueue[i].ip, ip_bits, MAXIPBIT);
                             counters->bluedot_ip_queue_current++;
 
                             pthread_mutex_unlock(&SaganProcBluedotIPWorkMutex);
@@ -1428,7 +1386,7 @@ unsigned char Sagan_Bluedot_Lookup(char *data,  unsigned char type, int rule_pos
 
             /* Store data into cache */
 
-            memcpy(SaganBluedotIPCache[counters->bluedot_ip_cache_count].ip, ip_convert, MAXIPBIT);
+            memcpy(SaganBluedotIPCache[counters->bluedot_ip_cache_count].ip, ip_bits, MAXIPBIT);
             strlcpy(SaganBluedotIPCache[counters->bluedot_ip_cache_count].bluedot_json, json_final, sizeof(SaganBluedotIPCache[counters->bluedot_ip_cache_count].bluedot_json));
             SaganBluedotIPCache[counters->bluedot_ip_cache_count].cache_utime = epoch_time;                   /* store utime */
             SaganBluedotIPCache[counters->bluedot_ip_cache_count].cdate_utime = cdate_utime_u32;
@@ -1440,15 +1398,15 @@ unsigned char Sagan_Bluedot_Lookup(char *data,  unsigned char type, int rule_pos
 
             pthread_mutex_unlock(&SaganProcBluedotIPWorkMutex);
 
-            if ( bluedot_alertid != 0 && rulestruct[rule_position].bluedot_mdate_effective_period != 0 )
+            if ( bluedot_alertid != 0 && gen->rulestruct[rule_position].bluedot_mdate_effective_period != 0 )
                 {
 
-                    if ( ( epoch_time - mdate_utime_u32 ) > rulestruct[rule_position].bluedot_mdate_effective_period )
+                    if ( ( epoch_time - mdate_utime_u32 ) > gen->rulestruct[rule_position].bluedot_mdate_effective_period )
                         {
 
                             if ( debug->debugbluedot )
                                 {
-                                    Sagan_Log(DEBUG, "[%s, line %d] mdate_epoch for %s is over %d seconds.  Not alerting.", __FILE__, __LINE__, data, rulestruct[rule_position].bluedot_mdate_effective_period);
+                                    Sagan_Log(DEBUG, "[%s, line %d] mdate_epoch for %s is over %d seconds.  Not alerting.", __FILE__, __LINE__, data, gen->rulestruct[rule_position].bluedot_mdate_effective_period);
                                 }
 
                             __atomic_add_fetch(&counters->bluedot_mdate, 1, __ATOMIC_SEQ_CST);
@@ -1457,15 +1415,15 @@ unsigned char Sagan_Bluedot_Lookup(char *data,  unsigned char type, int rule_pos
                         }
                 }
 
-            else if ( bluedot_alertid != 0 && rulestruct[rule_position].bluedot_cdate_effective_period != 0 )
+            else if ( bluedot_alertid != 0 && gen->rulestruct[rule_position].bluedot_cdate_effective_period != 0 )
                 {
 
-                    if ( ( epoch_time - cdate_utime_u32 ) > rulestruct[rule_position].bluedot_cdate_effective_period )
+                    if ( ( epoch_time - cdate_utime_u32 ) > gen->rulestruct[rule_position].bluedot_cdate_effective_period )
                         {
 
                             if ( debug->debugbluedot )
                                 {
-                                    Sagan_Log(DEBUG, "[%s, line %d] cdate_epoch for %s is over %d seconds.  Not alerting.", __FILE__, __LINE__, data, rulestruct[rule_position].bluedot_cdate_effective_period);
+                                    Sagan_Log(DEBUG, "[%s, line %d] cdate_epoch for %s is over %d seconds.  Not alerting.", __FILE__, __LINE__, data, gen->rulestruct[rule_position].bluedot_cdate_effective_period);
                                 }
 
                             __atomic_add_fetch(&counters->bluedot_cdate, 1, __ATOMIC_SEQ_CST);
@@ -1550,7 +1508,7 @@ unsigned char Sagan_Bluedot_Lookup(char *data,  unsigned char type, int rule_pos
             pthread_mutex_unlock(&SaganProcBluedotJA3WorkMutex);
         }
 
-    Sagan_Bluedot_Clean_Queue(data, type);	/* Remove item for "queue" */
+    Sagan_Bluedot_Clean_Queue(data, ip_bits, type);	/* Remove item for "queue" */
 
     json_object_put(json_in);       		/* Clear json_in as we're done with it */
 
@@ -1559,6 +1517,35 @@ unsigned char Sagan_Bluedot_Lookup(char *data,  unsigned char type, int rule_pos
     return(bluedot_alertid);
 }
 
+/***************************************************************************
+ * Sagan_Bluedot_Lookup - Lookup by string.  IP addresses are parsed here
+ * and handed to Sagan_Bluedot_Lookup_IP().
+ ***************************************************************************/
+
+unsigned char Sagan_Bluedot_Lookup(char *data,  unsigned char type, int rule_position, char *bluedot_str, size_t bluedot_size )
+{
+
+    struct _Sagan_IP addr;
+
+    if ( type == BLUEDOT_LOOKUP_IP )
+        {
+            IP_Set( &addr, data );
+            return( Sagan_Bluedot_Lookup_IP( &addr, rule_position, bluedot_str, bluedot_size ) );
+        }
+
+    return( Bluedot_Lookup( data, NULL, type, rule_position, bluedot_str, bluedot_size ) );
+}
+
+/***************************************************************************
+ * Sagan_Bluedot_Lookup_IP - Lookup an address the engine has already
+ * parsed.  The binary form is used for the cache,  queue and skip checks.
+ ***************************************************************************/
+
+unsigned char Sagan_Bluedot_Lookup_IP( struct _Sagan_IP *addr, int rule_position, char *bluedot_str, size_t bluedot_size )
+{
+    return( Bluedot_Lookup( IP_Text( addr ), addr->bits, BLUEDOT_LOOKUP_IP, rule_position, bluedot_str, bluedot_size ) );
+}
+
 /***************************************************************************
  * Sagan_Bluedot_Cat_Compare - Takes the Bluedot query results and
  * compares to what the rule is looking for
@@ -1567,15 +1554,17 @@ unsigned char Sagan_Bluedot_Lookup(char *data,  unsigned char type, int rule_pos
 int Sagan_Bluedot_Cat_Compare ( unsigned char bluedot_results, int rule_position, unsigned char type )
 {
 
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
+
     int i;
 
     if ( type == BLUEDOT_LOOKUP_IP )
         {
 
-            for ( i = 0; i < rulestruct[rule_position].bluedot_ip_cat_count; i++ )
+            for ( i = 0; i < gen->rulestruct[rule_position].bluedot_ip_cat_count; i++ )
                 {
 
-                    if ( bluedot_results == rulestruct[rule_position].bluedot_ip_cats[i] )
+                    if ( bluedot_results == gen->rulestruct[rule_position].bluedot_ip_cats[i] )
                         {
 
                             __atomic_add_fetch(&counters->bluedot_ip_positive_hit, 1, __ATOMIC_SEQ_CST);
@@ -1590,10 +1579,10 @@ int Sagan_Bluedot_Cat_Compare ( unsigned char bluedot_results, int rule_position
 
     if ( type == BLUEDOT_LOOKUP_HASH )
         {
-            for ( i = 0; i < rulestruct[rule_position].bluedot_hash_cat_count; i++ )
+            for ( i = 0; i < gen->rulestruct[rule_position].bluedot_hash_cat_count; i++ )
                 {
 
-                    if ( bluedot_results == rulestruct[rule_position].bluedot_hash_cats[i] )
+                    if ( bluedot_results == gen->rulestruct[rule_position].bluedot_hash_cats[i] )
                         {
                             __atomic_add_fetch(&counters->bluedot_hash_positive_hit, 1, __ATOMIC_SEQ_CST);
 
@@ -1605,10 +1594,10 @@ int Sagan_Bluedot_Cat_Compare ( unsigned char bluedot_results, int rule_position
 
     if ( type == BLUEDOT_LOOKUP_URL )
         {
-            for ( i = 0; i < rulestruct[rule_position].bluedot_url_cat_count; i++ )
+            for ( i = 0; i < gen->rulestruct[rule_position].bluedot_url_cat_count; i++ )
                 {
 
-                    if ( bluedot_results == rulestruct[rule_position].bluedot_url_cats[i] )
+                    if ( bluedot_results == gen->rulestruct[rule_position].bluedot_url_cats[i] )
                         {
 
                             __atomic_add_fetch(&counters->bluedot_url_positive_hit, 1, __ATOMIC_SEQ_CST);
@@ -1621,10 +1610,10 @@ int Sagan_Bluedot_Cat_Compare ( unsigned char bluedot_results, int rule_position
 
     if ( type == BLUEDOT_LOOKUP_FILENAME )
         {
-            for ( i = 0; i < rulestruct[rule_position].bluedot_filename_cat_count; i++ )
+            for ( i = 0; i < gen->rulestruct[rule_position].bluedot_filename_cat_count; i++ )
                 {
 
-                    if ( bluedot_results == rulestruct[rule_position].bluedot_filename_cats[i] )
+                    if ( bluedot_results == gen->rulestruct[rule_position].bluedot_filename_cats[i] )
                         {
                             __atomic_add_fetch(&counters->bluedot_filename_positive_hit, 1, __ATOMIC_SEQ_CST);
 
@@ -1638,10 +1627,10 @@ int Sagan_Bluedot_Cat_Compare ( unsigned char bluedot_results, int rule_position
 
     if ( type == BLUEDOT_LOOKUP_JA3 )
         {
-            for ( i = 0; i < rulestruct[rule_position].bluedot_ja3_cat_count; i++ )
+            for ( i = 0; i < gen->rulestruct[rule_position].bluedot_ja3_cat_count; i++ )
                 {
 
-                    if ( bluedot_results == rulestruct[rule_position].bluedot_ja3_cats[i] )
+                    if ( bluedot_results == gen->rulestruct[rule_position].bluedot_ja3_cats[i] )
                         {
                             __atomic_add_fetch(&counters->bluedot_ja3_positive_hit, 1, __ATOMIC_SEQ_CST);
 
@@ -1671,10 +1660,16 @@ int Sagan_Bluedot_IP_Lookup_All ( char *syslog_message, int rule_position, _Saga
 
     char bluedot_json[BLUEDOT_JSON_SIZE] = { 0 };
 
+    struct _Sagan_IP addr;
+
     for (i = 0; i < lookup_cache_size; i++)
         {
 
-            bluedot_results = Sagan_Bluedot_Lookup(lookup_cache[i].ip, BLUEDOT_LOOKUP_IP, rule_position, bluedot_json, sizeof(bluedot_json));
+            memcpy(addr.bits, lookup_cache[i].ip_bits, MAXIPBIT);
+            addr.family = lookup_cache[i].family;
+            addr.text = lookup_cache[i].ip;
+
+            bluedot_results = Sagan_Bluedot_Lookup_IP( &addr, rule_position, bluedot_json, sizeof(bluedot_json));
             bluedot_flag = Sagan_Bluedot_Cat_Compare( bluedot_results, rule_position, BLUEDOT_LOOKUP_IP );
 
             if ( bluedot_flag == 1 )
@@ -1690,6 +1685,8 @@ int Sagan_Bluedot_IP_Lookup_All ( char *syslog_message, int rule_position, _Saga
 void Sagan_Verify_Categories( char *categories, int rule_number, const char *ruleset, int linecount, unsigned char type )
 {
 
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
+
     char tmp2[64];
     char *tmptoken;
     char *saveptrrule;
@@ -1721,10 +1718,10 @@ void Sagan_Verify_Categories( char *categories, int rule_number, const char *rul
                             if ( type == BLUEDOT_LOOKUP_IP )
                                 {
 
-                                    if ( rulestruct[rule_number].bluedot_ip_cat_count <= BLUEDOT_MAX_CAT )
+                                    if ( gen->rulestruct[rule_number].bluedot_ip_cat_count <= BLUEDOT_MAX_CAT )
                                         {
-                                            rulestruct[rule_number].bluedot_ip_cats[rulestruct[rule_number].bluedot_ip_cat_count] =  SaganBluedotCatList[i].cat_number;
-                                            rulestruct[rule_number].bluedot_ip_cat_count++;
+                                            gen->rulestruct[rule_number].bluedot_ip_cats[gen->rulestruct[rule_number].bluedot_ip_cat_count] =  SaganBluedotCatList[i].cat_number;
+                                            gen->rulestruct[rule_number].bluedot_ip_cat_count++;
                                         }
                                     else
                                         {
@@ -1734,10 +1731,10 @@ void Sagan_Verify_Categories( char *categories, int rule_number, const char *rul
 
                             if ( type == BLUEDOT_LOOKUP_HASH )
                                 {
-                                    if ( rulestruct[rule_number].bluedot_hash_cat_count <= BLUEDOT_MAX_CAT )
+                                    if ( gen->rulestruct[rule_number].bluedot_hash_cat_count <= BLUEDOT_MAX_CAT )
                                         {
-                                            rulestruct[rule_number].bluedot_hash_cats[rulestruct[rule_number].bluedot_hash_cat_count] =  SaganBluedotCatList[i].cat_number;
-                                            rulestruct[rule_number].bluedot_hash_cat_count++;
+                                            gen->rulestruct[rule_number].bluedot_hash_cats[gen->rulestruct[rule_number].bluedot_hash_cat_count] =  SaganBluedotCatList[i].cat_number;
+                                            gen->rulestruct[rule_number].bluedot_hash_cat_count++;
                                         }
                                     else
                                         {
@@ -1747,10 +1744,10 @@ void Sagan_Verify_Categories( char *categories, int rule_number, const char *rul
 
                             if ( type == BLUEDOT_LOOKUP_URL )
                                 {
-                                    if ( rulestruct[rule_number].bluedot_url_cat_count <= BLUEDOT_MAX_CAT )
+                                    if ( gen->rulestruct[rule_number].bluedot_url_cat_count <= BLUEDOT_MAX_CAT )
                                         {
-                                            rulestruct[rule_number].bluedot_url_cats[rulestruct[rule_number].bluedot_url_cat_count] =  SaganBluedotCatList[i].cat_number;
-                                            rulestruct[rule_number].bluedot_url_cat_count++;
+                                            gen->rulestruct[rule_number].bluedot_url_cats[gen->rulestruct[rule_number].bluedot_url_cat_count] =  SaganBluedotCatList[i].cat_number;
+                                            gen->rulestruct[rule_number].bluedot_url_cat_count++;
                                         }
                                     else
                                         {
@@ -1760,10 +1757,10 @@ void Sagan_Verify_Categories( char *categories, int rule_number, const char *rul
 
                             if ( type == BLUEDOT_LOOKUP_FILENAME )
                                 {
-                                    if ( rulestruct[rule_number].bluedot_filename_cat_count <= BLUEDOT_MAX_CAT )
+                                    if ( gen->rulestruct[rule_number].bluedot_filename_cat_count <= BLUEDOT_MAX_CAT )
                                         {
-                                            rulestruct[rule_number].bluedot_filename_cats[rulestruct[rule_number].bluedot_filename_cat_count] =  SaganBluedotCatList[i].cat_number;
-                                            rulestruct[rule_number].bluedot_filename_cat_count++;
+                                            gen->rulestruct[rule_number].bluedot_filename_cats[gen->rulestruct[rule_number].bluedot_filename_cat_count] =  SaganBluedotCatList[i].cat_number;
+                                            gen->rulestruct[rule_number].bluedot_filename_cat_count++;
                                         }
                                     else
                                         {
@@ -1773,10 +1770,10 @@ void Sagan_Verify_Categories( char *categories, int rule_number, const char *rul
 
                             if ( type == BLUEDOT_LOOKUP_JA3 )
                                 {
-                                    if ( rulestruct[rule_number].bluedot_ja3_cat_count <= BLUEDOT_MAX_CAT )
+                                    if ( gen->rulestruct[rule_number].bluedot_ja3_cat_count <= BLUEDOT_MAX_CAT )
                                         {
-                                            rulestruct[rule_number].bluedot_ja3_cats[rulestruct[rule_number].bluedot_ja3_cat_count] =  SaganBluedotCatList[i].cat_number;
-                                            rulestruct[rule_number].bluedot_ja3_cat_count++;
+                                            gen->rulestruct[rule_number].bluedot_ja3_cats[gen->rulestruct[rule_number].bluedot_ja3_cat_count] =  SaganBluedotCatList[i].cat_number;
+                                            gen->rulestruct[rule_number].bluedot_ja3_cat_count++;
                                         }
                                     else
                                         {
@@ -47,6 +47,7 @@
 int Sagan_Bluedot_Cat_Compare ( unsigned char, int, unsigned char );
 int Sagan_Bluedot ( _Sagan_Proc_Syslog *, int  );
 unsigned char Sagan_Bluedot_Lookup(char *data,  unsigned char type, int rule_position, char *bluedot_str, size_t bluedot_size );
+unsigned char Sagan_Bluedot_Lookup_IP( struct _Sagan_IP *addr, int rule_position, char *bluedot_str, size_t bluedot_size );
 int Sagan_Bluedot_IP_Lookup_All ( char *, int, _Sagan_Lookup_Cache_Entry *, int );
 
 void Sagan_Bluedot_Clean_Cache ( void );
@@ -55,7 +56,7 @@ void Sagan_Bluedot_Load_Cat(void);
 void Sagan_Verify_Categories( char *, int, const char *, int, unsigned char );
 void Sagan_Bluedot_Check_Cache_Time (void);
 
-int Sagan_Bluedot_Clean_Queue ( char *, unsigned char );
+int Sagan_Bluedot_Clean_Queue ( char *, unsigned char *, unsigned char );
 
 
 typedef struct _Sagan_Bluedot_Cat_List _Sagan_Bluedot_Cat_List;
@@ -206,15 +206,7 @@ void Client_Stats_Add_Update_IP( char *ip, char *program, char *message )
     uint32_t hash = Djb2_Hash( ip );
 
     int i = 0;
-    time_t t;
-    struct tm *now;
-    uint64_t epoch = 0;
-    char timet[20];
-
-    t = time(NULL);
-    now=localtime(&t);
-    strftime(timet, sizeof(timet), "%s",  now);
-    epoch = atol(timet);
+    uint64_t epoch = Return_Epoch();
 
 
     for ( i = 0; i < counters->client_stats_count; i++ )
@@ -24,6 +24,13 @@
  * for Sagan to detect logs it might not be monitoring and automatically
  * enable and/or warn the operator.
  *
+ * The rule set is parsed by the "SaganDynLoad" thread,  not the Processor
+ * thread that saw the dynamic rule,  so that thread isn't stalled for the
+ * whole load.  The other threads keep running while it loads.  A new rule
+ * is only counted (and seen by Sagan_Engine()) once it is complete,  and
+ * memory the load replaces is retired rather than free()'ed.  See
+ * rule-epoch.c
+ *
  */
 
 
@@ -35,29 +42,230 @@
 #include <stdlib.h>
 #include <pthread.h>
 #include <string.h>
+#include <errno.h>
+#include <time.h>
 #include <sys/time.h>
 
+#ifdef HAVE_SYS_PRCTL_H
+#include <sys/prctl.h>
+#endif
+
 #include "sagan.h"
 #include "sagan-defs.h"
 #include "rules.h"
+#include "rule-generation.h"
 #include "sagan-config.h"
 #include "send-alert.h"
+#include "template-cache.h"
+#include "rule-epoch.h"
 
 #include "processors/dynamic-rules.h"
 
 struct _SaganConfig *config;
-struct _Rule_Struct *rulestruct;
 struct _Rules_Loaded *rules_loaded;
 struct _SaganCounters *counters;
 
 bool reload_rules;
+bool death;
 
 pthread_mutex_t SaganRulesLoadedMutex;
 pthread_mutex_t CounterDynamicGenericMutex=PTHREAD_MUTEX_INITIALIZER;
 
-int Sagan_Dynamic_Rules ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, int rule_position, _Sagan_Processor_Info *processor_info_engine, char *ip_src, char *ip_dst )
+/* Rule sets waiting for the "SaganDynLoad" thread */
+
+struct _Dynamic_Load
+{
+    char ruleset[MAXPATH];
+    struct _Dynamic_Load *next;
+};
+
+static pthread_mutex_t DynamicLoadQueueMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t DynamicLoadQueueCond = PTHREAD_COND_INITIALIZER;
+
+static struct _Dynamic_Load *Dynamic_Load_Head = NULL;
+static struct _Dynamic_Load **Dynamic_Load_Tail = &Dynamic_Load_Head;
+
+static bool Dynamic_Load_Started = false;
+
+/* Held for the whole of a load,  so Dynamic_Rules_Flush() can wait it out */
+
+static pthread_mutex_t DynamicLoadMutex = PTHREAD_MUTEX_INITIALIZER;
+
+/****************************************************************************
+ * Dynamic_Rules_Thread - The "SaganDynLoad" thread.  Loads the queued rule
+ * sets one at a time and frees whatever memory the loads retired.
+ ****************************************************************************/
+
+static void Dynamic_Rules_Thread( void )
+{
+
+    (void)SetThreadName("SaganDynLoad");
+
+    struct _Dynamic_Load *Load = NULL;
+    struct timespec wait;
+
+    uint32_t retired = 0;
+
+    while ( death == false )
+        {
+
+            pthread_mutex_lock(&DynamicLoadQueueMutex);
+
+            while ( Dynamic_Load_Head == NULL && death == false )
+                {
+
+                    /* Retired memory is checked once a second until the
+                       threads that could see it have moved on */
+
+                    if ( retired == 0 )
+                        {
+                            pthread_cond_wait(&DynamicLoadQueueCond, &DynamicLoadQueueMutex);
+                            continue;
+                        }
+
+                    clock_gettime(CLOCK_REALTIME, &wait);
+                    wait.tv_sec++;
+
+                    if ( pthread_cond_timedwait(&DynamicLoadQueueCond, &DynamicLoadQueueMutex, &wait) == ETIMEDOUT )
+                        {
+                            break;
+                        }
+                }
+
+            Load = Dynamic_Load_Head;
+
+            if ( Load != NULL )
+                {
+
+                    Dynamic_Load_Head = Load->next;
+
+                    if ( Dynamic_Load_Head == NULL )
+                        {
+                            Dynamic_Load_Tail = &Dynamic_Load_Head;
+                        }
+                }
+
+            pthread_mutex_unlock(&DynamicLoadQueueMutex);
+
+            if ( Load != NULL )
+                {
+
+                    pthread_mutex_lock(&DynamicLoadMutex);
+
+                    /* A SIGHUP reloads everything anyways */
+
+                    if ( config->sagan_reload == false )
+                        {
+
+                            pthread_mutex_lock(&SaganRulesLoadedMutex);
+                            reload_rules = 1;
+
+                            Load_Rules(Load->ruleset);
+                            Template_Cache_Clear();
+
+                            reload_rules = 0;
+                            pthread_mutex_unlock(&SaganRulesLoadedMutex);
+
+                            __atomic_add_fetch(&counters->dynamic_load_count, 1, __ATOMIC_SEQ_CST);
+
+                            Sagan_Log(NORMAL, "Dynamic rule set '%s' loaded. There are now %d rules loaded.", Load->ruleset, Rule_Generation_Current()->rulecount);
+                        }
+
+                    pthread_mutex_unlock(&DynamicLoadMutex);
+
+                    free(Load);
+                }
+
+            retired = Rule_Epoch_Reclaim();
+
+        }
+
+}
+
+/****************************************************************************
+ * Dynamic_Rules_Queue - Hand "ruleset" to the "SaganDynLoad" thread,
+ * starting it if needed.
+ ****************************************************************************/
+
+static void Dynamic_Rules_Queue( const char *ruleset )
+{
+
+    struct _Dynamic_Load *Load = NULL;
+
+    pthread_t dynload_thread;
+    pthread_attr_t dynload_thread_attr;
+    int rc = 0;
+
+    Load = malloc(sizeof(struct _Dynamic_Load));
+
+    if ( Load == NULL )
+        {
+            Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for _Dynamic_Load. Abort!", __FILE__, __LINE__);
+        }
+
+    memset(Load, 0, sizeof(struct _Dynamic_Load));
+    strlcpy(Load->ruleset, ruleset, sizeof(Load->ruleset));
+
+    pthread_mutex_lock(&DynamicLoadQueueMutex);
+
+    if ( Dynamic_Load_Started == false )
+        {
+
+            pthread_attr_init(&dynload_thread_attr);
+            pthread_attr_setdetachstate(&dynload_thread_attr,  PTHREAD_CREATE_DETACHED);
+
+            rc = pthread_create( &dynload_thread, &dynload_thread_attr, (void *)Dynamic_Rules_Thread, NULL );
+
+            if ( rc != 0 )
+                {
+                    Sagan_Log(ERROR, "[%s, line %d] Error creating dynamic rule loading thread. [error: %d]", __FILE__, __LINE__, rc);
+                }
+
+            Dynamic_Load_Started = true;
+        }
+
+    *Dynamic_Load_Tail = Load;
+    Dynamic_Load_Tail = &Load->next;
+
+    pthread_cond_signal(&DynamicLoadQueueCond);
+    pthread_mutex_unlock(&DynamicLoadQueueMutex);
+
+}
+
+/****************************************************************************
+ * Dynamic_Rules_Flush - Drop queued rule sets and wait for a load in
+ * progress to finish.  Called on SIGHUP,  after config->sagan_reload is
+ * set and before the rules are cleared.
+ ****************************************************************************/
+
+void Dynamic_Rules_Flush( void )
 {
 
+    struct _Dynamic_Load *Load = NULL;
+
+    pthread_mutex_lock(&DynamicLoadQueueMutex);
+
+    while ( Dynamic_Load_Head != NULL )
+        {
+            Load = Dynamic_Load_Head;
+            Dynamic_Load_Head = Load->next;
+            free(Load);
+        }
+
+    Dynamic_Load_Tail = &Dynamic_Load_Head;
+
+    pthread_mutex_unlock(&DynamicLoadQueueMutex);
+
+    pthread_mutex_lock(&DynamicLoadMutex);
+    pthread_mutex_unlock(&DynamicLoadMutex);
+
+}
+
+int Sagan_Dynamic_Rules ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, int rule_position, _Sagan_Processor_Info *processor_info_engine, struct _Sagan_IP *ip_src, struct _Sagan_IP *ip_dst )
+{
+
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
+
     int i;
 
     struct timeval  tp;
@@ -72,7 +280,7 @@ int Sagan_Dynamic_Rules ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, int rule_po
 
             /* If the rule set is loaded (or in our array), nothing else needs to be done */
 
-            if (!strcmp(rulestruct[rule_position].dynamic_ruleset, rules_loaded[i].ruleset))
+            if (!strcmp(gen->rulestruct[rule_position].dynamic_ruleset, rules_loaded[i].ruleset))
                 {
 
                     /* Rule was already loaded.  Release mutex and continue as normal */
@@ -93,7 +301,7 @@ int Sagan_Dynamic_Rules ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, int rule_po
 
     memset(&rules_loaded[counters->rules_loaded_count], 0, sizeof(_Rules_Loaded));
 
-    strlcpy(rules_loaded[counters->rules_loaded_count].ruleset, rulestruct[rule_position].dynamic_ruleset, sizeof(rules_loaded[counters->rules_loaded_count].ruleset));
+    strlcpy(rules_loaded[counters->rules_loaded_count].ruleset, gen->rulestruct[rule_position].dynamic_ruleset, sizeof(rules_loaded[counters->rules_loaded_count].ruleset));
 
     __atomic_add_fetch(&counters->rules_loaded_count, 1, __ATOMIC_SEQ_CST);
 
@@ -109,11 +317,11 @@ int Sagan_Dynamic_Rules ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, int rule_po
     if ( config->dynamic_load_type == 0 )
         {
 
-            Sagan_Log(NORMAL, "Detected dynamic signature '%s'. Dynamically loading '%s'.", rulestruct[rule_position].s_msg, rulestruct[rule_position].dynamic_ruleset);
+            Sagan_Log(NORMAL, "Detected dynamic signature '%s'. Dynamically loading '%s'.", gen->rulestruct[rule_position].s_msg, gen->rulestruct[rule_position].dynamic_ruleset);
 
             gettimeofday(&tp, 0);
 
-            /* Process the alert _before_ loading rule set! Otherwise, mem will mismatch */
+            /* Alert before the rule set is queued */
             Send_Alert(SaganProcSyslog_LOCAL,
                        NULL,
                        processor_info_engine,
@@ -122,20 +330,14 @@ int Sagan_Dynamic_Rules ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, int rule_po
                        "",
                        "",
                        config->sagan_proto,
-                       rulestruct[rule_position].s_sid,
+                       gen->rulestruct[rule_position].s_sid,
                        config->sagan_port,
                        config->sagan_port,
                        rule_position, tp, NULL, 0 );
 
-            /* Lock rules so other threads don't try to use it while we alter/load new rules */
-
-            pthread_mutex_lock(&SaganRulesLoadedMutex);
-            reload_rules = 1;
-
-            Load_Rules(rulestruct[rule_position].dynamic_ruleset);
+            /* Loaded in the background.  This thread goes back to work */
 
-            reload_rules = 0;
-            pthread_mutex_unlock(&SaganRulesLoadedMutex);
+            Dynamic_Rules_Queue( gen->rulestruct[rule_position].dynamic_ruleset );
 
         }
 
@@ -146,7 +348,7 @@ int Sagan_Dynamic_Rules ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, int rule_po
     else if ( config->dynamic_load_type == 1 )
         {
 
-            Sagan_Log(NORMAL, "Detected dynamic signature '%s'. Sagan would automatically load '%s' but the 'dynamic_load' processor is set to 'log_only'.", rulestruct[rule_position].s_msg, rulestruct[rule_position].dynamic_ruleset);
+            Sagan_Log(NORMAL, "Detected dynamic signature '%s'. Sagan would automatically load '%s' but the 'dynamic_load' processor is set to 'log_only'.", gen->rulestruct[rule_position].s_msg, gen->rulestruct[rule_position].dynamic_ruleset);
 
         }
 
@@ -157,7 +359,7 @@ int Sagan_Dynamic_Rules ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, int rule_po
     else if ( config->dynamic_load_type == 2 )
         {
 
-            Sagan_Log(NORMAL, "Detected dynamic signature '%s'. Sagan would automatically load '%s' but the 'dynamic_load' processor is set to 'alert'.", rulestruct[rule_position].s_msg, rulestruct[rule_position].dynamic_ruleset);
+            Sagan_Log(NORMAL, "Detected dynamic signature '%s'. Sagan would automatically load '%s' but the 'dynamic_load' processor is set to 'alert'.", gen->rulestruct[rule_position].s_msg, gen->rulestruct[rule_position].dynamic_ruleset);
 
 
             gettimeofday(&tp, 0);
@@ -170,7 +372,7 @@ int Sagan_Dynamic_Rules ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, int rule_po
                        "",
                        "",
                        config->sagan_proto,
-                       rulestruct[rule_position].s_sid,
+                       gen->rulestruct[rule_position].s_sid,
                        config->sagan_port,
                        config->sagan_port,
                        rule_position, tp, NULL, 0 );
@@ -0,0 +1,329 @@
+/*
+** Copyright (C) 2009-2020 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2020 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* engine-defer.c
+ *
+ * flexbits_pause,  flexbits_upause,  xbits_pause and xbits_upause used to
+ * sleep() inside the Processor thread,  holding up the rest of its batch.
+ * Instead,  Sagan_Engine() parks a copy of the event and the rule position
+ * on a timer wheel and moves on.  The "SaganDefer" thread runs the rule
+ * again once the delay has passed.  Its header filters and content/pcre/etc
+ * checks are not repeated,  but the addresses,  ports,  hashes and protocol
+ * are worked out again from the copy of the event (including liblognorm for
+ * "normalize" rules) and the flow is re-checked before the xbit/flexbit
+ * conditions.  Nothing from the Processor thread's working memory is kept.
+ *
+ * The wheel has ENGINE_DEFER_SLOTS slots of ENGINE_DEFER_TICK microseconds.
+ * Delays longer than one turn of the wheel wait "rounds" extra turns.  At
+ * most ENGINE_DEFER_MAX events are parked at once.  Past that,  the old
+ * blocking pause is used.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <sys/time.h>
+
+#ifdef HAVE_SYS_PRCTL_H
+#include <sys/prctl.h>
+#endif
+
+#include "sagan.h"
+#include "sagan-defs.h"
+#include "rule-generation.h"
+
+#include "processors/engine.h"
+#include "processors/engine-defer.h"
+
+struct _SaganCounters *counters;
+
+bool death;
+
+static struct _Engine_Defer *Engine_Defer_Wheel[ENGINE_DEFER_SLOTS];
+static struct _Engine_Defer *Engine_Defer_Free_List = NULL;
+
+static uint32_t Engine_Defer_Tick = 0;		/* Slot the thread last ran */
+static uint32_t Engine_Defer_Pending = 0;	/* Events on the wheel */
+static uint32_t Engine_Defer_Allocated = 0;	/* Events on the wheel + free list */
+
+/* EngineDeferMutex protects the wheel.  EngineDeferRunMutex is held while
+   parked events are being run so Engine_Defer_Flush() can wait them out */
+
+static pthread_mutex_t EngineDeferMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t EngineDeferRunMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t EngineDeferCond = PTHREAD_COND_INITIALIZER;
+
+/****************************************************************************
+ * Engine_Defer_Init - Start the "SaganDefer" thread
+ ****************************************************************************/
+
+void Engine_Defer_Init( void )
+{
+
+    pthread_t defer_thread;
+    pthread_attr_t defer_thread_attr;
+    int rc = 0;
+
+    pthread_attr_init(&defer_thread_attr);
+    pthread_attr_setdetachstate(&defer_thread_attr,  PTHREAD_CREATE_DETACHED);
+
+    rc = pthread_create( &defer_thread, &defer_thread_attr, (void *)Engine_Defer_Thread, NULL );
+
+    if ( rc != 0 )
+        {
+            Sagan_Log(ERROR, "[%s, line %d] Error creating deferred evaluation thread. [error: %d]", __FILE__, __LINE__, rc);
+        }
+
+}
+
+/****************************************************************************
+ * Engine_Defer - Park rule "rule" for "event" until "usec" microseconds from
+ * now.  Returns false if the wheel is full,  in which case the caller has
+ * to pause the old way.
+ ****************************************************************************/
+
+bool Engine_Defer( struct _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, int rule, bool appended, struct timeval tp, uint64_t usec )
+{
+
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
+
+    struct _Engine_Defer *Defer = NULL;
+
+    uint64_t ticks = ( usec + ENGINE_DEFER_TICK - 1 ) / ENGINE_DEFER_TICK;
+    uint32_t slot = 0;
+
+    if ( ticks == 0 )
+        {
+            ticks = 1;
+        }
+
+    pthread_mutex_lock(&EngineDeferMutex);
+
+    if ( Engine_Defer_Free_List != NULL )
+        {
+            Defer = Engine_Defer_Free_List;
+            Engine_Defer_Free_List = Defer->next;
+        }
+
+    else if ( Engine_Defer_Allocated < ENGINE_DEFER_MAX )
+        {
+
+            Defer = malloc(sizeof(struct _Engine_Defer));
+
+            if ( Defer == NULL )
+                {
+                    Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for _Engine_Defer. Abort!", __FILE__, __LINE__);
+                }
+
+            Engine_Defer_Allocated++;
+            __atomic_add_fetch(&counters->hot_path_alloc, 1, __ATOMIC_SEQ_CST);
+        }
+
+    pthread_mutex_unlock(&EngineDeferMutex);
+
+    if ( Defer == NULL )
+        {
+            __atomic_add_fetch(&counters->engine_defer_full, 1, __ATOMIC_SEQ_CST);
+            return(false);
+        }
+
+    /* The copy is made outside of the lock */
+
+    memcpy(&Defer->SaganProcSyslog, SaganProcSyslog_LOCAL, sizeof(struct _Sagan_Proc_Syslog));
+
+    Defer->rule = rule;
+    Defer->generation = gen->id;
+    Defer->appended = appended;
+    Defer->tp = tp;
+
+    pthread_mutex_lock(&EngineDeferMutex);
+
+    slot = ( Engine_Defer_Tick + ticks ) % ENGINE_DEFER_SLOTS;
+    Defer->rounds = ( ticks - 1 ) / ENGINE_DEFER_SLOTS;
+
+    Defer->next = Engine_Defer_Wheel[slot];
+    Engine_Defer_Wheel[slot] = Defer;
+
+    /* Wake the thread if the wheel was idle */
+
+    if ( Engine_Defer_Pending++ == 0 )
+        {
+            pthread_cond_signal(&EngineDeferCond);
+        }
+
+    pthread_mutex_unlock(&EngineDeferMutex);
+
+    __atomic_add_fetch(&counters->engine_deferred, 1, __ATOMIC_SEQ_CST);
+
+    return(true);
+
+}
+
+/****************************************************************************
+ * Engine_Defer_Flush - Drop everything that is parked.  Used on SIGHUP,
+ * where the rule positions are about to change.
+ ****************************************************************************/
+
+void Engine_Defer_Flush( void )
+{
+
+    struct _Engine_Defer *Defer = NULL;
+    uint32_t dropped = 0;
+    int i = 0;
+
+    pthread_mutex_lock(&EngineDeferRunMutex);
+    pthread_mutex_lock(&EngineDeferMutex);
+
+    for ( i = 0; i < ENGINE_DEFER_SLOTS; i++ )
+        {
+
+            while ( Engine_Defer_Wheel[i] != NULL )
+                {
+                    Defer = Engine_Defer_Wheel[i];
+                    Engine_Defer_Wheel[i] = Defer->next;
+
+                    Defer->next = Engine_Defer_Free_List;
+                    Engine_Defer_Free_List = Defer;
+
+                    dropped++;
+                }
+        }
+
+    Engine_Defer_Pending = 0;
+
+    pthread_mutex_unlock(&EngineDeferMutex);
+    pthread_mutex_unlock(&EngineDeferRunMutex);
+
+    if ( dropped != 0 )
+        {
+            Sagan_Log(NORMAL, "Dropped %" PRIu32 " paused flexbit/xbit evaluations.", dropped);
+        }
+
+}
+
+/****************************************************************************
+ * Engine_Defer_Thread - Turns the wheel and resumes whatever is due.  Sleeps
+ * on EngineDeferCond while nothing is parked.
+ ****************************************************************************/
+
+void Engine_Defer_Thread( void )
+{
+
+    (void)SetThreadName("SaganDefer");
+
+    struct _Engine_Defer *Defer = NULL;
+    struct _Engine_Defer *Due = NULL;
+    struct _Engine_Defer **Prev = NULL;
+
+    struct timespec next;
+
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    while ( death == false )
+        {
+
+            pthread_mutex_lock(&EngineDeferMutex);
+
+            if ( Engine_Defer_Pending == 0 )
+                {
+
+                    while ( Engine_Defer_Pending == 0 )
+                        {
+                            pthread_cond_wait(&EngineDeferCond, &EngineDeferMutex);
+                        }
+
+                    clock_gettime(CLOCK_MONOTONIC, &next);
+                }
+
+            pthread_mutex_unlock(&EngineDeferMutex);
+
+            /* Fixed rate.  If we fall behind,  the missed ticks are run
+               back to back */
+
+            next.tv_nsec += ENGINE_DEFER_TICK * 1000;
+
+            if ( next.tv_nsec >= 1000000000 )
+                {
+                    next.tv_sec++;
+                    next.tv_nsec -= 1000000000;
+                }
+
+            while ( clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR );
+
+            pthread_mutex_lock(&EngineDeferRunMutex);
+            pthread_mutex_lock(&EngineDeferMutex);
+
+            Engine_Defer_Tick = ( Engine_Defer_Tick + 1 ) % ENGINE_DEFER_SLOTS;
+
+            Due = NULL;
+            Prev = &Engine_Defer_Wheel[Engine_Defer_Tick];
+
+            while ( *Prev != NULL )
+                {
+
+                    Defer = *Prev;
+
+                    if ( Defer->rounds != 0 )
+                        {
+                            Defer->rounds--;
+                            Prev = &Defer->next;
+                            continue;
+                        }
+
+                    *Prev = Defer->next;
+
+                    Defer->next = Due;
+                    Due = Defer;
+
+                    Engine_Defer_Pending--;
+                }
+
+            pthread_mutex_unlock(&EngineDeferMutex);
+
+            while ( Due != NULL )
+                {
+
+                    Defer = Due;
+                    Due = Defer->next;
+
+                    Sagan_Engine_Resume( Defer );
+
+                    pthread_mutex_lock(&EngineDeferMutex);
+                    Defer->next = Engine_Defer_Free_List;
+                    Engine_Defer_Free_List = Defer;
+                    pthread_mutex_unlock(&EngineDeferMutex);
+
+                }
+
+            pthread_mutex_unlock(&EngineDeferRunMutex);
+
+        }
+
+}
+
@@ -0,0 +1,50 @@
+/*
+** Copyright (C) 2009-2020 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2020 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+/* A rule evaluation parked by flexbits_pause/xbits_pause (see engine-defer.c).
+   The event is copied so the Processor thread can move on to other work. */
+
+typedef struct _Engine_Defer _Engine_Defer;
+struct _Engine_Defer
+{
+
+    struct _Engine_Defer *next;
+
+    uint32_t rounds;				/* Full turns of the wheel left to wait */
+    int rule;					/* rulestruct[] position to resume */
+    uint32_t generation;			/* Rule_Generation id "rule" belongs to */
+    bool appended;				/* "append_program" was already applied */
+    struct timeval tp;				/* When the event was first seen */
+
+    struct _Sagan_Proc_Syslog SaganProcSyslog;
+
+};
+
+void Engine_Defer_Init( void );
+bool Engine_Defer( struct _Sagan_Proc_Syslog *, int, bool, struct timeval, uint64_t );
+void Engine_Defer_Flush( void );
+void Engine_Defer_Thread( void );
+
+void Sagan_Engine_Resume( struct _Engine_Defer * );	/* engine.c */
+
@@ -30,6 +30,7 @@
 #endif
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <sys/time.h>
@@ -38,6 +39,8 @@
 #include <sys/stat.h>
 #include <sys/mman.h>
 #include <unistd.h>
+#include <errno.h>
+#include <inttypes.h>
 
 #include "sagan.h"
 #include "sagan-defs.h"
@@ -60,6 +63,11 @@
 #include "json-pcre.h"
 #include "json-content.h"
 #include "json-meta-content.h"
+#include "event-cache.h"
+#include "rule-table.h"
+#include "rule-generation.h"
+#include "rule-profile.h"
+#include "rule-epoch.h"
 
 #include "parsers/parsers.h"
 
@@ -67,6 +75,8 @@
 #include "processors/zeek-intel.h"
 #include "processors/blacklist.h"
 #include "processors/dynamic-rules.h"
+#include "processors/engine-defer.h"
+#include "template-cache.h"
 
 #ifdef WITH_BLUEDOT
 #include "processors/bluedot.h"
@@ -81,14 +91,15 @@
 #endif
 
 #ifdef HAVE_LIBFASTJSON
+#include "input-json.h"
 #include "message-json-map.h"
 #endif
 
+#include "thread-context.h"
+
 #include "output-plugins/eve.h"
 
 struct _SaganCounters *counters;
-struct _Rule_Struct *rulestruct;
-struct _Sagan_Ruleset_Track *Ruleset_Track;
 struct _SaganDebug *debug;
 struct _SaganConfig *config;
 
@@ -96,20 +107,385 @@ struct _Sagan_IPC_Counters *counters_ipc;
 
 void Sagan_Engine_Init ( void )
 {
-    /* Nothing to do yet */
+    Engine_Defer_Init();
+    Template_Cache_Init();
 }
 
-int Sagan_Engine ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, bool dynamic_rule_flag )
+/****************************************************************************
+ * Engine_Pause - Blocking flexbit/xbit pause.  Only used when too many
+ * evaluations are already parked (see engine-defer.c)
+ ****************************************************************************/
+
+static void Engine_Pause( uint64_t usec )
+{
+
+    struct timespec ts;
+
+    ts.tv_sec = usec / 1000000;
+    ts.tv_nsec = ( usec % 1000000 ) * 1000;
+
+    while ( nanosleep(&ts, &ts) == -1 && errno == EINTR );
+
+}
+
+/****************************************************************************
+ * Engine_Header - Check a rule header filter (program,  facility,  etc) by
+ * ID.  Filters are shared between rules,  so the result is cached for the
+ * current event.
+ ****************************************************************************/
+
+static bool Engine_Header( uint32_t id, struct _Sagan_Thread_Context *ThreadContext, _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL )
+{
+
+    if ( id == 0 )
+        {
+            return(true);
+        }
+
+    if ( id >= RULE_HEADER_CACHE )
+        {
+            return(Rule_Table_Header_Match( id, SaganProcSyslog_LOCAL ));
+        }
+
+    if ( ThreadContext->header_seen[id] != ThreadContext->header_event )
+        {
+            ThreadContext->header_match[id] = Rule_Table_Header_Match( id, SaganProcSyslog_LOCAL );
+            ThreadContext->header_seen[id] = ThreadContext->header_event;
+        }
+
+    return(ThreadContext->header_match[id]);
+
+}
+
+/****************************************************************************
+ * Engine_Check - Run one of a rule's content/pcre/etc checks (RULE_CHECK_*)
+ ****************************************************************************/
+
+static bool Engine_Check( int check, int b, _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL )
+{
+
+    switch ( check )
+        {
+
+        case RULE_CHECK_CONTENT:
+            return(Content(b, SaganProcSyslog_LOCAL->syslog_message ));
+
+        case RULE_CHECK_PCRE:
+            return(PcreS(b, SaganProcSyslog_LOCAL->syslog_message ));
+
+        case RULE_CHECK_META_CONTENT:
+            return(Meta_Content(b, SaganProcSyslog_LOCAL->syslog_message));
+
+        case RULE_CHECK_JSON_PCRE:
+            return(JSON_Pcre(b, SaganProcSyslog_LOCAL ));
+
+        case RULE_CHECK_JSON_CONTENT:
+            return(JSON_Content(b, SaganProcSyslog_LOCAL ));
+
+        case RULE_CHECK_JSON_META_CONTENT:
+            return(JSON_Meta_Content(b, SaganProcSyslog_LOCAL ));
+
+        case RULE_CHECK_EVENT_ID:
+            return(Event_ID( b, SaganProcSyslog_LOCAL ));
+
+        }
+
+    return(true);
+
+}
+
+/****************************************************************************
+ * Engine_Checks - Run a rule's content/pcre/etc checks.  The order was
+ * picked by Rule_Table_Order().  A sampled event runs every check so the
+ * rejection rates aren't skewed by the current order.
+ ****************************************************************************/
+
+static bool Engine_Checks( const struct _Rule_Generation *gen, int b, _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, bool order_sample, struct _Rule_Profile *rule_profile )
+{
+
+    uint32_t rule_order = __atomic_load_n(&gen->ruletable->order[b], __ATOMIC_RELAXED);
+    int rule_check = 0;
+    bool check_passed = false;
+    bool flag = true;
+
+    while ( rule_order != 0 && ( flag == true || order_sample == true ) )
+        {
+
+            rule_check = ( rule_order & 0x0f ) - 1;
+            rule_order = rule_order >> 4;
+
+            check_passed = Engine_Check( rule_check, b, SaganProcSyslog_LOCAL );
+
+            if ( order_sample == true )
+                {
+                    Rule_Table_Sample( b, rule_check, check_passed );
+                }
+
+            if ( rule_profile != NULL && flag == true && check_passed == true )
+                {
+                    rule_profile[b].stage_pass[rule_check]++;
+                }
+
+            if ( check_passed == false )
+                {
+                    flag = false;
+                }
+        }
+
+    if ( order_sample == true && gen->ruletable->stages[b] != 0 )
+        {
+            Rule_Table_Sampled( b );
+        }
+
+    return(flag);
+
+}
+
+/****************************************************************************
+ * Engine_Batch_Test/Engine_Batch_Set - Per event rule bitmaps
+ ****************************************************************************/
+
+static bool Engine_Batch_Test( uint64_t *bitmap, struct _Sagan_Engine_Batch *Batch, int slot, int b )
+{
+    return( ( bitmap[ slot * Batch->words + ( b >> 6 ) ] >> ( b & 63 ) ) & 1 );
+}
+
+static void Engine_Batch_Set( uint64_t *bitmap, struct _Sagan_Engine_Batch *Batch, int slot, int b )
+{
+    bitmap[ slot * Batch->words + ( b >> 6 ) ] |= ( 1ULL << ( b & 63 ) );
+}
+
+/****************************************************************************
+ * Engine_Next_Rule - The next rule for Sagan_Engine() to look at.  Outside
+ * of a batch that is every rule.  In a batch,  only the rules that
+ * Sagan_Engine_Batch() left as candidates for the event.
+ ****************************************************************************/
+
+static int Engine_Next_Rule( struct _Sagan_Engine_Batch *Batch, int slot, int b )
+{
+
+    uint64_t bits = 0;
+    uint32_t word = 0;
+
+    if ( Batch == NULL )
+        {
+            return(b);
+        }
+
+    while ( b < (int)Batch->rules )
+        {
+
+            word = b >> 6;
+            bits = Batch->candidate[ slot * Batch->words + word ] >> ( b & 63 );
+
+            if ( bits != 0 )
+                {
+                    return( b + __builtin_ctzll(bits) );
+                }
+
+            b = ( word + 1 ) << 6;
+        }
+
+    return(Batch->rules);
+
+}
+
+/****************************************************************************
+ * Engine_Batch_Header - Engine_Header() for an event in a batch.  Results
+ * are cached per event for the life of the batch.
+ ****************************************************************************/
+
+static bool Engine_Batch_Header( uint32_t id, struct _Sagan_Engine_Batch *Batch, int slot, _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL )
+{
+
+    unsigned char *result = NULL;
+
+    if ( id == 0 )
+        {
+            return(true);
+        }
+
+    result = &Batch->header[ slot * Batch->headers + id ];
+
+    if ( *result == 0 )
+        {
+            *result = Rule_Table_Header_Match( id, SaganProcSyslog_LOCAL ) == true ? 2 : 1;
+        }
+
+    return( *result == 2 );
+
+}
+
+/****************************************************************************
+ * Engine_Batch_Get - The calling thread's batch working memory,  sized for
+ * the currently loaded rules.
+ ****************************************************************************/
+
+static struct _Sagan_Engine_Batch *Engine_Batch_Get( const struct _Rule_Generation *gen, struct _Sagan_Thread_Context *ThreadContext )
+{
+
+    struct _Sagan_Engine_Batch *Batch = ThreadContext->EngineBatch;
+
+    /* The rule count is read first.  Every header filter its rules use is
+       then below header_count */
+
+    uint32_t rules = __atomic_load_n(&gen->rulecount, __ATOMIC_ACQUIRE);
+    uint32_t words = ( rules + 63 ) / 64;
+    uint32_t headers = gen->ruletable->header_count;
+
+    if ( Batch == NULL )
+        {
+
+            Batch = malloc(sizeof(struct _Sagan_Engine_Batch));
+
+            if ( Batch == NULL )
+                {
+                    Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for _Sagan_Engine_Batch. Abort!", __FILE__, __LINE__);
+                }
+
+            memset(Batch, 0, sizeof(struct _Sagan_Engine_Batch));
+            ThreadContext->EngineBatch = Batch;
+
+        }
+
+    if ( words > Batch->words )
+        {
+
+            free(Batch->candidate);
+            free(Batch->pending);
+
+            Batch->candidate = malloc(words * ENGINE_BATCH_MAX * sizeof(uint64_t));
+            Batch->pending = malloc(words * ENGINE_BATCH_MAX * sizeof(uint64_t));
+
+            if ( Batch->candidate == NULL || Batch->pending == NULL )
+                {
+                    Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for batch rule bitmaps. Abort!", __FILE__, __LINE__);
+                }
+
+            Batch->words = words;
+
+            __atomic_add_fetch(&counters->hot_path_alloc, 1, __ATOMIC_SEQ_CST);
+        }
+
+    if ( headers > Batch->headers )
+        {
+
+            free(Batch->header);
+
+            Batch->header = malloc(headers * ENGINE_BATCH_MAX);
+
+            if ( Batch->header == NULL )
+                {
+                    Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for batch header results. Abort!", __FILE__, __LINE__);
+                }
+
+            Batch->headers = headers;
+
+            __atomic_add_fetch(&counters->hot_path_alloc, 1, __ATOMIC_SEQ_CST);
+        }
+
+    Batch->rules = rules;
+
+    return(Batch);
+
+}
+
+/****************************************************************************
+ * Engine_Prepare - Work done on an event before any rule looks at it
+ ****************************************************************************/
+
+static void Engine_Prepare( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL )
 {
 
-    struct _Sagan_Routing *SaganRouting = NULL;
-    SaganRouting = malloc(sizeof(struct _Sagan_Routing));
+#ifdef HAVE_LIBFASTJSON
+
+    /* If "parse-json-program" is enabled, we'll look for signs in the program
+       field for JSON.  If we find it,  we'll append the program and message
+       field */
+
+
+    if ( config->parse_json_program == true || config->parse_json_message == true )
+        {
+            SaganProcSyslog_LOCAL->src_ip[0] = '\0';
+            SaganProcSyslog_LOCAL->dst_ip[0] = '\0';
+            SaganProcSyslog_LOCAL->src_port = 0;
+            SaganProcSyslog_LOCAL->dst_port = 0;
+            SaganProcSyslog_LOCAL->proto = 0;
+        }
+
+    if ( config->parse_json_program == true &&
+            ( SaganProcSyslog_LOCAL->syslog_program[0] == '{' ||
+              SaganProcSyslog_LOCAL->syslog_program[1] == '{' ) )
+        {
+
+            char tmp_json[MAX_SYSLOGMSG] = { 0 };
+
+            if ( debug->debugjson )
+                {
+                    Sagan_Log(DEBUG, "[%s, line %d] Found possible JSON within program \"%s\"", __FILE__, __LINE__, SaganProcSyslog_LOCAL->syslog_program );
+                }
+
+            /* Merge program+message */
+
+            snprintf(tmp_json, sizeof(tmp_json), "%s%s", SaganProcSyslog_LOCAL->syslog_program, SaganProcSyslog_LOCAL->syslog_message );
+
+            /* Zero out program (might get set by JSON) */
+
+            SaganProcSyslog_LOCAL->syslog_program[0] = '\0';
+            strlcpy(SaganProcSyslog_LOCAL->syslog_message, tmp_json, sizeof(SaganProcSyslog_LOCAL->syslog_message));
+
+            /* Parse JSON */
+
+            Parse_JSON_Message( SaganProcSyslog_LOCAL );
+
+        }
+
+    /* If "parse-json-message" is enabled, we'll look for signs in the message for
+           JSON */
 
-    if ( SaganRouting == NULL )
+    if ( config->parse_json_message == true &&
+            ( SaganProcSyslog_LOCAL->syslog_message[1] == '{' ||
+              SaganProcSyslog_LOCAL->syslog_message[2] == '{'  ) )
         {
-            Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for _Sagan_Routing, Abort!", __FILE__, __LINE__);
+
+            if ( debug->debugjson )
+                {
+                    Sagan_Log(DEBUG, "[%s, line %d] Found possible JSON within message \"%s\".", __FILE__, __LINE__, SaganProcSyslog_LOCAL->syslog_message);
+                }
+
+            Parse_JSON_Message( SaganProcSyslog_LOCAL );
+
         }
 
+#endif
+
+    /* Event_ID() finds the event ID on first use,  json_* rule options index
+       the JSON keys on first use */
+
+    SaganProcSyslog_LOCAL->event_id_done = false;
+    SaganProcSyslog_LOCAL->json_index_done = false;
+
+}
+
+/****************************************************************************
+ * Engine_Event - Run the rules over one event.  If "Batch" is set,  the
+ * event is "slot" of a batch that Sagan_Engine_Batch() has already run the
+ * header filters and content/pcre/etc checks for.  If "Defer" is set,  only
+ * that parked rule is run.  Its header and content/pcre/etc checks are
+ * skipped,  but normalization,  address/port/hash parsing and the flow
+ * check are done again before its xbit/flexbit conditions.
+ ****************************************************************************/
+
+static int Engine_Event ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, bool dynamic_rule_flag, struct _Sagan_Engine_Batch *Batch, int slot, struct _Engine_Defer *Defer )
+{
+
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
+
+    /* Working memory is allocated once per thread.  See thread-context.c */
+
+    struct _Sagan_Thread_Context *ThreadContext = Thread_Context();
+
+    struct _Sagan_Routing *SaganRouting = &ThreadContext->SaganRouting;
     memset(SaganRouting, 0, sizeof(_Sagan_Routing));
 
     SaganRouting->check_flow_return = true;
@@ -134,25 +510,14 @@ int Sagan_Engine ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, bool dynamic_rule_
 
 #endif
 
-    struct _Sagan_Processor_Info *processor_info_engine = NULL;
-    processor_info_engine = malloc(sizeof(struct _Sagan_Processor_Info));
-
-    if ( processor_info_engine == NULL )
-        {
-            Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for processor_info_engine. Abort!", __FILE__, __LINE__);
-        }
-
+    struct _Sagan_Processor_Info *processor_info_engine = &ThreadContext->processor_info_engine;
     memset(processor_info_engine, 0, sizeof(_Sagan_Processor_Info));
 
-    struct _Sagan_Lookup_Cache_Entry *lookup_cache = NULL;
-    lookup_cache = malloc(sizeof(struct _Sagan_Lookup_Cache_Entry) * MAX_PARSE_IP);
+    /* Values derived from the log line are computed once per event and
+       shared by all rules.  See event-cache.c */
 
-    if ( lookup_cache == NULL )
-        {
-            Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for lookup_cache. Abort!", __FILE__, __LINE__);
-        }
-
-    memset(lookup_cache, 0, sizeof(_Sagan_Lookup_Cache_Entry) * MAX_PARSE_IP);
+    struct _Sagan_Event_Cache *EventCache = &ThreadContext->EventCache;
+    struct _Sagan_Lookup_Cache_Entry *lookup_cache = EventCache->lookup_cache;
 
     bool after_log_flag = false;
     bool thresh_log_flag = false;
@@ -161,32 +526,41 @@ int Sagan_Engine ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, bool dynamic_rule_
 
     int b = 0;
 
-    bool pre_match = false;
+    /* Dynamic rules may be added while we run.  Only the rules that were
+       loaded when the event started are looked at (see rule-epoch.c).  The
+       "template-cache" generation is read first,  so a verdict is never
+       recorded for rules this scan didn't see (see template-cache.c) */
+
+    uint32_t template_generation = Batch != NULL ? Batch->template_generation : Template_Cache_Epoch();
 
-    char *ptmp = NULL;
-    char *tok2 = NULL;
+    int rules = Batch != NULL ? (int)Batch->rules : __atomic_load_n(&gen->rulecount, __ATOMIC_ACQUIRE);
+
+    bool order_sample = false;
+
+    struct _Rule_Profile *rule_profile = NULL;
+    uint64_t profile_ticks = 0;
+
+    uint64_t pause_usec = 0;
+
+    uint64_t template_key = 0;
+    bool template_unsafe = false;
+    bool template_match = false;
 
     char parse_ip_src[MAXIP] = { 0 };
     char parse_ip_dst[MAXIP] = { 0 };
-    char parse_md5_hash[MD5_HASH_SIZE+1] = { 0 };
-    char parse_sha1_hash[SHA1_HASH_SIZE+1] = { 0 };
-    char parse_sha256_hash[SHA256_HASH_SIZE+1] = { 0 };
 
     bool ip_src_flag = false;
 
     uint32_t ip_srcport_u32;
-    unsigned char ip_src_bits[MAXIPBIT] = { 0 };
+    struct _Sagan_IP ip_src_addr;
 
     bool ip_dst_flag = false;
 
     uint32_t ip_dstport_u32 = 0;
-    unsigned char ip_dst_bits[MAXIPBIT] = { 0 };
+    struct _Sagan_IP ip_dst_addr;
 
-    char tmpbuf[256] = { 0 };
     char s_msg[1024] = { 0 };
 
-    char syslog_append_program[MAX_SYSLOGMSG] = { 0 };
-
     struct timeval tp;
     unsigned char proto = 0;
     int lookup_cache_size = 0;
@@ -246,98 +620,162 @@ int Sagan_Engine ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, bool dynamic_rule_
 
     gettimeofday(&tp, 0);       /* Store event time as soon as we get it */
 
-#ifdef HAVE_LIBFASTJSON
+    /* Events in a batch were prepared by Sagan_Engine_Batch().  A parked
+       event was prepared before it was parked */
 
-    /* If "parse-json-program" is enabled, we'll look for signs in the program
-       field for JSON.  If we find it,  we'll append the program and message
-       field */
+    if ( Defer != NULL )
+        {
+            tp = Defer->tp;
+        }
+
+    else if ( Batch == NULL )
+        {
+            Engine_Prepare( SaganProcSyslog_LOCAL );
+        }
 
+    Event_Cache_Init( EventCache, SaganProcSyslog_LOCAL );
 
-    if ( config->parse_json_program == true || config->parse_json_message == true )
+    if ( Defer != NULL )
         {
-            SaganProcSyslog_LOCAL->src_ip[0] = '\0';
-            SaganProcSyslog_LOCAL->dst_ip[0] = '\0';
-            SaganProcSyslog_LOCAL->src_port = 0;
-            SaganProcSyslog_LOCAL->dst_port = 0;
-            SaganProcSyslog_LOCAL->proto = 0;
+            EventCache->append_program_done = Defer->appended;
         }
 
-    if ( config->parse_json_program == true &&
-            ( SaganProcSyslog_LOCAL->syslog_program[0] == '{' ||
-              SaganProcSyslog_LOCAL->syslog_program[1] == '{' ) )
+    /* "rule-ordering: adaptive" samples a fraction of events */
+
+    if ( Defer != NULL )
         {
+            order_sample = false;
+        }
 
-            char tmp_json[MAX_SYSLOGMSG] = { 0 };
+    else if ( Batch == NULL )
+        {
+            order_sample = config->rule_order_adaptive == true &&
+                           ( ++ThreadContext->order_events & ( RULE_ORDER_SAMPLE_RATE - 1 ) ) == 0;
+        }
+    else
+        {
+            order_sample = Batch->order_sample[slot];
+        }
 
-            if ( debug->debugjson )
-                {
-                    Sagan_Log(DEBUG, "[%s, line %d] Found possible JSON within program \"%s\"", __FILE__, __LINE__, SaganProcSyslog_LOCAL->syslog_program );
-                }
+    /* "rule-profiling" counters for this thread */
 
-            /* Merge program+message */
+    if ( config->rule_profile_flag == true )
+        {
+            rule_profile = Rule_Profile_Begin( &ThreadContext->profile );
+        }
 
-            snprintf(tmp_json, sizeof(tmp_json), "%s%s", SaganProcSyslog_LOCAL->syslog_program, SaganProcSyslog_LOCAL->syslog_message );
+    /* "template-cache".  Dynamic rule samples and parked rules don't use it */
+
+    if ( Batch != NULL )
+        {
+            template_key = Batch->template_key[slot];
+            template_unsafe = Batch->template_unsafe[slot];
+        }
+
+    else if ( config->template_cache_flag == true && Defer == NULL && dynamic_rule_flag == false )
+        {
+            template_key = Template_Cache_Key( SaganProcSyslog_LOCAL, template_generation );
+        }
+
+    /* New event,  forget cached header filter results */
+
+    ThreadContext->header_event++;
+
+    if ( ThreadContext->header_event == 0 )
+        {
+            memset(ThreadContext->header_seen, 0, sizeof(ThreadContext->header_seen));
+            ThreadContext->header_event = 1;
+        }
+
+    /* Search for matches */
 
-            /* Zero out program (might get set by JSON) */
+    /* First we search for 'program' and such.   This way,  we don't waste CPU
+     * time with pcre/content.  */
 
-            SaganProcSyslog_LOCAL->syslog_program[0] = '\0';
-            strlcpy(SaganProcSyslog_LOCAL->syslog_message, tmp_json, sizeof(SaganProcSyslog_LOCAL->syslog_message));
 
-            /* Parse JSON */
+    b = ( Defer == NULL ) ? Engine_Next_Rule( Batch, slot, 0 ) : Defer->rule;
 
-            Parse_JSON_Message( SaganProcSyslog_LOCAL );
+    /* No rule matched this template last time */
 
+    if ( template_key != 0 &&
+            ( Batch != NULL ? Batch->template_hit[slot] : Template_Cache_Lookup( template_key ) ) == true )
+        {
+            b = rules;
+            template_key = 0;
         }
 
-    /* If "parse-json-message" is enabled, we'll look for signs in the message for
-           JSON */
-
-    if ( config->parse_json_message == true &&
-            ( SaganProcSyslog_LOCAL->syslog_message[1] == '{' ||
-              SaganProcSyslog_LOCAL->syslog_message[2] == '{'  ) )
+    for ( ; b < rules; b = ( Defer == NULL ) ? Engine_Next_Rule( Batch, slot, b + 1 ) : rules )
         {
+            /* Reject what we can using only the "hot" rule table.  rulestruct[b] is
+               not looked at until the rule is a candidate.  See rule-table.c */
 
-            if ( debug->debugjson )
+            if ( rule_profile != NULL )
                 {
-                    Sagan_Log(DEBUG, "[%s, line %d] Found possible JSON within message \"%s\".", __FILE__, __LINE__, SaganProcSyslog_LOCAL->syslog_message);
+                    profile_ticks = Rule_Profile_Ticks();
                 }
 
-            Parse_JSON_Message( SaganProcSyslog_LOCAL );
+            /* Batch candidates and parked rules already passed the dynamic and
+               header checks */
 
-        }
+            if ( Batch == NULL && Defer == NULL )
+                {
 
-#endif
+                    /* Skip dynamic rules if it's not time to process them */
 
-    /* Search for matches */
+                    if ( gen->ruletable->type[b] == DYNAMIC_RULE && dynamic_rule_flag == false )
+                        {
+                            continue;
+                        }
 
-    /* First we search for 'program' and such.   This way,  we don't waste CPU
-     * time with pcre/content.  */
+                    if ( rule_profile != NULL )
+                        {
+                            rule_profile[b].checks++;
+                        }
+
+                    if ( Engine_Header( gen->ruletable->program_id[b], ThreadContext, SaganProcSyslog_LOCAL ) == false ||
+                            Engine_Header( gen->ruletable->facility_id[b], ThreadContext, SaganProcSyslog_LOCAL ) == false ||
+                            Engine_Header( gen->ruletable->level_id[b], ThreadContext, SaganProcSyslog_LOCAL ) == false ||
+                            Engine_Header( gen->ruletable->tag_id[b], ThreadContext, SaganProcSyslog_LOCAL ) == false ||
+                            Engine_Header( gen->ruletable->syspri_id[b], ThreadContext, SaganProcSyslog_LOCAL ) == false )
+                        {
 
+                            if ( rule_profile != NULL )
+                                {
+                                    rule_profile[b].ticks += Rule_Profile_Ticks() - profile_ticks;
+                                }
 
-    for(b=0; b < counters->rulecount; b++)
-        {
+                            continue;
+                        }
+
+                    if ( rule_profile != NULL )
+                        {
+                            rule_profile[b].header_pass++;
+                        }
+
+                    if ( gen->ruletable->flags[b] & RULE_FLAG_TEMPLATE_UNSAFE )
+                        {
+                            template_unsafe = true;
+                        }
+                }
 
             ip_src_flag = false;
             ip_dst_flag = false;
 
             parse_ip_src[0] = '\0';
             parse_ip_dst[0] = '\0';
-            parse_md5_hash[0] = '\0';
-            parse_sha1_hash[0] = '\0';
-            parse_sha256_hash[0] = '\0';
 
             ip_src = parse_ip_src;
             ip_dst = parse_ip_dst;
 
-            md5_hash = parse_md5_hash;
-            sha1_hash = parse_sha1_hash;
-            sha256_hash = parse_sha256_hash;
+            md5_hash = "";
+            sha1_hash = "";
+            sha256_hash = "";
 
             ip_dstport_u32 = 0;
             ip_srcport_u32 = 0;
 
-            memset(ip_src_bits, 0, sizeof(ip_src_bits));
-            memset(ip_dst_bits, 0, sizeof(ip_dst_bits));
+            IP_Set( &ip_src_addr, ip_src );
+            IP_Set( &ip_dst_addr, ip_dst );
 
 #ifdef HAVE_LIBFASTJSON
 
@@ -348,7 +786,7 @@ int Sagan_Engine ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, bool dynamic_rule_
             if ( SaganProcSyslog_LOCAL->src_ip[0] != '\0' )
                 {
                     ip_src = SaganProcSyslog_LOCAL->src_ip;
-                    IP2Bit(ip_src, ip_src_bits);
+                    Event_Cache_IP( EventCache, EVENT_CACHE_IP_JSON_SRC, ip_src, &ip_src_addr );
                     ip_src_flag = true;
                 }
 
@@ -356,7 +794,7 @@ int Sagan_Engine ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, bool dynamic_rule_
                 {
 
                     ip_dst = SaganProcSyslog_LOCAL->dst_ip;
-                    IP2Bit(ip_dst, ip_dst_bits);
+                    Event_Cache_IP( EventCache, EVENT_CACHE_IP_JSON_DST, ip_dst, &ip_dst_addr );
                     ip_dst_flag = true;
                 }
 
@@ -397,9 +835,7 @@ int Sagan_Engine ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, bool dynamic_rule_
 
             if ( SaganProcSyslog_LOCAL->hostname[0] != '\0' )
                 {
-                    char tmp_normalize_http_uri[MAX_HOSTNAME_SIZE + MAX_URL_SIZE] = { 0 };
-                    snprintf(tmp_normalize_http_uri, sizeof(tmp_normalize_http_uri), "%s%s", SaganProcSyslog_LOCAL->hostname, SaganProcSyslog_LOCAL->url);
-                    normalize_http_uri = tmp_normalize_http_uri;
+                    normalize_http_uri = Event_Cache_HTTP_URI( EventCache );
                 }
 
             if ( SaganProcSyslog_LOCAL->ja3[0] != '\0' )
@@ -410,1033 +846,1100 @@ int Sagan_Engine ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, bool dynamic_rule_
 
 #endif
 
-            /* Process "normal" rules.  Skip dynamic rules if it's not time to process them */
+            /* If the "append_program" rule option is used,  we append the program here */
 
-            if ( rulestruct[b].type == NORMAL_RULE || ( rulestruct[b].type == DYNAMIC_RULE && dynamic_rule_flag == true ) )
+            if ( gen->ruletable->flags[b] & RULE_FLAG_APPEND_PROGRAM )
                 {
+                    Event_Cache_Append_Program( EventCache );
+                }
 
-                    pre_match = false;
+            /* Start processing searches from rule optison.  In a batch,  this was
+               already done by Sagan_Engine_Batch() unless "append_program"
+               or "normalize" could have changed the event first */
 
-                    if ( rulestruct[b].s_program[0] != '\0' )
-                        {
+            bool flag = true;
 
-                            strlcpy(tmpbuf, rulestruct[b].s_program, sizeof(tmpbuf));
+            if ( Defer == NULL && ( Batch == NULL || Engine_Batch_Test( Batch->pending, Batch, slot, b ) == true ) )
+                {
+                    flag = Engine_Checks( gen, b, SaganProcSyslog_LOCAL, order_sample, rule_profile );
+                }
 
-                            ptmp = strtok_r(tmpbuf, "|", &tok2);
-                            pre_match = true;
+            /* Check for match from content, pcre, etc... */
+            if ( flag == true )
+                {
 
-                            while ( ptmp != NULL )
-                                {
-                                    if ( Wildcard(ptmp, SaganProcSyslog_LOCAL->syslog_program) == 1 )
-                                        {
-                                            pre_match = false;
-                                        }
+                    template_match = true;
 
-                                    ptmp = strtok_r(NULL, "|", &tok2);
-                                }
+                    if ( rule_profile != NULL && Defer == NULL )
+                        {
+                            rule_profile[b].matches++;
                         }
 
-                    if ( rulestruct[b].s_facility[0] != '\0' && pre_match == false )
+
+#ifdef HAVE_LIBLOGNORM
+                    if ( liblognorm_status == false && ( gen->ruletable->flags[b] & RULE_FLAG_NORMALIZE ) )
                         {
-                            strlcpy(tmpbuf, rulestruct[b].s_facility, sizeof(tmpbuf));
-                            ptmp = strtok_r(tmpbuf, "|", &tok2);
-                            pre_match = true;
+                            /* Set that normalization has been tried work isn't repeated */
 
-                            while ( ptmp != NULL )
-                                {
-                                    if (!strcmp(ptmp, SaganProcSyslog_LOCAL->syslog_facility))
-                                        {
-                                            pre_match = false;
-                                        }
+                            liblognorm_status = -1;
+
+                            Normalize_Liblognorm(SaganProcSyslog_LOCAL->syslog_message, &SaganNormalizeLiblognorm);
 
-                                    ptmp = strtok_r(NULL, "|", &tok2);
+                            strlcpy(json_normalize, SaganNormalizeLiblognorm.json_normalize, sizeof(json_normalize));
+
+                            if ( SaganNormalizeLiblognorm.ip_src[0] != '0'  ||
+                                    SaganNormalizeLiblognorm.ip_dst[0] != '0'  ||
+                                    SaganNormalizeLiblognorm.src_port != 0  ||
+                                    SaganNormalizeLiblognorm.dst_port != 0  ||
+                                    SaganNormalizeLiblognorm.hash_sha1[0] != '\0'  ||
+                                    SaganNormalizeLiblognorm.hash_sha256[0] != '\0'  ||
+                                    SaganNormalizeLiblognorm.hash_md5[0] != '\0' )
+
+                                {
+                                    liblognorm_status = true;
                                 }
-                        }
 
-                    if ( rulestruct[b].s_level[0] != '\0' && pre_match == false )
-                        {
-                            strlcpy(tmpbuf, rulestruct[b].s_level, sizeof(tmpbuf));
-                            ptmp = strtok_r(tmpbuf, "|", &tok2);
-                            pre_match = true;
+                            /* These are _only_ set here */
 
-                            while ( ptmp != NULL )
+                            if ( SaganNormalizeLiblognorm.username[0] != '\0' )
                                 {
-                                    if (!strcmp(ptmp, SaganProcSyslog_LOCAL->syslog_level))
-                                        {
-                                            pre_match = false;
-                                        }
 
-                                    ptmp = strtok_r(NULL, "|", &tok2);
+                                    liblognorm_status = true;
+                                    normalize_username = SaganNormalizeLiblognorm.username;
                                 }
-                        }
 
-                    if ( rulestruct[b].s_tag[0] != '\0' && pre_match == false )
-                        {
-                            strlcpy(tmpbuf, rulestruct[b].s_tag, sizeof(tmpbuf));
-                            ptmp = strtok_r(tmpbuf, "|", &tok2);
-                            pre_match = true;
+                            if ( SaganNormalizeLiblognorm.http_uri[0] != '\0' )
+                                {
+                                    liblognorm_status = true;
+                                    normalize_http_uri = SaganNormalizeLiblognorm.http_uri;
+                                }
 
-                            while ( ptmp != NULL )
+                            if ( SaganNormalizeLiblognorm.filename[0] != '\0' )
                                 {
-                                    if (!strcmp(ptmp, SaganProcSyslog_LOCAL->syslog_tag))
-                                        {
-                                            pre_match = false;
-                                        }
+                                    liblognorm_status = true;
+                                    normalize_filename = SaganNormalizeLiblognorm.filename;
+                                }
+
+                            if ( SaganNormalizeLiblognorm.ja3[0] != '\0' )
+                                {
+                                    liblognorm_status = true;
+                                    normalize_ja3 = SaganNormalizeLiblognorm.ja3;
+                                }
 
-                                    ptmp = strtok_r(NULL, "|", &tok2);
+                            if ( SaganNormalizeLiblognorm.event_id[0] != '\0' )
+                                {
+                                    liblognorm_status = true;
+                                    strlcpy(SaganProcSyslog_LOCAL->event_id, SaganNormalizeLiblognorm.event_id, sizeof(SaganProcSyslog_LOCAL->event_id));
+                                    SaganProcSyslog_LOCAL->event_id_done = false;
                                 }
+
                         }
 
-                    if ( rulestruct[b].s_syspri[0] != '\0' && pre_match == false )
+                    if ( liblognorm_status == true && ( gen->ruletable->flags[b] & RULE_FLAG_NORMALIZE ) )
                         {
-                            strlcpy(tmpbuf, rulestruct[b].s_syspri, sizeof(tmpbuf));
-                            ptmp = strtok_r(tmpbuf, "|", &tok2);
-                            pre_match = true;
-
-                            while ( ptmp != NULL )
+                            if ( SaganNormalizeLiblognorm.ip_src[0] != '0')
                                 {
-                                    if (!strcmp(ptmp, SaganProcSyslog_LOCAL->syslog_priority))
+                                    ip_src_flag = true;
+                                    ip_src = SaganNormalizeLiblognorm.ip_src;
+
+                                    if ( !strcmp(ip_src, "127.0.0.1") ||
+                                            !strcmp(ip_src, "::1" ) ||
+                                            !strcmp(ip_src, "::ffff:127.0.0.1" ) )
                                         {
-                                            pre_match = false;
-                                        }
 
-                                    ptmp = strtok_r(NULL, "|", &tok2);
-                                }
-                        }
+                                            ip_src = SaganProcSyslog_LOCAL->syslog_host;
+                                            IP_Set( &ip_src_addr, ip_src );
+                                            ip_src_flag = false;
+                                        }
 
-                    /* If there has been a pre_match above,  or NULL on all,  then we continue with
-                     * PCRE/content search */
+                                    else
+                                        {
 
-                    /* Search via strstr (content:) */
+                                            Event_Cache_IP( EventCache, EVENT_CACHE_IP_NORMALIZE_SRC, ip_src, &ip_src_addr );
+                                        }
 
-                    bool flag = false;
 
-                    if ( pre_match == false )
-                        {
+                                }
 
-                            /* If the "append_program" rule option is used,  we append the program here */
 
-                            if ( rulestruct[b].append_program == true )
+                            if ( SaganNormalizeLiblognorm.ip_dst[0] != '0' )
                                 {
-                                    snprintf(syslog_append_program, sizeof(syslog_append_program), "%s | %s", SaganProcSyslog_LOCAL->syslog_message, SaganProcSyslog_LOCAL->syslog_program);
-                                    syslog_append_program[ sizeof(syslog_append_program) - 1 ] = '\0';
-                                    strlcpy(SaganProcSyslog_LOCAL->syslog_message, syslog_append_program, sizeof(SaganProcSyslog_LOCAL->syslog_message));
-                                }
+                                    ip_dst_flag = true;
+                                    ip_dst = SaganNormalizeLiblognorm.ip_dst;
 
-                            /* Start processing searches from rule optison */
+                                    if ( !strcmp(ip_dst, "127.0.0.1") ||
+                                            !strcmp(ip_dst, "::1" ) ||
+                                            !strcmp(ip_dst, "::ffff:127.0.0.1" ) )
 
-                            flag = true;
+                                        {
+                                            ip_dst = SaganProcSyslog_LOCAL->syslog_host;
+                                            IP_Set( &ip_dst_addr, ip_dst );
+                                            ip_dst_flag = false;
+                                        }
+
+                                    else
+                                        {
+                                            Event_Cache_IP( EventCache, EVENT_CACHE_IP_NORMALIZE_DST, ip_dst, &ip_dst_addr );
+                                        }
 
-                            if ( rulestruct[b].content_count > 0 )
-                                {
-                                    flag = Content(b, SaganProcSyslog_LOCAL->syslog_message );
-                                }
 
-                            if ( flag == true && rulestruct[b].pcre_count > 0 )
-                                {
-                                    flag = PcreS(b, SaganProcSyslog_LOCAL->syslog_message );
                                 }
 
-                            if ( flag == true && rulestruct[b].meta_content_count > 0 )
+                            if ( SaganNormalizeLiblognorm.src_port != 0 )
                                 {
-                                    flag = Meta_Content(b, SaganProcSyslog_LOCAL->syslog_message);
+                                    ip_srcport_u32 = SaganNormalizeLiblognorm.src_port;
                                 }
 
-                            if ( flag == true && rulestruct[b].json_pcre_count > 0 )
+
+                            if ( SaganNormalizeLiblognorm.dst_port != 0 )
                                 {
-                                    flag = JSON_Pcre(b, SaganProcSyslog_LOCAL );
+                                    ip_dstport_u32 = SaganNormalizeLiblognorm.dst_port;
                                 }
 
-                            if ( flag == true && rulestruct[b].json_content_count > 0 )
+                            if ( SaganNormalizeLiblognorm.hash_md5[0] != '\0' )
                                 {
-                                    flag = JSON_Content(b, SaganProcSyslog_LOCAL );
+                                    md5_hash = SaganNormalizeLiblognorm.hash_md5;
                                 }
 
-                            if ( flag == true && rulestruct[b].json_meta_content_count > 0 )
+                            if ( SaganNormalizeLiblognorm.hash_sha1[0] != '\0' )
                                 {
-                                    flag = JSON_Meta_Content(b, SaganProcSyslog_LOCAL );
+                                    sha1_hash = SaganNormalizeLiblognorm.hash_sha1;
                                 }
 
-                            if ( flag == true && rulestruct[b].event_id_count > 0 )
+                            if ( SaganNormalizeLiblognorm.hash_sha256[0] != '\0' )
                                 {
-                                    flag = Event_ID( b, SaganProcSyslog_LOCAL );
+                                    sha256_hash = SaganNormalizeLiblognorm.hash_sha256;
                                 }
 
                         }
+#endif
 
-                    /* Check for match from content, pcre, etc... */
 
-                    if ( pre_match == false && flag == true )
+                    /* Normalization should always over ride parse_src_ip/parse_dst_ip/parse_port,
+                     * _unless_ liblognorm fails and both are in a rule or liblognorm failed to get src or dst */
+
+                    /* parse_src_ip: {position} - Parse_IP build a cache table for IPs, ports, etc.  This way,
+                    we only parse the syslog string one time regardless of the rule options! */
+
+                    if ( gen->rulestruct[b].s_find_src_ip == true ||
+                            gen->rulestruct[b].s_find_dst_ip == true ||
+                            gen->rulestruct[b].blacklist_ipaddr_all == true ||
+                            gen->rulestruct[b].s_find_proto == true ||
+#ifdef WITH_BLUEDOT
+                            gen->rulestruct[b].bluedot_ipaddr_type == 4 ||
+#endif
+                            gen->rulestruct[b].brointel_ipaddr_all == true )
                         {
 
+                            lookup_cache_size = Event_Cache_Parse_IP( EventCache );
 
-#ifdef HAVE_LIBLOGNORM
-                            if ( liblognorm_status == false && rulestruct[b].normalize == true )
-                                {
-                                    /* Set that normalization has been tried work isn't repeated */
+                        }
 
-                                    liblognorm_status = -1;
+                    if ( ip_src_flag == false && gen->rulestruct[b].s_find_src_ip == true )
+                        {
 
-                                    Normalize_Liblognorm(SaganProcSyslog_LOCAL->syslog_message, &SaganNormalizeLiblognorm);
 
-                                    strlcpy(json_normalize, SaganNormalizeLiblognorm.json_normalize, sizeof(json_normalize));
+                            if ( lookup_cache[gen->rulestruct[b].s_find_src_pos-1].status == true )
+                                {
 
-                                    if ( SaganNormalizeLiblognorm.ip_src[0] != '0'  ||
-                                            SaganNormalizeLiblognorm.ip_dst[0] != '0'  ||
-                                            SaganNormalizeLiblognorm.src_port != 0  ||
-                                            SaganNormalizeLiblognorm.dst_port != 0  ||
-                                            SaganNormalizeLiblognorm.hash_sha1[0] != '\0'  ||
-                                            SaganNormalizeLiblognorm.hash_sha256[0] != '\0'  ||
-                                            SaganNormalizeLiblognorm.hash_md5[0] != '\0' )
 
-                                        {
-                                            liblognorm_status = true;
-                                        }
+                                    memcpy(parse_ip_src, lookup_cache[gen->rulestruct[b].s_find_src_pos-1].ip, MAXIP );
+                                    memcpy(ip_src_addr.bits, lookup_cache[gen->rulestruct[b].s_find_src_pos-1].ip_bits, MAXIPBIT);
+                                    ip_src_addr.family = lookup_cache[gen->rulestruct[b].s_find_src_pos-1].family;
+                                    ip_src_addr.text = parse_ip_src;
 
-                                    /* These are _only_ set here */
+                                    ip_src = parse_ip_src;
 
-                                    if ( SaganNormalizeLiblognorm.username[0] != '\0' )
+                                    if ( !strcmp(ip_src, "127.0.0.1") ||
+                                            !strcmp(ip_src, "::1" ) ||
+                                            !strcmp(ip_src, "::ffff:127.0.0.1" ) )
                                         {
 
-                                            liblognorm_status = true;
-                                            normalize_username = SaganNormalizeLiblognorm.username;
+                                            ip_src = SaganProcSyslog_LOCAL->syslog_host;
+                                            IP_Set( &ip_src_addr, ip_src );
+                                            ip_src_flag = false;
                                         }
 
-                                    if ( SaganNormalizeLiblognorm.http_uri[0] != '\0' )
-                                        {
-                                            liblognorm_status = true;
-                                            normalize_http_uri = SaganNormalizeLiblognorm.http_uri;
-                                        }
+                                    ip_srcport_u32 = lookup_cache[gen->rulestruct[b].s_find_src_pos-1].port;
+                                    proto = lookup_cache[0].proto;
+                                    ip_src_flag = true;
 
-                                    if ( SaganNormalizeLiblognorm.filename[0] != '\0' )
-                                        {
-                                            liblognorm_status = true;
-                                            normalize_filename = SaganNormalizeLiblognorm.filename;
-                                        }
+                                }
 
-                                    if ( SaganNormalizeLiblognorm.ja3[0] != '\0' )
-                                        {
-                                            liblognorm_status = true;
-                                            normalize_ja3 = SaganNormalizeLiblognorm.ja3;
-                                        }
+                        }
 
-                                    if ( SaganNormalizeLiblognorm.event_id[0] != '\0' )
-                                        {
-                                            liblognorm_status = true;
-                                            strlcpy(SaganProcSyslog_LOCAL->event_id, SaganNormalizeLiblognorm.event_id, sizeof(SaganProcSyslog_LOCAL->event_id));
-                                        }
 
-                                }
+                    /* parse_dst_ip: {position} */
+
+                    if ( ip_dst_flag == false && gen->rulestruct[b].s_find_dst_ip == true )
+                        {
 
-                            if ( liblognorm_status == true && rulestruct[b].normalize == true )
+                            if ( lookup_cache[gen->rulestruct[b].s_find_dst_pos-1].status == true )
                                 {
-                                    if ( SaganNormalizeLiblognorm.ip_src[0] != '0')
-                                        {
-                                            ip_src_flag = true;
-                                            ip_src = SaganNormalizeLiblognorm.ip_src;
 
-                                            if ( !strcmp(ip_src, "127.0.0.1") ||
-                                                    !strcmp(ip_src, "::1" ) ||
-                                                    !strcmp(ip_src, "::ffff:127.0.0.1" ) )
-                                                {
+                                    memcpy(parse_ip_dst, lookup_cache[gen->rulestruct[b].s_find_dst_pos-1].ip, MAXIP );
+                                    memcpy(ip_dst_addr.bits, lookup_cache[gen->rulestruct[b].s_find_dst_pos-1].ip_bits, MAXIPBIT);
+                                    ip_dst_addr.family = lookup_cache[gen->rulestruct[b].s_find_dst_pos-1].family;
+                                    ip_dst_addr.text = parse_ip_dst;
+                                    ip_dst = parse_ip_dst;
 
-                                                    ip_src = SaganProcSyslog_LOCAL->syslog_host;
-                                                    ip_src_flag = false;
-                                                }
+                                    if ( !strcmp(ip_dst, "127.0.0.1") ||
+                                            !strcmp(ip_dst, "::1" ) ||
+                                            !strcmp(ip_dst, "::ffff:127.0.0.1" ))
+                                        {
 
-                                            else
-                                                {
+                                            ip_dst = SaganProcSyslog_LOCAL->syslog_host;
+                                            IP_Set( &ip_dst_addr, ip_dst );
+                                            ip_dst_flag = false;
 
-                                                    IP2Bit(ip_src, ip_src_bits);
-                                                }
+                                        }
 
+                                    ip_dstport_u32 = lookup_cache[gen->rulestruct[b].s_find_dst_pos-1].port;
+                                    proto = lookup_cache[0].proto;
+                                    ip_dst_flag = true;
 
-                                        }
+                                }
 
+                        }
 
-                                    if ( SaganNormalizeLiblognorm.ip_dst[0] != '0' )
-                                        {
-                                            ip_dst_flag = true;
-                                            ip_dst = SaganNormalizeLiblognorm.ip_dst;
+                    /* parse_hash: md5 */
 
-                                            if ( !strcmp(ip_dst, "127.0.0.1") ||
-                                                    !strcmp(ip_dst, "::1" ) ||
-                                                    !strcmp(ip_dst, "::ffff:127.0.0.1" ) )
+                    if ( gen->rulestruct[b].s_find_hash_type == PARSE_HASH_MD5 )
+                        {
+                            md5_hash = Event_Cache_Hash( EventCache, PARSE_HASH_MD5 );
+                        }
 
-                                                {
-                                                    ip_dst = SaganProcSyslog_LOCAL->syslog_host;
-                                                    ip_dst_flag = false;
-                                                }
+                    else if ( gen->rulestruct[b].s_find_hash_type == PARSE_HASH_SHA1 )
+                        {
+                            sha1_hash = Event_Cache_Hash( EventCache, PARSE_HASH_SHA1 );
+                        }
 
-                                            else
-                                                {
-                                                    IP2Bit(ip_dst, ip_dst_bits);
-                                                }
+                    else if ( gen->rulestruct[b].s_find_hash_type == PARSE_HASH_SHA256 )
+                        {
+                            sha256_hash = Event_Cache_Hash( EventCache, PARSE_HASH_SHA256 );
+                        }
 
+                    /* If the rule calls for proto searching,  we do it now */
 
-                                        }
+                    if ( gen->rulestruct[b].s_find_proto_program == true )
+                        {
+                            proto = Event_Cache_Proto_Program( EventCache );
+                        }
 
-                                    if ( SaganNormalizeLiblognorm.src_port != 0 )
-                                        {
-                                            ip_srcport_u32 = SaganNormalizeLiblognorm.src_port;
-                                        }
 
+                    /* If proto is not searched or has failed,  default to whatever the rule told us to use */
 
-                                    if ( SaganNormalizeLiblognorm.dst_port != 0 )
-                                        {
-                                            ip_dstport_u32 = SaganNormalizeLiblognorm.dst_port;
-                                        }
+                    if ( ip_src_flag == false )
+                        {
 
-                                    if ( SaganNormalizeLiblognorm.hash_md5[0] != '\0' )
-                                        {
-                                            md5_hash = SaganNormalizeLiblognorm.hash_md5;
-                                        }
+                            /* We don't want 127.0.0.1,  so if the source is that, we change it to config->sagan_host */
 
-                                    if ( SaganNormalizeLiblognorm.hash_sha1[0] != '\0' )
-                                        {
-                                            sha1_hash = SaganNormalizeLiblognorm.hash_sha1;
-                                        }
+                            if (!strcmp(SaganProcSyslog_LOCAL->syslog_host, "127.0.0.1") ||
+                                    !strcmp(SaganProcSyslog_LOCAL->syslog_host, "::1" ) ||
+                                    !strcmp(SaganProcSyslog_LOCAL->syslog_host, "::ffff:127.0.0.1" ) )
 
-                                    if ( SaganNormalizeLiblognorm.hash_sha256[0] != '\0' )
-                                        {
-                                            sha256_hash = SaganNormalizeLiblognorm.hash_sha256;
-                                        }
+                                {
+                                    ip_src = config->sagan_host;
+                                }
+                            else
+                                {
 
+                                    ip_src = SaganProcSyslog_LOCAL->syslog_host;
                                 }
-#endif
 
+                            Event_Cache_IP( EventCache, EVENT_CACHE_IP_HOST, ip_src, &ip_src_addr );
+
+                        }
 
-                            /* Normalization should always over ride parse_src_ip/parse_dst_ip/parse_port,
-                             * _unless_ liblognorm fails and both are in a rule or liblognorm failed to get src or dst */
+                    if ( ip_dst_flag == false )
+                        {
 
-                            /* parse_src_ip: {position} - Parse_IP build a cache table for IPs, ports, etc.  This way,
-                            we only parse the syslog string one time regardless of the rule options! */
+                            /* We don't want 127.0.0.1,  so if the source is that, we
+                            change it to config->sagan_host */
 
-                            if ( rulestruct[b].s_find_src_ip == true ||
-                                    rulestruct[b].s_find_src_ip == true ||
-                                    rulestruct[b].blacklist_ipaddr_all == true ||
-                                    rulestruct[b].s_find_proto == true ||
-#ifdef WITH_BLUEDOT
-                                    rulestruct[b].bluedot_ipaddr_type == 4 ||
-#endif
-                                    rulestruct[b].brointel_ipaddr_all == true )
+                            if (!strcmp(SaganProcSyslog_LOCAL->syslog_host, "127.0.0.1") ||
+                                    !strcmp(SaganProcSyslog_LOCAL->syslog_host, "::1" ) ||
+                                    !strcmp(SaganProcSyslog_LOCAL->syslog_host, "::ffff:127.0.0.1" ) )
+                                {
+                                    ip_dst = config->sagan_host;
+                                }
+                            else
                                 {
 
-                                    lookup_cache_size = Parse_IP(SaganProcSyslog_LOCAL->syslog_message, lookup_cache );
+                                    ip_dst = SaganProcSyslog_LOCAL->syslog_host;
 
                                 }
 
-                            if ( ip_src_flag == false && rulestruct[b].s_find_src_ip == true )
-                                {
+                            Event_Cache_IP( EventCache, EVENT_CACHE_IP_HOST, ip_dst, &ip_dst_addr );
+                        }
 
+                    /* No source port was normalized, Use the rules default */
 
-                                    if ( lookup_cache[rulestruct[b].s_find_src_pos-1].status == true )
-                                        {
+                    if ( ip_srcport_u32 == 0 )
+                        {
+                            ip_srcport_u32=gen->rulestruct[b].default_src_port;
+                        }
 
+                    /* No destination port was normalzied. Use the rules default */
 
-                                            memcpy(parse_ip_src, lookup_cache[rulestruct[b].s_find_src_pos-1].ip, MAXIP );
-                                            memcpy(ip_src_bits, lookup_cache[rulestruct[b].s_find_src_pos-1].ip_bits, MAXIPBIT);
+                    if ( ip_dstport_u32 == 0 )
+                        {
+                            ip_dstport_u32=gen->rulestruct[b].default_dst_port;
+                        }
 
-                                            ip_src = parse_ip_src;
+                    /* No protocol was normalized.  Use the rules default */
 
-                                            if ( !strcmp(ip_src, "127.0.0.1") ||
-                                                    !strcmp(ip_src, "::1" ) ||
-                                                    !strcmp(ip_src, "::ffff:127.0.0.1" ) )
-                                                {
+                    if ( proto == 0 )
+                        {
+                            proto = gen->rulestruct[b].default_proto;
+                        }
 
-                                                    ip_src = SaganProcSyslog_LOCAL->syslog_host;
-                                                    ip_src_flag = false;
-                                                }
+                    strlcpy(s_msg, gen->rulestruct[b].s_msg, sizeof(s_msg));
 
-                                            ip_srcport_u32 = lookup_cache[rulestruct[b].s_find_src_pos-1].port;
-                                            proto = lookup_cache[0].proto;
-                                            ip_src_flag = true;
+                    /* Check for flow of rule - has_flow is set as rule loading.  It 1, then
+                    the rule has some sort of flow.  It 0,  rule is set any:any/any:any */
 
-                                        }
+                    if ( gen->ruletable->flags[b] & RULE_FLAG_FLOW )
+                        {
+
+                            SaganRouting->check_flow_return = Check_Flow( b, proto, ip_src_addr.bits, ip_srcport_u32, ip_dst_addr.bits, ip_dstport_u32);
+
+                            if( SaganRouting->check_flow_return == false)
+                                {
+
+                                    __atomic_add_fetch(&counters->follow_flow_drop, 1, __ATOMIC_SEQ_CST);
 
                                 }
 
+                            __atomic_add_fetch(&counters->follow_flow_total, 1, __ATOMIC_SEQ_CST);
 
-                            /* parse_dst_ip: {position} */
+                        }
 
-                            if ( ip_dst_flag == false && rulestruct[b].s_find_dst_ip == true )
-                                {
 
-                                    if ( lookup_cache[rulestruct[b].s_find_dst_pos-1].status == true )
-                                        {
+                    /****************************************************************************
+                     * flexbit/xbit "pause"/"upause".  This lets flexbits/xbit settle in "tight"
+                     * timing situations.  Rather than sleep here,  the event and rule are
+                     * parked and the rule is run again (past its content/pcre/etc checks)
+                     * later by the "SaganDefer" thread.  See engine-defer.c
+                     ****************************************************************************/
 
-                                            memcpy(parse_ip_dst, lookup_cache[rulestruct[b].s_find_dst_pos-1].ip, MAXIP );
-                                            memcpy(ip_dst_bits, lookup_cache[rulestruct[b].s_find_dst_pos-1].ip_bits, MAXIPBIT);
-                                            ip_dst = parse_ip_dst;
+                    if ( Defer == NULL && ( gen->ruletable->flags[b] & RULE_FLAG_PAUSE ) )
+                        {
 
-                                            if ( !strcmp(ip_dst, "127.0.0.1") ||
-                                                    !strcmp(ip_dst, "::1" ) ||
-                                                    !strcmp(ip_dst, "::ffff:127.0.0.1" ))
-                                                {
+                            pause_usec = ( (uint64_t)gen->rulestruct[b].flexbit_pause_time * 1000000 ) + gen->rulestruct[b].flexbit_upause_time +
+                                         ( (uint64_t)gen->rulestruct[b].xbit_pause_time * 1000000 ) + gen->rulestruct[b].xbit_upause_time;
 
-                                                    ip_dst = SaganProcSyslog_LOCAL->syslog_host;
-                                                    ip_dst_flag = false;
+                            if ( debug->debugxbit )
+                                {
+                                    Sagan_Log(DEBUG, "[%s, line %d] flexbit/xbit pause for %" PRIu64 " microseconds", __FILE__, __LINE__, pause_usec);
+                                }
 
-                                                }
+                            if ( Engine_Defer( SaganProcSyslog_LOCAL, b, EventCache->append_program_done, tp, pause_usec ) == true )
+                                {
 
-                                            ip_dstport_u32 = lookup_cache[rulestruct[b].s_find_dst_pos-1].port;
-                                            proto = lookup_cache[0].proto;
-                                            ip_dst_flag = true;
+                                    SaganRouting->check_flow_return = true;
 
+                                    if ( rule_profile != NULL )
+                                        {
+                                            rule_profile[b].ticks += Rule_Profile_Ticks() - profile_ticks;
                                         }
 
+                                    continue;
                                 }
 
-                            /* parse_hash: md5 */
+                            /* Too much is parked already.  Block like we used to */
+
+                            Engine_Pause( pause_usec );
+                        }
+
+                    /****************************************************************************
+                     * xbit - ISSET || ISNOTSET
+                     ****************************************************************************/
+
+                    if ( ( gen->ruletable->flags[b] & RULE_FLAG_XBIT ) && ( gen->rulestruct[b].xbit_isset_count || gen->rulestruct[b].xbit_isnotset_count ) )
+                        {
+                            SaganRouting->xbit_return = Xbit_Condition(b, &ip_src_addr, &ip_dst_addr);
+                        }
+
+                    /****************************************************************************
+                     * flexbit - ISSET || ISNOTSET
+                     ****************************************************************************/
 
-                            if ( parse_md5_hash[0] == '\0' && rulestruct[b].s_find_hash_type == PARSE_HASH_MD5 )
+                    if ( gen->ruletable->flags[b] & RULE_FLAG_FLEXBIT )
+                        {
+
+                            if ( gen->rulestruct[b].flexbit_condition_count )
                                 {
-                                    Parse_Hash(SaganProcSyslog_LOCAL->syslog_message, PARSE_HASH_MD5, parse_md5_hash, sizeof(parse_md5_hash));
-                                    md5_hash = parse_md5_hash;
+                                    SaganRouting->flexbit_return = Flexbit_Condition(b, &ip_src_addr, &ip_dst_addr, ip_srcport_u32, ip_dstport_u32);
                                 }
 
-                            else if ( parse_sha1_hash[0] == '\0' && rulestruct[b].s_find_hash_type == PARSE_HASH_SHA1 )
+                            if ( gen->rulestruct[b].flexbit_count_flag )
                                 {
-                                    Parse_Hash(SaganProcSyslog_LOCAL->syslog_message, PARSE_HASH_SHA1, parse_sha256_hash, sizeof(parse_sha1_hash));
-                                    sha1_hash = parse_sha1_hash;
+                                    SaganRouting->flexbit_count_return = Flexbit_Count(b, &ip_src_addr, &ip_dst_addr);
                                 }
 
-                            else if ( parse_sha256_hash[0] == '\0' && rulestruct[b].s_find_hash_type == PARSE_HASH_SHA256 )
+                        }
+
+
+                    /****************************************************************************
+                     * Country code
+                     ****************************************************************************/
+
+#ifdef HAVE_LIBMAXMINDDB
+
+                    if ( gen->rulestruct[b].geoip2_flag )
+                        {
+
+                            /* Set geoip2_return to GEOIP_SKIP in case ip_src_flag
+                               or ip_dst_flag is false! This way it will short
+                               circuit past the rest of the GeoIP logic. */
+
+                            geoip2_return = GEOIP_SKIP;
+                            SaganRouting->geoip2_isset = false;
+
+                            if ( ip_src_flag == true && gen->rulestruct[b].geoip2_src_or_dst == 1 )
                                 {
-                                    Parse_Hash(SaganProcSyslog_LOCAL->syslog_message, PARSE_HASH_SHA256, parse_sha256_hash, sizeof(parse_sha256_hash));
-                                    sha256_hash = parse_sha256_hash;
+                                    geoip2_return = GeoIP2_Lookup_Country( &ip_src_addr, b );
                                 }
 
-                            /* If the rule calls for proto searching,  we do it now */
-
-                            if ( rulestruct[b].s_find_proto_program == true )
+                            else if ( ip_dst_flag == true && gen->rulestruct[b].geoip2_src_or_dst == 2 )
                                 {
-                                    proto = Parse_Proto_Program(SaganProcSyslog_LOCAL->syslog_program);
+                                    geoip2_return = GeoIP2_Lookup_Country( &ip_dst_addr, b );
                                 }
 
+                            if ( geoip2_return != GEOIP_SKIP )
+                                {
 
-                            /* If proto is not searched or has failed,  default to whatever the rule told us to use */
+                                    /* If country IS NOT {my value} return 1 */
 
-                            if ( ip_src_flag == false )
-                                {
+                                    if ( gen->rulestruct[b].geoip2_type == 1 )    		/* isnot */
+                                        {
 
-                                    /* We don't want 127.0.0.1,  so if the source is that, we change it to config->sagan_host */
+                                            if ( geoip2_return == GEOIP_HIT )
+                                                {
+                                                    SaganRouting->geoip2_isset = false;
+                                                }
+                                            else
+                                                {
+                                                    SaganRouting->geoip2_isset = true;
 
-                                    if (!strcmp(SaganProcSyslog_LOCAL->syslog_host, "127.0.0.1") ||
-                                            !strcmp(SaganProcSyslog_LOCAL->syslog_host, "::1" ) ||
-                                            !strcmp(SaganProcSyslog_LOCAL->syslog_host, "::ffff:127.0.0.1" ) )
+                                                    __atomic_add_fetch(&counters->geoip2_hit, 1, __ATOMIC_SEQ_CST);
 
-                                        {
-                                            ip_src = config->sagan_host;
+                                                }
                                         }
-                                    else
+
+                                    /* If country IS {my value} return 1 */
+
+                                    else if ( gen->rulestruct[b].geoip2_type == 2 )             /* is */
                                         {
 
-                                            ip_src = SaganProcSyslog_LOCAL->syslog_host;
-                                        }
+                                            if ( geoip2_return == GEOIP_HIT )
+                                                {
+                                                    SaganRouting->geoip2_isset = true;
 
-                                    IP2Bit(ip_src, ip_src_bits);
+                                                    __atomic_add_fetch(&counters->geoip2_hit, 1, __ATOMIC_SEQ_CST);
+
+                                                }
+                                            else
+                                                {
 
+                                                    SaganRouting->geoip2_isset = false;
+                                                }
+                                        }
                                 }
+                        }
 
-                            if ( ip_dst_flag == false )
-                                {
+#endif
 
-                                    /* We don't want 127.0.0.1,  so if the source is that, we
-                                    change it to config->sagan_host */
+                    /****************************************************************************
+                     * Time based alerting
+                     ****************************************************************************/
 
-                                    if (!strcmp(SaganProcSyslog_LOCAL->syslog_host, "127.0.0.1") ||
-                                            !strcmp(SaganProcSyslog_LOCAL->syslog_host, "::1" ) ||
-                                            !strcmp(SaganProcSyslog_LOCAL->syslog_host, "::ffff:127.0.0.1" ) )
-                                        {
-                                            ip_dst = config->sagan_host;
-                                        }
-                                    else
-                                        {
+                    if ( gen->rulestruct[b].alert_time_flag )
+                        {
 
-                                            ip_dst = SaganProcSyslog_LOCAL->syslog_host;
+                            SaganRouting->alert_time_trigger = false;
 
-                                        }
+                            if ( Check_Time(b) )
+                                {
+                                    SaganRouting->alert_time_trigger = true;
+                                }
+                        }
+
+                    /****************************************************************************
+                     * Blacklist
+                     ****************************************************************************/
 
-                                    IP2Bit(ip_dst, ip_dst_bits);
-                                }
+                    if ( gen->rulestruct[b].blacklist_flag )
+                        {
 
-                            /* No source port was normalized, Use the rules default */
+                            SaganRouting->blacklist_results = false;
 
-                            if ( ip_srcport_u32 == 0 )
+                            if ( gen->rulestruct[b].blacklist_ipaddr_src && ip_src_flag )
                                 {
-                                    ip_srcport_u32=rulestruct[b].default_src_port;
+                                    SaganRouting->blacklist_results = Sagan_Blacklist_IPADDR( ip_src_addr.bits );
                                 }
 
-                            /* No destination port was normalzied. Use the rules default */
-
-                            if ( ip_dstport_u32 == 0 )
+                            if ( SaganRouting->blacklist_results == false && gen->rulestruct[b].blacklist_ipaddr_dst && ip_dst_flag )
                                 {
-                                    ip_dstport_u32=rulestruct[b].default_dst_port;
+                                    SaganRouting->blacklist_results = Sagan_Blacklist_IPADDR( ip_dst_addr.bits );
                                 }
 
-                            /* No protocol was normalized.  Use the rules default */
+                            if ( SaganRouting->blacklist_results == false && gen->rulestruct[b].blacklist_ipaddr_all )
+                                {
+                                    SaganRouting->blacklist_results = Sagan_Blacklist_IPADDR_All(SaganProcSyslog_LOCAL->syslog_message, lookup_cache, lookup_cache_size);
+                                }
 
-                            if ( proto == 0 )
+                            if ( SaganRouting->blacklist_results == false && gen->rulestruct[b].blacklist_ipaddr_both && ip_src_flag && ip_dst_flag )
                                 {
-                                    proto = rulestruct[b].default_proto;
+                                    if ( Sagan_Blacklist_IPADDR( ip_src_addr.bits ) || Sagan_Blacklist_IPADDR( ip_dst_addr.bits ) )
+                                        {
+                                            SaganRouting->blacklist_results = true;
+                                        }
                                 }
+                        }
 
-                            strlcpy(s_msg, rulestruct[b].s_msg, sizeof(s_msg));
+#ifdef WITH_BLUEDOT
+
+                    if ( config->bluedot_flag )
+                        {
 
-                            /* Check for flow of rule - has_flow is set as rule loading.  It 1, then
-                            the rule has some sort of flow.  It 0,  rule is set any:any/any:any */
+                            bluedot_results = 0;
+                            bluedot_json[0] = '\0';
 
-                            if ( rulestruct[b].has_flow == true )
+                            if ( gen->rulestruct[b].bluedot_ipaddr_type )
                                 {
 
-                                    SaganRouting->check_flow_return = Check_Flow( b, proto, ip_src_bits, ip_srcport_u32, ip_dst_bits, ip_dstport_u32);
+                                    /* 1 == src,  2 == dst,  3 == both,  4 == all */
 
-                                    if( SaganRouting->check_flow_return == false)
+                                    if ( gen->rulestruct[b].bluedot_ipaddr_type == 1 && ip_src_flag )
                                         {
-
-                                            __atomic_add_fetch(&counters->follow_flow_drop, 1, __ATOMIC_SEQ_CST);
-
+                                            bluedot_results = Sagan_Bluedot_Lookup_IP( &ip_src_addr, b, bluedot_json, sizeof(bluedot_json));
+                                            SaganRouting->bluedot_ip_flag = Sagan_Bluedot_Cat_Compare( bluedot_results, b, BLUEDOT_LOOKUP_IP);
                                         }
 
-                                    __atomic_add_fetch(&counters->follow_flow_total, 1, __ATOMIC_SEQ_CST);
+                                    if ( gen->rulestruct[b].bluedot_ipaddr_type == 2 && ip_dst_flag )
+                                        {
+                                            bluedot_results = Sagan_Bluedot_Lookup_IP( &ip_dst_addr, b, bluedot_json, sizeof(bluedot_json));
+                                            SaganRouting->bluedot_ip_flag = Sagan_Bluedot_Cat_Compare( bluedot_results, b, BLUEDOT_LOOKUP_IP);
+                                        }
 
-                                }
+                                    if ( gen->rulestruct[b].bluedot_ipaddr_type == 3 && ip_src_flag && ip_dst_flag )
+                                        {
 
+                                            bluedot_results = Sagan_Bluedot_Lookup_IP( &ip_src_addr, b, bluedot_json, sizeof(bluedot_json));
+                                            SaganRouting->bluedot_ip_flag = Sagan_Bluedot_Cat_Compare( bluedot_results, b, BLUEDOT_LOOKUP_IP);
+                                            /* If the source isn't found,  then check the dst */
 
-                            /****************************************************************************
-                                             * flexbit/xbit "upause".  This lets flexbits/xbit settle in "tight" timing situations.
-                              ****************************************************************************/
+                                            if ( SaganRouting->bluedot_ip_flag == 0 )
+                                                {
+                                                    bluedot_results = Sagan_Bluedot_Lookup_IP( &ip_dst_addr, b, bluedot_json, sizeof(bluedot_json));
+                                                    SaganRouting->bluedot_ip_flag = Sagan_Bluedot_Cat_Compare( bluedot_results, b, BLUEDOT_LOOKUP_IP);
+                                                }
 
+                                        }
 
-                            /* pause (seconds) */
+                                    if ( lookup_cache_size > 0 && gen->rulestruct[b].bluedot_ipaddr_type == 4 )
+                                        {
 
-                            if ( rulestruct[b].flexbit_pause_time != 0 )
-                                {
+                                            SaganRouting->bluedot_ip_flag = Sagan_Bluedot_IP_Lookup_All(SaganProcSyslog_LOCAL->syslog_message, b, lookup_cache, lookup_cache_size );
 
-                                    if ( debug->debugxbit )
-                                        {
-                                            Sagan_Log(DEBUG, "[%s, line %d] flexbit_pause for %d seconds", __FILE__, __LINE__, rulestruct[b].flexbit_pause_time);
                                         }
 
 
-                                    sleep( rulestruct[b].flexbit_pause_time );
                                 }
 
-                            /* upause (millisecond) */
 
-                            if ( rulestruct[b].flexbit_upause_time != 0 )
+
+                            if ( gen->rulestruct[b].bluedot_file_hash )
                                 {
-                                    if ( debug->debugxbit )
-                                        {
-                                            Sagan_Log(DEBUG, "[%s, line %d] flexbit_pause for %d microseconds", __FILE__, __LINE__, rulestruct[b].flexbit_upause_time);
-                                        }
 
-                                    usleep( rulestruct[b].flexbit_upause_time );
-                                }
 
-                            /* pause (second) */
+                                    if ( md5_hash[0] != '\0')
+                                        {
 
-                            if ( rulestruct[b].xbit_pause_time != 0 )
-                                {
+                                            bluedot_results = Sagan_Bluedot_Lookup( md5_hash, BLUEDOT_LOOKUP_HASH, b, bluedot_json, sizeof(bluedot_json));
+                                            SaganRouting->bluedot_hash_flag = Sagan_Bluedot_Cat_Compare( bluedot_results, b, BLUEDOT_LOOKUP_HASH);
 
-                                    if ( debug->debugxbit )
-                                        {
-                                            Sagan_Log(DEBUG, "[%s, line %d] xbit_pause for %d seconds", __FILE__, __LINE__, rulestruct[b].xbit_pause_time);
                                         }
 
-                                    sleep( rulestruct[b].xbit_pause_time );
-                                }
-
-                            if ( rulestruct[b].xbit_upause_time != 0 )
-                                {
-                                    if ( debug->debugxbit )
+                                    if ( sha1_hash[0] != '\0' )
                                         {
-                                            Sagan_Log(DEBUG, "[%s, line %d] xbit_upause for %d microseconds", __FILE__, __LINE__, rulestruct[b].xbit_upause_time);
+
+                                            bluedot_results = Sagan_Bluedot_Lookup( sha1_hash, BLUEDOT_LOOKUP_HASH, b, bluedot_json, sizeof(bluedot_json));
+                                            SaganRouting->bluedot_hash_flag = Sagan_Bluedot_Cat_Compare( bluedot_results, b, BLUEDOT_LOOKUP_HASH );
+
                                         }
 
+                                    if ( sha256_hash[0] != '\0')
+                                        {
 
-                                    sleep( rulestruct[b].xbit_upause_time );
-                                }
+                                            bluedot_results = Sagan_Bluedot_Lookup( sha256_hash, BLUEDOT_LOOKUP_HASH, b, bluedot_json, sizeof(bluedot_json));
+                                            SaganRouting->bluedot_hash_flag = Sagan_Bluedot_Cat_Compare( bluedot_results, b, BLUEDOT_LOOKUP_HASH);
 
-                            /****************************************************************************
-                             * xbit - ISSET || ISNOTSET
-                             ****************************************************************************/
+                                        }
 
-                            if ( rulestruct[b].xbit_flag && ( rulestruct[b].xbit_isset_count || rulestruct[b].xbit_isnotset_count ) )
-                                {
-                                    SaganRouting->xbit_return = Xbit_Condition(b, ip_src, ip_dst);
                                 }
 
-                            /****************************************************************************
-                             * flexbit - ISSET || ISNOTSET
-                             ****************************************************************************/
-
-                            if ( rulestruct[b].flexbit_flag )
+                            if ( gen->rulestruct[b].bluedot_url && normalize_http_uri != NULL )
                                 {
 
-                                    if ( rulestruct[b].flexbit_condition_count )
-                                        {
-                                            SaganRouting->flexbit_return = Flexbit_Condition(b, ip_src, ip_dst, ip_srcport_u32, ip_dstport_u32);
-                                        }
-
-                                    if ( rulestruct[b].flexbit_count_flag )
-                                        {
-                                            SaganRouting->flexbit_count_return = Flexbit_Count(b, ip_src, ip_dst);
-                                        }
+                                    bluedot_results = Sagan_Bluedot_Lookup( normalize_http_uri, BLUEDOT_LOOKUP_URL, b, bluedot_json, sizeof(bluedot_json));
+                                    SaganRouting->bluedot_url_flag = Sagan_Bluedot_Cat_Compare( bluedot_results, b, BLUEDOT_LOOKUP_URL);
 
                                 }
 
+                            if ( gen->rulestruct[b].bluedot_filename && normalize_filename != NULL )
+                                {
 
-                            /****************************************************************************
-                             * Country code
-                             ****************************************************************************/
+                                    bluedot_results = Sagan_Bluedot_Lookup( normalize_filename, BLUEDOT_LOOKUP_FILENAME, b, bluedot_json, sizeof(bluedot_json));
+                                    SaganRouting->bluedot_filename_flag = Sagan_Bluedot_Cat_Compare( bluedot_results, b, BLUEDOT_LOOKUP_FILENAME);
 
-#ifdef HAVE_LIBMAXMINDDB
+                                }
 
-                            if ( rulestruct[b].geoip2_flag )
+                            if ( gen->rulestruct[b].bluedot_ja3 && normalize_ja3 != NULL )
                                 {
 
-                                    /* Set geoip2_return to GEOIP_SKIP in case ip_src_flag
-                                       or ip_dst_flag is false! This way it will short
-                                       circuit past the rest of the GeoIP logic. */
+                                    bluedot_results = Sagan_Bluedot_Lookup( normalize_ja3, BLUEDOT_LOOKUP_JA3, b, bluedot_json, sizeof(bluedot_json));
+                                    SaganRouting->bluedot_ja3_flag = Sagan_Bluedot_Cat_Compare( bluedot_results, b, BLUEDOT_LOOKUP_JA3);
 
-                                    geoip2_return = GEOIP_SKIP;
-                                    SaganRouting->geoip2_isset = false;
+                                }
 
-                                    if ( ip_src_flag == true && rulestruct[b].geoip2_src_or_dst == 1 )
-                                        {
-                                            geoip2_return = GeoIP2_Lookup_Country(ip_src, b );
-                                        }
 
-                                    else if ( ip_dst_flag == true && rulestruct[b].geoip2_src_or_dst == 2 )
-                                        {
-                                            geoip2_return = GeoIP2_Lookup_Country(ip_dst, b );
-                                        }
 
-                                    if ( geoip2_return != GEOIP_SKIP )
-                                        {
+                            /* Do cleanup at the end in case any "hits" above refresh the cache.  This why we don't
+                             * "delete" an entry only to re-add it! */
 
-                                            /* If country IS NOT {my value} return 1 */
+                            Sagan_Bluedot_Check_Cache_Time();
 
-                                            if ( rulestruct[b].geoip2_type == 1 )    		/* isnot */
-                                                {
 
-                                                    if ( geoip2_return == GEOIP_HIT )
-                                                        {
-                                                            SaganRouting->geoip2_isset = false;
-                                                        }
-                                                    else
-                                                        {
-                                                            SaganRouting->geoip2_isset = true;
+                        }
+#endif
 
-                                                            __atomic_add_fetch(&counters->geoip2_hit, 1, __ATOMIC_SEQ_CST);
 
-                                                        }
-                                                }
+                    /****************************************************************************
+                    * Bro Intel
+                    ****************************************************************************/
 
-                                            /* If country IS {my value} return 1 */
+                    if ( gen->rulestruct[b].brointel_flag )
+                        {
 
-                                            else if ( rulestruct[b].geoip2_type == 2 )             /* is */
-                                                {
+                            SaganRouting->brointel_results = false;
 
-                                                    if ( geoip2_return == GEOIP_HIT )
-                                                        {
-                                                            SaganRouting->geoip2_isset = true;
+                            if ( gen->rulestruct[b].brointel_ipaddr_src && ip_src_flag )
+                                {
+                                    SaganRouting->brointel_results = Sagan_BroIntel_IPADDR( ip_src_addr.bits, ip_src );
+                                }
 
-                                                            __atomic_add_fetch(&counters->geoip2_hit, 1, __ATOMIC_SEQ_CST);
+                            if ( SaganRouting->brointel_results == false && gen->rulestruct[b].brointel_ipaddr_dst && ip_dst_flag )
+                                {
+                                    SaganRouting->brointel_results = Sagan_BroIntel_IPADDR( ip_dst_addr.bits, ip_dst );
+                                }
 
-                                                        }
-                                                    else
-                                                        {
+                            if ( SaganRouting->brointel_results == false && gen->rulestruct[b].brointel_ipaddr_all )
+                                {
+                                    SaganRouting->brointel_results = Sagan_BroIntel_IPADDR_All ( SaganProcSyslog_LOCAL->syslog_message, lookup_cache, MAX_PARSE_IP);
+                                }
 
-                                                            SaganRouting->geoip2_isset = false;
-                                                        }
-                                                }
+                            if ( SaganRouting->brointel_results == false && gen->rulestruct[b].brointel_ipaddr_both && ip_src_flag && ip_dst_flag )
+                                {
+                                    if ( Sagan_BroIntel_IPADDR( ip_src_addr.bits, ip_src ) || Sagan_BroIntel_IPADDR( ip_dst_addr.bits, ip_dst ) )
+                                        {
+                                            SaganRouting->brointel_results = true;
                                         }
                                 }
 
-#endif
+                            if ( SaganRouting->brointel_results == false && gen->rulestruct[b].brointel_domain )
+                                {
+                                    SaganRouting->brointel_results = Sagan_BroIntel_DOMAIN(SaganProcSyslog_LOCAL->syslog_message);
+                                }
 
-                            /****************************************************************************
-                             * Time based alerting
-                             ****************************************************************************/
+                            if ( SaganRouting->brointel_results == false && gen->rulestruct[b].brointel_file_hash )
+                                {
+                                    SaganRouting->brointel_results = Sagan_BroIntel_FILE_HASH(SaganProcSyslog_LOCAL->syslog_message);
+                                }
 
-                            if ( rulestruct[b].alert_time_flag )
+                            if ( SaganRouting->brointel_results == false && gen->rulestruct[b].brointel_url )
                                 {
+                                    SaganRouting->brointel_results = Sagan_BroIntel_URL(SaganProcSyslog_LOCAL->syslog_message);
+                                }
 
-                                    SaganRouting->alert_time_trigger = false;
+                            if ( SaganRouting->brointel_results == false && gen->rulestruct[b].brointel_software )
+                                {
+                                    SaganRouting->brointel_results = Sagan_BroIntel_SOFTWARE(SaganProcSyslog_LOCAL->syslog_message);
+                                }
 
-                                    if ( Check_Time(b) )
-                                        {
-                                            SaganRouting->alert_time_trigger = true;
-                                        }
+                            if ( SaganRouting->brointel_results == false && gen->rulestruct[b].brointel_user_name )
+                                {
+                                    SaganRouting->brointel_results = Sagan_BroIntel_USER_NAME(SaganProcSyslog_LOCAL->syslog_message);
                                 }
 
-                            /****************************************************************************
-                             * Blacklist
-                             ****************************************************************************/
+                            if ( SaganRouting->brointel_results == false && gen->rulestruct[b].brointel_file_name )
+                                {
+                                    SaganRouting->brointel_results = Sagan_BroIntel_FILE_NAME(SaganProcSyslog_LOCAL->syslog_message);
+                                }
 
-                            if ( rulestruct[b].blacklist_flag )
+                            if ( SaganRouting->brointel_results == false && gen->rulestruct[b].brointel_cert_hash )
                                 {
+                                    SaganRouting->brointel_results = Sagan_BroIntel_CERT_HASH(SaganProcSyslog_LOCAL->syslog_message);
+                                }
 
-                                    SaganRouting->blacklist_results = false;
+                        }
 
-                                    if ( rulestruct[b].blacklist_ipaddr_src && ip_src_flag )
-                                        {
-                                            SaganRouting->blacklist_results = Sagan_Blacklist_IPADDR( ip_src_bits );
-                                        }
+                    /****************************************************************************/
+                    /* Populate the Sagan Event array with the information needed.  This info    */
+                    /* will be passed to the threads.  No need to populate it _if_ we're in a   */
+                    /* threshold state.                                                         */
+                    /****************************************************************************/
 
-                                    if ( SaganRouting->blacklist_results == false && rulestruct[b].blacklist_ipaddr_dst && ip_dst_flag )
-                                        {
-                                            SaganRouting->blacklist_results = Sagan_Blacklist_IPADDR( ip_dst_bits );
-                                        }
+                    SaganRouting->position = b;
 
-                                    if ( SaganRouting->blacklist_results == false && rulestruct[b].blacklist_ipaddr_all )
-                                        {
-                                            SaganRouting->blacklist_results = Sagan_Blacklist_IPADDR_All(SaganProcSyslog_LOCAL->syslog_message, lookup_cache, lookup_cache_size);
-                                        }
+                    if ( Sagan_Check_Routing( SaganRouting ) == true )
+                        {
 
-                                    if ( SaganRouting->blacklist_results == false && rulestruct[b].blacklist_ipaddr_both && ip_src_flag && ip_dst_flag )
-                                        {
-                                            if ( Sagan_Blacklist_IPADDR( ip_src_bits ) || Sagan_Blacklist_IPADDR( ip_dst_bits ) )
-                                                {
-                                                    SaganRouting->blacklist_results = true;
-                                                }
-                                        }
+                            if ( rule_profile != NULL )
+                                {
+                                    rule_profile[b].triggers++;
                                 }
 
-#ifdef WITH_BLUEDOT
+                            /* After */
 
-                            if ( config->bluedot_flag )
+                            after_log_flag = false;
+
+                            if ( gen->ruletable->flags[b] & RULE_FLAG_AFTER )
                                 {
+                                    after_log_flag = After2 (b, &ip_src_addr, ip_srcport_u32, &ip_dst_addr, ip_dstport_u32, normalize_username, SaganProcSyslog_LOCAL->syslog_message );
+                                }
 
-                                    bluedot_results = 0;
-                                    bluedot_json[0] = '\0';
+                            /* Threshold */
 
-                                    if ( rulestruct[b].bluedot_ipaddr_type )
-                                        {
+                            thresh_log_flag = false;
 
-                                            /* 1 == src,  2 == dst,  3 == both,  4 == all */
+                            if ( ( gen->ruletable->flags[b] & RULE_FLAG_THRESHOLD ) && after_log_flag == false )
+                                {
+                                    thresh_log_flag = Threshold2 (b, &ip_src_addr, ip_srcport_u32, &ip_dst_addr, ip_dstport_u32, normalize_username, SaganProcSyslog_LOCAL->syslog_message );
+                                }
 
-                                            if ( rulestruct[b].bluedot_ipaddr_type == 1 && ip_src_flag )
-                                                {
-                                                    bluedot_results = Sagan_Bluedot_Lookup(ip_src, BLUEDOT_LOOKUP_IP, b, bluedot_json, sizeof(bluedot_json));
-                                                    SaganRouting->bluedot_ip_flag = Sagan_Bluedot_Cat_Compare( bluedot_results, b, BLUEDOT_LOOKUP_IP);
-                                                }
 
-                                            if ( rulestruct[b].bluedot_ipaddr_type == 2 && ip_dst_flag )
-                                                {
-                                                    bluedot_results = Sagan_Bluedot_Lookup(ip_dst, BLUEDOT_LOOKUP_IP, b, bluedot_json, sizeof(bluedot_json));
-                                                    SaganRouting->bluedot_ip_flag = Sagan_Bluedot_Cat_Compare( bluedot_results, b, BLUEDOT_LOOKUP_IP);
-                                                }
+                            if ( config->rule_tracking_flag == true )
+                                {
+                                    gen->Ruleset_Track[gen->rulestruct[b].ruleset_id].trigger = true;
+                                }
 
-                                            if ( rulestruct[b].bluedot_ipaddr_type == 3 && ip_src_flag && ip_dst_flag )
-                                                {
 
-                                                    bluedot_results = Sagan_Bluedot_Lookup(ip_src, BLUEDOT_LOOKUP_IP, b, bluedot_json, sizeof(bluedot_json));
-                                                    SaganRouting->bluedot_ip_flag = Sagan_Bluedot_Cat_Compare( bluedot_results, b, BLUEDOT_LOOKUP_IP);
-                                                    /* If the source isn't found,  then check the dst */
+                            __atomic_add_fetch(&counters->saganfound, 1, __ATOMIC_SEQ_CST);
 
-                                                    if ( SaganRouting->bluedot_ip_flag == 0 )
-                                                        {
-                                                            bluedot_results = Sagan_Bluedot_Lookup(ip_dst, BLUEDOT_LOOKUP_IP, b, bluedot_json, sizeof(bluedot_json));
-                                                            SaganRouting->bluedot_ip_flag = Sagan_Bluedot_Cat_Compare( bluedot_results, b, BLUEDOT_LOOKUP_IP);
-                                                        }
+                            /* Check for thesholding & "after" */
 
-                                                }
+                            if ( thresh_log_flag == false && after_log_flag == false )
+                                {
 
-                                            if ( lookup_cache_size > 0 && rulestruct[b].bluedot_ipaddr_type == 4 )
-                                                {
+                                    if ( debug->debugengine )
+                                        {
 
-                                                    SaganRouting->bluedot_ip_flag = Sagan_Bluedot_IP_Lookup_All(SaganProcSyslog_LOCAL->syslog_message, b, lookup_cache, lookup_cache_size );
+                                            Sagan_Log(DEBUG, "[%s, line %d] **[Trigger]*********************************", __FILE__, __LINE__);
+                                            Sagan_Log(DEBUG, "[%s, line %d] Program: %s | Facility: %s | Priority: %s | Level: %s | Tag: %s", __FILE__, __LINE__, SaganProcSyslog_LOCAL->syslog_program, SaganProcSyslog_LOCAL->syslog_facility, SaganProcSyslog_LOCAL->syslog_priority, SaganProcSyslog_LOCAL->syslog_level, SaganProcSyslog_LOCAL->syslog_tag);
+                                            Sagan_Log(DEBUG, "[%s, line %d] Threshold flag: %d | After flag: %d | Flexbit Flag: %d | Flexbit status: %d", __FILE__, __LINE__, thresh_log_flag, after_log_flag, gen->rulestruct[b].flexbit_flag, SaganRouting->flexbit_return);
+                                            Sagan_Log(DEBUG, "[%s, line %d] Triggering Message: %s", __FILE__, __LINE__, SaganProcSyslog_LOCAL->syslog_message);
 
-                                                }
+                                        }
 
+                                    /* Do we need to "set" an xbit? */
 
+                                    if ( gen->rulestruct[b].xbit_flag && ( gen->rulestruct[b].xbit_set_count || gen->rulestruct[b].xbit_unset_count ) )
+                                        {
+                                            Xbit_Set(b, &ip_src_addr, &ip_dst_addr, SaganProcSyslog_LOCAL);
                                         }
 
+                                    /* Check to "set" a flexbit */
 
+                                    if ( gen->rulestruct[b].flexbit_flag && gen->rulestruct[b].flexbit_set_count )
+                                        {
+                                            Flexbit_Set(b, &ip_src_addr, &ip_dst_addr, ip_srcport_u32, ip_dstport_u32, SaganProcSyslog_LOCAL);
+                                        }
 
-                                    if ( rulestruct[b].bluedot_file_hash )
+                                    threadid++;
+
+                                    if ( threadid >= MAX_THREADS )
                                         {
+                                            threadid=0;
+                                        }
 
 
-                                            if ( md5_hash[0] != '\0')
-                                                {
+                                    processor_info_engine->processor_name          =       s_msg;
+                                    processor_info_engine->processor_generator_id  =       SAGAN_PROCESSOR_GENERATOR_ID;
+                                    processor_info_engine->processor_facility      =       SaganProcSyslog_LOCAL->syslog_facility;
+                                    processor_info_engine->processor_priority      =       SaganProcSyslog_LOCAL->syslog_level;
+                                    processor_info_engine->processor_pri           =       gen->rulestruct[b].s_pri;
+                                    processor_info_engine->processor_class         =       gen->rulestruct[b].s_classtype;
+                                    processor_info_engine->processor_tag           =       SaganProcSyslog_LOCAL->syslog_tag;
+                                    processor_info_engine->processor_rev           =       gen->rulestruct[b].s_rev;
 
-                                                    bluedot_results = Sagan_Bluedot_Lookup( md5_hash, BLUEDOT_LOOKUP_HASH, b, bluedot_json, sizeof(bluedot_json));
-                                                    SaganRouting->bluedot_hash_flag = Sagan_Bluedot_Cat_Compare( bluedot_results, b, BLUEDOT_LOOKUP_HASH);
+                                    if ( gen->rulestruct[b].flexbit_flag == false || gen->rulestruct[b].flexbit_noalert == 0 )
+                                        {
 
+                                            if ( rule_profile != NULL )
+                                                {
+                                                    rule_profile[b].alerts++;
                                                 }
 
-                                            if ( sha256_hash[0] != '\0' )
+                                            if ( gen->rulestruct[b].type == NORMAL_RULE )
                                                 {
 
-                                                    bluedot_results = Sagan_Bluedot_Lookup( sha256_hash, BLUEDOT_LOOKUP_HASH, b, bluedot_json, sizeof(bluedot_json));
-                                                    SaganRouting->bluedot_hash_flag = Sagan_Bluedot_Cat_Compare( bluedot_results, b, BLUEDOT_LOOKUP_HASH );
+                                                    Send_Alert(SaganProcSyslog_LOCAL,
+                                                               json_normalize,
+                                                               processor_info_engine,
+                                                               &ip_src_addr,
+                                                               &ip_dst_addr,
+                                                               normalize_http_uri,
+                                                               normalize_http_hostname,
+                                                               proto,
+                                                               gen->rulestruct[b].s_sid,
+                                                               ip_srcport_u32,
+                                                               ip_dstport_u32,
+                                                               b, tp, bluedot_json, bluedot_results );
 
-                                                }
 
-                                            if ( sha256_hash[0] != '\0')
+                                                }
+                                            else
                                                 {
 
-                                                    bluedot_results = Sagan_Bluedot_Lookup( sha256_hash, BLUEDOT_LOOKUP_HASH, b, bluedot_json, sizeof(bluedot_json));
-                                                    SaganRouting->bluedot_hash_flag = Sagan_Bluedot_Cat_Compare( bluedot_results, b, BLUEDOT_LOOKUP_HASH);
+                                                    Sagan_Dynamic_Rules(SaganProcSyslog_LOCAL, b, processor_info_engine,
+                                                                        &ip_src_addr, &ip_dst_addr);
 
                                                 }
 
                                         }
 
-                                    if ( rulestruct[b].bluedot_url && normalize_http_uri != NULL )
-                                        {
-
-                                            bluedot_results = Sagan_Bluedot_Lookup( normalize_http_uri, BLUEDOT_LOOKUP_URL, b, bluedot_json, sizeof(bluedot_json));
-                                            SaganRouting->bluedot_url_flag = Sagan_Bluedot_Cat_Compare( bluedot_results, b, BLUEDOT_LOOKUP_URL);
 
-                                        }
+                                } /* Threshold / After */
 
-                                    if ( rulestruct[b].bluedot_filename && normalize_filename != NULL )
-                                        {
+                        } /* End of routing */
 
-                                            bluedot_results = Sagan_Bluedot_Lookup( normalize_filename, BLUEDOT_LOOKUP_FILENAME, b, bluedot_json, sizeof(bluedot_json));
-                                            SaganRouting->bluedot_filename_flag = Sagan_Bluedot_Cat_Compare( bluedot_results, b, BLUEDOT_LOOKUP_FILENAME);
+                } /* End of pcre/content/etc match */
 
-                                        }
+            SaganRouting->flexbit_return=false;	      /* Flexbit reset */
+            SaganRouting->xbit_return=false;            /* xbit reset */
+            SaganRouting->check_flow_return = true;      /* Rule flow direction reset */
 
-                                    if ( rulestruct[b].bluedot_ja3 && normalize_ja3 != NULL )
-                                        {
+            if ( rule_profile != NULL )
+                {
+                    rule_profile[b].ticks += Rule_Profile_Ticks() - profile_ticks;
+                }
 
-                                            bluedot_results = Sagan_Bluedot_Lookup( normalize_ja3, BLUEDOT_LOOKUP_JA3, b, bluedot_json, sizeof(bluedot_json));
-                                            SaganRouting->bluedot_ja3_flag = Sagan_Bluedot_Cat_Compare( bluedot_results, b, BLUEDOT_LOOKUP_JA3);
+        } /* End for for loop */
 
-                                        }
+    /* Nothing matched and nothing could have matched a different message
+       with the same template */
 
+    if ( template_key != 0 && template_match == false && template_unsafe == false )
+        {
+            Template_Cache_Add( template_key, template_generation );
+        }
 
 
-                                    /* Do cleanup at the end in case any "hits" above refresh the cache.  This why we don't
-                                     * "delete" an entry only to re-add it! */
+#ifdef HAVE_LIBFASTJSON
 
-                                    Sagan_Bluedot_Check_Cache_Time();
+    /* A parked event was logged when it was first seen */
 
+    if ( config->eve_flag && config->eve_logs && Defer == NULL )
+        {
+            Log_JSON(SaganProcSyslog_LOCAL, tp);
+        }
 
-                                }
 #endif
 
+    return(0);
+}
 
-                            /****************************************************************************
-                            * Bro Intel
-                            ****************************************************************************/
-
-                            if ( rulestruct[b].brointel_flag )
-                                {
-
-                                    SaganRouting->brointel_results = false;
-
-                                    if ( rulestruct[b].brointel_ipaddr_src && ip_src_flag )
-                                        {
-                                            SaganRouting->brointel_results = Sagan_BroIntel_IPADDR( ip_src_bits, ip_src );
-                                        }
-
-                                    if ( SaganRouting->brointel_results == false && rulestruct[b].brointel_ipaddr_dst && ip_dst_flag )
-                                        {
-                                            SaganRouting->brointel_results = Sagan_BroIntel_IPADDR( ip_dst_bits, ip_dst );
-                                        }
-
-                                    if ( SaganRouting->brointel_results == false && rulestruct[b].brointel_ipaddr_all )
-                                        {
-                                            SaganRouting->brointel_results = Sagan_BroIntel_IPADDR_All ( SaganProcSyslog_LOCAL->syslog_message, lookup_cache, MAX_PARSE_IP);
-                                        }
-
-                                    if ( SaganRouting->brointel_results == false && rulestruct[b].brointel_ipaddr_both && ip_src_flag && ip_dst_flag )
-                                        {
-                                            if ( Sagan_BroIntel_IPADDR( ip_src_bits, ip_src ) || Sagan_BroIntel_IPADDR( ip_dst_bits, ip_dst ) )
-                                                {
-                                                    SaganRouting->brointel_results = true;
-                                                }
-                                        }
-
-                                    if ( SaganRouting->brointel_results == false && rulestruct[b].brointel_domain )
-                                        {
-                                            SaganRouting->brointel_results = Sagan_BroIntel_DOMAIN(SaganProcSyslog_LOCAL->syslog_message);
-                                        }
-
-                                    if ( SaganRouting->brointel_results == false && rulestruct[b].brointel_file_hash )
-                                        {
-                                            SaganRouting->brointel_results = Sagan_BroIntel_FILE_HASH(SaganProcSyslog_LOCAL->syslog_message);
-                                        }
-
-                                    if ( SaganRouting->brointel_results == false && rulestruct[b].brointel_url )
-                                        {
-                                            SaganRouting->brointel_results = Sagan_BroIntel_URL(SaganProcSyslog_LOCAL->syslog_message);
-                                        }
-
-                                    if ( SaganRouting->brointel_results == false && rulestruct[b].brointel_software )
-                                        {
-                                            SaganRouting->brointel_results = Sagan_BroIntel_SOFTWARE(SaganProcSyslog_LOCAL->syslog_message);
-                                        }
-
-                                    if ( SaganRouting->brointel_results == false && rulestruct[b].brointel_user_name )
-                                        {
-                                            SaganRouting->brointel_results = Sagan_BroIntel_USER_NAME(SaganProcSyslog_LOCAL->syslog_message);
-                                        }
-
-                                    if ( SaganRouting->brointel_results == false && rulestruct[b].brointel_file_name )
-                                        {
-                                            SaganRouting->brointel_results = Sagan_BroIntel_FILE_NAME(SaganProcSyslog_LOCAL->syslog_message);
-                                        }
-
-                                    if ( SaganRouting->brointel_results == false && rulestruct[b].brointel_cert_hash )
-                                        {
-                                            SaganRouting->brointel_results = Sagan_BroIntel_CERT_HASH(SaganProcSyslog_LOCAL->syslog_message);
-                                        }
+/****************************************************************************
+ * Sagan_Engine - Run the rules over a single event
+ ****************************************************************************/
 
-                                }
+int Sagan_Engine ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, bool dynamic_rule_flag )
+{
+    return(Engine_Event( SaganProcSyslog_LOCAL, dynamic_rule_flag, NULL, 0, NULL ));
+}
 
-                            /****************************************************************************/
-                            /* Populate the Sagan Event array with the information needed.  This info    */
-                            /* will be passed to the threads.  No need to populate it _if_ we're in a   */
-                            /* threshold state.                                                         */
-                            /****************************************************************************/
+/****************************************************************************
+ * Sagan_Engine_Resume - Finish a rule that was parked by a flexbit/xbit
+ * pause.  Called from the "SaganDefer" thread.
+ ****************************************************************************/
 
-                            SaganRouting->position = b;
+void Sagan_Engine_Resume( struct _Engine_Defer *Defer )
+{
 
-                            if ( Sagan_Check_Routing( SaganRouting ) == true )
-                                {
+    const struct _Rule_Generation *gen = NULL;
 
-                                    /* After */
+    Rule_Epoch_Enter();
 
-                                    after_log_flag = false;
+    gen = Rule_Generation_Current();
 
-                                    if ( rulestruct[b].after2 == true )
-                                        {
-                                            after_log_flag = After2 (b, ip_src, ip_srcport_u32, ip_dst, ip_dstport_u32, normalize_username, SaganProcSyslog_LOCAL->syslog_message );
-                                        }
+    /* A SIGHUP swapped the rules in while it was parked */
 
-                                    /* Threshold */
+    if ( Defer->generation == gen->id )
+        {
+            (void)Engine_Event( &Defer->SaganProcSyslog, true, NULL, 0, Defer );
+        }
 
-                                    thresh_log_flag = false;
+    Rule_Epoch_Exit();
+}
 
-                                    if ( rulestruct[b].threshold2_type != 0 && after_log_flag == false )
-                                        {
-                                            thresh_log_flag = Threshold2 (b, ip_src, ip_srcport_u32, ip_dst, ip_dstport_u32, normalize_username, SaganProcSyslog_LOCAL->syslog_message );
-                                        }
+/****************************************************************************
+ * Sagan_Engine_Batch - "rule-evaluation: batch".  Runs the rules over up to
+ * ENGINE_BATCH_MAX events at a time.
+ *
+ * The header filters and content/pcre/etc checks have no side effects,  so
+ * they are run a rule at a time over every event in the batch.  This keeps
+ * the rule's hot table entries and compiled patterns in cache while they
+ * are used,  rather than walking the whole rule set once per event.  What
+ * is left (flow,  xbits,  flexbits,  thresholds,  alerts,  etc) changes
+ * shared state and is still done one event at a time,  in rule order,  by
+ * Engine_Event() for the candidate rules only.
+ *
+ * Once "append_program" has changed an event's message,  the later rules'
+ * checks for that event are left to Engine_Event() so they see the message
+ * at the same point they would have outside of a batch.  Likewise,  once a
+ * "normalize" rule is a candidate,  liblognorm may set the event_id when
+ * Engine_Event() gets to it,  so later "event_id" checks are left there too.
+ ****************************************************************************/
+
+void Sagan_Engine_Batch ( _Sagan_Proc_Syslog *SaganProcSyslog_BATCH, bool *dynamic_rule_flags, int count )
+{
 
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
 
-                                    if ( config->rule_tracking_flag == true )
-                                        {
-                                            Ruleset_Track[rulestruct[b].ruleset_id].trigger = true;
-                                        }
+    struct _Sagan_Thread_Context *ThreadContext = Thread_Context();
 
+    /* Before Engine_Batch_Get() takes the rule count,  see Engine_Event() */
 
-                                    __atomic_add_fetch(&counters->saganfound, 1, __ATOMIC_SEQ_CST);
+    uint32_t template_generation = Template_Cache_Epoch();
 
-                                    /* Check for thesholding & "after" */
+    struct _Sagan_Engine_Batch *Batch = Engine_Batch_Get( gen, ThreadContext );
+    struct _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL = NULL;
 
-                                    if ( thresh_log_flag == false && after_log_flag == false )
-                                        {
+    struct _Rule_Profile *rule_profile = NULL;
+    uint64_t profile_ticks = 0;
 
-                                            if ( debug->debugengine )
-                                                {
+    int b = 0;
+    int e = 0;
 
-                                                    Sagan_Log(DEBUG, "[%s, line %d] **[Trigger]*********************************", __FILE__, __LINE__);
-                                                    Sagan_Log(DEBUG, "[%s, line %d] Program: %s | Facility: %s | Priority: %s | Level: %s | Tag: %s", __FILE__, __LINE__, SaganProcSyslog_LOCAL->syslog_program, SaganProcSyslog_LOCAL->syslog_facility, SaganProcSyslog_LOCAL->syslog_priority, SaganProcSyslog_LOCAL->syslog_level, SaganProcSyslog_LOCAL->syslog_tag);
-                                                    Sagan_Log(DEBUG, "[%s, line %d] Threshold flag: %d | After flag: %d | Flexbit Flag: %d | Flexbit status: %d", __FILE__, __LINE__, thresh_log_flag, after_log_flag, rulestruct[b].flexbit_flag, SaganRouting->flexbit_return);
-                                                    Sagan_Log(DEBUG, "[%s, line %d] Triggering Message: %s", __FILE__, __LINE__, SaganProcSyslog_LOCAL->syslog_message);
+    if ( count > ENGINE_BATCH_MAX )
+        {
+            Sagan_Log(ERROR, "[%s, line %d] Batch of %d events is larger than ENGINE_BATCH_MAX (%d). Abort!", __FILE__, __LINE__, count, ENGINE_BATCH_MAX);
+        }
 
-                                                }
+    Batch->template_generation = template_generation;
 
-                                            /* Do we need to "set" an xbit? */
+    memset(Batch->candidate, 0, count * Batch->words * sizeof(uint64_t));
+    memset(Batch->pending, 0, count * Batch->words * sizeof(uint64_t));
+    memset(Batch->header, 0, count * Batch->headers);
 
-                                            if ( rulestruct[b].xbit_flag && ( rulestruct[b].xbit_set_count || rulestruct[b].xbit_unset_count ) )
-                                                {
-                                                    Xbit_Set(b, ip_src, ip_dst, SaganProcSyslog_LOCAL);
-                                                }
+    for ( e = 0; e < count; e++ )
+        {
 
-                                            /* Check to "set" a flexbit */
+            Engine_Prepare( &SaganProcSyslog_BATCH[e] );
 
-                                            if ( rulestruct[b].flexbit_flag && rulestruct[b].flexbit_set_count )
-                                                {
-                                                    Flexbit_Set(b, ip_src, ip_dst, ip_srcport_u32, ip_dstport_u32, SaganProcSyslog_LOCAL);
-                                                }
+            Batch->template_key[e] = 0;
+            Batch->template_hit[e] = false;
+            Batch->template_unsafe[e] = false;
 
-                                            threadid++;
+            if ( config->template_cache_flag == true && dynamic_rule_flags[e] == false )
+                {
+                    Batch->template_key[e] = Template_Cache_Key( &SaganProcSyslog_BATCH[e], template_generation );
+                    Batch->template_hit[e] = Template_Cache_Lookup( Batch->template_key[e] );
+                }
 
-                                            if ( threadid >= MAX_THREADS )
-                                                {
-                                                    threadid=0;
-                                                }
+            Batch->appended[e] = false;
+            Batch->normalized[e] = false;
+            Batch->order_sample[e] = config->rule_order_adaptive == true &&
+                                     ( ++ThreadContext->order_events & ( RULE_ORDER_SAMPLE_RATE - 1 ) ) == 0;
+        }
 
+    if ( config->rule_profile_flag == true )
+        {
+            rule_profile = Rule_Profile_Begin( &ThreadContext->profile );
+        }
 
-                                            processor_info_engine->processor_name          =       s_msg;
-                                            processor_info_engine->processor_generator_id  =       SAGAN_PROCESSOR_GENERATOR_ID;
-                                            processor_info_engine->processor_facility      =       SaganProcSyslog_LOCAL->syslog_facility;
-                                            processor_info_engine->processor_priority      =       SaganProcSyslog_LOCAL->syslog_level;
-                                            processor_info_engine->processor_pri           =       rulestruct[b].s_pri;
-                                            processor_info_engine->processor_class         =       rulestruct[b].s_classtype;
-                                            processor_info_engine->processor_tag           =       SaganProcSyslog_LOCAL->syslog_tag;
-                                            processor_info_engine->processor_rev           =       rulestruct[b].s_rev;
+    /* Rule at a time over the batch */
 
-                                            if ( rulestruct[b].flexbit_flag == false || rulestruct[b].flexbit_noalert == 0 )
-                                                {
+    for ( b = 0; b < (int)Batch->rules; b++ )
+        {
 
-                                                    if ( rulestruct[b].type == NORMAL_RULE )
-                                                        {
+            for ( e = 0; e < count; e++ )
+                {
 
-                                                            Send_Alert(SaganProcSyslog_LOCAL,
-                                                                       json_normalize,
-                                                                       processor_info_engine,
-                                                                       ip_src,
-                                                                       ip_dst,
-                                                                       normalize_http_uri,
-                                                                       normalize_http_hostname,
-                                                                       proto,
-                                                                       rulestruct[b].s_sid,
-                                                                       ip_srcport_u32,
-                                                                       ip_dstport_u32,
-                                                                       b, tp, bluedot_json, bluedot_results );
+                    SaganProcSyslog_LOCAL = &SaganProcSyslog_BATCH[e];
 
+                    if ( ( gen->ruletable->type[b] == DYNAMIC_RULE && dynamic_rule_flags[e] == false ) ||
+                            Batch->template_hit[e] == true )
+                        {
+                            continue;
+                        }
 
-                                                        }
-                                                    else
-                                                        {
+                    if ( rule_profile != NULL )
+                        {
+                            profile_ticks = Rule_Profile_Ticks();
+                            rule_profile[b].checks++;
+                        }
 
-                                                            Sagan_Dynamic_Rules(SaganProcSyslog_LOCAL, b, processor_info_engine,
-                                                                                ip_src, ip_dst);
+                    if ( Engine_Batch_Header( gen->ruletable->program_id[b], Batch, e, SaganProcSyslog_LOCAL ) == true &&
+                            Engine_Batch_Header( gen->ruletable->facility_id[b], Batch, e, SaganProcSyslog_LOCAL ) == true &&
+                            Engine_Batch_Header( gen->ruletable->level_id[b], Batch, e, SaganProcSyslog_LOCAL ) == true &&
+                            Engine_Batch_Header( gen->ruletable->tag_id[b], Batch, e, SaganProcSyslog_LOCAL ) == true &&
+                            Engine_Batch_Header( gen->ruletable->syspri_id[b], Batch, e, SaganProcSyslog_LOCAL ) == true )
+                        {
 
-                                                        }
+                            if ( rule_profile != NULL )
+                                {
+                                    rule_profile[b].header_pass++;
+                                }
 
-                                                }
+                            if ( gen->ruletable->flags[b] & RULE_FLAG_TEMPLATE_UNSAFE )
+                                {
+                                    Batch->template_unsafe[e] = true;
+                                }
 
+                            if ( gen->ruletable->flags[b] & RULE_FLAG_APPEND_PROGRAM )
+                                {
+                                    Batch->appended[e] = true;
+                                }
 
-                                        } /* Threshold / After */
+                            if ( Batch->appended[e] == true ||
+                                    ( Batch->normalized[e] == true && ( gen->ruletable->stages[b] & RULE_STAGE_EVENT_ID ) ) )
+                                {
+                                    Engine_Batch_Set( Batch->candidate, Batch, e, b );
+                                    Engine_Batch_Set( Batch->pending, Batch, e, b );
+                                }
 
-                                } /* End of routing */
+                            else if ( Engine_Checks( gen, b, SaganProcSyslog_LOCAL, Batch->order_sample[e], rule_profile ) == true )
+                                {
+                                    Engine_Batch_Set( Batch->candidate, Batch, e, b );
+                                }
 
-                        } /* End of pcre/content/etc match */
+                            /* This rule may normalize the event before the rules after it */
 
-                    pre_match = false;  		      /* Reset match! */
-                    SaganRouting->flexbit_return=false;	      /* Flexbit reset */
-                    SaganRouting->xbit_return=false;            /* xbit reset */
-                    SaganRouting->check_flow_return = true;      /* Rule flow direction reset */
+                            if ( ( gen->ruletable->flags[b] & RULE_FLAG_NORMALIZE ) &&
+                                    Engine_Batch_Test( Batch->candidate, Batch, e, b ) == true )
+                                {
+                                    Batch->normalized[e] = true;
+                                }
 
-                } /* If normal or dynamic rule */
+                        }
 
-        } /* End for for loop */
+                    if ( rule_profile != NULL )
+                        {
+                            rule_profile[b].ticks += Rule_Profile_Ticks() - profile_ticks;
+                        }
 
+                }
+        }
 
-#ifdef HAVE_LIBFASTJSON
+    /* Event at a time over the candidates */
 
-    if ( config->eve_flag && config->eve_logs )
+    for ( e = 0; e < count; e++ )
         {
-            Log_JSON(SaganProcSyslog_LOCAL, tp);
+            (void)Engine_Event( &SaganProcSyslog_BATCH[e], dynamic_rule_flags[e], Batch, e, NULL );
         }
 
-#endif
-
-    free(processor_info_engine);
-    free(lookup_cache);
-    free(SaganRouting);
-
-    return(0);
 }
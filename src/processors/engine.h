@@ -27,5 +27,33 @@
 #define SAGAN_PROCESSOR_TAG NULL
 #define SAGAN_PROCESSOR_GENERATOR_ID 1
 
+/* "rule-evaluation: batch" working memory (see Sagan_Engine_Batch()).  One
+   per thread,  hung off the thread context.  Bitmaps are "words" uint64_t's
+   per event,  one bit per rule. */
+
+typedef struct _Sagan_Engine_Batch _Sagan_Engine_Batch;
+struct _Sagan_Engine_Batch
+{
+
+    uint32_t rules;				/* Rules loaded when the batch started */
+    uint32_t words;
+    uint32_t headers;
+
+    uint64_t *candidate;			/* Rules Engine_Event() should look at */
+    uint64_t *pending;				/* Candidates with content/pcre/etc still to check */
+    unsigned char *header;			/* Header filter results.  0 = unchecked,  1 = no,  2 = yes */
+
+    bool appended[ENGINE_BATCH_MAX];		/* "append_program" changed the message */
+    bool normalized[ENGINE_BATCH_MAX];		/* A "normalize" rule is a candidate,  event_id may change */
+    bool order_sample[ENGINE_BATCH_MAX];	/* "rule-ordering: adaptive" sample */
+
+    uint32_t template_generation;		/* Template_Cache_Epoch() before "rules" was read */
+    uint64_t template_key[ENGINE_BATCH_MAX];	/* "template-cache" key,  0 if not used */
+    bool template_hit[ENGINE_BATCH_MAX];	/* No rule can match,  skip the event */
+    bool template_unsafe[ENGINE_BATCH_MAX];	/* A RULE_FLAG_TEMPLATE_UNSAFE rule passed its header filters */
+
+};
+
 int Sagan_Engine ( _Sagan_Proc_Syslog *, bool );
+void Sagan_Engine_Batch ( _Sagan_Proc_Syslog *, bool *, int );
 void Sagan_Engine_Init ( void );
@@ -55,6 +55,9 @@
 #include "sagan-config.h"
 #include "lockfile.h"
 #include "util-time.h"
+#include "rules.h"
+#include "rule-table.h"
+#include "rule-profile.h"
 #include "processors/stats-json.h"
 
 struct _SaganConfig *config;
@@ -88,11 +91,7 @@ void Stats_JSON_Handler( void )
 
     (void)SetThreadName("SaganStatsJSON");
 
-    time_t t;
-    struct tm *now;
-
     char  timebuf[64] = { 0 };
-    char  current_utime[64] = { 0 };
 
     uint64_t uptime_seconds;
 
@@ -178,10 +177,7 @@ void Stats_JSON_Handler( void )
 
             /* Get our "uptime" */
 
-            t = time(NULL);
-            now=localtime(&t);
-            strftime(current_utime, sizeof(current_utime), "%s",  now);
-            uptime_seconds = atol(current_utime) - atol(config->sagan_startutime);
+            uptime_seconds = Return_Epoch() - atol(config->sagan_startutime);
 
             gettimeofday(&tp, 0);
             CreateIsoTimeString(&tp, timebuf, sizeof(timebuf));
@@ -542,6 +538,30 @@ void Stats_JSON_Handler( void )
             strlcat(json_final, " } }", sizeof(json_head));
 
             fprintf( config->stats_json_file_stream, "%s\n", json_final);
+
+            /* "rule-profiling" is written as its own event.  It is too large
+               for the json_final buffer */
+
+            if ( config->rule_profile_flag == true )
+                {
+
+                    struct json_object *jobj_profile = json_object_new_object();
+                    struct json_object *jarray_rules = json_object_new_array();
+
+                    json_object_object_add(jobj_profile, "timestamp", json_object_new_string(timebuf));
+                    json_object_object_add(jobj_profile, "event_type", json_object_new_string("rule_profile"));
+                    json_object_object_add(jobj_profile, "event_source", json_object_new_string("sagan"));
+                    json_object_object_add(jobj_profile, "host", json_object_new_string(config->sagan_sensor_name));
+
+                    Rule_Profile_JSON( jarray_rules );
+                    json_object_object_add(jobj_profile, "rules", jarray_rules);
+
+                    fprintf( config->stats_json_file_stream, "%s\n", json_object_to_json_string(jobj_profile));
+
+                    json_object_put(jobj_profile);
+
+                }
+
             fflush( config->stats_json_file_stream );
 
             json_object_put(jobj);
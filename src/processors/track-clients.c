@@ -49,6 +49,7 @@
 #include "sagan-defs.h"
 #include "sagan-config.h"
 #include "send-alert.h"
+#include "rule-epoch.h"
 #include "util-time.h"
 
 #include "processors/track-clients.h"
@@ -72,17 +73,10 @@ struct _SaganConfig *config;
 void Track_Clients ( char *host )
 {
 
-    char utime_tmp[20] = { 0 };
-    time_t t;
-    struct tm *now;
     int i;
-    uint64_t utime_u64;
+    uint64_t utime_u64 = Return_Epoch();
     unsigned char hostbits[MAXIPBIT] = { 0 };
 
-    t = time(NULL);
-    now=localtime(&t);
-    strftime(utime_tmp, sizeof(utime_tmp), "%s",  now);
-    utime_u64 = atol(utime_tmp);
     int expired_time = config->pp_sagan_track_clients * 60;
 
     IP2Bit(host, hostbits);
@@ -189,18 +183,14 @@ void Track_Clients_Thread ( void )
 
             const char *tmp_ip = NULL;
 
-            char utime_tmp[20] = { 0 };
-            time_t t;
-            struct tm *now;
-
             uint64_t utime_u32;
 
             struct timeval tp;
 
-            t = time(NULL);
-            now=localtime(&t);
-            strftime(utime_tmp, sizeof(utime_tmp), "%s",  now);
-            utime_u32 = atol(utime_tmp);
+            struct _Sagan_IP ip_src;
+            struct _Sagan_IP ip_dst;
+
+            utime_u32 = Return_Epoch();
 
             int expired_time = config->pp_sagan_track_clients * 60;
 
@@ -274,11 +264,19 @@ void Track_Clients_Thread ( void )
 
                                     /* Send alert to output plugins */
 
+                                    IP_Set( &ip_src, SaganProcSyslog_LOCAL->syslog_host );
+                                    IP_Set( &ip_dst, config->sagan_host );
+
+                                    /* Output() and the gen-msg lookup read the rules.  Pin
+                                       them so a SIGHUP can't free them underneath us */
+
+                                    Rule_Epoch_Enter();
+
                                     Send_Alert(SaganProcSyslog_LOCAL,
                                                NULL,
                                                processor_info_track_client,
-                                               SaganProcSyslog_LOCAL->syslog_host,
-                                               config->sagan_host,
+                                               &ip_src,
+                                               &ip_dst,
                                                "\0",
                                                "\0",
                                                config->sagan_proto,
@@ -286,6 +284,8 @@ void Track_Clients_Thread ( void )
                                                config->sagan_port,
                                                config->sagan_port,
                                                0, tp, NULL, 0);
+
+                                    Rule_Epoch_Exit();
                                 } /* End last seen check time */
 
                         }
@@ -341,11 +341,18 @@ void Track_Clients_Thread ( void )
 
                                     /* Send alert to output plugins */
 
+                                    IP_Set( &ip_src, SaganProcSyslog_LOCAL->syslog_host );
+                                    IP_Set( &ip_dst, config->sagan_host );
+
+                                    /* Pinned for the same reason as above */
+
+                                    Rule_Epoch_Enter();
+
                                     Send_Alert(SaganProcSyslog_LOCAL,
                                                NULL,
                                                processor_info_track_client,
-                                               SaganProcSyslog_LOCAL->syslog_host,
-                                               config->sagan_host,
+                                               &ip_src,
+                                               &ip_dst,
                                                "\0",
                                                "\0",
                                                config->sagan_proto,
@@ -354,6 +361,8 @@ void Track_Clients_Thread ( void )
                                                config->sagan_port,
                                                0, tp, NULL, 0);
 
+                                    Rule_Epoch_Exit();
+
                                 }  /* End of existing utime check */
 
                         } /* End of else */
@@ -40,17 +40,17 @@
 #include "sagan-defs.h"
 #include "references.h"
 #include "rules.h"
+#include "rule-generation.h"
 
 struct _SaganCounters *counters;
 struct _SaganDebug *debug;
 struct _SaganConfig *config;
 
-struct _Ref_Struct *refstruct;
-struct _Rule_Struct *rulestruct;
-
 void Load_Reference( const char *ruleset )
 {
 
+    struct _Rule_Generation *gen = Rule_Generation_Current();
+
     FILE *reffile;
 
     char refbuf[1024];
@@ -60,7 +60,7 @@ void Load_Reference( const char *ruleset )
 
     int linecount=0;
 
-    counters->refcount = 0;
+    gen->refcount = 0;
 
     Sagan_Log(NORMAL, "Loading references.conf file. [%s]", ruleset);
 
@@ -85,14 +85,14 @@ void Load_Reference( const char *ruleset )
 
             /* Allocate memory for references,  not comments */
 
-            refstruct = (_Ref_Struct *) realloc(refstruct, (counters->refcount+1) * sizeof(_Ref_Struct));
+            gen->refstruct = (_Ref_Struct *) realloc(gen->refstruct, (gen->refcount+1) * sizeof(_Ref_Struct));
 
-            if ( refstruct == NULL )
+            if ( gen->refstruct == NULL )
                 {
                     Sagan_Log(ERROR, "[%s, line %d] Failed to reallocate memory for refstruct. Abort!", __FILE__, __LINE__);
                 }
 
-            memset(&refstruct[counters->refcount], 0, sizeof(struct _Ref_Struct));
+            memset(&gen->refstruct[gen->refcount], 0, sizeof(struct _Ref_Struct));
 
             strtok_r(refbuf, ":", &saveptr);
             tmptoken = strtok_r(NULL, " ", &saveptr);
@@ -104,7 +104,7 @@ void Load_Reference( const char *ruleset )
                     Sagan_Log(ERROR, "[%s, line %d] The file %s at line %d is improperly formated. Abort!", __FILE__, __LINE__, ruleset, linecount);
                 }
 
-            strlcpy(refstruct[counters->refcount].s_refid, laststring, sizeof(refstruct[counters->refcount].s_refid));
+            strlcpy(gen->refstruct[gen->refcount].s_refid, laststring, sizeof(gen->refstruct[gen->refcount].s_refid));
 
             laststring = strtok_r(NULL, ",", &saveptr);
 
@@ -113,19 +113,19 @@ void Load_Reference( const char *ruleset )
                     Sagan_Log(ERROR, "[%s, line %d] The file %s at line %d is improperly formated. Abort!", __FILE__, __LINE__, ruleset, linecount);
                 }
 
-            strlcpy(refstruct[counters->refcount].s_refurl, laststring, sizeof(refstruct[counters->refcount].s_refurl));
-            refstruct[counters->refcount].s_refurl[strlen(refstruct[counters->refcount].s_refurl)-1] = '\0';
+            strlcpy(gen->refstruct[gen->refcount].s_refurl, laststring, sizeof(gen->refstruct[gen->refcount].s_refurl));
+            gen->refstruct[gen->refcount].s_refurl[strlen(gen->refstruct[gen->refcount].s_refurl)-1] = '\0';
 
             if (debug->debugload)
                 {
-                    Sagan_Log(DEBUG, "[D-%d] Reference: %s|%s", counters->refcount, refstruct[counters->refcount].s_refid, refstruct[counters->refcount].s_refurl);
+                    Sagan_Log(DEBUG, "[D-%d] Reference: %s|%s", gen->refcount, gen->refstruct[gen->refcount].s_refid, gen->refstruct[gen->refcount].s_refurl);
                 }
 
-            counters->refcount++;
+            gen->refcount++;
 
         }
     fclose(reffile);
-    Sagan_Log(NORMAL, "%d references loaded.", counters->refcount);
+    Sagan_Log(NORMAL, "%d references loaded.", gen->refcount);
 }
 
 
@@ -141,6 +141,8 @@ void Load_Reference( const char *ruleset )
 void Reference_Lookup( int rulemem, int type, char *str, size_t size )
 {
 
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
+
     char reftmp[256] = { 0 };
 
     int i=0;
@@ -155,10 +157,10 @@ void Reference_Lookup( int rulemem, int type, char *str, size_t size )
     char refinfo[512];
     char refinfo2[512];
 
-    for (i=0; i <= rulestruct[rulemem].ref_count; i++ )
+    for (i=0; i <= gen->rulestruct[rulemem].ref_count; i++ )
         {
 
-            strlcpy(refinfo, rulestruct[rulemem].s_reference[i], sizeof(refinfo));
+            strlcpy(refinfo, gen->rulestruct[rulemem].s_reference[i], sizeof(refinfo));
 
             tmp = strtok_r(refinfo, ",", &tmptok);
 
@@ -185,19 +187,19 @@ void Reference_Lookup( int rulemem, int type, char *str, size_t size )
                 }
 
 
-            for ( b=0; b < counters->refcount; b++)
+            for ( b=0; b < gen->refcount; b++)
                 {
 
-                    if (!strcmp(refstruct[b].s_refid,  reftype))
+                    if (!strcmp(gen->refstruct[b].s_refid,  reftype))
                         {
                             if ( type == 0 )
                                 {
-                                    snprintf(refinfo2, sizeof(refinfo2)-1, "[Xref => %s%s]",  refstruct[b].s_refurl, url);
+                                    snprintf(refinfo2, sizeof(refinfo2)-1, "[Xref => %s%s]",  gen->refstruct[b].s_refurl, url);
                                 }
 
                             if ( type == 1 )
                                 {
-                                    snprintf(refinfo2, sizeof(refinfo2)-1, "Reference:%s%s\n", refstruct[b].s_refurl, url);
+                                    snprintf(refinfo2, sizeof(refinfo2)-1, "Reference:%s%s\n", gen->refstruct[b].s_refurl, url);
                                 }
 
                             strlcat(reftmp,  refinfo2,  sizeof(reftmp));
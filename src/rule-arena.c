@@ -0,0 +1,319 @@
+/*
+** Copyright (C) 2009-2020 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2020 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* rule-arena.c
+ *
+ * Storage for the variable length parts of a rule (content,  flows,  ports,
+ * meta_content,  etc).  These used to be fixed sized arrays inside of
+ * _Rule_Struct,  which made every rule roughly a megabyte whether it used
+ * those options or not.
+ *
+ * While a rule is being parsed,  Rule_Arena_Begin() points the rule at
+ * full sized scratch space.  Rule_Arena_Commit() then copies only what the
+ * rule actually uses into the arena.  The arena is a simple list of large
+ * blocks that is only ever released as a whole,  with the rule generation
+ * it belongs to (see rule-generation.c).
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pcre.h>
+
+#include "sagan.h"
+#include "sagan-defs.h"
+#include "rules.h"
+#include "rule-arena.h"
+#include "rule-generation.h"
+
+/* Full sized scratch space for the rule being parsed */
+
+typedef struct _Rule_Arena_Scratch _Rule_Arena_Scratch;
+struct _Rule_Arena_Scratch
+{
+
+    char content[MAX_CONTENT][256];
+    char s_reference[MAX_REFERENCE][256];
+    char event_id[MAX_EVENT_ID][32];
+
+    /* Flow/port "type" arrays are 1 based */
+
+    struct arr_flow_1 flow_1[MAX_CHECK_FLOWS+1];
+    struct arr_flow_2 flow_2[MAX_CHECK_FLOWS+1];
+    struct arr_port_1 port_1[MAX_CHECK_FLOWS+1];
+    struct arr_port_2 port_2[MAX_CHECK_FLOWS+1];
+
+    int flow_1_type[MAX_CHECK_FLOWS+1];
+    int flow_2_type[MAX_CHECK_FLOWS+1];
+    int port_1_type[MAX_CHECK_FLOWS+1];
+    int port_2_type[MAX_CHECK_FLOWS+1];
+
+    struct meta_content_conversion meta_content_containers[MAX_META_CONTENT];
+    char meta_content_converted[MAX_META_CONTENT][MAX_META_CONTENT_ITEMS][256];
+    char meta_content_help[MAX_META_CONTENT][CONFBUF];
+
+    char json_content_key[MAX_JSON_CONTENT][128];
+    char json_content_content[MAX_JSON_CONTENT][1024];
+
+    char json_pcre_key[MAX_JSON_PCRE][128];
+
+    struct json_meta_content_conversion json_meta_content_containers[MAX_JSON_META_CONTENT];
+    char json_meta_content_converted[MAX_JSON_META_CONTENT][MAX_JSON_META_CONTENT_ITEMS][256];
+    char json_meta_content_key[MAX_JSON_META_CONTENT][128];
+
+};
+
+/* Per thread,  as rule files may be parsed in parallel (see rule-load.c) */
+
+static __thread struct _Rule_Arena_Scratch *Scratch = NULL;
+static __thread bool Scratch_Dirty = false;
+
+/****************************************************************************
+ * Rule_Arena_Alloc - Returns "size" bytes of zeroed memory from the rule
+ * arena of the generation being loaded.  Memory is 16 byte aligned and
+ * lives as long as the generation.
+ ****************************************************************************/
+
+void *Rule_Arena_Alloc( size_t size )
+{
+
+    struct _Rule_Generation *gen = Rule_Generation_Current();
+
+    struct _Rule_Arena_Block *block = NULL;
+    size_t block_size = 0;
+    void *ptr = NULL;
+
+    size = ( size + 15 ) & ~( (size_t)15 );
+
+    if ( gen->arena == NULL || gen->arena->size - gen->arena->used < size )
+        {
+
+            block_size = size > RULE_ARENA_BLOCK_SIZE ? size : RULE_ARENA_BLOCK_SIZE;
+
+            block = calloc(1, RULE_ARENA_HEADER_SIZE + block_size);
+
+            if ( block == NULL )
+                {
+                    Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for the rule arena. Abort!", __FILE__, __LINE__);
+                }
+
+            block->size = block_size;
+            block->used = 0;
+            block->next = gen->arena;
+
+            gen->arena = block;
+            gen->arena_total += RULE_ARENA_HEADER_SIZE + block_size;
+
+        }
+
+    ptr = (char *)gen->arena + RULE_ARENA_HEADER_SIZE + gen->arena->used;
+    gen->arena->used += size;
+
+    return(ptr);
+
+}
+
+/****************************************************************************
+ * Rule_Arena_Free - Releases every block of a retired generation's arena
+ ****************************************************************************/
+
+void Rule_Arena_Free( struct _Rule_Arena_Block *block )
+{
+
+    struct _Rule_Arena_Block *next = NULL;
+
+    while ( block != NULL )
+        {
+            next = block->next;
+            free(block);
+            block = next;
+        }
+
+}
+
+/****************************************************************************
+ * Rule_Arena_Size - Bytes held by the rule arena
+ ****************************************************************************/
+
+size_t Rule_Arena_Size( void )
+{
+
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
+
+    return(gen->arena_total);
+}
+
+/****************************************************************************
+ * Rule_Arena_Scratch_Free - Release the calling thread's scratch space once
+ * it is done parsing rules.
+ ****************************************************************************/
+
+void Rule_Arena_Scratch_Free( void )
+{
+
+    free(Scratch);
+
+    Scratch = NULL;
+    Scratch_Dirty = false;
+
+}
+
+/****************************************************************************
+ * Rule_Arena_Begin - Point a new (zeroed) rule at the scratch space
+ ****************************************************************************/
+
+void Rule_Arena_Begin( struct _Rule_Struct *rule )
+{
+
+    int i = 0;
+
+    if ( Scratch == NULL )
+        {
+
+            Scratch = calloc(1, sizeof(struct _Rule_Arena_Scratch));
+
+            if ( Scratch == NULL )
+                {
+                    Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for rule scratch space. Abort!", __FILE__, __LINE__);
+                }
+        }
+
+    /* The previous rule was never committed.  Start clean. */
+
+    if ( Scratch_Dirty == true )
+        {
+            memset(Scratch, 0, sizeof(struct _Rule_Arena_Scratch));
+        }
+
+    Scratch_Dirty = true;
+
+    for ( i = 0; i < MAX_META_CONTENT; i++ )
+        {
+            Scratch->meta_content_containers[i].meta_content_converted = Scratch->meta_content_converted[i];
+        }
+
+    for ( i = 0; i < MAX_JSON_META_CONTENT; i++ )
+        {
+            Scratch->json_meta_content_containers[i].json_meta_content_converted = Scratch->json_meta_content_converted[i];
+        }
+
+    rule->content = Scratch->content;
+    rule->s_reference = Scratch->s_reference;
+    rule->event_id = Scratch->event_id;
+
+    rule->flow_1 = Scratch->flow_1;
+    rule->flow_2 = Scratch->flow_2;
+    rule->port_1 = Scratch->port_1;
+    rule->port_2 = Scratch->port_2;
+
+    rule->flow_1_type = Scratch->flow_1_type;
+    rule->flow_2_type = Scratch->flow_2_type;
+    rule->port_1_type = Scratch->port_1_type;
+    rule->port_2_type = Scratch->port_2_type;
+
+    rule->meta_content_containers = Scratch->meta_content_containers;
+    rule->meta_content_help = Scratch->meta_content_help;
+
+    rule->json_content_key = Scratch->json_content_key;
+    rule->json_content_content = Scratch->json_content_content;
+
+    rule->json_pcre_key = Scratch->json_pcre_key;
+
+    rule->json_meta_content_containers = Scratch->json_meta_content_containers;
+    rule->json_meta_content_key = Scratch->json_meta_content_key;
+
+}
+
+/****************************************************************************
+ * Rule_Arena_Copy - Copy "size" bytes of scratch into the arena and clear
+ * the scratch copy for the next rule.  Returns NULL when size is 0.
+ ****************************************************************************/
+
+static void *Rule_Arena_Copy( void *scratch, size_t size )
+{
+
+    void *ptr = NULL;
+
+    if ( size == 0 )
+        {
+            return(NULL);
+        }
+
+    ptr = Rule_Arena_Alloc( size );
+    memcpy(ptr, scratch, size);
+    memset(scratch, 0, size);
+
+    return(ptr);
+
+}
+
+/****************************************************************************
+ * Rule_Arena_Commit - Move what the rule uses from scratch to the arena.
+ ****************************************************************************/
+
+void Rule_Arena_Commit( struct _Rule_Struct *rule )
+{
+
+    int i = 0;
+
+    rule->content = Rule_Arena_Copy( Scratch->content, rule->content_count * sizeof(Scratch->content[0]) );
+    rule->s_reference = Rule_Arena_Copy( Scratch->s_reference, rule->ref_count * sizeof(Scratch->s_reference[0]) );
+    rule->event_id = Rule_Arena_Copy( Scratch->event_id, rule->event_id_count * sizeof(Scratch->event_id[0]) );
+
+    rule->flow_1 = Rule_Arena_Copy( Scratch->flow_1, rule->flow_1_counter * sizeof(Scratch->flow_1[0]) );
+    rule->flow_2 = Rule_Arena_Copy( Scratch->flow_2, rule->flow_2_counter * sizeof(Scratch->flow_2[0]) );
+    rule->port_1 = Rule_Arena_Copy( Scratch->port_1, rule->port_1_counter * sizeof(Scratch->port_1[0]) );
+    rule->port_2 = Rule_Arena_Copy( Scratch->port_2, rule->port_2_counter * sizeof(Scratch->port_2[0]) );
+
+    rule->flow_1_type = Rule_Arena_Copy( Scratch->flow_1_type, rule->flow_1_counter == 0 ? 0 : ( rule->flow_1_counter + 1 ) * sizeof(int) );
+    rule->flow_2_type = Rule_Arena_Copy( Scratch->flow_2_type, rule->flow_2_counter == 0 ? 0 : ( rule->flow_2_counter + 1 ) * sizeof(int) );
+    rule->port_1_type = Rule_Arena_Copy( Scratch->port_1_type, rule->port_1_counter == 0 ? 0 : ( rule->port_1_counter + 1 ) * sizeof(int) );
+    rule->port_2_type = Rule_Arena_Copy( Scratch->port_2_type, rule->port_2_counter == 0 ? 0 : ( rule->port_2_counter + 1 ) * sizeof(int) );
+
+    for ( i = 0; i < rule->meta_content_count; i++ )
+        {
+            Scratch->meta_content_containers[i].meta_content_converted = Rule_Arena_Copy( Scratch->meta_content_converted[i], Scratch->meta_content_containers[i].meta_counter * sizeof(Scratch->meta_content_converted[i][0]) );
+        }
+
+    rule->meta_content_containers = Rule_Arena_Copy( Scratch->meta_content_containers, rule->meta_content_count * sizeof(Scratch->meta_content_containers[0]) );
+    rule->meta_content_help = Rule_Arena_Copy( Scratch->meta_content_help, rule->meta_content_count * sizeof(Scratch->meta_content_help[0]) );
+
+    rule->json_content_key = Rule_Arena_Copy( Scratch->json_content_key, rule->json_content_count * sizeof(Scratch->json_content_key[0]) );
+    rule->json_content_content = Rule_Arena_Copy( Scratch->json_content_content, rule->json_content_count * sizeof(Scratch->json_content_content[0]) );
+
+    rule->json_pcre_key = Rule_Arena_Copy( Scratch->json_pcre_key, rule->json_pcre_count * sizeof(Scratch->json_pcre_key[0]) );
+
+    for ( i = 0; i < rule->json_meta_content_count; i++ )
+        {
+            Scratch->json_meta_content_containers[i].json_meta_content_converted = Rule_Arena_Copy( Scratch->json_meta_content_converted[i], Scratch->json_meta_content_containers[i].json_meta_counter * sizeof(Scratch->json_meta_content_converted[i][0]) );
+        }
+
+    rule->json_meta_content_containers = Rule_Arena_Copy( Scratch->json_meta_content_containers, rule->json_meta_content_count * sizeof(Scratch->json_meta_content_containers[0]) );
+    rule->json_meta_content_key = Rule_Arena_Copy( Scratch->json_meta_content_key, rule->json_meta_content_count * sizeof(Scratch->json_meta_content_key[0]) );
+
+    Scratch_Dirty = false;
+
+}
+
@@ -0,0 +1,41 @@
+/*
+** Copyright (C) 2009-2020 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2020 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* Requires rules.h to be included first */
+
+#define RULE_ARENA_BLOCK_SIZE	1048576		/* Arena grows 1MB at a time */
+#define RULE_ARENA_HEADER_SIZE	32		/* _Rule_Arena_Block,  rounded up to keep data aligned */
+
+typedef struct _Rule_Arena_Block _Rule_Arena_Block;
+struct _Rule_Arena_Block
+{
+    struct _Rule_Arena_Block *next;
+    size_t size;
+    size_t used;
+};
+
+void  *Rule_Arena_Alloc( size_t size );
+void   Rule_Arena_Free( struct _Rule_Arena_Block *block );
+size_t Rule_Arena_Size( void );
+
+void   Rule_Arena_Scratch_Free( void );
+void   Rule_Arena_Begin( struct _Rule_Struct *rule );
+void   Rule_Arena_Commit( struct _Rule_Struct *rule );
+
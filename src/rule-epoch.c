@@ -0,0 +1,403 @@
+/*
+** Copyright (C) 2009-2020 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2020 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* rule-epoch.c
+ *
+ * Rules can be added while the processing threads are running (dynamic
+ * rules).  The arrays holding them used to be realloc()'ed in place,  which
+ * could free memory another thread was still reading.  They now grow by
+ * allocating a new array,  copying the old one and publishing the new
+ * pointer.  The old array is "retired" and only free()'ed once every thread
+ * that could have seen it has finished the event it was working on.
+ *
+ * Threads reading the rules call Rule_Epoch_Enter() before and
+ * Rule_Epoch_Exit() after.  Entering records the current epoch and picks up
+ * the live rule generation (see rule-generation.c).  Every retire bumps the
+ * epoch,  so memory retired at epoch "n" is safe to free once no thread is
+ * inside with an epoch lower than "n".
+ *
+ * Rule_Epoch_Pause() waits for every thread to leave and keeps them out
+ * until Rule_Epoch_Resume().  This is for what SIGHUP still has to change
+ * in place.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "sagan.h"
+#include "sagan-defs.h"
+#include "rule-epoch.h"
+#include "rule-generation.h"
+
+struct _SaganCounters *counters;
+
+/* Retired memory waiting to be free()'ed */
+
+struct _Rule_Epoch_Retired
+{
+    void *ptr;
+    void (*release)( void * );
+    uint64_t epoch;
+    struct _Rule_Epoch_Retired *next;
+};
+
+static pthread_mutex_t Rule_Epoch_Mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct _Rule_Epoch_Thread *Rule_Epoch_List = NULL;
+static struct _Rule_Epoch_Retired *Rule_Epoch_Retired_List = NULL;
+
+static uint64_t Rule_Epoch = 1;
+
+static pthread_mutex_t Rule_Epoch_Pause_Mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t Rule_Epoch_Pause_Cond = PTHREAD_COND_INITIALIZER;
+static bool Rule_Epoch_Paused = false;
+
+static __thread struct _Rule_Epoch_Thread *Rule_Epoch_Self = NULL;
+
+/****************************************************************************
+ * Rule_Epoch_Enter - The calling thread is about to read the rules.  Calls
+ * can be nested.
+ ****************************************************************************/
+
+void Rule_Epoch_Enter( void )
+{
+
+    struct _Rule_Epoch_Thread *Self = Rule_Epoch_Self;
+    uint64_t epoch = 0;
+
+    if ( Self == NULL )
+        {
+
+            Self = malloc(sizeof(struct _Rule_Epoch_Thread));
+
+            if ( Self == NULL )
+                {
+                    Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for _Rule_Epoch_Thread. Abort!", __FILE__, __LINE__);
+                }
+
+            memset(Self, 0, sizeof(struct _Rule_Epoch_Thread));
+
+            pthread_mutex_lock(&Rule_Epoch_Mutex);
+            Self->next = Rule_Epoch_List;
+            Rule_Epoch_List = Self;
+            pthread_mutex_unlock(&Rule_Epoch_Mutex);
+
+            Rule_Epoch_Self = Self;
+        }
+
+    if ( Self->depth++ != 0 )
+        {
+            return;
+        }
+
+    /* Publish the epoch we saw,  then make sure it is still current.  If a
+       retire happened in between,  Rule_Epoch_Reclaim() may not have seen
+       us,  so try again with the new epoch.  The same goes for a pause. */
+
+    epoch = __atomic_load_n(&Rule_Epoch, __ATOMIC_SEQ_CST);
+
+    for ( ;; )
+        {
+
+            __atomic_store_n(&Self->epoch, epoch, __ATOMIC_SEQ_CST);
+
+            if ( __atomic_load_n(&Rule_Epoch_Paused, __ATOMIC_SEQ_CST) == true )
+                {
+
+                    __atomic_store_n(&Self->epoch, 0, __ATOMIC_SEQ_CST);
+
+                    pthread_mutex_lock(&Rule_Epoch_Pause_Mutex);
+
+                    while ( Rule_Epoch_Paused == true )
+                        {
+                            pthread_cond_wait(&Rule_Epoch_Pause_Cond, &Rule_Epoch_Pause_Mutex);
+                        }
+
+                    pthread_mutex_unlock(&Rule_Epoch_Pause_Mutex);
+
+                    epoch = __atomic_load_n(&Rule_Epoch, __ATOMIC_SEQ_CST);
+                    continue;
+                }
+
+            uint64_t now = __atomic_load_n(&Rule_Epoch, __ATOMIC_SEQ_CST);
+
+            if ( now == epoch )
+                {
+                    break;
+                }
+
+            epoch = now;
+        }
+
+    /* A thread building a generation keeps using it */
+
+    Self->pinned = false;
+
+    if ( Rule_Generation_Local == NULL )
+        {
+            Rule_Generation_Local = __atomic_load_n(&Rule_Generation_Live, __ATOMIC_SEQ_CST);
+            Self->pinned = true;
+        }
+
+}
+
+/****************************************************************************
+ * Rule_Epoch_Exit - The calling thread is done reading the rules
+ ****************************************************************************/
+
+void Rule_Epoch_Exit( void )
+{
+
+    struct _Rule_Epoch_Thread *Self = Rule_Epoch_Self;
+
+    if ( Self == NULL || Self->depth == 0 )
+        {
+            return;
+        }
+
+    if ( --Self->depth == 0 )
+        {
+
+            if ( Self->pinned == true )
+                {
+                    Rule_Generation_Local = NULL;
+                    Self->pinned = false;
+                }
+
+            __atomic_store_n(&Self->epoch, 0, __ATOMIC_RELEASE);
+        }
+
+}
+
+/****************************************************************************
+ * Rule_Epoch_Retire - free() "ptr" once no thread can still be using it.
+ * The caller must have already published whatever replaces it.
+ ****************************************************************************/
+
+void Rule_Epoch_Retire( void *ptr )
+{
+    Rule_Epoch_Retire_Func( ptr, free );
+}
+
+/****************************************************************************
+ * Rule_Epoch_Retire_Func - Rule_Epoch_Retire(),  but "release" is called
+ * rather than free()
+ ****************************************************************************/
+
+void Rule_Epoch_Retire_Func( void *ptr, void (*release)( void * ) )
+{
+
+    struct _Rule_Epoch_Retired *Retired = NULL;
+
+    if ( ptr == NULL )
+        {
+            return;
+        }
+
+    Retired = malloc(sizeof(struct _Rule_Epoch_Retired));
+
+    if ( Retired == NULL )
+        {
+            Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for _Rule_Epoch_Retired. Abort!", __FILE__, __LINE__);
+        }
+
+    Retired->ptr = ptr;
+    Retired->release = release;
+
+    pthread_mutex_lock(&Rule_Epoch_Mutex);
+
+    Retired->epoch = __atomic_add_fetch(&Rule_Epoch, 1, __ATOMIC_SEQ_CST);
+    Retired->next = Rule_Epoch_Retired_List;
+    Rule_Epoch_Retired_List = Retired;
+
+    pthread_mutex_unlock(&Rule_Epoch_Mutex);
+
+    __atomic_add_fetch(&counters->rule_epoch_retired, 1, __ATOMIC_SEQ_CST);
+
+}
+
+/****************************************************************************
+ * Rule_Epoch_Grow - The replacement for realloc() on shared rule arrays.
+ * "slot" is the address of the array pointer.  A copy,  zero filled up to
+ * "new_size",  is published there before the old array is retired.  The
+ * other way around,  a thread could enter at the new epoch and still load
+ * the old pointer.
+ ****************************************************************************/
+
+void Rule_Epoch_Grow( void *slot, size_t old_size, size_t new_size )
+{
+
+    void **Slot = slot;
+    void *ptr = __atomic_load_n(Slot, __ATOMIC_ACQUIRE);
+
+    unsigned char *tmp = malloc(new_size);
+
+    if ( tmp == NULL )
+        {
+            Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for the rules. Abort!", __FILE__, __LINE__);
+        }
+
+    if ( ptr != NULL && old_size != 0 )
+        {
+            memcpy(tmp, ptr, old_size < new_size ? old_size : new_size);
+        }
+
+    if ( new_size > old_size )
+        {
+            memset(tmp + old_size, 0, new_size - old_size);
+        }
+
+    __atomic_store_n(Slot, (void *)tmp, __ATOMIC_RELEASE);
+
+    Rule_Epoch_Retire( ptr );
+
+}
+
+/****************************************************************************
+ * Rule_Epoch_Reclaim - free() retired memory nothing can be reading.
+ * Returns the number of retired blocks still waiting.
+ ****************************************************************************/
+
+uint32_t Rule_Epoch_Reclaim( void )
+{
+
+    struct _Rule_Epoch_Thread *Thread = NULL;
+    struct _Rule_Epoch_Retired *Retired = NULL;
+    struct _Rule_Epoch_Retired **Prev = NULL;
+
+    uint64_t oldest = UINT64_MAX;
+    uint64_t epoch = 0;
+    uint32_t waiting = 0;
+
+    pthread_mutex_lock(&Rule_Epoch_Mutex);
+
+    for ( Thread = Rule_Epoch_List; Thread != NULL; Thread = Thread->next )
+        {
+
+            epoch = __atomic_load_n(&Thread->epoch, __ATOMIC_SEQ_CST);
+
+            if ( epoch != 0 && epoch < oldest )
+                {
+                    oldest = epoch;
+                }
+        }
+
+    Prev = &Rule_Epoch_Retired_List;
+
+    while ( ( Retired = *Prev ) != NULL )
+        {
+
+            if ( Retired->epoch <= oldest )
+                {
+                    *Prev = Retired->next;
+                    Retired->release(Retired->ptr);
+                    free(Retired);
+                    continue;
+                }
+
+            Prev = &Retired->next;
+            waiting++;
+        }
+
+    pthread_mutex_unlock(&Rule_Epoch_Mutex);
+
+    return(waiting);
+
+}
+
+/****************************************************************************
+ * Rule_Epoch_Synchronize - Wait until everything retired so far has been
+ * free()'ed.  Only takes as long as the slowest thread's current batch.
+ ****************************************************************************/
+
+void Rule_Epoch_Synchronize( void )
+{
+
+    struct timespec wait = { 0, 1000000 };
+
+    while ( Rule_Epoch_Reclaim() != 0 )
+        {
+            nanosleep(&wait, NULL);
+        }
+
+}
+
+/****************************************************************************
+ * Rule_Epoch_Pause - Wait until no other thread is reading the rules and
+ * hold them in Rule_Epoch_Enter() until Rule_Epoch_Resume()
+ ****************************************************************************/
+
+void Rule_Epoch_Pause( void )
+{
+
+    struct _Rule_Epoch_Thread *Thread = NULL;
+    struct timespec wait = { 0, 100000 };
+
+    bool busy = true;
+
+    __atomic_store_n(&Rule_Epoch_Paused, true, __ATOMIC_SEQ_CST);
+
+    while ( busy == true )
+        {
+
+            busy = false;
+
+            pthread_mutex_lock(&Rule_Epoch_Mutex);
+
+            for ( Thread = Rule_Epoch_List; Thread != NULL; Thread = Thread->next )
+                {
+                    if ( Thread != Rule_Epoch_Self && __atomic_load_n(&Thread->epoch, __ATOMIC_SEQ_CST) != 0 )
+                        {
+                            busy = true;
+                            break;
+                        }
+                }
+
+            pthread_mutex_unlock(&Rule_Epoch_Mutex);
+
+            if ( busy == true )
+                {
+                    nanosleep(&wait, NULL);
+                }
+        }
+
+}
+
+/****************************************************************************
+ * Rule_Epoch_Resume - Let threads back in after Rule_Epoch_Pause()
+ ****************************************************************************/
+
+void Rule_Epoch_Resume( void )
+{
+
+    pthread_mutex_lock(&Rule_Epoch_Pause_Mutex);
+    __atomic_store_n(&Rule_Epoch_Paused, false, __ATOMIC_SEQ_CST);
+    pthread_cond_broadcast(&Rule_Epoch_Pause_Cond);
+    pthread_mutex_unlock(&Rule_Epoch_Pause_Mutex);
+
+}
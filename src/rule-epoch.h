@@ -0,0 +1,50 @@
+/*
+** Copyright (C) 2009-2020 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2020 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+/* Threads that read the rules (rulestruct,  ruletable,  Ruleset_Track and
+   the flow groups) while they may be growing or being replaced.  See
+   rule-epoch.c */
+
+typedef struct _Rule_Epoch_Thread _Rule_Epoch_Thread;
+struct _Rule_Epoch_Thread
+{
+
+    uint64_t epoch;				/* 0 when the thread is not reading */
+    uint32_t depth;				/* Nested Rule_Epoch_Enter() calls */
+    bool pinned;				/* Rule_Epoch_Enter() set Rule_Generation_Local */
+
+    struct _Rule_Epoch_Thread *next;
+
+};
+
+void Rule_Epoch_Enter( void );
+void Rule_Epoch_Exit( void );
+void Rule_Epoch_Grow( void *slot, size_t old_size, size_t new_size );
+void Rule_Epoch_Retire( void *ptr );
+void Rule_Epoch_Retire_Func( void *ptr, void (*release)( void * ) );
+uint32_t Rule_Epoch_Reclaim( void );
+void Rule_Epoch_Synchronize( void );
+void Rule_Epoch_Pause( void );
+void Rule_Epoch_Resume( void );
+
@@ -0,0 +1,257 @@
+/*
+** Copyright (C) 2009-2020 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2020 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* rule-generation.c
+ *
+ * A "generation" is everything built from the rule files: the rules,  the
+ * hot rule table,  flow groups,  the rule arena (or rule image,  see
+ * rule-image.c),  ruleset tracking,  references and gen-msg.  The
+ * processing threads only ever see a complete generation.
+ *
+ * On SIGHUP,  the signal thread builds a new generation
+ * (Rule_Generation_Begin() points its own Rule_Generation_Local at it,  so
+ * Load_Rules() and friends write there) while the processing threads carry
+ * on with the live one.  Rule_Generation_Publish() then swaps
+ * Rule_Generation_Live.  A processing thread picks up the new generation
+ * the next time it calls Rule_Epoch_Enter().  The old generation is
+ * retired and free()'ed once the last thread using it calls
+ * Rule_Epoch_Exit().  See rule-epoch.c
+ *
+ * Dynamic rules (see dynamic-rules.c) are added to the live generation.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pcre.h>
+
+#include "sagan.h"
+#include "sagan-defs.h"
+#include "rules.h"
+#include "rule-arena.h"
+#include "rule-table.h"
+#include "flow.h"
+#include "rule-epoch.h"
+#include "rule-image.h"
+#include "rule-generation.h"
+
+__thread struct _Rule_Generation *Rule_Generation_Local = NULL;
+struct _Rule_Generation *Rule_Generation_Live = NULL;
+
+static uint32_t Rule_Generation_ID = 0;
+
+/****************************************************************************
+ * Rule_Generation_New - An empty generation
+ ****************************************************************************/
+
+static struct _Rule_Generation *Rule_Generation_New( void )
+{
+
+    struct _Rule_Generation *Gen = calloc(1, sizeof(struct _Rule_Generation));
+
+    if ( Gen == NULL )
+        {
+            Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for _Rule_Generation. Abort!", __FILE__, __LINE__);
+        }
+
+    Gen->id = ++Rule_Generation_ID;
+    Gen->flowgroup_count = 1;
+
+    return(Gen);
+
+}
+
+/****************************************************************************
+ * Rule_Generation_Free - Release a retired generation
+ ****************************************************************************/
+
+static void Rule_Generation_Free( void *ptr )
+{
+
+    struct _Rule_Generation *Gen = ptr;
+
+    Rule_Table_Free( Gen->ruletable );
+    Flow_Group_Free( Gen->flowgroup, Gen->flowgroup_count );
+    Rule_Arena_Free( Gen->arena );
+
+    if ( Gen->image != NULL )
+        {
+            Rule_Image_Release( Gen->image, Gen->image_size );
+        }
+
+    free(Gen->rulestruct);
+    free(Gen->Ruleset_Track);
+    free(Gen->refstruct);
+    free(Gen->generator);
+    free(Gen);
+
+}
+
+/****************************************************************************
+ * Rule_Generation_Init - The first live generation.  Called once at startup,
+ * before the configuration is loaded.
+ ****************************************************************************/
+
+void Rule_Generation_Init( void )
+{
+    Rule_Generation_Live = Rule_Generation_New();
+}
+
+/****************************************************************************
+ * Rule_Generation_Current - The generation the calling thread is using.  A
+ * processing thread gets the one it pinned with Rule_Epoch_Enter().
+ ****************************************************************************/
+
+struct _Rule_Generation *Rule_Generation_Current( void )
+{
+
+    if ( Rule_Generation_Local != NULL )
+        {
+            return(Rule_Generation_Local);
+        }
+
+    return(Rule_Generation_Live);
+}
+
+/****************************************************************************
+ * Rule_Generation_Begin - Start building a new generation.  Until
+ * Rule_Generation_Publish(),  rules loaded by the calling thread go into it.
+ ****************************************************************************/
+
+void Rule_Generation_Begin( void )
+{
+    Rule_Generation_Local = Rule_Generation_New();
+}
+
+/****************************************************************************
+ * Rule_Generation_Publish - Make the generation the calling thread built
+ * the live one,  and retire the old one.
+ ****************************************************************************/
+
+void Rule_Generation_Publish( void )
+{
+
+    struct _Rule_Generation *Old = Rule_Generation_Live;
+
+    if ( Rule_Generation_Local == NULL )
+        {
+            return;
+        }
+
+    __atomic_store_n(&Rule_Generation_Live, Rule_Generation_Local, __ATOMIC_SEQ_CST);
+    Rule_Generation_Local = NULL;
+
+    Rule_Epoch_Retire_Func( Old, Rule_Generation_Free );
+
+}
+
+
+/****************************************************************************
+ * Rule_Generation_Staging - A private generation for one rule file parsed
+ * by a rule loading thread.  See rule-load.c
+ ****************************************************************************/
+
+struct _Rule_Generation *Rule_Generation_Staging( void )
+{
+
+    struct _Rule_Generation *Gen = Rule_Generation_New();
+
+    Gen->staging = true;
+
+    return(Gen);
+
+}
+
+/****************************************************************************
+ * Rule_Generation_Merge - Append the rules of a staging generation to the
+ * one the calling thread is loading,  and release the staging generation.
+ * The rule arena blocks are moved over rather than copied,  so the rules'
+ * variable length parts stay where they are.
+ ****************************************************************************/
+
+void Rule_Generation_Merge( struct _Rule_Generation *Staging )
+{
+
+    struct _Rule_Generation *Gen = Rule_Generation_Current();
+    struct _Rule_Arena_Block *tail = NULL;
+
+    uint32_t max = Gen->rulestruct_max;
+    int track = Gen->ruleset_track_count;
+    int b = 0;
+
+    if ( Staging->ruleset_track_count > 0 )
+        {
+
+            Rule_Epoch_Grow(&Gen->Ruleset_Track, track * sizeof(_Sagan_Ruleset_Track), ( track + Staging->ruleset_track_count ) * sizeof(_Sagan_Ruleset_Track));
+
+            memcpy(&Gen->Ruleset_Track[track], Staging->Ruleset_Track, Staging->ruleset_track_count * sizeof(_Sagan_Ruleset_Track));
+
+            __atomic_add_fetch(&Gen->ruleset_track_count, Staging->ruleset_track_count, __ATOMIC_SEQ_CST);
+
+        }
+
+    if ( (uint32_t)( Gen->rulecount + Staging->rulecount ) > max )
+        {
+
+            while ( (uint32_t)( Gen->rulecount + Staging->rulecount ) > max )
+                {
+                    max = max == 0 ? 256 : max * 2;
+                }
+
+            Rule_Epoch_Grow(&Gen->rulestruct, Gen->rulestruct_max * sizeof(_Rule_Struct), max * sizeof(_Rule_Struct));
+
+            Gen->rulestruct_max = max;
+
+        }
+
+    if ( Staging->arena != NULL )
+        {
+
+            for ( tail = Staging->arena; tail->next != NULL; tail = tail->next );
+
+            tail->next = Gen->arena;
+            Gen->arena = Staging->arena;
+            Gen->arena_total += Staging->arena_total;
+
+        }
+
+    for ( b = 0; b < Staging->rulecount; b++ )
+        {
+
+            memcpy(&Gen->rulestruct[Gen->rulecount], &Staging->rulestruct[b], sizeof(_Rule_Struct));
+            Gen->rulestruct[Gen->rulecount].ruleset_id += track;
+
+            Rule_Table_Add( Gen->rulecount );
+
+            __atomic_add_fetch(&Gen->rulecount, 1, __ATOMIC_SEQ_CST);
+
+        }
+
+    free(Staging->rulestruct);
+    free(Staging->Ruleset_Track);
+    free(Staging);
+
+}
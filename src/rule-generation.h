@@ -0,0 +1,78 @@
+/*
+** Copyright (C) 2009-2020 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2020 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+/* Everything built from the rule files.  A SIGHUP builds a new generation
+   while the processing threads keep using the live one.  See
+   rule-generation.c */
+
+typedef struct _Rule_Generation _Rule_Generation;
+struct _Rule_Generation
+{
+
+    uint32_t id;
+    bool staging;					/* A single rule file being parsed.  See rule-load.c */
+
+    struct _Rule_Struct *rulestruct;			/* rules.c */
+    uint32_t rulestruct_max;
+    int rulecount;
+
+    struct _Sagan_Ruleset_Track *Ruleset_Track;		/* rules.c */
+    int ruleset_track_count;
+
+    struct _Rule_Table *ruletable;			/* rule-table.c */
+
+    struct _Flow_Group *flowgroup;			/* flow.c.  ID 0 is "any" */
+    uint32_t flowgroup_count;
+    uint32_t flowgroup_max;
+
+    struct _Rule_Arena_Block *arena;			/* rule-arena.c */
+    size_t arena_total;
+
+    void *image;					/* rule-image.c.  mmap()'ed,  or NULL */
+    size_t image_size;
+
+    struct _Ref_Struct *refstruct;			/* references.c */
+    int refcount;
+
+    struct _Sagan_Processor_Generator *generator;	/* gen-msg.c */
+    int genmapcount;
+
+};
+
+/* The generation the calling thread is using.  Processing threads get the
+   live generation when they call Rule_Epoch_Enter() and keep it until
+   Rule_Epoch_Exit().  A thread building a new generation uses that one.
+   Rule_Generation_Current() returns it;  take it once per event or function
+   and use the pointer from there. */
+
+extern __thread struct _Rule_Generation *Rule_Generation_Local;
+extern struct _Rule_Generation *Rule_Generation_Live;
+
+void Rule_Generation_Init( void );
+struct _Rule_Generation *Rule_Generation_Current( void );
+void Rule_Generation_Begin( void );
+void Rule_Generation_Publish( void );
+struct _Rule_Generation *Rule_Generation_Staging( void );
+void Rule_Generation_Merge( struct _Rule_Generation *Staging );
+
@@ -0,0 +1,870 @@
+/*
+** Copyright (C) 2009-2020 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2020 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* rule-image.c
+ *
+ * Precompiled rule images.  "sagan --compile-rules <file>" parses the rule
+ * files as usual and writes the result to a versioned binary image.  With
+ * "rule-image" set in the configuration,  Sagan mmap()'s that image at
+ * startup and on SIGHUP instead of parsing the rule files,  provided it is
+ * intact and was built from the same rule files,  vars and classifications
+ * (see Rule_Image_Fingerprint()).  Otherwise the rule files are loaded as
+ * normal.
+ *
+ * The image holds the rules (_Rule_Struct),  ruleset tracking and the rule
+ * arena contents,  which is where the variable length parts of each rule
+ * live (content,  meta_content lists,  flows,  event_id hashes,  etc.  See
+ * rule-arena.c).  Pointers are stored as offsets into the arena section.
+ * Compiled PCRE patterns are saved as described in pcreprecompile(3).
+ * Study/JIT data can't be saved,  so patterns are studied again on load.
+ *
+ * The rules themselves are copied out of the image,  since their pointers
+ * need to be fixed up and dynamic rules may be added to them later.  The
+ * arena section and compiled patterns are used where they are,  read only.
+ * Several Sagan instances using the same image share those pages.
+ *
+ * Images are replaced with rename(),  so an instance that has the old image
+ * mapped keeps using it until its next reload.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <pcre.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "version.h"
+
+#include "sagan.h"
+#include "sagan-defs.h"
+#include "sagan-config.h"
+#include "classifications.h"
+#include "rules.h"
+#include "rule-arena.h"
+#include "rule-table.h"
+#include "rule-generation.h"
+#include "rule-image.h"
+
+#define RULE_IMAGE_FNV_OFFSET	14695981039346656037ULL
+#define RULE_IMAGE_FNV_PRIME	1099511628211ULL
+
+struct _SaganConfig *config;
+struct _SaganCounters *counters;
+struct _SaganVar *var;
+struct _Class_Struct *classstruct;
+struct _Rules_Loaded *rules_loaded;
+
+pthread_mutex_t SaganRulesLoadedMutex;
+
+/* Where each arena block went in the data section,  while writing */
+
+typedef struct _Rule_Image_Build _Rule_Image_Build;
+struct _Rule_Image_Build
+{
+
+    struct _Rule_Arena_Block **block;
+    uint64_t *offset;
+    uint32_t count;
+
+    unsigned char *data;
+    uint64_t data_size;
+    uint64_t data_max;
+
+};
+
+/****************************************************************************
+ * Rule_Image_Hash - FNV-1a style hash,  8 bytes at a time as the checksum
+ * covers the whole image on every start.  Sizes passed in while writing
+ * are multiples of 8,  so hashing in pieces gives the same result as
+ * hashing the image at once.
+ ****************************************************************************/
+
+static uint64_t Rule_Image_Hash( uint64_t hash, const void *data, size_t size )
+{
+
+    const unsigned char *p = data;
+    uint64_t word = 0;
+
+    while ( size >= sizeof(uint64_t) )
+        {
+            memcpy(&word, p, sizeof(uint64_t));
+            hash = ( hash ^ word ) * RULE_IMAGE_FNV_PRIME;
+            hash ^= hash >> 32;
+            p += sizeof(uint64_t);
+            size -= sizeof(uint64_t);
+        }
+
+    while ( size > 0 )
+        {
+            hash = ( hash ^ *p ) * RULE_IMAGE_FNV_PRIME;
+            p++;
+            size--;
+        }
+
+    return(hash);
+
+}
+
+/****************************************************************************
+ * Rule_Image_Fingerprint - Everything the parsed rules depend on.  An image
+ * with a different fingerprint is stale and is not used.
+ ****************************************************************************/
+
+static uint64_t Rule_Image_Fingerprint( void )
+{
+
+    struct stat filecheck;
+
+    uint64_t hash = RULE_IMAGE_FNV_OFFSET;
+    uint32_t rule_size = sizeof(struct _Rule_Struct);
+    int i = 0;
+
+    hash = Rule_Image_Hash( hash, VERSION, strlen(VERSION) );
+    hash = Rule_Image_Hash( hash, pcre_version(), strlen(pcre_version()) );
+    hash = Rule_Image_Hash( hash, &rule_size, sizeof(rule_size) );
+
+    /* The rule files.  Any change (or "touch") makes the image stale */
+
+    pthread_mutex_lock(&SaganRulesLoadedMutex);
+
+    for ( i = 0; i < counters->rules_loaded_count; i++ )
+        {
+
+            hash = Rule_Image_Hash( hash, rules_loaded[i].ruleset, strlen(rules_loaded[i].ruleset) + 1 );
+
+            if ( stat(rules_loaded[i].ruleset, &filecheck) == 0 )
+                {
+                    hash = Rule_Image_Hash( hash, &filecheck.st_size, sizeof(filecheck.st_size) );
+                    hash = Rule_Image_Hash( hash, &filecheck.st_mtime, sizeof(filecheck.st_mtime) );
+                }
+        }
+
+    pthread_mutex_unlock(&SaganRulesLoadedMutex);
+
+    /* Rules are parsed with vars substituted and classifications looked up */
+
+    for ( i = 0; i < counters->var_count; i++ )
+        {
+            hash = Rule_Image_Hash( hash, var[i].var_name, strlen(var[i].var_name) + 1 );
+            hash = Rule_Image_Hash( hash, var[i].var_value, strlen(var[i].var_value) + 1 );
+        }
+
+    for ( i = 0; i < counters->classcount; i++ )
+        {
+            hash = Rule_Image_Hash( hash, classstruct[i].s_shortname, strlen(classstruct[i].s_shortname) + 1 );
+            hash = Rule_Image_Hash( hash, &classstruct[i].s_priority, sizeof(classstruct[i].s_priority) );
+        }
+
+#ifdef WITH_BLUEDOT
+
+    if ( config->bluedot_flag == true && stat(config->bluedot_cat, &filecheck) == 0 )
+        {
+            hash = Rule_Image_Hash( hash, &filecheck.st_size, sizeof(filecheck.st_size) );
+            hash = Rule_Image_Hash( hash, &filecheck.st_mtime, sizeof(filecheck.st_mtime) );
+        }
+
+#endif
+
+    return(hash);
+
+}
+
+/****************************************************************************
+ * Rule_Image_Align - Round up to a multiple of "align" (a power of 2)
+ ****************************************************************************/
+
+static uint64_t Rule_Image_Align( uint64_t size, uint64_t align )
+{
+    return( ( size + align - 1 ) & ~( align - 1 ) );
+}
+
+/****************************************************************************
+ * Rule_Image_Encode - Arena pointer to "offset + 1" in the data section.
+ * NULL stays NULL.
+ ****************************************************************************/
+
+static void *Rule_Image_Encode( struct _Rule_Image_Build *Build, const void *ptr )
+{
+
+    const unsigned char *start = NULL;
+    uint32_t i = 0;
+
+    if ( ptr == NULL )
+        {
+            return(NULL);
+        }
+
+    for ( i = 0; i < Build->count; i++ )
+        {
+
+            start = (const unsigned char *)Build->block[i] + RULE_ARENA_HEADER_SIZE;
+
+            if ( (const unsigned char *)ptr >= start && (const unsigned char *)ptr < start + Build->block[i]->used )
+                {
+                    return( (void *)(uintptr_t)( Build->offset[i] + ( (const unsigned char *)ptr - start ) + 1 ) );
+                }
+        }
+
+    Sagan_Log(ERROR, "[%s, line %d] Rule data is outside of the rule arena. Abort!", __FILE__, __LINE__);
+
+    return(NULL);		/* Not reached */
+
+}
+
+/****************************************************************************
+ * Rule_Image_Pointer - Undo Rule_Image_Encode() against the mapped image
+ ****************************************************************************/
+
+static void *Rule_Image_Pointer( unsigned char *data, const void *ptr )
+{
+
+    if ( ptr == NULL )
+        {
+            return(NULL);
+        }
+
+    return( data + (uintptr_t)ptr - 1 );
+
+}
+
+/****************************************************************************
+ * Rule_Image_Data_Add - Append to the data section,  16 byte aligned.
+ * Returns the offset.
+ ****************************************************************************/
+
+static uint64_t Rule_Image_Data_Add( struct _Rule_Image_Build *Build, const void *ptr, size_t size )
+{
+
+    uint64_t offset = Rule_Image_Align( Build->data_size, 16 );
+    unsigned char *tmp = NULL;
+
+    if ( offset + size > Build->data_max )
+        {
+
+            while ( offset + size > Build->data_max )
+                {
+                    Build->data_max = Build->data_max == 0 ? RULE_ARENA_BLOCK_SIZE : Build->data_max * 2;
+                }
+
+            tmp = realloc(Build->data, Build->data_max);
+
+            if ( tmp == NULL )
+                {
+                    Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for the rule image. Abort!", __FILE__, __LINE__);
+                }
+
+            Build->data = tmp;
+
+        }
+
+    memset(Build->data + Build->data_size, 0, offset - Build->data_size);
+    memcpy(Build->data + offset, ptr, size);
+
+    Build->data_size = offset + size;
+
+    return(offset);
+
+}
+
+/****************************************************************************
+ * Rule_Image_Pcre - Append a compiled pattern,  see pcreprecompile(3)
+ ****************************************************************************/
+
+static void *Rule_Image_Pcre( struct _Rule_Image_Build *Build, pcre *re )
+{
+
+    size_t size = 0;
+
+    if ( re == NULL )
+        {
+            return(NULL);
+        }
+
+    if ( pcre_fullinfo(re, NULL, PCRE_INFO_SIZE, &size) != 0 )
+        {
+            Sagan_Log(ERROR, "[%s, line %d] Cannot get the size of a compiled PCRE. Abort!", __FILE__, __LINE__);
+        }
+
+    return( (void *)(uintptr_t)( Rule_Image_Data_Add( Build, re, size ) + 1 ) );
+
+}
+
+/****************************************************************************
+ * Rule_Image_Put - fwrite() and add to the checksum
+ ****************************************************************************/
+
+static void Rule_Image_Put( FILE *image, uint64_t *checksum, const void *ptr, size_t size, const char *filename )
+{
+
+    if ( size == 0 )
+        {
+            return;
+        }
+
+    if ( fwrite(ptr, size, 1, image) != 1 )
+        {
+            Sagan_Log(ERROR, "[%s, line %d] Cannot write rule image %s (%s). Abort!", __FILE__, __LINE__, filename, strerror(errno));
+        }
+
+    *checksum = Rule_Image_Hash( *checksum, ptr, size );
+
+}
+
+/****************************************************************************
+ * Rule_Image_Write - Write the rules loaded into the current generation
+ * to "filename".  Used by --compile-rules.
+ ****************************************************************************/
+
+void Rule_Image_Write( const char *filename )
+{
+
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
+
+    struct _Rule_Image_Header Header;
+    struct _Rule_Image_Build Build;
+    struct _Rule_Struct Rule;
+    struct _Rule_Arena_Block *block = NULL;
+    struct meta_content_conversion *meta_containers = NULL;
+    struct json_meta_content_conversion *json_meta_containers = NULL;
+
+    struct _Rule_Struct *original = NULL;
+
+    FILE *image = NULL;
+    char tmp_filename[MAXPATH] = { 0 };
+
+    unsigned char *track = NULL;
+    unsigned char padding[RULE_IMAGE_ALIGN] = { 0 };
+
+    uint64_t checksum = RULE_IMAGE_FNV_OFFSET;
+    uint64_t header_size = Rule_Image_Align( sizeof(struct _Rule_Image_Header), RULE_IMAGE_ALIGN );
+    uint64_t track_size = Rule_Image_Align( gen->ruleset_track_count * sizeof(struct _Sagan_Ruleset_Track), RULE_IMAGE_ALIGN );
+    uint64_t rules_size = Rule_Image_Align( gen->rulecount * sizeof(struct _Rule_Struct), RULE_IMAGE_ALIGN );
+    uint64_t data_size = 0;
+
+    uint32_t i = 0;
+    int b = 0;
+    int a = 0;
+
+    memset(&Header, 0, sizeof(Header));
+    memset(&Build, 0, sizeof(Build));
+
+    /* Arena blocks go first in the data section,  in list order */
+
+    for ( block = gen->arena; block != NULL; block = block->next )
+        {
+            Build.count++;
+        }
+
+    Build.block = calloc(Build.count + 1, sizeof(struct _Rule_Arena_Block *));
+    Build.offset = calloc(Build.count + 1, sizeof(uint64_t));
+
+    if ( Build.block == NULL || Build.offset == NULL )
+        {
+            Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for the rule image. Abort!", __FILE__, __LINE__);
+        }
+
+    for ( i = 0, block = gen->arena; block != NULL; i++, block = block->next )
+        {
+            Build.block[i] = block;
+            Build.offset[i] = Rule_Image_Data_Add( &Build, (unsigned char *)block + RULE_ARENA_HEADER_SIZE, block->used );
+        }
+
+    /* Pointers held within the arena (meta_content lists) */
+
+    for ( b = 0; b < gen->rulecount; b++ )
+        {
+
+            original = &gen->rulestruct[b];
+
+            if ( original->meta_content_count > 0 )
+                {
+
+                    meta_containers = (struct meta_content_conversion *)( Build.data + (uintptr_t)Rule_Image_Encode( &Build, original->meta_content_containers ) - 1 );
+
+                    for ( a = 0; a < original->meta_content_count; a++ )
+                        {
+                            meta_containers[a].meta_content_converted = Rule_Image_Encode( &Build, original->meta_content_containers[a].meta_content_converted );
+                        }
+                }
+
+            if ( original->json_meta_content_count > 0 )
+                {
+
+                    json_meta_containers = (struct json_meta_content_conversion *)( Build.data + (uintptr_t)Rule_Image_Encode( &Build, original->json_meta_content_containers ) - 1 );
+
+                    for ( a = 0; a < original->json_meta_content_count; a++ )
+                        {
+                            json_meta_containers[a].json_meta_content_converted = Rule_Image_Encode( &Build, original->json_meta_content_containers[a].json_meta_content_converted );
+                        }
+                }
+        }
+
+    strlcpy(Header.magic, RULE_IMAGE_MAGIC, sizeof(Header.magic));
+    Header.version = RULE_IMAGE_VERSION;
+    Header.rule_size = sizeof(struct _Rule_Struct);
+    Header.fingerprint = Rule_Image_Fingerprint();
+
+    Header.rulecount = gen->rulecount;
+    Header.ruleset_track_count = gen->ruleset_track_count;
+
+    Header.flexbit_total = counters->flexbit_total_counter;
+    Header.xbit_total = counters->xbit_total_counter;
+    Header.dynamic_rule_count = counters->dynamic_rule_count;
+
+#ifdef HAVE_LIBESMTP
+    Header.esmtp = config->sagan_esmtp_flag;
+#endif
+
+    Header.track_offset = header_size;
+    Header.rules_offset = Header.track_offset + track_size;
+    Header.data_offset = Header.rules_offset + rules_size;
+
+    /* Written next to the final name and rename()'ed into place */
+
+    snprintf(tmp_filename, sizeof(tmp_filename), "%s.tmp", filename);
+
+    if (( image = fopen(tmp_filename, "w" )) == NULL )
+        {
+            Sagan_Log(ERROR, "[%s, line %d] Cannot open rule image %s (%s). Abort!", __FILE__, __LINE__, tmp_filename, strerror(errno));
+        }
+
+    /* The header is written again once the checksum is known */
+
+    Rule_Image_Put( image, &checksum, &Header, sizeof(Header), tmp_filename );
+    Rule_Image_Put( image, &checksum, padding, header_size - sizeof(Header), tmp_filename );
+
+    checksum = RULE_IMAGE_FNV_OFFSET;
+
+    /* Ruleset tracking */
+
+    track = calloc(1, track_size + 1);
+
+    if ( track == NULL )
+        {
+            Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for the rule image. Abort!", __FILE__, __LINE__);
+        }
+
+    memcpy(track, gen->Ruleset_Track, gen->ruleset_track_count * sizeof(struct _Sagan_Ruleset_Track));
+
+    for ( b = 0; b < gen->ruleset_track_count; b++ )
+        {
+            ((struct _Sagan_Ruleset_Track *)track)[b].trigger = false;
+        }
+
+    Rule_Image_Put( image, &checksum, track, track_size, tmp_filename );
+
+    free(track);
+
+    /* Rules,  with pointers encoded.  Compiled patterns are appended to the
+       data section as we go. */
+
+    for ( b = 0; b < gen->rulecount; b++ )
+        {
+
+            original = &gen->rulestruct[b];
+            memcpy(&Rule, original, sizeof(struct _Rule_Struct));
+
+            Rule.content = Rule_Image_Encode( &Build, original->content );
+            Rule.s_reference = Rule_Image_Encode( &Build, original->s_reference );
+            Rule.event_id = Rule_Image_Encode( &Build, original->event_id );
+            Rule.event_id_hash = Rule_Image_Encode( &Build, original->event_id_hash );
+            Rule.event_id_index = Rule_Image_Encode( &Build, original->event_id_index );
+
+            Rule.flow_1 = Rule_Image_Encode( &Build, original->flow_1 );
+            Rule.flow_2 = Rule_Image_Encode( &Build, original->flow_2 );
+            Rule.port_1 = Rule_Image_Encode( &Build, original->port_1 );
+            Rule.port_2 = Rule_Image_Encode( &Build, original->port_2 );
+
+            Rule.flow_1_type = Rule_Image_Encode( &Build, original->flow_1_type );
+            Rule.flow_2_type = Rule_Image_Encode( &Build, original->flow_2_type );
+            Rule.port_1_type = Rule_Image_Encode( &Build, original->port_1_type );
+            Rule.port_2_type = Rule_Image_Encode( &Build, original->port_2_type );
+
+            Rule.meta_content_containers = Rule_Image_Encode( &Build, original->meta_content_containers );
+            Rule.meta_content_help = Rule_Image_Encode( &Build, original->meta_content_help );
+
+            Rule.json_content_key = Rule_Image_Encode( &Build, original->json_content_key );
+            Rule.json_content_key_hash = Rule_Image_Encode( &Build, original->json_content_key_hash );
+            Rule.json_content_content = Rule_Image_Encode( &Build, original->json_content_content );
+
+            Rule.json_pcre_key = Rule_Image_Encode( &Build, original->json_pcre_key );
+            Rule.json_pcre_key_hash = Rule_Image_Encode( &Build, original->json_pcre_key_hash );
+
+            Rule.json_meta_content_containers = Rule_Image_Encode( &Build, original->json_meta_content_containers );
+            Rule.json_meta_content_key = Rule_Image_Encode( &Build, original->json_meta_content_key );
+            Rule.json_meta_content_key_hash = Rule_Image_Encode( &Build, original->json_meta_content_key_hash );
+
+            Rule.aetas_week = Rule_Image_Encode( &Build, original->aetas_week );
+
+            for ( a = 0; a < MAX_PCRE; a++ )
+                {
+                    Rule.re_pcre[a] = a < original->pcre_count ? Rule_Image_Pcre( &Build, original->re_pcre[a] ) : NULL;
+                    Rule.pcre_extra[a] = NULL;
+                }
+
+            for ( a = 0; a < MAX_JSON_PCRE; a++ )
+                {
+                    Rule.json_re_pcre[a] = a < original->json_pcre_count ? Rule_Image_Pcre( &Build, original->json_re_pcre[a] ) : NULL;
+                    Rule.json_pcre_extra[a] = NULL;
+                }
+
+            Rule_Image_Put( image, &checksum, &Rule, sizeof(struct _Rule_Struct), tmp_filename );
+
+        }
+
+    Rule_Image_Put( image, &checksum, padding, rules_size - gen->rulecount * sizeof(struct _Rule_Struct), tmp_filename );
+
+    /* Arena and compiled patterns,  zero padded as one piece so the
+       checksum stays 8 byte aligned */
+
+    data_size = Rule_Image_Align( Build.data_size, RULE_IMAGE_ALIGN );
+
+    if ( data_size > Build.data_size )
+        {
+            (void)Rule_Image_Data_Add( &Build, padding, data_size - Rule_Image_Align( Build.data_size, 16 ) );
+        }
+
+    Rule_Image_Put( image, &checksum, Build.data, data_size, tmp_filename );
+
+    Header.data_size = data_size;
+    Header.size = Header.data_offset + data_size;
+    Header.checksum = checksum;
+
+    if ( fseek(image, 0, SEEK_SET) != 0 || fwrite(&Header, sizeof(Header), 1, image) != 1 || fclose(image) != 0 )
+        {
+            Sagan_Log(ERROR, "[%s, line %d] Cannot write rule image %s (%s). Abort!", __FILE__, __LINE__, tmp_filename, strerror(errno));
+        }
+
+    if ( rename(tmp_filename, filename) != 0 )
+        {
+            Sagan_Log(ERROR, "[%s, line %d] Cannot rename %s to %s (%s). Abort!", __FILE__, __LINE__, tmp_filename, filename, strerror(errno));
+        }
+
+    Sagan_Log(NORMAL, "Wrote %d rules to rule image %s (%" PRIu64 " bytes).", gen->rulecount, filename, Header.size);
+
+    free(Build.block);
+    free(Build.offset);
+    free(Build.data);
+
+}
+
+/****************************************************************************
+ * Rule_Image_Relocate - Fix up the pointers of a rule copied out of the
+ * image.  Returns false if a compiled pattern can't be used.
+ ****************************************************************************/
+
+static bool Rule_Image_Relocate( struct _Rule_Struct *rule, unsigned char *data )
+{
+
+    struct meta_content_conversion *meta_containers = NULL;
+    struct json_meta_content_conversion *json_meta_containers = NULL;
+
+    const char *error = NULL;
+    unsigned long options = 0;
+    int study_options = 0;
+    int a = 0;
+
+#ifdef PCRE_HAVE_JIT
+
+    if ( config->pcre_jit == true )
+        {
+            study_options |= PCRE_STUDY_JIT_COMPILE;
+        }
+
+#endif
+
+    rule->content = Rule_Image_Pointer( data, rule->content );
+    rule->s_reference = Rule_Image_Pointer( data, rule->s_reference );
+    rule->event_id = Rule_Image_Pointer( data, rule->event_id );
+    rule->event_id_hash = Rule_Image_Pointer( data, rule->event_id_hash );
+    rule->event_id_index = Rule_Image_Pointer( data, rule->event_id_index );
+
+    rule->flow_1 = Rule_Image_Pointer( data, rule->flow_1 );
+    rule->flow_2 = Rule_Image_Pointer( data, rule->flow_2 );
+    rule->port_1 = Rule_Image_Pointer( data, rule->port_1 );
+    rule->port_2 = Rule_Image_Pointer( data, rule->port_2 );
+
+    rule->flow_1_type = Rule_Image_Pointer( data, rule->flow_1_type );
+    rule->flow_2_type = Rule_Image_Pointer( data, rule->flow_2_type );
+    rule->port_1_type = Rule_Image_Pointer( data, rule->port_1_type );
+    rule->port_2_type = Rule_Image_Pointer( data, rule->port_2_type );
+
+    rule->meta_content_help = Rule_Image_Pointer( data, rule->meta_content_help );
+
+    rule->json_content_key = Rule_Image_Pointer( data, rule->json_content_key );
+    rule->json_content_key_hash = Rule_Image_Pointer( data, rule->json_content_key_hash );
+    rule->json_content_content = Rule_Image_Pointer( data, rule->json_content_content );
+
+    rule->json_pcre_key = Rule_Image_Pointer( data, rule->json_pcre_key );
+    rule->json_pcre_key_hash = Rule_Image_Pointer( data, rule->json_pcre_key_hash );
+
+    rule->json_meta_content_key = Rule_Image_Pointer( data, rule->json_meta_content_key );
+    rule->json_meta_content_key_hash = Rule_Image_Pointer( data, rule->json_meta_content_key_hash );
+
+    rule->aetas_week = Rule_Image_Pointer( data, rule->aetas_week );
+
+    /* The meta_content lists hold pointers themselves.  The image is read
+       only,  so they get a fixed up copy in the (small) arena */
+
+    if ( rule->meta_content_count > 0 )
+        {
+
+            meta_containers = Rule_Arena_Alloc( rule->meta_content_count * sizeof(struct meta_content_conversion) );
+            memcpy(meta_containers, Rule_Image_Pointer( data, rule->meta_content_containers ), rule->meta_content_count * sizeof(struct meta_content_conversion));
+
+            for ( a = 0; a < rule->meta_content_count; a++ )
+                {
+                    meta_containers[a].meta_content_converted = Rule_Image_Pointer( data, meta_containers[a].meta_content_converted );
+                }
+
+            rule->meta_content_containers = meta_containers;
+
+        }
+
+    if ( rule->json_meta_content_count > 0 )
+        {
+
+            json_meta_containers = Rule_Arena_Alloc( rule->json_meta_content_count * sizeof(struct json_meta_content_conversion) );
+            memcpy(json_meta_containers, Rule_Image_Pointer( data, rule->json_meta_content_containers ), rule->json_meta_content_count * sizeof(struct json_meta_content_conversion));
+
+            for ( a = 0; a < rule->json_meta_content_count; a++ )
+                {
+                    json_meta_containers[a].json_meta_content_converted = Rule_Image_Pointer( data, json_meta_containers[a].json_meta_content_converted );
+                }
+
+            rule->json_meta_content_containers = json_meta_containers;
+
+        }
+
+    /* Compiled patterns are used in place.  pcre_fullinfo() checks they are
+       usable by this libpcre.  Study (and JIT) data can't be saved,  so that
+       is redone */
+
+    for ( a = 0; a < rule->pcre_count; a++ )
+        {
+
+            rule->re_pcre[a] = Rule_Image_Pointer( data, rule->re_pcre[a] );
+
+            if ( pcre_fullinfo(rule->re_pcre[a], NULL, PCRE_INFO_OPTIONS, &options) != 0 )
+                {
+                    return(false);
+                }
+
+            rule->pcre_extra[a] = pcre_study( rule->re_pcre[a], study_options, &error );
+
+        }
+
+    for ( a = 0; a < rule->json_pcre_count; a++ )
+        {
+
+            rule->json_re_pcre[a] = Rule_Image_Pointer( data, rule->json_re_pcre[a] );
+
+            if ( pcre_fullinfo(rule->json_re_pcre[a], NULL, PCRE_INFO_OPTIONS, &options) != 0 )
+                {
+                    return(false);
+                }
+
+            rule->json_pcre_extra[a] = pcre_study( rule->json_re_pcre[a], study_options, &error );
+
+        }
+
+    return(true);
+
+}
+
+/****************************************************************************
+ * Rule_Image_Load - Load the rules from a precompiled image into the
+ * generation being loaded.  Returns false (and loads nothing) if the image
+ * is missing,  damaged or stale,  in which case the rule files should be
+ * parsed as normal.
+ ****************************************************************************/
+
+bool Rule_Image_Load( const char *filename )
+{
+
+    struct _Rule_Generation *gen = Rule_Generation_Current();
+
+    struct stat filecheck;
+    struct _Rule_Image_Header *Header = NULL;
+
+    unsigned char *image = NULL;
+    unsigned char *data = NULL;
+    const char *problem = NULL;
+
+    uint32_t max = 256;
+    int fd = -1;
+    int b = 0;
+
+    if (( fd = open(filename, O_RDONLY) ) == -1 )
+        {
+            Sagan_Log(WARN, "Cannot open rule image %s (%s).  Loading the rule files.", filename, strerror(errno));
+            return(false);
+        }
+
+    if ( fstat(fd, &filecheck) != 0 || filecheck.st_size < (off_t)sizeof(struct _Rule_Image_Header) )
+        {
+            Sagan_Log(WARN, "Rule image %s is truncated.  Loading the rule files.", filename);
+            close(fd);
+            return(false);
+        }
+
+    /* Shared and read only,  so other instances using the image share the
+       pages */
+
+    image = mmap(NULL, filecheck.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if ( image == MAP_FAILED )
+        {
+            Sagan_Log(WARN, "Cannot mmap() rule image %s (%s).  Loading the rule files.", filename, strerror(errno));
+            return(false);
+        }
+
+    Header = (struct _Rule_Image_Header *)image;
+
+    if ( memcmp(Header->magic, RULE_IMAGE_MAGIC, sizeof(RULE_IMAGE_MAGIC)) != 0 )
+        {
+            problem = "not a rule image";
+        }
+
+    else if ( Header->version != RULE_IMAGE_VERSION || Header->rule_size != sizeof(struct _Rule_Struct) )
+        {
+            problem = "from a different version of Sagan";
+        }
+
+    else if ( Header->size != (uint64_t)filecheck.st_size ||
+              Header->track_offset + (uint64_t)Header->ruleset_track_count * sizeof(struct _Sagan_Ruleset_Track) > Header->rules_offset ||
+              Header->rules_offset + (uint64_t)Header->rulecount * sizeof(struct _Rule_Struct) > Header->data_offset ||
+              Header->data_offset + Header->data_size != Header->size )
+        {
+            problem = "truncated";
+        }
+
+    else if ( Header->fingerprint != Rule_Image_Fingerprint() )
+        {
+            problem = "out of date";
+        }
+
+    else if ( Header->checksum != Rule_Image_Hash( RULE_IMAGE_FNV_OFFSET, image + Header->track_offset, Header->size - Header->track_offset ) )
+        {
+            problem = "damaged (bad checksum)";
+        }
+
+    if ( problem != NULL )
+        {
+            Sagan_Log(WARN, "Rule image %s is %s.  Loading the rule files.", filename, problem);
+            munmap(image, filecheck.st_size);
+            return(false);
+        }
+
+    data = image + Header->data_offset;
+
+    /* Ruleset tracking and the rules are copied out.  Both are written to
+       later (dynamic rules) */
+
+    if ( Header->ruleset_track_count > 0 )
+        {
+
+            gen->Ruleset_Track = malloc(Header->ruleset_track_count * sizeof(struct _Sagan_Ruleset_Track));
+
+            if ( gen->Ruleset_Track == NULL )
+                {
+                    Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for Ruleset_Track. Abort!", __FILE__, __LINE__);
+                }
+
+            memcpy(gen->Ruleset_Track, image + Header->track_offset, Header->ruleset_track_count * sizeof(struct _Sagan_Ruleset_Track));
+            gen->ruleset_track_count = Header->ruleset_track_count;
+
+        }
+
+    while ( max < Header->rulecount )
+        {
+            max *= 2;
+        }
+
+    gen->rulestruct = malloc(max * sizeof(struct _Rule_Struct));
+
+    if ( gen->rulestruct == NULL )
+        {
+            Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for rulestruct. Abort!", __FILE__, __LINE__);
+        }
+
+    memcpy(gen->rulestruct, image + Header->rules_offset, Header->rulecount * sizeof(struct _Rule_Struct));
+    gen->rulestruct_max = max;
+
+    for ( b = 0; b < (int)Header->rulecount; b++ )
+        {
+
+            if ( Rule_Image_Relocate( &gen->rulestruct[b], data ) == false )
+                {
+                    Sagan_Log(ERROR, "[%s, line %d] Rule image %s has a PCRE this libpcre can't use.  Rebuild it with --compile-rules. Abort!", __FILE__, __LINE__, filename);
+                }
+
+            Rule_Table_Add( b );
+
+            __atomic_add_fetch(&gen->rulecount, 1,  __ATOMIC_SEQ_CST);
+
+        }
+
+    gen->image = image;
+    gen->image_size = filecheck.st_size;
+
+    /* What Load_Rules() would have done along the way */
+
+    __atomic_add_fetch(&counters->flexbit_total_counter, Header->flexbit_total, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&counters->xbit_total_counter, Header->xbit_total, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&counters->dynamic_rule_count, Header->dynamic_rule_count, __ATOMIC_SEQ_CST);
+
+#ifdef HAVE_LIBESMTP
+
+    if ( Header->esmtp != 0 )
+        {
+            config->sagan_esmtp_flag = true;
+        }
+
+#endif
+
+    Sagan_Log(NORMAL, "Loaded %d rules from rule image %s.", gen->rulecount, filename);
+
+    return(true);
+
+}
+
+/****************************************************************************
+ * Rule_Image_Release - Unmap an image once its generation is released.
+ * See rule-generation.c
+ ****************************************************************************/
+
+void Rule_Image_Release( void *image, size_t size )
+{
+    munmap(image, size);
+}
@@ -0,0 +1,65 @@
+/*
+** Copyright (C) 2009-2020 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2020 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+/* Requires rules.h to be included first */
+
+#define RULE_IMAGE_MAGIC	"SAGANRI"	/* 8 bytes with the NULL */
+#define RULE_IMAGE_VERSION	1
+#define RULE_IMAGE_ALIGN	64		/* Section alignment within the image */
+
+/* On disk (and mmap()'ed) layout of a precompiled rule image.  Everything
+   after the header is covered by "checksum".  Pointers within the rules are
+   stored as offset + 1 into the data section (0 is NULL).  See rule-image.c */
+
+typedef struct _Rule_Image_Header _Rule_Image_Header;
+struct _Rule_Image_Header
+{
+
+    char magic[8];
+    uint32_t version;
+    uint32_t rule_size;				/* sizeof(_Rule_Struct) */
+
+    uint64_t fingerprint;			/* Rule files,  vars,  classifications,  PCRE version */
+    uint64_t checksum;
+    uint64_t size;				/* Whole image,  header included */
+
+    uint32_t rulecount;
+    uint32_t ruleset_track_count;
+
+    uint32_t flexbit_total;			/* Counters Load_Rules() would have bumped */
+    uint32_t xbit_total;
+    uint32_t dynamic_rule_count;
+    uint32_t esmtp;				/* A rule uses "email:" */
+
+    uint64_t track_offset;			/* _Sagan_Ruleset_Track[ruleset_track_count] */
+    uint64_t rules_offset;			/* _Rule_Struct[rulecount] */
+    uint64_t data_offset;			/* Rule arena contents and compiled PCRE */
+    uint64_t data_size;
+
+};
+
+void Rule_Image_Write( const char *filename );
+bool Rule_Image_Load( const char *filename );
+void Rule_Image_Release( void *image, size_t size );
+
@@ -0,0 +1,166 @@
+/*
+** Copyright (C) 2009-2020 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2020 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* rule-load.c
+ *
+ * Parses the rule files on several threads at once.  Each thread parses a
+ * file at a time into its own staging generation (Rule_Generation_Local
+ * is per thread,  so Load_Rules() needs no changes).  This includes
+ * compiling the file's pcre.  Once every file has been parsed,  the staging
+ * generations are merged in the order the files are listed in the
+ * configuration,  so rule positions are the same as loading them one at a
+ * time.  See rule-generation.c
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <pcre.h>
+
+#ifdef HAVE_SYS_PRCTL_H
+#include <sys/prctl.h>
+#endif
+
+#include "sagan.h"
+#include "sagan-defs.h"
+#include "rules.h"
+#include "rule-arena.h"
+#include "rule-epoch.h"
+#include "rule-generation.h"
+#include "rule-load.h"
+
+/****************************************************************************
+ * Rule_Load_Thread - Parse rule files until there are none left
+ ****************************************************************************/
+
+static void Rule_Load_Thread( struct _Rule_Load *Load )
+{
+
+    uint32_t i = 0;
+
+    (void)SetThreadName("SaganRuleLoad");
+
+    while ( ( i = __atomic_fetch_add(&Load->next, 1, __ATOMIC_SEQ_CST) ) < Load->count )
+        {
+            Rule_Generation_Local = Load->staging[i];
+            Load_Rules( Load->rulesets[i].ruleset );
+        }
+
+    Rule_Generation_Local = NULL;
+
+    Rule_Arena_Scratch_Free();
+
+}
+
+/****************************************************************************
+ * Rule_Load_Files - Load "count" rule files into the calling thread's
+ * generation.
+ ****************************************************************************/
+
+void Rule_Load_Files( struct _Rules_Loaded *rulesets, int count )
+{
+
+    struct _Rule_Load Load;
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = 0;
+    int rc = 0;
+    int i = 0;
+
+    threads = cpus < 1 ? 1 : cpus > RULE_LOAD_MAX_THREADS ? RULE_LOAD_MAX_THREADS : cpus;
+
+    if ( threads > count )
+        {
+            threads = count;
+        }
+
+    /* Nothing to gain */
+
+    if ( threads <= 1 )
+        {
+
+            for ( i = 0; i < count; i++ )
+                {
+                    Load_Rules( rulesets[i].ruleset );
+                }
+
+            return;
+        }
+
+    pthread_t load_thread[threads];
+
+    memset(&Load, 0, sizeof(Load));
+
+    Load.rulesets = rulesets;
+    Load.count = count;
+    Load.staging = malloc(count * sizeof(struct _Rule_Generation *));
+
+    if ( Load.staging == NULL )
+        {
+            Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for rule loading. Abort!", __FILE__, __LINE__);
+        }
+
+    for ( i = 0; i < count; i++ )
+        {
+            Load.staging[i] = Rule_Generation_Staging();
+        }
+
+    Sagan_Log(NORMAL, "Loading %d rule files on %d threads.", count, threads);
+
+    for ( i = 0; i < threads; i++ )
+        {
+
+            rc = pthread_create( &load_thread[i], NULL, (void *)Rule_Load_Thread, &Load );
+
+            if ( rc != 0 )
+                {
+                    Sagan_Log(ERROR, "[%s, line %d] Error creating rule loading thread. [error: %d]", __FILE__, __LINE__, rc);
+                }
+        }
+
+    for ( i = 0; i < threads; i++ )
+        {
+            pthread_join( load_thread[i], NULL );
+        }
+
+    /* Same order as the configuration */
+
+    for ( i = 0; i < count; i++ )
+        {
+            Rule_Generation_Merge( Load.staging[i] );
+        }
+
+    free(Load.staging);
+
+    /* rulestruct copies left behind as the staging generations grew.  Nobody
+       else has seen them. */
+
+    (void)Rule_Epoch_Reclaim();
+
+}
@@ -0,0 +1,41 @@
+/*
+** Copyright (C) 2009-2020 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2020 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+/* Requires rules.h to be included first */
+
+#define RULE_LOAD_MAX_THREADS	16		/* Rule files parsed at once */
+
+typedef struct _Rule_Load _Rule_Load;
+struct _Rule_Load
+{
+
+    struct _Rules_Loaded *rulesets;
+    struct _Rule_Generation **staging;		/* One per rule file */
+    uint32_t count;
+    uint32_t next;				/* Next rule file to parse */
+
+};
+
+void Rule_Load_Files( struct _Rules_Loaded *rulesets, int count );
+
@@ -0,0 +1,415 @@
+/*
+** Copyright (C) 2009-2020 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2020 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* rule-profile.c
+ *
+ * "rule-profiling" - Per rule counters and CPU time,  similar to Snort's
+ * rule profiling.  This is used to find the rules that are making Sagan
+ * slow after a rule set update.
+ *
+ * Every processing thread keeps its own array of counters so Sagan_Engine()
+ * never shares a cache line or takes a lock to update them.  The per thread
+ * arrays are only merged when a report is requested (SIGUSR1,  shutdown or
+ * stats-json).  The merged numbers may be a few events behind the threads.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <time.h>
+
+#ifdef HAVE_LIBFASTJSON
+#include <json.h>
+#endif
+
+#include "sagan.h"
+#include "sagan-defs.h"
+#include "sagan-config.h"
+#include "rules.h"
+#include "rule-table.h"
+#include "rule-generation.h"
+#include "rule-profile.h"
+#include "rule-epoch.h"
+
+struct _SaganCounters *counters;
+struct _SaganConfig *config;
+
+static pthread_mutex_t Rule_Profile_List_Mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct _Rule_Profile_Thread *Rule_Profile_List = NULL;
+
+/* Bumped every time the rules are (re)loaded.  Threads with an older
+   generation clear their counters before using them again. */
+
+static uint32_t Rule_Profile_Generation = 1;
+
+/* A merged rule,  used for sorting the report */
+
+struct _Rule_Profile_Merged
+{
+    int rule;
+    struct _Rule_Profile profile;
+};
+
+/****************************************************************************
+ * Rule_Profile_Ticks - CPU time stamp.  This is the TSC where we have it,
+ * otherwise nanoseconds from the monotonic clock.
+ ****************************************************************************/
+
+uint64_t Rule_Profile_Ticks( void )
+{
+
+#if defined(__x86_64__) || defined(__i386__)
+
+    return(__builtin_ia32_rdtsc());
+
+#else
+
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return( (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec );
+
+#endif
+
+}
+
+/****************************************************************************
+ * Rule_Profile_Begin - Called at the start of every event.  Returns the
+ * calling thread's counters,  creating or clearing them if needed.
+ ****************************************************************************/
+
+struct _Rule_Profile *Rule_Profile_Begin( struct _Rule_Profile_Thread **ProfileThread )
+{
+
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
+
+    struct _Rule_Profile_Thread *Profile = *ProfileThread;
+    struct _Rule_Profile *tmp = NULL;
+
+    uint32_t generation = __atomic_load_n(&Rule_Profile_Generation, __ATOMIC_ACQUIRE);
+    uint32_t rulecount = gen->rulecount;
+
+    if ( Profile == NULL )
+        {
+
+            Profile = malloc(sizeof(struct _Rule_Profile_Thread));
+
+            if ( Profile == NULL )
+                {
+                    Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for _Rule_Profile_Thread. Abort!", __FILE__, __LINE__);
+                }
+
+            memset(Profile, 0, sizeof(struct _Rule_Profile_Thread));
+            pthread_mutex_init(&Profile->lock, NULL);
+
+            pthread_mutex_lock(&Rule_Profile_List_Mutex);
+            Profile->next = Rule_Profile_List;
+            Rule_Profile_List = Profile;
+            pthread_mutex_unlock(&Rule_Profile_List_Mutex);
+
+            *ProfileThread = Profile;
+        }
+
+    if ( Profile->generation == generation && Profile->size >= rulecount )
+        {
+            return(Profile->rules);
+        }
+
+    pthread_mutex_lock(&Profile->lock);
+
+    if ( Profile->size < rulecount )
+        {
+
+            tmp = realloc(Profile->rules, rulecount * sizeof(struct _Rule_Profile));
+
+            if ( tmp == NULL )
+                {
+                    Sagan_Log(ERROR, "[%s, line %d] Failed to reallocate memory for _Rule_Profile. Abort!", __FILE__, __LINE__);
+                }
+
+            memset(&tmp[Profile->size], 0, ( rulecount - Profile->size ) * sizeof(struct _Rule_Profile));
+
+            Profile->rules = tmp;
+            Profile->size = rulecount;
+        }
+
+    if ( Profile->generation != generation )
+        {
+            memset(Profile->rules, 0, Profile->size * sizeof(struct _Rule_Profile));
+            Profile->generation = generation;
+        }
+
+    pthread_mutex_unlock(&Profile->lock);
+
+    return(Profile->rules);
+
+}
+
+/****************************************************************************
+ * Rule_Profile_Reset - Rules have been reloaded (SIGHUP).  Rule numbers no
+ * longer line up so everything collected so far is thrown away.
+ ****************************************************************************/
+
+void Rule_Profile_Reset( void )
+{
+    __atomic_add_fetch(&Rule_Profile_Generation, 1, __ATOMIC_RELEASE);
+}
+
+/****************************************************************************
+ * Rule_Profile_Compare - qsort(),  most CPU time first
+ ****************************************************************************/
+
+static int Rule_Profile_Compare( const void *a, const void *b )
+{
+
+    const struct _Rule_Profile_Merged *x = a;
+    const struct _Rule_Profile_Merged *y = b;
+
+    if ( x->profile.ticks != y->profile.ticks )
+        {
+            return( x->profile.ticks > y->profile.ticks ? -1 : 1 );
+        }
+
+    if ( x->profile.checks != y->profile.checks )
+        {
+            return( x->profile.checks > y->profile.checks ? -1 : 1 );
+        }
+
+    return( x->rule - y->rule );
+
+}
+
+/****************************************************************************
+ * Rule_Profile_Merge - Add up every thread's counters and sort them.  The
+ * caller free()'s the results.
+ ****************************************************************************/
+
+static struct _Rule_Profile_Merged *Rule_Profile_Merge( int *count )
+{
+
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
+
+    struct _Rule_Profile_Thread *Profile = NULL;
+    struct _Rule_Profile_Merged *Merged = NULL;
+
+    uint32_t generation = __atomic_load_n(&Rule_Profile_Generation, __ATOMIC_ACQUIRE);
+    int rulecount = gen->rulecount;
+
+    int i = 0;
+    int c = 0;
+    int max = 0;
+
+    *count = 0;
+
+    if ( rulecount <= 0 )
+        {
+            return(NULL);
+        }
+
+    Merged = malloc(rulecount * sizeof(struct _Rule_Profile_Merged));
+
+    if ( Merged == NULL )
+        {
+            Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for _Rule_Profile_Merged. Abort!", __FILE__, __LINE__);
+        }
+
+    memset(Merged, 0, rulecount * sizeof(struct _Rule_Profile_Merged));
+
+    for ( i = 0; i < rulecount; i++ )
+        {
+            Merged[i].rule = i;
+        }
+
+    pthread_mutex_lock(&Rule_Profile_List_Mutex);
+
+    for ( Profile = Rule_Profile_List; Profile != NULL; Profile = Profile->next )
+        {
+
+            pthread_mutex_lock(&Profile->lock);
+
+            if ( Profile->generation == generation )
+                {
+
+                    max = Profile->size < (uint32_t)rulecount ? Profile->size : rulecount;
+
+                    for ( i = 0; i < max; i++ )
+                        {
+
+                            Merged[i].profile.checks += __atomic_load_n(&Profile->rules[i].checks, __ATOMIC_RELAXED);
+                            Merged[i].profile.header_pass += __atomic_load_n(&Profile->rules[i].header_pass, __ATOMIC_RELAXED);
+
+                            for ( c = 0; c < RULE_CHECK_MAX; c++ )
+                                {
+                                    Merged[i].profile.stage_pass[c] += __atomic_load_n(&Profile->rules[i].stage_pass[c], __ATOMIC_RELAXED);
+                                }
+
+                            Merged[i].profile.matches += __atomic_load_n(&Profile->rules[i].matches, __ATOMIC_RELAXED);
+                            Merged[i].profile.triggers += __atomic_load_n(&Profile->rules[i].triggers, __ATOMIC_RELAXED);
+                            Merged[i].profile.alerts += __atomic_load_n(&Profile->rules[i].alerts, __ATOMIC_RELAXED);
+                            Merged[i].profile.ticks += __atomic_load_n(&Profile->rules[i].ticks, __ATOMIC_RELAXED);
+
+                        }
+                }
+
+            pthread_mutex_unlock(&Profile->lock);
+
+        }
+
+    pthread_mutex_unlock(&Rule_Profile_List_Mutex);
+
+    qsort(Merged, rulecount, sizeof(struct _Rule_Profile_Merged), Rule_Profile_Compare);
+
+    *count = rulecount < config->rule_profile_top ? rulecount : config->rule_profile_top;
+
+    return(Merged);
+
+}
+
+/****************************************************************************
+ * Rule_Profile_Report - Log the top "rule-profiling-top" rules by CPU time
+ ****************************************************************************/
+
+void Rule_Profile_Report( void )
+{
+
+    const struct _Rule_Generation *gen = NULL;
+
+    struct _Rule_Profile_Merged *Merged = NULL;
+    struct _Rule_Profile *p = NULL;
+
+    int count = 0;
+    int i = 0;
+
+    Rule_Epoch_Enter();
+
+    gen = Rule_Generation_Current();
+
+    Merged = Rule_Profile_Merge( &count );
+
+    Sagan_Log(NORMAL, "");
+    Sagan_Log(NORMAL, "          -[ Sagan Rule Profile (top %d by CPU ticks) ]-", count);
+    Sagan_Log(NORMAL, "");
+
+    for ( i = 0; i < count; i++ )
+        {
+
+            p = &Merged[i].profile;
+
+            if ( p->checks == 0 )
+                {
+                    break;
+                }
+
+            Sagan_Log(NORMAL, "  %3d sid: %" PRIu64 " rev: %" PRIu32 " \"%s\"", i + 1, gen->rulestruct[Merged[i].rule].s_sid, gen->rulestruct[Merged[i].rule].s_rev, gen->rulestruct[Merged[i].rule].s_msg);
+
+            Sagan_Log(NORMAL, "      Ticks/Avg per check         : %" PRIu64 " / %" PRIu64 "", p->ticks, p->ticks / p->checks);
+
+            Sagan_Log(NORMAL, "      Checks/Header/Match/Trigger : %" PRIu64 " / %" PRIu64 " / %" PRIu64 " / %" PRIu64 "", p->checks, p->header_pass, p->matches, p->triggers);
+
+            Sagan_Log(NORMAL, "      Content/PCRE/Meta           : %" PRIu64 " / %" PRIu64 " / %" PRIu64 "", p->stage_pass[RULE_CHECK_CONTENT], p->stage_pass[RULE_CHECK_PCRE], p->stage_pass[RULE_CHECK_META_CONTENT]);
+
+            Sagan_Log(NORMAL, "      JSON PCRE/Content/Meta      : %" PRIu64 " / %" PRIu64 " / %" PRIu64 "", p->stage_pass[RULE_CHECK_JSON_PCRE], p->stage_pass[RULE_CHECK_JSON_CONTENT], p->stage_pass[RULE_CHECK_JSON_META_CONTENT]);
+
+            Sagan_Log(NORMAL, "      Event ID/Alerts             : %" PRIu64 " / %" PRIu64 "", p->stage_pass[RULE_CHECK_EVENT_ID], p->alerts);
+
+        }
+
+    Sagan_Log(NORMAL, "");
+
+    free(Merged);
+
+    Rule_Epoch_Exit();
+
+}
+
+#ifdef HAVE_LIBFASTJSON
+
+/****************************************************************************
+ * Rule_Profile_JSON - Adds the top "rule-profiling-top" rules to a JSON
+ * array for stats-json.
+ ****************************************************************************/
+
+void Rule_Profile_JSON( struct json_object *jarray )
+{
+
+    const struct _Rule_Generation *gen = NULL;
+
+    struct _Rule_Profile_Merged *Merged = NULL;
+    struct _Rule_Profile *p = NULL;
+
+    struct json_object *jrule;
+
+    int count = 0;
+    int i = 0;
+
+    Rule_Epoch_Enter();
+
+    gen = Rule_Generation_Current();
+
+    Merged = Rule_Profile_Merge( &count );
+
+    for ( i = 0; i < count; i++ )
+        {
+
+            p = &Merged[i].profile;
+
+            if ( p->checks == 0 )
+                {
+                    break;
+                }
+
+            jrule = json_object_new_object();
+
+            json_object_object_add(jrule, "signature_id", json_object_new_int64( gen->rulestruct[Merged[i].rule].s_sid ));
+            json_object_object_add(jrule, "rev", json_object_new_int64( gen->rulestruct[Merged[i].rule].s_rev ));
+            json_object_object_add(jrule, "signature", json_object_new_string( gen->rulestruct[Merged[i].rule].s_msg ));
+            json_object_object_add(jrule, "checks", json_object_new_int64( p->checks ));
+            json_object_object_add(jrule, "header", json_object_new_int64( p->header_pass ));
+            json_object_object_add(jrule, "content", json_object_new_int64( p->stage_pass[RULE_CHECK_CONTENT] ));
+            json_object_object_add(jrule, "pcre", json_object_new_int64( p->stage_pass[RULE_CHECK_PCRE] ));
+            json_object_object_add(jrule, "meta_content", json_object_new_int64( p->stage_pass[RULE_CHECK_META_CONTENT] ));
+            json_object_object_add(jrule, "json_pcre", json_object_new_int64( p->stage_pass[RULE_CHECK_JSON_PCRE] ));
+            json_object_object_add(jrule, "json_content", json_object_new_int64( p->stage_pass[RULE_CHECK_JSON_CONTENT] ));
+            json_object_object_add(jrule, "json_meta_content", json_object_new_int64( p->stage_pass[RULE_CHECK_JSON_META_CONTENT] ));
+            json_object_object_add(jrule, "event_id", json_object_new_int64( p->stage_pass[RULE_CHECK_EVENT_ID] ));
+            json_object_object_add(jrule, "matches", json_object_new_int64( p->matches ));
+            json_object_object_add(jrule, "triggers", json_object_new_int64( p->triggers ));
+            json_object_object_add(jrule, "alerts", json_object_new_int64( p->alerts ));
+            json_object_object_add(jrule, "ticks", json_object_new_int64( p->ticks ));
+
+            json_object_array_add(jarray, jrule);
+
+        }
+
+    free(Merged);
+
+    Rule_Epoch_Exit();
+
+}
+
+#endif
@@ -0,0 +1,62 @@
+/*
+** Copyright (C) 2009-2020 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2020 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* Requires rule-table.h (and json.h with libfastjson) to be included first */
+
+/* Per rule counters.  Each thread keeps its own array (indexed the same as
+   rulestruct) so nothing here is shared or locked in Sagan_Engine(). */
+
+typedef struct _Rule_Profile _Rule_Profile;
+struct _Rule_Profile
+{
+
+    uint64_t checks;				/* Rule was looked at */
+    uint64_t header_pass;			/* Passed program/facility/level/tag/syspri */
+    uint64_t stage_pass[RULE_CHECK_MAX];	/* Passed content,  pcre,  etc (RULE_CHECK_*) */
+    uint64_t matches;				/* Passed every content/pcre/etc check */
+    uint64_t triggers;				/* Passed flow/xbit/flexbit/etc routing */
+    uint64_t alerts;				/* Passed threshold/after and alerted */
+    uint64_t ticks;				/* CPU time spent on the rule */
+
+};
+
+typedef struct _Rule_Profile_Thread _Rule_Profile_Thread;
+struct _Rule_Profile_Thread
+{
+
+    pthread_mutex_t lock;			/* Held while "rules" is resized or merged */
+
+    uint32_t generation;			/* Rules (re)loaded since "rules" was cleared */
+    uint32_t size;
+    struct _Rule_Profile *rules;
+
+    struct _Rule_Profile_Thread *next;
+
+};
+
+uint64_t Rule_Profile_Ticks( void );
+struct _Rule_Profile *Rule_Profile_Begin( struct _Rule_Profile_Thread **ProfileThread );
+void Rule_Profile_Reset( void );
+void Rule_Profile_Report( void );
+
+#ifdef HAVE_LIBFASTJSON
+void Rule_Profile_JSON( struct json_object *jarray );
+#endif
+
@@ -0,0 +1,623 @@
+/*
+** Copyright (C) 2009-2020 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2020 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* rule-table.c
+ *
+ * Builds the "hot" rule table (see rule-table.h) as rules are loaded.
+ * _Rule_Struct is several kilobytes,  and the fields Sagan_Engine() checks
+ * for every rule were spread over many cache lines of it.  Copying them into
+ * dense arrays means rejecting a rule touches a few bytes instead.
+ *
+ * The program/facility/level/tag/priority filters are also de-duplicated
+ * here,  so rules that share a filter share its result for an event.
+ *
+ * This is also where the order of a rule's content/pcre/etc checks is
+ * decided.  All of the checks have to pass for a rule to match,  so the
+ * order doesn't change the result,  only how much work it takes to reject
+ * an event.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pcre.h>
+
+#include "sagan.h"
+#include "sagan-defs.h"
+#include "sagan-config.h"
+#include "rules.h"
+#include "rule-table.h"
+#include "rule-generation.h"
+#include "rule-epoch.h"
+#include "flow.h"
+
+struct _SaganConfig *config;
+
+
+/****************************************************************************
+ * Rule_Table_Grow - Replace one of the rule table arrays with a larger copy.
+ * Processing threads may still be reading the old one (dynamic rules),  so
+ * it is retired rather than free()'ed.  See rule-epoch.c
+ ****************************************************************************/
+
+#define Rule_Table_Grow(array, old_max, new_max) \
+    Rule_Epoch_Grow(&(array), (old_max) * sizeof((array)[0]), (new_max) * sizeof((array)[0]))
+
+/****************************************************************************
+ * Rule_Table_Header_ID - Returns the ID for a header filter,  adding it if
+ * it hasn't been seen yet.  An empty filter is always ID 0.
+ ****************************************************************************/
+
+static uint32_t Rule_Table_Header_ID( unsigned char type, char *value )
+{
+
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
+
+    uint32_t i = 0;
+    uint32_t hash = 0;
+
+    if ( value[0] == '\0' )
+        {
+            return(0);
+        }
+
+    hash = Djb2_Hash(value);
+
+    for ( i = 1; i < gen->ruletable->header_count; i++ )
+        {
+
+            if ( gen->ruletable->header[i].hash == hash &&
+                    gen->ruletable->header[i].type == type &&
+                    !strcmp(gen->ruletable->header[i].value, value) )
+                {
+                    return(i);
+                }
+        }
+
+    if ( gen->ruletable->header_count >= gen->ruletable->header_max )
+        {
+            Rule_Table_Grow(gen->ruletable->header, gen->ruletable->header_max, gen->ruletable->header_max * 2);
+            gen->ruletable->header_max = gen->ruletable->header_max * 2;
+        }
+
+    gen->ruletable->header[gen->ruletable->header_count].type = type;
+    gen->ruletable->header[gen->ruletable->header_count].hash = hash;
+    strlcpy(gen->ruletable->header[gen->ruletable->header_count].value, value, sizeof(gen->ruletable->header[gen->ruletable->header_count].value));
+
+    gen->ruletable->header_count++;
+
+    return(gen->ruletable->header_count - 1);
+
+}
+
+/****************************************************************************
+ * Rule_Table_Template_Safe - Does the rule give the same answer for every
+ * message with the same "template-cache" template?  True when its only
+ * checks are content/meta_content without digits or positions.  See
+ * template-cache.c
+ ****************************************************************************/
+
+static bool Rule_Table_Template_Safe( uint32_t b )
+{
+
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
+
+    int i = 0;
+    int z = 0;
+
+    if ( gen->rulestruct[b].pcre_count > 0 || gen->rulestruct[b].event_id_count > 0 ||
+            gen->rulestruct[b].json_pcre_count > 0 || gen->rulestruct[b].json_content_count > 0 ||
+            gen->rulestruct[b].json_meta_content_count > 0 )
+        {
+            return(false);
+        }
+
+    for ( i = 0; i < gen->rulestruct[b].content_count; i++ )
+        {
+
+            if ( gen->rulestruct[b].s_offset[i] != 0 || gen->rulestruct[b].s_depth[i] != 0 ||
+                    gen->rulestruct[b].s_distance[i] != 0 || gen->rulestruct[b].s_within[i] != 0 ||
+                    strpbrk(gen->rulestruct[b].content[i], "0123456789") != NULL )
+                {
+                    return(false);
+                }
+        }
+
+    for ( i = 0; i < gen->rulestruct[b].meta_content_count; i++ )
+        {
+
+            if ( gen->rulestruct[b].meta_offset[i] != 0 || gen->rulestruct[b].meta_depth[i] != 0 ||
+                    gen->rulestruct[b].meta_distance[i] != 0 || gen->rulestruct[b].meta_within[i] != 0 )
+                {
+                    return(false);
+                }
+
+            for ( z = 0; z < gen->rulestruct[b].meta_content_containers[i].meta_counter; z++ )
+                {
+
+                    if ( strpbrk(gen->rulestruct[b].meta_content_containers[i].meta_content_converted[z], "0123456789") != NULL )
+                        {
+                            return(false);
+                        }
+                }
+        }
+
+    return(true);
+
+}
+
+/****************************************************************************
+ * Rule_Table_Add - Copy the hot fields of rulestruct[b] into the table.
+ * Called by Load_Rules() once a rule has been completely parsed.
+ ****************************************************************************/
+
+void Rule_Table_Add( uint32_t b )
+{
+
+    struct _Rule_Generation *gen = Rule_Generation_Current();
+
+    uint16_t stages = 0;
+    uint16_t flags = 0;
+
+    uint32_t meta_items = 0;
+    uint32_t json_meta_items = 0;
+    uint32_t max = 0;
+
+    int i = 0;
+
+    if ( gen->ruletable == NULL )
+        {
+
+            gen->ruletable = calloc(1, sizeof(struct _Rule_Table));
+
+            if ( gen->ruletable == NULL )
+                {
+                    Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for the rule table. Abort!", __FILE__, __LINE__);
+                }
+
+            Rule_Table_Grow(gen->ruletable->header, 0, 64);
+            gen->ruletable->header_max = 64;
+            gen->ruletable->header_count = 1;
+
+        }
+
+    if ( b >= gen->ruletable->max )
+        {
+
+            max = gen->ruletable->max == 0 ? 256 : gen->ruletable->max * 2;
+
+            Rule_Table_Grow(gen->ruletable->type, gen->ruletable->max, max);
+
+            Rule_Table_Grow(gen->ruletable->program_id, gen->ruletable->max, max);
+            Rule_Table_Grow(gen->ruletable->facility_id, gen->ruletable->max, max);
+            Rule_Table_Grow(gen->ruletable->level_id, gen->ruletable->max, max);
+            Rule_Table_Grow(gen->ruletable->tag_id, gen->ruletable->max, max);
+            Rule_Table_Grow(gen->ruletable->syspri_id, gen->ruletable->max, max);
+
+            Rule_Table_Grow(gen->ruletable->stages, gen->ruletable->max, max);
+            Rule_Table_Grow(gen->ruletable->flags, gen->ruletable->max, max);
+
+            Rule_Table_Grow(gen->ruletable->content_count, gen->ruletable->max, max);
+            Rule_Table_Grow(gen->ruletable->pcre_count, gen->ruletable->max, max);
+            Rule_Table_Grow(gen->ruletable->meta_content_count, gen->ruletable->max, max);
+            Rule_Table_Grow(gen->ruletable->json_pcre_count, gen->ruletable->max, max);
+            Rule_Table_Grow(gen->ruletable->json_content_count, gen->ruletable->max, max);
+            Rule_Table_Grow(gen->ruletable->json_meta_content_count, gen->ruletable->max, max);
+            Rule_Table_Grow(gen->ruletable->event_id_count, gen->ruletable->max, max);
+
+            Rule_Table_Grow(gen->ruletable->order, gen->ruletable->max, max);
+            Rule_Table_Grow(gen->ruletable->cost, gen->ruletable->max, max);
+            Rule_Table_Grow(gen->ruletable->checks, gen->ruletable->max, max);
+            Rule_Table_Grow(gen->ruletable->rejects, gen->ruletable->max, max);
+            Rule_Table_Grow(gen->ruletable->samples, gen->ruletable->max, max);
+
+            Rule_Table_Grow(gen->ruletable->ip_proto, gen->ruletable->max, max);
+            Rule_Table_Grow(gen->ruletable->direction, gen->ruletable->max, max);
+            Rule_Table_Grow(gen->ruletable->flow_1_group, gen->ruletable->max, max);
+            Rule_Table_Grow(gen->ruletable->port_1_group, gen->ruletable->max, max);
+            Rule_Table_Grow(gen->ruletable->flow_2_group, gen->ruletable->max, max);
+            Rule_Table_Grow(gen->ruletable->port_2_group, gen->ruletable->max, max);
+
+            gen->ruletable->max = max;
+
+        }
+
+    gen->ruletable->type[b] = gen->rulestruct[b].type;
+
+    gen->ruletable->program_id[b] = Rule_Table_Header_ID( RULE_HEADER_PROGRAM, gen->rulestruct[b].s_program );
+    gen->ruletable->facility_id[b] = Rule_Table_Header_ID( RULE_HEADER_FACILITY, gen->rulestruct[b].s_facility );
+    gen->ruletable->level_id[b] = Rule_Table_Header_ID( RULE_HEADER_LEVEL, gen->rulestruct[b].s_level );
+    gen->ruletable->tag_id[b] = Rule_Table_Header_ID( RULE_HEADER_TAG, gen->rulestruct[b].s_tag );
+    gen->ruletable->syspri_id[b] = Rule_Table_Header_ID( RULE_HEADER_SYSPRI, gen->rulestruct[b].s_syspri );
+
+    /* flow_1/port_1/flow_2/port_2 are compiled into shared groups.  See flow.c */
+
+    gen->ruletable->ip_proto[b] = gen->rulestruct[b].ip_proto;
+    gen->ruletable->direction[b] = gen->rulestruct[b].direction;
+
+    gen->ruletable->flow_1_group[b] = gen->rulestruct[b].flow_1_var == 0 ? 0 : Flow_Group_ID( FLOW_GROUP_ADDRESS, gen->rulestruct[b].flow_1, gen->rulestruct[b].flow_1_type, gen->rulestruct[b].flow_1_counter );
+    gen->ruletable->port_1_group[b] = gen->rulestruct[b].port_1_var == 0 ? 0 : Flow_Group_ID( FLOW_GROUP_PORT, gen->rulestruct[b].port_1, gen->rulestruct[b].port_1_type, gen->rulestruct[b].port_1_counter );
+    gen->ruletable->flow_2_group[b] = gen->rulestruct[b].flow_2_var == 0 ? 0 : Flow_Group_ID( FLOW_GROUP_ADDRESS, gen->rulestruct[b].flow_2, gen->rulestruct[b].flow_2_type, gen->rulestruct[b].flow_2_counter );
+    gen->ruletable->port_2_group[b] = gen->rulestruct[b].port_2_var == 0 ? 0 : Flow_Group_ID( FLOW_GROUP_PORT, gen->rulestruct[b].port_2, gen->rulestruct[b].port_2_type, gen->rulestruct[b].port_2_counter );
+
+    gen->ruletable->content_count[b] = gen->rulestruct[b].content_count;
+    gen->ruletable->pcre_count[b] = gen->rulestruct[b].pcre_count;
+    gen->ruletable->meta_content_count[b] = gen->rulestruct[b].meta_content_count;
+    gen->ruletable->json_pcre_count[b] = gen->rulestruct[b].json_pcre_count;
+    gen->ruletable->json_content_count[b] = gen->rulestruct[b].json_content_count;
+    gen->ruletable->json_meta_content_count[b] = gen->rulestruct[b].json_meta_content_count;
+    gen->ruletable->event_id_count[b] = gen->rulestruct[b].event_id_count;
+
+    if ( gen->rulestruct[b].content_count > 0 )
+        {
+            stages |= RULE_STAGE_CONTENT;
+        }
+
+    if ( gen->rulestruct[b].pcre_count > 0 )
+        {
+            stages |= RULE_STAGE_PCRE;
+        }
+
+    if ( gen->rulestruct[b].meta_content_count > 0 )
+        {
+            stages |= RULE_STAGE_META_CONTENT;
+        }
+
+    if ( gen->rulestruct[b].json_pcre_count > 0 )
+        {
+            stages |= RULE_STAGE_JSON_PCRE;
+        }
+
+    if ( gen->rulestruct[b].json_content_count > 0 )
+        {
+            stages |= RULE_STAGE_JSON_CONTENT;
+        }
+
+    if ( gen->rulestruct[b].json_meta_content_count > 0 )
+        {
+            stages |= RULE_STAGE_JSON_META_CONTENT;
+        }
+
+    if ( gen->rulestruct[b].event_id_count > 0 )
+        {
+            stages |= RULE_STAGE_EVENT_ID;
+        }
+
+    if ( gen->rulestruct[b].append_program == true )
+        {
+            flags |= RULE_FLAG_APPEND_PROGRAM;
+        }
+
+    if ( gen->rulestruct[b].normalize == true )
+        {
+            flags |= RULE_FLAG_NORMALIZE;
+        }
+
+    if ( gen->rulestruct[b].threshold2_type != 0 )
+        {
+            flags |= RULE_FLAG_THRESHOLD;
+        }
+
+    if ( gen->rulestruct[b].after2 == true )
+        {
+            flags |= RULE_FLAG_AFTER;
+        }
+
+    if ( gen->rulestruct[b].xbit_flag == true )
+        {
+            flags |= RULE_FLAG_XBIT;
+        }
+
+    if ( gen->rulestruct[b].flexbit_flag == true )
+        {
+            flags |= RULE_FLAG_FLEXBIT;
+        }
+
+    if ( gen->rulestruct[b].has_flow == true )
+        {
+            flags |= RULE_FLAG_FLOW;
+        }
+
+    if ( gen->rulestruct[b].flexbit_pause_time != 0 || gen->rulestruct[b].flexbit_upause_time != 0 ||
+            gen->rulestruct[b].xbit_pause_time != 0 || gen->rulestruct[b].xbit_upause_time != 0 )
+        {
+            flags |= RULE_FLAG_PAUSE;
+        }
+
+    if ( Rule_Table_Template_Safe( b ) == false )
+        {
+            flags |= RULE_FLAG_TEMPLATE_UNSAFE;
+        }
+
+    gen->ruletable->stages[b] = stages;
+    gen->ruletable->flags[b] = flags;
+
+    /* Estimated cost of each check */
+
+    for ( i = 0; i < gen->rulestruct[b].meta_content_count; i++ )
+        {
+            meta_items += gen->rulestruct[b].meta_content_containers[i].meta_counter;
+        }
+
+    for ( i = 0; i < gen->rulestruct[b].json_meta_content_count; i++ )
+        {
+            json_meta_items += gen->rulestruct[b].json_meta_content_containers[i].json_meta_counter;
+        }
+
+    gen->ruletable->cost[b][RULE_CHECK_CONTENT] = RULE_COST_CONTENT * gen->rulestruct[b].content_count;
+    gen->ruletable->cost[b][RULE_CHECK_PCRE] = RULE_COST_PCRE * gen->rulestruct[b].pcre_count;
+    gen->ruletable->cost[b][RULE_CHECK_META_CONTENT] = RULE_COST_META_CONTENT * meta_items;
+    gen->ruletable->cost[b][RULE_CHECK_JSON_PCRE] = RULE_COST_JSON_PCRE * gen->rulestruct[b].json_pcre_count;
+    gen->ruletable->cost[b][RULE_CHECK_JSON_CONTENT] = RULE_COST_JSON_CONTENT * gen->rulestruct[b].json_content_count;
+    gen->ruletable->cost[b][RULE_CHECK_JSON_META_CONTENT] = RULE_COST_JSON_META_CONTENT * json_meta_items;
+    gen->ruletable->cost[b][RULE_CHECK_EVENT_ID] = RULE_COST_EVENT_ID * gen->rulestruct[b].event_id_count;
+
+    memset(gen->ruletable->checks[b], 0, sizeof(gen->ruletable->checks[b]));
+    memset(gen->ruletable->rejects[b], 0, sizeof(gen->ruletable->rejects[b]));
+    gen->ruletable->samples[b] = 0;
+
+    Rule_Table_Order( b );
+
+}
+
+/****************************************************************************
+ * Rule_Table_Order - Decide the order of a rule's checks.  Cheapest first,
+ * or with "rule-ordering: adaptive",  lowest cost per rejection first.
+ * Ties keep the traditional order.
+ ****************************************************************************/
+
+void Rule_Table_Order( uint32_t b )
+{
+
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
+
+    int check[RULE_CHECK_MAX] = { 0 };
+    double key[RULE_CHECK_MAX] = { 0 };
+
+    int count = 0;
+    int i = 0;
+    int j = 0;
+
+    uint32_t checks = 0;
+    uint32_t rejects = 0;
+    uint32_t order = 0;
+
+    int tmp_check = 0;
+    double tmp_key = 0;
+
+    for ( i = 0; i < RULE_CHECK_MAX; i++ )
+        {
+
+            if ( !( gen->ruletable->stages[b] & ( 1 << i ) ) )
+                {
+                    continue;
+                }
+
+            check[count] = i;
+            key[count] = gen->ruletable->cost[b][i];
+
+            checks = __atomic_load_n(&gen->ruletable->checks[b][i], __ATOMIC_RELAXED);
+            rejects = __atomic_load_n(&gen->ruletable->rejects[b][i], __ATOMIC_RELAXED);
+
+            /* Expected cost of finding a rejection with this check */
+
+            if ( config->rule_order_adaptive == true && checks >= RULE_ORDER_MIN_SAMPLES )
+                {
+                    key[count] = key[count] * ( checks + 2 ) / ( rejects + 1 );
+                }
+
+            /* Insertion sort.  There are never more than RULE_CHECK_MAX */
+
+            for ( j = count; j > 0 && key[j] < key[j-1]; j-- )
+                {
+
+                    tmp_key = key[j];
+                    key[j] = key[j-1];
+                    key[j-1] = tmp_key;
+
+                    tmp_check = check[j];
+                    check[j] = check[j-1];
+                    check[j-1] = tmp_check;
+
+                }
+
+            count++;
+
+        }
+
+    for ( i = count - 1; i >= 0; i-- )
+        {
+            order = ( order << 4 ) | ( check[i] + 1 );
+        }
+
+    __atomic_store_n(&gen->ruletable->order[b], order, __ATOMIC_RELAXED);
+
+}
+
+/****************************************************************************
+ * Rule_Table_Sample - Record the result of one check of a sampled event
+ ****************************************************************************/
+
+void Rule_Table_Sample( uint32_t b, int check, bool passed )
+{
+
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
+
+    __atomic_add_fetch(&gen->ruletable->checks[b][check], 1, __ATOMIC_RELAXED);
+
+    if ( passed == false )
+        {
+            __atomic_add_fetch(&gen->ruletable->rejects[b][check], 1, __ATOMIC_RELAXED);
+        }
+
+}
+
+/****************************************************************************
+ * Rule_Table_Sampled - A sampled event has been checked against rule "b".
+ * Periodically re-order the rule's checks based on what has been seen.
+ ****************************************************************************/
+
+void Rule_Table_Sampled( uint32_t b )
+{
+
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
+
+    int i = 0;
+
+    if ( __atomic_add_fetch(&gen->ruletable->samples[b], 1, __ATOMIC_RELAXED) % RULE_ORDER_REFRESH != 0 )
+        {
+            return;
+        }
+
+    Rule_Table_Order( b );
+
+    /* Let older samples fade so the order follows changes in traffic */
+
+    for ( i = 0; i < RULE_CHECK_MAX; i++ )
+        {
+
+            if ( __atomic_load_n(&gen->ruletable->checks[b][i], __ATOMIC_RELAXED) > RULE_ORDER_DECAY )
+                {
+                    __atomic_store_n(&gen->ruletable->checks[b][i], gen->ruletable->checks[b][i] / 2, __ATOMIC_RELAXED);
+                    __atomic_store_n(&gen->ruletable->rejects[b][i], gen->ruletable->rejects[b][i] / 2, __ATOMIC_RELAXED);
+                }
+        }
+
+}
+
+/****************************************************************************
+ * Rule_Table_Free - Release a table once its rule generation has been
+ * retired.  See rule-generation.c
+ ****************************************************************************/
+
+void Rule_Table_Free( struct _Rule_Table *table )
+{
+
+    if ( table == NULL )
+        {
+            return;
+        }
+
+    free(table->type);
+    free(table->program_id);
+    free(table->facility_id);
+    free(table->level_id);
+    free(table->tag_id);
+    free(table->syspri_id);
+    free(table->stages);
+    free(table->flags);
+    free(table->content_count);
+    free(table->pcre_count);
+    free(table->meta_content_count);
+    free(table->json_pcre_count);
+    free(table->json_content_count);
+    free(table->json_meta_content_count);
+    free(table->event_id_count);
+    free(table->order);
+    free(table->cost);
+    free(table->checks);
+    free(table->rejects);
+    free(table->samples);
+    free(table->ip_proto);
+    free(table->direction);
+    free(table->flow_1_group);
+    free(table->port_1_group);
+    free(table->flow_2_group);
+    free(table->port_2_group);
+    free(table->header);
+    free(table);
+
+}
+
+/****************************************************************************
+ * Rule_Table_Header_Match - Does the event match a header filter?  Each
+ * filter is a "|" separated list.  "program" allows wildcards.
+ ****************************************************************************/
+
+bool Rule_Table_Header_Match( uint32_t id, struct _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL )
+{
+
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
+
+    char tmpbuf[256] = { 0 };
+    char *ptmp = NULL;
+    char *tok = NULL;
+    char *field = NULL;
+
+    struct _Rule_Header_Filter *header = &gen->ruletable->header[id];
+
+    switch ( header->type )
+        {
+
+        case RULE_HEADER_FACILITY:
+            field = SaganProcSyslog_LOCAL->syslog_facility;
+            break;
+
+        case RULE_HEADER_LEVEL:
+            field = SaganProcSyslog_LOCAL->syslog_level;
+            break;
+
+        case RULE_HEADER_TAG:
+            field = SaganProcSyslog_LOCAL->syslog_tag;
+            break;
+
+        case RULE_HEADER_SYSPRI:
+            field = SaganProcSyslog_LOCAL->syslog_priority;
+            break;
+
+        default:
+            field = SaganProcSyslog_LOCAL->syslog_program;
+            break;
+
+        }
+
+    strlcpy(tmpbuf, header->value, sizeof(tmpbuf));
+
+    ptmp = strtok_r(tmpbuf, "|", &tok);
+
+    while ( ptmp != NULL )
+        {
+
+            if ( header->type == RULE_HEADER_PROGRAM )
+                {
+
+                    if ( Wildcard(ptmp, field) == 1 )
+                        {
+                            return(true);
+                        }
+                }
+
+            else if ( !strcmp(ptmp, field) )
+                {
+                    return(true);
+                }
+
+            ptmp = strtok_r(NULL, "|", &tok);
+        }
+
+    return(false);
+
+}
+
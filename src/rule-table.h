@@ -0,0 +1,156 @@
+/*
+** Copyright (C) 2009-2020 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2020 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* Requires rules.h to be included first */
+
+/* content/pcre/etc checks.  These are listed in the order Sagan has
+   traditionally run them */
+
+#define RULE_CHECK_CONTENT		0
+#define RULE_CHECK_PCRE			1
+#define RULE_CHECK_META_CONTENT		2
+#define RULE_CHECK_JSON_PCRE		3
+#define RULE_CHECK_JSON_CONTENT		4
+#define RULE_CHECK_JSON_META_CONTENT	5
+#define RULE_CHECK_EVENT_ID		6
+
+#define RULE_CHECK_MAX			7
+
+/* Which checks a rule uses */
+
+#define RULE_STAGE_CONTENT		( 1 << RULE_CHECK_CONTENT )
+#define RULE_STAGE_PCRE			( 1 << RULE_CHECK_PCRE )
+#define RULE_STAGE_META_CONTENT		( 1 << RULE_CHECK_META_CONTENT )
+#define RULE_STAGE_JSON_PCRE		( 1 << RULE_CHECK_JSON_PCRE )
+#define RULE_STAGE_JSON_CONTENT		( 1 << RULE_CHECK_JSON_CONTENT )
+#define RULE_STAGE_JSON_META_CONTENT	( 1 << RULE_CHECK_JSON_META_CONTENT )
+#define RULE_STAGE_EVENT_ID		( 1 << RULE_CHECK_EVENT_ID )
+
+/* Estimated cost of one item (a content,  a pcre,  a meta_content string,
+   etc) for each check.  Used to order a rule's checks cheapest first. */
+
+#define RULE_COST_CONTENT		4
+#define RULE_COST_PCRE			20
+#define RULE_COST_META_CONTENT		2
+#define RULE_COST_JSON_PCRE		24
+#define RULE_COST_JSON_CONTENT		6
+#define RULE_COST_JSON_META_CONTENT	3
+#define RULE_COST_EVENT_ID		3
+
+/* "rule-ordering: adaptive" - One in RULE_ORDER_SAMPLE_RATE events (per
+   thread) runs every check of a candidate rule and records which ones
+   rejected it.  Every RULE_ORDER_REFRESH samples,  the rule's order is
+   recomputed from the observed rejection rates. */
+
+#define RULE_ORDER_SAMPLE_RATE		64		/* Must be a power of 2 */
+#define RULE_ORDER_REFRESH		256
+#define RULE_ORDER_MIN_SAMPLES		32		/* Per check,  before observed rates are trusted */
+#define RULE_ORDER_DECAY		65536		/* Halve sample counts past this */
+
+/* Rule options that change what happens after a match */
+
+#define RULE_FLAG_APPEND_PROGRAM	0x0001
+#define RULE_FLAG_NORMALIZE		0x0002
+#define RULE_FLAG_THRESHOLD		0x0004
+#define RULE_FLAG_AFTER			0x0008
+#define RULE_FLAG_XBIT			0x0010
+#define RULE_FLAG_FLEXBIT		0x0020
+#define RULE_FLAG_FLOW			0x0040
+#define RULE_FLAG_PAUSE			0x0080		/* flexbits/xbits pause or upause */
+#define RULE_FLAG_TEMPLATE_UNSAFE	0x0100		/* Checks can tell apart messages with the same template (see template-cache.c) */
+
+/* Header filter types */
+
+#define RULE_HEADER_PROGRAM		1
+#define RULE_HEADER_FACILITY		2
+#define RULE_HEADER_LEVEL		3
+#define RULE_HEADER_TAG			4
+#define RULE_HEADER_SYSPRI		5
+
+/* Unique program/facility/level/tag/priority filter.  Rules only carry the
+   ID of the filter,  so a filter shared by many rules is only evaluated once
+   per event.  ID 0 means "no filter" */
+
+typedef struct _Rule_Header_Filter _Rule_Header_Filter;
+struct _Rule_Header_Filter
+{
+    unsigned char type;
+    uint32_t hash;
+    char value[256];				/* Same size as s_program/s_tag */
+};
+
+/* "Hot" rule data.  These are the only things Sagan_Engine() looks at for
+   every rule on every event,  kept in dense parallel arrays indexed by rule
+   position.  Everything else stays in rulestruct[],  which is only looked at
+   once a rule is a candidate match. */
+
+typedef struct _Rule_Table _Rule_Table;
+struct _Rule_Table
+{
+
+    uint32_t max;				/* Entries allocated */
+
+    unsigned char *type;			/* NORMAL_RULE or DYNAMIC_RULE */
+
+    uint32_t *program_id;			/* Header filter IDs */
+    uint32_t *facility_id;
+    uint32_t *level_id;
+    uint32_t *tag_id;
+    uint32_t *syspri_id;
+
+    uint16_t *stages;				/* RULE_STAGE_* */
+    uint16_t *flags;				/* RULE_FLAG_* */
+
+    unsigned char *content_count;
+    unsigned char *pcre_count;
+    unsigned char *meta_content_count;
+    unsigned char *json_pcre_count;
+    unsigned char *json_content_count;
+    unsigned char *json_meta_content_count;
+    unsigned char *event_id_count;
+
+    uint32_t *order;				/* Check order.  4 bits per check (RULE_CHECK_* + 1),
+						   first check in the low bits,  0 terminated */
+
+    uint32_t (*cost)[RULE_CHECK_MAX];		/* Estimated cost of each check */
+    uint32_t (*checks)[RULE_CHECK_MAX];		/* rule-ordering: adaptive */
+    uint32_t (*rejects)[RULE_CHECK_MAX];
+    uint32_t *samples;
+
+    unsigned char *ip_proto;			/* Check_Flow().  Group IDs are from Flow_Group_ID() */
+    unsigned char *direction;
+    uint32_t *flow_1_group;
+    uint32_t *port_1_group;
+    uint32_t *flow_2_group;
+    uint32_t *port_2_group;
+
+    uint32_t header_count;			/* Includes the unused ID 0 */
+    uint32_t header_max;
+    struct _Rule_Header_Filter *header;
+
+};
+
+void Rule_Table_Add( uint32_t b );
+void Rule_Table_Free( struct _Rule_Table *table );
+bool Rule_Table_Header_Match( uint32_t id, struct _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL );
+void Rule_Table_Order( uint32_t b );
+void Rule_Table_Sample( uint32_t b, int check, bool passed );
+void Rule_Table_Sampled( uint32_t b );
+
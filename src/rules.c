@@ -53,6 +53,13 @@
 #include "lockfile.h"
 #include "classifications.h"
 #include "rules.h"
+#include "rule-arena.h"
+#include "rule-epoch.h"
+#include "aetas.h"
+#include "event-id.h"
+#include "json-index.h"
+#include "rule-table.h"
+#include "rule-generation.h"
 #include "sagan-config.h"
 #include "parsers/parsers.h"
 
@@ -72,11 +79,6 @@ struct _SaganConfig *config;
 
 struct _Sagan_Bluedot_Cat_List *SaganBluedotCatList;
 
-char *bluedot_time = NULL;
-char *bluedot_type = NULL;
-
-uint64_t bluedot_time_u32 = 0;
-
 #endif
 
 #ifdef HAVE_LIBLOGNORM
@@ -92,13 +94,13 @@ int liblognorm_count;
 #define PCRE_STUDY_JIT_COMPILE 0
 #endif
 
-struct _Rule_Struct *rulestruct = NULL;
 struct _Class_Struct *classstruct = NULL;
-struct _Sagan_Ruleset_Track *Ruleset_Track = NULL;
 
 void Load_Rules( const char *ruleset )
 {
 
+    struct _Rule_Generation *gen = Rule_Generation_Current();
+
     struct stat filecheck;
 
     /* This is done for stanity check */
@@ -217,6 +219,15 @@ void Load_Rules( const char *ruleset )
     json_object *metadata_jstring;
     json_object *metadata_jarray[MAX_METADATA];
 
+#endif
+
+#ifdef WITH_BLUEDOT
+
+    char *bluedot_time = NULL;
+    char *bluedot_type = NULL;
+
+    uint64_t bluedot_time_u32 = 0;
+
 #endif
 
     /* Store rule set names/path in memory for later usage dynamic loading, etc */
@@ -230,19 +241,16 @@ void Load_Rules( const char *ruleset )
 
 
 
-    Ruleset_Track = (_Sagan_Ruleset_Track *) realloc(Ruleset_Track, (counters->ruleset_track_count+1) * sizeof(_Sagan_Ruleset_Track));
+    /* Processing threads may be reading Ruleset_Track (dynamic rules),  so
+       it is copied rather than realloc()'ed.  See rule-epoch.c */
 
-    if ( Ruleset_Track == NULL )
-        {
-            Sagan_Log(ERROR, "[%s, line %d] Failed to reallocate memory for _Sagan_Ruleset_Track. Abort!", __FILE__, __LINE__);
-        }
+    Rule_Epoch_Grow(&gen->Ruleset_Track, gen->ruleset_track_count * sizeof(_Sagan_Ruleset_Track), (gen->ruleset_track_count+1) * sizeof(_Sagan_Ruleset_Track));
 
-    memset(&Ruleset_Track[counters->ruleset_track_count], 0, sizeof(struct _Sagan_Ruleset_Track));
-    memcpy(Ruleset_Track[counters->ruleset_track_count].ruleset, ruleset_fullname, sizeof(Ruleset_Track[counters->ruleset_track_count].ruleset));
+    memcpy(gen->Ruleset_Track[gen->ruleset_track_count].ruleset, ruleset_fullname, sizeof(gen->Ruleset_Track[gen->ruleset_track_count].ruleset));
 
-    ruleset_track_id = counters->ruleset_track_count;
+    ruleset_track_id = gen->ruleset_track_count;
 
-    __atomic_add_fetch(&counters->ruleset_track_count, 1, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&gen->ruleset_track_count, 1, __ATOMIC_SEQ_CST);
 
     Sagan_Log(NORMAL, "Loading %s rule file.", ruleset_fullname);
 
@@ -285,15 +293,26 @@ void Load_Rules( const char *ruleset )
             else
                 {
 
-                    /* Allocate memory for rules, but not comments */
+                    /* Allocate memory for rules, but not comments.  The array
+                       grows geometrically rather than one rule at a time.  It
+                       is copied rather than realloc()'ed as the processing
+                       threads may be using it (dynamic rules).  See rule-epoch.c */
 
-                    rulestruct = (_Rule_Struct *) realloc(rulestruct, (counters->rulecount+1) * sizeof(_Rule_Struct));
-                    if ( rulestruct == NULL )
+                    if ( gen->rulecount >= gen->rulestruct_max )
                         {
-                            Sagan_Log(ERROR, "[%s, line %d] Failed to reallocate memory for rulestruct. Abort!", __FILE__, __LINE__);
+
+                            Rule_Epoch_Grow(&gen->rulestruct, gen->rulestruct_max * sizeof(_Rule_Struct), ( gen->rulestruct_max == 0 ? 256 : gen->rulestruct_max * 2 ) * sizeof(_Rule_Struct));
+
+                            gen->rulestruct_max = gen->rulestruct_max == 0 ? 256 : gen->rulestruct_max * 2;
+
                         }
 
-                    memset(&rulestruct[counters->rulecount], 0, sizeof(struct _Rule_Struct));
+                    memset(&gen->rulestruct[gen->rulecount], 0, sizeof(struct _Rule_Struct));
+
+                    /* Variable length options are parsed into scratch space
+                       and moved to the rule arena when the rule is complete */
+
+                    Rule_Arena_Begin( &gen->rulestruct[gen->rulecount] );
 
                 }
 
@@ -425,7 +444,7 @@ void Load_Rules( const char *ruleset )
 
             /* Assigned ruleset "id" to track when rules "fire" */
 
-            rulestruct[counters->rulecount].ruleset_id = ruleset_track_id;
+            gen->rulestruct[gen->rulecount].ruleset_id = ruleset_track_id;
 
 
             /****************************************************************************/
@@ -446,13 +465,13 @@ void Load_Rules( const char *ruleset )
                             if (!strcmp(tokennet, "drop" ))
                                 {
 
-                                    rulestruct[counters->rulecount].drop = true;
+                                    gen->rulestruct[gen->rulecount].drop = true;
 
                                 }
                             else
                                 {
 
-                                    rulestruct[counters->rulecount].drop = false;
+                                    gen->rulestruct[gen->rulecount].drop = false;
 
                                 }
                         }
@@ -463,32 +482,32 @@ void Load_Rules( const char *ruleset )
                         {
                             if (!strcmp(tokennet, "any" ))
                                 {
-                                    rulestruct[counters->rulecount].ip_proto = 0;
+                                    gen->rulestruct[gen->rulecount].ip_proto = 0;
                                 }
 
                             else if (!strcmp(tokennet, "ip" ))
                                 {
-                                    rulestruct[counters->rulecount].ip_proto = 0;
+                                    gen->rulestruct[gen->rulecount].ip_proto = 0;
                                 }
 
                             else if (!strcmp(tokennet, "icmp" ))
                                 {
-                                    rulestruct[counters->rulecount].ip_proto = 1;
+                                    gen->rulestruct[gen->rulecount].ip_proto = 1;
                                 }
 
                             else if (!strcmp(tokennet, "tcp"  ))
                                 {
-                                    rulestruct[counters->rulecount].ip_proto = 6;
+                                    gen->rulestruct[gen->rulecount].ip_proto = 6;
                                 }
 
                             else if (!strcmp(tokennet, "udp"  ))
                                 {
-                                    rulestruct[counters->rulecount].ip_proto = 17;
+                                    gen->rulestruct[gen->rulecount].ip_proto = 17;
                                 }
 
                             else if (!strcmp(tokennet, "syslog"  ))
                                 {
-                                    rulestruct[counters->rulecount].ip_proto = config->sagan_proto;
+                                    gen->rulestruct[gen->rulecount].ip_proto = config->sagan_proto;
                                 }
                         }
 
@@ -512,7 +531,7 @@ void Load_Rules( const char *ruleset )
 
                             if (!strcmp(flow_a, "any")) //  || !strcmp(flow_a, tokennet))
                                 {
-                                    rulestruct[counters->rulecount].flow_1_var = 0;	  /* 0 = any */
+                                    gen->rulestruct[gen->rulecount].flow_1_var = 0;	  /* 0 = any */
 
                                 }
                             else
@@ -544,7 +563,7 @@ void Load_Rules( const char *ruleset )
 
                                             f1++;
 
-                                            is_masked = Netaddr_To_Range(tmptoken, (unsigned char *)&rulestruct[counters->rulecount].flow_1[flow_1_count].range);
+                                            is_masked = Netaddr_To_Range(tmptoken, (unsigned char *)&gen->rulestruct[gen->rulecount].flow_1[flow_1_count].range);
 
                                             if(strchr(tmptoken, '/'))
                                                 {
@@ -552,23 +571,23 @@ void Load_Rules( const char *ruleset )
                                                     if( !strncmp(tmptoken, "!", 1) || !strncmp("not", tmptoken, 3))
                                                         {
 
-                                                            rulestruct[counters->rulecount].flow_1_type[f1] = is_masked ? 0 : 2; /* 0 = not in group, 2 == IP not range */
+                                                            gen->rulestruct[gen->rulecount].flow_1_type[f1] = is_masked ? 0 : 2; /* 0 = not in group, 2 == IP not range */
                                                         }
                                                     else
                                                         {
 
-                                                            rulestruct[counters->rulecount].flow_1_type[f1] = is_masked ? 1 : 3; /* 1 = in group, 3 == IP not range */
+                                                            gen->rulestruct[gen->rulecount].flow_1_type[f1] = is_masked ? 1 : 3; /* 1 = in group, 3 == IP not range */
                                                         }
                                                 }
                                             else if( !strncmp(tmptoken, "!", 1) || !strncmp("not", tmptoken, 3))
                                                 {
 
-                                                    rulestruct[counters->rulecount].flow_1_type[f1] = 2; /* 2 = not match ip */
+                                                    gen->rulestruct[gen->rulecount].flow_1_type[f1] = 2; /* 2 = not match ip */
                                                 }
                                             else
                                                 {
 
-                                                    rulestruct[counters->rulecount].flow_1_type[f1] = 3; /* 3 = match ip */
+                                                    gen->rulestruct[gen->rulecount].flow_1_type[f1] = 3; /* 3 = match ip */
                                                 }
 
                                             flow_1_count++;
@@ -579,8 +598,8 @@ void Load_Rules( const char *ruleset )
                                                 }
                                         }
 
-                                    rulestruct[counters->rulecount].flow_1_var = 1;   /* 1 = var */
-                                    rulestruct[counters->rulecount].flow_1_counter = flow_1_count;
+                                    gen->rulestruct[gen->rulecount].flow_1_var = 1;   /* 1 = var */
+                                    gen->rulestruct[gen->rulecount].flow_1_counter = flow_1_count;
                                 }
                         }
 
@@ -590,11 +609,11 @@ void Load_Rules( const char *ruleset )
                         {
                             if (!strcmp(nettmp, "any"))
                                 {
-                                    rulestruct[counters->rulecount].port_1_var = 0;	  /* 0 = any */
+                                    gen->rulestruct[gen->rulecount].port_1_var = 0;	  /* 0 = any */
                                 }
                             else
                                 {
-                                    rulestruct[counters->rulecount].port_1_var = 1;	  /* 1 = var */
+                                    gen->rulestruct[gen->rulecount].port_1_var = 1;	  /* 1 = var */
                                     strlcpy(tmp4, nettmp, sizeof(tmp4));
 
                                     for (tmptoken = strtok_r(tmp4, ",", &saveptrport); tmptoken; tmptoken = strtok_r(NULL, ",", &saveptrport))
@@ -603,7 +622,7 @@ void Load_Rules( const char *ruleset )
                                             g1++;
                                             if (Is_Numeric(nettmp))
                                                 {
-                                                    rulestruct[counters->rulecount].port_1[port_1_count].lo = atoi(nettmp);          /* If it's a number (see Var_To_Value),  then set to that */
+                                                    gen->rulestruct[gen->rulecount].port_1[port_1_count].lo = atoi(nettmp);          /* If it's a number (see Var_To_Value),  then set to that */
                                                 }
 
                                             if (!strncmp(tmptoken,"!", 1) || !strncmp("not", tmptoken, 3))
@@ -611,16 +630,16 @@ void Load_Rules( const char *ruleset )
                                                     if(strchr(tok_help2,':'))
                                                         {
 
-                                                            rulestruct[counters->rulecount].port_1[port_1_count].lo = atoi(strtok_r(tok_help2, ":", &saveptrportrange));
-                                                            rulestruct[counters->rulecount].port_1[port_1_count].hi = atoi(strtok_r(NULL, ":", &saveptrportrange));
-                                                            rulestruct[counters->rulecount].port_1_type[g1] = 0; /* 0 = not in group */
+                                                            gen->rulestruct[gen->rulecount].port_1[port_1_count].lo = atoi(strtok_r(tok_help2, ":", &saveptrportrange));
+                                                            gen->rulestruct[gen->rulecount].port_1[port_1_count].hi = atoi(strtok_r(NULL, ":", &saveptrportrange));
+                                                            gen->rulestruct[gen->rulecount].port_1_type[g1] = 0; /* 0 = not in group */
 
                                                         }
                                                     else
                                                         {
 
-                                                            rulestruct[counters->rulecount].port_1[port_1_count].lo = atoi(tok_help2);
-                                                            rulestruct[counters->rulecount].port_1_type[g1] = 2; /* This was a single port, not a range */
+                                                            gen->rulestruct[gen->rulecount].port_1[port_1_count].lo = atoi(tok_help2);
+                                                            gen->rulestruct[gen->rulecount].port_1_type[g1] = 2; /* This was a single port, not a range */
 
                                                         }
                                                 }
@@ -629,16 +648,16 @@ void Load_Rules( const char *ruleset )
                                                     if(strchr(tok_help2, ':'))
                                                         {
 
-                                                            rulestruct[counters->rulecount].port_1[port_1_count].lo = atoi(strtok_r(tok_help2, ":", &saveptrportrange));
-                                                            rulestruct[counters->rulecount].port_1[port_1_count].hi = atoi(strtok_r(NULL, ":", &saveptrportrange));
-                                                            rulestruct[counters->rulecount].port_1_type[g1] = 1; /* 1 = in group */
+                                                            gen->rulestruct[gen->rulecount].port_1[port_1_count].lo = atoi(strtok_r(tok_help2, ":", &saveptrportrange));
+                                                            gen->rulestruct[gen->rulecount].port_1[port_1_count].hi = atoi(strtok_r(NULL, ":", &saveptrportrange));
+                                                            gen->rulestruct[gen->rulecount].port_1_type[g1] = 1; /* 1 = in group */
 
                                                         }
                                                     else
                                                         {
 
-                                                            rulestruct[counters->rulecount].port_1[port_1_count].lo = atoi(tok_help2);
-                                                            rulestruct[counters->rulecount].port_1_type[g1] = 3; /* This was a single port, not a range */
+                                                            gen->rulestruct[gen->rulecount].port_1[port_1_count].lo = atoi(tok_help2);
+                                                            gen->rulestruct[gen->rulecount].port_1_type[g1] = 3; /* This was a single port, not a range */
 
                                                         }
 
@@ -651,7 +670,7 @@ void Load_Rules( const char *ruleset )
                                                 }
 
                                         }
-                                    rulestruct[counters->rulecount].port_1_counter = port_1_count;
+                                    gen->rulestruct[gen->rulecount].port_1_counter = port_1_count;
                                 }
 
                         }
@@ -678,7 +697,7 @@ void Load_Rules( const char *ruleset )
                                 {
                                     d = 0;  /* 0 = any */
                                 }
-                            rulestruct[counters->rulecount].direction = d;
+                            gen->rulestruct[gen->rulecount].direction = d;
                         }
 
                     /* Second flow */
@@ -698,7 +717,7 @@ void Load_Rules( const char *ruleset )
 
                             if (!strcmp(flow_b, "any")) //  || !strcmp(flow_b, tokennet))
                                 {
-                                    rulestruct[counters->rulecount].flow_2_var = 0;     /* 0 = any */
+                                    gen->rulestruct[gen->rulecount].flow_2_var = 0;     /* 0 = any */
 
                                 }
                             else
@@ -730,26 +749,26 @@ void Load_Rules( const char *ruleset )
 
                                             f2++;
 
-                                            is_masked = Netaddr_To_Range(tmptoken, (unsigned char *)&rulestruct[counters->rulecount].flow_2[flow_2_count].range);
+                                            is_masked = Netaddr_To_Range(tmptoken, (unsigned char *)&gen->rulestruct[gen->rulecount].flow_2[flow_2_count].range);
 
                                             if(strchr(tmptoken, '/'))
                                                 {
                                                     if( !strncmp(tmptoken, "!", 1) || !strncmp("not", tmptoken, 3))
                                                         {
-                                                            rulestruct[counters->rulecount].flow_2_type[f2] = is_masked ? 0 : 2; /* 0 = not in group, 2 == IP not range */
+                                                            gen->rulestruct[gen->rulecount].flow_2_type[f2] = is_masked ? 0 : 2; /* 0 = not in group, 2 == IP not range */
                                                         }
                                                     else
                                                         {
-                                                            rulestruct[counters->rulecount].flow_2_type[f2] = is_masked ? 1 : 3; /* 1 = in group, 3 == IP not range */
+                                                            gen->rulestruct[gen->rulecount].flow_2_type[f2] = is_masked ? 1 : 3; /* 1 = in group, 3 == IP not range */
                                                         }
                                                 }
                                             else if( !strncmp(tmptoken, "!", 1) || !strncmp("not", tmptoken, 3))
                                                 {
-                                                    rulestruct[counters->rulecount].flow_2_type[f2] = 2; /* 2 = not match ip */
+                                                    gen->rulestruct[gen->rulecount].flow_2_type[f2] = 2; /* 2 = not match ip */
                                                 }
                                             else
                                                 {
-                                                    rulestruct[counters->rulecount].flow_2_type[f2] = 3; /* 3 = match ip */
+                                                    gen->rulestruct[gen->rulecount].flow_2_type[f2] = 3; /* 3 = match ip */
                                                 }
 
                                             flow_2_count++;
@@ -760,8 +779,8 @@ void Load_Rules( const char *ruleset )
                                                 }
                                         }
 
-                                    rulestruct[counters->rulecount].flow_2_var = 1;   /* 1 = var */
-                                    rulestruct[counters->rulecount].flow_2_counter = flow_2_count;
+                                    gen->rulestruct[gen->rulecount].flow_2_var = 1;   /* 1 = var */
+                                    gen->rulestruct[gen->rulecount].flow_2_counter = flow_2_count;
                                 }
                         }
 
@@ -771,11 +790,11 @@ void Load_Rules( const char *ruleset )
                         {
                             if (!strcmp(nettmp, "any"))
                                 {
-                                    rulestruct[counters->rulecount].port_2_var = 0;	  /* 0 = any */
+                                    gen->rulestruct[gen->rulecount].port_2_var = 0;	  /* 0 = any */
                                 }
                             else
                                 {
-                                    rulestruct[counters->rulecount].port_2_var = 1;	  /* 1 = var */
+                                    gen->rulestruct[gen->rulecount].port_2_var = 1;	  /* 1 = var */
                                     strlcpy(tmp4, nettmp, sizeof(tmp4));
 
                                     for (tmptoken = strtok_r(tmp4, ",", &saveptrport); tmptoken; tmptoken = strtok_r(NULL, ",", &saveptrport))
@@ -784,7 +803,7 @@ void Load_Rules( const char *ruleset )
                                             g2++;
                                             if (Is_Numeric(nettmp))
                                                 {
-                                                    rulestruct[counters->rulecount].port_2[port_2_count].lo = atoi(nettmp);          /* If it's a number (see Var_To_Value),  then set to that */
+                                                    gen->rulestruct[gen->rulecount].port_2[port_2_count].lo = atoi(nettmp);          /* If it's a number (see Var_To_Value),  then set to that */
                                                 }
 
                                             if (!strncmp(tmptoken,"!", 1) || !strncmp("not", tmptoken, 3))
@@ -792,16 +811,16 @@ void Load_Rules( const char *ruleset )
                                                     if(strchr(tok_help2,':'))
                                                         {
 
-                                                            rulestruct[counters->rulecount].port_2[port_2_count].lo = atoi(strtok_r(tok_help2, ":", &saveptrportrange));
-                                                            rulestruct[counters->rulecount].port_2[port_2_count].hi = atoi(strtok_r(NULL, ":", &saveptrportrange));
-                                                            rulestruct[counters->rulecount].port_2_type[g2] = 0; /* 0 = not in group */
+                                                            gen->rulestruct[gen->rulecount].port_2[port_2_count].lo = atoi(strtok_r(tok_help2, ":", &saveptrportrange));
+                                                            gen->rulestruct[gen->rulecount].port_2[port_2_count].hi = atoi(strtok_r(NULL, ":", &saveptrportrange));
+                                                            gen->rulestruct[gen->rulecount].port_2_type[g2] = 0; /* 0 = not in group */
 
                                                         }
                                                     else
                                                         {
 
-                                                            rulestruct[counters->rulecount].port_2[port_2_count].lo = atoi(tok_help2);
-                                                            rulestruct[counters->rulecount].port_2_type[g2] = 2; /* This was a single port, not a range */
+                                                            gen->rulestruct[gen->rulecount].port_2[port_2_count].lo = atoi(tok_help2);
+                                                            gen->rulestruct[gen->rulecount].port_2_type[g2] = 2; /* This was a single port, not a range */
 
                                                         }
                                                 }
@@ -810,16 +829,16 @@ void Load_Rules( const char *ruleset )
                                                     if(strchr(tok_help2, ':'))
                                                         {
 
-                                                            rulestruct[counters->rulecount].port_2[port_2_count].lo = atoi(strtok_r(tok_help2, ":", &saveptrportrange));
-                                                            rulestruct[counters->rulecount].port_2[port_2_count].hi = atoi(strtok_r(NULL, ":", &saveptrportrange));
-                                                            rulestruct[counters->rulecount].port_2_type[g2] = 1; /* 1 = in group */
+                                                            gen->rulestruct[gen->rulecount].port_2[port_2_count].lo = atoi(strtok_r(tok_help2, ":", &saveptrportrange));
+                                                            gen->rulestruct[gen->rulecount].port_2[port_2_count].hi = atoi(strtok_r(NULL, ":", &saveptrportrange));
+                                                            gen->rulestruct[gen->rulecount].port_2_type[g2] = 1; /* 1 = in group */
 
                                                         }
                                                     else
                                                         {
 
-                                                            rulestruct[counters->rulecount].port_2[port_2_count].lo = atoi(tok_help2);
-                                                            rulestruct[counters->rulecount].port_2_type[g2] = 3; /* This was a single port, not a range */
+                                                            gen->rulestruct[gen->rulecount].port_2[port_2_count].lo = atoi(tok_help2);
+                                                            gen->rulestruct[gen->rulecount].port_2_type[g2] = 3; /* This was a single port, not a range */
 
                                                         }
 
@@ -832,7 +851,7 @@ void Load_Rules( const char *ruleset )
                                                 }
 
                                         }
-                                    rulestruct[counters->rulecount].port_2_counter = port_2_count;
+                                    gen->rulestruct[gen->rulecount].port_2_counter = port_2_count;
                                 }
 
                         }
@@ -840,9 +859,9 @@ void Load_Rules( const char *ruleset )
                     /* Used later for a single check to determine if a rule has a flow or not
                         - Champ Clark III (06/12/2016) */
 
-                    if ( rulestruct[counters->rulecount].ip_proto != 0 || rulestruct[counters->rulecount].flow_1_var != 0 || rulestruct[counters->rulecount].port_1_var != 0 || rulestruct[counters->rulecount].flow_2_var != 0 || rulestruct[counters->rulecount].port_2_var != 0 )
+                    if ( gen->rulestruct[gen->rulecount].ip_proto != 0 || gen->rulestruct[gen->rulecount].flow_1_var != 0 || gen->rulestruct[gen->rulecount].port_1_var != 0 || gen->rulestruct[gen->rulecount].flow_2_var != 0 || gen->rulestruct[gen->rulecount].port_2_var != 0 )
                         {
-                            rulestruct[counters->rulecount].has_flow = 1;
+                            gen->rulestruct[gen->rulecount].has_flow = 1;
                         }
 
                     tokennet = strtok_r(NULL, " ", &saveptrnet);
@@ -858,9 +877,9 @@ void Load_Rules( const char *ruleset )
 
             /* Set some defaults outside the option parsing */
 
-            rulestruct[counters->rulecount].default_proto = config->sagan_proto;
-            rulestruct[counters->rulecount].default_src_port = config->sagan_port;
-            rulestruct[counters->rulecount].default_dst_port = config->sagan_port;
+            gen->rulestruct[gen->rulecount].default_proto = config->sagan_proto;
+            gen->rulestruct[gen->rulecount].default_src_port = config->sagan_port;
+            gen->rulestruct[gen->rulecount].default_dst_port = config->sagan_port;
 
             tokenrule = strtok_r(rulestring, ";", &saveptrrule1);
 
@@ -875,25 +894,25 @@ void Load_Rules( const char *ruleset )
                     if (!strcmp(rulesplit, "parse_port"))
                         {
                             strtok_r(NULL, ":", &saveptrrule2);
-                            rulestruct[counters->rulecount].s_find_port = true;
+                            gen->rulestruct[gen->rulecount].s_find_port = true;
                         }
 
                     if (!strcmp(rulesplit, "parse_proto"))
                         {
                             strtok_r(NULL, ":", &saveptrrule2);
-                            rulestruct[counters->rulecount].s_find_proto = true;
+                            gen->rulestruct[gen->rulecount].s_find_proto = true;
                         }
 
                     if (!strcmp(rulesplit, "parse_proto_program"))
                         {
                             strtok_r(NULL, ":", &saveptrrule2);
-                            rulestruct[counters->rulecount].s_find_proto_program = true;
+                            gen->rulestruct[gen->rulecount].s_find_proto_program = true;
                         }
 
                     if (!strcmp(rulesplit, "append_program"))
                         {
                             strtok_r(NULL, ":", &saveptrrule2);
-                            rulestruct[counters->rulecount].append_program = true;
+                            gen->rulestruct[gen->rulecount].append_program = true;
                         }
 
                     if (!strcmp(rulesplit, "flexbits_upause"))
@@ -905,7 +924,7 @@ void Load_Rules( const char *ruleset )
                                     Sagan_Log(ERROR, "[%s, line %d] The \"flexbit_upause\" option appears to be incomplete at line %d in %s, Abort", __FILE__, __LINE__, linecount, ruleset_fullname);
                                 }
 
-                            rulestruct[counters->rulecount].flexbit_upause_time = atoi(arg);
+                            gen->rulestruct[gen->rulecount].flexbit_upause_time = atoi(arg);
                         }
 
                     if (!strcmp(rulesplit, "xbits_upause"))
@@ -917,7 +936,7 @@ void Load_Rules( const char *ruleset )
                                     Sagan_Log(ERROR, "[%s, line %d] The \"xbit_upause\" option appears to be incomplete at line %d in %s, Abort", __FILE__, __LINE__, linecount, ruleset_fullname);
                                 }
 
-                            rulestruct[counters->rulecount].xbit_upause_time = atoi(arg);
+                            gen->rulestruct[gen->rulecount].xbit_upause_time = atoi(arg);
                         }
 
                     if (!strcmp(rulesplit, "flexbits_pause"))
@@ -929,7 +948,7 @@ void Load_Rules( const char *ruleset )
                                     Sagan_Log(ERROR, "[%s, line %d] The \"flexbits_pause\" option appears to be incomplete at line %d in %s, Abort", __FILE__, __LINE__, linecount, ruleset_fullname);
                                 }
 
-                            rulestruct[counters->rulecount].flexbit_pause_time = atoi(arg);
+                            gen->rulestruct[gen->rulecount].flexbit_pause_time = atoi(arg);
                         }
 
                     if (!strcmp(rulesplit, "xbits_pause"))
@@ -941,7 +960,7 @@ void Load_Rules( const char *ruleset )
                                     Sagan_Log(ERROR, "[%s, line %d] The \"xbit_pause\" option appears to be incomplete at line %d in %s, Abort", __FILE__, __LINE__, linecount, ruleset_fullname);
                                 }
 
-                            rulestruct[counters->rulecount].xbit_pause_time = atoi(arg);
+                            gen->rulestruct[gen->rulecount].xbit_pause_time = atoi(arg);
                         }
 
 
@@ -960,17 +979,17 @@ void Load_Rules( const char *ruleset )
 
                             if (!strcmp(tmp1, "icmp") || !strcmp(tmp1, "1"))
                                 {
-                                    rulestruct[counters->rulecount].default_proto = 1;
+                                    gen->rulestruct[gen->rulecount].default_proto = 1;
                                 }
 
                             else if (!strcmp(tmp1, "tcp" ) || !strcmp(tmp1, "6" ))
                                 {
-                                    rulestruct[counters->rulecount].default_proto = 6;
+                                    gen->rulestruct[gen->rulecount].default_proto = 6;
                                 }
 
                             else if (!strcmp(tmp1, "udp" ) || !strcmp(tmp1, "17" ))
                                 {
-                                    rulestruct[counters->rulecount].default_proto = 17;
+                                    gen->rulestruct[gen->rulecount].default_proto = 17;
                                 }
 
                         }
@@ -988,7 +1007,7 @@ void Load_Rules( const char *ruleset )
                             Var_To_Value(arg, tmp1, sizeof(tmp1));
                             Remove_Spaces(tmp1);
 
-                            rulestruct[counters->rulecount].default_src_port = atoi(tmp1);
+                            gen->rulestruct[gen->rulecount].default_src_port = atoi(tmp1);
 
                         }
 
@@ -1006,7 +1025,7 @@ void Load_Rules( const char *ruleset )
                             Remove_Spaces(tmp1);
 
 
-                            rulestruct[counters->rulecount].default_dst_port = atoi(tmp1);
+                            gen->rulestruct[gen->rulecount].default_dst_port = atoi(tmp1);
 
                         }
 
@@ -1014,28 +1033,28 @@ void Load_Rules( const char *ruleset )
                         {
 
                             arg = strtok_r(NULL, ":", &saveptrrule2);
-                            rulestruct[counters->rulecount].s_find_src_ip = true;
+                            gen->rulestruct[gen->rulecount].s_find_src_ip = true;
 
                             if ( arg == NULL )
                                 {
                                     Sagan_Log(ERROR, "[%s, line %d] The \"parse_src_ip\" option appears to be incomplete at line %d in %s, Abort", __FILE__, __LINE__, linecount, ruleset_fullname);
                                 }
 
-                            rulestruct[counters->rulecount].s_find_src_pos = atoi(arg);
+                            gen->rulestruct[gen->rulecount].s_find_src_pos = atoi(arg);
                         }
 
                     if (!strcmp(rulesplit, "parse_dst_ip"))
                         {
 
                             arg = strtok_r(NULL, ":", &saveptrrule2);
-                            rulestruct[counters->rulecount].s_find_dst_ip = 1;
+                            gen->rulestruct[gen->rulecount].s_find_dst_ip = 1;
 
                             if ( arg == NULL )
                                 {
                                     Sagan_Log(ERROR, "[%s, line %d] The \"parse_dst_ip\" option appears to be incomplete at line %d in %s, Abort", __FILE__, __LINE__, linecount, ruleset_fullname);
                                 }
 
-                            rulestruct[counters->rulecount].s_find_dst_pos = atoi(arg);
+                            gen->rulestruct[gen->rulecount].s_find_dst_pos = atoi(arg);
                         }
 
                     if (!strcmp(rulesplit, "parse_hash"))
@@ -1052,26 +1071,26 @@ void Load_Rules( const char *ruleset )
 
                             if (!strcmp(arg, "md5"))
                                 {
-                                    rulestruct[counters->rulecount].s_find_hash_type = PARSE_HASH_MD5;
+                                    gen->rulestruct[gen->rulecount].s_find_hash_type = PARSE_HASH_MD5;
                                 }
 
                             else if (!strcmp(arg, "sha1"))
                                 {
-                                    rulestruct[counters->rulecount].s_find_hash_type = PARSE_HASH_SHA1;
+                                    gen->rulestruct[gen->rulecount].s_find_hash_type = PARSE_HASH_SHA1;
                                 }
 
                             else if (!strcmp(arg, "sha256"))
                                 {
-                                    rulestruct[counters->rulecount].s_find_hash_type = PARSE_HASH_SHA256;
+                                    gen->rulestruct[gen->rulecount].s_find_hash_type = PARSE_HASH_SHA256;
                                 }
                             /*
                                                         else if (!strcmp(arg, "all"))
                                                             {
-                                                                rulestruct[counters->rulecount].s_find_hash_type = PARSE_HASH_ALL;
+                                                                gen->rulestruct[gen->rulecount].s_find_hash_type = PARSE_HASH_ALL;
                                                             }
                             */
 
-                            if ( rulestruct[counters->rulecount].s_find_hash_type == 0 )
+                            if ( gen->rulestruct[gen->rulecount].s_find_hash_type == 0 )
                                 {
                                     Sagan_Log(ERROR, "[%s, line %d] The \"parse_hash\" option appears to be invalid at line %d in %s. Valid values are 'md5', 'sha1' and 'sha256', Abort.", __FILE__, __LINE__, linecount, ruleset_fullname);
                                 }
@@ -1098,13 +1117,13 @@ void Load_Rules( const char *ruleset )
 
                             if ( !strcmp(arg, "noeve") )
                                 {
-                                    rulestruct[counters->rulecount].xbit_noeve=true;
+                                    gen->rulestruct[gen->rulecount].xbit_noeve=true;
                                     xbit_single = true;
                                 }
 
                             if ( !strcmp(arg, "noalert") )
                                 {
-                                    rulestruct[counters->rulecount].xbit_noalert=true;
+                                    gen->rulestruct[gen->rulecount].xbit_noalert=true;
                                     xbit_single = true;
                                 }
 
@@ -1131,32 +1150,32 @@ void Load_Rules( const char *ruleset )
                                         }
 
 
-                                    rulestruct[counters->rulecount].xbit_flag = true;
+                                    gen->rulestruct[gen->rulecount].xbit_flag = true;
 
                                     if (!strcmp(tmptoken, "set") )
                                         {
 
-                                            rulestruct[counters->rulecount].xbit_type[xbit_count]  = 1;   /* set */
-                                            rulestruct[counters->rulecount].xbit_set_count++;
+                                            gen->rulestruct[gen->rulecount].xbit_type[xbit_count]  = 1;   /* set */
+                                            gen->rulestruct[gen->rulecount].xbit_set_count++;
                                             __atomic_add_fetch(&counters->xbit_total_counter, 1, __ATOMIC_SEQ_CST);
                                         }
 
                                     else if (!strcmp(tmptoken, "unset") )
                                         {
-                                            rulestruct[counters->rulecount].xbit_type[xbit_count]  = 2;   /* unset */
-                                            rulestruct[counters->rulecount].xbit_unset_count++;
+                                            gen->rulestruct[gen->rulecount].xbit_type[xbit_count]  = 2;   /* unset */
+                                            gen->rulestruct[gen->rulecount].xbit_unset_count++;
                                         }
 
                                     else if (!strcmp(tmptoken, "isset") )
                                         {
-                                            rulestruct[counters->rulecount].xbit_type[xbit_count]  = 3;   /* isset */
-                                            rulestruct[counters->rulecount].xbit_isset_count++;
+                                            gen->rulestruct[gen->rulecount].xbit_type[xbit_count]  = 3;   /* isset */
+                                            gen->rulestruct[gen->rulecount].xbit_isset_count++;
                                         }
 
                                     else if (!strcmp(tmptoken, "isnotset") )
                                         {
-                                            rulestruct[counters->rulecount].xbit_type[xbit_count]  = 4;   /* isnotset */
-                                            rulestruct[counters->rulecount].xbit_isnotset_count++;
+                                            gen->rulestruct[gen->rulecount].xbit_type[xbit_count]  = 4;   /* isnotset */
+                                            gen->rulestruct[gen->rulecount].xbit_isnotset_count++;
                                         }
 
 
@@ -1173,13 +1192,13 @@ void Load_Rules( const char *ruleset )
 
                                                                         else if (!strcmp(tmptoken, "toggle") )
                                                                             {
-                                                                                rulestruct[counters->rulecount].xbit_type[xbit_count]  = 5;
-                                    					    rulestruct[counters->rulecount].xbit_toggle_count++;
+                                                                                gen->rulestruct[gen->rulecount].xbit_type[xbit_count]  = 5;
+                                    					    gen->rulestruct[gen->rulecount].xbit_toggle_count++;
 
                                                                             }
                                     */
 
-                                    if ( rulestruct[counters->rulecount].xbit_type[xbit_count] == 0 )
+                                    if ( gen->rulestruct[gen->rulecount].xbit_type[xbit_count] == 0 )
                                         {
                                             Sagan_Log(ERROR, "[%s, line %d] Xbit is not 'set', 'unset', 'isset', 'isnotset' or 'toggle'. Abort at line %d in %s", __FILE__, __LINE__, linecount, ruleset);
                                         }
@@ -1193,9 +1212,9 @@ void Load_Rules( const char *ruleset )
 
                                     Remove_Spaces(tmptoken);
 
-                                    strlcpy(rulestruct[counters->rulecount].xbit_name[xbit_count], tmptoken, sizeof(rulestruct[counters->rulecount].xbit_name[xbit_count]));
+                                    strlcpy(gen->rulestruct[gen->rulecount].xbit_name[xbit_count], tmptoken, sizeof(gen->rulestruct[gen->rulecount].xbit_name[xbit_count]));
 
-                                    rulestruct[counters->rulecount].xbit_name_hash[xbit_count] = Djb2_Hash(tmptoken);
+                                    gen->rulestruct[gen->rulecount].xbit_name_hash[xbit_count] = Djb2_Hash(tmptoken);
 
                                     tmptoken = strtok_r(NULL, ",", &saveptrrule2);
 
@@ -1217,24 +1236,24 @@ void Load_Rules( const char *ruleset )
                                             tmptoken[8] == 's' && tmptoken[9] == 'r' && tmptoken[10] == 'c' )
                                         {
 
-                                            rulestruct[counters->rulecount].xbit_direction[xbit_count] = 1; /* ip_src */
+                                            gen->rulestruct[gen->rulecount].xbit_direction[xbit_count] = 1; /* ip_src */
                                         }
 
                                     else if ( strlen(tmptoken) == 11 && tmptoken[5] == 'i' && tmptoken[6] == 'p' && tmptoken[7] == '_' &&
                                               tmptoken[8] == 'd' && tmptoken[9] == 's' && tmptoken[10] == 't' )
                                         {
 
-                                            rulestruct[counters->rulecount].xbit_direction[xbit_count] = 2; /* ip_dst */
+                                            gen->rulestruct[gen->rulecount].xbit_direction[xbit_count] = 2; /* ip_dst */
                                         }
 
                                     else if ( strlen(tmptoken) == 12 && tmptoken[5] == 'i' && tmptoken[6] == 'p' && tmptoken[7] == '_' &&
                                               tmptoken[8] == 'p' && tmptoken[9] == 'a' && tmptoken[10] == 'i' && tmptoken[11] == 'r' )
                                         {
 
-                                            rulestruct[counters->rulecount].xbit_direction[xbit_count] = 3; /* ip_pair */
+                                            gen->rulestruct[gen->rulecount].xbit_direction[xbit_count] = 3; /* ip_pair */
                                         }
 
-                                    if ( rulestruct[counters->rulecount].xbit_direction[xbit_count] == 0 )
+                                    if ( gen->rulestruct[gen->rulecount].xbit_direction[xbit_count] == 0 )
                                         {
                                             Sagan_Log(ERROR, "[%s, line %d] Expected track by 'ip_src', 'ip_dst', or 'ip_pair'. Aborting at line %d in file %s.", __FILE__, __LINE__, linecount, ruleset);
                                         }
@@ -1242,7 +1261,7 @@ void Load_Rules( const char *ruleset )
 
                                     /* If we're in a 'set', we'll need expire time */
 
-                                    if ( rulestruct[counters->rulecount].xbit_type[xbit_count] == 1 )
+                                    if ( gen->rulestruct[gen->rulecount].xbit_type[xbit_count] == 1 )
                                         {
 
                                             tmptoken = strtok_r(NULL, ",", &saveptrrule2);
@@ -1276,9 +1295,9 @@ void Load_Rules( const char *ruleset )
                                                     strlcat(tmp2, tmp, sizeof(tmp2));
                                                 }
 
-                                            rulestruct[counters->rulecount].xbit_expire[xbit_count] = atol(tmp2);
+                                            gen->rulestruct[gen->rulecount].xbit_expire[xbit_count] = atol(tmp2);
 
-                                            if ( rulestruct[counters->rulecount].xbit_direction[xbit_count] == 0 )
+                                            if ( gen->rulestruct[gen->rulecount].xbit_direction[xbit_count] == 0 )
                                                 {
                                                     Sagan_Log(ERROR, "[%s, line %d] xbit expire time is invalid at %d in file %s. Abort", __FILE__, __LINE__, linecount, ruleset);
                                                 }
@@ -1287,7 +1306,7 @@ void Load_Rules( const char *ruleset )
                                         }
 
                                     xbit_count++;
-                                    rulestruct[counters->rulecount].xbit_count = xbit_count;
+                                    gen->rulestruct[gen->rulecount].xbit_count = xbit_count;
                                 }
 
                         }
@@ -1321,12 +1340,12 @@ void Load_Rules( const char *ruleset )
 
                             if (!strcmp(tmptoken, "noalert"))
                                 {
-                                    rulestruct[counters->rulecount].flexbit_noalert=true;
+                                    gen->rulestruct[gen->rulecount].flexbit_noalert=true;
                                 }
 
                             if (!strcmp(tmptoken, "noeve"))
                                 {
-                                    rulestruct[counters->rulecount].flexbit_noeve=true;
+                                    gen->rulestruct[gen->rulecount].flexbit_noeve=true;
                                 }
 
 
@@ -1344,15 +1363,15 @@ void Load_Rules( const char *ruleset )
 
                                     Remove_Spaces(tmptoken);
 
-                                    rulestruct[counters->rulecount].flexbit_flag = 1; 				/* We have flexbit in the rule! */
-                                    rulestruct[counters->rulecount].flexbit_set_count++;
-                                    rulestruct[counters->rulecount].flexbit_type[flexbit_count]  = 1;		/* set */
+                                    gen->rulestruct[gen->rulecount].flexbit_flag = 1; 				/* We have flexbit in the rule! */
+                                    gen->rulestruct[gen->rulecount].flexbit_set_count++;
+                                    gen->rulestruct[gen->rulecount].flexbit_type[flexbit_count]  = 1;		/* set */
 
-                                    strlcpy(rulestruct[counters->rulecount].flexbit_name[flexbit_count], tmptoken, sizeof(rulestruct[counters->rulecount].flexbit_name[flexbit_count]));
+                                    strlcpy(gen->rulestruct[gen->rulecount].flexbit_name[flexbit_count], tmptoken, sizeof(gen->rulestruct[gen->rulecount].flexbit_name[flexbit_count]));
 
-                                    rulestruct[counters->rulecount].flexbit_timeout[flexbit_count] = atoi(strtok_r(NULL, ",", &saveptrrule2));
+                                    gen->rulestruct[gen->rulecount].flexbit_timeout[flexbit_count] = atoi(strtok_r(NULL, ",", &saveptrrule2));
 
-                                    if ( rulestruct[counters->rulecount].flexbit_timeout[flexbit_count] == 0 )
+                                    if ( gen->rulestruct[gen->rulecount].flexbit_timeout[flexbit_count] == 0 )
                                         {
                                             Sagan_Log(ERROR, "[%s, line %d] Expected flexbit valid expire time for \"set\" at line %d in %s, Abort", __FILE__, __LINE__, linecount, ruleset_fullname);
                                         }
@@ -1376,11 +1395,11 @@ void Load_Rules( const char *ruleset )
 
                                     Remove_Spaces(tmptoken);
 
-                                    rulestruct[counters->rulecount].flexbit_direction[flexbit_count] = Flexbit_Type(tmptoken, linecount, ruleset_fullname);
+                                    gen->rulestruct[gen->rulecount].flexbit_direction[flexbit_count] = Flexbit_Type(tmptoken, linecount, ruleset_fullname);
 
-                                    rulestruct[counters->rulecount].flexbit_flag = 1;               			/* We have flexbit in the rule! */
-                                    rulestruct[counters->rulecount].flexbit_set_count++;
-                                    rulestruct[counters->rulecount].flexbit_type[flexbit_count]  = 2;                	/* unset */
+                                    gen->rulestruct[gen->rulecount].flexbit_flag = 1;               			/* We have flexbit in the rule! */
+                                    gen->rulestruct[gen->rulecount].flexbit_set_count++;
+                                    gen->rulestruct[gen->rulecount].flexbit_type[flexbit_count]  = 2;                	/* unset */
 
                                     tmptoken = strtok_r(NULL, ",", &saveptrrule2);
 
@@ -1391,7 +1410,7 @@ void Load_Rules( const char *ruleset )
 
                                     Remove_Spaces(tmptoken);
 
-                                    strlcpy(rulestruct[counters->rulecount].flexbit_name[flexbit_count], tmptoken, sizeof(rulestruct[counters->rulecount].flexbit_name[flexbit_count]));
+                                    strlcpy(gen->rulestruct[gen->rulecount].flexbit_name[flexbit_count], tmptoken, sizeof(gen->rulestruct[gen->rulecount].flexbit_name[flexbit_count]));
 
                                     flexbit_count++;
 
@@ -1411,10 +1430,10 @@ void Load_Rules( const char *ruleset )
 
                                     Remove_Spaces(tmptoken);
 
-                                    rulestruct[counters->rulecount].flexbit_direction[flexbit_count] = Flexbit_Type(tmptoken, linecount, ruleset_fullname);
+                                    gen->rulestruct[gen->rulecount].flexbit_direction[flexbit_count] = Flexbit_Type(tmptoken, linecount, ruleset_fullname);
 
-                                    rulestruct[counters->rulecount].flexbit_flag = 1;               			/* We have flexbit in the rule! */
-                                    rulestruct[counters->rulecount].flexbit_type[flexbit_count]  = 3;               	/* isset */
+                                    gen->rulestruct[gen->rulecount].flexbit_flag = 1;               			/* We have flexbit in the rule! */
+                                    gen->rulestruct[gen->rulecount].flexbit_type[flexbit_count]  = 3;               	/* isset */
 
                                     tmptoken = strtok_r(NULL, ",", &saveptrrule2);
 
@@ -1425,9 +1444,9 @@ void Load_Rules( const char *ruleset )
 
                                     Remove_Spaces(tmptoken);
 
-                                    strlcpy(rulestruct[counters->rulecount].flexbit_name[flexbit_count], tmptoken, sizeof(rulestruct[counters->rulecount].flexbit_name[flexbit_count]));
+                                    strlcpy(gen->rulestruct[gen->rulecount].flexbit_name[flexbit_count], tmptoken, sizeof(gen->rulestruct[gen->rulecount].flexbit_name[flexbit_count]));
 
-                                    rulestruct[counters->rulecount].flexbit_condition_count++;
+                                    gen->rulestruct[gen->rulecount].flexbit_condition_count++;
                                     flexbit_count++;
 
                                 }
@@ -1446,10 +1465,10 @@ void Load_Rules( const char *ruleset )
 
                                     Remove_Spaces(tmptoken);
 
-                                    rulestruct[counters->rulecount].flexbit_direction[flexbit_count] = Flexbit_Type(tmptoken, linecount, ruleset_fullname);
+                                    gen->rulestruct[gen->rulecount].flexbit_direction[flexbit_count] = Flexbit_Type(tmptoken, linecount, ruleset_fullname);
 
-                                    rulestruct[counters->rulecount].flexbit_flag = 1;                               	/* We have flexbit in the rule! */
-                                    rulestruct[counters->rulecount].flexbit_type[flexbit_count]  = 4;               	/* isnotset */
+                                    gen->rulestruct[gen->rulecount].flexbit_flag = 1;                               	/* We have flexbit in the rule! */
+                                    gen->rulestruct[gen->rulecount].flexbit_type[flexbit_count]  = 4;               	/* isnotset */
 
                                     tmptoken = strtok_r(NULL, ",", &saveptrrule2);
 
@@ -1460,9 +1479,9 @@ void Load_Rules( const char *ruleset )
 
                                     Remove_Spaces(tmptoken);
 
-                                    strlcpy(rulestruct[counters->rulecount].flexbit_name[flexbit_count], tmptoken, sizeof(rulestruct[counters->rulecount].flexbit_name[flexbit_count]));
+                                    strlcpy(gen->rulestruct[gen->rulecount].flexbit_name[flexbit_count], tmptoken, sizeof(gen->rulestruct[gen->rulecount].flexbit_name[flexbit_count]));
 
-                                    rulestruct[counters->rulecount].flexbit_condition_count++;
+                                    gen->rulestruct[gen->rulecount].flexbit_condition_count++;
                                     flexbit_count++;
 
                                 }
@@ -1481,15 +1500,15 @@ void Load_Rules( const char *ruleset )
 
                                     Remove_Spaces(tmptoken);
 
-                                    rulestruct[counters->rulecount].flexbit_flag = 1; 				/* We have flexbit in the rule! */
-                                    rulestruct[counters->rulecount].flexbit_set_count++;
-                                    rulestruct[counters->rulecount].flexbit_type[flexbit_count]  = 5;		/* set_srcport */
+                                    gen->rulestruct[gen->rulecount].flexbit_flag = 1; 				/* We have flexbit in the rule! */
+                                    gen->rulestruct[gen->rulecount].flexbit_set_count++;
+                                    gen->rulestruct[gen->rulecount].flexbit_type[flexbit_count]  = 5;		/* set_srcport */
 
-                                    strlcpy(rulestruct[counters->rulecount].flexbit_name[flexbit_count], tmptoken, sizeof(rulestruct[counters->rulecount].flexbit_name[flexbit_count]));
+                                    strlcpy(gen->rulestruct[gen->rulecount].flexbit_name[flexbit_count], tmptoken, sizeof(gen->rulestruct[gen->rulecount].flexbit_name[flexbit_count]));
 
-                                    rulestruct[counters->rulecount].flexbit_timeout[flexbit_count] = atoi(strtok_r(NULL, ",", &saveptrrule2));
+                                    gen->rulestruct[gen->rulecount].flexbit_timeout[flexbit_count] = atoi(strtok_r(NULL, ",", &saveptrrule2));
 
-                                    if ( rulestruct[counters->rulecount].flexbit_timeout[flexbit_count] == 0 )
+                                    if ( gen->rulestruct[gen->rulecount].flexbit_timeout[flexbit_count] == 0 )
                                         {
                                             Sagan_Log(ERROR, "[%s, line %d] Expected flexbit valid expire time for \"set\" at line %d in %s, Abort", __FILE__, __LINE__, linecount, ruleset_fullname);
                                         }
@@ -1513,15 +1532,15 @@ void Load_Rules( const char *ruleset )
 
                                     Remove_Spaces(tmptoken);
 
-                                    rulestruct[counters->rulecount].flexbit_flag = 1; 				/* We have flexbit in the rule! */
-                                    rulestruct[counters->rulecount].flexbit_set_count++;
-                                    rulestruct[counters->rulecount].flexbit_type[flexbit_count]  = 6;		/* set_dstport */
+                                    gen->rulestruct[gen->rulecount].flexbit_flag = 1; 				/* We have flexbit in the rule! */
+                                    gen->rulestruct[gen->rulecount].flexbit_set_count++;
+                                    gen->rulestruct[gen->rulecount].flexbit_type[flexbit_count]  = 6;		/* set_dstport */
 
-                                    strlcpy(rulestruct[counters->rulecount].flexbit_name[flexbit_count], tmptoken, sizeof(rulestruct[counters->rulecount].flexbit_name[flexbit_count]));
+                                    strlcpy(gen->rulestruct[gen->rulecount].flexbit_name[flexbit_count], tmptoken, sizeof(gen->rulestruct[gen->rulecount].flexbit_name[flexbit_count]));
 
-                                    rulestruct[counters->rulecount].flexbit_timeout[flexbit_count] = atoi(strtok_r(NULL, ",", &saveptrrule2));
+                                    gen->rulestruct[gen->rulecount].flexbit_timeout[flexbit_count] = atoi(strtok_r(NULL, ",", &saveptrrule2));
 
-                                    if ( rulestruct[counters->rulecount].flexbit_timeout[flexbit_count] == 0 )
+                                    if ( gen->rulestruct[gen->rulecount].flexbit_timeout[flexbit_count] == 0 )
                                         {
                                             Sagan_Log(ERROR, "[%s, line %d] Expected flexbit valid expire time for \"set\" at line %d in %s, Abort", __FILE__, __LINE__, linecount, ruleset);
                                         }
@@ -1545,15 +1564,15 @@ void Load_Rules( const char *ruleset )
 
                                     Remove_Spaces(tmptoken);
 
-                                    rulestruct[counters->rulecount].flexbit_flag = 1; 				/* We have flexbit in the rule! */
-                                    rulestruct[counters->rulecount].flexbit_set_count++;
-                                    rulestruct[counters->rulecount].flexbit_type[flexbit_count]  = 7;		/* set_ports */
+                                    gen->rulestruct[gen->rulecount].flexbit_flag = 1; 				/* We have flexbit in the rule! */
+                                    gen->rulestruct[gen->rulecount].flexbit_set_count++;
+                                    gen->rulestruct[gen->rulecount].flexbit_type[flexbit_count]  = 7;		/* set_ports */
 
-                                    strlcpy(rulestruct[counters->rulecount].flexbit_name[flexbit_count], tmptoken, sizeof(rulestruct[counters->rulecount].flexbit_name[flexbit_count]));
+                                    strlcpy(gen->rulestruct[gen->rulecount].flexbit_name[flexbit_count], tmptoken, sizeof(gen->rulestruct[gen->rulecount].flexbit_name[flexbit_count]));
 
-                                    rulestruct[counters->rulecount].flexbit_timeout[flexbit_count] = atoi(strtok_r(NULL, ",", &saveptrrule2));
+                                    gen->rulestruct[gen->rulecount].flexbit_timeout[flexbit_count] = atoi(strtok_r(NULL, ",", &saveptrrule2));
 
-                                    if ( rulestruct[counters->rulecount].flexbit_timeout[flexbit_count] == 0 )
+                                    if ( gen->rulestruct[gen->rulecount].flexbit_timeout[flexbit_count] == 0 )
                                         {
                                             Sagan_Log(ERROR, "[%s, line %d] Expected flexbit valid expire time for \"set\" at line %d in %s, Abort", __FILE__, __LINE__, linecount, ruleset);
                                         }
@@ -1587,19 +1606,19 @@ void Load_Rules( const char *ruleset )
                                     if ( !strcmp(tmptoken, "by_src") )
                                         {
 
-                                            rulestruct[counters->rulecount].flexbit_direction[flexbit_count] = 2;
+                                            gen->rulestruct[gen->rulecount].flexbit_direction[flexbit_count] = 2;
 
                                         }
                                     else
                                         {
 
-                                            rulestruct[counters->rulecount].flexbit_direction[flexbit_count] = 3;
+                                            gen->rulestruct[gen->rulecount].flexbit_direction[flexbit_count] = 3;
 
                                         }
 
-                                    rulestruct[counters->rulecount].flexbit_flag = 1;
-                                    rulestruct[counters->rulecount].flexbit_set_count++;
-                                    rulestruct[counters->rulecount].flexbit_type[flexbit_count]  = 8;         /* count */
+                                    gen->rulestruct[gen->rulecount].flexbit_flag = 1;
+                                    gen->rulestruct[gen->rulecount].flexbit_set_count++;
+                                    gen->rulestruct[gen->rulecount].flexbit_type[flexbit_count]  = 8;         /* count */
 
                                     tmptoken = strtok_r(NULL, ",", &saveptrrule2);
 
@@ -1609,7 +1628,7 @@ void Load_Rules( const char *ruleset )
                                         }
 
                                     Remove_Spaces(tmptoken);
-                                    strlcpy(rulestruct[counters->rulecount].flexbit_name[flexbit_count], tmptoken, sizeof(rulestruct[counters->rulecount].flexbit_name[flexbit_count]));
+                                    strlcpy(gen->rulestruct[gen->rulecount].flexbit_name[flexbit_count], tmptoken, sizeof(gen->rulestruct[gen->rulecount].flexbit_name[flexbit_count]));
 
                                     tmptoken = strtok_r(NULL, ",", &saveptrrule2);
 
@@ -1631,19 +1650,19 @@ void Load_Rules( const char *ruleset )
 
                                     if ( tmp1[0] == '>' )
                                         {
-                                            rulestruct[counters->rulecount].flexbit_count_gt_lt[flexbit_count] = 0;
+                                            gen->rulestruct[gen->rulecount].flexbit_count_gt_lt[flexbit_count] = 0;
                                             tmptoken = strtok_r(tmp1, ">", &saveptrrule3);
                                         }
 
                                     else if ( tmp1[0] == '<' )
                                         {
-                                            rulestruct[counters->rulecount].flexbit_count_gt_lt[flexbit_count] = 1;
+                                            gen->rulestruct[gen->rulecount].flexbit_count_gt_lt[flexbit_count] = 1;
                                             tmptoken = strtok_r(tmp1, "<", &saveptrrule3);
                                         }
 
                                     else if ( tmp1[0] == '=' )
                                         {
-                                            rulestruct[counters->rulecount].flexbit_count_gt_lt[flexbit_count] = 2;
+                                            gen->rulestruct[gen->rulecount].flexbit_count_gt_lt[flexbit_count] = 2;
                                             tmptoken = strtok_r(tmp1, "=", &saveptrrule3);
                                         }
 
@@ -1653,15 +1672,15 @@ void Load_Rules( const char *ruleset )
                                         }
 
                                     Remove_Spaces(tmptoken);
-                                    rulestruct[counters->rulecount].flexbit_count_counter[flexbit_count] = atoi(tmptoken);
-                                    rulestruct[counters->rulecount].flexbit_count_flag = true;
+                                    gen->rulestruct[gen->rulecount].flexbit_count_counter[flexbit_count] = atoi(tmptoken);
+                                    gen->rulestruct[gen->rulecount].flexbit_count_flag = true;
 
                                     flexbit_count++;
                                     __atomic_add_fetch(&counters->flexbit_total_counter, 1, __ATOMIC_SEQ_CST);
-                                    rulestruct[counters->rulecount].flexbit_count_count++;
+                                    gen->rulestruct[gen->rulecount].flexbit_count_count++;
                                 }
 
-                            rulestruct[counters->rulecount].flexbit_count = flexbit_count;
+                            gen->rulestruct[gen->rulecount].flexbit_count = flexbit_count;
 
                         }
 
@@ -1688,8 +1707,8 @@ void Load_Rules( const char *ruleset )
                             Var_To_Value(arg, tmp1, sizeof(tmp1));
                             Remove_Spaces(tmp1);
 
-                            strlcpy(rulestruct[counters->rulecount].dynamic_ruleset, tmp1, sizeof(rulestruct[counters->rulecount].dynamic_ruleset));
-                            rulestruct[counters->rulecount].type = DYNAMIC_RULE;
+                            strlcpy(gen->rulestruct[gen->rulecount].dynamic_ruleset, tmp1, sizeof(gen->rulestruct[gen->rulecount].dynamic_ruleset));
+                            gen->rulestruct[gen->rulecount].type = DYNAMIC_RULE;
                             __atomic_add_fetch(&counters->dynamic_rule_count, 1, __ATOMIC_SEQ_CST);
 
                         }
@@ -1730,12 +1749,12 @@ void Load_Rules( const char *ruleset )
 
                             if (!strcmp(tmptoken, "by_src"))
                                 {
-                                    rulestruct[counters->rulecount].geoip2_src_or_dst = 1;
+                                    gen->rulestruct[gen->rulecount].geoip2_src_or_dst = 1;
                                 }
 
                             if (!strcmp(tmptoken, "by_dst"))
                                 {
-                                    rulestruct[counters->rulecount].geoip2_src_or_dst = 2;
+                                    gen->rulestruct[gen->rulecount].geoip2_src_or_dst = 2;
                                 }
 
                             tmptoken = strtok_r(NULL, " ", &saveptrrule2);
@@ -1754,12 +1773,12 @@ void Load_Rules( const char *ruleset )
 
                             if (!strcmp(tmptoken, "isnot"))
                                 {
-                                    rulestruct[counters->rulecount].geoip2_type = 1;
+                                    gen->rulestruct[gen->rulecount].geoip2_type = 1;
                                 }
 
                             if (!strcmp(tmptoken, "is" ))
                                 {
-                                    rulestruct[counters->rulecount].geoip2_type = 2;
+                                    gen->rulestruct[gen->rulecount].geoip2_type = 2;
                                 }
 
                             tmptoken = strtok_r(NULL, ";", &saveptrrule2);           /* Grab country codes */
@@ -1767,9 +1786,9 @@ void Load_Rules( const char *ruleset )
                             Var_To_Value(tmptoken, tmp1, sizeof(tmp1));
                             Remove_Spaces(tmp1);
 
-                            strlcpy(rulestruct[counters->rulecount].geoip2_country_codes, tmp1, sizeof(rulestruct[counters->rulecount].geoip2_country_codes));
+                            strlcpy(gen->rulestruct[gen->rulecount].geoip2_country_codes, tmp1, sizeof(gen->rulestruct[gen->rulecount].geoip2_country_codes));
 
-                            rulestruct[counters->rulecount].geoip2_flag = 1;
+                            gen->rulestruct[gen->rulecount].geoip2_flag = 1;
                         }
 #endif
 
@@ -1805,7 +1824,7 @@ void Load_Rules( const char *ruleset )
                             while ( tmptoken != NULL )
                                 {
 
-                                    if ( event_id_count > MAX_EVENT_ID )
+                                    if ( event_id_count >= MAX_EVENT_ID )
                                         {
                                             Sagan_Log(ERROR, "[%s, line %d] There is to many event ids in 'event_id' types in the rule at line %d in %s, Abort", __FILE__, __LINE__, linecount, ruleset_fullname);
                                         }
@@ -1814,14 +1833,16 @@ void Load_Rules( const char *ruleset )
 
                                     /* We copy it as a string in case we have event id's that lead with a zero */
 
-                                    strlcpy(rulestruct[counters->rulecount].event_id[event_id_count], tmptoken, sizeof(rulestruct[counters->rulecount].event_id[event_id_count]));
+                                    strlcpy(gen->rulestruct[gen->rulecount].event_id[event_id_count], tmptoken, sizeof(gen->rulestruct[gen->rulecount].event_id[event_id_count]));
 
                                     event_id_count++;
-                                    rulestruct[counters->rulecount].event_id_count = event_id_count;
+                                    gen->rulestruct[gen->rulecount].event_id_count = event_id_count;
 
                                     tmptoken = strtok_r(NULL, ",", &saveptrrule2);
 
                                 }
+
+                            Event_ID_Compile( gen->rulecount );
                         }
 
                     if (!strcmp(rulesplit, "meta_content"))
@@ -1836,7 +1857,7 @@ void Load_Rules( const char *ruleset )
 
                             if ( Check_Content_Not(arg) == true )
                                 {
-                                    rulestruct[counters->rulecount].meta_content_not[meta_content_count] = true;
+                                    gen->rulestruct[gen->rulecount].meta_content_not[meta_content_count] = true;
                                 }
 
                             tmptoken = strtok_r(arg, ",", &saveptrrule2);
@@ -1850,7 +1871,7 @@ void Load_Rules( const char *ruleset )
 
                             Content_Pipe(tmp2, linecount, ruleset_fullname, rule_tmp, sizeof(rule_tmp));
 
-                            strlcpy(rulestruct[counters->rulecount].meta_content_help[meta_content_count], rule_tmp, sizeof(rulestruct[counters->rulecount].meta_content_help[meta_content_count]));
+                            strlcpy(gen->rulestruct[gen->rulecount].meta_content_help[meta_content_count], rule_tmp, sizeof(gen->rulestruct[gen->rulecount].meta_content_help[meta_content_count]));
 
                             tmptoken = strtok_r(NULL, ";", &saveptrrule2);           /* Grab Search data */
 
@@ -1871,29 +1892,29 @@ void Load_Rules( const char *ruleset )
                             while (ptmp != NULL)
                                 {
 
-                                    Replace_Sagan(rulestruct[counters->rulecount].meta_content_help[meta_content_count], ptmp, tmp_help, sizeof(tmp_help));
-                                    strlcpy(rulestruct[counters->rulecount].meta_content_containers[meta_content_count].meta_content_converted[meta_content_converted_count], tmp_help, sizeof(rulestruct[counters->rulecount].meta_content_containers[meta_content_count].meta_content_converted[meta_content_converted_count]));
-
-                                    meta_content_converted_count++;
-
-                                    if ( meta_content_converted_count > MAX_META_ITEM_SIZE )
+                                    if ( meta_content_converted_count >= MAX_META_CONTENT_ITEMS )
                                         {
 
-                                            Sagan_Log(ERROR, "[%s, line %d] To many meta_content string values at %d in %s.  Max is %d", __FILE__, __LINE__, linecount, ruleset_fullname, MAX_META_ITEM_SIZE);
+                                            Sagan_Log(ERROR, "[%s, line %d] To many meta_content string values at %d in %s.  Max is %d", __FILE__, __LINE__, linecount, ruleset_fullname, MAX_META_CONTENT_ITEMS);
 
                                         }
 
+                                    Replace_Sagan(gen->rulestruct[gen->rulecount].meta_content_help[meta_content_count], ptmp, tmp_help, sizeof(tmp_help));
+                                    strlcpy(gen->rulestruct[gen->rulecount].meta_content_containers[meta_content_count].meta_content_converted[meta_content_converted_count], tmp_help, sizeof(gen->rulestruct[gen->rulecount].meta_content_containers[meta_content_count].meta_content_converted[meta_content_converted_count]));
+
+                                    meta_content_converted_count++;
+
                                     ptmp = strtok_r(NULL, ",", &tok);
                                 }
 
-                            rulestruct[counters->rulecount].meta_content_containers[meta_content_count].meta_counter = meta_content_converted_count;
+                            gen->rulestruct[gen->rulecount].meta_content_containers[meta_content_count].meta_counter = meta_content_converted_count;
 
-                            rulestruct[counters->rulecount].meta_content_flag = true;
+                            gen->rulestruct[gen->rulecount].meta_content_flag = true;
 
                             tmptoken = strtok_r(NULL, ",", &saveptrrule2);
 
                             meta_content_count++;
-                            rulestruct[counters->rulecount].meta_content_count=meta_content_count;
+                            gen->rulestruct[gen->rulecount].meta_content_count=meta_content_count;
 
                         }
 
@@ -1902,7 +1923,7 @@ void Load_Rules( const char *ruleset )
                     if (!strcmp(rulesplit, "meta_nocase"))
                         {
                             strtok_r(NULL, ":", &saveptrrule2);
-                            rulestruct[counters->rulecount].meta_content_case[meta_content_count-1] = 1;
+                            gen->rulestruct[gen->rulecount].meta_content_case[meta_content_count-1] = 1;
                         }
 
                     /* "json_content" works like "content" but on JSON key/values */
@@ -1925,7 +1946,7 @@ void Load_Rules( const char *ruleset )
 
                             if ( Check_Content_Not(arg) == true )
                                 {
-                                    rulestruct[counters->rulecount].json_content_not[json_content_count] = true;
+                                    gen->rulestruct[gen->rulecount].json_content_not[json_content_count] = true;
                                 }
 
                             tmptoken = strtok_r(arg, ",", &saveptrrule2);
@@ -1935,7 +1956,7 @@ void Load_Rules( const char *ruleset )
                                     Sagan_Log(ERROR, "[%s, line %d] Expected a json_content key,  but none was found at line %d in %s - Abort", __FILE__, __LINE__, linecount, ruleset_fullname);
                                 }
 
-                            Between_Quotes(tmptoken, rulestruct[counters->rulecount].json_content_key[json_content_count], sizeof(rulestruct[counters->rulecount].json_content_key[json_content_count]));
+                            Between_Quotes(tmptoken, gen->rulestruct[gen->rulecount].json_content_key[json_content_count], sizeof(gen->rulestruct[gen->rulecount].json_content_key[json_content_count]));
 
                             tmptoken = strtok_r(NULL, ",", &saveptrrule2);
 
@@ -1944,10 +1965,10 @@ void Load_Rules( const char *ruleset )
                                     Sagan_Log(ERROR, "[%s, line %d] Expected a json_content \"content\",  but none was found at line %d in %s - Abort", __FILE__, __LINE__, linecount, ruleset_fullname);
                                 }
 
-                            Between_Quotes(tmptoken, rulestruct[counters->rulecount].json_content_content[json_content_count], sizeof(rulestruct[counters->rulecount].json_content_content[json_content_count]));
+                            Between_Quotes(tmptoken, gen->rulestruct[gen->rulecount].json_content_content[json_content_count], sizeof(gen->rulestruct[gen->rulecount].json_content_content[json_content_count]));
 
                             json_content_count++;
-                            rulestruct[counters->rulecount].json_content_count=json_content_count;
+                            gen->rulestruct[gen->rulecount].json_content_count=json_content_count;
 
                         }
 
@@ -1956,7 +1977,7 @@ void Load_Rules( const char *ruleset )
                     if (!strcmp(rulesplit, "json_nocase"))
                         {
                             strtok_r(NULL, ":", &saveptrrule2);
-                            rulestruct[counters->rulecount].json_content_case[json_content_count-1] = 1;
+                            gen->rulestruct[gen->rulecount].json_content_case[json_content_count-1] = 1;
                         }
 
                     /* Set the previous "json_strstr" to use strstr instead of strcmp */
@@ -1964,7 +1985,7 @@ void Load_Rules( const char *ruleset )
                     if (!strcmp(rulesplit, "json_strstr"))
                         {
                             strtok_r(NULL, ":", &saveptrrule2);
-                            rulestruct[counters->rulecount].json_content_strstr[json_content_count-1] = 1;
+                            gen->rulestruct[gen->rulecount].json_content_strstr[json_content_count-1] = 1;
                         }
 
                     /* Set the previous "json_meta_strstr" to use strstr instead of strcmp */
@@ -1972,7 +1993,7 @@ void Load_Rules( const char *ruleset )
                     if (!strcmp(rulesplit, "json_meta_strstr"))
                         {
                             strtok_r(NULL, ":", &saveptrrule2);
-                            rulestruct[counters->rulecount].json_meta_strstr[json_content_count-1] = 1;
+                            gen->rulestruct[gen->rulecount].json_meta_strstr[json_content_count-1] = 1;
                         }
 
                     /* Search JSON via PCRE */
@@ -2000,7 +2021,7 @@ void Load_Rules( const char *ruleset )
                                 }
 
 
-                            Between_Quotes(tmptoken, rulestruct[counters->rulecount].json_pcre_key[json_pcre_count], sizeof(rulestruct[counters->rulecount].json_pcre_key[json_pcre_count]));
+                            Between_Quotes(tmptoken, gen->rulestruct[gen->rulecount].json_pcre_key[json_pcre_count], sizeof(gen->rulestruct[gen->rulecount].json_pcre_key[json_pcre_count]));
 
                             tmptoken = strtok_r(NULL, ",", &saveptrrule2);
 
@@ -2070,7 +2091,7 @@ void Load_Rules( const char *ruleset )
 
                             /* We store the compiled/study results. */
 
-                            rulestruct[counters->rulecount].json_re_pcre[json_pcre_count] =  pcre_compile( pcrerule, pcreoptions, &error, &erroffset, NULL );
+                            gen->rulestruct[gen->rulecount].json_re_pcre[json_pcre_count] =  pcre_compile( pcrerule, pcreoptions, &error, &erroffset, NULL );
 
 
 #ifdef PCRE_HAVE_JIT
@@ -2081,7 +2102,7 @@ void Load_Rules( const char *ruleset )
                                 }
 #endif
 
-                            rulestruct[counters->rulecount].json_pcre_extra[json_pcre_count] = pcre_study( rulestruct[counters->rulecount].json_re_pcre[json_pcre_count], pcreoptions, &error);
+                            gen->rulestruct[gen->rulecount].json_pcre_extra[json_pcre_count] = pcre_study( gen->rulestruct[gen->rulecount].json_re_pcre[json_pcre_count], pcreoptions, &error);
 
 #ifdef PCRE_HAVE_JIT
 
@@ -2090,7 +2111,7 @@ void Load_Rules( const char *ruleset )
                                     int jit = 0;
                                     rc = 0;
 
-                                    rc = pcre_fullinfo(rulestruct[counters->rulecount].json_re_pcre[json_pcre_count], rulestruct[counters->rulecount].json_pcre_extra[json_pcre_count], PCRE_INFO_JIT, &jit);
+                                    rc = pcre_fullinfo(gen->rulestruct[gen->rulecount].json_re_pcre[json_pcre_count], gen->rulestruct[gen->rulecount].json_pcre_extra[json_pcre_count], PCRE_INFO_JIT, &jit);
 
                                     if (rc != 0 || jit != 1)
                                         {
@@ -2100,14 +2121,14 @@ void Load_Rules( const char *ruleset )
 
 #endif
 
-                            if (  rulestruct[counters->rulecount].json_re_pcre[json_pcre_count]  == NULL )
+                            if (  gen->rulestruct[gen->rulecount].json_re_pcre[json_pcre_count]  == NULL )
                                 {
                                     Sagan_Log(ERROR, "[%s, line %d] PCRE failure in %s at %d [%d: %s], Abort", __FILE__, __LINE__, ruleset_fullname, linecount, erroffset, error);
                                 }
 
 
                             json_pcre_count++;
-                            rulestruct[counters->rulecount].json_pcre_count=json_pcre_count;
+                            gen->rulestruct[gen->rulecount].json_pcre_count=json_pcre_count;
 
                         }
 
@@ -2124,7 +2145,7 @@ void Load_Rules( const char *ruleset )
 
                             if ( Check_Content_Not(arg) == true )
                                 {
-                                    rulestruct[counters->rulecount].json_meta_content_not[json_meta_content_count] = true;
+                                    gen->rulestruct[gen->rulecount].json_meta_content_not[json_meta_content_count] = true;
                                 }
 
                             tmptoken = strtok_r(arg, ",", &saveptrrule2);
@@ -2134,7 +2155,7 @@ void Load_Rules( const char *ruleset )
                                     Sagan_Log(ERROR, "[%s, line %d] Expected a json_meta_content key but none was found at line %d in %s - Abort", __FILE__, __LINE__, linecount, ruleset_fullname);
                                 }
 
-                            Between_Quotes(tmptoken, rulestruct[counters->rulecount].json_meta_content_key[json_meta_content_count],sizeof(rulestruct[counters->rulecount].json_meta_content_key[json_meta_content_count]));
+                            Between_Quotes(tmptoken, gen->rulestruct[gen->rulecount].json_meta_content_key[json_meta_content_count],sizeof(gen->rulestruct[gen->rulecount].json_meta_content_key[json_meta_content_count]));
 
                             tmptoken = strtok_r(NULL, ";", &saveptrrule2);           /* Grab Search data */
 
@@ -2150,37 +2171,38 @@ void Load_Rules( const char *ruleset )
                             strlcpy(tmp2, rule_tmp, sizeof(tmp2));
 
                             ptmp = strtok_r(tmp2, ",", &tok);
+                            json_meta_content_converted_count = 0;
 
                             while ( ptmp != NULL )
                                 {
 
-                                    strlcpy(rulestruct[counters->rulecount].json_meta_content_containers[json_meta_content_count].json_meta_content_converted[json_meta_content_converted_count], ptmp, sizeof(rulestruct[counters->rulecount].json_meta_content_containers[json_meta_content_count].json_meta_content_converted[json_meta_content_converted_count]));
-
-                                    json_meta_content_converted_count++;
-
-                                    if ( json_meta_content_converted_count > MAX_JSON_META_ITEM_SIZE )
+                                    if ( json_meta_content_converted_count >= MAX_JSON_META_CONTENT_ITEMS )
                                         {
 
-                                            Sagan_Log(ERROR, "[%s, line %d] To many json_meta_content string values at %d in %s.  Max is %d", __FILE__, __LINE__, linecount, ruleset_fullname, MAX_JSON_META_ITEM_SIZE);
+                                            Sagan_Log(ERROR, "[%s, line %d] To many json_meta_content string values at %d in %s.  Max is %d", __FILE__, __LINE__, linecount, ruleset_fullname, MAX_JSON_META_CONTENT_ITEMS);
 
                                         }
 
+                                    strlcpy(gen->rulestruct[gen->rulecount].json_meta_content_containers[json_meta_content_count].json_meta_content_converted[json_meta_content_converted_count], ptmp, sizeof(gen->rulestruct[gen->rulecount].json_meta_content_containers[json_meta_content_count].json_meta_content_converted[json_meta_content_converted_count]));
+
+                                    json_meta_content_converted_count++;
+
                                     ptmp = strtok_r(NULL, ",", &tok);
 
                                 }
 
-                            rulestruct[counters->rulecount].json_meta_content_containers[json_meta_content_count].json_meta_counter = json_meta_content_converted_count;
+                            gen->rulestruct[gen->rulecount].json_meta_content_containers[json_meta_content_count].json_meta_counter = json_meta_content_converted_count;
 
 
                             json_meta_content_count++;
-                            rulestruct[counters->rulecount].json_meta_content_count=json_meta_content_count;
+                            gen->rulestruct[gen->rulecount].json_meta_content_count=json_meta_content_count;
 
                         }
 
                     if (!strcmp(rulesplit, "json_meta_nocase"))
                         {
                             strtok_r(NULL, ":", &saveptrrule2);
-                            rulestruct[counters->rulecount].json_meta_content_case[json_meta_content_count-1] = true;
+                            gen->rulestruct[gen->rulecount].json_meta_content_case[json_meta_content_count-1] = true;
                         }
 
                     /* Rule revision */
@@ -2196,7 +2218,7 @@ void Load_Rules( const char *ruleset )
 
                             Remove_Spaces(arg);
 
-                            rulestruct[counters->rulecount].s_rev = atoi(arg);
+                            gen->rulestruct[gen->rulecount].s_rev = atoi(arg);
                         }
 
                     if (!strcmp(rulesplit, "classtype" ))
@@ -2209,15 +2231,15 @@ void Load_Rules( const char *ruleset )
                                 }
 
                             Remove_Spaces(arg);
-                            strlcpy(rulestruct[counters->rulecount].s_classtype, arg, sizeof(rulestruct[counters->rulecount].s_classtype));
+                            strlcpy(gen->rulestruct[gen->rulecount].s_classtype, arg, sizeof(gen->rulestruct[gen->rulecount].s_classtype));
 
                             found = 0;
 
                             for(i=0; i < counters->classcount; i++)
                                 {
-                                    if (!strcmp(classstruct[i].s_shortname, rulestruct[counters->rulecount].s_classtype))
+                                    if (!strcmp(classstruct[i].s_shortname, gen->rulestruct[gen->rulecount].s_classtype))
                                         {
-                                            rulestruct[counters->rulecount].s_pri = classstruct[i].s_priority;
+                                            gen->rulestruct[gen->rulecount].s_pri = classstruct[i].s_priority;
                                             found = 1;
                                         }
                                 }
@@ -2225,7 +2247,7 @@ void Load_Rules( const char *ruleset )
                             if ( found == 0 )
                                 {
                                     Sagan_Log(ERROR, "[%s, line %d] The classtype \"%s\" was not found on line %d in %s! "
-                                              "Are you attempting loading a rule set before loading the classification.config? - Abort", __FILE__, __LINE__, rulestruct[counters->rulecount].s_classtype, linecount, ruleset_fullname);
+                                              "Are you attempting loading a rule set before loading the classification.config? - Abort", __FILE__, __LINE__, gen->rulestruct[gen->rulecount].s_classtype, linecount, ruleset_fullname);
                                 }
 
                         }
@@ -2242,7 +2264,7 @@ void Load_Rules( const char *ruleset )
                             Var_To_Value(arg, tmp1, sizeof(tmp1));
                             Remove_Spaces(tmp1);
 
-                            strlcpy(rulestruct[counters->rulecount].s_program, tmp1, sizeof(rulestruct[counters->rulecount].s_program));
+                            strlcpy(gen->rulestruct[gen->rulecount].s_program, tmp1, sizeof(gen->rulestruct[gen->rulecount].s_program));
 
                         }
 
@@ -2256,8 +2278,8 @@ void Load_Rules( const char *ruleset )
                                 }
 
                             Remove_Spaces(arg);
-                            strlcpy(rulestruct[counters->rulecount].s_reference[ref_count], arg, sizeof(rulestruct[counters->rulecount].s_reference[ref_count]));
-                            rulestruct[counters->rulecount].ref_count=ref_count;
+                            strlcpy(gen->rulestruct[gen->rulecount].s_reference[ref_count], arg, sizeof(gen->rulestruct[gen->rulecount].s_reference[ref_count]));
+                            gen->rulestruct[gen->rulecount].ref_count=ref_count;
                             ref_count++;
                         }
 
@@ -2271,7 +2293,7 @@ void Load_Rules( const char *ruleset )
                                 }
 
                             Remove_Spaces(arg);
-                            rulestruct[counters->rulecount].s_sid = atol(arg);
+                            gen->rulestruct[gen->rulecount].s_sid = atol(arg);
                         }
 
 
@@ -2300,7 +2322,7 @@ void Load_Rules( const char *ruleset )
                                     ptmp = strtok_r(NULL, "|", &tok);
                                 }
 
-                            strlcpy(rulestruct[counters->rulecount].s_tag, arg, sizeof(rulestruct[counters->rulecount].s_tag));
+                            strlcpy(gen->rulestruct[gen->rulecount].s_tag, arg, sizeof(gen->rulestruct[gen->rulecount].s_tag));
                         }
 
 
@@ -2314,7 +2336,7 @@ void Load_Rules( const char *ruleset )
                                 }
 
                             Remove_Spaces(arg);
-                            strlcpy(rulestruct[counters->rulecount].s_facility, arg, sizeof(rulestruct[counters->rulecount].s_facility));
+                            strlcpy(gen->rulestruct[gen->rulecount].s_facility, arg, sizeof(gen->rulestruct[gen->rulecount].s_facility));
                         }
 
                     if (!strcmp(rulesplit, "syslog_level" ))
@@ -2327,7 +2349,7 @@ void Load_Rules( const char *ruleset )
                                 }
 
                             Remove_Spaces(arg);
-                            strlcpy(rulestruct[counters->rulecount].s_level, arg, sizeof(rulestruct[counters->rulecount].s_level));
+                            strlcpy(gen->rulestruct[gen->rulecount].s_level, arg, sizeof(gen->rulestruct[gen->rulecount].s_level));
                         }
 
                     if (!strcmp(rulesplit, "syslog_priority" ))
@@ -2340,7 +2362,7 @@ void Load_Rules( const char *ruleset )
                                 }
 
                             Remove_Spaces(arg);
-                            strlcpy(rulestruct[counters->rulecount].s_syspri, arg, sizeof(rulestruct[counters->rulecount].s_syspri));
+                            strlcpy(gen->rulestruct[gen->rulecount].s_syspri, arg, sizeof(gen->rulestruct[gen->rulecount].s_syspri));
                         }
 
 
@@ -2354,7 +2376,7 @@ void Load_Rules( const char *ruleset )
                                 }
 
                             Remove_Spaces(arg);
-                            rulestruct[counters->rulecount].s_pri = atoi(arg);
+                            gen->rulestruct[gen->rulecount].s_pri = atoi(arg);
                         }
 
 #ifdef HAVE_LIBESMTP
@@ -2374,8 +2396,8 @@ void Load_Rules( const char *ruleset )
                                 }
 
                             Remove_Spaces(arg);
-                            strlcpy(rulestruct[counters->rulecount].email, arg, sizeof(rulestruct[counters->rulecount].email));
-                            rulestruct[counters->rulecount].email_flag=1;
+                            strlcpy(gen->rulestruct[gen->rulecount].email, arg, sizeof(gen->rulestruct[gen->rulecount].email));
+                            gen->rulestruct[gen->rulecount].email_flag=1;
                             config->sagan_esmtp_flag=1;
                         }
 #endif
@@ -2390,7 +2412,7 @@ void Load_Rules( const char *ruleset )
 
                     if (!strcmp(rulesplit, "normalize" ))
                         {
-                            rulestruct[counters->rulecount].normalize = 1;
+                            gen->rulestruct[gen->rulecount].normalize = 1;
 
                             /* Test for old liblognorm/Sagan usage.  If old method is found,  produce a warning */
 
@@ -2417,7 +2439,7 @@ void Load_Rules( const char *ruleset )
                                     Sagan_Log(ERROR, "[%s, line %d] The \"msg\" appears to be incomplete at line %d in %s, Abort", __FILE__, __LINE__, linecount, ruleset_fullname);
                                 }
 
-                            strlcpy(rulestruct[counters->rulecount].s_msg, tmp2, sizeof(rulestruct[counters->rulecount].s_msg));
+                            strlcpy(gen->rulestruct[gen->rulecount].s_msg, tmp2, sizeof(gen->rulestruct[gen->rulecount].s_msg));
                         }
 
                     /* Good ole "content" style search */
@@ -2435,7 +2457,7 @@ void Load_Rules( const char *ruleset )
 
                             if ( Check_Content_Not(arg) == true )
                                 {
-                                    rulestruct[counters->rulecount].content_not[content_count] = true;
+                                    gen->rulestruct[gen->rulecount].content_not[content_count] = true;
                                 }
 
                             Between_Quotes(arg, tmp2, sizeof(tmp2));
@@ -2450,10 +2472,10 @@ void Load_Rules( const char *ruleset )
                             Content_Pipe(tmp2, linecount, ruleset_fullname, rule_tmp, sizeof(rule_tmp));
                             strlcpy(final_content, rule_tmp, sizeof(final_content));
 
-                            strlcpy(rulestruct[counters->rulecount].content[content_count], final_content, sizeof(rulestruct[counters->rulecount].content[content_count]));
+                            strlcpy(gen->rulestruct[gen->rulecount].content[content_count], final_content, sizeof(gen->rulestruct[gen->rulecount].content[content_count]));
                             final_content[0] = '\0';
                             content_count++;
-                            rulestruct[counters->rulecount].content_count=content_count;
+                            gen->rulestruct[gen->rulecount].content_count=content_count;
                         }
 
                     /* Single option,  but "nocase" works better here */
@@ -2461,7 +2483,7 @@ void Load_Rules( const char *ruleset )
                     if (!strcmp(rulesplit, "nocase"))
                         {
                             strtok_r(NULL, ":", &saveptrrule2);
-                            rulestruct[counters->rulecount].content_case[content_count - 1] = true;
+                            gen->rulestruct[gen->rulecount].content_case[content_count - 1] = true;
                         }
 
                     if (!strcmp(rulesplit, "offset"))
@@ -2473,7 +2495,7 @@ void Load_Rules( const char *ruleset )
                                     Sagan_Log(ERROR, "[%s, line %d] The \"offset\" appears to be missing at line %d in %s, Abort", __FILE__, __LINE__, linecount, ruleset_fullname);
                                 }
 
-                            rulestruct[counters->rulecount].s_offset[content_count - 1] = atoi(arg);
+                            gen->rulestruct[gen->rulecount].s_offset[content_count - 1] = atoi(arg);
                         }
 
                     if (!strcmp(rulesplit, "meta_offset"))
@@ -2485,7 +2507,7 @@ void Load_Rules( const char *ruleset )
                                     Sagan_Log(ERROR, "[%s, line %d] The \"meta_offset\" appears to be missing at line %d in %s, Abort", __FILE__, __LINE__, linecount, ruleset_fullname);
                                 }
 
-                            rulestruct[counters->rulecount].meta_offset[meta_content_count - 1] = atoi(arg);
+                            gen->rulestruct[gen->rulecount].meta_offset[meta_content_count - 1] = atoi(arg);
                         }
 
 
@@ -2498,7 +2520,7 @@ void Load_Rules( const char *ruleset )
                                     Sagan_Log(ERROR, "[%s, line %d] The \"depth\" appears to be missing at line %d in %s, Abort", __FILE__, __LINE__, linecount, ruleset_fullname);
                                 }
 
-                            rulestruct[counters->rulecount].s_depth[content_count - 1] = atoi(arg);
+                            gen->rulestruct[gen->rulecount].s_depth[content_count - 1] = atoi(arg);
                         }
 
                     if (!strcmp(rulesplit, "meta_depth"))
@@ -2510,7 +2532,7 @@ void Load_Rules( const char *ruleset )
                                     Sagan_Log(ERROR, "[%s, line %d] The \"meta_depth\" appears to be missing at line %d in %s, Abort", __FILE__, __LINE__, linecount, ruleset_fullname);
                                 }
 
-                            rulestruct[counters->rulecount].meta_depth[meta_content_count - 1] = atoi(arg);
+                            gen->rulestruct[gen->rulecount].meta_depth[meta_content_count - 1] = atoi(arg);
                         }
 
 
@@ -2523,7 +2545,7 @@ void Load_Rules( const char *ruleset )
                                     Sagan_Log(ERROR, "[%s, line %d] The \"distance\" appears to be missing at line %d in %s, Abort", __FILE__, __LINE__, linecount, ruleset_fullname);
                                 }
 
-                            rulestruct[counters->rulecount].s_distance[content_count - 1] = atoi(arg);
+                            gen->rulestruct[gen->rulecount].s_distance[content_count - 1] = atoi(arg);
                         }
 
                     if (!strcmp(rulesplit, "meta_distance"))
@@ -2535,7 +2557,7 @@ void Load_Rules( const char *ruleset )
                                     Sagan_Log(ERROR, "[%s, line %d] The \"meta_distance\" appears to be missing at line %d in %s, Abort", __FILE__, __LINE__, linecount, ruleset_fullname);
                                 }
 
-                            rulestruct[counters->rulecount].meta_distance[meta_content_count - 1] = atoi(arg);
+                            gen->rulestruct[gen->rulecount].meta_distance[meta_content_count - 1] = atoi(arg);
                         }
 
 
@@ -2547,7 +2569,7 @@ void Load_Rules( const char *ruleset )
                                 {
                                     Sagan_Log(ERROR, "[%s, line %d] The \"within\" appears to be missing at line %d in %s, Abort", __FILE__, __LINE__, linecount, ruleset_fullname);
                                 }
-                            rulestruct[counters->rulecount].s_within[content_count - 1] = atoi(arg);
+                            gen->rulestruct[gen->rulecount].s_within[content_count - 1] = atoi(arg);
                         }
 
 
@@ -2559,7 +2581,7 @@ void Load_Rules( const char *ruleset )
                                 {
                                     Sagan_Log(ERROR, "[%s, line %d] The \"meta_within\" appears to be missing at line %d in %s, Abort", __FILE__, __LINE__, linecount, ruleset_fullname);
                                 }
-                            rulestruct[counters->rulecount].meta_within[meta_content_count - 1] = atoi(arg);
+                            gen->rulestruct[gen->rulecount].meta_within[meta_content_count - 1] = atoi(arg);
                         }
 
 
@@ -2662,7 +2684,7 @@ void Load_Rules( const char *ruleset )
 
                             /* We store the compiled/study results.  This saves us some CPU time during searching - Champ Clark III - 02/01/2011 */
 
-                            rulestruct[counters->rulecount].re_pcre[pcre_count] =  pcre_compile( pcrerule, pcreoptions, &error, &erroffset, NULL );
+                            gen->rulestruct[gen->rulecount].re_pcre[pcre_count] =  pcre_compile( pcrerule, pcreoptions, &error, &erroffset, NULL );
 
 #ifdef PCRE_HAVE_JIT
 
@@ -2672,7 +2694,7 @@ void Load_Rules( const char *ruleset )
                                 }
 #endif
 
-                            rulestruct[counters->rulecount].pcre_extra[pcre_count] = pcre_study( rulestruct[counters->rulecount].re_pcre[pcre_count], pcreoptions, &error);
+                            gen->rulestruct[gen->rulecount].pcre_extra[pcre_count] = pcre_study( gen->rulestruct[gen->rulecount].re_pcre[pcre_count], pcreoptions, &error);
 
 #ifdef PCRE_HAVE_JIT
 
@@ -2681,7 +2703,7 @@ void Load_Rules( const char *ruleset )
                                     int jit = 0;
                                     rc = 0;
 
-                                    rc = pcre_fullinfo(rulestruct[counters->rulecount].re_pcre[pcre_count], rulestruct[counters->rulecount].pcre_extra[pcre_count], PCRE_INFO_JIT, &jit);
+                                    rc = pcre_fullinfo(gen->rulestruct[gen->rulecount].re_pcre[pcre_count], gen->rulestruct[gen->rulecount].pcre_extra[pcre_count], PCRE_INFO_JIT, &jit);
 
                                     if (rc != 0 || jit != 1)
                                         {
@@ -2691,13 +2713,13 @@ void Load_Rules( const char *ruleset )
 
 #endif
 
-                            if (  rulestruct[counters->rulecount].re_pcre[pcre_count]  == NULL )
+                            if (  gen->rulestruct[gen->rulecount].re_pcre[pcre_count]  == NULL )
                                 {
                                     Sagan_Log(ERROR, "[%s, line %d] PCRE failure in %s at %d [%d: %s], Abort", __FILE__, __LINE__, ruleset_fullname, linecount, erroffset, error);
                                 }
 
                             pcre_count++;
-                            rulestruct[counters->rulecount].pcre_count=pcre_count;
+                            gen->rulestruct[gen->rulecount].pcre_count=pcre_count;
                         }
 
                     /* Time based alerting */
@@ -2705,7 +2727,7 @@ void Load_Rules( const char *ruleset )
                     if (!strcmp(rulesplit, "alert_time"))
                         {
 
-                            rulestruct[counters->rulecount].alert_time_flag = 1;
+                            gen->rulestruct[gen->rulecount].alert_time_flag = 1;
 
                             tok_tmp = strtok_r(NULL, ":", &saveptrrule2);
                             Var_To_Value(tok_tmp, tmp1, sizeof(tmp1));
@@ -2737,13 +2759,13 @@ void Load_Rules( const char *ruleset )
                                                             Sagan_Log(ERROR, "[%s, line %d] The day '%c' 'alert_time / days' is invalid in %s at line %d, Abort.", __FILE__, __LINE__,  alert_time_tmp[i], ruleset_fullname, linecount);
                                                         }
 
-                                                    if ( atoi(tmp) == 0 ) rulestruct[counters->rulecount].alert_days ^= SUNDAY;
-                                                    if ( atoi(tmp) == 1 ) rulestruct[counters->rulecount].alert_days ^= MONDAY;
-                                                    if ( atoi(tmp) == 2 ) rulestruct[counters->rulecount].alert_days ^= TUESDAY;
-                                                    if ( atoi(tmp) == 3 ) rulestruct[counters->rulecount].alert_days ^= WEDNESDAY;
-                                                    if ( atoi(tmp) == 4 ) rulestruct[counters->rulecount].alert_days ^= THURSDAY;
-                                                    if ( atoi(tmp) == 5 ) rulestruct[counters->rulecount].alert_days ^= FRIDAY;
-                                                    if ( atoi(tmp) == 6 ) rulestruct[counters->rulecount].alert_days ^= SATURDAY;
+                                                    if ( atoi(tmp) == 0 ) gen->rulestruct[gen->rulecount].alert_days ^= SUNDAY;
+                                                    if ( atoi(tmp) == 1 ) gen->rulestruct[gen->rulecount].alert_days ^= MONDAY;
+                                                    if ( atoi(tmp) == 2 ) gen->rulestruct[gen->rulecount].alert_days ^= TUESDAY;
+                                                    if ( atoi(tmp) == 3 ) gen->rulestruct[gen->rulecount].alert_days ^= WEDNESDAY;
+                                                    if ( atoi(tmp) == 4 ) gen->rulestruct[gen->rulecount].alert_days ^= THURSDAY;
+                                                    if ( atoi(tmp) == 5 ) gen->rulestruct[gen->rulecount].alert_days ^= FRIDAY;
+                                                    if ( atoi(tmp) == 6 ) gen->rulestruct[gen->rulecount].alert_days ^= SATURDAY;
 
                                                 }
 
@@ -2780,7 +2802,7 @@ void Load_Rules( const char *ruleset )
                                                 }
 
                                             snprintf(alert_time_all, sizeof(alert_time_all), "%s%s", alert_tmp_hour, alert_tmp_minute);
-                                            rulestruct[counters->rulecount].aetas_start = atoi(alert_time_all);
+                                            gen->rulestruct[gen->rulecount].aetas_start = atoi(alert_time_all);
 
                                             /* End hour */
 
@@ -2800,13 +2822,15 @@ void Load_Rules( const char *ruleset )
 
                                             snprintf(alert_time_all, sizeof(alert_time_all), "%s%s", alert_tmp_hour, alert_tmp_minute);
 
-                                            rulestruct[counters->rulecount].aetas_end = atoi(alert_time_all);
+                                            gen->rulestruct[gen->rulecount].aetas_end = atoi(alert_time_all);
 
                                         }
 
                                     tmptoken = strtok_r(NULL, ",", &saveptrrule2);
                                 }
 
+                            Aetas_Compile( gen->rulecount );
+
                         }
 
                     /* Threshold */
@@ -2825,15 +2849,15 @@ void Load_Rules( const char *ruleset )
 
                                             if (Sagan_strstr(tmptoken, "limit"))
                                                 {
-                                                    rulestruct[counters->rulecount].threshold2_type = THRESHOLD_LIMIT;
+                                                    gen->rulestruct[gen->rulecount].threshold2_type = THRESHOLD_LIMIT;
                                                 }
 
                                             else if (Sagan_strstr(tmptoken, "suppress"))
                                                 {
-                                                    rulestruct[counters->rulecount].threshold2_type = THRESHOLD_SUPPRESS;
+                                                    gen->rulestruct[gen->rulecount].threshold2_type = THRESHOLD_SUPPRESS;
                                                 }
 
-                                            if ( rulestruct[counters->rulecount].threshold2_type == 0 )
+                                            if ( gen->rulestruct[gen->rulecount].threshold2_type == 0 )
                                                 {
                                                     Sagan_Log(ERROR, "[%s, line %d] Invalid threshold type '%s' at line %d in %s. Threshold type must be 'limit' or 'suppress'. Abort.", __FILE__, __LINE__, tmptoken, linecount, ruleset_fullname);
                                                 }
@@ -2846,27 +2870,27 @@ void Load_Rules( const char *ruleset )
 
                                             if (Sagan_strstr(tmptoken, "by_src"))
                                                 {
-                                                    rulestruct[counters->rulecount].threshold2_method_src = true;
+                                                    gen->rulestruct[gen->rulecount].threshold2_method_src = true;
                                                 }
 
                                             if (Sagan_strstr(tmptoken, "by_dst"))
                                                 {
-                                                    rulestruct[counters->rulecount].threshold2_method_dst = true;
+                                                    gen->rulestruct[gen->rulecount].threshold2_method_dst = true;
                                                 }
 
                                             if (Sagan_strstr(tmptoken, "by_username") || Sagan_strstr(tmptoken, "by_string"))
                                                 {
-                                                    rulestruct[counters->rulecount].threshold2_method_username = true;
+                                                    gen->rulestruct[gen->rulecount].threshold2_method_username = true;
                                                 }
 
                                             if (Sagan_strstr(tmptoken, "by_srcport"))
                                                 {
-                                                    rulestruct[counters->rulecount].threshold2_method_srcport = true;
+                                                    gen->rulestruct[gen->rulecount].threshold2_method_srcport = true;
                                                 }
 
                                             if (Sagan_strstr(tmptoken, "by_dstport"))
                                                 {
-                                                    rulestruct[counters->rulecount].threshold2_method_dstport = true;
+                                                    gen->rulestruct[gen->rulecount].threshold2_method_dstport = true;
                                                 }
                                         }
 
@@ -2874,9 +2898,9 @@ void Load_Rules( const char *ruleset )
                                         {
                                             tmptok_tmp = strtok_r(tmptoken, " ", &saveptrrule3);
                                             tmptok_tmp = strtok_r(NULL, " ", &saveptrrule3);
-                                            rulestruct[counters->rulecount].threshold2_count = atoi(tmptok_tmp);
+                                            gen->rulestruct[gen->rulecount].threshold2_count = atoi(tmptok_tmp);
 
-                                            if ( rulestruct[counters->rulecount].threshold2_count == 0 )
+                                            if ( gen->rulestruct[gen->rulecount].threshold2_count == 0 )
                                                 {
                                                     Sagan_Log(ERROR, "[%s, line %d] Invalid threshold count '%s' at line %d in %s. Abort.", __FILE__, __LINE__, tmptok_tmp, linecount, ruleset_fullname);
                                                 }
@@ -2887,9 +2911,9 @@ void Load_Rules( const char *ruleset )
                                         {
                                             tmptok_tmp = strtok_r(tmptoken, " ", &saveptrrule3);
                                             tmptok_tmp = strtok_r(NULL, " ", &saveptrrule3 );
-                                            rulestruct[counters->rulecount].threshold2_seconds = atoi(tmptok_tmp);
+                                            gen->rulestruct[gen->rulecount].threshold2_seconds = atoi(tmptok_tmp);
 
-                                            if ( rulestruct[counters->rulecount].threshold2_seconds == 0 )
+                                            if ( gen->rulestruct[gen->rulecount].threshold2_seconds == 0 )
                                                 {
                                                     Sagan_Log(ERROR, "[%s, line %d] Invalid threshold time '%s' at line %d in %s. Abort.", __FILE__, __LINE__, tmptok_tmp, linecount, ruleset_fullname);
                                                 }
@@ -2904,7 +2928,7 @@ void Load_Rules( const char *ruleset )
                     if (!strcmp(rulesplit, "after" ))
                         {
 
-                            rulestruct[counters->rulecount].after2 = true;
+                            gen->rulestruct[gen->rulecount].after2 = true;
 
                             tok_tmp = strtok_r(NULL, ":", &saveptrrule2);
 
@@ -2938,27 +2962,27 @@ void Load_Rules( const char *ruleset )
 
                                                     if (!strcmp(after_value2, "by_src"))
                                                         {
-                                                            rulestruct[counters->rulecount].after2_method_src = true;
+                                                            gen->rulestruct[gen->rulecount].after2_method_src = true;
                                                         }
 
                                                     if (!strcmp(after_value2, "by_dst"))
                                                         {
-                                                            rulestruct[counters->rulecount].after2_method_dst = true;
+                                                            gen->rulestruct[gen->rulecount].after2_method_dst = true;
                                                         }
 
                                                     if (!strcmp(after_value2, "by_username"))
                                                         {
-                                                            rulestruct[counters->rulecount].after2_method_username = true;
+                                                            gen->rulestruct[gen->rulecount].after2_method_username = true;
                                                         }
 
                                                     if(!strcmp(after_value2, "by_srcport"))
                                                         {
-                                                            rulestruct[counters->rulecount].after2_method_srcport  = true;
+                                                            gen->rulestruct[gen->rulecount].after2_method_srcport  = true;
                                                         }
 
                                                     if(!strcmp(after_value2, "by_dstport"))
                                                         {
-                                                            rulestruct[counters->rulecount].after2_method_dstport  = true;
+                                                            gen->rulestruct[gen->rulecount].after2_method_dstport  = true;
                                                         }
 
                                                     after_value2 = strtok_r(NULL, "&", &after_value3);
@@ -2969,9 +2993,9 @@ void Load_Rules( const char *ruleset )
                                         {
                                             tmptok_tmp = strtok_r(tmptoken, " ", &saveptrrule3);
                                             tmptok_tmp = strtok_r(NULL, " ", &saveptrrule3);
-                                            rulestruct[counters->rulecount].after2_count = atoi(tmptok_tmp);
+                                            gen->rulestruct[gen->rulecount].after2_count = atoi(tmptok_tmp);
 
-                                            if ( rulestruct[counters->rulecount].after2_count == 0 )
+                                            if ( gen->rulestruct[gen->rulecount].after2_count == 0 )
                                                 {
                                                     Sagan_Log(ERROR, "[%s, line %d] Invalid after count '%s' at line %d in %s. Abort.", __FILE__, __LINE__, tmptok_tmp, linecount, ruleset_fullname);
                                                 }
@@ -2983,9 +3007,9 @@ void Load_Rules( const char *ruleset )
                                         {
                                             tmptok_tmp = strtok_r(tmptoken, " ", &saveptrrule3);
                                             tmptok_tmp = strtok_r(NULL, " ", &saveptrrule3 );
-                                            rulestruct[counters->rulecount].after2_seconds = atoi(tmptok_tmp);
+                                            gen->rulestruct[gen->rulecount].after2_seconds = atoi(tmptok_tmp);
 
-                                            if ( rulestruct[counters->rulecount].after2_seconds == 0 )
+                                            if ( gen->rulestruct[gen->rulecount].after2_seconds == 0 )
                                                 {
                                                     Sagan_Log(ERROR, "[%s, line %d] Invalid after time '%s' at line %d in %s. Abort.", __FILE__, __LINE__, tmptok_tmp, linecount, ruleset_fullname);
                                                 }
@@ -3019,29 +3043,29 @@ void Load_Rules( const char *ruleset )
 
                                     if (!strcmp(tmptoken, "by_src"))
                                         {
-                                            rulestruct[counters->rulecount].blacklist_ipaddr_src = 1;
-                                            rulestruct[counters->rulecount].blacklist_flag = 1;
+                                            gen->rulestruct[gen->rulecount].blacklist_ipaddr_src = 1;
+                                            gen->rulestruct[gen->rulecount].blacklist_flag = 1;
                                             found = 1;
                                         }
 
                                     if (!strcmp(tmptoken, "by_dst"))
                                         {
-                                            rulestruct[counters->rulecount].blacklist_ipaddr_dst = 1;
-                                            rulestruct[counters->rulecount].blacklist_flag = 1;
+                                            gen->rulestruct[gen->rulecount].blacklist_ipaddr_dst = 1;
+                                            gen->rulestruct[gen->rulecount].blacklist_flag = 1;
                                             found = 1;
                                         }
 
                                     if (!strcmp(tmptoken, "both"))
                                         {
-                                            rulestruct[counters->rulecount].blacklist_ipaddr_both = 1;
-                                            rulestruct[counters->rulecount].blacklist_flag = 1;
+                                            gen->rulestruct[gen->rulecount].blacklist_ipaddr_both = 1;
+                                            gen->rulestruct[gen->rulecount].blacklist_flag = 1;
                                             found = 1;
                                         }
 
                                     if (!strcmp(tmptoken, "all"))
                                         {
-                                            rulestruct[counters->rulecount].blacklist_ipaddr_all = 1;
-                                            rulestruct[counters->rulecount].blacklist_flag = 1;
+                                            gen->rulestruct[gen->rulecount].blacklist_ipaddr_all = 1;
+                                            gen->rulestruct[gen->rulecount].blacklist_flag = 1;
                                             found = 1;
                                         }
 
@@ -3072,85 +3096,85 @@ void Load_Rules( const char *ruleset )
 
                                     if (!strcmp(tmptoken, "by_src"))
                                         {
-                                            rulestruct[counters->rulecount].brointel_ipaddr_src = 1;
-                                            rulestruct[counters->rulecount].brointel_flag = 1;
+                                            gen->rulestruct[gen->rulecount].brointel_ipaddr_src = 1;
+                                            gen->rulestruct[gen->rulecount].brointel_flag = 1;
                                             found = 1;
                                         }
 
                                     if (!strcmp(tmptoken, "by_dst"))
                                         {
-                                            rulestruct[counters->rulecount].brointel_ipaddr_dst = 1;
-                                            rulestruct[counters->rulecount].brointel_flag = 1;
+                                            gen->rulestruct[gen->rulecount].brointel_ipaddr_dst = 1;
+                                            gen->rulestruct[gen->rulecount].brointel_flag = 1;
                                             found = 1;
                                         }
 
                                     if (!strcmp(tmptoken, "both"))
                                         {
-                                            rulestruct[counters->rulecount].brointel_ipaddr_both = 1;
-                                            rulestruct[counters->rulecount].brointel_flag = 1;
+                                            gen->rulestruct[gen->rulecount].brointel_ipaddr_both = 1;
+                                            gen->rulestruct[gen->rulecount].brointel_flag = 1;
                                             found = 1;
                                         }
 
                                     if (!strcmp(tmptoken, "all"))
                                         {
-                                            rulestruct[counters->rulecount].brointel_ipaddr_all = 1;
-                                            rulestruct[counters->rulecount].brointel_flag = 1;
+                                            gen->rulestruct[gen->rulecount].brointel_ipaddr_all = 1;
+                                            gen->rulestruct[gen->rulecount].brointel_flag = 1;
                                             found = 1;
                                         }
 
                                     if (!strcmp(tmptoken, "domain"))
                                         {
-                                            rulestruct[counters->rulecount].brointel_domain = 1;
-                                            rulestruct[counters->rulecount].brointel_flag = 1;
+                                            gen->rulestruct[gen->rulecount].brointel_domain = 1;
+                                            gen->rulestruct[gen->rulecount].brointel_flag = 1;
                                             found = 1;
                                         }
 
                                     if (!strcmp(tmptoken, "file_hash"))
                                         {
-                                            rulestruct[counters->rulecount].brointel_file_hash = 1;
-                                            rulestruct[counters->rulecount].brointel_flag = 1;
+                                            gen->rulestruct[gen->rulecount].brointel_file_hash = 1;
+                                            gen->rulestruct[gen->rulecount].brointel_flag = 1;
                                             found = 1;
                                         }
 
                                     if (!strcmp(tmptoken, "url"))
                                         {
-                                            rulestruct[counters->rulecount].brointel_url = 1;
-                                            rulestruct[counters->rulecount].brointel_flag = 1;
+                                            gen->rulestruct[gen->rulecount].brointel_url = 1;
+                                            gen->rulestruct[gen->rulecount].brointel_flag = 1;
                                             found = 1;
                                         }
 
                                     if (!strcmp(tmptoken, "software"))
                                         {
-                                            rulestruct[counters->rulecount].brointel_software = 1;
-                                            rulestruct[counters->rulecount].brointel_flag = 1;
+                                            gen->rulestruct[gen->rulecount].brointel_software = 1;
+                                            gen->rulestruct[gen->rulecount].brointel_flag = 1;
                                             found = 1;
                                         }
 
                                     if (!strcmp(tmptoken, "email"))
                                         {
-                                            rulestruct[counters->rulecount].brointel_email = 1;
-                                            rulestruct[counters->rulecount].brointel_flag = 1;
+                                            gen->rulestruct[gen->rulecount].brointel_email = 1;
+                                            gen->rulestruct[gen->rulecount].brointel_flag = 1;
                                             found = 1;
                                         }
 
                                     if (!strcmp(tmptoken, "user_name"))
                                         {
-                                            rulestruct[counters->rulecount].brointel_user_name = 1;
-                                            rulestruct[counters->rulecount].brointel_flag = 1;
+                                            gen->rulestruct[gen->rulecount].brointel_user_name = 1;
+                                            gen->rulestruct[gen->rulecount].brointel_flag = 1;
                                             found = 1;
                                         }
 
                                     if (!strcmp(tmptoken, "file_name"))
                                         {
-                                            rulestruct[counters->rulecount].brointel_file_name = 1;
-                                            rulestruct[counters->rulecount].brointel_flag = 1;
+                                            gen->rulestruct[gen->rulecount].brointel_file_name = 1;
+                                            gen->rulestruct[gen->rulecount].brointel_flag = 1;
                                             found = 1;
                                         }
 
                                     if (!strcmp(tmptoken, "cert_hash"))
                                         {
-                                            rulestruct[counters->rulecount].brointel_cert_hash = 1;
-                                            rulestruct[counters->rulecount].brointel_flag = 1;
+                                            gen->rulestruct[gen->rulecount].brointel_cert_hash = 1;
+                                            gen->rulestruct[gen->rulecount].brointel_flag = 1;
                                             found = 1;
                                         }
 
@@ -3186,8 +3210,8 @@ void Load_Rules( const char *ruleset )
                                     Sagan_Log(ERROR, "[%s, line %d] %s at line %d has 'external' option but external program '%s' is not executable, Abort", __FILE__, __LINE__, ruleset_fullname, linecount, tok_tmp);
                                 }
 
-                            rulestruct[counters->rulecount].external_flag = 1;
-                            strlcpy(rulestruct[counters->rulecount].external_program, tok_tmp, sizeof(rulestruct[counters->rulecount].external_program));
+                            gen->rulestruct[gen->rulecount].external_flag = 1;
+                            strlcpy(gen->rulestruct[gen->rulecount].external_program, tok_tmp, sizeof(gen->rulestruct[gen->rulecount].external_program));
 
                         }
 
@@ -3223,25 +3247,25 @@ void Load_Rules( const char *ruleset )
 
                                                     if ( Sagan_strstr(tmptoken, "by_src" ))
                                                         {
-                                                            rulestruct[counters->rulecount].bluedot_ipaddr_type  = 1;
+                                                            gen->rulestruct[gen->rulecount].bluedot_ipaddr_type  = 1;
                                                         }
 
                                                     if ( Sagan_strstr(tmptoken, "by_dst" ))
                                                         {
-                                                            rulestruct[counters->rulecount].bluedot_ipaddr_type  = 2;
+                                                            gen->rulestruct[gen->rulecount].bluedot_ipaddr_type  = 2;
                                                         }
 
                                                     if ( Sagan_strstr(tmptoken, "both" ))
                                                         {
-                                                            rulestruct[counters->rulecount].bluedot_ipaddr_type  = 3;
+                                                            gen->rulestruct[gen->rulecount].bluedot_ipaddr_type  = 3;
                                                         }
 
                                                     if ( Sagan_strstr(tmptoken, "all" ))
                                                         {
-                                                            rulestruct[counters->rulecount].bluedot_ipaddr_type  = 4;
+                                                            gen->rulestruct[gen->rulecount].bluedot_ipaddr_type  = 4;
                                                         }
 
-                                                    if ( rulestruct[counters->rulecount].bluedot_ipaddr_type == 0 )
+                                                    if ( gen->rulestruct[gen->rulecount].bluedot_ipaddr_type == 0 )
                                                         {
                                                             Sagan_Log(ERROR, "[%s, line %d] No Bluedot by_src, by_dst, both or all specified in %s at line %d, Abort.", __FILE__, __LINE__, ruleset_fullname, linecount);
                                                         }
@@ -3287,7 +3311,7 @@ void Load_Rules( const char *ruleset )
                                                                     Sagan_Log(ERROR, "[%s, line %d] %s at line %d has no or invalid Bluedot timeframe, Abort.", __FILE__, __LINE__, ruleset_fullname, linecount);
                                                                 }
 
-                                                            rulestruct[counters->rulecount].bluedot_mdate_effective_period = Value_To_Seconds(bluedot_type, bluedot_time_u32);
+                                                            gen->rulestruct[gen->rulecount].bluedot_mdate_effective_period = Value_To_Seconds(bluedot_type, bluedot_time_u32);
                                                         }
                                                     else if (Sagan_strstr(tmptoken, "cdate_effective_period" ))
                                                         {
@@ -3315,15 +3339,15 @@ void Load_Rules( const char *ruleset )
                                                                     Sagan_Log(ERROR, "[%s, line %d] %s at line %d has no or invalid Bluedot timeframe, Abort", __FILE__, __LINE__, ruleset_fullname, linecount);
                                                                 }
 
-                                                            rulestruct[counters->rulecount].bluedot_cdate_effective_period = Value_To_Seconds(bluedot_type, bluedot_time_u32);
+                                                            gen->rulestruct[gen->rulecount].bluedot_cdate_effective_period = Value_To_Seconds(bluedot_type, bluedot_time_u32);
                                                         }
 
                                                 }
                                             else
                                                 {
 
-                                                    rulestruct[counters->rulecount].bluedot_mdate_effective_period = 0;
-                                                    rulestruct[counters->rulecount].bluedot_cdate_effective_period = 0;
+                                                    gen->rulestruct[gen->rulecount].bluedot_mdate_effective_period = 0;
+                                                    gen->rulestruct[gen->rulecount].bluedot_cdate_effective_period = 0;
 
                                                 }
 
@@ -3336,14 +3360,14 @@ void Load_Rules( const char *ruleset )
 
                                             Remove_Spaces(tmptoken);
 
-                                            Sagan_Verify_Categories( tmptoken, counters->rulecount, ruleset_fullname, linecount, BLUEDOT_LOOKUP_IP);
+                                            Sagan_Verify_Categories( tmptoken, gen->rulecount, ruleset_fullname, linecount, BLUEDOT_LOOKUP_IP);
 
 
                                         }
 
                                     if ( Sagan_strstr(tmptoken, "ja3" ))
                                         {
-                                            rulestruct[counters->rulecount].bluedot_ja3 = true;
+                                            gen->rulestruct[gen->rulecount].bluedot_ja3 = true;
 
                                             tmptok_tmp = strtok_r(NULL, ";", &saveptrrule2);   /* Support var's */
 
@@ -3354,13 +3378,13 @@ void Load_Rules( const char *ruleset )
 
                                             Var_To_Value(tmptok_tmp, tmp1, sizeof(tmp1));
 
-                                            Sagan_Verify_Categories( tmp1, counters->rulecount, ruleset_fullname, linecount, BLUEDOT_LOOKUP_HASH);
+                                            Sagan_Verify_Categories( tmp1, gen->rulecount, ruleset_fullname, linecount, BLUEDOT_LOOKUP_HASH);
                                         }
 
 
                                     if ( Sagan_strstr(tmptoken, "file_hash" ))
                                         {
-                                            rulestruct[counters->rulecount].bluedot_file_hash = true;
+                                            gen->rulestruct[gen->rulecount].bluedot_file_hash = true;
 
                                             tmptok_tmp = strtok_r(NULL, ";", &saveptrrule2);   /* Support var's */
 
@@ -3371,13 +3395,13 @@ void Load_Rules( const char *ruleset )
 
                                             Var_To_Value(tmptok_tmp, tmp1, sizeof(tmp1));
 
-                                            Sagan_Verify_Categories( tmp1, counters->rulecount, ruleset_fullname, linecount, BLUEDOT_LOOKUP_HASH);
+                                            Sagan_Verify_Categories( tmp1, gen->rulecount, ruleset_fullname, linecount, BLUEDOT_LOOKUP_HASH);
                                         }
 
                                     if ( Sagan_strstr(tmptoken, "url" ))
 
                                         {
-                                            rulestruct[counters->rulecount].bluedot_url = true;
+                                            gen->rulestruct[gen->rulecount].bluedot_url = true;
 
                                             tmptok_tmp = strtok_r(NULL, ";", &saveptrrule2);   /* Support var's */
 
@@ -3388,13 +3412,13 @@ void Load_Rules( const char *ruleset )
 
                                             Var_To_Value(tmptok_tmp, tmp1, sizeof(tmp1));
 
-                                            Sagan_Verify_Categories( tmp1, counters->rulecount, ruleset_fullname, linecount, BLUEDOT_LOOKUP_URL);
+                                            Sagan_Verify_Categories( tmp1, gen->rulecount, ruleset_fullname, linecount, BLUEDOT_LOOKUP_URL);
                                         }
 
 
                                     if ( Sagan_strstr(tmptoken, "filename" ))
                                         {
-                                            rulestruct[counters->rulecount].bluedot_filename = true;
+                                            gen->rulestruct[gen->rulecount].bluedot_filename = true;
 
                                             tmptok_tmp = strtok_r(NULL, ";", &saveptrrule2);   /* Support var's */
 
@@ -3405,7 +3429,7 @@ void Load_Rules( const char *ruleset )
 
                                             Var_To_Value(tmptok_tmp, tmp1, sizeof(tmp1));
 
-                                            Sagan_Verify_Categories( tmp1, counters->rulecount, ruleset_fullname, linecount, BLUEDOT_LOOKUP_FILENAME);
+                                            Sagan_Verify_Categories( tmp1, gen->rulecount, ruleset_fullname, linecount, BLUEDOT_LOOKUP_FILENAME);
                                         }
 
                                     /* Error  check (  set flag? */
@@ -3480,7 +3504,7 @@ void Load_Rules( const char *ruleset )
 
                                 }
 
-                            strlcpy(rulestruct[counters->rulecount].metadata_json, json_object_to_json_string(metadata_jobj), sizeof(rulestruct[counters->rulecount].metadata_json));
+                            strlcpy(gen->rulestruct[gen->rulecount].metadata_json, json_object_to_json_string(metadata_jobj), sizeof(gen->rulestruct[gen->rulecount].metadata_json));
 
                         }
 
@@ -3531,40 +3555,55 @@ void Load_Rules( const char *ruleset )
             if ( debug->debugload )
                 {
 
-                    Sagan_Log(DEBUG, "---[Rule %" PRIu64 "]------------------------------------------------------", rulestruct[counters->rulecount].s_sid);
+                    Sagan_Log(DEBUG, "---[Rule %" PRIu64 "]------------------------------------------------------", gen->rulestruct[gen->rulecount].s_sid);
 
 
-                    Sagan_Log(DEBUG, "= Position: %d", counters->rulecount);
-                    Sagan_Log(DEBUG, "= SID: %" PRIu64 "", rulestruct[counters->rulecount].s_sid);
-                    Sagan_Log(DEBUG, "= Rev: %d", rulestruct[counters->rulecount].s_rev);
-                    Sagan_Log(DEBUG, "= Msg: %s", rulestruct[counters->rulecount].s_msg);
-                    Sagan_Log(DEBUG, "= Pri: %d", rulestruct[counters->rulecount].s_pri);
-                    Sagan_Log(DEBUG, "= Classtype: %s", rulestruct[counters->rulecount].s_classtype);
-                    Sagan_Log(DEBUG, "= Drop: %d", rulestruct[counters->rulecount].drop);
-                    Sagan_Log(DEBUG, "= default_dst_port: %d", rulestruct[counters->rulecount].default_dst_port);
+                    Sagan_Log(DEBUG, "= Position: %d", gen->rulecount);
+                    Sagan_Log(DEBUG, "= SID: %" PRIu64 "", gen->rulestruct[gen->rulecount].s_sid);
+                    Sagan_Log(DEBUG, "= Rev: %d", gen->rulestruct[gen->rulecount].s_rev);
+                    Sagan_Log(DEBUG, "= Msg: %s", gen->rulestruct[gen->rulecount].s_msg);
+                    Sagan_Log(DEBUG, "= Pri: %d", gen->rulestruct[gen->rulecount].s_pri);
+                    Sagan_Log(DEBUG, "= Classtype: %s", gen->rulestruct[gen->rulecount].s_classtype);
+                    Sagan_Log(DEBUG, "= Drop: %d", gen->rulestruct[gen->rulecount].drop);
+                    Sagan_Log(DEBUG, "= default_dst_port: %d", gen->rulestruct[gen->rulecount].default_dst_port);
 
-                    if ( rulestruct[counters->rulecount].s_find_src_ip != 0 )
+                    if ( gen->rulestruct[gen->rulecount].s_find_src_ip != 0 )
                         {
                             Sagan_Log(DEBUG, "= parse_src_ip");
                         }
 
-                    if ( rulestruct[counters->rulecount].s_find_port != 0 )
+                    if ( gen->rulestruct[gen->rulecount].s_find_port != 0 )
                         {
                             Sagan_Log(DEBUG, "= parse_port");
                         }
 
                     for (i=0; i<content_count; i++)
                         {
-                            Sagan_Log(DEBUG, "= [%d] content: \"%s\"", i, rulestruct[counters->rulecount].content[i]);
+                            Sagan_Log(DEBUG, "= [%d] content: \"%s\"", i, gen->rulestruct[gen->rulecount].content[i]);
                         }
 
                     for (i=0; i<ref_count; i++)
                         {
-                            Sagan_Log(DEBUG, "= [%d] reference: \"%s\"", i,  rulestruct[counters->rulecount].s_reference[i]);
+                            Sagan_Log(DEBUG, "= [%d] reference: \"%s\"", i,  gen->rulestruct[gen->rulecount].s_reference[i]);
                         }
                 }
 
-            __atomic_add_fetch(&counters->rulecount, 1,  __ATOMIC_SEQ_CST);
+            /* Move the variable length parts of the rule to the arena */
+
+            Rule_Arena_Commit( &gen->rulestruct[gen->rulecount] );
+
+            JSON_Index_Compile( gen->rulecount );
+
+            /* Fields used for every event go into the hot rule table.  Rule
+               files parsed in parallel are added when they are merged (see
+               rule-load.c) */
+
+            if ( gen->staging == false )
+                {
+                    Rule_Table_Add( gen->rulecount );
+                }
+
+            __atomic_add_fetch(&gen->rulecount, 1,  __ATOMIC_SEQ_CST);
 
         } /* end of while loop */
 
@@ -68,20 +68,27 @@ struct arr_port_2
     int hi;
 };
 
+/* The converted strings are stored in the rule arena (see rule-arena.c).
+   Only "meta_counter" entries are allocated. */
+
 typedef struct meta_content_conversion meta_content_conversion;
 struct meta_content_conversion
 {
-    char meta_content_converted[MAX_META_CONTENT_ITEMS][256];
+    char (*meta_content_converted)[256];
     int  meta_counter;
 };
 
 typedef struct json_meta_content_conversion json_meta_content_conversion;
 struct json_meta_content_conversion
 {
-    char json_meta_content_converted[MAX_JSON_META_CONTENT_ITEMS][256];
+    char (*json_meta_content_converted)[256];
     int  json_meta_counter;
 };
 
+/* Variable length parts of a rule.  While a rule is being parsed these
+   point to full sized scratch space.  Once the rule is complete,  only what
+   the rule uses is copied into the rule arena.  See rule-arena.c */
+
 
 typedef struct _Rule_Struct _Rule_Struct;
 struct _Rule_Struct
@@ -93,8 +100,8 @@ struct _Rule_Struct
     pcre *re_pcre[MAX_PCRE];
     pcre_extra *pcre_extra[MAX_PCRE];
 
-    char content[MAX_CONTENT][256];
-    char s_reference[MAX_REFERENCE][256];
+    char (*content)[256];			/* content_count */
+    char (*s_reference)[256];			/* ref_count */
     char s_classtype[32];
     uint64_t s_sid;
     uint32_t s_rev;
@@ -105,7 +112,9 @@ struct _Rule_Struct
     char s_level[25];
     char s_tag[MAX_SYSLOG_TAG_SIZE];
 
-    char event_id[MAX_EVENT_ID][32];
+    char (*event_id)[32];			/* event_id_count */
+    uint32_t *event_id_hash;			/* Sorted,  see Event_ID_Compile() */
+    unsigned char *event_id_index;		/* event_id_hash[i] is event_id[event_id_index[i]] */
 
     char email[255];
     bool email_flag;
@@ -114,14 +123,14 @@ struct _Rule_Struct
     char  dynamic_ruleset[MAXPATH];
 
     /* Check Flow */
-    struct arr_flow_1 flow_1[MAX_CHECK_FLOWS];
-    struct arr_flow_2 flow_2[MAX_CHECK_FLOWS];
+    struct arr_flow_1 *flow_1;			/* flow_1_counter */
+    struct arr_flow_2 *flow_2;			/* flow_2_counter */
 
-    struct arr_port_1 port_1[MAX_CHECK_FLOWS];
-    struct arr_port_2 port_2[MAX_CHECK_FLOWS];
+    struct arr_port_1 *port_1;			/* port_1_counter */
+    struct arr_port_2 *port_2;			/* port_2_counter */
 
-    struct meta_content_conversion meta_content_containers[MAX_META_CONTENT];
-    struct json_meta_content_conversion json_meta_content_containers[MAX_JSON_META_CONTENT];
+    struct meta_content_conversion *meta_content_containers;		/* meta_content_count */
+    struct json_meta_content_conversion *json_meta_content_containers;	/* json_meta_content_count */
 
     int direction;
 
@@ -132,13 +141,13 @@ struct _Rule_Struct
 
     bool has_flow;
 
-    int flow_1_type[MAX_CHECK_FLOWS];
-    int flow_2_type[MAX_CHECK_FLOWS];
+    int *flow_1_type;				/* 1 based,  flow_1_counter + 1 */
+    int *flow_2_type;
     int flow_1_counter;
     int flow_2_counter;
 
-    int port_1_type[MAX_CHECK_FLOWS];
-    int port_2_type[MAX_CHECK_FLOWS];
+    int *port_1_type;				/* 1 based,  port_1_counter + 1 */
+    int *port_2_type;
     int port_1_counter;
     int port_2_counter;
 
@@ -272,11 +281,12 @@ struct _Rule_Struct
     bool meta_content_not[MAX_META_CONTENT];
 
     //char meta_content[MAX_META_CONTENT][CONFBUF];
-    char meta_content_help[MAX_META_CONTENT][CONFBUF];
+    char (*meta_content_help)[CONFBUF];		/* meta_content_count */
 
     bool json_content_not[MAX_JSON_CONTENT];
-    char json_content_key[MAX_JSON_CONTENT][128];
-    char json_content_content[MAX_JSON_CONTENT][1024];
+    char (*json_content_key)[128];		/* json_content_count */
+    uint32_t *json_content_key_hash;		/* See JSON_Index_Compile() */
+    char (*json_content_content)[1024];
     int  json_content_count;
     bool json_content_case[MAX_JSON_CONTENT];
     bool json_content_strstr[MAX_JSON_CONTENT];
@@ -284,13 +294,15 @@ struct _Rule_Struct
     pcre *json_re_pcre[MAX_JSON_PCRE];
     pcre_extra *json_pcre_extra[MAX_JSON_PCRE];
     int  json_pcre_count;
-    char json_pcre_key[MAX_JSON_PCRE][128];
+    char (*json_pcre_key)[128];			/* json_pcre_count */
+    uint32_t *json_pcre_key_hash;
 
 
     bool json_meta_content_case[MAX_JSON_META_CONTENT];
     bool json_meta_content_not[MAX_JSON_META_CONTENT];
     bool json_meta_strstr[MAX_JSON_META_CONTENT];
-    char json_meta_content_key[MAX_JSON_META_CONTENT][128];
+    char (*json_meta_content_key)[128];		/* json_meta_content_count */
+    uint32_t *json_meta_content_key_hash;
     int  json_meta_content_count;
     unsigned char json_meta_content_converted_count;
 
@@ -303,6 +315,8 @@ struct _Rule_Struct
     int	 aetas_start;
     int  aetas_end;
 
+    unsigned char *aetas_week;		/* AETAS_MINUTES bit "minute of the week" map */
+
     int  alert_end_hour;
     int  alert_end_minute;
 
@@ -133,6 +133,19 @@ struct _SaganConfig
     bool 	 fast_flag;
     char         fast_filename[MAXPATH];
 
+    bool	 rule_order_adaptive;		/* rule-ordering: adaptive */
+
+    bool	 rule_eval_batch;		/* rule-evaluation: batch */
+
+    bool	 rule_profile_flag;		/* rule-profiling */
+    int		 rule_profile_top;
+
+    bool	 template_cache_flag;		/* template-cache */
+    uint64_t	 template_cache_size;		/* template-cache-size */
+
+    char	 rule_image[MAXPATH];		/* rule-image */
+    char	 rule_image_compile[MAXPATH];	/* --compile-rules */
+
     bool	 parse_ip_ipv6;
     bool	 parse_ip_ipv4_mapped_ipv6;
 
@@ -196,6 +209,9 @@ struct _SaganConfig
     int		shm_flexbit;
     bool	shm_flexbit_status;
 
+    int		shm_flexbit_group;
+    bool	shm_flexbit_group_status;
+
     int		shm_xbit;
     bool        shm_xbit_status;
 
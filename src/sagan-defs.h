@@ -44,7 +44,7 @@ typedef void json_object;
 
 #define SENSOR_NAME		"default_sensor_name"
 #define CLUSTER_NAME		"default_cluster_name"
-#define MMAP_VERSION		2.0
+#define MMAP_VERSION		3.0
 
 #define CLASSBUF		1024
 #define RULEBUF			5128
@@ -78,6 +78,7 @@ typedef void json_object;
 #define JSON_MAX_OBJECTS        256
 #define JSON_MAX_KEY_SIZE       64
 #define JSON_MAX_VALUE_SIZE	2048
+#define JSON_INDEX_SIZE		512		/* Per event key hash table.  Power of 2,  > JSON_MAX_OBJECTS */
 
 #define DEFAULT_JSON_INPUT_MAP          "/usr/local/etc/sagan-rules/json-input.map"
 #define INPUT_PIPE                      1
@@ -136,11 +137,15 @@ typedef void json_object;
 #define MAX_REFERENCE		10		/* Max references within a rule */
 #define MAX_PARSE_IP		30		/* Max IP to collect form log line via parse.c */
 
+#define CLOCK_RESOLUTION	1000		/* Cached clock refresh in microseconds (see util-time.c) */
+
 /* TODO: These need to be labeled better! These directly affect
    functions like is_notroutable(). Think before you alter */
 
 #define MAXIP			64		/* Max IP length */
 #define MAXIPBIT	     	16		/* Max IP length in bytes */
+#define IP_HASH_SEED		2166136261U	/* FNV-1a offset basis,  see IP_Hash() */
+#define IP_HASH64_SEED		14695981039346656037ULL	/* 64 bit FNV-1a offset basis */
 
 #define LOCKFILE 		"/var/run/sagan/sagan.pid"
 #define SAGANLOG		"/var/log/sagan/sagan.log"
@@ -184,6 +189,8 @@ typedef void json_object;
 #define FRIDAY			32
 #define SATURDAY		64
 
+#define AETAS_MINUTES		10080		/* Minutes in a week,  see Aetas_Compile() */
+
 /* This is for loading/reloading Sagan log files */
 
 #define OPEN			0
@@ -208,6 +215,7 @@ typedef void json_object;
 
 #define COUNTERS_IPC_FILE 		"sagan-counters.shared"
 #define FLEXBIT_IPC_FILE 	        "sagan-flexbits.shared"
+#define FLEXBIT_GROUP_IPC_FILE		"sagan-flexbits-group.shared"
 #define XBIT_IPC_FILE			"sagan-xbits.shared"
 #define THRESH_BY_SRC_IPC_FILE 		"sagan-thresh-by-source.shared"
 #define THRESH_BY_DST_IPC_FILE 		"sagan-thresh-by-destination.shared"
@@ -240,6 +248,18 @@ typedef void json_object;
 #define NORMAL_RULE			0
 #define DYNAMIC_RULE			1
 
+#define RULE_HEADER_CACHE		8192		/* Rule header filter results cached per event (see rule-table.c) */
+
+#define RULE_PROFILE_DEFAULT_TOP	20		/* Rules reported when "rule-profiling-top" isn't set */
+
+#define TEMPLATE_CACHE_DEFAULT_SIZE	65536		/* "template-cache-size" default (rounded up to a power of 2) */
+
+#define ENGINE_BATCH_MAX		16		/* Events evaluated together with "rule-evaluation: batch" */
+
+#define ENGINE_DEFER_TICK		5000		/* flexbits/xbits pause timer wheel resolution in microseconds */
+#define ENGINE_DEFER_SLOTS		1024		/* Timer wheel slots (one turn is ~5 seconds) */
+#define ENGINE_DEFER_MAX		4096		/* Most events parked by a pause at once */
+
 #define FLEXBIT_STORAGE_MMAP		0
 #define FLEXBIT_STORAGE_REDIS		1
 
@@ -69,6 +69,7 @@
 #include "stats.h"
 #include "ipc.h"
 #include "tracking-syslog.h"
+#include "util-time.h"
 #include "parsers/parsers.h"
 
 #include "input-pipe.h"
@@ -88,6 +89,9 @@
 
 #include "processors/engine.h"
 #include "rules.h"
+#include "rule-arena.h"
+#include "rule-generation.h"
+#include "rule-image.h"
 #include "processors/blacklist.h"
 #include "processors/track-clients.h"
 #include "processors/perfmon.h"
@@ -117,7 +121,6 @@ struct _JSON_Message_Map *JSON_Message_Map = NULL;
 
 /* Already Init'ed */
 
-struct _Rule_Struct *rulestruct;
 struct _Sagan_Ignorelist *SaganIgnorelist;
 
 #ifdef WITH_BLUEDOT
@@ -147,6 +150,8 @@ pthread_mutex_t SaganRulesLoadedMutex=PTHREAD_MUTEX_INITIALIZER;
 int main(int argc, char **argv)
 {
 
+    const struct _Rule_Generation *gen = NULL;
+
     (void)SetThreadName("SaganMain");
 
     const struct option long_options[] =
@@ -161,11 +166,12 @@ int main(int argc, char **argv)
         { "log",          required_argument,    NULL,   'l' },
         { "file",	  required_argument,    NULL,   'F' },
         { "quiet", 	  no_argument, 		NULL, 	'Q' },
+        { "compile-rules", required_argument,   NULL,   'R' },
         {0, 0, 0, 0}
     };
 
     static const char *short_options =
-        "l:f:u:F:d:c:pDhCQ";
+        "l:f:u:F:d:c:R:pDhCQ";
 
     int option_index = 0;
 
@@ -229,6 +235,13 @@ int main(int argc, char **argv)
     sigfillset( &signal_set );
     pthread_sigmask( SIG_BLOCK, &signal_set, NULL );
 
+    /* Cached clock (see util-time.c) */
+
+    pthread_t clock_thread;
+    pthread_attr_t clock_thread_attr;
+    pthread_attr_init(&clock_thread_attr);
+    pthread_attr_setdetachstate(&clock_thread_attr,  PTHREAD_CREATE_DETACHED);
+
     /* Key board handler (displays stats, etc */
 
     pthread_t key_thread;
@@ -335,6 +348,8 @@ int main(int argc, char **argv)
 
 #endif
 
+    Clock_Init();
+
     t = time(NULL);
     run=localtime(&t);
     strftime(config->sagan_startutime, sizeof(config->sagan_startutime), "%s",  run);
@@ -566,6 +581,10 @@ int main(int argc, char **argv)
                     strlcpy(config->sagan_log_filepath,optarg,sizeof(config->sagan_log_filepath) - 1);
                     break;
 
+                case 'R':
+                    strlcpy(config->rule_image_compile,optarg,sizeof(config->rule_image_compile) - 1);
+                    break;
+
                 default:
                     fprintf(stderr, "Invalid argument! See below for command line switches.\n");
                     Usage();
@@ -675,6 +694,16 @@ int main(int argc, char **argv)
             Sagan_Log(ERROR, "[%s, line %d] Error creating signal handler thread. [error: %d]", __FILE__, __LINE__, rc);
         }
 
+    /* The clock thread is also started after the fork() */
+
+    rc = pthread_create( &clock_thread, &clock_thread_attr, (void *)Clock_Thread, NULL );
+
+    if ( rc != 0  )
+        {
+            Remove_Lock_File();
+            Sagan_Log(ERROR, "[%s, line %d] Error creating clock thread. [error: %d]", __FILE__, __LINE__, rc);
+        }
+
 
 #ifdef PCRE_HAVE_JIT
 
@@ -692,10 +721,22 @@ int main(int argc, char **argv)
 
 #endif
 
+    Rule_Generation_Init();
+
     pthread_mutex_lock(&SaganRulesLoadedMutex);
     (void)Load_YAML_Config(config->sagan_config);
     pthread_mutex_unlock(&SaganRulesLoadedMutex);
 
+    Load_YAML_Rules();
+
+    /* --compile-rules only writes the rule image.  See rule-image.c */
+
+    if ( config->rule_image_compile[0] != '\0' )
+        {
+            Rule_Image_Write( config->rule_image_compile );
+            exit(0);
+        }
+
     (void)Sagan_Engine_Init();
 
     SaganPassSyslog = malloc(config->max_processor_threads * sizeof(_Sagan_Pass_Syslog));
@@ -733,8 +774,11 @@ int main(int argc, char **argv)
 
 #endif
 
-    Sagan_Log(NORMAL, "Configuration file %s loaded and %d rules loaded.", config->sagan_config, counters->rulecount);
-    Sagan_Log(NORMAL, "There are %d rules loaded.", counters->rulecount);
+    gen = Rule_Generation_Current();
+
+    Sagan_Log(NORMAL, "Configuration file %s loaded and %d rules loaded.", config->sagan_config, gen->rulecount);
+    Sagan_Log(NORMAL, "There are %d rules loaded.", gen->rulecount);
+    Sagan_Log(NORMAL, "Rules are using %lu bytes of memory (%lu bytes in the rule arena).", (unsigned long)(gen->rulecount * sizeof(_Rule_Struct) + Rule_Arena_Size()), (unsigned long)Rule_Arena_Size());
     Sagan_Log(NORMAL, "%d flexbit(s) are in use.", counters->flexbit_total_counter);
     Sagan_Log(NORMAL, "%d xbit(s) are in use.", counters->xbit_total_counter);
     Sagan_Log(NORMAL, "%d dynamic rule(s) are loaded.", counters->dynamic_rule_count);
@@ -93,6 +93,21 @@ size_t strlcpy(char *, const char *, size_t );
 #define SetThreadName(n) (0)
 #endif
 
+/* An IP address as it's handed from the engine to the state trackers
+   (xbits, flexbits, threshold, after),  GeoIP,  Bluedot and Send_Alert().
+   The string is parsed once per event.  "text" points at the string the
+   address came from.  If there isn't one,  IP_Text() formats "bits" into
+   "text_buf" the first time the text is needed. */
+
+typedef struct _Sagan_IP _Sagan_IP;
+struct _Sagan_IP
+{
+    unsigned char bits[MAXIPBIT];
+    int  family;			/* IPv4,  IPv6 or 0 if not an IP address */
+    char *text;
+    char text_buf[MAXIP];
+};
+
 bool     Is_Numeric (char *);
 void      To_UpperC(char* const );
 void      To_LowerC(char* const );
@@ -111,6 +126,11 @@ void      Droppriv( void );
 int       DNS_Lookup( char *, char *str, size_t size );
 void      Var_To_Value(char *, char *str, size_t size);
 bool     IP2Bit (char *, unsigned char * );
+int      IP_Parse ( const char *, unsigned char * );
+int      IP_Set ( struct _Sagan_IP *, char * );
+char     *IP_Text ( struct _Sagan_IP * );
+uint32_t  IP_Hash ( struct _Sagan_IP *, uint32_t );
+uint64_t  IP_Hash64 ( struct _Sagan_IP *, uint64_t );
 bool     Mask2Bit (int, unsigned char * );
 const char *Bit2IP(unsigned char *, char *str, size_t size);
 bool     Validate_HEX (const char *);
@@ -129,6 +149,8 @@ bool     File_Lock ( int );
 bool     File_Unlock ( int );
 bool     Check_Content_Not( char * );
 uint32_t  Djb2_Hash( char * );
+uint32_t  Fnv1a_Hash( const void *, size_t, uint32_t );
+uint64_t  Fnv1a_Hash64( const void *, size_t, uint64_t );
 bool     Starts_With(const char *str, const char *prefix);
 char      *strrpbrk(const char *str, const char *accept);
 bool Is_IP_Range (char *str);
@@ -210,7 +232,17 @@ struct _SaganCounters
 
     uint64_t worker_thread_exhaustion;
 
-    int	     ruleset_track_count;
+    uint64_t hot_path_alloc;		/* Sagan's own hot path allocations (not libraries') */
+
+    uint64_t engine_deferred;		/* Rule evaluations parked by flexbits/xbits pause */
+    uint64_t engine_defer_full;		/* ... that had to block because the wheel was full */
+
+    uint64_t template_cache_lookup;	/* "template-cache" */
+    uint64_t template_cache_hit;
+
+    uint64_t dynamic_load_count;		/* Rule sets loaded by the "SaganDynLoad" thread */
+    uint64_t rule_epoch_retired;		/* Rule arrays replaced while running (see rule-epoch.c) */
+
 
     uint64_t blacklist_hit_count;
     uint64_t blacklist_lookup_count;
@@ -228,12 +260,8 @@ struct _SaganCounters
     int	     dynamic_rule_count;
 
     int	     classcount;
-    int      rulecount;
-    int	     refcount;
     int      ruletotal;
 
-    int      genmapcount;
-
     int      mapcount_message;
     int      mapcount_program;
 
@@ -400,6 +428,11 @@ struct _Sagan_Proc_Syslog
     uint64_t flow_id;
 
     char event_id[32];
+
+    bool event_id_done;			/* event_id_key/event_id_hash are set (see event-id.c) */
+    uint32_t event_id_hash;
+    char event_id_key[32];			/* event_id,  or the " 1234: " at the front of the message */
+
     char md5[MD5_HASH_SIZE+1];
     char sha1[SHA1_HASH_SIZE+1];
     char sha256[SHA256_HASH_SIZE+1];
@@ -412,6 +445,12 @@ struct _Sagan_Proc_Syslog
     char json_key[JSON_MAX_OBJECTS][JSON_MAX_KEY_SIZE];
     char json_value[JSON_MAX_OBJECTS][JSON_MAX_VALUE_SIZE];
 
+    bool json_index_done;				/* json_key lookup table (see json-index.c) */
+    uint16_t json_index[JSON_INDEX_SIZE];		/* json_key position + 1,  0 == empty */
+    uint16_t json_next[JSON_MAX_OBJECTS];		/* Next position with the same key + 1 */
+    uint32_t json_key_hash[JSON_MAX_OBJECTS];
+    uint32_t json_value_len[JSON_MAX_OBJECTS];
+
 };
 
 typedef struct _Sagan_Pass_Syslog _Sagan_Pass_Syslog;
@@ -529,7 +568,7 @@ typedef struct _Threshold2_IPC _Threshold2_IPC;
 struct _Threshold2_IPC
 {
 
-    uint32_t hash;
+    uint64_t hash;
 
     bool threshold2_method_src;
     bool threshold2_method_dst;
@@ -559,7 +598,7 @@ typedef struct _After2_IPC _After2_IPC;
 struct _After2_IPC
 {
 
-    uint32_t hash;
+    uint64_t hash;
 
     bool after2_method_src;
     bool after2_method_dst;
@@ -614,6 +653,7 @@ struct _Sagan_Lookup_Cache_Entry
 {
     char ip[MAXIP];
     unsigned char ip_bits[MAXIPBIT];
+    int  family;
     int  port;
     unsigned char proto;
     bool status;
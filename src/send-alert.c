@@ -29,30 +29,46 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <stddef.h>
 #include "sagan.h"
+#include "sagan-defs.h"
 #include "version.h"
 
 #include "output.h"
 #include "gen-msg.h"
+#include "routing.h"
+#include "event-cache.h"
+
+#ifdef HAVE_LIBFASTJSON
+#include "input-json.h"
+#include "message-json-map.h"
+#endif
+
+#include "thread-context.h"
 
 #include "processors/engine.h"
 
 struct _SaganConfig *config;
 
-void Send_Alert ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, char *json_normalize, _Sagan_Processor_Info *processor_info, char *ip_src, char *ip_dst, char *normalize_http_uri, char *normalize_http_hostname, int proto, uint64_t sid, int src_port, int dst_port, int pos, struct timeval tp, char *bluedot_json, unsigned char bluedot_results  )
+void Send_Alert ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, char *json_normalize, _Sagan_Processor_Info *processor_info, struct _Sagan_IP *ip_src, struct _Sagan_IP *ip_dst, char *normalize_http_uri, char *normalize_http_hostname, int proto, uint64_t sid, int src_port, int dst_port, int pos, struct timeval tp, char *bluedot_json, unsigned char bluedot_results  )
 {
 
     char tmp[64] = { 0 };
 
-    struct _Sagan_Event *SaganProcessorEvent = NULL;
-    SaganProcessorEvent = malloc(sizeof(struct _Sagan_Event));
+    /* Output() is synchronous,  so the event can live in the thread context
+       and be reused.  Everything up to the hash/filename/url buffers is
+       cleared,  the buffers themselves only need to be empty strings */
 
-    if ( SaganProcessorEvent == NULL )
-        {
-            Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for SaganProcessorEvent. Abort!", __FILE__, __LINE__);
-        }
+    struct _Sagan_Event *SaganProcessorEvent = &Thread_Context()->SaganProcessorEvent;
+
+    memset(SaganProcessorEvent, 0, offsetof(struct _Sagan_Event, md5));
 
-    memset(SaganProcessorEvent, 0, sizeof(_Sagan_Event));
+    SaganProcessorEvent->md5[0] = '\0';
+    SaganProcessorEvent->sha1[0] = '\0';
+    SaganProcessorEvent->sha256[0] = '\0';
+    SaganProcessorEvent->filename[0] = '\0';
+    SaganProcessorEvent->hostname[0] = '\0';
+    SaganProcessorEvent->url[0] = '\0';
 
     if ( processor_info->processor_generator_id != SAGAN_PROCESSOR_GENERATOR_ID )
         {
@@ -78,8 +94,8 @@ void Send_Alert ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, char *json_normaliz
     SaganProcessorEvent->tag             =       processor_info->processor_tag;
     SaganProcessorEvent->rev             =       processor_info->processor_rev;
 
-    SaganProcessorEvent->ip_src          =       ip_src;
-    SaganProcessorEvent->ip_dst          =       ip_dst;
+    SaganProcessorEvent->ip_src          =       IP_Text(ip_src);
+    SaganProcessorEvent->ip_dst          =       IP_Text(ip_dst);
 
     SaganProcessorEvent->dst_port        =       dst_port;
     SaganProcessorEvent->src_port        =       src_port;
@@ -108,7 +124,6 @@ void Send_Alert ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, char *json_normaliz
 
 
     Output ( SaganProcessorEvent );
-    free(SaganProcessorEvent);
 
 }
 
@@ -38,6 +38,7 @@
 #include <errno.h>
 #include <stdbool.h>
 #include <errno.h>
+#include <sys/time.h>
 
 #ifdef HAVE_SYS_PRCTL_H
 #include <sys/prctl.h>
@@ -58,6 +59,11 @@
 
 #include "processors/perfmon.h"
 #include "rules.h"
+#include "rule-arena.h"
+#include "rule-table.h"
+#include "rule-generation.h"
+#include "rule-epoch.h"
+#include "rule-profile.h"
 #include "ignore-list.h"
 #include "flow.h"
 
@@ -66,6 +72,9 @@
 #include "processors/zeek-intel.h"
 #include "processors/client-stats.h"
 #include "processors/stats-json.h"
+#include "processors/engine-defer.h"
+#include "processors/dynamic-rules.h"
+#include "template-cache.h"
 
 #ifdef HAVE_LIBLOGNORM
 #include "liblognormalize.h"
@@ -89,10 +98,8 @@ struct _Sagan_Bluedot_Skip *Bluedot_Skip;
 struct _SaganCounters *counters;
 struct _SaganDebug *debug;
 struct _SaganConfig *config;
-struct _Rule_Struct *rulestruct;
 struct _Rules_Loaded *rules_loaded;
 struct _Class_Struct *classstruct;
-struct _Sagan_Processor_Generator *generator;
 struct _Sagan_Blacklist *SaganBlacklist;
 struct _Sagan_Track_Clients *SaganTrackClients;
 struct _SaganVar *var;
@@ -109,14 +116,20 @@ struct _Sagan_BroIntel_Intel_User_Name *Sagan_BroIntel_Intel_User_Name;
 struct _Sagan_BroIntel_Intel_File_Name *Sagan_BroIntel_Intel_File_Name;
 struct _Sagan_BroIntel_Intel_Cert_Hash *Sagan_BroIntel_Intel_Cert_Hash;
 
-pthread_mutex_t SaganReloadMutex = PTHREAD_MUTEX_INITIALIZER;
-pthread_cond_t SaganReloadCond = PTHREAD_COND_INITIALIZER;
-
 pthread_mutex_t SaganRulesLoadedMutex;
 
 bool death;
 int proc_running;
 
+/****************************************************************************
+ * Reload_Elapsed_MS - Milliseconds between two gettimeofday() calls
+ ****************************************************************************/
+
+static uint64_t Reload_Elapsed_MS( struct timeval *start, struct timeval *end )
+{
+    return( ( (uint64_t)( end->tv_sec - start->tv_sec ) * 1000000 + end->tv_usec - start->tv_usec ) / 1000 );
+}
+
 void Sig_Handler( void )
 {
 
@@ -131,6 +144,11 @@ void Sig_Handler( void )
 
     unsigned char max_death_time = 0;
 
+    struct timeval reload_start;
+    struct timeval reload_end;
+    struct timeval pause_start;
+    struct timeval pause_end;
+
 #ifdef HAVE_LIBPCAP
     bool orig_plog_value = 0;
 #endif
@@ -187,6 +205,11 @@ void Sig_Handler( void )
 
                     Statistics();
 
+                    if ( config->rule_profile_flag == true )
+                        {
+                            Rule_Profile_Report();
+                        }
+
 #ifdef HAVE_LIBMAXMINDDB
 
                     MMDB_close(&config->geoip2);
@@ -246,6 +269,16 @@ void Sig_Handler( void )
                                 }
                         }
 
+                    if ( config->shm_flexbit_group_status == true )
+                        {
+                            File_Unlock(config->shm_flexbit_group);
+
+                            if ( close(config->shm_flexbit_group) != 0 )
+                                {
+                                    Sagan_Log(WARN, "[%s, line %d] Cannot close IPC flexbit group! [%s]", __FILE__, __LINE__, strerror(errno));
+                                }
+                        }
+
                     if ( config->shm_thresh2_status == true )
                         {
                             File_Unlock(config->shm_thresh2);
@@ -302,7 +335,7 @@ void Sig_Handler( void )
 
                     config->sagan_reload = 1;				/* Only this thread can alter this */
 
-                    pthread_mutex_lock(&SaganReloadMutex);
+                    gettimeofday(&reload_start, NULL);
 
                     Sagan_Log(NORMAL, "[Reloading Sagan version %s.]-------", VERSION);
 
@@ -313,23 +346,36 @@ void Sig_Handler( void )
 
                     Open_Log_File(REOPEN, ALL_LOGS);
 
+                    /* Paused evaluations point at rule positions that are about to change,
+                       and a dynamic load in progress would be loading into them */
+
+                    Dynamic_Rules_Flush();
+                    Engine_Defer_Flush();
+
+                    /* Rules,  references and gen-msg are built into a new generation
+                       while the processor threads keep using the old one.  See
+                       rule-generation.c */
+
+                    Rule_Generation_Begin();
+
+                    /* Everything else is still reloaded in place,  so the processor
+                       threads are held (between log lines) until it is done */
+
+                    gettimeofday(&pause_start, NULL);
+
+                    Rule_Epoch_Pause();
+
                     /******************/
                     /* Reset counters */
                     /******************/
 
-                    __atomic_store_n (&counters->refcount, 0, __ATOMIC_SEQ_CST);
                     __atomic_store_n (&counters->classcount, 0, __ATOMIC_SEQ_CST);
-                    __atomic_store_n (&counters->rulecount, 0, __ATOMIC_SEQ_CST);
                     __atomic_store_n (&counters->ruletotal, 0, __ATOMIC_SEQ_CST);
-                    __atomic_store_n (&counters->genmapcount, 0, __ATOMIC_SEQ_CST);
                     __atomic_store_n (&counters->rules_loaded_count, 0, __ATOMIC_SEQ_CST);
                     __atomic_store_n (&counters->var_count, 0, __ATOMIC_SEQ_CST);
 
-
                     memset(rules_loaded, 0, sizeof(_Rules_Loaded));
-                    memset(rulestruct, 0, sizeof(_Rule_Struct));
                     memset(classstruct, 0, sizeof(_Class_Struct));
-                    memset(generator, 0, sizeof(_Sagan_Processor_Generator));
                     memset(var, 0, sizeof(_SaganVar));
 
                     /**********************************/
@@ -464,13 +510,15 @@ void Sig_Handler( void )
                         }
 
                     /************************************************************/
-                    /* Re-load primary configuration (rules/classifictions/etc) */
+                    /* Re-load primary configuration (classifictions/vars/etc)  */
                     /************************************************************/
 
                     pthread_mutex_lock(&SaganRulesLoadedMutex);
                     Load_YAML_Config(config->sagan_config);	/* <- RELOAD */
                     pthread_mutex_unlock(&SaganRulesLoadedMutex);
 
+                    Template_Cache_Init();
+
                     /************************************************************/
                     /* Re-load primary configuration (rules/classifictions/etc) */
                     /************************************************************/
@@ -571,13 +619,34 @@ void Sig_Handler( void )
                     Open_GeoIP2_Database();
 #endif
 
+                    gettimeofday(&pause_end, NULL);
+
+                    Rule_Epoch_Resume();
+
+                    /************************************************************/
+                    /* Build the new rules and swap them in                     */
+                    /************************************************************/
 
-                    pthread_cond_signal(&SaganReloadCond);
-                    pthread_mutex_unlock(&SaganReloadMutex);
+                    Load_YAML_Rules();
+
+                    Rule_Generation_Publish();
+
+                    /* Wait for the last reader of the old rules to let go.  Until
+                       then a verdict for the old rules could still be cached */
+
+                    Rule_Epoch_Synchronize();
+
+                    Template_Cache_Clear();
+                    Rule_Profile_Reset();
 
                     config->sagan_reload = 0;
 
-                    Sagan_Log(NORMAL, "Configuration reloaded.");
+                    gettimeofday(&reload_end, NULL);
+
+                    Sagan_Log(NORMAL, "Configuration reloaded. %d rules loaded in %lu ms (processing paused for %lu ms).",
+                              Rule_Generation_Current()->rulecount,
+                              (unsigned long)Reload_Elapsed_MS(&reload_start, &reload_end),
+                              (unsigned long)Reload_Elapsed_MS(&pause_start, &pause_end));
                     break;
 
                 /* Signals to ignore */
@@ -588,6 +657,12 @@ void Sig_Handler( void )
 
                 case SIGUSR1:
                     Statistics();
+
+                    if ( config->rule_profile_flag == true )
+                        {
+                            Rule_Profile_Report();
+                        }
+
                     break;
 
                 default:
@@ -39,6 +39,9 @@
 #include "sagan-defs.h"
 #include "stats.h"
 #include "rules.h"
+#include "rule-generation.h"
+#include "rule-epoch.h"
+#include "util-time.h"
 #include "sagan-config.h"
 
 #include "processors/client-stats.h"
@@ -46,18 +49,16 @@
 
 struct _SaganCounters *counters;
 struct _Sagan_IPC_Counters *counters_ipc;
-struct _Sagan_Ruleset_Track *Ruleset_Track;
 struct _SaganConfig *config;
+struct _SaganDebug *debug;
 
 int proc_running; 	/* Count of executing threads */
 
 void Statistics( void )
 {
 
-    char timet[20];
+    const struct _Rule_Generation *gen = NULL;
 
-    time_t t;
-    struct tm *now;
     int seconds = 0;
     unsigned long total=0;
     int i;
@@ -82,10 +83,7 @@ void Statistics( void )
     /* This is used to calulate the events per/second */
     /* Champ Clark III - 11/17/2011 */
 
-    t = time(NULL);
-    now=localtime(&t);
-    strftime(timet, sizeof(timet), "%s",  now);
-    seconds = atol(timet) - atol(config->sagan_startutime);
+    seconds = Return_Epoch() - atol(config->sagan_startutime);
 
     /* if statement prevents floating point exception */
 
@@ -122,6 +120,26 @@ void Statistics( void )
 
             Sagan_Log(NORMAL, "           Thread Usage               : %d/%d (%.3f%%)", proc_running, config->max_processor_threads, CalcPct( proc_running, config->max_processor_threads ));
 
+            if ( debug->debugthreads )
+                {
+                    Sagan_Log(NORMAL, "           Engine Allocations         : %" PRIu64 " (excludes libraries)", counters->hot_path_alloc);
+                }
+
+            if ( config->template_cache_flag == true )
+                {
+                    Sagan_Log(NORMAL, "           Template Cache Hits        : %" PRIu64 "/%" PRIu64 " (%.3f%%)", counters->template_cache_hit, counters->template_cache_lookup, CalcPct( counters->template_cache_hit, counters->template_cache_lookup ) );
+                }
+
+            if ( counters->engine_deferred != 0 || counters->engine_defer_full != 0 )
+                {
+                    Sagan_Log(NORMAL, "           Paused Evaluations         : %" PRIu64 " (blocked: %" PRIu64 ")", counters->engine_deferred, counters->engine_defer_full);
+                }
+
+            if ( counters->dynamic_load_count != 0 )
+                {
+                    Sagan_Log(NORMAL, "           Dynamic Rule Sets Loaded   : %" PRIu64 " (arrays replaced: %" PRIu64 ")", counters->dynamic_load_count, counters->rule_epoch_retired);
+                }
+
             if (config->sagan_droplist_flag)
                 {
                     Sagan_Log(NORMAL, "           Ignored Input              : %" PRIu64 " (%.3f%%)", counters->ignore_count, CalcPct(counters->ignore_count, counters->events_received) );
@@ -318,14 +336,18 @@ void Statistics( void )
                     Sagan_Log(NORMAL, "          * Fired rules *");
                     Sagan_Log(NORMAL, "");
 
+                    Rule_Epoch_Enter();
+
+                    gen = Rule_Generation_Current();
+
                     flag = false;
 
-                    for ( i = 0; i < counters->ruleset_track_count; i++ )
+                    for ( i = 0; i < gen->ruleset_track_count; i++ )
                         {
 
-                            if ( Ruleset_Track[i].trigger == true )
+                            if ( gen->Ruleset_Track[i].trigger == true )
                                 {
-                                    Sagan_Log(NORMAL, "          %s",  Ruleset_Track[i].ruleset );
+                                    Sagan_Log(NORMAL, "          %s",  gen->Ruleset_Track[i].ruleset );
                                     flag = true;
                                 }
 
@@ -343,11 +365,11 @@ void Statistics( void )
                     Sagan_Log(NORMAL, "");
 
 
-                    for ( i = 0; i < counters->ruleset_track_count; i++ )
+                    for ( i = 0; i < gen->ruleset_track_count; i++ )
                         {
-                            if ( Ruleset_Track[i].trigger == false )
+                            if ( gen->Ruleset_Track[i].trigger == false )
                                 {
-                                    Sagan_Log(NORMAL, "          %s",  Ruleset_Track[i].ruleset );
+                                    Sagan_Log(NORMAL, "          %s",  gen->Ruleset_Track[i].ruleset );
                                     flag = true;
                                 }
                         }
@@ -356,6 +378,8 @@ void Statistics( void )
                         {
                             Sagan_Log(NORMAL, "          [All rules fired]");
                         }
+
+                    Rule_Epoch_Exit();
                 }
 
 
@@ -0,0 +1,231 @@
+/*
+** Copyright (C) 2009-2020 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2020 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* template-cache.c
+ *
+ * "template-cache".  Most logs are the same few message templates with only
+ * PIDs,  counters,  IPs,  times,  etc changing,  and most never match a rule.
+ * This remembers the templates that no rule can match so the rule scan can
+ * be skipped the next time they are seen.
+ *
+ * The key is a 64 bit FNV-1a hash of the header fields rules filter on
+ * (program,  facility,  level,  tag,  priority) and the message with every
+ * run of digits replaced by a single TEMPLATE_DIGITS marker.  The marker is
+ * not a byte value,  so a run of digits never hashes like any literal text
+ * (a '#' in the message,  for example).
+ *
+ * Only digits are masked.  Two messages with the same template then have the
+ * same non-digit text,  in the same order,  split in the same places.  A
+ * "content" or "meta_content" with no digits and no offset/depth/distance/
+ * within can only match inside that non-digit text,  so it gives the same
+ * answer for every message with the template.  Rules with anything else
+ * (pcre,  json_*,  event_id,  digits in a content,  etc) are flagged
+ * RULE_FLAG_TEMPLATE_UNSAFE by Rule_Table_Add().  A verdict is only recorded
+ * when no rule passed its checks and no unsafe rule got past the header
+ * filters.  Hex IDs that contain letters are not masked,  since a content
+ * could match the letters.
+ *
+ * The table is direct mapped and lock free.  A collision just replaces the
+ * older entry.  Template_Cache_Clear() (rule reload,  dynamic rules) bumps a
+ * generation that is part of the key,  so verdicts from before the clear,
+ * including any recorded by a rule scan that was running at the time,  can
+ * never be found again.  The engine reads the generation with
+ * Template_Cache_Epoch() before it looks at how many rules are loaded.  A
+ * scan that missed rules added before a clear then always records its
+ * verdict under the generation from before the clear.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <inttypes.h>
+
+#include "sagan.h"
+#include "sagan-defs.h"
+#include "sagan-config.h"
+#include "template-cache.h"
+
+struct _SaganConfig *config;
+struct _SaganCounters *counters;
+
+static uint64_t *Template_Cache = NULL;
+static uint64_t Template_Cache_Mask = 0;
+static uint32_t Template_Cache_Generation = 0;
+
+#define TEMPLATE_FNV_OFFSET	14695981039346656037ULL
+#define TEMPLATE_FNV_PRIME	1099511628211ULL
+#define TEMPLATE_DIGITS		0x100			/* Run of digits,  outside the byte range */
+
+/****************************************************************************
+ * Template_Cache_Init - Allocate the table the first time "template-cache"
+ * is enabled.  The size is fixed from then on.
+ ****************************************************************************/
+
+void Template_Cache_Init( void )
+{
+
+    uint64_t size = 1;
+
+    if ( config->template_cache_flag == false || Template_Cache != NULL )
+        {
+            return;
+        }
+
+    while ( size < config->template_cache_size )
+        {
+            size = size << 1;
+        }
+
+    Template_Cache = calloc(size, sizeof(uint64_t));
+
+    if ( Template_Cache == NULL )
+        {
+            Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for the template cache. Abort!", __FILE__, __LINE__);
+        }
+
+    Template_Cache_Mask = size - 1;
+
+    Sagan_Log(NORMAL, "Template cache: %" PRIu64 " entries (%" PRIu64 " bytes).", size, size * sizeof(uint64_t));
+
+}
+
+/****************************************************************************
+ * Template_Cache_Clear - Forget every verdict.  The rules have changed.
+ ****************************************************************************/
+
+void Template_Cache_Clear( void )
+{
+    __atomic_add_fetch(&Template_Cache_Generation, 1, __ATOMIC_SEQ_CST);
+}
+
+/****************************************************************************
+ * Template_Cache_Key_Field - FNV-1a over a NULL terminated field,  plus the
+ * terminator so fields can't run together.
+ ****************************************************************************/
+
+static uint64_t Template_Cache_Key_Field( uint64_t hash, const char *field )
+{
+
+    const unsigned char *p = (const unsigned char *)field;
+
+    for ( ; *p != '\0'; p++ )
+        {
+            hash = ( hash ^ *p ) * TEMPLATE_FNV_PRIME;
+        }
+
+    return( hash * TEMPLATE_FNV_PRIME );
+
+}
+
+/****************************************************************************
+ * Template_Cache_Epoch - The current cache generation.  Read it before the
+ * rule count the scan will use.
+ ****************************************************************************/
+
+uint32_t Template_Cache_Epoch( void )
+{
+    return( __atomic_load_n(&Template_Cache_Generation, __ATOMIC_ACQUIRE) );
+}
+
+/****************************************************************************
+ * Template_Cache_Key - Key for an event,  computed once the event has been
+ * prepared (JSON program/message merged,  etc).  "generation" is from
+ * Template_Cache_Epoch().  Never 0.
+ ****************************************************************************/
+
+uint64_t Template_Cache_Key( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, uint32_t generation )
+{
+
+    const unsigned char *p = (const unsigned char *)SaganProcSyslog_LOCAL->syslog_message;
+    uint64_t hash = TEMPLATE_FNV_OFFSET ^ generation;
+    bool digits = false;
+
+    hash = Template_Cache_Key_Field( hash, SaganProcSyslog_LOCAL->syslog_program );
+    hash = Template_Cache_Key_Field( hash, SaganProcSyslog_LOCAL->syslog_facility );
+    hash = Template_Cache_Key_Field( hash, SaganProcSyslog_LOCAL->syslog_level );
+    hash = Template_Cache_Key_Field( hash, SaganProcSyslog_LOCAL->syslog_tag );
+    hash = Template_Cache_Key_Field( hash, SaganProcSyslog_LOCAL->syslog_priority );
+
+    for ( ; *p != '\0'; p++ )
+        {
+
+            if ( *p >= '0' && *p <= '9' )
+                {
+
+                    if ( digits == false )
+                        {
+                            hash = ( hash ^ TEMPLATE_DIGITS ) * TEMPLATE_FNV_PRIME;
+                            digits = true;
+                        }
+
+                    continue;
+                }
+
+            digits = false;
+            hash = ( hash ^ *p ) * TEMPLATE_FNV_PRIME;
+        }
+
+    return( hash == 0 ? 1 : hash );
+
+}
+
+/****************************************************************************
+ * Template_Cache_Lookup - Has "key" been seen to match no rule?
+ ****************************************************************************/
+
+bool Template_Cache_Lookup( uint64_t key )
+{
+
+    bool hit = ( __atomic_load_n(&Template_Cache[key & Template_Cache_Mask], __ATOMIC_RELAXED) == key );
+
+    __atomic_add_fetch(&counters->template_cache_lookup, 1, __ATOMIC_RELAXED);
+
+    if ( hit == true )
+        {
+            __atomic_add_fetch(&counters->template_cache_hit, 1, __ATOMIC_RELAXED);
+        }
+
+    return(hit);
+
+}
+
+/****************************************************************************
+ * Template_Cache_Add - Record that no rule matched "key",  made with
+ * "generation".  A verdict from before a clear is useless,  so skip it.
+ ****************************************************************************/
+
+void Template_Cache_Add( uint64_t key, uint32_t generation )
+{
+
+    if ( generation != __atomic_load_n(&Template_Cache_Generation, __ATOMIC_ACQUIRE) )
+        {
+            return;
+        }
+
+    __atomic_store_n(&Template_Cache[key & Template_Cache_Mask], key, __ATOMIC_RELAXED);
+
+}
+
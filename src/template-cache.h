@@ -0,0 +1,29 @@
+/*
+** Copyright (C) 2009-2020 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2020 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* template-cache.h */
+
+void     Template_Cache_Init( void );
+void     Template_Cache_Clear( void );
+uint32_t Template_Cache_Epoch( void );
+uint64_t Template_Cache_Key( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, uint32_t generation );
+bool     Template_Cache_Lookup( uint64_t key );
+void     Template_Cache_Add( uint64_t key, uint32_t generation );
+
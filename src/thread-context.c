@@ -0,0 +1,94 @@
+/*
+** Copyright (C) 2009-2020 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2020 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* thread-context.c
+ *
+ * Per-thread scratch memory for the event hot path.  Sagan_Engine(),
+ * Send_Alert(), SyslogInput_JSON() and Parse_JSON_Message() used to
+ * malloc()/free() their working structures for every log line.  With a
+ * large number of threads,  that allocator churn was very visible.  The
+ * memory is now allocated once per thread and reused.
+ *
+ * counters->hot_path_alloc counts the allocations Sagan itself makes on the
+ * hot path:  these contexts and the buffers they grow.  In a steady state it
+ * stops growing with the number of events.  It does not see allocations made
+ * inside libfastjson,  liblognorm or PCRE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "sagan.h"
+#include "sagan-defs.h"
+#include "routing.h"
+#include "event-cache.h"
+
+#ifdef HAVE_LIBFASTJSON
+#include "input-json.h"
+#include "message-json-map.h"
+#endif
+
+#include "thread-context.h"
+
+struct _SaganCounters *counters;
+struct _SaganDebug *debug;
+
+static __thread struct _Sagan_Thread_Context *ThreadContext = NULL;
+
+/****************************************************************************
+ * Thread_Context - Returns the calling threads context.  It is allocated
+ * the first time a thread asks for it.
+ ****************************************************************************/
+
+struct _Sagan_Thread_Context *Thread_Context( void )
+{
+
+    if ( ThreadContext != NULL )
+        {
+            return(ThreadContext);
+        }
+
+    ThreadContext = malloc(sizeof(struct _Sagan_Thread_Context));
+
+    if ( ThreadContext == NULL )
+        {
+            Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for _Sagan_Thread_Context. Abort!", __FILE__, __LINE__);
+        }
+
+    memset(ThreadContext, 0, sizeof(struct _Sagan_Thread_Context));
+
+    __atomic_add_fetch(&counters->hot_path_alloc, 1, __ATOMIC_SEQ_CST);
+
+    if ( debug->debugthreads )
+        {
+            Sagan_Log(DEBUG, "[%s, line %d] Allocated %lu bytes of thread context for thread %lu. Hot path allocations: %" PRIu64 "", __FILE__, __LINE__, (unsigned long)sizeof(struct _Sagan_Thread_Context), pthread_self(), counters->hot_path_alloc);
+        }
+
+    return(ThreadContext);
+
+}
+
@@ -0,0 +1,64 @@
+/*
+** Copyright (C) 2009-2020 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2020 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* Requires sagan.h, routing.h, event-cache.h and (with libfastjson)
+   input-json.h and message-json-map.h to be included first */
+
+/* Scratch memory used while processing a single event.  One of these is
+   allocated per thread,  the first time that thread needs it,  and is then
+   reused for every event.  Nothing in the event hot path should call
+   malloc() */
+
+typedef struct _Sagan_Thread_Context _Sagan_Thread_Context;
+struct _Sagan_Thread_Context
+{
+
+    struct _Sagan_Routing SaganRouting;				/* Sagan_Engine() */
+    struct _Sagan_Processor_Info processor_info_engine;		/* Sagan_Engine() */
+    struct _Sagan_Event_Cache EventCache;			/* Sagan_Engine() */
+
+    uint32_t header_event;					/* Sagan_Engine() header filter cache */
+    uint32_t header_seen[RULE_HEADER_CACHE];
+    bool header_match[RULE_HEADER_CACHE];
+
+    uint32_t order_events;					/* Sagan_Engine() "rule-ordering" sampling */
+
+    struct _Rule_Profile_Thread *profile;			/* Sagan_Engine() "rule-profiling" (see rule-profile.c) */
+
+    struct _Sagan_Engine_Batch *EngineBatch;			/* Sagan_Engine_Batch() */
+
+    uint32_t flow_cache_size;					/* Check_Flow() group results (see flow.c) */
+    struct _Flow_Group_Cache *flow_cache;
+
+    struct _Sagan_Event SaganProcessorEvent;			/* Send_Alert() */
+
+#ifdef HAVE_LIBFASTJSON
+
+    struct _JSON_Key_String JSON_Key_String[JSON_MAX_NEST];	/* SyslogInput_JSON() */
+    struct _JSON_Key_String JSON_Key_String_J[JSON_MAX_NEST];
+
+    struct _JSON_Message_Map_Found JSON_Message_Map_Found[JSON_MAX_NEST];	/* Parse_JSON_Message() */
+
+#endif
+
+};
+
+struct _Sagan_Thread_Context *Thread_Context( void );
+
@@ -34,203 +34,218 @@
 #include "sagan-defs.h"
 #include "sagan-config.h"
 #include "rules.h"
+#include "rule-generation.h"
+#include "util-time.h"
 #include "threshold.h"
 #include "ipc.h"
-
-pthread_mutex_t Thresh2_Mutex=PTHREAD_MUTEX_INITIALIZER;
+#include "ipc-hash.h"
 
 struct _Threshold2_IPC *Threshold2_IPC;
+struct _IPC_Hash *Threshold2_Index;
 struct _Sagan_IPC_Counters *counters_ipc;
 
 struct _SaganCounters *counters;
-struct _Rule_Struct *rulestruct;
 struct _SaganDebug *debug;
 struct _SaganConfig *config;
 
+/****************************************************************************
+ * Threshold2_Match - Confirm an index hit is for the same rule
+ ****************************************************************************/
+
+static bool Threshold2_Match( uint32_t entry, void *arg )
+{
+    return( Threshold2_IPC[entry].sid == *(uint64_t *)arg );
+}
+
+/****************************************************************************
+ * Threshold2_Expired - Can an entry be reused?  "arg" is the current time.
+ ****************************************************************************/
+
+static bool Threshold2_Expired( uint32_t entry, void *arg )
+{
+    return( ( *(uint64_t *)arg - Threshold2_IPC[entry].utime ) >= (uint64_t)Threshold2_IPC[entry].expire );
+}
+
 /***********************/
 /* Threshold2          */
 /***********************/
 
-bool Threshold2 ( int rule_position, char *ip_src, uint32_t src_port, char *ip_dst,  uint32_t dst_port, char *username, char *syslog_message )
+bool Threshold2 ( int rule_position, struct _Sagan_IP *ip_src, uint32_t src_port, struct _Sagan_IP *ip_dst,  uint32_t dst_port, char *username, char *syslog_message )
 {
 
-    time_t t;
-    struct tm *now;
-    char  timet[20];
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
 
     bool thresh_log_flag = false;
 
     uint64_t thresh_oldtime = 0;
     uint64_t current_time = 0;
 
-    int i;
+    int32_t i;
+    uint32_t stripe;
 
-    t = time(NULL);
-    now=localtime(&t);
-    strftime(timet, sizeof(timet), "%s",  now);
-
-    char src_tmp[MAXIP] = { 0 };
-    char dst_tmp[MAXIP] = { 0 };
+    char *src_tmp = "";
+    char *dst_tmp = "";
     char username_tmp[MAX_USERNAME_SIZE] = { 0 };
     uint32_t dst_port_tmp = 0;
     uint32_t src_port_tmp = 0;
 
-    char hash_string[128] = { 0 };
     char debug_string[64] = { 0 };
 
-    uint32_t hash;
+    uint64_t hash;
+    uint64_t sid = gen->rulestruct[rule_position].s_sid;
 
-    current_time = atoi(timet);
+    current_time = Return_Epoch();
 
     username_tmp[0] = '\0';
 
-    if ( rulestruct[rule_position].threshold2_method_src == true )
+    hash = Fnv1a_Hash64( &sid, sizeof(sid), IP_HASH64_SEED );
+
+    if ( gen->rulestruct[rule_position].threshold2_method_src == true )
         {
-            strlcpy(src_tmp, ip_src, sizeof(src_tmp));
+            hash = IP_Hash64( ip_src, hash );
+            src_tmp = IP_Text( ip_src );
         }
 
-    if ( rulestruct[rule_position].threshold2_method_dst == true )
+    if ( gen->rulestruct[rule_position].threshold2_method_dst == true )
         {
-            strlcpy(dst_tmp, ip_dst, sizeof(dst_tmp));
+            hash = IP_Hash64( ip_dst, hash );
+            dst_tmp = IP_Text( ip_dst );
         }
 
-    if ( rulestruct[rule_position].threshold2_method_username == true && username != NULL )
+    if ( gen->rulestruct[rule_position].threshold2_method_username == true && username != NULL )
         {
             strlcpy(username_tmp, username, sizeof(username_tmp));
         }
 
-    if ( rulestruct[rule_position].threshold2_method_srcport == true )
+    if ( gen->rulestruct[rule_position].threshold2_method_srcport == true )
         {
             src_port_tmp = src_port;
         }
 
-    if ( rulestruct[rule_position].threshold2_method_dstport == true )
+    if ( gen->rulestruct[rule_position].threshold2_method_dstport == true )
         {
             dst_port_tmp = dst_port;
         }
 
-    snprintf(hash_string, sizeof(hash_string), "%s|%d|%s|%d|%s", src_tmp, src_port_tmp, dst_tmp, dst_port_tmp, username_tmp);
+    /* Ports and username are folded into the same hash as the sid and
+       addresses */
 
-    hash = Djb2_Hash( hash_string );
+    hash = Fnv1a_Hash64( &src_port_tmp, sizeof(src_port_tmp), hash );
+    hash = Fnv1a_Hash64( &dst_port_tmp, sizeof(dst_port_tmp), hash );
+    hash = Fnv1a_Hash64( username_tmp, strlen(username_tmp), hash );
 
-    for (i = 0; i < counters_ipc->thresh2_count; i++ )
-        {
+    stripe = IPC_Hash_Lock( Threshold2_Index, hash );
 
-            if ( hash == Threshold2_IPC[i].hash && Threshold2_IPC[i].sid == rulestruct[rule_position].s_sid )
-                {
+    if ( ( i = IPC_Hash_Lookup( Threshold2_Index, hash, Threshold2_Match, &sid ) ) != -1 )
+        {
 
-                    File_Lock(config->shm_thresh2);
-                    pthread_mutex_lock(&Thresh2_Mutex);
+            Threshold2_IPC[i].count++;
 
-                    Threshold2_IPC[i].count++;
+            if ( gen->rulestruct[rule_position].threshold2_type == THRESHOLD_SUPPRESS )
+                {
+                    thresh_oldtime = current_time - Threshold2_IPC[i].utime;
+                    Threshold2_IPC[i].utime = current_time;
+                }
 
-                    if ( rulestruct[rule_position].threshold2_type == THRESHOLD_SUPPRESS )
-                        {
-                            thresh_oldtime = current_time - Threshold2_IPC[i].utime;
-                            Threshold2_IPC[i].utime = current_time;
-                        }
+            else if ( gen->rulestruct[rule_position].threshold2_type == THRESHOLD_LIMIT )
+                {
+                    thresh_oldtime = current_time - Threshold2_IPC[i].utime;
+                }
 
-                    else if ( rulestruct[rule_position].threshold2_type == THRESHOLD_LIMIT )
-                        {
-                            thresh_oldtime = current_time - Threshold2_IPC[i].utime;
-                        }
 
+            strlcpy(Threshold2_IPC[i].syslog_message, syslog_message, sizeof(Threshold2_IPC[i].syslog_message));
+            strlcpy(Threshold2_IPC[i].signature_msg, gen->rulestruct[rule_position].s_msg, sizeof(Threshold2_IPC[i].signature_msg));
 
-                    strlcpy(Threshold2_IPC[i].syslog_message, syslog_message, sizeof(Threshold2_IPC[i].syslog_message));
-                    strlcpy(Threshold2_IPC[i].signature_msg, rulestruct[rule_position].s_msg, sizeof(Threshold2_IPC[i].signature_msg));
+            if ( thresh_oldtime > gen->rulestruct[rule_position].threshold2_seconds )
+                {
+                    Threshold2_IPC[i].count=1;
+                    Threshold2_IPC[i].utime = current_time;  /* Reset the time */
+                    thresh_log_flag = false;
+                }
 
-                    if ( thresh_oldtime > rulestruct[rule_position].threshold2_seconds )
-                        {
-                            Threshold2_IPC[i].count=1;
-                            Threshold2_IPC[i].utime = current_time;  /* Reset the time */
-                            thresh_log_flag = false;
-                        }
+            if ( gen->rulestruct[rule_position].threshold2_count < Threshold2_IPC[i].count )
+                {
+                    thresh_log_flag = true;
 
-                    if ( rulestruct[rule_position].threshold2_count < Threshold2_IPC[i].count )
+                    if ( debug->debuglimits )
                         {
-                            thresh_log_flag = true;
 
-                            if ( debug->debuglimits )
+                            if ( Threshold2_IPC[i].threshold2_method_src == true )
                                 {
+                                    strlcat(debug_string, "by_src ", sizeof(debug_string));
+                                }
 
-                                    if ( Threshold2_IPC[i].threshold2_method_src == true )
-                                        {
-                                            strlcat(debug_string, "by_src ", sizeof(debug_string));
-                                        }
-
-                                    if ( Threshold2_IPC[i].threshold2_method_dst == true )
-                                        {
-                                            strlcat(debug_string, "by_dst ", sizeof(debug_string));
-                                        }
-
-                                    if ( Threshold2_IPC[i].threshold2_method_username == true )
-                                        {
-                                            strlcat(debug_string, "by_username ", sizeof(debug_string));
-                                        }
-
-                                    if ( Threshold2_IPC[i].threshold2_method_srcport == true )
-                                        {
-                                            strlcat(debug_string, "by_srcport ", sizeof(debug_string));
-                                        }
+                            if ( Threshold2_IPC[i].threshold2_method_dst == true )
+                                {
+                                    strlcat(debug_string, "by_dst ", sizeof(debug_string));
+                                }
 
-                                    if ( Threshold2_IPC[i].threshold2_method_dstport == true )
-                                        {
-                                            strlcat(debug_string, "by_dstport ", sizeof(debug_string));
-                                        }
+                            if ( Threshold2_IPC[i].threshold2_method_username == true )
+                                {
+                                    strlcat(debug_string, "by_username ", sizeof(debug_string));
+                                }
 
-                                    Sagan_Log(NORMAL, "Threshold SID %" PRIu64 ". Tracking by %s[%d: Hash: %lu]", Threshold2_IPC[i].sid, debug_string, i, hash);
+                            if ( Threshold2_IPC[i].threshold2_method_srcport == true )
+                                {
+                                    strlcat(debug_string, "by_srcport ", sizeof(debug_string));
+                                }
 
+                            if ( Threshold2_IPC[i].threshold2_method_dstport == true )
+                                {
+                                    strlcat(debug_string, "by_dstport ", sizeof(debug_string));
                                 }
 
-                            counters->threshold_total++;
+                            Sagan_Log(NORMAL, "Threshold SID %" PRIu64 ". Tracking by %s[%d: Hash: %" PRIu64 "]", Threshold2_IPC[i].sid, debug_string, i, hash);
+
                         }
 
-                    pthread_mutex_unlock(&Thresh2_Mutex);
-                    File_Unlock(config->shm_thresh2);
+                    __atomic_add_fetch(&counters->threshold_total, 1, __ATOMIC_SEQ_CST);
+                }
 
-                    return(thresh_log_flag);
+            IPC_Hash_Unlock( Threshold2_Index, stripe );
 
-                }
+            return(thresh_log_flag);
 
         }
 
-    /* If not found,  add it to the array */
+    /* If not found,  add it.  This reuses an expired entry on the way if
+       there is one. */
 
-    if ( Clean_IPC_Object(THRESHOLD2) == 0 )
+    if ( ( i = IPC_Hash_Insert( Threshold2_Index, hash, Threshold2_Expired, &current_time ) ) == -1 )
         {
+            IPC_Hash_Unlock( Threshold2_Index, stripe );
+            Sagan_Log(WARN, "[%s, line %d] Threshold2_IPC is full,  cannot track SID %" PRIu64 ".", __FILE__, __LINE__, sid);
+            return(false);
+        }
 
-            File_Lock(config->shm_thresh2);
-            pthread_mutex_lock(&Thresh2_Mutex);
+    Threshold2_IPC[i].hash = hash;
 
-            Threshold2_IPC[counters_ipc->thresh2_count].hash = hash;
+    Threshold2_IPC[i].count = 1;
+    Threshold2_IPC[i].utime = current_time;
+    Threshold2_IPC[i].expire = gen->rulestruct[rule_position].threshold2_seconds;
+    Threshold2_IPC[i].sid = sid;
+    Threshold2_IPC[i].target_count =gen->rulestruct[rule_position].threshold2_count;
+    Threshold2_IPC[i].threshold2_method_src = gen->rulestruct[rule_position].threshold2_method_src;
+    Threshold2_IPC[i].threshold2_method_dst = gen->rulestruct[rule_position].threshold2_method_dst;
+    Threshold2_IPC[i].threshold2_method_username = gen->rulestruct[rule_position].threshold2_method_username;
+    Threshold2_IPC[i].threshold2_method_srcport = gen->rulestruct[rule_position].threshold2_method_srcport;
+    Threshold2_IPC[i].threshold2_method_dstport = gen->rulestruct[rule_position].threshold2_method_dstport;
 
-            Threshold2_IPC[counters_ipc->thresh2_count].count = 1;
-            Threshold2_IPC[counters_ipc->thresh2_count].utime = current_time;
-            Threshold2_IPC[counters_ipc->thresh2_count].expire = rulestruct[rule_position].threshold2_seconds;
-            Threshold2_IPC[counters_ipc->thresh2_count].sid = rulestruct[rule_position].s_sid;
-            Threshold2_IPC[counters_ipc->thresh2_count].target_count =rulestruct[rule_position].threshold2_count;
-            Threshold2_IPC[counters_ipc->thresh2_count].threshold2_method_src = rulestruct[rule_position].threshold2_method_src;
-            Threshold2_IPC[counters_ipc->thresh2_count].threshold2_method_dst = rulestruct[rule_position].threshold2_method_dst;
-            Threshold2_IPC[counters_ipc->thresh2_count].threshold2_method_username = rulestruct[rule_position].threshold2_method_username;
+    strlcpy(Threshold2_IPC[i].ip_src, src_tmp, sizeof(Threshold2_IPC[i].ip_src));
+    Threshold2_IPC[i].src_port = src_port_tmp;
 
-            strlcpy(Threshold2_IPC[counters_ipc->thresh2_count].ip_src, src_tmp, sizeof(Threshold2_IPC[counters_ipc->thresh2_count].ip_src));
-            Threshold2_IPC[counters_ipc->thresh2_count].src_port = src_port_tmp;
+    strlcpy(Threshold2_IPC[i].ip_dst, dst_tmp, sizeof(Threshold2_IPC[i].ip_dst));
+    Threshold2_IPC[i].dst_port = dst_port_tmp;
 
-            strlcpy(Threshold2_IPC[counters_ipc->thresh2_count].ip_dst, dst_tmp, sizeof(Threshold2_IPC[counters_ipc->thresh2_count].ip_dst));
-            Threshold2_IPC[counters_ipc->thresh2_count].dst_port = dst_port_tmp;
+    strlcpy(Threshold2_IPC[i].username, username_tmp, sizeof(Threshold2_IPC[i].username));
 
-            strlcpy(Threshold2_IPC[counters_ipc->thresh2_count].username, username_tmp, sizeof(Threshold2_IPC[counters_ipc->thresh2_count].username));
+    strlcpy(Threshold2_IPC[i].syslog_message, syslog_message, sizeof(Threshold2_IPC[i].syslog_message));
+    strlcpy(Threshold2_IPC[i].signature_msg, gen->rulestruct[rule_position].s_msg, sizeof(Threshold2_IPC[i].signature_msg));
 
-            strlcpy(Threshold2_IPC[counters_ipc->thresh2_count].syslog_message, syslog_message, sizeof(Threshold2_IPC[counters_ipc->thresh2_count].syslog_message));
-            strlcpy(Threshold2_IPC[counters_ipc->thresh2_count].signature_msg, rulestruct[rule_position].s_msg, sizeof(Threshold2_IPC[counters_ipc->thresh2_count].signature_msg));
+    IPC_Hash_Unlock( Threshold2_Index, stripe );
 
-            counters_ipc->thresh2_count++;
-
-            pthread_mutex_unlock(&Thresh2_Mutex);
-            File_Unlock(config->shm_thresh2);
-        }
+    __atomic_store_n(&counters_ipc->thresh2_count, Threshold2_Index->entry_count, __ATOMIC_SEQ_CST);
 
     return(false);
 
 }
-
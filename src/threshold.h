@@ -18,5 +18,5 @@
 ** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 */
 
-bool Threshold2 ( int rule_position, char *ip_src, uint32_t src_port, char *ip_dst,  uint32_t dst_port, char *username, char *syslog_message );
+bool Threshold2 ( int rule_position, struct _Sagan_IP *ip_src, uint32_t src_port, struct _Sagan_IP *ip_dst,  uint32_t dst_port, char *username, char *syslog_message );
 
@@ -53,25 +53,26 @@
 #include "sagan-config.h"
 #include "sagan-defs.h"
 #include "rules.h"
+#include "rule-generation.h"
+#include "rule-epoch.h"
+#include "util-time.h"
 #include "tracking-syslog.h"
 
 struct _SaganConfig *config;
 struct _SaganCounters *counters;
-struct _Sagan_Ruleset_Track *Ruleset_Track;
 
 
 void RuleTracking_Syslog( void )
 {
 
+    const struct _Rule_Generation *gen = NULL;
+
     (void)SetThreadName("SaganRuleTrack");
 
     int i = 0;
     bool flag = 0;
 
 
-    time_t t;
-    char timet[20];
-    struct tm *now;
     int seconds = 0;
 
 
@@ -88,10 +89,7 @@ void RuleTracking_Syslog( void )
 
             sleep(config->rule_tracking_time);
 
-            t = time(NULL);
-            now=localtime(&t);
-            strftime(timet, sizeof(timet), "%s",  now);
-            seconds = atol(timet) - atol(config->sagan_startutime);
+            seconds = Return_Epoch() - atol(config->sagan_startutime);
 
             uptime_days = seconds / 86400;
             uptime_abovedays = seconds % 86400;
@@ -105,11 +103,15 @@ void RuleTracking_Syslog( void )
             syslog(LOG_INFO, "---[Sagan]----------------------------");
             syslog(LOG_INFO, "Uptime: %d days, %d hours, %d minutes, %d seconds.", uptime_days, uptime_hours, uptime_minutes, uptime_seconds);
 
-            for ( i = 0; i < counters->ruleset_track_count; i++ )
+            Rule_Epoch_Enter();
+
+            gen = Rule_Generation_Current();
+
+            for ( i = 0; i < gen->ruleset_track_count; i++ )
                 {
-                    if ( Ruleset_Track[i].trigger == true )
+                    if ( gen->Ruleset_Track[i].trigger == true )
                         {
-                            syslog(LOG_INFO, "Fired ruleset: %s", Ruleset_Track[i].ruleset);
+                            syslog(LOG_INFO, "Fired ruleset: %s", gen->Ruleset_Track[i].ruleset);
                             flag = true;
                         }
                 }
@@ -120,11 +122,11 @@ void RuleTracking_Syslog( void )
                 }
 
 
-            for ( i = 0; i < counters->ruleset_track_count; i++ )
+            for ( i = 0; i < gen->ruleset_track_count; i++ )
                 {
-                    if ( Ruleset_Track[i].trigger == false )
+                    if ( gen->Ruleset_Track[i].trigger == false )
                         {
-                            syslog(LOG_INFO, "Non-fired ruleset: %s", Ruleset_Track[i].ruleset);
+                            syslog(LOG_INFO, "Non-fired ruleset: %s", gen->Ruleset_Track[i].ruleset);
                             flag = true;
                         }
                 }
@@ -134,6 +136,8 @@ void RuleTracking_Syslog( void )
                     syslog(LOG_INFO, "Non-fired rulesets: All rules fired");
                 }
 
+            Rule_Epoch_Exit();
+
 
             closelog();
 
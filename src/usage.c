@@ -78,6 +78,7 @@ void Usage(void)
     fprintf(stderr, "\t\t\tfrom a FIFO.  The file must be in the Sagan format!\n");
     fprintf(stderr, "-l, --log [file]\tsagan.log location [default: %s].\n", SAGANLOG );
     fprintf(stderr, "-Q, --quiet\t\tRun Sagan in 'quiet' mode (no console output)\n");
+    fprintf(stderr, "-R, --compile-rules [file]\tWrite the rule set to a precompiled rule image and exit.\n");
     fprintf(stderr, "\n");
 
 #ifdef HAVE_LIBESMTP
@@ -29,14 +29,141 @@
 #endif
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <sys/time.h>
 #include <time.h>
 #include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/prctl.h>
 
 #include "sagan.h"
+#include "sagan-defs.h"
 #include "util-time.h"
 #include "parsers/strstr-asm/strstr-hook.h"
 
+/* Cached clock.  Clock_Thread() refreshes these every CLOCK_RESOLUTION
+   microseconds so the event path never has to call time() or localtime()
+   (which takes the libc timezone lock).  The broken down local time is
+   only rebuilt when the second changes and is guarded by a sequence
+   counter,  so readers never see a half written struct tm. */
+
+static uint64_t clock_epoch = 0;
+static uint32_t clock_seq = 0;
+static struct tm clock_local;
+static uint32_t clock_minute_of_week = 0;
+
+/****************************************************************************
+ * Clock_Update - Refresh the cached clock.  Only Clock_Init() and
+ * Clock_Thread() call this.
+ ****************************************************************************/
+
+void Clock_Update( void )
+{
+
+    struct timespec ts;
+    struct tm local;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    if ( (uint64_t)ts.tv_sec == __atomic_load_n(&clock_epoch, __ATOMIC_RELAXED) )
+        {
+            return;
+        }
+
+    localtime_r(&ts.tv_sec, &local);
+
+    __atomic_add_fetch(&clock_seq, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    memcpy(&clock_local, &local, sizeof(struct tm));
+
+    __atomic_add_fetch(&clock_seq, 1, __ATOMIC_RELEASE);
+
+    __atomic_store_n(&clock_minute_of_week, ( local.tm_wday * 1440 ) + ( local.tm_hour * 60 ) + local.tm_min, __ATOMIC_RELAXED);
+    __atomic_store_n(&clock_epoch, (uint64_t)ts.tv_sec, __ATOMIC_RELEASE);
+
+}
+
+/****************************************************************************
+ * Clock_Init - Prime the cached clock before any threads are started.
+ ****************************************************************************/
+
+void Clock_Init( void )
+{
+    Clock_Update();
+}
+
+/****************************************************************************
+ * Clock_Thread - Keeps the cached clock current.
+ ****************************************************************************/
+
+void Clock_Thread( void )
+{
+
+    (void)SetThreadName("SaganClock");
+
+    struct timespec tick;
+
+    tick.tv_sec = 0;
+    tick.tv_nsec = CLOCK_RESOLUTION * 1000;
+
+    while (1)
+        {
+            nanosleep(&tick, NULL);
+            Clock_Update();
+        }
+
+}
+
+/****************************************************************************
+ * Clock_Local - Copy of the cached local time.  Programs that never call
+ * Clock_Init() (saganpeek) get the real thing.
+ ****************************************************************************/
+
+void Clock_Local( struct tm *tm )
+{
+
+    uint32_t seq = 0;
+    time_t t;
+
+    if ( __atomic_load_n(&clock_epoch, __ATOMIC_ACQUIRE) == 0 )
+        {
+            t = time(NULL);
+            localtime_r(&t, tm);
+            return;
+        }
+
+    do
+        {
+            seq = __atomic_load_n(&clock_seq, __ATOMIC_ACQUIRE);
+            memcpy(tm, &clock_local, sizeof(struct tm));
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        }
+    while ( ( seq & 1 ) != 0 || seq != __atomic_load_n(&clock_seq, __ATOMIC_RELAXED) );
+
+}
+
+/****************************************************************************
+ * Clock_Minute_Of_Week - 0 (Sunday 00:00) to 10079 (Saturday 23:59) in
+ * local time.  Used by "alert_time".
+ ****************************************************************************/
+
+uint32_t Clock_Minute_Of_Week( void )
+{
+
+    struct tm tm;
+
+    if ( __atomic_load_n(&clock_epoch, __ATOMIC_ACQUIRE) == 0 )
+        {
+            Clock_Local(&tm);
+            return( ( tm.tm_wday * 1440 ) + ( tm.tm_hour * 60 ) + tm.tm_min );
+        }
+
+    return( __atomic_load_n(&clock_minute_of_week, __ATOMIC_RELAXED) );
+
+}
+
 struct tm *Sagan_LocalTime(time_t timep, struct tm *result)
 {
     return localtime_r(&timep, result);
@@ -94,21 +221,20 @@ void CreateIsoTimeString (const struct timeval *ts, char *str, size_t size)
 
 /************************************************
  * Returns current epoch time in uint64_t format
+ * (from the cached clock)
  ************************************************/
 
 uint64_t Return_Epoch( void )
 {
 
-    time_t t;
-    struct tm *now;
-    char timet[20] = { 0 };
-
+    uint64_t epoch = __atomic_load_n(&clock_epoch, __ATOMIC_ACQUIRE);
 
-    t = time(NULL);
-    now=localtime(&t);
-    strftime(timet, sizeof(timet), "%s",  now);
+    if ( epoch == 0 )
+        {
+            return((uint64_t)time(NULL));
+        }
 
-    return(atol(timet));
+    return(epoch);
 
 }
 
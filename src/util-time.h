@@ -25,6 +25,11 @@ void Return_Date( uint32_t, char *str, size_t size );
 void Return_Time( uint32_t, char *str, size_t size );
 void u32_Time_To_Human ( uint32_t, char *str, size_t size );
 uint64_t Return_Epoch( void );
+void Clock_Update( void );
+void Clock_Init( void );
+void Clock_Thread( void );
+void Clock_Local( struct tm * );
+uint32_t Clock_Minute_Of_Week( void );
 
 
 
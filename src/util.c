@@ -54,6 +54,7 @@
 #include "sagan-defs.h"
 #include "sagan-config.h"
 #include "lockfile.h"
+#include "util-time.h"
 
 #include "parsers/strstr-asm/strstr-hook.h"
 
@@ -62,7 +63,6 @@
 struct _SaganConfig *config;
 struct _SaganCounters *counters;
 struct _SaganVar *var;
-struct _Sagan_Processor_Generator *generator;
 
 bool daemonize;
 bool quiet;
@@ -217,11 +217,9 @@ void Sagan_Log (int type, const char *format,... )
     va_start(ap, format);
     char *chr="*";
     char curtime[64];
-    time_t t;
-    struct tm *now;
-    t = time(NULL);
-    now=localtime(&t);
-    strftime(curtime, sizeof(curtime), "%m/%d/%Y %H:%M:%S",  now);
+    struct tm now;
+    Clock_Local(&now);
+    strftime(curtime, sizeof(curtime), "%m/%d/%Y %H:%M:%S",  &now);
 
     if ( type == ERROR )
         {
@@ -289,67 +287,378 @@ bool Mask2Bit(int mask, unsigned char *out)
 
 }
 
-/* Converts IP address.  We assume that out is at least 16 bytes.  */
+/****************************************************************************
+ * IP_Parse_IPv4 - Dotted quad between "ip" and "end" into 4 bytes.  Same
+ * rules as inet_pton(AF_INET, ...);  exactly four decimal octets,  no
+ * leading zeros and nothing left over.
+ ****************************************************************************/
 
-bool IP2Bit(char *ipaddr, unsigned char *out)
+static bool IP_Parse_IPv4( const char *ip, const char *end, unsigned char *out )
 {
 
-    bool ret = false;
-    struct addrinfo hints = {0};
-    struct addrinfo *result = NULL;
+    unsigned int value = 0;
+    int octets = 0;
+    int digits = 0;
 
-    /* Use getaddrinfo so we can get ipv4 or 6 */
+    for ( octets = 0; octets < 4; octets++ )
+        {
 
-    hints.ai_family = AF_UNSPEC;
-    hints.ai_socktype = SOCK_DGRAM;
-    hints.ai_flags = AI_PASSIVE|AI_NUMERICHOST;
+            if ( octets > 0 )
+                {
 
-    if ( ipaddr == NULL || ipaddr[0] == '\0' )
-        {
-            return false;
+                    if ( ip >= end || *ip != '.' )
+                        {
+                            return(false);
+                        }
+
+                    ip++;
+                }
+
+            value = 0;
+            digits = 0;
+
+            while ( ip < end && *ip >= '0' && *ip <= '9' )
+                {
+
+                    /* No octal/leading zeros and no more than 3 digits */
+
+                    if ( digits == 3 || ( digits > 0 && value == 0 ) )
+                        {
+                            return(false);
+                        }
+
+                    value = ( value * 10 ) + ( *ip - '0' );
+                    digits++;
+                    ip++;
+                }
+
+            if ( digits == 0 || value > 255 )
+                {
+                    return(false);
+                }
+
+            out[octets] = (unsigned char)value;
         }
 
-    ret = getaddrinfo(ipaddr, NULL, &hints, &result) == 0;
+    return( ip == end );
+}
+
+/****************************************************************************
+ * IP_Parse_IPv6 - RFC 4291 text form between "ip" and "end" into 16 bytes.
+ * Handles "::" and a trailing dotted quad ("::ffff:192.168.1.1").
+ ****************************************************************************/
+
+static bool IP_Parse_IPv6( const char *ip, const char *end, unsigned char *out )
+{
+
+    unsigned char tmp[MAXIPBIT] = { 0 };
+    unsigned char *tp = tmp;
+    unsigned char *endp = tmp + MAXIPBIT;
+    unsigned char *colonp = NULL;
+
+    const char *curtok = NULL;
 
+    unsigned int value = 0;
+    int digits = 0;
+    int nibble = 0;
+    int n = 0;
+    char ch;
 
-    if (!ret)
+    /* Leading "::" */
+
+    if ( ip < end && *ip == ':' )
         {
-            Sagan_Log(WARN, "[%lu] Warning: Got a getaddrinfo() error for \"%s\" but continuing...", pthread_self(), ipaddr);
+
+            if ( ip + 1 >= end || ip[1] != ':' )
+                {
+                    return(false);
+                }
+
+            ip++;
         }
-    else
+
+    curtok = ip;
+
+    while ( ip < end )
         {
 
-            switch (((struct sockaddr_storage *)result->ai_addr)->ss_family)
+            ch = *ip++;
+
+            if ( ch >= '0' && ch <= '9' )
+                {
+                    nibble = ch - '0';
+                }
+            else if ( ch >= 'a' && ch <= 'f' )
+                {
+                    nibble = ch - 'a' + 10;
+                }
+            else if ( ch >= 'A' && ch <= 'F' )
+                {
+                    nibble = ch - 'A' + 10;
+                }
+            else
+                {
+                    nibble = -1;
+                }
+
+            if ( nibble >= 0 )
+                {
+
+                    if ( ++digits > 4 )
+                        {
+                            return(false);
+                        }
+
+                    value = ( value << 4 ) | nibble;
+                    continue;
+                }
+
+            if ( ch == ':' )
                 {
-                case AF_INET:
 
-                    ret = true;
-                    if (out != NULL)
+                    curtok = ip;
+
+                    /* "::" - only one allowed */
+
+                    if ( digits == 0 )
                         {
-                            memcpy(out, &((struct sockaddr_in *)result->ai_addr)->sin_addr, sizeof(((struct sockaddr_in *)0)->sin_addr));
+
+                            if ( colonp != NULL )
+                                {
+                                    return(false);
+                                }
+
+                            colonp = tp;
+                            continue;
                         }
-                    break;
 
-                case AF_INET6:
+                    /* Trailing single ':' */
 
-                    ret = true;
-                    if (out != NULL)
+                    if ( ip >= end || tp + 2 > endp )
                         {
-                            memcpy(out, &((struct sockaddr_in6 *)result->ai_addr)->sin6_addr, sizeof(((struct sockaddr_in6 *)0)->sin6_addr));
+                            return(false);
                         }
+
+                    *tp++ = (unsigned char)( value >> 8 );
+                    *tp++ = (unsigned char)( value & 0xff );
+
+                    value = 0;
+                    digits = 0;
+                    continue;
+                }
+
+            /* Embedded IPv4 takes the last 32 bits */
+
+            if ( ch == '.' && tp + 4 <= endp && IP_Parse_IPv4( curtok, end, tp ) == true )
+                {
+                    tp += 4;
+                    digits = 0;
                     break;
+                }
 
-                default:
-                    Sagan_Log(WARN, "[%lu] Warning: Got a getaddrinfo() received a non IPv4/IPv6 address for \"%s\" but continuing...", pthread_self(), ipaddr);
+            return(false);
+        }
+
+    if ( digits > 0 )
+        {
+
+            if ( tp + 2 > endp )
+                {
+                    return(false);
                 }
+
+            *tp++ = (unsigned char)( value >> 8 );
+            *tp++ = (unsigned char)( value & 0xff );
         }
 
-    if (result != NULL)
+    /* Expand "::" to however many zero groups are missing */
+
+    if ( colonp != NULL )
         {
-            freeaddrinfo(result);
+
+            if ( tp == endp )
+                {
+                    return(false);
+                }
+
+            n = tp - colonp;
+            memmove(endp - n, colonp, n);
+            memset(colonp, 0, ( endp - n ) - colonp);
+            tp = endp;
         }
 
-    return ret;
+    if ( tp != endp )
+        {
+            return(false);
+        }
+
+    memcpy(out, tmp, MAXIPBIT);
+    return(true);
+}
+
+/****************************************************************************
+ * IP_Parse - Validates an IPv4 or IPv6 address and converts it to binary in
+ * one pass.  Returns IPv4,  IPv6 or 0 if "ipaddr" is not a valid address.
+ * If "out" is not NULL it gets MAXIPBIT bytes (IPv4 uses the first 4 and
+ * the rest are zeroed).  Nothing is allocated and no locks are taken,
+ * unlike getaddrinfo().  An IPv6 zone ("fe80::1%eth0") is ignored.
+ ****************************************************************************/
+
+int IP_Parse( const char *ipaddr, unsigned char *out )
+{
+
+    unsigned char bits[MAXIPBIT] = { 0 };
+    const char *end = NULL;
+    bool colon = false;
+    int ver = 0;
+
+    if ( ipaddr == NULL || ipaddr[0] == '\0' )
+        {
+            return(0);
+        }
+
+    /* Find the end of the address and whether it's IPv6 */
+
+    for ( end = ipaddr; *end != '\0'; end++ )
+        {
+
+            if ( *end == ':' )
+                {
+                    colon = true;
+                }
+
+            else if ( *end == '%' && colon == true )
+                {
+                    break;
+                }
+        }
+
+    if ( colon == true )
+        {
+
+            if ( IP_Parse_IPv6( ipaddr, end, bits ) == false )
+                {
+                    return(0);
+                }
+
+            ver = IPv6;
+        }
+    else
+        {
+
+            if ( IP_Parse_IPv4( ipaddr, end, bits ) == false )
+                {
+                    return(0);
+                }
+
+            ver = IPv4;
+        }
+
+    if ( out != NULL )
+        {
+            memcpy(out, bits, MAXIPBIT);
+        }
+
+    return(ver);
+}
+
+/* Converts IP address.  We assume that out is at least 16 bytes.  */
+
+bool IP2Bit(char *ipaddr, unsigned char *out)
+{
+
+    if ( ipaddr == NULL || ipaddr[0] == '\0' )
+        {
+            return false;
+        }
+
+    if ( IP_Parse( ipaddr, out ) == 0 )
+        {
+            Sagan_Log(WARN, "[%lu] Warning: Got an invalid IP address \"%s\" but continuing...", pthread_self(), ipaddr);
+            return false;
+        }
+
+    return true;
+}
+
+/****************************************************************************
+ * IP_Set - Fill a _Sagan_IP from a string.  This is the one place the
+ * string is parsed;  everything downstream uses "bits" and "family".  A
+ * string that isn't an IP address (a hostname in the syslog "host" field
+ * for example) gets a family of 0 and all zero bits.
+ ****************************************************************************/
+
+int IP_Set( struct _Sagan_IP *addr, char *ip )
+{
+
+    memset(addr->bits, 0, MAXIPBIT);
+
+    addr->family = IP_Parse( ip, addr->bits );
+    addr->text = ip;
+    addr->text_buf[0] = '\0';
+
+    return(addr->family);
+}
+
+/****************************************************************************
+ * IP_Text - The printable form of an address.  If the address didn't come
+ * from a string,  it's formatted from "bits" the first time it's needed.
+ ****************************************************************************/
+
+char *IP_Text( struct _Sagan_IP *addr )
+{
+
+    if ( addr->text != NULL )
+        {
+            return(addr->text);
+        }
+
+    if ( addr->text_buf[0] == '\0' )
+        {
+            Bit2IP(addr->bits, addr->text_buf, sizeof(addr->text_buf));
+        }
+
+    return(addr->text_buf);
+}
+
+/****************************************************************************
+ * IP_Hash - Hash an address for the state trackers.  Real addresses are
+ * hashed by their binary form,  anything else by its text so different
+ * hostnames don't collide on all zero bits.
+ ****************************************************************************/
+
+uint32_t IP_Hash( struct _Sagan_IP *addr, uint32_t hash )
+{
+
+    char *text = NULL;
+
+    if ( addr->family != 0 )
+        {
+            return( Fnv1a_Hash( addr->bits, MAXIPBIT, hash ) );
+        }
+
+    text = IP_Text( addr );
+
+    return( Fnv1a_Hash( text, strlen(text), hash ) );
+}
+
+/****************************************************************************
+ * IP_Hash64 - 64 bit version of IP_Hash() for the shared memory indexes
+ ****************************************************************************/
+
+uint64_t IP_Hash64( struct _Sagan_IP *addr, uint64_t hash )
+{
+
+    char *text = NULL;
+
+    if ( addr->family != 0 )
+        {
+            return( Fnv1a_Hash64( addr->bits, MAXIPBIT, hash ) );
+        }
+
+    text = IP_Text( addr );
+
+    return( Fnv1a_Hash64( text, strlen(text), hash ) );
 }
 
 /****************************************
@@ -800,7 +1109,7 @@ void Content_Pipe(char *in_string, int linecount, const char *ruleset, char *str
 
     /* Set to RULEBUF.  Some meta_content strings can be rather large! */
 
-    static char final_content[RULEBUF] = { 0 };
+    static __thread char final_content[RULEBUF] = { 0 };
     memset(final_content,0,sizeof(final_content));
 
     char final_content_tmp[RULEBUF] = { 0 };
@@ -1357,25 +1666,11 @@ void Strip_Chars(const char *string, const char *chars, char *str)
 bool Is_IP (char *ipaddr, int ver )
 {
 
-    struct sockaddr_in sa;
-    bool ret = false;
-    char ip[MAXIP];
-    strlcpy(ip, ipaddr, sizeof(ip));
-
     /* We don't use getaddrinfo().  Here's why:
      * See https://blog.powerdns.com/2014/05/21/a-surprising-discovery-on-converting-ipv6-addresses-we-no-longer-prefer-getaddrinfo/
      */
 
-    if ( (ver = 4 ) )
-        {
-            ret = inet_pton(AF_INET, ip,  &(sa.sin_addr));
-        }
-    else
-        {
-            ret = inet_pton(AF_INET6, ip,  &(sa.sin_addr));
-        }
-
-    return(ret);
+    return( IP_Parse( ipaddr, NULL ) == ver );
 
 }
 
@@ -1530,6 +1825,44 @@ uint32_t Djb2_Hash(char *str)
     return(hash);
 }
 
+/***************************************************************************
+ * Fnv1a_Hash - FNV-1a over "len" bytes.  "hash" is IP_HASH_SEED or the
+ * result of a previous call,  so several fields can be chained together.
+ ***************************************************************************/
+
+uint32_t Fnv1a_Hash( const void *data, size_t len, uint32_t hash )
+{
+
+    const unsigned char *p = data;
+    size_t i;
+
+    for ( i = 0; i < len; i++ )
+        {
+            hash = ( hash ^ p[i] ) * 16777619;
+        }
+
+    return(hash);
+}
+
+/***************************************************************************
+ * Fnv1a_Hash64 - 64 bit FNV-1a.  "hash" is IP_HASH64_SEED or the result
+ * of a previous call.
+ ***************************************************************************/
+
+uint64_t Fnv1a_Hash64( const void *data, size_t len, uint64_t hash )
+{
+
+    const unsigned char *p = data;
+    size_t i;
+
+    for ( i = 0; i < len; i++ )
+        {
+            hash = ( hash ^ p[i] ) * 1099511628211ULL;
+        }
+
+    return(hash);
+}
+
 char *strrpbrk(const char *str, const char *accept)
 {
     const char *test = NULL;
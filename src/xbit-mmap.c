@@ -19,7 +19,14 @@
 ** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 */
 
-/* xbit-mmap.c - memory mapped xbit support a la 'Suricata' style */
+/* xbit-mmap.c - memory mapped xbit support a la 'Suricata' style
+ *
+ * Xbits are indexed by their name and tracking hash (see ipc-hash.c).
+ * "set" and "unset" lock the stripe the xbit belongs to.  "isset" and
+ * "isnotset" don't lock anything.  Each entry carries a sequence count that
+ * is odd while it's being written,  so a reader just retries if an entry
+ * changed under it.
+ */
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"             /* From autoconf */
@@ -29,225 +36,329 @@
 #include <string.h>
 #include <time.h>
 #include <pthread.h>
+#include <sched.h>
 #include <stdbool.h>
 #include <sys/mman.h>
 
 #include "sagan.h"
 #include "sagan-defs.h"
 #include "ipc.h"
+#include "ipc-hash.h"
 #include "xbit.h"
 #include "xbit-mmap.h"
 #include "rules.h"
+#include "rule-generation.h"
 #include "sagan-config.h"
 #include "util-time.h"
 
 
 struct _SaganCounters *counters;
-struct _Rule_Struct *rulestruct;
 struct _SaganDebug *debug;
 struct _SaganConfig *config;
 
 struct _Sagan_IPC_Counters *counters_ipc;
 struct _Sagan_IPC_Xbit *Xbit_IPC;
+struct _IPC_Hash *Xbit_Index;
 
-pthread_mutex_t Xbit_Mutex=PTHREAD_MUTEX_INITIALIZER;
+/****************************************************************************
+ * Xbit_Key_Hash - Index hash for an xbit name and tracking hash
+ ****************************************************************************/
 
-/*************************************************/
-/* Xbit_Set_MMAP - Used to "set", "unset" a xbit */
-/*************************************************/
+static uint64_t Xbit_Key_Hash( struct _Xbit_Key *Key )
+{
+
+    uint64_t hash = Fnv1a_Hash64( &Key->xbit_name_hash, sizeof(Key->xbit_name_hash), IP_HASH64_SEED );
+
+    return( Fnv1a_Hash64( &Key->xbit_hash, sizeof(Key->xbit_hash), hash ) );
+}
 
-void Xbit_Set_MMAP(int rule_position, char *ip_src_char, char *ip_dst_char, char *syslog_message )
+/****************************************************************************
+ * Xbit_Match - Index match for "set" and "unset".  The stripe is locked.
+ ****************************************************************************/
+
+static bool Xbit_Match( uint32_t entry, void *arg )
 {
 
-    int r = 0;
-    int x = 0;
+    struct _Xbit_Key *Key = arg;
+
+    return( Xbit_IPC[entry].xbit_hash == Key->xbit_hash && Xbit_IPC[entry].xbit_name_hash == Key->xbit_name_hash );
+}
 
-    bool xbit_match = false;
-    uint32_t hash;
+/****************************************************************************
+ * Xbit_Expired - Can an entry be reused?  "arg" is the current time.
+ ****************************************************************************/
+
+static bool Xbit_Expired( uint32_t entry, void *arg )
+{
+    return( Xbit_IPC[entry].xbit_expire == 0 || *(uint64_t *)arg >= Xbit_IPC[entry].xbit_expire );
+}
 
-    if ( Clean_IPC_Object(XBIT) == 0 )
+/****************************************************************************
+ * Xbit_Read - Index match for "isset" and "isnotset" without the lock.
+ * The key and expire time are read between two loads of the entry's
+ * sequence count and retried if it moved.  The expire time is handed back
+ * in "Key".
+ ****************************************************************************/
+
+static bool Xbit_Read( uint32_t entry, void *arg )
+{
+
+    struct _Xbit_Key *Key = arg;
+    struct _Sagan_IPC_Xbit *Xbit = &Xbit_IPC[entry];
+
+    uint32_t seq = 0;
+    bool match = false;
+    int tries = 0;
+
+    for ( tries = 0; tries < XBIT_READ_TRIES; tries++ )
         {
 
-            for (r = 0; r < rulestruct[rule_position].xbit_count; r++)
+            /* A writer is part way through.  Give it the CPU rather than
+               spin,  it may be copying a whole syslog message */
+
+            if ( ( seq = __atomic_load_n(&Xbit->seq, __ATOMIC_ACQUIRE) ) & 1 )
                 {
+                    sched_yield();
+                    continue;
+                }
 
-                    if ( rulestruct[rule_position].xbit_type[r] == XBIT_SET )
-                        {
+            match = __atomic_load_n(&Xbit->xbit_hash, __ATOMIC_RELAXED) == Key->xbit_hash &&
+                    __atomic_load_n(&Xbit->xbit_name_hash, __ATOMIC_RELAXED) == Key->xbit_name_hash;
 
-                            hash = Xbit_Return_Tracking_Hash( rule_position, r, ip_src_char, ip_dst_char );
+            Key->xbit_expire = __atomic_load_n(&Xbit->xbit_expire, __ATOMIC_RELAXED);
 
-                            xbit_match = false;
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
 
-                            for ( x = 0; x < counters_ipc->xbit_count; x++ )
-                                {
+            if ( __atomic_load_n(&Xbit->seq, __ATOMIC_RELAXED) == seq )
+                {
+                    return(match);
+                }
+        }
+
+    /* Still being written.  Either the writer is slow (a long syslog
+       message,  or it was scheduled out) or it died part way through.  The
+       caller falls back to the lock. */
 
-                                    if ( hash == Xbit_IPC[x].xbit_hash && rulestruct[rule_position].xbit_name_hash[r] == Xbit_IPC[x].xbit_name_hash )
-                                        {
+    Key->torn = true;
+    return(false);
+}
 
-                                            if ( debug->debugxbit )
-                                                {
-                                                    Sagan_Log(DEBUG, "[%s, line %d] Got an xbit match at %d.  Updating xbit '%s' [hash: %u]", __FILE__, __LINE__, x, Xbit_IPC[x].xbit_name, Xbit_IPC[x].xbit_hash);
-                                                }
+/****************************************************************************
+ * Xbit_Write_Begin / Xbit_Write_End - Bracket changes to an entry.  The
+ * stripe is locked.
+ ****************************************************************************/
 
-                                            xbit_match = true;
+static void Xbit_Write_Begin( struct _Sagan_IPC_Xbit *Xbit )
+{
 
-                                            File_Lock(config->shm_xbit);
-                                            pthread_mutex_lock(&Xbit_Mutex);
+    /* Already odd if the last writer died part way through,  keep it odd */
 
-                                            strlcpy(Xbit_IPC[x].syslog_message, syslog_message, sizeof(Xbit_IPC[x].syslog_message));
-                                            strlcpy(Xbit_IPC[x].signature_msg, rulestruct[rule_position].s_msg, sizeof(Xbit_IPC[x].signature_msg));
-                                            Xbit_IPC[x].xbit_expire = Return_Epoch() + rulestruct[rule_position].xbit_expire[r];
-                                            Xbit_IPC[x].expire = rulestruct[rule_position].xbit_expire[r];
-                                            Xbit_IPC[x].sid = rulestruct[rule_position].s_sid;
-                                            Xbit_IPC[x].xbit_hash = hash;
-                                            Xbit_IPC[x].xbit_name_hash = rulestruct[rule_position].xbit_name_hash[r];
-                                            File_Unlock(config->shm_xbit);
-                                            pthread_mutex_unlock(&Xbit_Mutex);
+    uint32_t seq = Xbit->seq;
 
-                                        }
+    __atomic_store_n(&Xbit->seq, seq + 1 + ( seq & 1 ), __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
 
-                                }
+static void Xbit_Write_End( struct _Sagan_IPC_Xbit *Xbit )
+{
+    __atomic_store_n(&Xbit->seq, Xbit->seq + 1, __ATOMIC_RELEASE);
+}
 
+/****************************************************************************
+ * Xbit_Is_Set - Is the xbit in "Key" set and not expired?
+ ****************************************************************************/
 
-                            /* No xbit to update, add one */
+static bool Xbit_Is_Set( struct _Xbit_Key *Key, uint64_t current_time )
+{
 
-                            if ( xbit_match == false )
-                                {
+    uint64_t hash = Xbit_Key_Hash( Key );
+    uint32_t stripe = 0;
+    int32_t x = 0;
 
-                                    File_Lock(config->shm_xbit);
-                                    pthread_mutex_lock(&Xbit_Mutex);
+    Key->torn = false;
+    Key->xbit_expire = 0;
 
-                                    strlcpy(Xbit_IPC[counters_ipc->xbit_count].xbit_name, rulestruct[rule_position].xbit_name[r], sizeof(Xbit_IPC[counters_ipc->xbit_count].xbit_name));
-                                    strlcpy(Xbit_IPC[counters_ipc->xbit_count].syslog_message, syslog_message, sizeof(Xbit_IPC[counters_ipc->xbit_count].syslog_message));
-                                    strlcpy(Xbit_IPC[counters_ipc->xbit_count].signature_msg, rulestruct[rule_position].s_msg, sizeof(Xbit_IPC[counters_ipc->xbit_count].signature_msg));
+    x = IPC_Hash_Lookup( Xbit_Index, hash, Xbit_Read, Key );
 
-                                    Xbit_IPC[counters_ipc->xbit_count].xbit_expire = Return_Epoch() + rulestruct[rule_position].xbit_expire[r];
-                                    Xbit_IPC[x].expire = rulestruct[rule_position].xbit_expire[r];
-                                    Xbit_IPC[counters_ipc->xbit_count].sid = rulestruct[rule_position].s_sid;
-                                    Xbit_IPC[counters_ipc->xbit_count].xbit_hash = hash;
-                                    Xbit_IPC[counters_ipc->xbit_count].xbit_name_hash = rulestruct[rule_position].xbit_name_hash[r];
+    if ( Key->torn == true )
+        {
 
-                                    if ( debug->debugxbit )
-                                        {
-                                            Sagan_Log(DEBUG, "[%s, line %d] Adding xbit '%s' at %d [hash: %u]", __FILE__, __LINE__, Xbit_IPC[x].xbit_name, x, Xbit_IPC[x].xbit_hash);
-                                        }
+            stripe = IPC_Hash_Lock( Xbit_Index, hash );
 
-                                    counters_ipc->xbit_count++;
+            if ( ( x = IPC_Hash_Lookup( Xbit_Index, hash, Xbit_Match, Key ) ) != -1 )
+                {
+                    Key->xbit_expire = Xbit_IPC[x].xbit_expire;
+                }
+
+            IPC_Hash_Unlock( Xbit_Index, stripe );
+        }
 
-                                    pthread_mutex_unlock(&Xbit_Mutex);
-                                    File_Unlock(config->shm_xbit);
+    return( x != -1 && Key->xbit_expire != 0 && current_time < Key->xbit_expire );
+}
+
+/*************************************************/
+/* Xbit_Set_MMAP - Used to "set", "unset" a xbit */
+/*************************************************/
+
+void Xbit_Set_MMAP(int rule_position, struct _Sagan_IP *ip_src, struct _Sagan_IP *ip_dst, char *syslog_message )
+{
+
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
+
+    int r = 0;
+    int32_t x = 0;
+
+    struct _Xbit_Key Key;
+    uint64_t hash = 0;
+    uint64_t current_time = Return_Epoch();
+    uint32_t stripe = 0;
+
+    for (r = 0; r < gen->rulestruct[rule_position].xbit_count; r++)
+        {
 
+            if ( gen->rulestruct[rule_position].xbit_type[r] == XBIT_SET )
+                {
+
+                    Key.xbit_hash = Xbit_Return_Tracking_Hash( rule_position, r, ip_src, ip_dst );
+                    Key.xbit_name_hash = gen->rulestruct[rule_position].xbit_name_hash[r];
+
+                    hash = Xbit_Key_Hash( &Key );
+
+                    stripe = IPC_Hash_Lock( Xbit_Index, hash );
+
+                    if ( ( x = IPC_Hash_Lookup( Xbit_Index, hash, Xbit_Match, &Key ) ) != -1 )
+                        {
+
+                            if ( debug->debugxbit )
+                                {
+                                    Sagan_Log(DEBUG, "[%s, line %d] Got an xbit match at %d.  Updating xbit '%s' [hash: %u]", __FILE__, __LINE__, x, Xbit_IPC[x].xbit_name, Xbit_IPC[x].xbit_hash);
                                 }
 
                         }
 
-                    /* UNSET */
+                    /* No xbit to update, add one */
 
-                    else if ( rulestruct[rule_position].xbit_type[r] == XBIT_UNSET )
+                    else if ( ( x = IPC_Hash_Insert( Xbit_Index, hash, Xbit_Expired, &current_time ) ) != -1 )
                         {
 
-                            hash = Xbit_Return_Tracking_Hash( rule_position, r, ip_src_char, ip_dst_char );
+                            if ( debug->debugxbit )
+                                {
+                                    Sagan_Log(DEBUG, "[%s, line %d] Adding xbit '%s' at %d [hash: %u]", __FILE__, __LINE__, gen->rulestruct[rule_position].xbit_name[r], x, Key.xbit_hash);
+                                }
 
-                            xbit_match = false;
+                        }
 
-                            for ( x = 0; x < counters_ipc->xbit_count; x++ )
-                                {
+                    else
+                        {
+                            IPC_Hash_Unlock( Xbit_Index, stripe );
+                            Sagan_Log(WARN, "[%s, line %d] Xbit_IPC is full,  cannot set xbit '%s'.", __FILE__, __LINE__, gen->rulestruct[rule_position].xbit_name[r]);
+                            continue;
+                        }
+
+                    Xbit_Write_Begin( &Xbit_IPC[x] );
+
+                    strlcpy(Xbit_IPC[x].xbit_name, gen->rulestruct[rule_position].xbit_name[r], sizeof(Xbit_IPC[x].xbit_name));
+                    strlcpy(Xbit_IPC[x].syslog_message, syslog_message, sizeof(Xbit_IPC[x].syslog_message));
+                    strlcpy(Xbit_IPC[x].signature_msg, gen->rulestruct[rule_position].s_msg, sizeof(Xbit_IPC[x].signature_msg));
+
+                    __atomic_store_n(&Xbit_IPC[x].xbit_expire, current_time + gen->rulestruct[rule_position].xbit_expire[r], __ATOMIC_RELAXED);
+                    __atomic_store_n(&Xbit_IPC[x].xbit_hash, Key.xbit_hash, __ATOMIC_RELAXED);
+                    __atomic_store_n(&Xbit_IPC[x].xbit_name_hash, Key.xbit_name_hash, __ATOMIC_RELAXED);
+
+                    Xbit_IPC[x].expire = gen->rulestruct[rule_position].xbit_expire[r];
+                    Xbit_IPC[x].sid = gen->rulestruct[rule_position].s_sid;
+
+                    Xbit_Write_End( &Xbit_IPC[x] );
 
-                                    if ( hash == Xbit_IPC[x].xbit_hash && rulestruct[rule_position].xbit_name_hash[r] == Xbit_IPC[x].xbit_name_hash )
-                                        {
+                    IPC_Hash_Unlock( Xbit_Index, stripe );
+
+                    __atomic_store_n(&counters_ipc->xbit_count, Xbit_Index->entry_count, __ATOMIC_SEQ_CST);
+
+                }
+
+            /* UNSET */
+
+            else if ( gen->rulestruct[rule_position].xbit_type[r] == XBIT_UNSET )
+                {
 
-                                            if ( debug->debugxbit )
-                                                {
-                                                    Sagan_Log(DEBUG, "[%s, line %d] Unsetting xbit '%s' at %d [hash: %u]", __FILE__, __LINE__, Xbit_IPC[x].xbit_name, x, Xbit_IPC[x].xbit_hash);
-                                                }
+                    Key.xbit_hash = Xbit_Return_Tracking_Hash( rule_position, r, ip_src, ip_dst );
+                    Key.xbit_name_hash = gen->rulestruct[rule_position].xbit_name_hash[r];
 
-                                            Xbit_IPC[x].xbit_expire = 0;
+                    hash = Xbit_Key_Hash( &Key );
 
-                                        }
+                    stripe = IPC_Hash_Lock( Xbit_Index, hash );
 
+                    if ( ( x = IPC_Hash_Lookup( Xbit_Index, hash, Xbit_Match, &Key ) ) != -1 )
+                        {
+
+                            if ( debug->debugxbit )
+                                {
+                                    Sagan_Log(DEBUG, "[%s, line %d] Unsetting xbit '%s' at %d [hash: %u]", __FILE__, __LINE__, Xbit_IPC[x].xbit_name, x, Xbit_IPC[x].xbit_hash);
                                 }
 
+                            Xbit_Write_Begin( &Xbit_IPC[x] );
+                            __atomic_store_n(&Xbit_IPC[x].xbit_expire, 0, __ATOMIC_RELAXED);
+                            Xbit_Write_End( &Xbit_IPC[x] );
+
                         }
 
-                } /* for (r = 0; r < rulestruct[rule_position].xbit_count; r++) */
-        }
+                    IPC_Hash_Unlock( Xbit_Index, stripe );
+
+                }
+
+        } /* for (r = 0; r < rulestruct[rule_position].xbit_count; r++) */
+
 }
 
 /**********************************************************/
 /* Xbit_Condition_MMAP - Handles logic for isset/isnotset */
 /**********************************************************/
 
-bool Xbit_Condition_MMAP(int rule_position, char *ip_src_char, char *ip_dst_char)
+bool Xbit_Condition_MMAP(int rule_position, struct _Sagan_IP *ip_src, struct _Sagan_IP *ip_dst)
 {
 
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
+
     int r = 0;
-    int x = 0;
     int xbit_isset = 0;
     int xbit_isnotset = 0;
 
-    bool xbit_match = false;
-
-    uint32_t hash;
+    struct _Xbit_Key Key;
+    uint64_t current_time = Return_Epoch();
 
-    for (r = 0; r < rulestruct[rule_position].xbit_count; r++)
+    for (r = 0; r < gen->rulestruct[rule_position].xbit_count; r++)
         {
 
-            if ( rulestruct[rule_position].xbit_type[r] == XBIT_ISSET )
+            if ( gen->rulestruct[rule_position].xbit_type[r] == XBIT_ISSET )
                 {
 
-                    hash = Xbit_Return_Tracking_Hash( rule_position, r, ip_src_char, ip_dst_char );
+                    Key.xbit_hash = Xbit_Return_Tracking_Hash( rule_position, r, ip_src, ip_dst );
+                    Key.xbit_name_hash = gen->rulestruct[rule_position].xbit_name_hash[r];
 
-                    for ( x = 0; x < counters_ipc->xbit_count; x++ )
+                    if ( Xbit_Is_Set( &Key, current_time ) == true )
                         {
 
-                            if ( hash == Xbit_IPC[x].xbit_hash &&
-                                    rulestruct[rule_position].xbit_name_hash[r] == Xbit_IPC[x].xbit_name_hash &&
-                                    Xbit_IPC[x].xbit_expire != 0 )
+                            if ( debug->debugxbit )
                                 {
-
-                                    if ( Return_Epoch() < Xbit_IPC[x].xbit_expire )
-                                        {
-
-                                            if ( debug->debugxbit )
-                                                {
-                                                    Sagan_Log(DEBUG, "[%s, line %d] Xbit '%s' found for 'isset' at %d [hash: %u]", __FILE__, __LINE__, Xbit_IPC[x].xbit_name, x, Xbit_IPC[x].xbit_hash);
-                                                }
-
-                                            xbit_isset++;
-                                            break;
-
-                                        }
+                                    Sagan_Log(DEBUG, "[%s, line %d] Xbit '%s' found for 'isset' [hash: %u]", __FILE__, __LINE__, gen->rulestruct[rule_position].xbit_name[r], Key.xbit_hash);
                                 }
+
+                            xbit_isset++;
                         }
                 }
 
-            else if ( rulestruct[rule_position].xbit_type[r] == XBIT_ISNOTSET )
+            else if ( gen->rulestruct[rule_position].xbit_type[r] == XBIT_ISNOTSET )
                 {
 
-                    hash = Xbit_Return_Tracking_Hash( rule_position, r, ip_src_char, ip_dst_char );
+                    Key.xbit_hash = Xbit_Return_Tracking_Hash( rule_position, r, ip_src, ip_dst );
+                    Key.xbit_name_hash = gen->rulestruct[rule_position].xbit_name_hash[r];
 
-                    for ( x = 0; x < counters_ipc->xbit_count; x++ )
-                        {
-
-                            if ( hash == Xbit_IPC[x].xbit_hash &&
-                                    rulestruct[rule_position].xbit_name_hash[r] == Xbit_IPC[x].xbit_name_hash &&
-                                    Xbit_IPC[x].xbit_expire != 0 )
-                                {
-                                    if ( Return_Epoch() < Xbit_IPC[x].xbit_expire )
-                                        {
-
-                                            xbit_match = true;
-                                            break;
-                                        }
-                                }
-                        }
-
-                    if ( xbit_match == false )
+                    if ( Xbit_Is_Set( &Key, current_time ) == false )
                         {
 
                             if ( debug->debugxbit )
                                 {
-                                    Sagan_Log(DEBUG, "[%s, line %d] Xbit '%s' not found for 'isnotset'", __FILE__, __LINE__, rulestruct[rule_position].xbit_name[r]);
+                                    Sagan_Log(DEBUG, "[%s, line %d] Xbit '%s' not found for 'isnotset'", __FILE__, __LINE__, gen->rulestruct[rule_position].xbit_name[r]);
                                 }
 
                             xbit_isnotset++;
@@ -258,8 +369,8 @@ bool Xbit_Condition_MMAP(int rule_position, char *ip_src_char, char *ip_dst_char
 
     /* check counts for set/unset! return if == */
 
-    if ( rulestruct[rule_position].xbit_isset_count == xbit_isset &&
-            rulestruct[rule_position].xbit_isnotset_count == xbit_isnotset )
+    if ( gen->rulestruct[rule_position].xbit_isset_count == xbit_isset &&
+            gen->rulestruct[rule_position].xbit_isnotset_count == xbit_isnotset )
         {
 
             if ( debug->debugxbit )
@@ -278,4 +389,3 @@ bool Xbit_Condition_MMAP(int rule_position, char *ip_src_char, char *ip_dst_char
     return(false);
 
 }
-
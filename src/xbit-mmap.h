@@ -19,14 +19,16 @@
 ** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 */
 
+#define XBIT_READ_TRIES		64	/* Xbit_Read() yields before taking the lock */
 
-void Xbit_Set_MMAP(int rule_position, char *ip_src_char, char *ip_dst_char, char *syslog_message );
-bool Xbit_Condition_MMAP(int rule_position, char *ip_src_char, char *ip_dst_char);
+void Xbit_Set_MMAP(int rule_position, struct _Sagan_IP *ip_src, struct _Sagan_IP *ip_dst, char *syslog_message );
+bool Xbit_Condition_MMAP(int rule_position, struct _Sagan_IP *ip_src, struct _Sagan_IP *ip_dst);
 void Clean_Xbit_MMAP(void);
 
 typedef struct _Sagan_IPC_Xbit _Sagan_IPC_Xbit;
 struct _Sagan_IPC_Xbit
 {
+    uint32_t seq;			/* Odd while being written,  see Xbit_Read() */
     char xbit_name[64];
     uint32_t xbit_hash;
     uint32_t xbit_name_hash;
@@ -37,3 +39,14 @@ struct _Sagan_IPC_Xbit
     char signature_msg[MAX_SAGAN_MSG];
 
 };
+
+/* What an isset/isnotset lookup is after,  and what it found */
+
+typedef struct _Xbit_Key _Xbit_Key;
+struct _Xbit_Key
+{
+    uint32_t xbit_hash;
+    uint32_t xbit_name_hash;
+    uint64_t xbit_expire;
+    bool torn;				/* Gave up waiting on a writer */
+};
@@ -39,13 +39,13 @@
 #include "xbit.h"
 #include "xbit-redis.h"
 #include "rules.h"
+#include "rule-generation.h"
 #include "redis.h"
 #include "sagan-config.h"
 
 #define 	REDIS_PREFIX	"sagan"
 
 struct _SaganCounters *counters;
-struct _Rule_Struct *rulestruct;
 struct _SaganDebug *debug;
 struct _SaganConfig *config;
 
@@ -60,9 +60,11 @@ int redis_msgslot;
 /* Xbit_Set_Redis - set/unset xbit in Redis (threaded) */
 /*******************************************************/
 
-void Xbit_Set_Redis(int rule_position, char *ip_src_char, char *ip_dst_char, _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL )
+void Xbit_Set_Redis(int rule_position, struct _Sagan_IP *ip_src, struct _Sagan_IP *ip_dst, _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL )
 {
 
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
+
     struct json_object *jobj;
 
     int r = 0;
@@ -74,17 +76,17 @@ void Xbit_Set_Redis(int rule_position, char *ip_src_char, char *ip_dst_char, _Sa
 
     //jobj = json_object_new_object();
 
-    for (r = 0; r < rulestruct[rule_position].xbit_count; r++)
+    for (r = 0; r < gen->rulestruct[rule_position].xbit_count; r++)
         {
 
-            if ( rulestruct[rule_position].xbit_type[r] == XBIT_SET )
+            if ( gen->rulestruct[rule_position].xbit_type[r] == XBIT_SET )
                 {
 
-                    Xbit_Return_Tracking_IP( rule_position, r, ip_src_char, ip_dst_char, tmp_ip, sizeof(tmp_ip));
+                    Xbit_Return_Tracking_IP( rule_position, r, ip_src, ip_dst, tmp_ip, sizeof(tmp_ip));
 
                     if ( debug->debugxbit )
                         {
-                            Sagan_Log(DEBUG, "[%s, line %d] Xbit '%s' set in Redis for %s for %d seconds", __FILE__, __LINE__, rulestruct[rule_position].xbit_name[r], tmp_ip, rulestruct[rule_position].xbit_expire[r]);
+                            Sagan_Log(DEBUG, "[%s, line %d] Xbit '%s' set in Redis for %s for %d seconds", __FILE__, __LINE__, gen->rulestruct[rule_position].xbit_name[r], tmp_ip, gen->rulestruct[rule_position].xbit_expire[r]);
                         }
 
                     if ( redis_msgslot < config->redis_max_writer_threads )
@@ -95,7 +97,7 @@ void Xbit_Set_Redis(int rule_position, char *ip_src_char, char *ip_dst_char, _Sa
                             json_object *jsensor = json_object_new_string(config->sagan_sensor_name);
                             json_object_object_add(jobj,"sensor", jsensor);
 
-                            json_object *jexpire = json_object_new_int(rulestruct[rule_position].xbit_expire[r]);
+                            json_object *jexpire = json_object_new_int(gen->rulestruct[rule_position].xbit_expire[r]);
                             json_object_object_add(jobj,"expire", jexpire);
 
                             json_object *jsrc_ip = json_object_new_string(SaganProcSyslog_LOCAL->syslog_host);
@@ -125,13 +127,13 @@ void Xbit_Set_Redis(int rule_position, char *ip_src_char, char *ip_dst_char, _Sa
                             json_object *jmessage = json_object_new_string(SaganProcSyslog_LOCAL->syslog_message);
                             json_object_object_add(jobj,"message", jmessage);
 
-                            json_object *jsignature = json_object_new_string(rulestruct[rule_position].s_msg);
+                            json_object *jsignature = json_object_new_string(gen->rulestruct[rule_position].s_msg);
                             json_object_object_add(jobj,"signature", jsignature);
 
-                            json_object *jsid = json_object_new_int64(rulestruct[rule_position].s_sid);
+                            json_object *jsid = json_object_new_int64(gen->rulestruct[rule_position].s_sid);
                             json_object_object_add(jobj,"sid", jsid);
 
-                            json_object *jrev = json_object_new_int(rulestruct[rule_position].s_rev);
+                            json_object *jrev = json_object_new_int(gen->rulestruct[rule_position].s_rev);
                             json_object_object_add(jobj,"rev", jrev);
 
                             snprintf(tmp_data, sizeof(tmp_data), "%s", json_object_to_json_string(jobj));
@@ -142,10 +144,10 @@ void Xbit_Set_Redis(int rule_position, char *ip_src_char, char *ip_dst_char, _Sa
                             pthread_mutex_lock(&SaganRedisWorkMutex);
 
                             strlcpy(Sagan_Redis_Write[redis_msgslot].command, "SET", sizeof(Sagan_Redis_Write[redis_msgslot].command));
-                            snprintf(Sagan_Redis_Write[redis_msgslot].key, sizeof(Sagan_Redis_Write[redis_msgslot].key), "%s:%s:%s:%s", REDIS_PREFIX, config->sagan_cluster_name, rulestruct[rule_position].xbit_name[r], tmp_ip);
+                            snprintf(Sagan_Redis_Write[redis_msgslot].key, sizeof(Sagan_Redis_Write[redis_msgslot].key), "%s:%s:%s:%s", REDIS_PREFIX, config->sagan_cluster_name, gen->rulestruct[rule_position].xbit_name[r], tmp_ip);
 
                             strlcpy(Sagan_Redis_Write[redis_msgslot].value, tmp_data, sizeof(Sagan_Redis_Write[redis_msgslot].value));
-                            Sagan_Redis_Write[redis_msgslot].expire = rulestruct[rule_position].xbit_expire[r];
+                            Sagan_Redis_Write[redis_msgslot].expire = gen->rulestruct[rule_position].xbit_expire[r];
 
                             redis_msgslot++;
 
@@ -161,14 +163,14 @@ void Xbit_Set_Redis(int rule_position, char *ip_src_char, char *ip_dst_char, _Sa
 
                 }
 
-            else if ( rulestruct[rule_position].xbit_type[r] == XBIT_UNSET )
+            else if ( gen->rulestruct[rule_position].xbit_type[r] == XBIT_UNSET )
                 {
 
-                    Xbit_Return_Tracking_IP( rule_position, r, ip_src_char, ip_dst_char, tmp_ip, sizeof(tmp_ip));
+                    Xbit_Return_Tracking_IP( rule_position, r, ip_src, ip_dst, tmp_ip, sizeof(tmp_ip));
 
                     if ( debug->debugxbit )
                         {
-                            Sagan_Log(DEBUG, "[%s, line %d] Xbit '%s' for %s unset in Redis", __FILE__, __LINE__, rulestruct[rule_position].xbit_name[r], tmp_ip);
+                            Sagan_Log(DEBUG, "[%s, line %d] Xbit '%s' for %s unset in Redis", __FILE__, __LINE__, gen->rulestruct[rule_position].xbit_name[r], tmp_ip);
                         }
 
                     if ( redis_msgslot < config->redis_max_writer_threads )
@@ -177,7 +179,7 @@ void Xbit_Set_Redis(int rule_position, char *ip_src_char, char *ip_dst_char, _Sa
                             pthread_mutex_lock(&SaganRedisWorkMutex);
 
                             strlcpy(Sagan_Redis_Write[redis_msgslot].command, "DEL", sizeof(Sagan_Redis_Write[redis_msgslot].command));
-                            snprintf(Sagan_Redis_Write[redis_msgslot].key, sizeof(Sagan_Redis_Write[redis_msgslot].key), "%s:%s:%s:%s", REDIS_PREFIX, config->sagan_cluster_name, rulestruct[rule_position].xbit_name[r], tmp_ip);
+                            snprintf(Sagan_Redis_Write[redis_msgslot].key, sizeof(Sagan_Redis_Write[redis_msgslot].key), "%s:%s:%s:%s", REDIS_PREFIX, config->sagan_cluster_name, gen->rulestruct[rule_position].xbit_name[r], tmp_ip);
                             Sagan_Redis_Write[redis_msgslot].value[0] = '\0';
                             Sagan_Redis_Write[redis_msgslot].expire = 0;
 
@@ -199,42 +201,44 @@ void Xbit_Set_Redis(int rule_position, char *ip_src_char, char *ip_dst_char, _Sa
 /* Xbit_Condition_Redis - Tests for Redis xbit (isset/isnotset) */
 /****************************************************************/
 
-bool Xbit_Condition_Redis(int rule_position, char *ip_src_char, char *ip_dst_char )
+bool Xbit_Condition_Redis(int rule_position, struct _Sagan_IP *ip_src, struct _Sagan_IP *ip_dst )
 {
 
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
+
     int r;
     char redis_command[64] = { 0 };
     char redis_results[32] = { 0 };
     char tmp_ip[MAXIP] = { 0 };
     bool xbit_match = false;
 
-    for (r = 0; r < rulestruct[rule_position].xbit_count; r++)
+    for (r = 0; r < gen->rulestruct[rule_position].xbit_count; r++)
         {
 
-            Xbit_Return_Tracking_IP( rule_position, r, ip_src_char, ip_dst_char, tmp_ip, sizeof(tmp_ip));
+            Xbit_Return_Tracking_IP( rule_position, r, ip_src, ip_dst, tmp_ip, sizeof(tmp_ip));
 
             snprintf(redis_command, sizeof(redis_command),
-                     "GET %s:%s:%s:%s", REDIS_PREFIX, config->sagan_cluster_name, rulestruct[rule_position].xbit_name[r], tmp_ip);
+                     "GET %s:%s:%s:%s", REDIS_PREFIX, config->sagan_cluster_name, gen->rulestruct[rule_position].xbit_name[r], tmp_ip);
 
             Redis_Reader ( (char *)redis_command, redis_results, sizeof(redis_results) );
 
-            if ( redis_results[0] == '\0' && rulestruct[rule_position].xbit_type[r] == XBIT_ISSET )
+            if ( redis_results[0] == '\0' && gen->rulestruct[rule_position].xbit_type[r] == XBIT_ISSET )
                 {
 
                     if ( debug->debugxbit )
                         {
-                            Sagan_Log(DEBUG, "[%s, line %d] Xbit '%s' was not found IP address %s for isset. Returning false.", __FILE__, __LINE__, rulestruct[rule_position].xbit_name[r], tmp_ip);
+                            Sagan_Log(DEBUG, "[%s, line %d] Xbit '%s' was not found IP address %s for isset. Returning false.", __FILE__, __LINE__, gen->rulestruct[rule_position].xbit_name[r], tmp_ip);
                         }
 
                     return(false);
                 }
 
-            else if ( redis_results[0] != '\0' && rulestruct[rule_position].xbit_type[r] == XBIT_ISNOTSET )
+            else if ( redis_results[0] != '\0' && gen->rulestruct[rule_position].xbit_type[r] == XBIT_ISNOTSET )
                 {
 
                     if ( debug->debugxbit )
                         {
-                            Sagan_Log(DEBUG, "[%s, line %d] Xbit '%s' was found for IP address %s for isnotset. Returning false.", __FILE__, __LINE__, rulestruct[rule_position].xbit_name[r], tmp_ip);
+                            Sagan_Log(DEBUG, "[%s, line %d] Xbit '%s' was found for IP address %s for isnotset. Returning false.", __FILE__, __LINE__, gen->rulestruct[rule_position].xbit_name[r], tmp_ip);
                         }
 
 
@@ -256,24 +260,26 @@ bool Xbit_Condition_Redis(int rule_position, char *ip_src_char, char *ip_dst_cha
  * Actual IP addresses so that it's easier to "see" in Redis.
  ******************************************************************************************/
 
-void Xbit_Return_Tracking_IP ( int rule_position, int xbit_position, char *ip_src_char, char *ip_dst_char, char *str, size_t size )
+void Xbit_Return_Tracking_IP ( int rule_position, int xbit_position, struct _Sagan_IP *ip_src, struct _Sagan_IP *ip_dst, char *str, size_t size )
 {
 
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
+
     /* These 1,2,3 values should really be defined */
 
-    if ( rulestruct[rule_position].xbit_direction[xbit_position] == 1 )
+    if ( gen->rulestruct[rule_position].xbit_direction[xbit_position] == 1 )
         {
-            snprintf(str, size, "%s", ip_src_char);
+            snprintf(str, size, "%s", IP_Text(ip_src));
         }
 
-    else if ( rulestruct[rule_position].xbit_direction[xbit_position] == 2 )
+    else if ( gen->rulestruct[rule_position].xbit_direction[xbit_position] == 2 )
         {
-            snprintf(str, size, "%s", ip_dst_char);
+            snprintf(str, size, "%s", IP_Text(ip_dst));
         }
 
-    else if (  rulestruct[rule_position].xbit_direction[xbit_position] == 3 )
+    else if (  gen->rulestruct[rule_position].xbit_direction[xbit_position] == 3 )
         {
-            snprintf(str, size, "%s:%s",  ip_src_char, ip_dst_char);
+            snprintf(str, size, "%s:%s",  IP_Text(ip_src), IP_Text(ip_dst));
         }
 
 }
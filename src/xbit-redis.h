@@ -19,6 +19,6 @@
 ** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 */
 
-void Xbit_Set_Redis(int rule_position, char *ip_src_char, char *ip_dst_char, _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL );
-bool Xbit_Condition_Redis(int rule_position, char *ip_src_char, char *ip_dst_char);
-void Xbit_Return_Tracking_IP ( int rule_position, int xbit_position, char *ip_src_char, char *ip_dst_char, char *str, size_t size );
+void Xbit_Set_Redis(int rule_position, struct _Sagan_IP *ip_src, struct _Sagan_IP *ip_dst, _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL );
+bool Xbit_Condition_Redis(int rule_position, struct _Sagan_IP *ip_src, struct _Sagan_IP *ip_dst);
+void Xbit_Return_Tracking_IP ( int rule_position, int xbit_position, struct _Sagan_IP *ip_src, struct _Sagan_IP *ip_dst, char *str, size_t size );
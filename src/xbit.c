@@ -32,6 +32,7 @@
 #include "sagan-defs.h"
 #include "sagan-config.h"
 #include "rules.h"
+#include "rule-generation.h"
 
 #include "xbit.h"
 #include "xbit-mmap.h"
@@ -43,7 +44,6 @@
 
 #endif
 
-struct _Rule_Struct *rulestruct;
 struct _SaganConfig *config;
 
 
@@ -51,20 +51,20 @@ struct _SaganConfig *config;
 /* Xbit_Set - "set", "unset" and "toggle" and xbit */
 /***************************************************/
 
-void Xbit_Set(int rule_position, char *ip_src_char, char *ip_dst_char, _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL )
+void Xbit_Set(int rule_position, struct _Sagan_IP *ip_src, struct _Sagan_IP *ip_dst, _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL )
 {
 
 #ifdef HAVE_LIBHIREDIS
 
     if ( config->redis_flag && config->xbit_storage == XBIT_STORAGE_REDIS )
         {
-            Xbit_Set_Redis(rule_position, ip_src_char, ip_dst_char, SaganProcSyslog_LOCAL );
+            Xbit_Set_Redis(rule_position, ip_src, ip_dst, SaganProcSyslog_LOCAL );
             return;
         }
 
 #endif
 
-    Xbit_Set_MMAP(rule_position, ip_src_char, ip_dst_char, SaganProcSyslog_LOCAL->syslog_message );
+    Xbit_Set_MMAP(rule_position, ip_src, ip_dst, SaganProcSyslog_LOCAL->syslog_message );
 
 }
 
@@ -73,31 +73,30 @@ void Xbit_Set(int rule_position, char *ip_src_char, char *ip_dst_char, _Sagan_Pr
 /* determine the direction an xbit and returns a hash for association            */
 /*********************************************************************************/
 
-uint32_t Xbit_Return_Tracking_Hash ( int rule_position, int xbit_position, char *ip_src_char, char *ip_dst_char )
+uint32_t Xbit_Return_Tracking_Hash ( int rule_position, int xbit_position, struct _Sagan_IP *ip_src, struct _Sagan_IP *ip_dst )
 {
 
-    char hash_pair[MAXIP*2] = { 0 };
+    const struct _Rule_Generation *gen = Rule_Generation_Current();
 
-    if ( rulestruct[rule_position].xbit_direction[xbit_position] == 1 )
+    if ( gen->rulestruct[rule_position].xbit_direction[xbit_position] == 1 )
         {
-            return(Djb2_Hash(ip_src_char));
+            return(IP_Hash(ip_src, IP_HASH_SEED));
         }
 
-    else if ( rulestruct[rule_position].xbit_direction[xbit_position] == 2 )
+    else if ( gen->rulestruct[rule_position].xbit_direction[xbit_position] == 2 )
         {
-            return(Djb2_Hash(ip_dst_char));
+            return(IP_Hash(ip_dst, IP_HASH_SEED));
         }
 
-    else if (  rulestruct[rule_position].xbit_direction[xbit_position] == 3 )
+    else if (  gen->rulestruct[rule_position].xbit_direction[xbit_position] == 3 )
         {
-            snprintf(hash_pair, sizeof(hash_pair), "%s:%s",  ip_src_char, ip_dst_char);
-            return(Djb2_Hash(hash_pair));
+            return(IP_Hash(ip_dst, IP_Hash(ip_src, IP_HASH_SEED)));
         }
 
 
     /* Should never get here */
 
-    Sagan_Log(WARN, "[%s, line %d] Bad xbit_direction for sid %" PRIu64 "", __FILE__, __LINE__, rulestruct[rule_position].s_sid);
+    Sagan_Log(WARN, "[%s, line %d] Bad xbit_direction for sid %" PRIu64 "", __FILE__, __LINE__, gen->rulestruct[rule_position].s_sid);
     return(0);
 
 }
@@ -106,19 +105,19 @@ uint32_t Xbit_Return_Tracking_Hash ( int rule_position, int xbit_position, char
 /* Xbit_Condition - This handles xbit conditions like "isset", "issnotset". */
 /****************************************************************************/
 
-bool Xbit_Condition(int rule_position, char *ip_src_char, char *ip_dst_char)
+bool Xbit_Condition(int rule_position, struct _Sagan_IP *ip_src, struct _Sagan_IP *ip_dst)
 {
 
 #ifdef HAVE_LIBHIREDIS
 
     if ( config->redis_flag && config->xbit_storage == XBIT_STORAGE_REDIS )
         {
-            return(Xbit_Condition_Redis(rule_position, ip_src_char, ip_dst_char));
+            return(Xbit_Condition_Redis(rule_position, ip_src, ip_dst));
         }
 
 #endif
 
-    return(Xbit_Condition_MMAP(rule_position, ip_src_char, ip_dst_char));
+    return(Xbit_Condition_MMAP(rule_position, ip_src, ip_dst));
 
 }
 
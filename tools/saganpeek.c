@@ -31,6 +31,7 @@
 #endif
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <sys/mman.h>
 #include <fcntl.h>
 #include <errno.h>
@@ -43,9 +44,11 @@
 #include <unistd.h>
 #include <stdbool.h>
 #include <getopt.h>
+#include <pthread.h>
 
 #include "../src/sagan.h"
 #include "../src/sagan-defs.h"
+#include "../src/ipc-hash.h"
 #include "../src/flexbit-mmap.h"
 #include "../src/xbit-mmap.h"
 #include "../src/util-time.h"
@@ -119,6 +122,70 @@ char *u32_time_to_human( uint64_t utime )
 
 }
 
+/****************************************************************************
+ * ipc_hash_map - Map an IPC object written through ipc-hash.c read only.
+ * The file starts with the index,  which records how many entries it was
+ * created for.  "entries" is pointed at the entry array and the number of
+ * entries handed out so far is returned.
+ ****************************************************************************/
+
+uint32_t ipc_hash_map( char *object, size_t entry_size, void **entries )
+{
+
+    struct _IPC_Hash *Index = NULL;
+
+    uint32_t max_entries = 0;
+    uint32_t entry_count = 0;
+    size_t size = 0;
+
+    int shm;
+
+    if ((shm = open(object, O_RDONLY ) ) == -1 )
+        {
+            fprintf(stderr, "[%s, line %d] Cannot open() (%s)\n", __FILE__, __LINE__, strerror(errno));
+            exit(1);
+        }
+
+    if (( Index = mmap(0, sizeof(_IPC_Hash), PROT_READ, MAP_SHARED, shm, 0)) == MAP_FAILED )
+        {
+            fprintf(stderr, "[%s, line %d] Error allocating memory object! [%s]\n", __FILE__, __LINE__, strerror(errno));
+            exit(1);
+        }
+
+    max_entries = Index->max_entries;
+
+    if ( Index->entry_size != entry_size )
+        {
+            fprintf(stderr, "Error.  %s holds %u byte entries,  not %zu.  Was it created by another version of Sagan?\n", object, Index->entry_size, entry_size);
+            exit(1);
+        }
+
+    munmap(Index, sizeof(_IPC_Hash));
+
+    size = IPC_Hash_Size( max_entries, entry_size );
+
+    if (( Index = mmap(0, size, PROT_READ, MAP_SHARED, shm, 0)) == MAP_FAILED )
+        {
+            fprintf(stderr, "[%s, line %d] Error allocating memory object! [%s]\n", __FILE__, __LINE__, strerror(errno));
+            exit(1);
+        }
+
+    close(shm);
+
+    /* The entries follow the index and its slots */
+
+    *entries = (char *)Index + size - (size_t)max_entries * entry_size;
+
+    entry_count = __atomic_load_n(&Index->entry_count, __ATOMIC_ACQUIRE);
+
+    if ( entry_count > max_entries )
+        {
+            entry_count = max_entries;
+        }
+
+    return(entry_count);
+}
+
 /****************************************************************************
  * main - Pull data from shared memory and display it!
  ****************************************************************************/
@@ -168,6 +235,7 @@ int main(int argc, char **argv)
     /* For convert to IP string */
 
     char ip_src[MAXIP] = { 0 };
+    char ip_dst[MAXIP] = { 0 };
     char time_buf[80] = { 0 };
 
     /* Shared memory descriptors */
@@ -176,6 +244,7 @@ int main(int argc, char **argv)
     int shm;
 
     int i;
+    uint32_t count = 0;
 
     bool typeflag = 0;
     unsigned char type = ALL_TYPES;
@@ -303,25 +372,13 @@ int main(int argc, char **argv)
                     exit(1);
                 }
 
-            if ((shm = open(tmp_object_check, O_RDONLY ) ) == -1 )
-                {
-                    fprintf(stderr, "[%s, line %d] Cannot open() (%s)\n", __FILE__, __LINE__, strerror(errno));
-                    exit(1);
-                }
-
-            if (( Threshold2_IPC = mmap(0, sizeof(_Threshold2_IPC) + (sizeof(_Threshold2_IPC) * counters_ipc->thresh2_count ) , PROT_READ, MAP_SHARED, shm, 0)) == MAP_FAILED )
-                {
-                    fprintf(stderr, "[%s, line %d] Error allocating memory object! [%s]\n", __FILE__, __LINE__, strerror(errno));
-                    exit(1);
-                }
-
-            close(shm);
+            count = ipc_hash_map( tmp_object_check, sizeof(_Threshold2_IPC), (void **)&Threshold2_IPC );
 
-            if ( counters_ipc->thresh2_count >= 1 )
+            if ( count >= 1 )
                 {
 
 
-                    for ( i = 0; i < counters_ipc->thresh2_count; i++)
+                    for ( i = 0; i < count; i++)
                         {
 
                             thresh_oldtime = current_time - Threshold2_IPC[i].utime;
@@ -337,7 +394,7 @@ int main(int argc, char **argv)
 
                                     printf("Type: Threshold [%d].\n", i);
 
-                                    printf("Tracking hash: %u\n", Threshold2_IPC[i].hash);
+                                    printf("Tracking hash: %" PRIu64 "\n", Threshold2_IPC[i].hash);
 
                                     printf("Tracking by:");
 
@@ -424,24 +481,12 @@ int main(int argc, char **argv)
                     exit(1);
                 }
 
-            if ((shm = open(tmp_object_check, O_RDONLY ) ) == -1 )
-                {
-                    fprintf(stderr, "[%s, line %d] Cannot open() (%s)\n", __FILE__, __LINE__, strerror(errno));
-                    exit(1);
-                }
+            count = ipc_hash_map( tmp_object_check, sizeof(_After2_IPC), (void **)&After2_IPC );
 
-            if (( After2_IPC = mmap(0, sizeof(_After2_IPC) + (sizeof(_After2_IPC) * counters_ipc->after2_count ) , PROT_READ, MAP_SHARED, shm, 0)) == MAP_FAILED )
-                {
-                    fprintf(stderr, "[%s, line %d] Error allocating memory object! [%s]\n", __FILE__, __LINE__, strerror(errno));
-                    exit(1);
-                }
-
-            close(shm);
-
-            if ( counters_ipc->after2_count >= 1 )
+            if ( count >= 1 )
                 {
 
-                    for ( i = 0; i < counters_ipc->after2_count; i++)
+                    for ( i = 0; i < count; i++)
                         {
 
                             after_oldtime = current_time - After2_IPC[i].utime;
@@ -457,7 +502,7 @@ int main(int argc, char **argv)
 
                                     u32_Time_To_Human(After2_IPC[i].utime, time_buf, sizeof(time_buf));
 
-                                    printf("Tracking hash: %u\n", After2_IPC[i].hash);
+                                    printf("Tracking hash: %" PRIu64 "\n", After2_IPC[i].hash);
 
                                     printf("Tracking by:");
 
@@ -542,25 +587,12 @@ int main(int argc, char **argv)
                     exit(1);
                 }
 
-            if ((shm = open(tmp_object_check, O_RDONLY ) ) == -1 )
-                {
-                    fprintf(stderr, "[%s, line %d] Cannot open() (%s)\n", __FILE__, __LINE__, strerror(errno));
-                    exit(1);
-                }
+            count = ipc_hash_map( tmp_object_check, sizeof(_Sagan_IPC_Flexbit), (void **)&flexbit_ipc );
 
-            if (( flexbit_ipc = mmap(0, sizeof(_Sagan_IPC_Flexbit) + (sizeof(_Sagan_IPC_Flexbit) * counters_ipc->flexbit_count ) , PROT_READ, MAP_SHARED, shm, 0)) == MAP_FAILED )
-                {
-                    fprintf(stderr, "[%s, line %d] Error allocating memory object! [%s]\n", __FILE__, __LINE__, strerror(errno));
-                    exit(1);
-                }
-
-            close(shm);
-
-
-            if ( counters_ipc->flexbit_count >= 1 )
+            if ( count >= 1 )
                 {
 
-                    for (i= 0; i < counters_ipc->flexbit_count; i++ )
+                    for (i= 0; i < count; i++ )
                         {
 
                             if ( flexbit_ipc[i].flexbit_state == 1 || all_flag == true )
@@ -573,7 +605,10 @@ int main(int argc, char **argv)
 
                                     printf("Xbit name: \"%s\"\n", flexbit_ipc[i].flexbit_name);
                                     printf("State: %s\n", flexbit_ipc[i].flexbit_state == 1 ? "ACTIVE" : "INACTIVE");
-                                    printf("IP: %s:%d -> %s:%d\n", flexbit_ipc[i].ip_src, flexbit_ipc[i].src_port, flexbit_ipc[i].ip_dst, flexbit_ipc[i].dst_port);
+                                    Bit2IP(flexbit_ipc[i].ip_src, ip_src, sizeof(ip_src));
+                                    Bit2IP(flexbit_ipc[i].ip_dst, ip_dst, sizeof(ip_dst));
+
+                                    printf("IP: %s:%d -> %s:%d\n", ip_src, flexbit_ipc[i].src_port, ip_dst, flexbit_ipc[i].dst_port);
                                     printf("Signature: \"%s\" (Signature ID: %" PRIu64 ")\n", flexbit_ipc[i].signature_msg, flexbit_ipc[i].sid);
                                     printf("Expire Time: %s (%d seconds)\n", time_buf, flexbit_ipc[i].expire);
                                     printf("Time until expire: %" PRIi64 " seconds.\n", flexbit_oldtime);
@@ -605,24 +640,12 @@ int main(int argc, char **argv)
             if ( err == false )
                 {
 
-                    if ((shm = open(tmp_object_check, O_RDONLY ) ) == -1 )
-                        {
-                            fprintf(stderr, "[%s, line %d] Cannot open() (%s)\n", __FILE__, __LINE__, strerror(errno));
-                            exit(1);
-                        }
-
-                    if (( xbit_ipc = mmap(0, sizeof(_Sagan_IPC_Xbit) + (sizeof(_Sagan_IPC_Xbit) * counters_ipc->xbit_count ) , PROT_READ, MAP_SHARED, shm, 0)) == MAP_FAILED )
-                        {
-                            fprintf(stderr, "[%s, line %d] Error allocating memory object! [%s]\n", __FILE__, __LINE__, strerror(errno));
-                            exit(1);
-                        }
-
-                    close(shm);
+                    count = ipc_hash_map( tmp_object_check, sizeof(_Sagan_IPC_Xbit), (void **)&xbit_ipc );
 
-                    if ( counters_ipc->xbit_count >= 1 )
+                    if ( count >= 1 )
                         {
 
-                            for (i= 0; i < counters_ipc->xbit_count; i++ )
+                            for (i= 0; i < count; i++ )
                                 {
 
                                     u32_Time_To_Human(xbit_ipc[i].xbit_expire, time_buf, sizeof(time_buf));